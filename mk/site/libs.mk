@@ -11,7 +11,7 @@ ONLOAD_EXT_VERSION_MAJOR := 1
 ONLOAD_EXT_VERSION_MINOR := 2
 
 # Micro: Incremented for any change.  Reset to zero when minor is bumped.
-ONLOAD_EXT_VERSION_MICRO := 0
+ONLOAD_EXT_VERSION_MICRO := 14
 
 lib_name  := onload_ext
 lib_where := lib/onload_ext
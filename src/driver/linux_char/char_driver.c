@@ -48,6 +48,14 @@ MODULE_PARM_DESC(phys_mode_gid,
 
 MODULE_AUTHOR("Solarflare Communications");
 MODULE_LICENSE("GPL");
+/* For registrations of dma-buf memory in efch_memreg.c. */
+#ifdef MODULE_IMPORT_NS
+# ifdef EFRM_MODULE_IMPORT_NS_IS_IDENT
+MODULE_IMPORT_NS(DMA_BUF);
+# else
+MODULE_IMPORT_NS("DMA_BUF");
+# endif
+#endif
 
 
 /*--------------------------------------------------------------------
@@ -10,6 +10,7 @@
 #include <ci/efrm/sysdep.h>
 #include "ci/driver/kernel_compat.h"
 #include <ci/driver/efab/hardware.h>
+#include <linux/dma-buf.h>
 
 struct efch_memreg_area_params {
   struct efrm_bt_collection           bt_alloc;
@@ -26,23 +27,59 @@ struct efch_memreg {
   int                                 nic_order;
 
   struct efch_memreg_area_params      area;
+
+  /* Only for registrations of a dma-buf, whose memory is already mapped
+   * for the NIC by the exporter. */
+  struct dma_buf                     *dmabuf;
+  struct dma_buf_attachment          *dmabuf_attach;
+  struct sg_table                    *dmabuf_sgt;
 };
 
 
 CI_BUILD_ASSERT(PAGE_SIZE == EFHW_NIC_PAGE_SIZE);
 
+
+static struct sg_table *efch_dma_buf_map(struct dma_buf_attachment *attach)
+{
+#ifdef EFRM_HAVE_DMA_BUF_MAP_ATTACHMENT_UNLOCKED
+  return dma_buf_map_attachment_unlocked(attach, DMA_BIDIRECTIONAL);
+#else
+  return dma_buf_map_attachment(attach, DMA_BIDIRECTIONAL);
+#endif
+}
+
+static void efch_dma_buf_unmap(struct dma_buf_attachment *attach,
+                               struct sg_table *sgt)
+{
+#ifdef EFRM_HAVE_DMA_BUF_MAP_ATTACHMENT_UNLOCKED
+  dma_buf_unmap_attachment_unlocked(attach, sgt, DMA_BIDIRECTIONAL);
+#else
+  dma_buf_unmap_attachment(attach, sgt, DMA_BIDIRECTIONAL);
+#endif
+}
+
 static void efch_memreg_free(struct efch_memreg *mr)
 {
   int i;
 
   if (mr->area.mapped) {
-    efrm_pd_dma_unmap(mr->pd, mr->area.n_addrs, mr->nic_order,
-                      mr->area.free_addrs, &mr->area.bt_alloc, 0);
+    if (mr->dmabuf != NULL)
+      efrm_pd_dma_unmap_premapped(mr->pd, &mr->area.bt_alloc, 0);
+    else
+      efrm_pd_dma_unmap(mr->pd, mr->area.n_addrs, mr->nic_order,
+                        mr->area.free_addrs, &mr->area.bt_alloc, 0);
     vfree(mr->area.dma_addrs);
     vfree(mr->area.free_addrs);
     mr->area.mapped = false;
   }
 
+  if (mr->dmabuf_sgt != NULL)
+    efch_dma_buf_unmap(mr->dmabuf_attach, mr->dmabuf_sgt);
+  if (mr->dmabuf_attach != NULL)
+    dma_buf_detach(mr->dmabuf, mr->dmabuf_attach);
+  if (mr->dmabuf != NULL)
+    dma_buf_put(mr->dmabuf);
+
   for (i = 0; i < mr->n_pages; ++i)
     unpin_user_page(mr->pages[i]);
   if (mr->pd != NULL)
@@ -158,6 +195,125 @@ static inline unsigned addr_page_align_order(uint64_t addr)
 }
 
 
+/* Registers [in_mem_ptr, in_mem_end) of a dma-buf, such as GPU memory
+ * exported by its driver.  The exporter maps the buffer for the NIC, so we
+ * only have to program the buffer table with the addresses it gives us.
+ */
+static int
+memreg_alloc_dmabuf(struct efch_memreg_alloc *alloc, uint64_t in_mem_end,
+                    struct efrm_pd *pd, struct efch_memreg **mr_out)
+{
+  struct efhw_nic *nic =
+    efrm_client_get_nic(efrm_pd_to_resource(pd)->rs_client);
+  struct efch_memreg *mr;
+  struct device *dev;
+  struct scatterlist *sg;
+  uint64_t sg_start, sg_end, lo, hi, addr_or, chunk;
+  int rc, i, j;
+
+  if ((mr = kzalloc(sizeof(*mr), GFP_KERNEL)) == NULL)
+    return -ENOMEM;
+
+  mr->dmabuf = dma_buf_get(alloc->in_dmabuf_fd);
+  if (IS_ERR(mr->dmabuf)) {
+    rc = PTR_ERR(mr->dmabuf);
+    mr->dmabuf = NULL;
+    goto fail;
+  }
+  if (in_mem_end > mr->dmabuf->size) {
+    rc = -EINVAL;
+    goto fail;
+  }
+
+  dev = efhw_nic_get_dev(nic);
+  if (dev == NULL) {
+    rc = -ENODEV;
+    goto fail;
+  }
+  mr->dmabuf_attach = dma_buf_attach(mr->dmabuf, dev);
+  put_device(dev);
+  if (IS_ERR(mr->dmabuf_attach)) {
+    rc = PTR_ERR(mr->dmabuf_attach);
+    mr->dmabuf_attach = NULL;
+    goto fail;
+  }
+  mr->dmabuf_sgt = efch_dma_buf_map(mr->dmabuf_attach);
+  if (IS_ERR(mr->dmabuf_sgt)) {
+    rc = PTR_ERR(mr->dmabuf_sgt);
+    mr->dmabuf_sgt = NULL;
+    goto fail;
+  }
+
+  /* As for user memory, all buffer table entries have the same order, so
+   * use the largest that every DMA-contiguous piece of the range is
+   * aligned to.
+   */
+  addr_or = in_mem_end - alloc->in_mem_ptr;
+  sg_start = 0;
+  for_each_sg(mr->dmabuf_sgt->sgl, sg, mr->dmabuf_sgt->nents, i) {
+    sg_end = sg_start + sg_dma_len(sg);
+    lo = max(sg_start, alloc->in_mem_ptr);
+    hi = min(sg_end, in_mem_end);
+    if (lo < hi)
+      addr_or |= (sg_dma_address(sg) + lo - sg_start) | (hi - lo);
+    sg_start = sg_end;
+  }
+  if (sg_start < in_mem_end || (addr_or & (EFHW_NIC_PAGE_SIZE - 1)) != 0) {
+    EFCH_ERR("%s: ERROR: dma-buf mapping does not cover the range or is "
+             "not NIC page aligned (mapped=%llx end=%llx or=%llx)",
+             __FUNCTION__, (unsigned long long) sg_start,
+             (unsigned long long) in_mem_end,
+             (unsigned long long) addr_or);
+    rc = -EINVAL;
+    goto fail;
+  }
+  mr->nic_order = __ffs64(addr_or) - EFHW_NIC_PAGE_SHIFT;
+  chunk = (uint64_t) EFHW_NIC_PAGE_SIZE << mr->nic_order;
+  mr->area.n_addrs = (in_mem_end - alloc->in_mem_ptr) >>
+                     (EFHW_NIC_PAGE_SHIFT + mr->nic_order);
+
+  mr->area.dma_addrs = vmalloc(mr->area.n_addrs *
+                               sizeof(mr->area.dma_addrs[0]));
+  mr->area.free_addrs = vmalloc(mr->area.n_addrs *
+                                sizeof(mr->area.free_addrs[0]));
+  if (mr->area.dma_addrs == NULL || mr->area.free_addrs == NULL) {
+    rc = -ENOMEM;
+    goto fail;
+  }
+
+  j = 0;
+  sg_start = 0;
+  for_each_sg(mr->dmabuf_sgt->sgl, sg, mr->dmabuf_sgt->nents, i) {
+    sg_end = sg_start + sg_dma_len(sg);
+    hi = min(sg_end, in_mem_end);
+    for (lo = max(sg_start, alloc->in_mem_ptr); lo < hi; lo += chunk)
+      mr->area.free_addrs[j++] = sg_dma_address(sg) + lo - sg_start;
+    sg_start = sg_end;
+  }
+  ci_assert_equal(j, mr->area.n_addrs);
+
+  rc = efrm_pd_dma_map_premapped(pd, mr->area.n_addrs, mr->nic_order,
+                                 mr->area.dma_addrs, mr->area.free_addrs,
+                                 (void *)(ci_uintptr_t)alloc->in_addrs_out_ptr,
+                                 alloc->in_addrs_out_stride, put_user_64,
+                                 &mr->area.bt_alloc, 0);
+  if (rc < 0) {
+    EFCH_ERR("%s: ERROR: efrm_pd_dma_map_premapped failed (%d)",
+             __FUNCTION__, rc);
+    goto fail;
+  }
+  mr->area.mapped = true;
+  *mr_out = mr;
+  return 0;
+
+ fail:
+  vfree(mr->area.dma_addrs);
+  vfree(mr->area.free_addrs);
+  efch_memreg_free(mr);
+  return rc;
+}
+
+
 static int
 memreg_rm_alloc(ci_resource_alloc_t* alloc_,
                 ci_resource_table_t* priv_opt,
@@ -190,6 +346,7 @@ memreg_rm_alloc(ci_resource_alloc_t* alloc_,
     CI_ALIGN_FWD(alloc->in_mem_bytes, EFHW_NIC_PAGE_SIZE);
 
   if ((alloc->in_mem_bytes == 0) ||
+      ((alloc->in_flags & ~EFCH_MEMREG_FLAG_DMABUF) != 0) ||
       ((alloc->in_mem_ptr & (EFHW_NIC_PAGE_SIZE - 1)) != 0) ||
       ((in_mem_end & (EFHW_NIC_PAGE_SIZE - 1)) != 0)) {
     rc = -EINVAL;
@@ -219,6 +376,16 @@ memreg_rm_alloc(ci_resource_alloc_t* alloc_,
     pd = efrm_pd_from_resource(vi_or_pd);
   }
 
+  if (alloc->in_flags & EFCH_MEMREG_FLAG_DMABUF) {
+    rc = memreg_alloc_dmabuf(alloc, in_mem_end, pd, &mr);
+    if (rc < 0)
+      goto fail2;
+    mr->pd = pd;
+    ch_rs->rs_base = NULL;
+    ch_rs->memreg = mr;
+    return 0;
+  }
+
   first_page = alloc->in_mem_ptr & PAGE_MASK;
   last_page = (in_mem_end + PAGE_SIZE - 1) & PAGE_MASK;
   max_pages = (last_page - first_page) >> PAGE_SHIFT;
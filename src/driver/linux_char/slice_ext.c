@@ -203,6 +203,46 @@ out:
 }
 
 
+static int
+ext_do_msg_batch(efch_resource_t* rs, struct efch_ext_msg __user * msgs_user,
+                 unsigned n_msgs, unsigned flags)
+{
+  struct efch_ext_msg* msgs;
+  size_t size = n_msgs * sizeof(*msgs);
+  unsigned i;
+  int rc = 0;
+
+  if (flags)
+    return -EINVAL;
+  if (n_msgs == 0)
+    return 0;
+  if (n_msgs > EFCH_EXT_MSG_BATCH_MAX)
+    return -E2BIG;
+
+  msgs = kmalloc(size, GFP_KERNEL);
+  if (!msgs)
+    return -ENOMEM;
+  if (copy_from_user(msgs, msgs_user, size)) {
+    rc = -EFAULT;
+    goto out;
+  }
+
+  /* A failed message does not stop the batch: each result goes back in
+   * its own entry, as if the messages had been sent one at a time. */
+  for (i = 0; i < n_msgs; ++i)
+    msgs[i].rc = ext_do_msg(rs, msgs[i].msg_id,
+                            (void __user *)(uintptr_t)msgs[i].payload_ptr,
+                            msgs[i].payload_len, 0);
+
+  if (copy_to_user(msgs_user, msgs, size))
+    rc = -EFAULT;
+
+out:
+  kfree(msgs);
+  return rc;
+}
+
+
 static int
 ext_rm_rsops(efch_resource_t* rs, ci_resource_table_t* priv_opt,
              ci_resource_op_t* op, int* copy_out)
@@ -221,6 +261,12 @@ ext_rm_rsops(efch_resource_t* rs, ci_resource_table_t* priv_opt,
                       op->u.ext_msg.payload_len,
                       op->u.ext_msg.flags);
 
+  case CI_RSOP_EXT_MSG_BATCH:
+    return ext_do_msg_batch(rs, (struct efch_ext_msg __user *)
+                                (uintptr_t)op->u.ext_msg_batch.msgs_ptr,
+                            op->u.ext_msg_batch.n_msgs,
+                            op->u.ext_msg_batch.flags);
+
   default:
     EFCH_ERR("%s: Invalid op, expected CI_RSOP_EXT_*", __FUNCTION__);
     return -EINVAL;
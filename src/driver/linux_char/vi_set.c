@@ -144,6 +144,10 @@ vi_set_rm_rsops(efch_resource_t* rs, ci_resource_table_t* priv_opt,
       rc = efch_filter_list_op_block(rs->rs_base, efrm_vi_set_get_pd(vi_set),
                                      &rs->vi_set.fl, op);
       break;
+    case CI_RSOP_VI_SET_RSS_SPREAD:
+      rc = efrm_vi_set_rss_spread(vi_set, EFRM_RSS_MODE_ID_DEFAULT,
+                                  op->u.vi_set_rss_spread.n_active);
+      break;
     default:
       flags = 0;
       if( efrm_vi_set_num_vis(vi_set) > 1 )
@@ -40,7 +40,7 @@ struct efx_dl_device_info;
  * kbuild and the module loader using symbol versions.
  */
 #define EFX_DRIVERLINK_API_VERSION 33
-#define EFX_DRIVERLINK_API_VERSION_MINOR_MAX 1
+#define EFX_DRIVERLINK_API_VERSION_MINOR_MAX 2
 
 /* If the client didn't define their VERSION_MINOR, default to 0 */
 #ifndef EFX_DRIVERLINK_API_VERSION_MINOR
@@ -293,6 +293,20 @@ enum efx_dl_filter_block_kernel_type {
 	EFX_DL_FILTER_BLOCK_KERNEL_MAX,
 };
 
+/**
+ * typedef efx_dl_mcdi_async_completer - Completion of an asynchronous MCDI
+ *	command issued with efx_dl_mcdi_rpc_async()
+ * @dl_dev: Driverlink client device context
+ * @cookie: The cookie passed to efx_dl_mcdi_rpc_async()
+ * @rc: A negative error code or 0 on success
+ * @outbuf: Response buffer, valid only for the duration of the call
+ * @outlen_actual: Length of the response, in bytes
+ */
+typedef void efx_dl_mcdi_async_completer(struct efx_dl_device *dl_dev,
+					 unsigned long cookie, int rc,
+					 const u8 *outbuf,
+					 size_t outlen_actual);
+
 /**
  * struct efx_dl_ops - Operations for driverlink clients to use
  *	on a driverlink nic.
@@ -323,6 +337,7 @@ enum efx_dl_filter_block_kernel_type {
  * @client_alloc: Allocate a dynamic client ID
  * @client_free: Free a dynamic client ID
  * @vi_set_user: Set VI user to client ID
+ * @mcdi_rpc_async: Issue an MCDI command without waiting for completion
 */
 struct efx_dl_ops {
 	bool (*hw_unavailable)(struct efx_dl_device *efx_dev);
@@ -388,6 +403,10 @@ struct efx_dl_ops {
 	int (*client_free)(struct efx_dl_device *dl_dev, u32 id);
 	int (*vi_set_user)(struct efx_dl_device *dl_dev, u32 vi_instance,
 			u32 client_id);
+	int (*mcdi_rpc_async)(struct efx_dl_device *dl_dev, unsigned int cmd,
+			      size_t inlen, const u8 *inbuf,
+			      efx_dl_mcdi_async_completer *complete,
+			      unsigned long cookie);
 };
 
 /**
@@ -824,6 +843,35 @@ static inline int efx_dl_mcdi_rpc(struct efx_dl_device *dl_dev,
 					  inbuf, outbuf);
 }
 
+/**
+ * efx_dl_mcdi_rpc_async - Issue an MCDI command without waiting for it
+ * @dl_dev: Driverlink client device context
+ * @cmd: Command type number
+ * @inlen: Length of command parameters, in bytes.  Must be a multiple
+ *	of 4 and no greater than %MC_SMEM_PDU_LEN.
+ * @inbuf: Command parameters.  These are copied, so the buffer may be
+ *	reused as soon as this returns.
+ * @complete: Called from process context once the command has completed,
+ *	failed or been abandoned.  May be %NULL.
+ * @cookie: Passed to @complete
+ *
+ * Commands are queued behind any others outstanding on the function, so
+ * a caller issuing several independent commands need not wait for each in
+ * turn.  This function does not sleep.  Defined from API version 34.2.
+ *
+ * Return: a negative error code if the command could not be queued, in
+ * which case @complete is not called, or 0.
+ */
+static inline int efx_dl_mcdi_rpc_async(struct efx_dl_device *dl_dev,
+					unsigned int cmd, size_t inlen,
+					const u8 *inbuf,
+					efx_dl_mcdi_async_completer *complete,
+					unsigned long cookie)
+{
+	return dl_dev->nic->ops->mcdi_rpc_async(dl_dev, cmd, inlen, inbuf,
+						complete, cookie);
+}
+
 /**
  * efx_dl_dma_xlate - Translate local DMA addresses to QDMA addresses
  * @dl_dev: Driverlink client device context
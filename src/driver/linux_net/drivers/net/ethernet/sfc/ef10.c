@@ -3638,7 +3638,19 @@ efx_ef10_handle_driver_event(struct efx_channel *channel,
 	case ESE_DZ_DRV_WAKE_UP_EV:
 #ifdef EFX_NOT_UPSTREAM
 #if IS_MODULE(CONFIG_SFC_DRIVERLINK)
-		return efx_dl_handle_event(&efx->dl_nic, event, budget);
+	{
+		/* Wakeups for driverlink clients' event queues are steered
+		 * to this channel, so count the events the client handled
+		 * towards adaptive IRQ moderation as we do for our own RX.
+		 * Otherwise a channel busy with wakeups only ever sees a low
+		 * score and moderation stays at its minimum.
+		 */
+		int rc = efx_dl_handle_event(&efx->dl_nic, event, budget);
+
+		if (rc > 0)
+			channel->irq_mod_score += 2 * rc;
+		return rc;
+	}
 #endif
 #endif
 		break;
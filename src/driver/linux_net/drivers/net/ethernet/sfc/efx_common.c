@@ -2646,6 +2646,53 @@ static int __efx_dl_mcdi_rpc(struct efx_dl_device *efx_dev, unsigned int cmd,
 				  outlen_actual);
 }
 
+struct efx_dl_mcdi_async {
+	struct efx_dl_device *efx_dev;
+	efx_dl_mcdi_async_completer *complete;
+	unsigned long cookie;
+};
+
+static void __efx_dl_mcdi_rpc_async_complete(struct efx_nic *efx,
+					     unsigned long cookie, int rc,
+					     efx_dword_t *outbuf,
+					     size_t outlen_actual)
+{
+	struct efx_dl_mcdi_async *async = (struct efx_dl_mcdi_async *)cookie;
+
+	if (async->complete)
+		async->complete(async->efx_dev, async->cookie, rc,
+				(const u8 *)outbuf, outlen_actual);
+	kfree(async);
+}
+
+static int __efx_dl_mcdi_rpc_async(struct efx_dl_device *efx_dev,
+				   unsigned int cmd, size_t inlen,
+				   const u8 *inbuf,
+				   efx_dl_mcdi_async_completer *complete,
+				   unsigned long cookie)
+{
+	struct efx_nic *efx = efx_dl_device_priv(efx_dev);
+	struct efx_dl_mcdi_async *async;
+	int rc;
+
+	if (WARN_ON(inlen & 3))
+		return -EINVAL;
+
+	async = kmalloc(sizeof(*async), GFP_ATOMIC);
+	if (!async)
+		return -ENOMEM;
+	async->efx_dev = efx_dev;
+	async->complete = complete;
+	async->cookie = cookie;
+
+	rc = efx_mcdi_rpc_async_quiet(efx, cmd, (const efx_dword_t *)inbuf,
+				      inlen, __efx_dl_mcdi_rpc_async_complete,
+				      (unsigned long)async);
+	if (rc)
+		kfree(async);
+	return rc;
+}
+
 static int __efx_dl_filter_block_kernel(struct efx_dl_device *efx_dev,
 					enum efx_dl_filter_block_kernel_type type)
 {
@@ -2790,6 +2837,7 @@ static struct efx_dl_ops efx_driverlink_ops = {
 	.client_alloc = __efx_dl_client_alloc,
 	.client_free = __efx_dl_client_free,
 	.vi_set_user = __efx_dl_vi_set_user,
+	.mcdi_rpc_async = __efx_dl_mcdi_rpc_async,
 };
 
 void efx_dl_probe(struct efx_nic *efx)
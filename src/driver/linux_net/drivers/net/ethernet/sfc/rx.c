@@ -525,7 +525,12 @@ void __efx_rx_packet(struct efx_rx_queue *rx_queue)
 		/* fall through */
 #endif
 #if !defined(EFX_USE_KCOMPAT) || defined(EFX_USE_GRO)
+	/* With GRO turned off (ethtool -K gro off) the GRO path would only
+	 * hand each packet to the stack on its own, bypassing the batched
+	 * channel->rx_list delivery, so send TCP the same way as the rest.
+	 */
 	if ((rx_buf->flags & EFX_RX_PKT_TCP) &&
+	    (efx->net_dev->features & NETIF_F_GRO) &&
 	    !rx_queue->receive_skb
 #if defined(EFX_USE_KCOMPAT) && defined(EFX_WANT_DRIVER_BUSY_POLL)
 	    && !efx_channel_busy_polling(channel)
@@ -102,6 +102,13 @@ MODULE_PARM_DESC(oof_shared_steal_thresh,
                  "the filter to persist even when a new wildcard socket needs "
                  "the filter.");
 
+module_param(oof_filter_pressure_thresh, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(oof_filter_pressure_thresh,
+                 "Number of Onload hardware filters on an interface above "
+                 "which sockets sharing a wildcard filter keep sharing it "
+                 "rather than being given their own full-match filters.  "
+                 "0 disables.");
+
 module_param(oof_all_ports_required, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(oof_all_ports_required, 
                  "When set Onload will generate an error if it is unable to "
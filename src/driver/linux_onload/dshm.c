@@ -7,6 +7,11 @@
  * (specified by the caller) and ID (returned by us).  We take a reference to
  * the underlying pages.  Other clients can then map those buffers into their
  * own address spaces.
+ *
+ * Clients may instead ask us to allocate the buffer, in which case the
+ * pages are mapped into every address space as normal pages rather than
+ * raw PFNs.  That allows each mapping to be pinned, and hence registered
+ * for DMA with onload_zc_register_buffers().
  */
 
 #include <linux/errno.h>
@@ -53,6 +58,8 @@ struct oo_dshm_buffer {
   ci_dllink handle_link;
   uid_t owner_euid;
   atomic_t refcount;
+  /* Pages were allocated by us rather than pinned from the user. */
+  ci_uint8 kernel_pages;
 };
 
 
@@ -110,21 +117,38 @@ oo_dshm_register_impl(ci_int32 shm_class, ci_user_ptr_t user_addr,
   }
   buffer->buffer_id = *buffer_id_out;
 
-  /* Take references to the pages from the user's buffer. */
-  mmap_read_lock(current->mm);
-  rc = ci_pin_user_pages((unsigned long) CI_USER_PTR_GET(user_addr),
-                         buffer->num_pages, 0 /* read-only, no force */,
-                         buffer->pages);
-  mmap_read_unlock(current->mm);
-
-  if( rc < (int)buffer->num_pages ) {
-    /* We pinned fewer pages than we asked for.  This should never happen, so
-     * treat it as fatal. */
-    int i;
-    for( i = 0; i < rc; ++i )
-      unpin_user_page(buffer->pages[i]);
-    rc = -EIO;
-    goto fail3;
+  if( CI_USER_PTR_GET(user_addr) == NULL ) {
+    /* Allocate the pages ourselves. */
+    ci_uint32 i;
+    buffer->kernel_pages = 1;
+    for( i = 0; i < buffer->num_pages; ++i ) {
+      buffer->pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+      if( buffer->pages[i] == NULL ) {
+        while( i > 0 )
+          __free_page(buffer->pages[--i]);
+        rc = -ENOMEM;
+        goto fail3;
+      }
+    }
+  }
+  else {
+    /* Take references to the pages from the user's buffer. */
+    buffer->kernel_pages = 0;
+    mmap_read_lock(current->mm);
+    rc = ci_pin_user_pages((unsigned long) CI_USER_PTR_GET(user_addr),
+                           buffer->num_pages, 0 /* read-only, no force */,
+                           buffer->pages);
+    mmap_read_unlock(current->mm);
+
+    if( rc < (int)buffer->num_pages ) {
+      /* We pinned fewer pages than we asked for.  This should never happen,
+       * so treat it as fatal. */
+      int i;
+      for( i = 0; i < rc; ++i )
+        unpin_user_page(buffer->pages[i]);
+      rc = -EIO;
+      goto fail3;
+    }
   }
 
   /* Stash the buffer in the appropriate lists so that we can find it again. */
@@ -204,8 +228,12 @@ static void dshm_release(struct oo_dshm_buffer* buffer)
 {
   if( atomic_dec_and_test(&buffer->refcount) ) {
     ci_uint32 i;
-    for( i = 0; i < buffer->num_pages; ++i )
-      unpin_user_page(buffer->pages[i]);
+    for( i = 0; i < buffer->num_pages; ++i ) {
+      if( buffer->kernel_pages )
+        __free_page(buffer->pages[i]);
+      else
+        unpin_user_page(buffer->pages[i]);
+    }
 
     ci_id_pool_free(&oo_dshm_state.ids[buffer->shm_class], buffer->buffer_id,
                     &oo_dshm_state.lock);
@@ -295,12 +323,16 @@ oo_dshm_mmap_impl(struct vm_area_struct* vma)
                                    map_length >> PAGE_SHIFT);
       ci_uint32 i;
       for( i = 0, rc = 0; i < num_pages && rc == 0; ++i ) {
+        unsigned long addr = vma->vm_start + (unsigned long) i * PAGE_SIZE;
         /* vm_insert_page() would have been simpler (and allow core dumps to
-         * capture these pages), but it fails with anonymous pages */
-        rc = remap_pfn_range(vma,
-                             vma->vm_start + (unsigned long) i * PAGE_SIZE,
-                             page_to_pfn(buffer->pages[i]),
-                             PAGE_SIZE, vma->vm_page_prot);
+         * capture these pages), but it fails with anonymous pages, so it
+         * is only used for pages that we allocated.  Those mappings can be
+         * pinned again by the process that maps them. */
+        if( buffer->kernel_pages )
+          rc = vm_insert_page(vma, addr, buffer->pages[i]);
+        else
+          rc = remap_pfn_range(vma, addr, page_to_pfn(buffer->pages[i]),
+                               PAGE_SIZE, vma->vm_page_prot);
       }
     }
     else {
@@ -73,6 +73,13 @@ struct oo_epoll1_private {
   ci_uint32 flags;
 #define OO_EPOLL1_FLAG_HOME_STACK_CHANGED 1
   ci_waitable_t home_w;
+
+  /* Ready lists held by UL in other stacks.  We only need to know about
+   * them to give them back if UL goes away without doing so. */
+  struct {
+    tcp_helper_resource_t* thr;
+    int ready_list;
+  } satellites[OO_EPOLL1_SATELLITES_MAX];
 #endif
 };
 
@@ -444,6 +451,9 @@ static void oo_epoll2_wait(struct oo_epoll_private *priv,
     ci_atomic32_dec(&ni->state->n_spinners);
     tcp_helper_request_wakeup(thr);
     CITP_STATS_NETIF_INC(&thr->netif, muxer_primes);
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+    tcp_helper_irq_follow(thr);
+#endif
   }
 
   /* Block */
@@ -652,6 +662,9 @@ static int oo_epoll1_mmap(struct oo_epoll1_private* priv,
 static int oo_epoll1_release(struct oo_epoll_private* priv)
 {
   struct oo_epoll1_private* priv1 = &priv->p.p1;
+#if CI_CFG_EPOLL3
+  int i;
+#endif
 
   ci_assert(priv1->whead);
   remove_wait_queue(priv1->whead, &priv1->wait);
@@ -663,6 +676,10 @@ static int oo_epoll1_release(struct oo_epoll_private* priv)
 #if CI_CFG_EPOLL3
   if( priv1->home_stack )
     ci_netif_put_ready_list(&priv1->home_stack->netif, priv1->ready_list);
+  for( i = 0; i < OO_EPOLL1_SATELLITES_MAX; ++i )
+    if( priv1->satellites[i].thr != NULL )
+      ci_netif_put_ready_list(&priv1->satellites[i].thr->netif,
+                              priv1->satellites[i].ready_list);
 #endif
 
   oo_epoll_release_common(priv);
@@ -1132,6 +1149,60 @@ static long oo_epoll_fop_unlocked_ioctl(struct file* filp,
     rc = 0;
     break;
 
+  case OO_EPOLL1_IOC_ADD_SATELLITE: {
+    struct oo_epoll1_satellite_arg local_arg;
+    struct file *stack_file;
+    ci_private_t *stack_priv;
+
+    ci_assert_equal(_IOC_SIZE(cmd), sizeof(local_arg));
+    if( priv->type != OO_EPOLL_TYPE_1 )
+      return -EINVAL;
+    if( copy_from_user(&local_arg, argp, _IOC_SIZE(cmd)) )
+      return -EFAULT;
+    if( local_arg.slot < 0 || local_arg.slot >= OO_EPOLL1_SATELLITES_MAX ||
+        local_arg.ready_list < 0 ||
+        local_arg.ready_list >= CI_CFG_N_READY_LISTS ||
+        priv->p.p1.satellites[local_arg.slot].thr != NULL )
+      return -EINVAL;
+
+    stack_file = fget(local_arg.sockfd);
+    if( stack_file == NULL )
+      return -EINVAL;
+    if( stack_file->f_op != &oo_fops ) {
+      fput(stack_file);
+      return -EINVAL;
+    }
+    stack_priv = stack_file->private_data;
+
+    rc = 0;
+    if( oo_epoll_add_stack(priv, stack_priv->thr) ) {
+      priv->p.p1.satellites[local_arg.slot].ready_list = local_arg.ready_list;
+      priv->p.p1.satellites[local_arg.slot].thr = stack_priv->thr;
+    }
+    else {
+      rc = -ENOSPC;
+    }
+
+    fput(stack_file);
+    break;
+  }
+
+  case OO_EPOLL1_IOC_REMOVE_SATELLITE: {
+    ci_int32 slot;
+
+    if( priv->type != OO_EPOLL_TYPE_1 )
+      return -EINVAL;
+    if( copy_from_user(&slot, argp, sizeof(slot)) )
+      return -EFAULT;
+    if( slot < 0 || slot >= OO_EPOLL1_SATELLITES_MAX )
+      return -EINVAL;
+    /* UL gives the ready list back itself.  We keep the stack reference
+     * taken by oo_epoll_add_stack(), as for the home stack. */
+    priv->p.p1.satellites[slot].thr = NULL;
+    rc = 0;
+    break;
+  }
+
   case OO_EPOLL1_IOC_SPIN_ON: {
     struct oo_epoll1_spin_on_arg local_arg;
     struct file* other_filp;
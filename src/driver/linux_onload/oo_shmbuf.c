@@ -5,7 +5,8 @@
 #include <onload/oo_shmbuf.h>
 
 
-int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num)
+int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num,
+                    int contig)
 {
   int i;
 
@@ -13,6 +14,8 @@ int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num)
   sh->order = order;
   sh->num = init_num;
   sh->init_num = init_num;
+  sh->contig = contig;
+  sh->n_contig = 0;
   mutex_init(&sh->lock);
 
   sh->addrs = kzalloc(sizeof(sh->addrs[0]) * max, GFP_KERNEL);
@@ -31,6 +34,33 @@ int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num)
   return 0;
 }
 
+static void* oo_shmbuf_alloc_contig(struct oo_shmbuf* sh)
+{
+  /* Don't try hard: a chunk from vmalloc() is fine, just slower. */
+  struct page* page = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN |
+                                  __GFP_NORETRY, sh->order);
+  if( page == NULL )
+    return NULL;
+  /* Split into order-0 pages so that they can be mapped to UL one by one,
+   * just as vmalloc() pages are. */
+  split_page(page, sh->order);
+  return page_address(page);
+}
+
+
+static void oo_shmbuf_free_chunk(struct oo_shmbuf* sh, void* addr)
+{
+  int i;
+
+  if( is_vmalloc_addr(addr) ) {
+    vfree(addr);
+    return;
+  }
+  for( i = 0; i < 1 << sh->order; i++ )
+    __free_page(virt_to_page((char*)addr + ((unsigned long)i << PAGE_SHIFT)));
+}
+
+
 void oo_shmbuf_free(struct oo_shmbuf* sh)
 {
   int i;
@@ -39,7 +69,7 @@ void oo_shmbuf_free(struct oo_shmbuf* sh)
     vfree(sh->addrs[0]);
 
   for( i = sh->init_num; i < sh->num && sh->addrs[i] != 0; i++ )
-    vfree(sh->addrs[i]);
+    oo_shmbuf_free_chunk(sh, sh->addrs[i]);
 
   kfree(sh->addrs);
 }
@@ -58,7 +88,13 @@ int oo_shmbuf_add(struct oo_shmbuf* sh)
   i = sh->num;
   /* Fixme implement locking */
 
-  sh->addrs[i] = vmalloc_user(PAGE_SIZE << sh->order);
+  if( sh->contig ) {
+    sh->addrs[i] = oo_shmbuf_alloc_contig(sh);
+    if( sh->addrs[i] != NULL )
+      sh->n_contig++;
+  }
+  if( sh->addrs[i] == NULL )
+    sh->addrs[i] = vmalloc_user(PAGE_SIZE << sh->order);
   if( sh->addrs[i] == 0 ) {
     mutex_unlock(&sh->lock);
     return -ENOMEM;
@@ -87,11 +123,25 @@ int oo_shmbuf_fault(struct oo_shmbuf* sh, struct vm_area_struct* vma,
     i = 0;
     size *= sh->init_num;
   }
+  else if( ! is_vmalloc_addr(sh->addrs[i]) ) {
+    unsigned long j;
+    for( j = 0; j < size; j += PAGE_SIZE ) {
+      rc = vm_insert_page(vma, vma->vm_start + start_off + j,
+                          virt_to_page((char*)sh->addrs[i] + j));
+      if( rc < 0 )
+        return rc;
+    }
+    goto out;
+  }
 
   rc = oo_remap_vmalloc_range_partial(vma, vma->vm_start + start_off,
                                       (void*)sh->addrs[i], size);
-  if( rc >= 0 )
-    /* remap_vmalloc_range_partial sets this */
-    vm_flags_clear(vma, VM_DONTDUMP);
-  return rc;
+  if( rc < 0 )
+    return rc;
+
+ out:
+  /* remap_vmalloc_range_partial sets this.  Clear it whichever way the
+   * chunk was mapped, so that the whole buffer is in core dumps. */
+  vm_flags_clear(vma, VM_DONTDUMP);
+  return 0;
 }
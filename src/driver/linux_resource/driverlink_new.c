@@ -81,7 +81,9 @@ efrm_dl_event(struct efx_dl_device *efx_dev, void *p_event, int budget);
 static struct efx_dl_driver efrm_dl_driver = {
 	.name = "resource",
 	.priority = EFX_DL_EV_HIGH,
-	.flags = EFX_DL_DRIVER_CHECKS_MEDFORD2_VI_STRIDE,
+	.flags = EFX_DL_DRIVER_CHECKS_MEDFORD2_VI_STRIDE |
+		 EFX_DL_DRIVER_REQUIRES_MINOR_VER,
+	.minor_ver = EFX_DRIVERLINK_API_VERSION_MINOR,
 	.probe = efrm_dl_probe,
 	.remove = efrm_dl_remove,
 	.reset_suspend = efrm_dl_reset_suspend,
@@ -481,6 +483,10 @@ static void efrm_dl_remove(struct efx_dl_device *efrm_dev)
                 /* flush all outstanding dma queues */
                 efrm_nic_flush_all_queues(nic, 0);
 
+		/* Return pooled buffer table blocks while MCDI is still
+		 * available. */
+		efrm_bt_pool_flush(nic, 0);
+
 		lnic->drv_device = NULL;
                 lnic->efrm_nic.dl_dev_info = NULL;
 
@@ -2127,7 +2127,8 @@ int efrm_filter_insert(struct efrm_client *client,
 	/* FIXME: add IPv6 support to firewall rules (bug 85208) */
 	if ( (spec->match_flags & EFX_FILTER_MATCH_ETHER_TYPE) &&
 	     (spec->ether_type == htons(ETH_P_IPV6)) ) {
-		return efhw_nic_filter_insert( efhw_nic, spec, rxq, pd_excl_owner, mask, flags );
+		rc = efhw_nic_filter_insert( efhw_nic, spec, rxq, pd_excl_owner, mask, flags );
+		goto out;
 	}
 #endif
 
@@ -2148,6 +2149,14 @@ int efrm_filter_insert(struct efrm_client *client,
 	else {
 		rc = -ENODEV;
 	}
+
+#if CI_CFG_IPV6
+out:
+#endif
+	if ( rc >= 0 )
+		atomic_inc(&efhw_nic->filters_in_use);
+	else if ( rc == -EBUSY || rc == -ENOSPC )
+		atomic_inc(&efhw_nic->filter_insert_full);
 	return rc;
 }
 EXPORT_SYMBOL(efrm_filter_insert);
@@ -2157,6 +2166,7 @@ void efrm_filter_remove(struct efrm_client *client, int filter_id)
 {
 	struct efhw_nic *efhw_nic = efrm_client_get_nic(client);
 	efhw_nic_filter_remove(efhw_nic, filter_id);
+	atomic_dec(&efhw_nic->filters_in_use);
 }
 EXPORT_SYMBOL(efrm_filter_remove);
 
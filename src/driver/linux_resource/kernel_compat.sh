@@ -159,6 +159,13 @@ EFRM_NEED_DEBUGFS_LOOKUP_AND_REMOVE nsymbol debugfs_lookup_and_remove include/li
 
 EFRM_HAVE_WARN_FLUSHING_SYSTEMWIDE_WQ symbol __warn_flushing_systemwide_wq include/linux/workqueue.h
 
+EFRM_XSK_HAS_FQ_TMP	member	struct_xdp_sock	fq_tmp	include/net/xdp_sock.h
+
+EFRM_HAVE_IRQ_GET_AFFINITY_MASK symbol irq_get_affinity_mask include/linux/irq.h
+
+EFRM_HAVE_DMA_BUF_MAP_ATTACHMENT_UNLOCKED symbol dma_buf_map_attachment_unlocked include/linux/dma-buf.h
+EFRM_MODULE_IMPORT_NS_IS_IDENT	custom
+
 # TODO move onload-related stuff from net kernel_compat
 " | grep -E -v -e '^#' -e '^$' | sed 's/[ \t][ \t]*/:/g'
 }
@@ -200,6 +207,16 @@ int func(unsigned long v, volatile unsigned long *ptr)
 "
 }
 
+# Since 6.13 MODULE_IMPORT_NS() takes a string rather than an identifier.
+function do_EFRM_MODULE_IMPORT_NS_IS_IDENT
+{
+    test_compile "
+#include <linux/module.h>
+MODULE_LICENSE(\"GPL\");
+MODULE_IMPORT_NS(DMA_BUF);
+"
+}
+
 function do_EFRM_NEED_IS_COMPAT_TASK
 {
     defer_test_compile neg "
@@ -41,13 +41,19 @@
 #include <ci/efrm/debug.h>
 #include <ci/efrm/driver_private.h>
 #include <ci/efrm/kernel_proc.h>
+#include <ci/efrm/nic_table.h>
+#include <ci/efrm/resource_stats.h>
+#include <ci/efhw/nic.h>
+#include <ci/efhw/efct.h>
 #include <linux/proc_fs.h>
+#include <linux/netdevice.h>
 #include <ci/driver/kernel_compat.h>
 
 /** Top level directory for sfc specific stats **/
 static struct proc_dir_entry *efrm_proc_root = NULL;
 static struct proc_dir_entry *efrm_proc_nic_dir = NULL;
 static struct proc_dir_entry *efrm_proc_resources = NULL;
+static struct proc_dir_entry *efrm_proc_stats = NULL;
 
 /** Subdirectories (interfaces) **/
 struct efrm_procdir_s {
@@ -338,6 +344,7 @@ efrm_proc_dir_check_all_removed(struct proc_dir_entry* parent,
 
 
 static const struct proc_ops efrm_resource_fops_proc;
+static const struct proc_ops efrm_stats_fops_proc;
 
 int efrm_install_proc_entries(void)
 {
@@ -367,6 +374,13 @@ int efrm_install_proc_entries(void)
 			EFRM_WARN("%s: Unable to create /proc/drivers/"
 				  "sfc_resource/resources", __func__);
 		}
+
+		efrm_proc_stats = proc_create("stats", 0444, efrm_proc_root,
+					      &efrm_stats_fops_proc);
+		if ( !efrm_proc_stats ) {
+			EFRM_WARN("%s: Unable to create /proc/drivers/"
+				  "sfc_resource/stats", __func__);
+		}
 	}
 out:
 	mutex_unlock( &efrm_pd_mutex );
@@ -394,6 +408,9 @@ int efrm_uninstall_proc_entries(void)
 	if ( efrm_proc_resources )
 		remove_proc_entry("resources", efrm_proc_root);
 	efrm_proc_resources = NULL;
+	if ( efrm_proc_stats )
+		remove_proc_entry("stats", efrm_proc_root);
+	efrm_proc_stats = NULL;
 	if ( efrm_proc_nic_dir )
 		remove_proc_entry(EFRM_PROC_DEVICES_NAME, efrm_proc_root);
 	efrm_proc_nic_dir = NULL;
@@ -448,3 +465,139 @@ static const struct proc_ops efrm_resource_fops_proc = {
 	.proc_release	= single_release,
 };
 
+/****************************************************************************
+ *
+ * /proc/drivers/sfc/stats
+ *
+ * A binary equivalent of the resources file plus per-NIC state that is
+ * otherwise only in debugfs.  See ci/efrm/resource_stats.h for the layout.
+ *
+ ****************************************************************************/
+
+struct efrm_stats_snapshot {
+	size_t len;
+	char buf[];
+};
+
+static void efrm_stats_fill_efct(struct efrm_stats_nic *out,
+				 struct efhw_nic *nic)
+{
+	struct efhw_nic_efct *efct = nic->arch_extra;
+	uint32_t i;
+
+	if (nic->devtype.arch != EFHW_ARCH_EFCT || efct == NULL)
+		return;
+
+	/* As for debugfs, these are read without locking: the values are
+	 * only a snapshot. */
+	out->efct_rxq_n = efct->rxq_n;
+	for (i = 0; i < efct->rxq_n; ++i) {
+		uint32_t excl = efct->exclusive_rxq_mapping[i];
+		if (excl && excl != EFHW_PD_NON_EXC_TOKEN)
+			++out->efct_rxqs_exclusive;
+	}
+	out->efct_hw_filters_n = efct->hw_filters_n;
+	for (i = 0; i < efct->hw_filters_n; ++i)
+		if (efct->hw_filters[i].refcount > 0)
+			++out->efct_hw_filters_in_use;
+}
+
+static void efrm_stats_fill_nic(struct efrm_stats_nic *out,
+				struct efhw_nic *nic, int index)
+{
+	struct net_device *net_dev;
+
+	memset(out, 0, sizeof(*out));
+	out->index = index;
+	out->ifindex = -1;
+	net_dev = efhw_nic_get_net_dev(nic);
+	if (net_dev) {
+		out->ifindex = net_dev->ifindex;
+		strlcpy(out->ifname, net_dev->name, sizeof(out->ifname));
+		dev_put(net_dev);
+	}
+	out->arch = nic->devtype.arch;
+	out->resetting = nic->resetting;
+	out->flags = nic->flags;
+	out->filters_in_use = atomic_read(&nic->filters_in_use);
+	out->filter_insert_full = atomic_read(&nic->filter_insert_full);
+	efrm_stats_fill_efct(out, nic);
+}
+
+static struct efrm_stats_snapshot *efrm_stats_snapshot(void)
+{
+	struct efrm_stats_snapshot *snap;
+	struct efrm_stats_header *hdr;
+	struct efrm_stats_resource *res;
+	struct efrm_stats_nic *nics;
+	struct efrm_resource_manager *rm;
+	struct efhw_nic *nic;
+	int type, nic_i;
+
+	/* Size for every possible NIC, rather than counting them first and
+	 * racing with hotplug; the buffer is small. */
+	snap = kzalloc(sizeof(*snap) + sizeof(*hdr) +
+		       EFRM_RESOURCE_NUM * sizeof(*res) +
+		       EFHW_MAX_NR_DEVS * sizeof(*nics), GFP_KERNEL);
+	if (snap == NULL)
+		return NULL;
+
+	hdr = (void *) snap->buf;
+	res = (void *) (hdr + 1);
+	hdr->magic = EFRM_STATS_MAGIC;
+	hdr->version = EFRM_STATS_VERSION;
+	hdr->header_len = sizeof(*hdr);
+	hdr->resource_len = sizeof(*res);
+	hdr->nic_len = sizeof(*nics);
+
+	for (type = 0; type < EFRM_RESOURCE_NUM; type++) {
+		rm = efrm_rm_table[type];
+		if (rm == NULL)
+			continue;
+		spin_lock_bh(&rm->rm_lock);
+		res->type = type;
+		res->total = rm->rm_resources_total;
+		res->in_use = rm->rm_resources;
+		res->hiwat = rm->rm_resources_hiwat;
+		spin_unlock_bh(&rm->rm_lock);
+		++res;
+		++hdr->n_resources;
+	}
+
+	nics = (void *) res;
+	EFRM_FOR_EACH_NIC(nic_i, nic)
+		efrm_stats_fill_nic(&nics[hdr->n_nics++], nic, nic_i);
+
+	snap->len = (char *) &nics[hdr->n_nics] - snap->buf;
+	return snap;
+}
+
+static ssize_t efrm_stats_read_proc(struct file *file, char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	struct efrm_stats_snapshot *snap = file->private_data;
+
+	/* Take a fresh snapshot each time the file is read from the start. */
+	if (*ppos == 0 || snap == NULL) {
+		struct efrm_stats_snapshot *new_snap = efrm_stats_snapshot();
+		if (new_snap == NULL)
+			return -ENOMEM;
+		kfree(snap);
+		file->private_data = snap = new_snap;
+	}
+	return simple_read_from_buffer(ubuf, count, ppos, snap->buf,
+				       snap->len);
+}
+
+static int efrm_stats_release_proc(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct proc_ops efrm_stats_fops_proc = {
+	PROC_OPS_SET_OWNER
+	.proc_read		= efrm_stats_read_proc,
+	.proc_lseek		= default_llseek,
+	.proc_release	= efrm_stats_release_proc,
+};
@@ -96,6 +96,17 @@ int efrm_is_pio_enabled(void)
   { return pio; }
 EXPORT_SYMBOL(efrm_is_pio_enabled);
 
+static int bt_pool_max_blocks = 512;
+module_param(bt_pool_max_blocks, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(bt_pool_max_blocks,
+		 "Maximum number of freed buffer table blocks to keep "
+		 "allocated on each NIC for reuse, which saves MCDI when "
+		 "creating Onload stacks and growing their packet sets.  "
+		 "Each block has 32 entries.  Set to 0 to return blocks to "
+		 "the NIC as soon as they are freed.");
+int efrm_bt_pool_max_blocks(void)
+  { return bt_pool_max_blocks; }
+
 static int enable_accel_by_default = 1;
 module_param(enable_accel_by_default, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(enable_accel_by_default,
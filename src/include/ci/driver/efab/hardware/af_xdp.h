@@ -15,6 +15,7 @@ struct efab_af_xdp_offsets_ring
   int64_t producer;
   int64_t consumer;
   int64_t desc;
+  int64_t flags;    /* negative if the kernel doesn't support need_wakeup */
 };
 
 struct efab_af_xdp_offsets_rings
@@ -25,10 +26,14 @@ struct efab_af_xdp_offsets_rings
   struct efab_af_xdp_offsets_ring cr;
 };
 
+/* Bits in efab_af_xdp_offsets::features */
+#define EFAB_AF_XDP_FEATURE_SG  0x1   /* frames may span several buffers */
+
 struct efab_af_xdp_offsets
 {
   int64_t mmap_bytes;
   struct efab_af_xdp_offsets_rings rings;
+  uint64_t features;
 };
 
 #endif
@@ -69,5 +69,6 @@ struct linux_efhw_nic {
   container_of(_efhw_nic, struct linux_efhw_nic, efrm_nic.efhw_nic)
 
 int efrm_is_pio_enabled(void);
+int efrm_bt_pool_max_blocks(void);
 
 #endif /* __CI_DRIVER_RESOURCE_LINUX_RESOURCE__ */
@@ -101,8 +101,14 @@ struct efch_memreg_alloc {
   uint64_t            in_mem_bytes;
   uint64_t            in_addrs_out_ptr;
   uint64_t            in_addrs_out_stride;
+  uint32_t            in_flags;
+  int32_t             in_dmabuf_fd;       /* if EFCH_MEMREG_FLAG_DMABUF */
 };
 
+/* Register part of the dma-buf [in_dmabuf_fd]: [in_mem_ptr] is then the
+ * offset within it rather than a user address. */
+#define EFCH_MEMREG_FLAG_DMABUF       0x1
+
 
 struct efch_pio_alloc {
   int32_t             in_pd_fd;
@@ -134,6 +140,19 @@ struct efch_ext_alloc {
 };
 
 
+/* One entry in the array passed to CI_RSOP_EXT_MSG_BATCH.  rc is written
+ * back with the result of the message. */
+struct efch_ext_msg {
+  uint64_t            payload_ptr;
+  uint64_t            payload_len;
+  uint32_t            msg_id;
+  int32_t             rc;
+};
+
+/* Limit on the number of messages in one CI_RSOP_EXT_MSG_BATCH */
+#define EFCH_EXT_MSG_BATCH_MAX  64
+
+
 struct efch_efct_rxq_alloc {
   efch_resource_id_t  in_vi_rs_id;
   uint32_t            in_flags;  /* none currently defined */
@@ -216,6 +235,8 @@ typedef struct ci_resource_op_s {
 # define                CI_RSOP_RXQ_REFRESH             0x8B
 # define                CI_RSOP_FILTER_QUERY            0x8C
 # define                CI_RSOP_VI_DESIGN_PARAMETERS    0x8D
+# define                CI_RSOP_VI_SET_RSS_SPREAD       0x8E
+# define                CI_RSOP_EXT_MSG_BATCH           0x8F
 
   union {
     struct {
@@ -327,6 +348,11 @@ typedef struct ci_resource_op_s {
       uint64_t          payload_len;
       uint32_t          flags;
     } ext_msg;
+    struct {
+      uint64_t          msgs_ptr;  /* struct efch_ext_msg[n_msgs] */
+      uint32_t          n_msgs;
+      uint32_t          flags;
+    } ext_msg_batch;
     struct {
       uint64_t          superbufs;
       uint64_t          current_mappings;
@@ -336,6 +362,9 @@ typedef struct ci_resource_op_s {
       uint64_t          data_ptr; /* struct efab_nic_design_parameters */
       uint64_t          data_len;
     } design_parameters;
+    struct {
+      uint32_t          n_active;
+    } vi_set_rss_spread;
   } u CI_ALIGN(8);
 } ci_resource_op_t;
 
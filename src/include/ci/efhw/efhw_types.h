@@ -608,6 +608,11 @@ struct efhw_nic {
         /* TX datapath firmware variant */
         uint16_t tx_variant;
 
+	/* Filters inserted by efrm_filter_insert() and not yet removed */
+	atomic_t filters_in_use;
+	/* Inserts that failed because the filter table was full */
+	atomic_t filter_insert_full;
+
 	struct dentry *debug_dir;
 	struct dentry *rs_debug_dirs[EFRM_RESOURCE_NUM];
 
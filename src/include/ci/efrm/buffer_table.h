@@ -98,4 +98,23 @@ struct efrm_bt_manager {
 	atomic_t btm_entries;
 };
 
+/* Per-NIC pool of buffer table blocks which are no longer in use but are
+ * still allocated on the NIC, for reuse by later allocations with the same
+ * owner and order.  See bt_manager.c. */
+#define EFRM_BT_POOL_ORDERS_MAX 4
+struct efrm_bt_pool {
+	/* Lists of blocks linked through btb_next, indexed by owner id and
+	 * then by index into the NIC's buffer table orders.  NULL if the NIC
+	 * does not pool blocks. */
+	struct efhw_buffer_table_block *(*btp_heads)[EFRM_BT_POOL_ORDERS_MAX];
+	int btp_n_owners;
+
+	/* Number of blocks in all the lists */
+	int btp_n_blocks;
+
+	/* Protects the lists.  As with btm_lock, no efhw operations are done
+	 * while holding it. */
+	spinlock_t btp_lock;
+};
+
 #endif /* __CI_EFRM_BUFFER_TABLE_H__ */
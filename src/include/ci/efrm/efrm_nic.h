@@ -5,6 +5,7 @@
 
 #include <ci/efhw/efhw_types.h>
 #include <ci/efrm/buddy.h>
+#include <ci/efrm/buffer_table.h>
 
 
 struct efrm_nic_per_vi {
@@ -51,6 +52,7 @@ struct efrm_nic {
 	struct efrm_nic_per_vi *vis;
         int max_vis;
 	struct efrm_nic_vi      nvi;
+	struct efrm_bt_pool bt_pool;
 	struct efrm_buddy_allocator vi_allocator;
 	unsigned rss_channel_count;
 	const struct efx_dl_device_info *dl_dev_info;
@@ -199,6 +199,27 @@ extern void efrm_pd_dma_unmap(struct efrm_pd *, int n_pages, int nic_order,
 			      dma_addr_t *free_addrs,
 			      struct efrm_bt_collection *, int reset_pending);
 
+/* Map areas that the caller has already DMA-mapped for the NIC's device,
+ * such as the pages of a dma-buf, to hardware.  Only supported for NICs
+ * with a buffer table.
+ * In: pd, n_pages, nic_order, free_addrs (the device's DMA addresses).
+ * Out: dma_addrs, user_addrs. */
+extern int efrm_pd_dma_map_premapped(struct efrm_pd *, int n_pages,
+				     int nic_order, dma_addr_t *dma_addrs,
+				     dma_addr_t *free_addrs,
+				     uint64_t *user_addrs,
+				     int user_addrs_stride,
+				     void (*user_addr_put)(uint64_t,
+							   uint64_t *),
+				     struct efrm_bt_collection *,
+				     int reset_pending);
+
+/* Unmap areas mapped by efrm_pd_dma_map_premapped().  The caller remains
+ * responsible for the device's DMA mapping. */
+extern void efrm_pd_dma_unmap_premapped(struct efrm_pd *,
+					struct efrm_bt_collection *,
+					int reset_pending);
+
 /* Re-map pages already mapped by efrm_pd_dma_map() after NIC reset.
  * In: pd, n_pages, nic_order, pages, dma_addrs.
  *     dma_addrs should be the same as returned by efrm_pd_dma_map().
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2026 Advanced Micro Devices, Inc. */
+/*
+ * Layout of /proc/driver/sfc_resource/stats.
+ *
+ * The file is a binary snapshot, regenerated each time it is read from
+ * offset zero, so a scraper can keep it open and pread() it periodically.
+ * It holds a header followed by [n_resources] resource records and then
+ * [n_nics] NIC records.  Readers must use the record sizes in the header
+ * to step over the records, so that fields can be appended to them
+ * without changing the version.
+ */
+
+#ifndef __CI_EFRM_RESOURCE_STATS_H__
+#define __CI_EFRM_RESOURCE_STATS_H__
+
+#include <ci/compat.h>
+
+#define EFRM_STATS_MAGIC    0x53524645u  /* "EFRS" */
+#define EFRM_STATS_VERSION  1
+
+struct efrm_stats_header {
+  ci_uint32 magic;
+  ci_uint32 version;
+  ci_uint32 header_len;
+  ci_uint32 resource_len;
+  ci_uint32 n_resources;
+  ci_uint32 nic_len;
+  ci_uint32 n_nics;
+  ci_uint32 reserved;
+};
+
+/* One per efrm resource type, as in /proc/driver/sfc_resource/resources. */
+struct efrm_stats_resource {
+  ci_uint32 type;            /* EFRM_RESOURCE_* */
+  ci_uint32 total;           /* ~0u if unlimited */
+  ci_uint32 in_use;
+  ci_uint32 hiwat;
+};
+
+/* One per NIC registered with efrm. */
+struct efrm_stats_nic {
+  ci_uint32 index;           /* index in the efrm NIC table */
+  ci_int32  ifindex;
+  char      ifname[16];
+  ci_uint32 arch;            /* EFHW_ARCH_* */
+  ci_uint32 resetting;
+  ci_uint64 flags;           /* NIC_FLAG_* */
+  ci_uint32 filters_in_use;
+  ci_uint32 filter_insert_full;
+  /* EFCT only; zero for other architectures. */
+  ci_uint32 efct_rxq_n;
+  ci_uint32 efct_rxqs_exclusive;
+  ci_uint32 efct_hw_filters_n;
+  ci_uint32 efct_hw_filters_in_use;
+};
+
+#endif /* __CI_EFRM_RESOURCE_STATS_H__ */
@@ -290,6 +290,10 @@ extern int efrm_vi_set_get_vi_instance(struct efrm_vi *);
 
 extern int efrm_vi_af_xdp_kick(struct efrm_vi *vi);
 
+/*! Steer the interrupt of an interrupting VI to the given CPU.  Returns
+ * -EOPNOTSUPP if the VI does not own an interrupt vector. */
+extern int efrm_vi_irq_set_affinity(struct efrm_vi *vi, int cpu);
+
 extern int
 efrm_interrupt_vectors_ctor(struct efrm_nic *nic,
 			    const struct vi_resource_dimensions *res_dim);
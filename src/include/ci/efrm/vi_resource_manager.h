@@ -105,6 +105,14 @@ struct efrm_vi_q {
  * interrupt when necessary or advantageous.
  *     Note that on architectures that use wakeups (notably EF10), interrupts
  * are managed by the net driver, and the structre below does not apply. */
+/* Locality of an interrupt vector relative to a CPU, best first. */
+enum {
+	EFRM_IRQ_LOCALITY_CORE,   /* affined to the CPU, within its node */
+	EFRM_IRQ_LOCALITY_NODE,   /* affined to some CPU on the CPU's node */
+	EFRM_IRQ_LOCALITY_REMOTE, /* affined only to other nodes */
+	EFRM_IRQ_LOCALITY_MAX,
+};
+
 struct efrm_interrupt_vector {
 	/* Link into efrm_nic::irq_list.  Protected by efrm_nic::lock. */
 	struct list_head link;
@@ -187,6 +195,9 @@ struct efrm_vi {
 
 	int net_drv_wakeup_channel;
 	struct efrm_interrupt_vector *vec;
+	/* How close vec's interrupt affinity was to the CPU the VI asked for
+	 * when vec was chosen: one of EFRM_IRQ_LOCALITY_*. */
+	int irq_locality;
 	struct list_head irq_link;
 
 	/* A memory mapping onto the IO page for this VI mapped into the
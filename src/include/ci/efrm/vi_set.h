@@ -64,6 +64,31 @@ efrm_vi_set_get_base(struct efrm_vi_set *);
 extern int
 efrm_vi_set_get_rss_context(struct efrm_vi_set *, unsigned rss_id);
 
+/* Size of the indirection table of the set's own RSS context for [rss_id],
+ * or 0 if the set uses the net driver's context. */
+extern int
+efrm_vi_set_rss_table_size(struct efrm_vi_set *, unsigned rss_id);
+
+extern const u8 *
+efrm_vi_set_rss_key(struct efrm_vi_set *, unsigned rss_id);
+
+/* Returns the index within the set of the VI that [bucket] of the
+ * indirection table spreads to. */
+extern int
+efrm_vi_set_rss_bucket_get(struct efrm_vi_set *, unsigned rss_id,
+			   int bucket);
+
+/* Reprograms [bucket] of the indirection table to spread to the VI with
+ * index [instance] within the set. */
+extern int
+efrm_vi_set_rss_bucket_move(struct efrm_vi_set *, unsigned rss_id,
+			    int bucket, int instance);
+
+/* Reprograms the whole indirection table to stripe evenly across the
+ * first [n_active] VIs of the set, leaving the rest idle. */
+extern int
+efrm_vi_set_rss_spread(struct efrm_vi_set *, unsigned rss_id, int n_active);
+
 extern struct efrm_resource *
 efrm_vi_set_to_resource(struct efrm_vi_set *);
 
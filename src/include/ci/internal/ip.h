@@ -30,6 +30,7 @@
 #include <ci/net/ethernet.h>
 #include <ci/internal/ip_shared_types.h>
 #include <ci/internal/ip_log.h>
+#include <ci/internal/ip_probes.h>
 
 #include <ci/tools.h>
 #include <ci/tools/istack.h>
@@ -402,6 +403,7 @@ typedef struct {
   /* [flags] can take any of the following values, or any of the tcp
   ** options flags (e.g. CI_TCPT_FLAG_*). */
 #define CI_TCP_PAWS_FAILED       0x80000000
+#define CI_TCP_FASTOPEN          0x40000000 /* SYN options include TFO */
 #define CI_TCP_SACKED            0x20000000 /* Something is newly SACKed */
 #define CI_TCP_DSACK             0x10000000 /* First SACK block is duplicate */
 
@@ -412,6 +414,10 @@ typedef struct {
   ci_int32      sack_blocks;
   ci_uint32     ack,seq;         /* ACK and SEQ values in host endian */
   ci_uint32     hash;            /* hash for l/r addr/port */
+  /* TCP Fast Open cookie, valid with CI_TCP_FASTOPEN; length 0 is a
+   * request for a cookie. */
+  ci_uint8      fastopen_len;
+  ci_uint8      fastopen_cookie[CI_TCP_FASTOPEN_COOKIE_MAX];
 } ciip_tcp_rx_pkt;
 
 
@@ -482,7 +488,9 @@ extern int  ci_netif_poll_intf_future(ci_netif*, int intf_i, ci_uint64 now_frc)
 #endif
 extern int  ci_netif_poll_n(ci_netif*, int max_evs) CI_HF;
 #define     ci_netif_poll(ni)  ci_netif_poll_n((ni), NI_OPTS(ni).evs_per_poll)
+extern void ci_netif_tx_coalesce_end(ci_netif*) CI_HF;
 extern void ci_netif_loopback_pkts_send(ci_netif* ni) CI_HF;
+extern void ci_netif_loopback_poll(ci_netif* ni) CI_HF;
 
 #if CI_CFG_WANT_BPF_NATIVE
 #ifdef __KERNEL__
@@ -534,6 +542,11 @@ extern void ci_netif_timeout_restart(ci_netif *ni, ci_tcp_state *ts) CI_HF;
 
 extern void ci_netif_timewait_enter(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 extern int  ci_netif_timewait_try_to_free_filter(ci_netif* ni) CI_HF;
+extern void ci_netif_timewait_compact(ci_netif* ni) CI_HF;
+extern ci_tcp_tw_compact_t*
+ci_tcp_tw_compact_lookup(ci_netif* ni, ci_uint32 laddr_be32,
+                         ci_uint16 lport_be16, ci_uint32 raddr_be32,
+                         ci_uint16 rport_be16) CI_HF;
 extern void ci_netif_fin_timeout_enter(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
 extern void ci_netif_dump(ci_netif* ni) CI_HF;
@@ -595,7 +608,8 @@ CI_DEBUG(extern void ci_netif_verify_freepkts(ci_netif *, const char *, int);)
   ci_assert((addr) + (size) <= (ni)->state->netif_mmap_bytes);  \
   }while(0)
 
-ci_inline int ci_netif_num_vis(ci_netif* ni)
+/* Number of VIs per interface on which packets are received. */
+ci_inline int ci_netif_num_rx_vis(ci_netif* ni)
 {
 #if CI_CFG_TCP_OFFLOAD_RECYCLER || CI_CFG_TX_CRC_OFFLOAD
   switch( NI_OPTS(ni).tcp_offload_plugin ) {
@@ -608,6 +622,29 @@ ci_inline int ci_netif_num_vis(ci_netif* ni)
   return 1;
 }
 
+/* Number of VIs per interface over which ordinary transmit traffic is
+ * spread.  See EF_TX_VIS.  The extra VIs share the event queue of the
+ * first one, and receive nothing.
+ */
+ci_inline int ci_netif_num_tx_vis(ci_netif* ni)
+{
+#if CI_CFG_TCP_OFFLOAD_RECYCLER || CI_CFG_TX_CRC_OFFLOAD
+  /* The plugins give their own meanings to the extra VIs. */
+  if( NI_OPTS(ni).tcp_offload_plugin != CITP_TCP_OFFLOAD_OFF )
+    return 1;
+#endif
+#if CI_CFG_TX_VIS_MAX > 1
+  return NI_OPTS(ni).tx_vis;
+#else
+  return 1;
+#endif
+}
+
+ci_inline int ci_netif_num_vis(ci_netif* ni)
+{
+  return CI_MAX(ci_netif_num_rx_vis(ni), ci_netif_num_tx_vis(ni));
+}
+
 /*********************************************************************
 ************************* Packet buffer mgmt *************************
 *********************************************************************/
@@ -662,6 +699,9 @@ ci_inline int ci_netif_num_vis(ci_netif* ni)
 
 
 extern int ci_netif_pktset_best(ci_netif* ni) CI_HF;
+extern int ci_netif_pktset_best_node(ci_netif* ni, int node,
+                                     int min_free) CI_HF;
+extern int ci_netif_numa_node_here(void) CI_HF;
 extern void ci_netif_pkt_free(ci_netif* ni, ci_ip_pkt_fmt* pkt
                               CI_KERNEL_ARG(int* p_netif_is_locked)) CI_HF;
 
@@ -684,6 +724,11 @@ ci_inline ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif *ni, int flags)
 extern int ci_netif_pkt_try_to_free(ci_netif* ni, int desperation,
                                     int stop_once_freed_n) CI_HF;
 extern void ci_netif_try_to_reap(ci_netif* ni, int stop_once_freed_n) CI_HF;
+extern void ci_netif_idle_reclaim(ci_netif* ni) CI_HF;
+#if CI_CFG_IP_REASM
+extern int ci_ip_reasm_rx(ci_netif* ni, ci_ip_pkt_fmt** p_pkt) CI_HF;
+extern void ci_ip_reasm_timeout(ci_netif* ni) CI_HF;
+#endif
 extern void ci_netif_rxq_low_on_recv(ci_netif*, ci_sock_cmn*,
                                      int bytes_freed) CI_HF;
 
@@ -796,6 +841,34 @@ ci_inline ci_int32 ci_get_so_error(ci_sock_cmn *s)
 #define SOCK_TX_ERRNO(s)        ((s)->tx_errno)
 #define SOCK_RX_ERRNO(s)        ((s)->rx_errno & 0x3fff)
 
+/**********************************************************************
+ ***************************** MSG_ZEROCOPY ***************************
+ **********************************************************************/
+
+/* These could be missing from older headers. */
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+/* Is there a MSG_ZEROCOPY notification to read from the error queue? */
+ci_inline bool ci_sock_zc_pending(const ci_sock_cmn* s)
+{
+  return OO_ACCESS_ONCE(s->zc_id_next) != s->zc_id_unreported;
+}
+
+#ifndef __KERNEL__
+extern void ci_sock_zc_copied(ci_netif*, ci_sock_cmn*, unsigned n) CI_HF;
+#endif
+
 /**********************************************************************
  **************************** ICMP/Errors *****************************
  **********************************************************************/
@@ -823,6 +896,10 @@ extern int __ci_icmp_send_error(ci_netif* ni, int af, ci_ipx_hdr_t* ipx,
 #define CI_UDP_MAX_PAYLOAD_BYTES(af) \
   (0xffff - sizeof(ci_udp_hdr) - (IS_AF_INET6(af) ? 0 : sizeof(ci_ip4_hdr)))
 
+/* Maximum number of datagrams a UDP_SEGMENT send is split into, as
+ * UDP_MAX_SEGMENTS in Linux. */
+#define CI_UDP_GSO_MAX_SEGS  64
+
 #define UDP_FLAGS(us)           ((us)->udpflags)
 
 #define UDP_SET_FLAG(us,f)      ((us)->udpflags|=(f))
@@ -936,7 +1013,8 @@ struct cmsg_state {
 extern void ci_put_cmsg(struct cmsg_state *cmsg_state, int level, int type,
                         socklen_t len, const void *data) CI_HF;
 /* info_out contains a pointer to struct in_pktinfo or struct in6_pktinfo */
-extern int ci_ip_cmsg_send(const struct msghdr*, void** info_out) CI_HF;
+extern int ci_ip_cmsg_send(const struct msghdr*, void** info_out,
+                           ci_uint16* gso_size_out) CI_HF;
 extern void ci_ip_cmsg_finish(struct cmsg_state* cmsg_state) CI_HF;
 
 #ifndef __KERNEL__
@@ -1005,12 +1083,24 @@ extern int ci_udp_recvmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
                            unsigned int vlen, int flags, 
                            const struct timespec* timeout
                            CI_KERNEL_ARG(ci_addr_spc_t addr_spc)) CI_HF;
+extern int ci_udp_sendmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
+                           unsigned int vlen, int flags) CI_HF;
 
 struct onload_zc_mmsg;
 extern int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, 
                           struct onload_zc_mmsg* msgs, int flags);
+struct onload_zc_iovec;
+/* Turn a buffer received with ONLOAD_ZC_KEEP into one that can be passed
+ * to ci_tcp_zc_send() on [ts] with its payload left where it is.  Returns
+ * false, leaving the buffer untouched, if the receive queue still holds
+ * it or its payload does not fit in a segment of [ts]. */
+extern int ci_tcp_zc_adopt_rx_pkt(ci_netif* ni, ci_tcp_state* ts,
+                                  ci_ip_pkt_fmt* pkt,
+                                  const struct onload_zc_iovec* iov) CI_HF;
 struct onload_zc_recv_args;
 int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args);
+int ci_udp_zc_recv_ready(ci_udp_iomsg_args* a,
+                         struct onload_zc_recv_args* args);
 
 /* A special version of recvmsg to grab data from kernel stack when
  * doing zero-copy 
@@ -1033,7 +1123,7 @@ ci_netif_raw_send(ci_netif* ni, int intf_i,
 
 extern void ci_ip_cmsg_recv(ci_netif*, ci_udp_state*, const ci_ip_pkt_fmt*,
                             struct msghdr*, int netif_locked,
-                            int *p_msg_flags) CI_HF;
+                            int *p_msg_flags, int gro_size) CI_HF;
 #if OO_DO_STACK_POLL
 extern void ci_udp_all_fds_gone(ci_netif* netif, oo_sp, int do_free);
 #endif
@@ -1511,6 +1601,17 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
                      ciip_tcp_rx_pkt* rxp,
                      ci_tcp_state_synrecv **tsr_p);
 
+extern void ci_tcp_fastopen_cookie(ci_netif* netif, ci_uint32 l_addr,
+                                   ci_uint32 r_addr, ci_uint8* cookie);
+extern int ci_tcp_fastopen_cookie_ok(ci_netif* netif, ci_uint32 l_addr,
+                                     ci_uint32 r_addr,
+                                     const ciip_tcp_rx_pkt* rxp);
+extern const ci_tcp_fastopen_cache_entry*
+ci_tcp_fastopen_cache_lookup(ci_netif* netif, ci_uint32 raddr_be32);
+extern void ci_tcp_fastopen_cache_update(ci_netif* netif,
+                                         ci_uint32 raddr_be32, ci_uint16 mss,
+                                         const ci_uint8* cookie, int len);
+
 extern void ci_tcp_set_sndbuf(ci_netif* ni, ci_tcp_state* ts);
 extern void ci_tcp_set_sndbuf_from_sndbuf_pkts(ci_netif* ni, ci_tcp_state* ts);
 
@@ -1659,6 +1760,12 @@ extern void ci_tcp_rx_plugin_meta(ci_netif*, struct ci_netif_poll_state*,
 extern void ci_tcp_tx_change_mss(ci_netif*, ci_tcp_state*, bool may_send) CI_HF;
 extern void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
                                    ci_ip_pkt_fmt* pkt) CI_HF;
+#ifndef __KERNEL__
+extern int ci_tcp_enqueue_syn_fastopen(ci_tcp_state* ts, ci_netif* netif,
+                                       ci_ip_pkt_fmt* pkt,
+                                       const ci_uint8* cookie, int len,
+                                       ci_iovec_ptr* piov) CI_HF;
+#endif
 extern int ci_tcp_send_sim_synack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
                                ci_tcp_state_synrecv* tsr, 
@@ -1676,12 +1783,55 @@ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
 extern void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
+/* Congestion control modules.  The built-in onload-reno module is
+ * open-coded in tcp_rx.c; the others are dispatched via tcp_cong.c. */
+extern int ci_tcp_cong_alg_lookup(const char* name, int len) CI_HF;
+extern const char* ci_tcp_cong_alg_name(unsigned alg) CI_HF;
+extern void ci_tcp_cong_init(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_release(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_on_ack(ci_netif* ni, ci_tcp_state* ts,
+                               unsigned acked) CI_HF;
+extern unsigned ci_tcp_cong_ssthresh_slow(ci_netif* ni,
+                                          ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_pacing_update(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_pacing_tx_advance(ci_netif* ni, ci_tcp_state* ts,
+                                     unsigned right_edge,
+                                     ci_uint32* p_stop_cntr) CI_HF;
+extern void ci_tcp_timeout_pace(ci_netif* ni, ci_tcp_cong_state* cong) CI_HF;
+
 extern void ci_tcp_clear_sacks(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_retrans_init_ptrs(ci_netif* ni, ci_tcp_state* ts,
                                      unsigned* recover_seq_out) CI_HF;
 extern void ci_tcp_get_fack(ci_netif* ni, ci_tcp_state* ts,
                             unsigned* fack_out, int* retrans_data_out) CI_HF;
 
+/* Returns the last packet of the SACKed block containing [pkt].
+ *
+ * [block_end] is kept up to date only in the first packet of each block
+ * and in the head of the retransmit queue.  When a block grows, packets
+ * already in it keep pointing to their old end, which is still inside the
+ * block.  So we follow on from there block-end to block-end until we reach
+ * an unSACKed packet, then save the result in [pkt].  Blocks are maximal
+ * runs of SACKed packets, so the next packet after the true end is never
+ * SACKed.
+ */
+ci_inline ci_ip_pkt_fmt* ci_tcp_sacked_block_end(ci_netif* ni,
+                                                 ci_ip_pkt_fmt* pkt)
+{
+  ci_ip_pkt_fmt* end = PKT_CHK(ni, pkt->pf.tcp_tx.block_end);
+  ci_ip_pkt_fmt* next;
+
+  ci_assert(pkt->flags & CI_PKT_FLAG_RTQ_SACKED);
+  while( OO_PP_NOT_NULL(end->next) ) {
+    next = PKT_CHK(ni, end->next);
+    if( ! (next->flags & CI_PKT_FLAG_RTQ_SACKED) )
+      break;
+    end = PKT_CHK(ni, next->pf.tcp_tx.block_end);
+  }
+  pkt->pf.tcp_tx.block_end = OO_PKT_P(end);
+  return end;
+}
+
 
 extern void ci_tcp_retrans_coalesce_block(ci_netif* ni, ci_tcp_state* ts,
                                           ci_ip_pkt_fmt* pkt) CI_HF;
@@ -1705,6 +1855,11 @@ extern void ci_tcp_send_rst(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void
 ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
                       ciip_tcp_rx_pkt* rxp) CI_HF;
+extern void
+ci_tcp_reply_from_tw_compact(ci_netif* netif,
+                             const struct oo_sock_cplane* sock_cp,
+                             ciip_tcp_rx_pkt* rxp,
+                             const ci_tcp_tw_compact_t* tw) CI_HF;
 extern int ci_tcp_reset_untrusted(ci_netif *netif, ci_tcp_state *ts) CI_HF;
 extern void ci_tcp_send_zwin_probe(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_set_established_state(ci_netif*, ci_tcp_state*) CI_HF;
@@ -1763,6 +1918,13 @@ ci_netif_filter_lookup(ci_netif* netif, int af_space,
                            ci_addr_t raddr, unsigned rport,
                            unsigned protocol);
 
+extern unsigned
+ci_netif_filter_prefetch_entry(ci_netif* netif, unsigned laddr, unsigned lport,
+                               unsigned raddr, unsigned rport,
+                               unsigned protocol) CI_HF;
+extern void ci_netif_filter_prefetch_sock(ci_netif* netif,
+                                          unsigned tbl_i) CI_HF;
+
 /* Returns socket index, or OO_SP_NULL if lookup failed. */
 extern oo_sp
 ci_netif_listener_lookup(ci_netif* netif, int af_space,
@@ -1907,6 +2069,7 @@ extern void ci_tcp_timeout_zwin(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_delack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_cork(ci_netif* netif, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_timeout_rack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_recycle(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_send_corked_packets(ci_netif* netif, ci_tcp_state* ts) CI_HF;
@@ -1959,6 +2122,7 @@ extern int ci_tcp_ioctl(citp_socket* ep, ci_fd_t fd, int request, void* arg) CI_
 
 struct oo_msg_template;
 struct onload_template_msg_update_iovec;
+struct onload_template_msg_update_batch;
 
 extern int ci_tcp_tmpl_alloc(ci_netif* ni, ci_tcp_state* ts,
                              struct oo_msg_template** omt_pp,
@@ -1969,6 +2133,12 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
                    struct oo_msg_template* omt,
                    const struct onload_template_msg_update_iovec* updates,
                    int ulen, unsigned flags) CI_HF;
+/* Largest number of templates ci_tcp_tmpl_update_batch() takes at once. */
+#define CI_TCP_TMPL_BATCH_MAX  64
+extern void
+ci_tcp_tmpl_update_batch(ci_netif* ni, ci_tcp_state** tss,
+                         struct onload_template_msg_update_batch* batch,
+                         int n, unsigned flags) CI_HF;
 extern int ci_tcp_tmpl_abort(ci_netif* ni, ci_tcp_state* ts,
                              struct oo_msg_template* omt) CI_HF;
 
@@ -2012,7 +2182,20 @@ extern int  ci_netif_lock_or_defer_work(ci_netif*, citp_waitable*) CI_HF;
 #ifndef __KERNEL__
 extern int ci_tcp_connect(citp_socket*, const struct sockaddr*, socklen_t,
                           ci_fd_t fd, int *p_moved) CI_HF;
+extern int ci_tcp_connect_fastopen(citp_socket*, const struct sockaddr*,
+                                   socklen_t, ci_fd_t fd,
+                                   const ci_iovec* iov, int iovlen) CI_HF;
 extern int ci_tcp_shutdown(citp_socket*, int how, ci_fd_t fd) CI_HF;
+
+struct ci_tcp_connect_batch_req {
+  citp_socket            ep;
+  ci_fd_t                fd;
+  const struct sockaddr* addr;
+  socklen_t              addrlen;
+  int                    rc;
+};
+extern void ci_tcp_connect_batch(ci_netif*, struct ci_tcp_connect_batch_req*,
+                                 int n_reqs) CI_HF;
 #endif
 
 extern oo_sp ci_tcp_connect_find_local_peer(ci_netif *ni, int locked,
@@ -2384,7 +2567,7 @@ ci_inline void ci_netif_ring_ceph_doorbell(ci_netif* netif,
 ci_inline void ci_netif_rx_post_all_batch(ci_netif* netif, int nic_index)
 {
   int i;
-  int num_vis = ci_netif_num_vis(netif);
+  int num_vis = ci_netif_num_rx_vis(netif);
   int n_posted = 0;
   for( i = 0; i < num_vis; ++i ) {
     ef_vi* vi = &netif->nic_hw[nic_index].vis[i];
@@ -2632,6 +2815,99 @@ ci_inline ci_uint32 ci_ip_time_freq_hz2tick(ci_netif* ni, ci_uint32 hz)
 }
 
 
+/**********************************************************************
+ * Transmit pacing token buckets (SO_MAX_PACING_RATE).
+ *
+ * Tokens are bytes.  The bucket is refilled from the cycle counter at
+ * [rate] bytes/sec up to a depth chosen by the caller, and a send is
+ * allowed while the bucket is positive; the send that takes it negative is
+ * paid for by delaying the next one.
+ */
+
+ci_inline ci_uint32 ci_pacing_now(ci_netif* ni)
+{
+  ci_uint64 frc;
+  ci_frc64(&frc);
+  return (ci_uint32) (frc >> IPTIMER_STATE(ni)->ci_ip_time_frc2us);
+}
+
+/* Bucket depth: about a timer tick's worth of tokens, so that the rate can
+ * be sustained when refills are driven only by the timer wheel, and never
+ * less than [min_burst]. */
+ci_inline ci_int32 ci_pacing_bucket_depth(const ci_pacing_bucket* b,
+                                          ci_int32 min_burst)
+{
+  ci_uint64 d = CI_MIN(b->rate / 1000, (ci_uint64) 0x3fffffff);
+  return CI_MAX((ci_int32) d, min_burst);
+}
+
+ci_inline void ci_pacing_bucket_init(ci_netif* ni, ci_pacing_bucket* b,
+                                     ci_uint64 rate, ci_int32 min_burst)
+{
+  b->rate = rate;
+  b->tokens = ci_pacing_bucket_depth(b, min_burst);
+  b->stamp = ci_pacing_now(ni);
+}
+
+ci_inline void ci_pacing_bucket_refill(ci_netif* ni, ci_pacing_bucket* b,
+                                       ci_int32 depth)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint32 now = ci_pacing_now(ni);
+  ci_uint64 cycles = (ci_uint64) (now - b->stamp) << its->ci_ip_time_frc2us;
+  ci_uint64 add;
+
+  /* The bucket never holds more than a few ms worth, so limit the product
+   * below to 10ms. */
+  cycles = CI_MIN(cycles, (ci_uint64) its->khz * 10);
+  add = b->rate * cycles / ((ci_uint64) its->khz * 1000);
+  if( add == 0 )
+    return;  /* leave the stamp alone so that the remainder accrues */
+  b->stamp = now;
+  b->tokens = (ci_int32) CI_MIN((ci_int64) b->tokens + (ci_int64) add,
+                                (ci_int64) depth);
+}
+
+/* Refill the bucket and, if it has any tokens, take [bytes] from it.
+ * Returns false and leaves the bucket alone if it is empty.  This does not
+ * need the stack lock: a racing sender makes the compare-and-swap fail, and
+ * the refill is redone from the stamp it left. */
+ci_inline int ci_pacing_bucket_take(ci_netif* ni, ci_pacing_bucket* b,
+                                    ci_int32 depth, ci_int32 bytes)
+{
+  ci_pacing_bucket old, new;
+
+  new.rate = b->rate;
+  do {
+    old.state = OO_ACCESS_ONCE(b->state);
+    new.state = old.state;
+    ci_pacing_bucket_refill(ni, &new, depth);
+    if( new.tokens <= 0 )
+      return 0;
+    new.tokens -= bytes;
+  } while( ci_cas64u_fail(&b->state, old.state, new.state) );
+  return 1;
+}
+
+/* Microseconds until the bucket holds [want] tokens. */
+ci_inline ci_uint32 ci_pacing_bucket_wait_us(const ci_pacing_bucket* b,
+                                             ci_int32 want)
+{
+  ci_int64 need = (ci_int64) want - b->tokens;
+  if( need <= 0 || b->rate == 0 )
+    return 0;
+  return (ci_uint32) CI_MIN((ci_uint64) need * 1000000 / b->rate,
+                            (ci_uint64) 0xffffffff);
+}
+
+ci_inline void ci_udp_pacing_update(ci_netif* ni, ci_udp_state* us)
+{
+  ci_uint64 rate = us->s.so_max_pacing_rate;
+  ci_pacing_bucket_init(ni, &us->pace,
+                        rate == CI_PACING_RATE_UNLIMITED ? 0 : rate, 0);
+}
+
+
 ci_inline const cicp_hwport_mask_t ci_netif_get_hwport_mask(ci_netif* ni)
 {
 #ifdef __KERNEL__
@@ -2867,6 +3143,71 @@ ci_inline int ci_netif_need_poll_maybe_spinning(ci_netif* ni, ci_uint64 frc_now,
     return ci_netif_need_poll_frc(ni, frc_now);
 }
 
+
+/* Called by a spinning thread that wants the stack polled but could not
+ * get the lock.  With EF_POLL_HANDOFF, ask the lock holder to poll before
+ * it drops the lock (see the deferred_polls stat), unless spinners have
+ * already done that too many times in a row.
+ */
+ci_inline void ci_netif_poll_handoff(ci_netif* ni)
+{
+  if( ni->state->poll_handoffs < NI_OPTS(ni).poll_handoff &&
+      ! (ni->state->lock.lock & CI_EPLOCK_NETIF_NEED_POLL) &&
+      ef_eplock_set_flags_if_locked(&ni->state->lock,
+                                    CI_EPLOCK_NETIF_NEED_POLL) )
+    ++ni->state->poll_handoffs;
+}
+
+
+/* Poll the stack from a spin loop: poll it ourselves if we can get the
+ * lock, or else hand the poll to the lock holder.  Returns true if we
+ * polled.
+ */
+ci_inline int ci_netif_spin_poll(ci_netif* ni)
+{
+  if( ci_netif_trylock(ni) ) {
+    ni->state->poll_handoffs = 0;
+    ci_netif_poll(ni);
+    ci_netif_unlock(ni);
+    return 1;
+  }
+  ci_netif_poll_handoff(ni);
+  return 0;
+}
+
+
+#ifndef __KERNEL__
+/* Adaptive spinning; see spin_adapt.c.  [key] identifies the socket or
+ * epoll set being waited on. */
+extern ci_uint64 oo_spin_adapt_limit(const void* key, ci_uint64 max_spin,
+                                     unsigned khz) CI_HF;
+extern void oo_spin_adapt_record(const void* key, ci_uint64 waited,
+                                 unsigned khz) CI_HF;
+
+/* Returns how long to spin before sleeping in a wait on [key], given that
+ * the configured limit is [max_spin]. */
+ci_inline ci_uint64 ci_netif_spin_adapt_limit(ci_netif* ni, const void* key,
+                                               ci_uint64 max_spin)
+{
+  ci_uint64 limit = oo_spin_adapt_limit(key, max_spin,
+                                        IPTIMER_STATE(ni)->khz);
+  if( limit == 0 )
+    CITP_STATS_NETIF_INC(ni, spin_adapt_skip);
+  return limit;
+}
+
+/* Called when a wait on [key] that began at [start_frc] is satisfied.
+ * [spinning] is true if it was satisfied before the spin ended. */
+ci_inline void ci_netif_spin_adapt_done(ci_netif* ni, const void* key,
+                                        ci_uint64 start_frc, int spinning)
+{
+  oo_spin_adapt_record(key, ci_frc64_get() - start_frc,
+                       IPTIMER_STATE(ni)->khz);
+  if( spinning )
+    CITP_STATS_NETIF_INC(ni, spin_adapt_hit);
+}
+#endif
+
 #if CI_CFG_TCP_SHARED_LOCAL_PORTS
 ci_inline int ci_netif_should_allocate_tcp_shared_local_ports(ci_netif* ni)
 {
@@ -3251,6 +3592,20 @@ ci_inline void ci_netif_pkt_free_nonb_list(ci_netif *ni, oo_pkt_p pkt_list,
 }
 
 
+#ifndef __KERNEL__
+/* As ci_netif_pkt_alloc_nonb(), but allocate from the calling thread's
+ * cache of packets taken from the non-blocking pool, if EF_PKT_MAGAZINE is
+ * set.  Packets held in these caches are returned to the pool by
+ * ci_netif_pkt_mags_drain().
+ */
+extern ci_ip_pkt_fmt* ci_netif_pkt_alloc_nonb_cached(ci_netif* ni) CI_HF;
+extern void ci_netif_pkt_mags_init(ci_netif* ni) CI_HF;
+extern void ci_netif_pkt_mags_drain(ci_netif* ni) CI_HF;
+#else
+# define ci_netif_pkt_alloc_nonb_cached  ci_netif_pkt_alloc_nonb
+#endif
+
+
 ci_inline void ci_netif_pkt_hold(ci_netif* ni, ci_ip_pkt_fmt* pkt) {
   ci_assert_gt(pkt->refcount, 0);
   ++pkt->refcount;
@@ -3576,8 +3931,24 @@ typedef union {
   ci_uint16 ip4;
 } ci_ipx_id_t;
 
+/* UDP sockets take IPv4 IDs from the stack's block a chunk at a time, so
+ * that threads sending on different sockets without the stack lock do not
+ * all write the same counter for each datagram. */
+#define CI_IPID_SOCK_CHUNK  16
+
+ci_inline ci_uint16 ci_udp_next_ip_id(ci_netif* ni, ci_udp_state* us)
+{
+  if( us->ipid_left == 0 ) {
+    us->ipid_next = NI_IPID(ni)->next;
+    NI_IPID(ni)->next += CI_IPID_SOCK_CHUNK;
+    us->ipid_left = CI_IPID_SOCK_CHUNK;
+  }
+  --us->ipid_left;
+  return NI_IPID(ni)->base | (us->ipid_next++ & CI_IPID_BLOCK_MASK);
+}
+
 ci_inline ci_ipx_id_t
-ci_next_ipx_id_be(int af, ci_netif* ni)
+ci_udp_next_ipx_id_be(int af, ci_netif* ni, ci_udp_state* us)
 {
   ci_ipx_id_t ipx_id;
 #if CI_CFG_IPV6
@@ -3585,7 +3956,7 @@ ci_next_ipx_id_be(int af, ci_netif* ni)
     ipx_id.ip6 = CI_BSWAP_BE32(NEXT_IP6_ID(ni));
   else
 #endif
-    ipx_id.ip4 = CI_BSWAP_BE16(NEXT_IP_ID(ni));
+    ipx_id.ip4 = CI_BSWAP_BE16(ci_udp_next_ip_id(ni, us));
   return ipx_id;
 }
 
@@ -3762,6 +4133,40 @@ ci_inline void ci_udp_recv_q_put(ci_netif* ni, ci_udp_recv_q* q,
 }
 
 
+#if CI_CFG_RX_LATENCY_HIST
+/* Add a sample to a histogram.  Receivers on different sockets may add to
+ * the same histogram at once, holding only their own socket locks. */
+ci_inline void ci_netif_rx_latency_add(ci_uint64* hist, ci_uint64 cycles)
+{
+  unsigned i = cycles ? 64 - __builtin_clzll(cycles) : 0;
+  volatile ci_uint64* p = &hist[CI_MIN(i, CI_RX_LATENCY_BUCKETS - 1)];
+  ci_uint64 n;
+
+  do
+    n = *p;
+  while( ci_cas64u_fail(p, n, n + 1) );
+}
+#endif
+
+
+/* Record the time from poll to enqueue of a packet that is about to be put on
+ * a socket's recv_q.  Stack should be locked. */
+ci_inline void ci_udp_rx_latency_enqueue(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+#if CI_CFG_RX_LATENCY_HIST
+  ci_uint64 now, cycles;
+
+  if( CI_LIKELY(! ni->state->opts.rx_latency_hist) )
+    return;
+  ci_frc64(&now);
+  /* The poll may have read the cycle counter on another core. */
+  cycles = now > pkt->tstamp_frc ? now - pkt->tstamp_frc : 0;
+  pkt->netif.rx.enqueue_cycles = CI_MIN(cycles, (ci_uint64) 0xffffffff);
+  ci_netif_rx_latency_add(ni->state->rx_latency.poll_to_enqueue, cycles);
+#endif
+}
+
+
 /* Get a packet from recv_q.  Socket should be locked. */
 ci_inline ci_ip_pkt_fmt* ci_udp_recv_q_get(ci_netif* ni,
                                            ci_udp_recv_q* q)
@@ -4393,6 +4798,10 @@ ci_inline void ci_tcp_set_initialcwnd(ci_netif* ni, ci_tcp_state* ts) {
    * processed the options, so this is OK. */
   ci_assert_le(ts->snd_wscl, CI_TCP_WSCL_MAX);
   ts->ssthresh = 65535 << ts->snd_wscl;
+
+  if( ts->c.cong_alg != CI_TCP_CONG_ALG_RENO ||
+      ts->s.so_max_pacing_rate != CI_PACING_RATE_UNLIMITED )
+    ci_tcp_cong_init(ni, ts);
 }
 
 /*! ?? \TODO should we use fackets to make things more exact ? */ 
@@ -4415,6 +4824,58 @@ ci_inline unsigned ci_tcp_losswnd(ci_tcp_state* ts) {
   return CI_MAX(x, y);
 }
 
+/* True if the socket is using the built-in onload-reno module.  A socket
+ * may also have ts->cong without a module of its own if it is paced. */
+ci_inline int ci_tcp_cong_is_reno(ci_tcp_state* ts) {
+  return OO_P_IS_NULL(ts->cong) || ts->c.cong_alg == CI_TCP_CONG_ALG_RENO;
+}
+
+/* New value for [ssthresh] after loss, as chosen by the socket's
+ * congestion control module. */
+ci_inline unsigned ci_tcp_cong_ssthresh(ci_netif* ni, ci_tcp_state* ts) {
+  if( CI_LIKELY( ci_tcp_cong_is_reno(ts) ) )
+    return ci_tcp_losswnd(ts);
+  return ci_tcp_cong_ssthresh_slow(ni, ts);
+}
+
+/* Per-socket flight recorder; see tcp_flight.c. */
+extern void ci_tcp_flight_init(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_flight_release(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_flight_record_slow(ci_netif* ni, ci_tcp_state* ts,
+                                      int type, int flags, unsigned len,
+                                      ci_uint32 a, ci_uint32 b) CI_HF;
+extern void ci_tcp_flight_dump(ci_netif* ni, ci_tcp_state* ts,
+                               const char* pf, oo_dump_log_fn_t logger,
+                               void* log_arg) CI_HF;
+
+/* Add an event to the socket's flight recorder, if it has one.  See
+ * CI_TCP_FLIGHT_* for the meaning of the arguments. */
+ci_inline void ci_tcp_flight_record(ci_netif* ni, ci_tcp_state* ts,
+                                    int type, int flags, unsigned len,
+                                    ci_uint32 a, ci_uint32 b) {
+  if( CI_UNLIKELY( OO_P_NOT_NULL(ts->flight) ) )
+    ci_tcp_flight_record_slow(ni, ts, type, flags, len, a, b);
+}
+
+/* RACK loss detection; see tcp_rack.c. */
+extern void ci_tcp_rack_update(ci_netif* ni, ci_tcp_state* ts,
+                               ci_ip_pkt_fmt* pkt, ci_uint32 now_us) CI_HF;
+extern void ci_tcp_rack_dsack(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern int /*bool*/ ci_tcp_rack_detect_loss(ci_netif* ni,
+                                            ci_tcp_state* ts) CI_HF;
+
+/* Whether TCP segments are stamped with their send time in microseconds,
+ * pf.tcp_tx.xmit_us. */
+ci_inline int ci_tcp_want_xmit_us(const ci_netif* ni)
+{
+  return NI_OPTS(ni).tcp_rack | NI_OPTS(ni).tcp_rtt_us;
+}
+
+ci_inline int ci_tcp_rack_enabled(const ci_netif* ni, const ci_tcp_state* ts)
+{
+  return NI_OPTS(ni).tcp_rack && (ts->tcpflags & CI_TCPT_FLAG_SACK);
+}
+
 
 #if CI_CFG_BURST_CONTROL
 ci_inline unsigned ci_tcp_burst_exhausted(ci_netif* ni, ci_tcp_state* ts) {
@@ -4696,6 +5157,9 @@ static inline const char* ci_tcp_aux_type2str(int type)
     case CI_TCP_AUX_TYPE_SYNRECV: return "syn-recv state";
     case CI_TCP_AUX_TYPE_BUCKET:  return "syn-recv bucket";
     case CI_TCP_AUX_TYPE_EPOLL: return "epoll3 state";
+    case CI_TCP_AUX_TYPE_PMTUS: return "pmtu state";
+    case CI_TCP_AUX_TYPE_CONG:  return "congestion control state";
+    case CI_TCP_AUX_TYPE_FLIGHT: return "flight recorder";
     default: return "unknown";
   }
 }
@@ -4730,6 +5194,18 @@ ci_inline ci_pmtu_state_t* ci_ni_aux_p2pmtus(ci_netif* ni, oo_p oop)
   ci_assert_equal(aux->type, CI_TCP_AUX_TYPE_PMTUS);
   return &aux->u.pmtus;
 }
+ci_inline ci_tcp_cong_state* ci_ni_aux_p2cong(ci_netif* ni, oo_p oop)
+{
+  ci_ni_aux_mem* aux = ci_ni_aux_p2aux(ni, oop);
+  ci_assert_equal(aux->type, CI_TCP_AUX_TYPE_CONG);
+  return &aux->u.cong;
+}
+ci_inline ci_tcp_flight_buf* ci_ni_aux_p2flight(ci_netif* ni, oo_p oop)
+{
+  ci_ni_aux_mem* aux = ci_ni_aux_p2aux(ni, oop);
+  ci_assert_equal(aux->type, CI_TCP_AUX_TYPE_FLIGHT);
+  return &aux->u.flight;
+}
 
 ci_inline citp_waitable*
 ci_ni_aux2container_w(ci_ni_aux_mem* aux)
@@ -4769,6 +5245,13 @@ ci_inline void ci_sb_epoll_free(ci_netif* ni, ci_sb_epoll_state* epoll) {
 ci_inline void ci_pmtu_state_free(ci_netif* ni, ci_pmtu_state_t* pmtus) {
   ci_ni_aux_free(ni, CI_CONTAINER(ci_ni_aux_mem, u.pmtus, pmtus));
 }
+ci_inline void ci_tcp_cong_state_free(ci_netif* ni, ci_tcp_cong_state* cong) {
+  ci_ip_timer_clear(ni, &cong->pace_tid);
+  ci_ni_aux_free(ni, CI_CONTAINER(ci_ni_aux_mem, u.cong, cong));
+}
+ci_inline void ci_tcp_flight_buf_free(ci_netif* ni, ci_tcp_flight_buf* fb) {
+  ci_ni_aux_free(ni, CI_CONTAINER(ci_ni_aux_mem, u.flight, fb));
+}
 
 extern void ci_ni_aux_more_bufs(ci_netif* ni);
 ci_inline int/*bool*/ ci_ni_aux_can_alloc(ci_netif* ni, int type)
@@ -5330,6 +5813,20 @@ ci_inline void oo_tcpdump_dump_pkt(ci_netif *ni, ci_ip_pkt_fmt *pkt)
 #define oo_tcpdump_dump_pkt(ni, pkt)
 #endif
 
+#if CI_CFG_PKT_SAMPLE
+extern void oo_pkt_sample_copy(ci_netif* ni, ci_ip_pkt_fmt* pkt, int is_tx);
+
+/* Offer a frame to packet sampling.  This is on the RX and TX fast paths,
+ * so when sampling is off it must cost no more than one branch. */
+ci_inline void oo_pkt_sample(ci_netif* ni, ci_ip_pkt_fmt* pkt, int is_tx)
+{
+  if(CI_UNLIKELY( ni->state->pkt_sample_every != 0 ))
+    oo_pkt_sample_copy(ni, pkt, is_tx);
+}
+#else
+#define oo_pkt_sample(ni, pkt, is_tx)
+#endif
+
 
 #ifdef __KERNEL__
 /*********************************************************************
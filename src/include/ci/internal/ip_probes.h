@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+#ifndef __CI_INTERNAL_IP_PROBES_H__
+#define __CI_INTERNAL_IP_PROBES_H__
+
+/* USDT probe points in the user-level stack, for use with bpftrace, perf
+ * and similar tools, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/lib64/libonload.so:onload:tcp_retrans
+ *                { @[arg0] = count(); }'
+ *
+ * A probe that nothing is attached to is a single nop, and its arguments
+ * are values that are already to hand, so the probes are left enabled in
+ * production builds.  They compile to nothing in the kernel, when
+ * CI_CFG_USDT_PROBES is 0, or when <sys/sdt.h> is not installed.
+ *
+ * Probes (all in provider "onload"):
+ *   netif_poll(stack_id, n_evs)          after each poll of the stack
+ *   netif_lock_contended(stack_id)       when taking the stack lock blocks
+ *   tcp_state(stack_id, sock_id, old, new)  on each TCP state change
+ *   tcp_retrans(stack_id, sock_id, seq)  on each retransmitted segment
+ *   tcp_enqueue(stack_id, sock_id, len)  when data is added to a recv queue
+ *   udp_enqueue(stack_id, sock_id, len)  as tcp_enqueue, for UDP
+ *   tcp_recv(stack_id, sock_id, rc)      on return from TCP recvmsg
+ *   udp_recv(stack_id, sock_id, rc)      on return from UDP recvmsg
+ */
+
+#include <ci/internal/transport_config_opt.h>
+
+#if CI_CFG_USDT_PROBES && ! defined(__KERNEL__) && defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+#  define OO_PROBES_ENABLED 1
+# endif
+#endif
+
+#ifdef OO_PROBES_ENABLED
+# define OO_PROBE1(name, a)           DTRACE_PROBE1(onload, name, a)
+# define OO_PROBE2(name, a, b)        DTRACE_PROBE2(onload, name, a, b)
+# define OO_PROBE3(name, a, b, c)     DTRACE_PROBE3(onload, name, a, b, c)
+# define OO_PROBE4(name, a, b, c, d)  DTRACE_PROBE4(onload, name, a, b, c, d)
+#else
+# define OO_PROBES_ENABLED 0
+# define OO_PROBE1(name, a)           do{}while(0)
+# define OO_PROBE2(name, a, b)        do{}while(0)
+# define OO_PROBE3(name, a, b, c)     do{}while(0)
+# define OO_PROBE4(name, a, b, c, d)  do{}while(0)
+#endif
+
+#endif /* __CI_INTERNAL_IP_PROBES_H__ */
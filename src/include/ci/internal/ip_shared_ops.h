@@ -62,7 +62,19 @@ ci_netif_unlock_slow_common(ci_netif*, ci_uint64 lock_val,
 #define ci_netif_lock_maybe_wedged(ni) ef_eplock_lock_maybe_wedged(ni)
 #endif
 #define ci_netif_lock_id(ni,id)  ef_eplock_lock(ni)
-#define ci_netif_trylock(ni)     ef_eplock_trylock(&(ni)->state->lock)
+#if OO_LOCK_PROFILE
+ci_inline int __ci_netif_trylock(ci_netif* ni, const char* file, int line)
+{
+  if( ! ef_eplock_trylock(&ni->state->lock) )
+    return 0;
+  if(CI_UNLIKELY( ni->state->opts.lock_profile ))
+    ci_netif_lock_profile_acquired(ni, file, line);
+  return 1;
+}
+# define ci_netif_trylock(ni)    __ci_netif_trylock((ni), __FILE__, __LINE__)
+#else
+# define ci_netif_trylock(ni)    ef_eplock_trylock(&(ni)->state->lock)
+#endif
 
 #define ci_netif_lock_fdi(epi)   ci_netif_lock_id((epi)->sock.netif,    \
                                                   SC_SP((epi)->sock.s))
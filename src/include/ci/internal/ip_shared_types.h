@@ -77,10 +77,11 @@
 /* See ci_netif_pkt_try_to_free(). */
 #define CI_NETIF_PKT_TRY_TO_FREE_MAX_DESP  2
 
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
+#if CI_CFG_TCP_OFFLOAD_RECYCLER && \
+    2 + CI_CFG_TCP_PLUGIN_EXTRA_VIS > CI_CFG_TX_VIS_MAX
 #define CI_MAX_VIS_PER_INTF (2 + CI_CFG_TCP_PLUGIN_EXTRA_VIS)
 #else
-#define CI_MAX_VIS_PER_INTF 1
+#define CI_MAX_VIS_PER_INTF CI_CFG_TX_VIS_MAX
 #endif
 
 /* Timer wheels are used to schedule the timers. There are 4 level's on
@@ -151,6 +152,13 @@ struct oo_timespec {
   ci_int32 tv_nsec;
 };
 
+/* An entry in the stack's TX timestamp ring (EF_TX_TIMESTAMP_RING) */
+typedef struct {
+  ci_int32            sock_id;
+  ci_uint32           id;         /* SOF_TIMESTAMPING_OPT_ID key */
+  struct oo_timespec  stamp;
+} ci_tx_ts_rec;
+
 
 typedef struct {
   /* We cache EPs between close and accept to speed up passive opens.  See
@@ -233,7 +241,12 @@ typedef union {
 #if CI_CFG_TIMESTAMPING
     struct oo_timespec first_tx_hw_stamp; /* Timestamp of the first transmit */
 #endif
-    ci_user_ptr_t     next CI_ALIGN(8);   /* for ci_tcp_sendmsg() local use only! */
+    union {
+      /* for ci_tcp_sendmsg() local use only! */
+      ci_user_ptr_t   next CI_ALIGN(8);
+      /* time of last (re)transmit for RACK, once sent, if EF_TCP_RACK */
+      ci_uint32       xmit_us;
+    };
   } tcp_tx CI_ALIGN(8);
   struct {
     ci_uint32         pay_len;              /*!< length of UDP payload */
@@ -347,8 +360,19 @@ struct ci_ip_pkt_fmt_s {
       oo_pkt_p          dmaq_next; /**< Next packet in the overflow queue. */
 #if CI_CFG_PORT_STRIPING
       ci_int32          intf_swap;
+#endif
+#if CI_CFG_TX_ADAPTIVE
+      /* Low bits of the frc when posted to the NIC, or 0 if the completion
+       * latency is not being measured (EF_TX_ADAPTIVE). */
+      ci_uint32         post_frc;
 #endif
     } tx;
+#if CI_CFG_RX_LATENCY_HIST
+    struct {
+      /* Cycles from [tstamp_frc] to enqueue on the socket (saturating). */
+      ci_uint32         enqueue_cycles;
+    } rx;
+#endif
   } netif;
 
   /*! These flags can only be used by (i) netif lock holder, or (ii)
@@ -450,10 +474,11 @@ struct ci_ip_pkt_fmt_s {
  * by the TCP_APP */
   /*! For rx packets, the VI/rxq on which this packet was enqueued/received.
    * For tx packets, the VI/txq on which to send this packet.
-   * If !CI_CFG_TCP_OFFLOAD_RECYCLER then there is only one queue and this
+   * If CI_MAX_VIS_PER_INTF is 1 then there is only one queue and this
    * field is irrelevant. Otherwise, plugins tend to use multiple VIs to
    * distinguish different classes of packet and/or content targetting at
-   * different levels of the stack. */
+   * different levels of the stack, and with EF_TX_VIS ordinary packets are
+   * sent on the VI chosen for their flow by ci_ip_set_mac_and_port(). */
   ci_uint8              q_id;
 
   /*! Ensure we have space before [dma_start] so we can expand the Ethernet
@@ -612,6 +637,141 @@ typedef struct {
 } ci_netif_stats;
 
 
+/*!
+** ci_netif_rx_latency
+**
+** Histograms of receive latency, in cycles.  Bucket 0 counts samples of
+** zero, bucket i counts samples in [2^(i-1), 2^i), and the last bucket also
+** counts anything larger.
+*/
+#define CI_RX_LATENCY_BUCKETS  32
+
+typedef struct {
+  /* Hardware timestamp to pickup by ci_netif_poll(). */
+  ci_uint64 hw_to_poll[CI_RX_LATENCY_BUCKETS];
+  /* Pickup by ci_netif_poll() to enqueue on the socket. */
+  ci_uint64 poll_to_enqueue[CI_RX_LATENCY_BUCKETS];
+  /* Enqueue on the socket to delivery to the application. */
+  ci_uint64 enqueue_to_recv[CI_RX_LATENCY_BUCKETS];
+} ci_netif_rx_latency;
+
+
+/*!
+** ci_netif_lock_profile
+**
+** Stack lock hold and wait times, in cycles, by the source line that took
+** the lock (EF_LOCK_PROFILE).  Sites are hashed by line number into a small
+** open-addressed table; locks taken once it is full are only counted in
+** [n_unrecorded].  The hold histograms use the same buckets as
+** ci_netif_rx_latency.
+*/
+#define CI_LOCK_PROFILE_SITES     32
+#define CI_LOCK_PROFILE_BUCKETS   32
+#define CI_LOCK_PROFILE_FILE_LEN  24
+
+typedef struct {
+  char      file[CI_LOCK_PROFILE_FILE_LEN]; /* basename; empty if unused */
+  ci_uint32 line;
+  ci_uint32 hold_max;
+  ci_uint64 n_locks;
+  ci_uint64 hold_cycles;
+  ci_uint64 wait_cycles;
+  ci_uint32 n_waits;
+  ci_uint32 wait_max;
+  ci_uint32 hold_hist[CI_LOCK_PROFILE_BUCKETS];
+} ci_netif_lock_profile_site;
+
+typedef struct {
+  /* One more than the index of the current holder's site, or 0. */
+  ci_uint32 holder;
+  ci_uint32 n_unrecorded;
+  ci_uint64 holder_frc;
+  /* Time the current holder waited, left by the lock's slow path. */
+  ci_uint64 holder_wait;
+  ci_netif_lock_profile_site sites[CI_LOCK_PROFILE_SITES];
+} ci_netif_lock_profile;
+
+
+/*!
+** ci_netif_poll_profile
+**
+** Cycles spent in the sampled calls to ci_netif_poll_n() (EF_POLL_PROFILE),
+** split by phase, and the part of the event queue phase spent handling each
+** class of event.  RX handling lags by one packet, so a packet's TCP/UDP
+** processing is charged to the event that follows it.
+*/
+#define CI_POLL_PHASE_EVQ        0  /* event decode and handling */
+#define CI_POLL_PHASE_POST_POLL  1  /* post-poll list: wakeups, socket work */
+#define CI_POLL_PHASE_RX_REFILL  2  /* freeing TX packets, refilling RXQs */
+#define CI_POLL_PHASE_TX_PUSH    3  /* pushing the DMA queues */
+#define CI_POLL_PHASE_LOOPBACK   4  /* loopback packet delivery */
+#define CI_POLL_PHASE_TIMERS     5
+#define CI_POLL_PHASE_OTHER      6  /* everything else, e.g. deferred work */
+#define CI_POLL_PHASE_N          7
+
+#define CI_POLL_EV_RX            0
+#define CI_POLL_EV_TX            1
+#define CI_POLL_EV_RX_DISCARD    2
+#define CI_POLL_EV_OTHER         3
+#define CI_POLL_EV_N             4
+
+typedef struct {
+  /* Polls left until the next sampled one. */
+  ci_uint32 countdown;
+  /* Non-zero while a sampled poll is in progress. */
+  ci_uint32 active;
+  ci_uint64 n_polls;
+  ci_uint64 total_cycles;
+  ci_uint64 phase_cycles[CI_POLL_PHASE_N];
+  ci_uint64 ev_cycles[CI_POLL_EV_N];
+  ci_uint64 ev_count[CI_POLL_EV_N];
+} ci_netif_poll_profile;
+
+
+/*!
+** more_stats_t
+**
+** Counts derived by walking the stack's sockets; see get_more_stats().
+*/
+#define OO_MORE_STATS_N_STATES  15
+
+typedef struct {
+#define OO_STAT(desc, type, name, kind)  type name CI_ALIGN(sizeof(type));
+  union {
+    unsigned states[OO_MORE_STATS_N_STATES + 1];
+    struct {
+#include <ci/internal/more_stats_def.h>
+    };
+  };
+#undef OO_STAT
+} more_stats_t;
+
+
+#if CI_CFG_STATS_NETIF
+/*!
+** ci_netif_stats_pub
+**
+** A copy of the stack's statistics, refreshed every EF_STATS_PUBLISH_MS so
+** that monitoring tools can sample them without the stack lock and without
+** walking the sockets.  [seq] is odd while the stack is writing: readers
+** copy the region and retry if [seq] was odd or has changed.  [version] is
+** zero until the first copy is published.
+*/
+#define CI_NETIF_STATS_PUB_VERSION  1
+
+typedef struct {
+  ci_uint32             version;
+  volatile ci_uint32    seq;
+  ci_uint64             frc;        /**< when last published */
+  ci_netif_stats        stats;
+  more_stats_t          more_stats;
+#if CI_CFG_SUPPORT_STATS_COLLECTION
+  ci_ip_stats           ip_stats;   /**< copy of stats_snapshot */
+#endif
+} ci_netif_stats_pub;
+#endif
+
+
 /*!
 ** ci_netif_filter_table
 **
@@ -661,9 +821,101 @@ typedef struct {
   ci_uint32 route_count; /* for handling tombstones */
 } ci_tcp_prev_seq_t;
 
+
+/* A TIME_WAIT connection that has given up its endpoint.  This is enough
+ * to re-ACK the peer's retransmitted FIN, and to decide whether a SYN may
+ * reuse the four-tuple, until the entry expires (EF_TCP_TIME_WAIT_COMPACT).
+ */
+typedef struct {
+  ci_uint32   laddr_be32;
+  ci_uint32   raddr_be32;
+  ci_uint16   lport_be16;  /* zero if the entry is free */
+  ci_uint16   rport_be16;
+  ci_uint32   snd_nxt;
+  ci_uint32   rcv_nxt;
+  ci_uint32   tsrecent;    /* peer's timestamp to echo if [tso] is set */
+  ci_iptime_t expiry;      /* time (ticks) the connection leaves TIME_WAIT */
+  ci_uint16   window_be16; /* window to advertise in our ACKs */
+  ci_uint8    tso;         /* timestamps were negotiated */
+  ci_uint8    reserved;
+} ci_tcp_tw_compact_t;
+
 #define CI_TCP_PREV_SEQ_IS_FREE(prev_seq)     (CI_IPX_ADDR_IS_ANY((prev_seq).laddr))
 #define CI_TCP_PREV_SEQ_IS_TERMINAL(prev_seq) ((prev_seq).route_count == 0)
 
+/* TCP Fast Open cookies: we issue cookies of CI_TCP_FASTOPEN_COOKIE_LEN
+ * bytes, and parse any length allowed by RFC7413.  A client can only use
+ * cookies of up to CI_TCP_FASTOPEN_COOKIE_CACHE_MAX bytes, as longer ones
+ * do not fit in the SYN alongside our other options. */
+#define CI_TCP_FASTOPEN_COOKIE_LEN        8
+#define CI_TCP_FASTOPEN_COOKIE_MIN        4
+#define CI_TCP_FASTOPEN_COOKIE_MAX        16
+#define CI_TCP_FASTOPEN_COOKIE_CACHE_MAX  12
+
+/* A cookie learnt from a server, for EF_TCP_FASTOPEN client mode. */
+typedef struct {
+  ci_uint32 raddr_be32;
+  ci_uint16 mss;        /* MSS advertised by the server */
+  ci_uint8  len;        /* cookie length, or 0 if the entry is unused */
+  ci_uint8  cookie[CI_TCP_FASTOPEN_COOKIE_CACHE_MAX];
+} ci_tcp_fastopen_cache_entry;
+
+#define CI_TCP_FASTOPEN_CACHE_SIZE  16
+
+/* An early-drop rule, set with onload_rx_drop_rule_set().  IPv4 packets
+ * whose source matches [saddr_be32] under [smask_be32], and whose protocol
+ * and destination port match where those are non-zero, are dropped before
+ * socket lookup.  If [rate_pps] is non-zero, matching packets are only
+ * dropped once they exceed that rate. */
+typedef struct {
+  ci_uint32 saddr_be32;
+  ci_uint32 smask_be32;
+  ci_uint16 dport_be16;
+  ci_uint8  protocol;
+  ci_uint8  in_use;
+  ci_uint32 rate_pps;
+  ci_uint32 tokens;
+  ci_uint64 refill_frc CI_ALIGN(8);
+  ci_uint64 n_matched  CI_ALIGN(8);
+  ci_uint64 n_dropped  CI_ALIGN(8);
+} ci_rx_drop_rule;
+
+#if CI_CFG_IP_REASM
+/* An IPv4 datagram under reassembly.  Its fragments are linked through
+ * their [next] fields in order of offset.  [total_len] is the length of
+ * the IP payload, or -1 until the last fragment has arrived, and [bytes]
+ * the payload held so far.  The slot is free when [n_pkts] is zero. */
+typedef struct {
+  ci_uint32   saddr_be32;
+  ci_uint32   daddr_be32;
+  ci_uint16   id_be16;
+  ci_uint8    protocol;
+  ci_uint8    reserved;
+  ci_int32    n_pkts;
+  ci_int32    total_len;
+  ci_int32    bytes;
+  ci_iptime_t expiry;
+  oo_pkt_p    frags;
+} ci_ip_reasm;
+#endif
+
+#if CI_CFG_PKT_SAMPLE
+/* A frame copied by packet sampling.  [seq] is set to ~0 while the slot is
+ * being written and then to the ring index it was written at, so that a
+ * reader can tell whether its copy of the slot is intact. */
+typedef struct {
+  volatile ci_uint32 seq;
+  ci_uint16 len;           /* length of the frame */
+  ci_uint16 caplen;        /* bytes of it in [data] */
+  ci_uint64 frc CI_ALIGN(8);
+  ci_int8   intf_i;
+  ci_uint8  is_tx;
+  ci_uint8  data[CI_CFG_PKT_SAMPLE_SNAPLEN] CI_ALIGN(8);
+} ci_pkt_sample;
+#endif
+
+#define CI_RX_DROP_RULES_MAX  16
+
 #if CI_CFG_IPV6
 typedef struct {
   ci_int32  id;
@@ -855,6 +1107,11 @@ typedef struct {
 # define CI_IP_TIMER_NETIF_STATS        0xa  /* netif statistics timer   */
 # define CI_IP_TIMER_TCP_CORK           0xb  /* TCP_CORK timer           */
 # define CI_IP_TIMER_NETIF_TCP_RECYCLE  0xc  /* EF100 plugin recycling   */
+# define CI_IP_TIMER_TCP_PACE           0xd  /* TCP pacing callback      */
+# define CI_IP_TIMER_NETIF_STATS_PUB    0xe  /* netif stats publication  */
+# define CI_IP_TIMER_TCP_RACK           0xf  /* TCP RACK reorder timer   */
+# define CI_IP_TIMER_NETIF_IDLE_RECLAIM 0x10 /* idle socket buffer sweep */
+# define CI_IP_TIMER_NETIF_IP_REASM     0x11 /* IP reassembly timeout    */
 } ci_ip_timer;
 
 
@@ -869,10 +1126,29 @@ typedef struct {
 #define CI_PIO_BUDDY_MAX_ORDER (CI_PIO_BUF_ORDER - CI_CFG_MIN_PIO_BLOCK_ORDER)
 
 
+/* Number of sockets on each interface that may hold a PIO reservation (see
+ * ONLOAD_TEMPLATE_FLAGS_PIO_RESERVE). */
+#define CI_PIO_BUDDY_MAX_RESV 4
+
+/* A block set aside for one socket's templated sends.  It is kept from one
+ * template to the next rather than being returned to the free lists. */
+typedef struct {
+  /* Socket holding the reservation, or OO_SP_NULL if the socket gave it up
+   * while the block was still in use. */
+  oo_sp                 sock_id;
+  /* Offset of the block into the PIO region, or -1 if this slot is free. */
+  ci_int16              offset;
+  ci_uint8              order;
+  ci_uint8              in_use;
+} ci_pio_buddy_resv;
+
 typedef struct {
   struct oo_p_dllink    free_lists[CI_PIO_BUDDY_MAX_ORDER+1];
   struct oo_p_dllink    links[1ul<<CI_PIO_BUDDY_MAX_ORDER];
   ci_uint8              orders[1ul<<CI_PIO_BUDDY_MAX_ORDER];
+  ci_pio_buddy_resv     resv[CI_PIO_BUDDY_MAX_RESV];
+  /* Number of slots in [resv] in use. */
+  ci_int32              n_resv;
   ci_int32              initialised;
 } ci_pio_buddy_allocator;
 
@@ -889,6 +1165,7 @@ typedef struct {
                                          containing page allocation, e.g. if
                                          packet buffers are 2K and pages are
                                          2MB then 10. */
+  CI_ULCONST ci_int8    numa_node;  /**< NUMA node of the buffers, or -1 */
 } oo_pktbuf_set;
 
 typedef struct {
@@ -1048,6 +1325,41 @@ struct oo_ringbuffer_state {
 
 #include <ci/internal/oo_vi_flags.h>
 
+/* Transmit mechanisms, in order of increasing static preference. */
+#define CI_TX_MECH_DMA          0
+#define CI_TX_MECH_PIO          1
+#define CI_TX_MECH_CTPIO        2
+#define CI_TX_MECH_N            3
+
+#if CI_CFG_TX_ADAPTIVE
+/* Frames are bucketed by length as <=128, <=256, <=512, <=1024 and
+ * larger. */
+#define CI_TX_ADAPT_BUCKET_MIN_ORDER  7
+#define CI_TX_ADAPT_N_BUCKETS         5
+
+typedef struct {
+  /* Sends for which this mechanism was chosen. */
+  ci_uint32             attempts;
+  /* Attempts that went by DMA instead: no free PIO region, or a CTPIO
+   * fallback reported on completion. */
+  ci_uint32             fallbacks;
+  /* EWMA of cycles from posting to handling the completion, 0 until the
+   * first sample. */
+  ci_uint32             lat_ewma;
+  /* EWMA of the fallback rate, out of 1 << 16. */
+  ci_uint32             fallback_ewma;
+} ci_tx_adapt_entry_t;
+
+/* Per-interface state of the adaptive TX mechanism selector
+ * (EF_TX_ADAPTIVE).  Entries are indexed by bucket * CI_TX_MECH_N + mech. */
+typedef struct {
+  ci_tx_adapt_entry_t   entry[CI_TX_ADAPT_N_BUCKETS * CI_TX_MECH_N];
+  /* Counts decisions where more than one mechanism was available, to pace
+   * exploration of the ones not currently preferred. */
+  ci_uint32             n_decisions;
+} ci_tx_adapt_t;
+#endif
+
 typedef struct {
   ci_uint32             timer_quantum_ns CI_ALIGN(8);
   ci_uint32             rx_prefix_len;
@@ -1080,9 +1392,13 @@ typedef struct {
   CI_ULCONST ci_uint8   vi_revision;
   CI_ULCONST ci_uint8   vi_nic_flags;
   CI_ULCONST ci_uint8   vi_channel;
+  CI_ULCONST ci_int8    numa_node;   /* NUMA node of the NIC, or -1 */
   CI_ULCONST char       dev_name[20];
   /* Transmit overflow queue.  Packets here are ready to send. */
   oo_pktq               dmaq[CI_MAX_VIS_PER_INTF];
+  /* Packets from bulk sockets waiting for the TX ring to drain below
+   * EF_TX_BULK_FILL_MAX.  These are sent on the first VI, after dmaq[0]. */
+  oo_pktq               dmaq_bulk;
   /* Counts bytes of packet payload into and out of the TX descriptor ring. */
   ci_uint32             tx_bytes_added;
   ci_uint32             tx_bytes_removed;
@@ -1113,6 +1429,9 @@ typedef struct {
   ci_uint32             ctpio_frame_len_check;
   ci_uint32             ctpio_max_frame_len;
 #endif
+#if CI_CFG_TX_ADAPTIVE
+  ci_tx_adapt_t         tx_adapt;
+#endif
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
   ci_uint32             plugin_app_credit;
   CI_ULCONST ef_addrspace  plugin_addr_space CI_ALIGN(8);
@@ -1211,6 +1530,10 @@ struct ci_netif_state_s {
    */
   ci_int8               poll_work_outstanding;
 
+  /* Polls handed to lock holders by spinning threads since one of them
+   * last polled the stack itself (EF_POLL_HANDOFF).  Not synchronised. */
+  ci_uint32             poll_handoffs;
+
   /* Set by thread that is spinning just after it polls for network events. */
   ci_uint64             last_spin_poll_frc CI_ALIGN(8);
 
@@ -1291,7 +1614,18 @@ struct ci_netif_state_s {
   CI_ULCONST ci_uint32  sw_filter_ofs;  /**< offset of sw filter operations */
 #endif
   CI_ULCONST ci_uint32  seq_table_ofs;   /**< offset of seq no table */
+  CI_ULCONST ci_uint32  tw_table_ofs;    /**< offset of compact TIME_WAITs */
   CI_ULCONST ci_uint32  deferred_pkts_ofs; /**< offset of deferred pkts array */
+#if CI_CFG_TIMESTAMPING
+  CI_ULCONST ci_uint32  tx_ts_ring_ofs;  /**< offset of TX timestamp ring */
+  CI_ULCONST ci_uint32  tx_ts_ring_size; /**< entries in TX timestamp ring */
+  /* The stack adds entries to the TX timestamp ring under the stack lock.
+   * Applications remove them without the lock, by advancing [read]. */
+  ci_uint32             tx_ts_ring_write;
+  ci_uint32             tx_ts_ring_dropped; /**< entries lost: ring full */
+  ci_uint32             tx_ts_ring_read CI_ALIGN(CI_CACHE_LINE_SIZE);
+  ci_uint32             tx_ts_ring_dropped_seen;
+#endif
   CI_ULCONST ci_uint32  buf_ofs;         /**< offset of packet metadata */
   CI_ULCONST ci_uint32  dma_ofs;         /**< offset of dma_addrs */
 
@@ -1312,6 +1646,19 @@ struct ci_netif_state_s {
   /* List of sockets that may have reapable buffers. */
   struct oo_p_dllink        reap_list;
 
+  /* Sweep freeing the buffers kept by idle TCP sockets, and the next
+   * endpoint it will look at.  See EF_TCP_IDLE_RECLAIM_MS. */
+  ci_ip_timer           idle_reclaim_tid CI_ALIGN(8);
+  ci_uint32             idle_reclaim_next;
+
+#if CI_CFG_IP_REASM
+  /* Fragmented datagrams under reassembly, and the number of packet
+   * buffers they hold.  See EF_IP_REASM_MAX_PKTS. */
+  ci_ip_timer           ip_reasm_tid CI_ALIGN(8);
+  ci_int32              ip_reasm_n_pkts;
+  ci_ip_reasm           ip_reasm[CI_CFG_IP_REASM_SLOTS];
+#endif
+
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   ci_int32              stats_fmt; /**< Output format */
   ci_ip_timer           stats_tid CI_ALIGN(8); /**< NETIF statistics timer id */
@@ -1359,7 +1706,9 @@ struct ci_netif_state_s {
 #define CI_TCP_AUX_TYPE_BUCKET  1
 #define CI_TCP_AUX_TYPE_EPOLL   2
 #define CI_TCP_AUX_TYPE_PMTUS   3
-#define CI_TCP_AUX_TYPE_NUM     4
+#define CI_TCP_AUX_TYPE_CONG    4
+#define CI_TCP_AUX_TYPE_FLIGHT  5
+#define CI_TCP_AUX_TYPE_NUM     6
   struct oo_p_dllink    free_aux_mem;    /**< Free list of synrecv bufs. */
   ci_uint32             n_free_aux_bufs; /**< Number of free aux bufs */
   ci_uint32             n_aux_bufs[CI_TCP_AUX_TYPE_NUM];
@@ -1409,6 +1758,10 @@ struct ci_netif_state_s {
 
   /* are we in the poll loop? */
   ci_int32              in_poll;
+  /* are DMA sends being deferred to the end of the poll? (EF_TX_COALESCE) */
+  ci_int32              tx_coalesce_active;
+  /* are pure ACKs being queued to the end of the poll? (EF_TCP_ACK_BATCH) */
+  ci_int32              ack_batch_active;
   ci_int32              poll_start_intf;
   struct oo_p_dllink    post_poll_list;
 
@@ -1430,6 +1783,17 @@ struct ci_netif_state_s {
 
 #if CI_CFG_STATS_NETIF
   ci_netif_stats        stats;
+  ci_ip_timer           stats_pub_tid CI_ALIGN(8);
+  ci_netif_stats_pub    stats_pub CI_ALIGN(CI_CACHE_LINE_SIZE);
+#endif
+#if CI_CFG_RX_LATENCY_HIST
+  ci_netif_rx_latency   rx_latency CI_ALIGN(8);
+#endif
+#if CI_CFG_LOCK_PROFILE
+  ci_netif_lock_profile lock_profile CI_ALIGN(8);
+#endif
+#if CI_CFG_POLL_PROFILE
+  ci_netif_poll_profile poll_profile CI_ALIGN(8);
 #endif
 
 #define OO_INTF_I_SEND_VIA_OS   CI_CFG_MAX_INTERFACES
@@ -1444,6 +1808,18 @@ struct ci_netif_state_s {
   volatile ci_uint16    dump_read_i;
   volatile ci_uint16    dump_write_i;
 #endif
+#if CI_CFG_PKT_SAMPLE
+  /* Copy 1 in [pkt_sample_every] frames, up to [pkt_sample_snaplen] bytes
+   * of each, into pkt_sample_ring.  Zero disables sampling.  Set by the
+   * reader; the ring is overwritten without regard to it. */
+  ci_uint32             pkt_sample_every;
+  ci_uint32             pkt_sample_snaplen;
+  ci_uint32             pkt_sample_countdown;
+  volatile ci_uint32    pkt_sample_write_i;
+  ci_uint32             pkt_sample_read_i;   /* owned by the reader */
+  ci_pkt_sample         pkt_sample_ring[CI_CFG_PKT_SAMPLE_RING_LEN]
+                                                    CI_ALIGN(CI_CACHE_LINE_SIZE);
+#endif
 
   ef_vi_stats           vi_stats CI_ALIGN(8);
 
@@ -1451,6 +1827,10 @@ struct ci_netif_state_s {
   CI_ULCONST ci_int32   load_numa_node;
   CI_ULCONST ci_uint32  packet_alloc_numa_nodes;
   CI_ULCONST ci_uint32  sock_alloc_numa_nodes;
+  /* Chunks of socket buffers allocated, and how many of them are
+   * physically contiguous (EF_STATE_HUGE_PAGES) */
+  CI_ULCONST ci_uint32  sock_buf_chunks;
+  CI_ULCONST ci_uint32  sock_buf_huge_chunks;
   CI_ULCONST ci_uint32  interrupt_numa_nodes;
 
 #if CI_CFG_FD_CACHING
@@ -1474,6 +1854,20 @@ struct ci_netif_state_s {
   /* Number of entries in the table of previously-used sequence numbers. */
   CI_ULCONST ci_uint32  seq_table_entries_n;
 
+  /* Number of entries in the table of compact TIME_WAIT connections, and
+   * the number of full TIME_WAIT endpoints waiting to be compacted. */
+  CI_ULCONST ci_uint32  tw_table_entries_n;
+  ci_uint32             tw_compact_pending;
+
+  /* TCP Fast Open cookies learnt from servers, indexed by a hash of the
+   * server's address. */
+  ci_tcp_fastopen_cache_entry fastopen_cache[CI_TCP_FASTOPEN_CACHE_SIZE];
+
+  /* Early-drop rules.  [rx_drop_rules_n] is one more than the highest rule
+   * in use, so that the RX path can skip the table when it is zero. */
+  ci_uint32             rx_drop_rules_n;
+  ci_rx_drop_rule       rx_drop_rules[CI_RX_DROP_RULES_MAX];
+
   CI_ULCONST ci_uint16  rss_instance;
   CI_ULCONST ci_uint16  cluster_size;
 
@@ -1752,6 +2146,104 @@ typedef struct {
   oo_sp                 sp;             /* socket pointer */
 } ci_pmtu_state_t;
 
+
+/* Token bucket used to pace transmits (see ci_pacing_bucket_*()).  UDP
+ * senders do not hold the stack lock, so they update [tokens] and [stamp]
+ * together, through [state]. */
+typedef struct {
+  ci_uint64             rate CI_ALIGN(8); /* bytes/sec, or 0 if not pacing */
+  union {
+    struct {
+      ci_int32          tokens;         /* bytes that may be sent now */
+      ci_uint32         stamp;          /* last refill: frc>>frc2us */
+    };
+    ci_uint64           state;
+  };
+} ci_pacing_bucket;
+
+
+/* Private state of the non-default TCP congestion control modules.  It
+ * lives in an aux buffer hanging off ci_tcp_state::cong, which is only
+ * allocated for sockets that are not using the built-in onload-reno
+ * module or that are paced; see tcp_cong.c.
+ */
+typedef struct {
+  ci_iptime_t           epoch_start;    /* start of current epoch, or 0 */
+  ci_uint32             last_max_cwnd;  /* W_max, in bytes */
+  ci_uint32             origin_point;   /* cwnd at the plateau, bytes */
+  ci_uint32             k;              /* time to reach origin_point, ms */
+  ci_uint32             tcp_cwnd;       /* Reno-friendly estimate, bytes */
+  ci_uint32             tcp_acked;      /* bytes acked towards tcp_cwnd */
+} ci_tcp_cubic_state;
+
+#define CI_TCP_BBR_BW_SLOTS       3
+#define CI_TCP_BBR_BW_SLOT_ROUNDS 4
+typedef struct {
+  /* Windowed max-filter of delivery rate samples (bytes/sec).  Each slot
+   * covers CI_TCP_BBR_BW_SLOT_ROUNDS round trips. */
+  ci_uint64             bw[CI_TCP_BBR_BW_SLOTS] CI_ALIGN(8);
+  ci_uint64             full_bw;        /* bw at last full-pipe check */
+  ci_uint32             round_count;    /* number of round trips seen */
+  ci_uint32             round_start;    /* start of current round, us */
+  ci_uint32             round_end_seq;  /* round ends when this is acked */
+  ci_uint32             round_delivered;/* bytes acked this round */
+  ci_uint32             min_rtt_us;     /* windowed min RTT, us */
+  ci_iptime_t           min_rtt_stamp;  /* when min_rtt_us was taken */
+  ci_iptime_t           probe_rtt_done; /* when PROBE_RTT may end */
+  ci_uint32             cycle_stamp;    /* start of PROBE_BW phase, us */
+  ci_uint32             prior_cwnd;     /* cwnd before PROBE_RTT */
+  ci_uint8              mode;
+#define CI_TCP_BBR_STARTUP      0
+#define CI_TCP_BBR_DRAIN        1
+#define CI_TCP_BBR_PROBE_BW     2
+#define CI_TCP_BBR_PROBE_RTT    3
+  ci_uint8              cycle_idx;      /* index into PROBE_BW gains */
+  ci_uint8              full_bw_cnt;    /* rounds without bw growth */
+  ci_uint8              full_pipe;      /* startup has filled the pipe */
+} ci_tcp_bbr_state;
+
+typedef struct {
+  /* Pacing at the lower of SO_MAX_PACING_RATE and the module's own rate.
+   * [pace_tid] restarts transmit once the bucket has refilled. */
+  ci_ip_timer           pace_tid;
+  oo_sp                 sp;
+  ci_pacing_bucket      pace;
+
+  union {
+    ci_tcp_cubic_state  cubic;
+    ci_tcp_bbr_state    bbr;
+  } u;
+} ci_tcp_cong_state;
+
+/* Flight recorder: a per-socket ring of recent events, for working out
+ * after the fact why a connection stalled.  It is enabled by
+ * EF_TCP_FLIGHT_RECORDER, and is made of that many aux buffers linked in
+ * a circle from ci_tcp_state::flight, which points at the buffer being
+ * written; see tcp_flight.c.
+ */
+#define CI_TCP_FLIGHT_RX       1  /* a=seq b=ack len=payload flags=tcp */
+#define CI_TCP_FLIGHT_TX       2  /* a=seq b=ack len=payload flags=tcp */
+#define CI_TCP_FLIGHT_RETRANS  3  /* a=seq b=end_seq len=retransmits */
+#define CI_TCP_FLIGHT_RTO      4  /* a=snd_una b=rto(ticks) len=retransmits */
+#define CI_TCP_FLIGHT_CWND     5  /* a=cwnd b=ssthresh flags=congstate */
+#define CI_TCP_FLIGHT_WND      6  /* a=ack b=window */
+
+typedef struct {
+  ci_uint32             time;   /* frc >> ci_ip_time_frc2us: about 1us */
+  ci_uint8              type;
+  ci_uint8              flags;
+  ci_uint16             len;
+  ci_uint32             a;
+  ci_uint32             b;
+} ci_tcp_flight_ev;
+
+#define CI_TCP_FLIGHT_EVS_PER_BUF  6
+typedef struct {
+  oo_p                  next;   /* next buffer in the ring */
+  ci_uint16             n_evs;  /* entries of ev[] written so far */
+  ci_tcp_flight_ev      ev[CI_TCP_FLIGHT_EVS_PER_BUF];
+} ci_tcp_flight_buf;
+
 /*! Possible return codes between cicp_user_retrieve and cicp_user_defer
     if these codes have their least significant bit set it may be worth
     re-trying the operation
@@ -1978,6 +2470,8 @@ struct ci_sock_cmn_s {
 #define CI_SOCK_AFLAG_NEED_ACK_BIT      10u
 #define CI_SOCK_AFLAG_SELECT_ERR_QUEUE  0x800
 #define CI_SOCK_AFLAG_SELECT_ERR_QUEUE_BIT 11u
+#define CI_SOCK_AFLAG_ZEROCOPY          0x1000       /* SO_ZEROCOPY  */
+#define CI_SOCK_AFLAG_ZEROCOPY_BIT      12u
 
 
   /*! Which socket flags should be inherited by accepted connections? */
@@ -1989,7 +2483,7 @@ struct ci_sock_cmn_s {
    CI_SOCK_FLAG_IP6_PMTU_DO | CI_SOCK_FLAG_IP6_ALWAYS_DF |                  \
    CI_SOCK_FLAG_TCP_OFFLOAD)
 #define CI_SOCK_AFLAG_TCP_INHERITED \
-    (CI_SOCK_AFLAG_CORK | CI_SOCK_AFLAG_NODELAY)
+    (CI_SOCK_AFLAG_CORK | CI_SOCK_AFLAG_NODELAY | CI_SOCK_AFLAG_ZEROCOPY)
 
   /* Bound-to local address.
    * - s.laddr is the bound-to address, unmodified.  Used by the filters.
@@ -2110,6 +2604,19 @@ struct ci_sock_cmn_s {
    * of 4 bytes.
    */
   ci_uint8              domain;           /*!<  PF_INET or PF_INET6 */
+
+  /* SO_MAX_PACING_RATE in bytes/sec, as Linux's unsigned long.
+   * Inherited on accept(), as [so] is. */
+  ci_uint64             so_max_pacing_rate CI_ALIGN(8);
+#define CI_PACING_RATE_UNLIMITED 0xffffffffffffffffull
+
+  /* MSG_ZEROCOPY notification ids.  Onload copies the payload of such
+   * sends, so each one is complete when the send returns.  [zc_id_next] is
+   * the id of the next one (written with the stack lock held), and
+   * [zc_id_unreported] the first not yet read from the error queue
+   * (written with the socket lock held). */
+  ci_uint32             zc_id_next;
+  ci_uint32             zc_id_unreported;
 };
 
 ci_inline bool is_sock_flag_pmtu_do_set(const ci_sock_cmn* s, int af)
@@ -2216,6 +2723,9 @@ typedef struct {
   ci_uint32 n_rx_overflow;    /* datagrams dropped due to overflow     */
   ci_uint32 n_rx_mem_drop;    /* datagrams dropped due to out-of-mem   */
   ci_uint32 n_rx_pktinfo;     /* n times IP/IPV6_PKTINFO retrieved     */
+  ci_uint32 n_rx_gro;         /* datagrams merged into a previous one  */
+  ci_uint32 n_rx_fanout;      /* datagrams sharing another's buffer    */
+  ci_uint32 n_rx_fanout_drop; /* no buffer to share with this socket   */
   ci_uint32 max_recvq_pkts;   /* maximum packets queued for recv       */
 
   ci_uint32 n_tx_os;          /* datagrams send via OS socket          */
@@ -2240,15 +2750,17 @@ typedef struct {
   ci_uint32 n_tx_msg_confirm; /* onload send with MSG_CONFIRM          */
   ci_uint32 n_tx_os_late;     /* sent via OS, after copying            */
   ci_uint32 n_tx_unconnect_late; /* concurrent send and unconnect      */
+  ci_uint32 n_tx_gso;         /* sends split by UDP_SEGMENT            */
 } ci_udp_socket_stats;
 
 struct  ci_udp_state_s {
   ci_sock_cmn           s;
 
-  /*! Cache used for "unconnected" destinations - i.e. where a dest. addr
-   * has been provided by the caller.  We use this cache regardless of 
-   * whether we are connected */
-  ci_ip_cached_hdrs     ephemeral_pkt CI_ALIGN(8);
+  /* Fields from here to [tx_count] are touched on every receive and send;
+   * the header cache and everything after it are only needed on the send
+   * path to unconnected destinations or for less common options.  See
+   * ci_udp_state_layout_check().
+   */
 
   ci_uint32 udpflags;
 #define CI_UDPF_FILTERED        0x00000001  /*!< filter inserted         */
@@ -2265,9 +2777,17 @@ struct  ci_udp_state_s {
 #define CI_UDPF_MCAST_FILTER    0x00010000  /*!< mcast filter added */
 #define CI_UDPF_NO_UCAST_FILTER 0x00020000  /*!< don't add unicast filters */
 #define CI_UDPF_LAST_SEND_NOMAC 0x00040000  /*!< last send was via nomac path */
+#define CI_UDPF_GRO             0x00080000  /*!< UDP_GRO                 */
 
   ci_uint32 future_intf_i; /* Interface to check for incoming future packets */
 
+  /*! UDP_SEGMENT: payload bytes per datagram when a send is split, or 0 */
+  ci_uint16 gso_size;
+
+  /*! IPv4 IDs taken from the stack's block: next one and how many left */
+  ci_uint16 ipid_next;
+  ci_uint16 ipid_left;
+
 #if CI_CFG_ZC_RECV_FILTER
   /* Only safe to use these at user-level in context of caller who set them */
   ci_uint64     recv_q_filter CI_ALIGN(8);
@@ -2305,6 +2825,14 @@ struct  ci_udp_state_s {
    */
   ci_uint32 tx_count;
 
+  /*! Cache used for "unconnected" destinations - i.e. where a dest. addr
+   * has been provided by the caller.  We use this cache regardless of 
+   * whether we are connected */
+  ci_ip_cached_hdrs     ephemeral_pkt CI_ALIGN(8);
+
+  /* SO_MAX_PACING_RATE: limits the rate of sendmsg(). */
+  ci_pacing_bucket pace;
+
   /* Cache for IP_PKTINFO and IPV6_PKTINFO */
   struct {
     /* PKT info: */
@@ -2372,6 +2900,9 @@ struct oo_pipe {
 #define CI_PFD_AFLAG_READER_MASK    0x07
 #define CI_PFD_AFLAG_WRITER_SHIFT   4
 #define CI_PFD_AFLAG_WRITER_MASK    0x70
+  /* Set for the whole pipe to delay waking a blocked writer until the pipe
+   * is half empty (EF_PIPE_WAKE_BATCH). */
+#define CI_PFD_AFLAG_WAKE_BATCH     0x100
 
   ci_uint32 bufs_num;
 
@@ -2459,6 +2990,8 @@ typedef struct {
 
   ci_uint32            hash;        /* hash value for lookup table       */
   oo_p                 bucket_link; /* link used in hash buckets         */
+
+  ci_uint8             fastopen;  /* send a TFO cookie in the SYN-ACK    */
 } ci_tcp_state_synrecv;
 
 /* State for maintaining ci_netif_state::ready_eps_list[ready_list_id]
@@ -2504,6 +3037,8 @@ typedef struct {
     ci_tcp_listen_bucket bucket;
     ci_sb_epoll_state    epoll;
     ci_pmtu_state_t      pmtus;
+    ci_tcp_cong_state    cong;
+    ci_tcp_flight_buf    flight;
   } u;
 
   /* This is not a real member.  It just brings the sizeof(ci_ni_aux_mem)
@@ -2526,6 +3061,13 @@ typedef struct {
   ci_uint16            user_mss;            /* user-provided maximum MSS */
   ci_uint8             tcp_defer_accept;    /* TCP_DEFER_ACCEPT sockopt  */
 #define OO_TCP_DEFER_ACCEPT_OFF 0xff
+  ci_uint8             cong_alg;            /* TCP_CONGESTION sockopt    */
+#define CI_TCP_CONG_ALG_RENO    0   /* built-in RFC3465 Reno: "onload-reno" */
+#define CI_TCP_CONG_ALG_CUBIC   1
+#define CI_TCP_CONG_ALG_BBR     2
+#define CI_TCP_CONG_ALG_NUM     3
+#define CI_TCP_CONG_NAME_MAX    16  /* as Linux TCP_CA_NAME_MAX */
+  ci_uint16            fastopen_qlen;       /* TCP_FASTOPEN sockopt      */
 
 } ci_tcp_socket_cmn;
 
@@ -2536,6 +3078,7 @@ struct oo_tcp_socket_stats {
   ci_uint32  tx_stop_cwnd;    /* TX stopped by congestion window   */
   ci_uint32  tx_stop_more;    /* TX stopped by CORK, MSG_MORE etc. */
   ci_uint32  tx_stop_nagle;   /* TX stopped by nagle's algorithm   */
+  ci_uint32  tx_stop_autocork;/* TX held back by autocorking       */
   ci_uint32  tx_stop_app;     /* TX stopped because TXQ empty      */
 #if CI_CFG_BURST_CONTROL
   ci_uint32  tx_stop_burst;   /* TX stopped by burst control       */
@@ -2546,6 +3089,8 @@ struct oo_tcp_socket_stats {
   ci_uint32  tx_msg_warm;     /* Number of MSG_WARM done           */
   ci_uint32  tx_tmpl_send_fast;  /* Number of fast tmpl sends      */
   ci_uint32  tx_tmpl_send_slow;  /* Number of slow tmpl sends      */
+  ci_uint32  rx_ooo_tail;     /* ooo pkts placed via rob_tail_block */
+  ci_uint32  rx_ooo_walk;     /* ROB blocks walked placing ooo pkts */
   ci_uint32  rx_isn;          /* initial sequence num              */
   ci_uint16  tx_tmpl_active;  /* Number of active tmpl sends       */
   ci_uint16  rtos;            /* RTO timeouts                      */
@@ -2554,6 +3099,7 @@ struct oo_tcp_socket_stats {
   ci_uint16  rx_ack_seq_errs; /* out-of-seq ACKs dropped           */
   ci_uint16  rx_ooo_pkts;     /* out-of-order pkts recvd           */
   ci_uint16  rx_ooo_fill;     /* out-of-order events               */
+  ci_uint16  rx_ooo_max_walk; /* most ROB blocks walked for one pkt */
   ci_uint16  total_retrans;   /* total number of retransmits       */
 };
 
@@ -2562,11 +3108,14 @@ struct ci_tcp_state_s {
   ci_sock_cmn         s;
   ci_tcp_socket_cmn   c;
 
-  /* Id of the local peer socket in case of loopback connection */
-  oo_sp                 local_peer;
-
-  /* List of allocated templated sends on this socket */
-  oo_pkt_p            tmpl_head;
+  /* The fields from here to [rcv_window_max] are those used when handling
+   * a segment on the receive fast path (see ci_tcp_rx_deliver_to_conn()),
+   * and are kept together so that it touches as few cache lines as
+   * possible.  The groups that follow are those used to send, then those
+   * used by the timers, then the rest.  The layout is checked by
+   * ci_tcp_state_layout_check(): update that when moving fields between
+   * the groups.
+   */
 
   /* Various options.  Should be updated under the stack lock only. */
   ci_uint32            tcpflags;
@@ -2620,84 +3169,22 @@ struct ci_tcp_state_s {
    * because packet allocation failed.  Must send FIN, really. */
 #define CI_TCPT_FLAG_FIN_PENDING        0x800000
 
+  /* The socket is in TIME_WAIT and will be moved to the compact TIME_WAIT
+   * table at the end of the poll, freeing its endpoint. */
+#define CI_TCPT_FLAG_TW_COMPACT         0x1000000
+
   /* flags advertised on SYN */
 # define CI_TCPT_SYN_FLAGS \
         (CI_TCPT_FLAG_WSCL | CI_TCPT_FLAG_TSO | CI_TCPT_FLAG_SACK)
 # define CI_TCPT_NEG_FLAGS \
         (CI_TCPT_FLAG_TSO | CI_TCPT_FLAG_WSCL | CI_TCPT_FLAG_SACK | \
          CI_TCPT_FLAG_ECN)
-  /* Path MTU data: timer, value, etc */
-  oo_p pmtus;
-
-  /* SO_SNDBUF measured in packet buffers. */
-  ci_int32            so_sndbuf_pkts;
-
-  /* the part of SO_RVCBUF used as window */
-  ci_uint32           rcv_window_max;
-
-  ci_uint32           send_in;    /**< Packets added directly to send queue */
-  ci_uint32           send_out;   /**< Packets removed from send queue */
-  ci_ip_pkt_queue     send;       /**< Send queue. */
 
-  ci_ip_pkt_queue     retrans;    /**< Retransmit queue. */
-
-  ci_ip_pkt_queue     recv1;      /**< Receive queue. */
-  ci_ip_pkt_queue     recv2;      /**< Aux receive queue for urgent data */
-  oo_pkt_p            recv1_extract; 
-                                  /**< Next id in main receive queue to be 
-                                       extracted by recvmsg */
-  ci_uint16           recv_off;   /**< Offset to current recv queue
-                                       from base of [ci_tcp_state] */
-
-  ci_uint16           outgoing_hdrs_len;
-  /* Length of IP + TCP headers (inc TSO if any).
-   * Does not include Ethernet header len any more! */
-
-  ci_ip_pkt_queue     rob;        /**< Re-order buffer. */
-  oo_pkt_p            last_sack[CI_TCP_SACK_MAX_BLOCKS + 1];  
-                                  /**< First packets of last-received
-                                   * block (in [0]) and last-sent 
-                                   * SACKed blocks */
-  ci_uint32           dsack_start;/**< Start SEQ of DSACK option */
-  ci_uint32           dsack_end;  /**< End SEQ of DSACK option */
-  oo_pkt_p            dsack_block;/**< Second block packet id: 
-                                   * CI_ILL_END used for no second block;
-                                   * CI_ILL_UNUSED when no DSACK present */
-
-#if CI_CFG_TIMESTAMPING
-  /* About timestamp_q management:
-   * This queue is for delivery to the app when it asks for the list of
-   * completed tx timestamps. The timestamp to be given is that of the last
-   * transmit, so we add to this queue when we get the ACK confirming that
-   * there aren't going to be any more retransmits.
-   *
-   * The trickiness arises because that ACK may arrive before the tx
-   * completion. In that case we split timestamp_q at timestamp_q_pending so
-   * that the non-tx-complete don't appear to be visible to the app;
-   * ci_netif_rx_pkt_complete_tcp() checks for this in poll and can make them
-   * visible.
-   *
-   * Full diagram of what's what:
-   *   ts_q.head (oldest packet) (===ts_q.pkts_reaped)
-   *      > ci_udp_recv_q_reapable()
-   *   ts_q.extract  (===ts_q.pkts_delivered)
-   *      > ci_udp_recv_q_pkts()
-   *   ts_q_pending (===ts_q.pkts_added)
-   *   ts_q.tail (newest packet)
-   *
-   * NB: the timestamp_q is used both for tx timestamping and for zc
-   * completions: they have identical needs so they share an implementation.
-   * */
-  ci_udp_recv_q       timestamp_q;/**< TX timestamp queue */
-  oo_pkt_p            timestamp_q_pending; /* First non-tx-complete packet on
-                                       timestamp_q, or OO_PP_NULL if there is
-                                       no such packet. Protected by the stack
-                                       lock */
-#endif
-
-  /* Next field is needed to support PathMTU discovery functionality */
-  ci_uint32            snd_check;   /* equal to snd_nxt at beginning of
-                                       tested interval */
+  ci_uint32            fast_path_check;
+  /* If in a state in which we can execute the TCP receive fast path, then
+  ** this reflects the expected TCP header length and flags.  Otherwise it
+  ** is set to an invalid value that should never match a TCP packet.
+  */
 
   ci_uint32            snd_nxt;     /* next sequence number to send       */
   ci_uint32            snd_max;     /* maximum sequence number advertised */
@@ -2708,19 +3195,6 @@ struct ci_tcp_state_s {
 #endif
   ci_uint32            snd_delegated; /* bytes sent via delegated_send() */
 
-  ci_uint32            fast_path_check;
-  /* If in a state in which we can execute the TCP receive fast path, then
-  ** this reflects the expected TCP header length and flags.  Otherwise it
-  ** is set to an invalid value that should never match a TCP packet.
-  */
-
-  ci_uint32            snd_up;      /* send urgent pointer, holds the seq 
-                                       num of byte following the OOB byte */
-  ci_uint16            amss;        /* advertised mss to the sending side */
-  ci_uint16            smss;        /* sending MSS (excl IP & TCP hdrs)   */
-  ci_uint16            eff_mss;     /* PMTU-based mss, excl TCP options   */
-  ci_uint16            retransmits; /* number of retransmissions */
-
   ci_uint32            rcv_wnd_advertised; /* receive window to advertise in
                                               outgoing packets            */
   ci_uint32            rcv_wnd_right_edge_sent; /* the edge of the receive
@@ -2730,14 +3204,48 @@ struct ci_tcp_state_s {
   ci_uint32            rcv_delivered; /* amount removed from rx queue     */
   ci_uint32            ack_trigger; /* rcv_delivered value which triggers
                                        next receive window update         */
+
 #if CI_CFG_BURST_CONTROL
   ci_uint32            burst_window; /* bytes after snd_una that we
                                         can burst to before receiving
                                         any packets from other side,
                                         or zero if unlimited */
 #endif
-  ci_uint32            rcv_up;      /* receive urgent pointer, holds the
-                                       seq num of the OOB byte            */
+
+  /* timestamp option fields see RFC1323 */
+  ci_uint32            tsrecent;    /* TS.Recent RFC1323                  */
+  ci_uint32            tslastack;   /* Last.ACK.sent RFC1323              */ 
+#ifndef NDEBUG
+  ci_uint32            tslastseq;   /* Sequence no of packet that updated tsrecent
+                                       Just being used for debugging - purge at will */
+#endif
+  ci_iptime_t          tspaws;      /* last active timestamp for tsrecent */
+#define CI_TCP_TSO_WORD (CI_BSWAPC_BE32((CI_TCP_OPT_NOP       << 24u)  | \
+                                        (CI_TCP_OPT_NOP       << 16u)  | \
+                                        (CI_TCP_OPT_TIMESTAMP <<  8u)  | \
+                                        (0xa                        )))
+
+  /* Keep alive probes, and sending ACKs after gaps that may cause
+   * other end to validated its congetion window 
+   */
+  ci_iptime_t          t_prev_recv_payload; /* timestamp of prev in-seq 
+                                             * burst with payload */
+  ci_iptime_t          t_last_recv_payload; /* timestamp of last in-seq 
+                                             * packet with payload */
+  ci_iptime_t          t_last_recv_ack;     /* timestamp of last in-seq 
+                                             * packet without payload */
+
+  /* delayed acknowledgements */
+  ci_uint16            acks_pending;/* number of packets needing ack      */
+/* These bits are ORed into acks_pending */
+#define CI_TCP_DELACK_SOON_FLAG 0x8000
+#define CI_TCP_ACK_FORCED_FLAG  0x4000
+/* Mask to get the number of acks pending (includes ACK_FORCED but not
+ * DELACK_SOON bit)
+ */
+#define CI_TCP_ACKS_PENDING_MASK 0x7fff
+
+  ci_uint8             incoming_tcp_hdr_len; /* expected TCP header length */
 
   ci_uint8             rcv_wscl;    /* receive window scaling             */
   ci_uint8             snd_wscl;    /* send window scaling                */
@@ -2752,11 +3260,53 @@ struct ci_tcp_state_s {
 
   ci_uint8             dup_acks;    /* number of dup-acks received        */
 
-  ci_uint8             incoming_tcp_hdr_len; /* expected TCP header length */
+  ci_ip_pkt_queue     recv1;      /**< Receive queue. */
+  ci_ip_pkt_queue     recv2;      /**< Aux receive queue for urgent data */
+  oo_pkt_p            recv1_extract; 
+                                  /**< Next id in main receive queue to be 
+                                       extracted by recvmsg */
+  ci_uint16           recv_off;   /**< Offset to current recv queue
+                                       from base of [ci_tcp_state] */
 
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
-  ci_uint16            plugin_stream_id;
-#endif
+  ci_ip_pkt_queue     rob;        /**< Re-order buffer. */
+  oo_pkt_p            last_sack[CI_TCP_SACK_MAX_BLOCKS + 1];  
+                                  /**< First packets of last-received
+                                   * block (in [0]) and last-sent 
+                                   * SACKed blocks */
+  oo_pkt_p            rob_tail_block;
+                                  /**< First packet of the last block in
+                                   * [rob], or OO_PP_NULL if not known.
+                                   * Stale when [rob] is empty. */
+  ci_uint32           dsack_start;/**< Start SEQ of DSACK option */
+  ci_uint32           dsack_end;  /**< End SEQ of DSACK option */
+  oo_pkt_p            dsack_block;/**< Second block packet id: 
+                                   * CI_ILL_END used for no second block;
+                                   * CI_ILL_UNUSED when no DSACK present */
+
+  /* Flight recorder (ci_tcp_flight_buf), or OO_P_NULL when disabled. */
+  oo_p flight;
+
+  /* the part of SO_RVCBUF used as window */
+  ci_uint32           rcv_window_max;
+
+  /* Send path and ACK processing. */
+
+  ci_uint32           send_in;    /**< Packets added directly to send queue */
+  ci_uint32           send_out;   /**< Packets removed from send queue */
+  ci_ip_pkt_queue     send;       /**< Send queue. */
+
+  ci_ip_pkt_queue     retrans;    /**< Retransmit queue. */
+
+  ci_uint16           outgoing_hdrs_len;
+  /* Length of IP + TCP headers (inc TSO if any).
+   * Does not include Ethernet header len any more! */
+
+  ci_uint32            snd_up;      /* send urgent pointer, holds the seq 
+                                       num of byte following the OOB byte */
+  ci_uint16            amss;        /* advertised mss to the sending side */
+  ci_uint16            smss;        /* sending MSS (excl IP & TCP hdrs)   */
+  ci_uint16            eff_mss;     /* PMTU-based mss, excl TCP options   */
+  ci_uint16            retransmits; /* number of retransmissions */
 
   ci_uint32            congrecover; /* snd_nxt when loss detected         */
   oo_pkt_p             retrans_ptr; /* next packet to retransmit          */
@@ -2777,15 +3327,20 @@ struct ci_tcp_state_s {
   ci_uint32            taildrop_mark;
 #endif
 
-  /* Keep alive probes, and sending ACKs after gaps that may cause
-   * other end to validated its congetion window 
-   */
-  ci_iptime_t          t_prev_recv_payload; /* timestamp of prev in-seq 
-                                             * burst with payload */
-  ci_iptime_t          t_last_recv_payload; /* timestamp of last in-seq 
-                                             * packet with payload */
-  ci_iptime_t          t_last_recv_ack;     /* timestamp of last in-seq 
-                                             * packet without payload */
+  /* SO_SNDBUF measured in packet buffers. */
+  ci_int32            so_sndbuf_pkts;
+
+  /* An extension of the send queue.  Packets are put here when the netif
+  ** lock is contended, and are later transferred to the sendq.  This is a
+  ** linked list of packets in reverse order. */
+  ci_int32             send_prequeue;
+  /* send_prequeue_in is an atomic addition to send_in; it is never
+   * decremented.  See ci_tcp_sendq_n_pkts(). */
+  oo_atomic_t          send_prequeue_in;
+
+  /* Next field is needed to support PathMTU discovery functionality */
+  ci_uint32            snd_check;   /* equal to snd_nxt at beginning of
+                                       tested interval */
 
   /* congestion window validation RFC2861; 
    * also used for time-wait state timeout
@@ -2802,14 +3357,45 @@ struct ci_tcp_state_s {
    */
 #endif
 
-  ci_iptime_t          t_last_invalid_ack; /* timestamp of last ACK for
-                                              an invalid incoming packet */
+  /* Start sequence number of the segment last held back by autocorking,
+   * and when it was first held, in microseconds.  See EF_TCP_AUTOCORK_US.
+   */
+  ci_uint32            autocork_seq;
+  ci_uint32            autocork_us;
+
+  /* RACK (RFC8985) loss detection state, used iff EF_TCP_RACK and SACK.
+   * Times are in microseconds (frc >> ci_ip_time_frc2us). */
+  struct {
+    ci_uint32          xmit_us;     /* send time of most recently sent
+                                     * segment delivered                  */
+    ci_uint32          end_seq;     /* ... and its end sequence number    */
+    ci_uint32          rtt_us;      /* RTT of that segment                */
+    ci_uint32          min_rtt_us;  /* minimum RTT seen                   */
+    ci_uint8           reo_wnd_mult;/* reordering window in min_rtt/4     */
+    ci_uint8           valid;       /* fields above have been set         */
+  } rack;
+
+  /* List of allocated templated sends on this socket */
+  oo_pkt_p            tmpl_head;
+
+  /* Path MTU data: timer, value, etc */
+  oo_p pmtus;
+
+  /* Congestion control module state (ci_tcp_cong_state), or OO_P_NULL
+   * when the built-in onload-reno module is in use. */
+  oo_p cong;
+
+  /* Round-trip estimation and timers. */
 
   /* sa and sv are scaled by 8 and 4 respectively to minimize roundoff
   ** error when time has a large granularity See the appendix of
   ** Jacobson's SIGCOMM 88  */
   ci_iptime_t          sa;          /* smoothed round trip time           */
   ci_iptime_t          sv;          /* round trip time variance estimate  */
+  /* As sa and sv, in microseconds (frc >> ci_ip_time_frc2us), when
+   * EF_TCP_RTT_US is set.  sa and sv are then derived from these. */
+  ci_uint32            sa_us;
+  ci_uint32            sv_us;
   ci_iptime_t          rto;         /* retransmit timeout value           */
 
   /* these fields for RTT measurement are valid when:
@@ -2820,28 +3406,14 @@ struct ci_tcp_state_s {
   ci_uint32            timed_seq;   /* first byte of timed packet         */
   ci_iptime_t          timed_ts;    /* timestamp for timed packet         */
 
-  /* timestamp option fields see RFC1323 */
-  ci_uint32            tsrecent;    /* TS.Recent RFC1323                  */
-  ci_uint32            tslastack;   /* Last.ACK.sent RFC1323              */ 
-#ifndef NDEBUG
-  ci_uint32            tslastseq;   /* Sequence no of packet that updated tsrecent
-                                       Just being used for debugging - purge at will */
-#endif
-  ci_iptime_t          tspaws;      /* last active timestamp for tsrecent */
-#define CI_TCP_TSO_WORD (CI_BSWAPC_BE32((CI_TCP_OPT_NOP       << 24u)  | \
-                                        (CI_TCP_OPT_NOP       << 16u)  | \
-                                        (CI_TCP_OPT_TIMESTAMP <<  8u)  | \
-                                        (0xa                        )))
+  ci_iptime_t          t_last_invalid_ack; /* timestamp of last ACK for
+                                              an invalid incoming packet */
 
-  /* delayed acknowledgements */
-  ci_uint16            acks_pending;/* number of packets needing ack      */
-/* These bits are ORed into acks_pending */
-#define CI_TCP_DELACK_SOON_FLAG 0x8000
-#define CI_TCP_ACK_FORCED_FLAG  0x4000
-/* Mask to get the number of acks pending (includes ACK_FORCED but not
- * DELACK_SOON bit)
- */
-#define CI_TCP_ACKS_PENDING_MASK 0x7fff
+  /* keepalive vailables */
+  ci_uint32            ka_probes;   /* number of probes sent              */
+
+  ci_uint16            zwin_probes; /* zero window probes counter         */
+  ci_uint16            zwin_acks;   /* zero window acks counter           */
 
   ci_uint16 urg_data; /** out-of-band byte store & relevant flags */
 #define CI_TCP_URG_DATA_MASK    0x00ff
@@ -2849,12 +3421,6 @@ struct ci_tcp_state_s {
 #define CI_TCP_URG_IS_HERE      0x0200  /* oob byte is valid (got it) */
 #define CI_TCP_URG_PTR_VALID    0x0400  /* tcp_rcv_up is valid */
 
-  /* keepalive vailables */
-  ci_uint32            ka_probes;   /* number of probes sent              */
-
-  ci_uint16            zwin_probes; /* zero window probes counter         */
-  ci_uint16            zwin_acks;   /* zero window acks counter           */
-
   /* timer ids for timers */
   ci_ip_timer          rto_tid;     /* retransmit timer                   */
   ci_ip_timer          delack_tid;  /* delayed acknowledgement timer      */
@@ -2864,6 +3430,50 @@ struct ci_tcp_state_s {
   ci_ip_timer          stats_tid;   /* Statistics report timer            */
 #endif
   ci_ip_timer          cork_tid;    /* TCP timer for TCP_CORK/MSG_MORE   */
+  ci_ip_timer          rack_tid;    /* RACK reordering window timer      */
+
+  /* Rarely used. */
+
+  /* Id of the local peer socket in case of loopback connection */
+  oo_sp                 local_peer;
+
+  ci_uint32            rcv_up;      /* receive urgent pointer, holds the
+                                       seq num of the OOB byte            */
+
+#if CI_CFG_TIMESTAMPING
+  /* About timestamp_q management:
+   * This queue is for delivery to the app when it asks for the list of
+   * completed tx timestamps. The timestamp to be given is that of the last
+   * transmit, so we add to this queue when we get the ACK confirming that
+   * there aren't going to be any more retransmits.
+   *
+   * The trickiness arises because that ACK may arrive before the tx
+   * completion. In that case we split timestamp_q at timestamp_q_pending so
+   * that the non-tx-complete don't appear to be visible to the app;
+   * ci_netif_rx_pkt_complete_tcp() checks for this in poll and can make them
+   * visible.
+   *
+   * Full diagram of what's what:
+   *   ts_q.head (oldest packet) (===ts_q.pkts_reaped)
+   *      > ci_udp_recv_q_reapable()
+   *   ts_q.extract  (===ts_q.pkts_delivered)
+   *      > ci_udp_recv_q_pkts()
+   *   ts_q_pending (===ts_q.pkts_added)
+   *   ts_q.tail (newest packet)
+   *
+   * NB: the timestamp_q is used both for tx timestamping and for zc
+   * completions: they have identical needs so they share an implementation.
+   * */
+  ci_udp_recv_q       timestamp_q;/**< TX timestamp queue */
+  oo_pkt_p            timestamp_q_pending; /* First non-tx-complete packet on
+                                       timestamp_q, or OO_PP_NULL if there is
+                                       no such packet. Protected by the stack
+                                       lock */
+#endif
+
+#if CI_CFG_TCP_OFFLOAD_RECYCLER
+  ci_uint16            plugin_stream_id;
+#endif
 
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
   /* Technically a timer, but it always has a single-tick expiry so we save
@@ -2878,6 +3488,7 @@ struct ci_tcp_state_s {
   ci_int32             stats_fmt;        /**< Output format */
 #endif
  
+
 #if CI_CFG_FD_CACHING
   /* Used to cache TCP-state and associated fds to improve accept performance */
   ci_int32             cached_on_fd;
@@ -2890,14 +3501,6 @@ struct ci_tcp_state_s {
   struct oo_p_dllink   epcache_fd_link;
 #endif
 
-  /* An extension of the send queue.  Packets are put here when the netif
-  ** lock is contended, and are later transferred to the sendq.  This is a
-  ** linked list of packets in reverse order. */
-  ci_int32             send_prequeue;
-  /* send_prequeue_in is an atomic addition to send_in; it is never
-   * decremented.  See ci_tcp_sendq_n_pkts(). */
-  oo_atomic_t          send_prequeue_in;
-
   struct oo_p_dllink   timeout_q_link;
 
   /* Additional stats for Dynamic Right Sizing */
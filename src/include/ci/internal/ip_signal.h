@@ -39,6 +39,37 @@
 typedef struct oo_sig_thread_state citp_signal_info;
 
 
+/* A thread's signal state is only changed by that thread, or by a signal
+ * handler that interrupts it.  Updates must be atomic with respect to
+ * interruption, but not with respect to other CPUs, so on x86 a single
+ * instruction without the lock prefix is enough.  That is several times
+ * cheaper, which matters for applications taking frequent signals.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+ci_inline void oo_signal_flags_or(volatile ci_uint32* p, ci_uint32 mask)
+{ __asm__ __volatile__("orl %1, %0" : "+m" (*p) : "ir" (mask) : "memory"); }
+
+ci_inline void oo_signal_flags_and(volatile ci_uint32* p, ci_uint32 mask)
+{ __asm__ __volatile__("andl %1, %0" : "+m" (*p) : "ir" (mask) : "memory"); }
+
+ci_inline int oo_signal_cas_fail(volatile ci_int32* p, ci_int32 oldval,
+                                 ci_int32 newval)
+{
+  char ret;
+  ci_int32 prevval;
+  __asm__ __volatile__("cmpxchgl %3, %1; setne %0"
+                       : "=q"(ret), "+m"(*p), "=a"(prevval)
+                       : "r"(newval), "a"(oldval)
+                       : "memory");
+  return ret;
+}
+#else
+#define oo_signal_flags_or   ci_atomic32_or
+#define oo_signal_flags_and  ci_atomic32_and
+#define oo_signal_cas_fail   ci_cas32_fail
+#endif
+
+
 extern void citp_signal_run_pending(citp_signal_info* info) CI_HF;
 
 ci_inline citp_signal_info *citp_signal_get_specific_inited(void)
@@ -47,6 +47,14 @@ extern void ci_netif_stats_action(__NI_STRUCT__ *ni,
 
 #endif
 
+#if CI_CFG_STATS_NETIF
+
+/** Refresh the stack's published statistics and rearm the timer that
+    calls this every EF_STATS_PUBLISH_MS. */
+extern void ci_netif_stats_publish(__NI_STRUCT__ *ni) CI_HF;
+
+#endif
+
 /* Clear ci_ip_stats structure */
 ci_inline void
 ci_ip_stats_clear(ci_ip_stats *stats)
@@ -45,7 +45,8 @@ enum {
                                      ONLOAD_TIMESTAMPING_FLAG_RX_CPACKET,
 
   ONLOAD_TIMESTAMPING_FLAG_MASK = ONLOAD_TIMESTAMPING_FLAG_TX_MASK |
-                                  ONLOAD_TIMESTAMPING_FLAG_RX_MASK,
+                                  ONLOAD_TIMESTAMPING_FLAG_RX_MASK |
+                                  ONLOAD_TIMESTAMPING_FLAG_TX_RING,
 
   ONLOAD_TIMESTAMPING_FLAG_TX_COUNT = 1,
   ONLOAD_TIMESTAMPING_FLAG_RX_COUNT = 2,
@@ -69,6 +70,27 @@ onload_timestamping_want_tx_nic(unsigned flags)
   return flags & ONLOAD_SOF_TIMESTAMPING_TX_HARDWARE;
 }
 
+/* Indicates whether TX NIC timestamps go to the stack's TX timestamp ring */
+static inline int /*bool*/
+onload_timestamping_want_tx_ring(unsigned flags)
+{
+  const unsigned want = ONLOAD_SOF_TIMESTAMPING_ONLOAD |
+                        ONLOAD_TIMESTAMPING_FLAG_TX_RING;
+  return (flags & want) == want;
+}
+
+/* The SOF_TIMESTAMPING_OPT_ID key for a timestamped TCP segment */
+static inline ci_uint32
+ci_tcp_tx_timestamp_id(const ci_sock_cmn* s, ci_ip_pkt_fmt* pkt)
+{
+  ci_uint32 id = pkt->pf.tcp_tx.end_seq - 1 - s->ts_key;
+  /* FIN and SYN eat seq space, but the user is not interested in them */
+  if( TX_PKT_IPX_TCP(ipcache_af(&s->pkt), pkt)->tcp_flags &
+      (CI_TCP_FLAG_SYN|CI_TCP_FLAG_FIN) )
+    id--;
+  return id;
+}
+
 static inline void
 onload_timestamp_to_timespec(const struct onload_timestamp* in,
                              ef_timespec* out)
@@ -102,6 +102,24 @@ struct oo_ringbuffer {
 };
 
 
+#ifndef __KERNEL__
+/* A cache of packet buffers taken in a batch from the non-blocking pool,
+ * from which one thread at a time allocates without touching the shared
+ * pool.  Padded so that caches used by different threads do not share a
+ * cache line. */
+union oo_pkt_magazine {
+  struct {
+    /* Non-zero while a thread is using this cache */
+    volatile ci_uint32 busy;
+    ci_uint32          n;
+    /* List of [n] free packets, linked through pkt->next */
+    oo_pkt_p           head;
+  } m;
+  char pad[CI_CACHE_LINE_SIZE];
+};
+#endif
+
+
 /*!
 ** ci_netif
 **
@@ -187,9 +205,15 @@ struct ci_netif_s {
   struct oo_p_dllink* active_wild_table;
 #endif
   ci_tcp_prev_seq_t*   seq_table;
+  ci_tcp_tw_compact_t* tw_table;
 
   struct oo_deferred_pkt* deferred_pkts;
 
+#if CI_CFG_TIMESTAMPING
+  ci_tx_ts_rec*        tx_ts_ring;
+  ci_uint32            tx_ts_ring_mask;  /**< Trusted copy of size - 1 */
+#endif
+
 #ifdef __ci_driver__
   unsigned             pkt_sets_n;
   unsigned             pkt_sets_max;
@@ -236,6 +260,11 @@ struct ci_netif_s {
   ci_uint32             dma_addr_next;
 #endif
 
+#ifndef __KERNEL__
+  /* See ci_netif_pkt_alloc_nonb_cached() */
+  union oo_pkt_magazine pkt_mags[CI_CFG_PKT_MAGAZINES];
+#endif
+
 #ifndef __ci_driver__
   /* for table of active UL netifs (unix/netif_init.c) */
   ci_dllink            link;
@@ -380,8 +409,22 @@ struct ci_netif_poll_state {
   oo_pkt_p  tx_pkt_free_list;
   oo_pkt_p* tx_pkt_free_list_insert;
   int       tx_pkt_free_list_n;
+  /* The connected TCP socket that last took a segment on the fast path in
+   * this poll, and the interface and VLAN that segment arrived on.  Further
+   * segments of the same flow are usually back-to-back, so they can go
+   * straight to it instead of through the filter table. */
+  oo_sp     tcp_rx_last_sock;
+  ci_int16  tcp_rx_last_intf_i;
+  ci_int16  tcp_rx_last_vlan;
 };
 
+ci_inline void ci_netif_poll_state_init(struct ci_netif_poll_state* ps)
+{
+  ps->tx_pkt_free_list_insert = &ps->tx_pkt_free_list;
+  ps->tx_pkt_free_list_n = 0;
+  ps->tcp_rx_last_sock = OO_SP_NULL;
+}
+
 
 
 #endif  /* __CI_INTERNAL_IP_TYPES_H__ */
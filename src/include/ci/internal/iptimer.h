@@ -55,17 +55,16 @@ ci_inline void __ci_timer_busy_unset(ci_netif* netif, ci_iptime_t time)
   IPTIMER_STATE(netif)->busy_mask[b/64] &=~ (1ULL << (b%64));
 }
 
+/* The timer may have been in wheel0 even if [time] is not in the current
+ * rotation: see ci_ip_timer_cascade_early().  So keep the mask in step with
+ * the bucket regardless. */
 ci_inline void ci_timer_busy_maybe_unset(ci_netif* netif, ci_iptime_t time)
 {
-  int b;
-  if( (IPTIMER_STATE(netif)->sched_ticks & IPTIMER_WHEEL0_MASK) !=
-      (time & IPTIMER_WHEEL0_MASK) )
-    return;
-  b = IPTIMER_BUCKETNO(0, time);
+  int b = IPTIMER_BUCKETNO(0, time);
   if( oo_p_dllink_is_empty(netif,
                            oo_p_dllink_ptr(netif,
                                            &IPTIMER_STATE(netif)->warray[b])) )
-    __ci_timer_busy_unset(netif, time);
+    IPTIMER_STATE(netif)->busy_mask[b/64] &=~ (1ULL << (b%64));
 }
 
 /* debugging hook called if CI_IP_TIMER_DEBUG_HOOK set */
@@ -8,21 +8,12 @@
 
 #define N_STATES  (CI_TCP_STATE_NUM(CI_TCP_STATE_ACTIVE_WILD) + 1)
 
-typedef struct {
-#define OO_STAT(desc, type, name, kind)  type name CI_ALIGN(sizeof(type));
-  union {
-    unsigned states[N_STATES + 1];
-    struct {
-#include "more_stats_def.h"
-    };
-  };
-} more_stats_t;
-#undef OO_STAT
-
 
 static inline void get_more_stats(ci_netif* ni, more_stats_t* s)
 {
   unsigned i;
+
+  CI_BUILD_ASSERT(N_STATES == OO_MORE_STATS_N_STATES);
   memset(s, 0, sizeof(*s));
   for( i = 0; i < ni->state->n_ep_bufs; ++i ) {
     citp_waitable_obj* wo = SP_TO_WAITABLE_OBJ(ni, i);
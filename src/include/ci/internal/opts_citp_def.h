@@ -100,7 +100,13 @@ CI_CFG_OPT("EF_UL_EPOLL", ul_epoll, ci_uint32,
 "over mode 1, particularly with larger sets.  However, this mode has "
 "some restrictions.  It does not support epoll sets that exist across fork(). "
 "It does not support monitoring the readiness of the set's epoll fd via a "
-"another epoll/poll/select.",
+"another epoll/poll/select.\n"
+"\n"
+"In modes 1 and 3, file descriptors that Onload does not accelerate (e.g. "
+"timerfd or eventfd) are held in a kernel epoll set, whose readiness the "
+"driver mirrors into memory shared with the application.  epoll_wait() "
+"therefore only enters the kernel for them when one of them is ready or "
+"when it has to block.",
           2, , CITP_EPOLL_UL, 0, 3, oneof:kernel;ul;kernel_accel;ul_scale)
 
 CI_CFG_OPT("EF_EPOLL_SPIN", ul_epoll_spin, ci_uint32, 
@@ -155,6 +161,20 @@ CI_CFG_OPT("EF_EPOLL_MT_SAFE", ul_epoll_mt_safe, ci_uint32,
 "EF_UL_EPOLL=2 and EF_EPOLL_CTL_FAST=1.",
            1, , 0, 0, 1, yesno)
 
+CI_CFG_OPT("EF_EPOLL_MULTI_STACK", ul_epoll_multi_stack, ci_uint32,
+"With EF_UL_EPOLL=3, the maximum number of stacks other than the home stack "
+"in which an epoll set may claim a ready list.  Sockets in those stacks are "
+"otherwise handled as non-home members, but while none of them has been woken "
+"epoll_wait() skips them without examining each socket, and polls each such "
+"stack once rather than once per socket.  This makes spinning on an epoll set "
+"spanning many stacks much cheaper."
+"\n"
+"Each stack has only a few ready lists, and one claimed in this way is not "
+"available to another epoll set that wants the stack as its home stack."
+"\n"
+"The default of 0 disables this feature.",
+           4, , 0, 0, 8, count)
+
 CI_CFG_OPT("EF_WODA_SINGLE_INTERFACE", woda_single_if, ci_uint32,
 "This option alters the behaviour of onload_ordered_epoll_wait().  This "
 "function would normally ensure correct ordering across multiple interfaces. "
@@ -203,6 +223,14 @@ CI_CFG_OPT("EF_LOG_TIMESTAMPS", log_timestamps, ci_uint32,
 "Timestamps are originated from the FRC counter.",
            1, , 0, 0, 1, yesno)
 
+CI_CFG_OPT("EF_LOG_BINARY", log_binary, ci_uint32,
+"If enabled, the per-packet diagnostic logging selected by "
+"EF_TCP_RX_LOG_FLAGS (in debug builds) is recorded in binary form in a per-thread buffer "
+"instead of being formatted as it happens, which greatly reduces its "
+"effect on latency.  The buffered records are formatted and written to "
+"the Onload log when the process exits or fails.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_LOG_VIA_IOCTL", log_via_ioctl, ci_uint32,
 "Causes error and log messages emitted by OpenOnload to be written to the "
 "system log rather than written to standard error.  This includes the "
@@ -314,6 +342,15 @@ CI_CFG_OPT("EF_PIPE_SIZE", pipe_size, ci_int32,
            , , OO_PIPE_DEFAULT_SIZE, OO_PIPE_MIN_SIZE, CI_CFG_MAX_PIPE_SIZE,
            count)
 
+CI_CFG_OPT("EF_PIPE_WAKE_BATCH", pipe_wake_batch, ci_uint32,
+"Tune pipes for bulk throughput.  A writer blocked on a full pipe is "
+"normally woken as soon as the reader frees a buffer, so that a fast writer "
+"and a slow reader wake each other for every buffer.  With this option set, "
+"the writer is not woken until the reader has drained the pipe to half of "
+"its size, or emptied it.  This saves many wakeups at the cost of the writer "
+"seeing space later.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_SOCK_LOCK_BUZZ", sock_lock_buzz, ci_uint32,
 "Spin while waiting to obtain a per-socket lock.  If the spin timeout "
 "expires, enter the kernel and block.  The spin timeout is set by "
@@ -486,6 +523,17 @@ CI_CFG_OPT("EF_SPIN_USEC", ul_spin_usec, ci_uint32,
 OO_SPIN_BLURB,
            , , 0, MIN, MAX, time:usec)
 
+CI_CFG_OPT("EF_SPIN_ADAPT", ul_spin_adapt, ci_uint32,
+"When enabled, the time spent spinning in each blocking receive and "
+"epoll_wait() is adapted to the recent history of waits on the same socket "
+"or epoll set, rather than always being EF_SPIN_USEC.  If most recent waits "
+"lasted longer than EF_SPIN_USEC, the thread goes straight to sleep; "
+"otherwise it spins only as long as most of those waits that were short "
+"enough took.  EF_SPIN_USEC remains the upper limit.  Applies to TCP and "
+"UDP recv() and to epoll_wait() on an epoll set handled by "
+"Onload.  See the spin_adapt_* stack statistics for the effect.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_SLEEP_SPIN_USEC", sleep_spin_usec, ci_uint32, 
 "Sets the duration in microseconds of sleep after each spin iteration. "
 "Currently applies to EPOLL3 epoll_wait only. "
@@ -607,6 +655,17 @@ CI_CFG_OPT("EF_CLUSTER_HOT_RESTART", cluster_hot_restart_opt, ci_uint32,
     " 1 - enable per-port stack sharing for hot restarts.",
            , , 0, 0, 1, level)
 
+CI_CFG_OPT("EF_CLUSTER_PER_THREAD", cluster_per_thread, ci_uint32,
+"When scalable filters are in an \"rss\" mode, each process normally gets "
+"one stack from the cluster, which all of its threads share.  When this "
+"option is set, a thread that has given itself a stack name with "
+"onload_set_stackname(ONLOAD_THIS_THREAD, ...) instead gets a clustered "
+"stack of its own, with that name.  Each such thread can then listen on the "
+"same SO_REUSEPORT port from its own stack, with the NIC spreading "
+"incoming connections across the threads' stacks.  Each thread's stack "
+"counts against EF_CLUSTER_SIZE.",
+           , , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_TCP_FORCE_REUSEPORT", tcp_reuseports, ci_uint64,
 "This option specifies a comma-separated list of port numbers.  TCP "
 "sockets that bind to those port numbers will have SO_REUSEPORT "
@@ -623,7 +682,8 @@ CI_CFG_OPT("EF_UDP_FORCE_REUSEPORT", udp_reuseports, ci_uint64,
 CI_CFG_OPT("EF_SOCKET_CACHE_PORTS", sock_cache_ports, ci_uint64,
 "This option specifies a comma-separated list of port numbers.  When set (and "
 "socket caching is enabled), only sockets bound to the specified ports will "
-"be eligible to be cached.\n",
+"be eligible to be cached.  Active-open sockets are also eligible if they "
+"are connected to one of the specified remote ports.\n",
            A8, , 0, MIN, MAX, list)
 #endif
 
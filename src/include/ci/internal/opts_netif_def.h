@@ -157,6 +157,19 @@ CI_CFG_OPT("EF_POLL_ON_DEMAND", poll_on_demand, ci_uint32,
 "events are (mostly) processed in response to interrupts.",
            1, , 1, 0, 1, yesno)
 
+CI_CFG_OPT("EF_POLL_HANDOFF", poll_handoff, ci_uint32,
+"When a spinning thread finds that the stack needs polling but another "
+"thread holds the stack lock, ask the lock holder to poll the stack again "
+"before it drops the lock, so that the spinning thread only has to watch "
+"its own sockets.  This lets several threads that share a stack cooperate "
+"in polling it rather than contending for the lock."
+"\n"
+"This option limits the number of polls that spinning threads may hand to "
+"lock holders in a row before one of them must take the lock itself, so "
+"that a thread holding the lock is not kept polling indefinitely.  The "
+"default of 0 disables handoff.",
+           8, , 0, 0, 255, count)
+
 CI_CFG_OPT("EF_INT_DRIVEN", int_driven, ci_uint32,
 "Put the stack into an 'interrupt driven' mode of operation.  When this "
 "option is not enabled Onload uses heuristics to decide when to enable "
@@ -199,6 +212,12 @@ CI_CFG_OPT("EF_MCAST_RECV", mcast_recv, ci_uint32,
 "multicast receives are not accelerated, but the socket continues to be "
 "managed by Onload."
 "\n"
+"Each stack that joins a group needs its own filter, and relies on the NIC "
+"to replicate the traffic when several do.  Where many processes receive "
+"the same groups, sharing one stack between them (see EF_NAME) needs only "
+"one filter, and each datagram is received once and delivered to every "
+"socket from the same packet buffer."
+"\n"
 "See also EF_MCAST_JOIN_HANDOVER."
 MULTICAST_LIMITATIONS_NOTE,
            1, , 1, 0, 1, yesno)
@@ -375,6 +394,15 @@ CI_CFG_OPT("EF_TX_TIMESTAMPING", tx_timestamping, ci_uint32,
 " does not succeed;\n",
            2, , 0, 0, 3, count)
 
+CI_CFG_OPT("EF_TX_TIMESTAMP_RING", tx_ts_ring, ci_uint32,
+"Number of entries in the stack's ring of transmit timestamps.  The NIC "
+"timestamps of packets sent by sockets that have requested "
+"ONLOAD_TIMESTAMPING_FLAG_TX_RING through onload_timestamping_request() are "
+"recorded in this ring, which the application drains in bulk with "
+"onload_tx_timestamp_ring_read(), instead of on the sockets' error queues.  "
+"Rounded up to a power of 2.  The default of 0 disables the ring.",
+           , , 0, 0, 1 << 20, count)
+
 CI_CFG_OPT("EF_TCP_TSOPT_MODE", tcp_tsopt_mode, ci_uint32,
 "Enable or disable per-stack TCP header timestamps (as defined in RFC 1323).  "
 "Overrides system setting ipv4.tcp_timestamps and EF_TCP_SYN_OPTS.  "
@@ -390,6 +418,16 @@ CI_CFG_OPT("EF_CLUSTER_IGNORE", cluster_ignore, ci_uint32,
 "effectively ignore attempts to set SO_REUSEPORT.",
            1, , 0, 0, 1, count)
 
+CI_CFG_OPT("EF_CLUSTER_REBALANCE", cluster_rebalance, ci_uint32,
+"When non-zero, the stacks of a scalable cluster compare their receive load "
+"about once a second.  If the busiest stack has handled more than this "
+"percentage more receive events than the quietest, one bucket of the "
+"cluster's RSS indirection table that carries none of the busiest stack's "
+"connected sockets is pointed at the quietest stack instead, so that new "
+"flows hashing to it are handled there.  The default of 0 disables "
+"rebalancing.",
+           , , 0, 0, 10000, count)
+
 CI_CFG_OPT("EF_VALIDATE_ENV", validate_env, ci_uint32,
 "When set this option validates Onload related environment "
 "variables (starting with EF_).",
@@ -464,6 +502,26 @@ CI_CFG_OPT("EF_TCP_SYNCOOKIES", tcp_syncookies, ci_uint32,
 "Use TCP syncookies to protect from SYN flood attack",
            1, , 0, 0, 1, yesno)
 
+#define EF_TCP_FASTOPEN_CLIENT 1
+#define EF_TCP_FASTOPEN_SERVER 2
+CI_CFG_OPT("EF_TCP_FASTOPEN", tcp_fastopen, ci_uint32,
+"Enable TCP Fast Open (RFC 7413) for IPv4 connections, which lets data be "
+"carried in the SYN so that a short-lived connection saves a round trip.  "
+"The value is a bitmask, as for net.ipv4.tcp_fastopen:\n"
+"  1 - client: send(MSG_FASTOPEN) or sendto(MSG_FASTOPEN) on an unconnected "
+"socket connects it, and carries the data in the SYN once a cookie has been "
+"learnt from the server,\n"
+"  2 - server: listening sockets with the TCP_FASTOPEN socket option set "
+"issue cookies, and accept a connection with the data in its SYN when a "
+"valid cookie is presented, without waiting for the handshake to "
+"complete.\n"
+"Cookies are derived from the addresses of the connection and a per-stack "
+"secret, so they are not valid across stacks.  A client connection that "
+"Onload can't accelerate, or a loopback one, fails with EOPNOTSUPP as when "
+"Linux has TCP Fast Open disabled, so that the application falls back to "
+"connect().",
+           3, , 0, 0, 3, oneof:none;client;server;both)
+
 CI_CFG_OPT("EF_TCP_SEND_NONBLOCK_NO_PACKETS_MODE", 
            tcp_nonblock_no_pkts_mode, ci_uint32,
            "This option controls how a non-blocking TCP send() call should "
@@ -505,6 +563,64 @@ CI_CFG_OPT("EF_TCP_RCVBUF_MODE", tcp_rcvbuf_mode, ci_uint32,
 "The effect of EF_TCP_RCVBUF_STRICT is independent of this setting.",
 	   1, , 0, 0, 1, yesno)
 
+CI_CFG_OPT("EF_TCP_RECV_NT_COPY_THRESH", tcp_recv_nt_copy_thresh, ci_uint32,
+"TCP receive calls with buffers of at least this many bytes copy data to "
+"the application with non-temporal stores, prefetching the next packet in "
+"the receive queue as they go.  This avoids evicting the rest of the cache "
+"when bulk receivers read large blocks (e.g. 1MB) that they will not touch "
+"again soon, but will slow down applications that do read the data "
+"straight away.  0 (the default) disables this.",
+           , , 0, 0, MAX, bincount)
+
+CI_CFG_OPT("EF_TCP_RX_COPYBREAK", tcp_rx_copybreak, ci_uint32,
+"In-order TCP segments carrying at most this many bytes are copied onto the "
+"end of the last packet in the socket's receive queue, when it has room, "
+"and their own packet buffer is freed at once.  This stops a stream of "
+"small segments queued for a slow reader from using a whole packet buffer "
+"each.  Segments are not copied while the application is receiving from "
+"the socket, nor when receive timestamps are enabled.  0 (the default) "
+"disables this.",
+           , , 0, 0, 1024, count)
+
+CI_CFG_OPT("EF_TCP_AUTOCORK_US", tcp_autocork_us, ci_uint32,
+"Autocorking of small sends on TCP sockets with Nagle's algorithm "
+"disabled (TCP_NODELAY).  A segment smaller than the MSS that would be "
+"sent while the socket's previous segment is still waiting for the NIC "
+"to complete it is held back instead, and later sends are added to it.  "
+"It is sent once the stack has handled the NIC's next events, or when "
+"the previous segment is acknowledged, or when a later send finds it has "
+"been held for this many microseconds.  Failing all of those it is sent "
+"by a timer, after this many microseconds rounded up to the stack's timer "
+"resolution (about a millisecond).  This reduces the number of "
+"packets sent by applications doing many small writes, without delaying "
+"sends on idle sockets.  0 (the default) disables autocorking.",
+           , , 0, 0, MAX, time:usec)
+
+CI_CFG_OPT("EF_TCP_IDLE_RECLAIM_MS", tcp_idle_reclaim_ms, ci_uint32,
+"TCP sockets that have received no data for this many milliseconds give "
+"back the packet buffers they keep after the application has read "
+"everything, which otherwise stay allocated until the stack runs short of "
+"buffers.  The stack walks its sockets a few at a time so that each one is "
+"looked at about once per interval.  This bounds the packet buffer "
+"footprint of stacks holding very many mostly-idle connections.  0 (the "
+"default) disables this.",
+           , , 0, 0, MAX, count)
+
+CI_CFG_OPT("EF_IP_REASM_MAX_PKTS", ip_reasm_max_pkts, ci_uint32,
+"Fragmented IPv4 UDP datagrams are reassembled in the stack, holding at "
+"most this many packet buffers of incomplete datagrams.  When the limit "
+"is reached the oldest incomplete datagram is dropped.  Fragments only "
+"reach the stack when the filters match them, as with MAC filters or "
+"multicast, since port filters cannot match fragments other than the "
+"first.  0 (the default) disables reassembly, and fragments are passed "
+"to the kernel.",
+           , , 0, 0, MAX, count)
+
+CI_CFG_OPT("EF_IP_REASM_TIMEOUT_MS", ip_reasm_timeout_ms, ci_uint32,
+"Time in milliseconds after its first fragment arrives that an incomplete "
+"datagram is dropped, when EF_IP_REASM_MAX_PKTS is set.",
+           , , 1000, 1, 60000, time:msec)
+
 CI_CFG_OPT("EF_HIGH_THROUGHPUT_MODE", rx_merge_mode, ci_uint32,
 "This option causes onload to optimise for throughput at the cost of latency.",
            1, , 0, 0, 1, yesno)
@@ -617,6 +733,27 @@ CI_CFG_OPT("EF_USE_HUGE_PAGES", huge_pages, ci_uint32,
            2, , 1, 0, 2, oneof:no;try;always)
 #endif
 
+CI_CFG_OPT("EF_STATE_HUGE_PAGES", state_huge_pages, ci_uint32,
+"Control of whether socket buffers are allocated in physically-contiguous "
+"huge-page-sized chunks:\n"
+"  0 - no (default);\n"
+"  1 - yes, when the system can provide them without trying hard, and "
+"fall back to normal allocation otherwise.\n"
+"Onload then accesses socket state from the kernel (for example when "
+"polling the stack from an interrupt or timer) through huge page "
+"mappings, which reduces TLB misses for stacks with many sockets.  "
+"onload_stackdump reports how many chunks were allocated this way.",
+           1, , 0, 0, 1, oneof:no;try)
+
+CI_CFG_OPT("EF_STATS_PUBLISH_MS", stats_publish_ms, ci_uint32,
+"Every this many milliseconds, the stack publishes a consistent copy of its "
+"statistics, including the counts that onload_stackdump derives by walking "
+"the sockets, in its shared state.  onload_remote_monitor then reads that "
+"copy instead of walking the sockets itself, which is cheaper and does not "
+"disturb the cache lines the application is using.  0 (the default) "
+"disables this.",
+           , , 0, 0, MAX, count)
+
 CI_CFG_OPT("EF_COMPOUND_PAGES_MODE", compound_pages, ci_uint32,
 "Debug option, not suitable for normal use.\n"
 "For packet buffers, allocate system pages in the following way:\n"
@@ -625,6 +762,17 @@ CI_CFG_OPT("EF_COMPOUND_PAGES_MODE", compound_pages, ci_uint32,
 "  2 - do not use compound pages at all.\n",
           2, , 0, 0, 2, oneof:always;small;never)
 
+CI_CFG_OPT("EF_PKT_NUMA", pkt_numa, ci_uint32,
+"Controls the NUMA placement of packet buffers:\n"
+"  0 - allocate packet buffers on the node of the thread that causes the "
+"allocation, and use packet sets without regard to their node (default);\n"
+"  1 - allocate buffers for the receive rings on the NIC's node, and other "
+"buffers on the node of the thread that needs them.  When choosing a "
+"packet set, prefer one on the wanted node.\n"
+"Counters pkt_set_numa_remote and pkt_set_alloc_numa_remote in "
+"'onload_stackdump lots' show how often this could not be achieved.",
+          1, , 0, 0, 1, oneof:any;local)
+
 #if CI_CFG_PIO
 CI_CFG_OPT("EF_PIO", pio, ci_uint32,
 "Control of whether Programmed I/O is used instead of DMA for small packets:\n"
@@ -776,6 +924,17 @@ CI_CFG_OPT("EF_SHARE_WITH", share_with, ci_int32,
 "the stack.",
            , , 0, -1, SMAX, count)
 
+CI_CFG_OPT("EF_STACK_LINGER", stack_linger, ci_uint32,
+"Keep a named stack (see EF_NAME) alive for this many milliseconds after the "
+"last process using it has gone, so that the next process with the same "
+"EF_NAME attaches to it immediately rather than paying for the creation of a "
+"new stack.  This suits workloads which start many short-lived processes.  "
+"The stack keeps the options it was created with.\n"
+"The stack is destroyed between one and two times this interval after it "
+"becomes unused.  The default of 0 destroys a stack as soon as it is unused.  "
+"This option has no effect on unnamed and clustered stacks.",
+           , , 0, 0, 3600000, count)
+
 /* TODO EFCT allow 0 ring size for now for development purposes */
 CI_CFG_OPT("EF_RXQ_SIZE", rxq_size, ci_uint16,
 "Set the size of the receive descriptor ring.  Must be a power of two.  "
@@ -791,6 +950,19 @@ CI_CFG_OPT("EF_TXQ_SIZE", txq_size, ci_uint16,
 "or 4096.",
            , , 512, 512, 4096, bincount)
 
+#if CI_CFG_TX_VIS_MAX > 1
+CI_CFG_OPT("EF_TX_VIS", tx_vis, ci_uint16,
+"Number of transmit VIs to allocate on each interface.  Each socket sends "
+"on one of them, chosen by a hash of its remote address and port, so that "
+"threads sending on different sockets need not share a transmit queue and "
+"doorbell.  The extra VIs share the event queue of the first one.  PIO and "
+"CTPIO are used only by the first VI: sockets mapped to the other VIs "
+"always send by DMA.\n"
+"Values greater than 1 are supported only on EF10 and EF100 adapters, and "
+"are ignored when EF_TCP_OFFLOAD is enabled.",
+           , , 1, 1, CI_CFG_TX_VIS_MAX, count)
+#endif
+
 CI_CFG_OPT("EF_SEND_POLL_THRESH", send_poll_thresh, ci_uint16,
 "Poll for network events after sending this many packets."
 "\n"
@@ -810,6 +982,25 @@ CI_CFG_OPT("EF_UDP_SEND_UNLOCK_THRESH", udp_send_unlock_thresh, ci_uint16,
 "increase lock contention in multi-threaded applications.",
            , , 1500, MIN, MAX, count)
 
+CI_CFG_OPT("EF_NONB_POOL_REFILL", nonb_pool_refill, ci_uint16,
+"When a send that does not hold the stack lock finds the non-blocking pool "
+"of packet buffers empty, it takes the stack lock to allocate a buffer.  "
+"It then also moves this many free buffers to the non-blocking pool, so "
+"that sends from other threads can get buffers without taking the lock.  "
+"This reduces lock contention when several threads send on one stack.  "
+"0 disables.",
+           , , 32, MIN, MAX, count)
+
+CI_CFG_OPT("EF_PKT_MAGAZINE", pkt_magazine, ci_uint16,
+"Size of the per-thread caches of packet buffers used by sends that do not "
+"hold the stack lock.  When non-zero, such a send takes buffers from the "
+"non-blocking pool (see EF_NONB_POOL_REFILL) in batches of up to this many "
+"into a cache private to the calling thread, and allocates from that cache "
+"until it is empty.  This reduces contention on the shared pool when "
+"several threads send on one stack, at the cost of each thread holding up "
+"to this many buffers that other threads cannot use.  0 disables.",
+           , , 0, 0, 256, count)
+
 CI_CFG_OPT("EF_UDP_PORT_HANDOVER_MIN", udp_port_handover_min, ci_uint16,
 "When set (together with EF_UDP_PORT_HANDOVER_MAX), this causes UDP sockets "
 "explicitly bound to a port in the given range to be handed over to the "
@@ -865,6 +1056,14 @@ CI_CFG_OPT("EF_DYNAMIC_ACK_THRESH", dynack_thresh, ci_uint16,
            , , 16, 0, 65535, count)
 #endif
 
+CI_CFG_OPT("EF_TCP_ACK_BATCH", tcp_ack_batch, ci_uint32,
+"When enabled, pure ACKs generated while polling the stack are queued and "
+"posted to the NIC together at the end of the poll, with a single doorbell, "
+"rather than each being sent as soon as it is built.  This reduces the cost "
+"of acknowledging many connections that receive in the same poll, at the "
+"expense of the latency of the first ACKs in the batch.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_INVALID_ACK_RATELIMIT", oow_ack_ratelimit, ci_uint32,
 "Limit the rate of ACKs sent because of invalid incoming TCP packet, "
 "in milliseconds.  The limitation is applied per-socket.  "
@@ -877,7 +1076,13 @@ CI_CFG_OPT("EF_SOCKET_CACHE_MAX", sock_cache_max, ci_uint32,
 "Sets the maximum number of TCP sockets to cache for this stack.  When "
 "set > 0, OpenOnload will cache resources associated with sockets in order "
 "to improve connection set-up and tear-down performance.  This improves "
-"performance for applications that make new TCP connections at a high rate.",
+"performance for applications that make new TCP connections at a high rate."
+"\n"
+"Active-open (connect()ed) sockets can only be cached if they have no "
+"backing kernel socket, which requires them to use shared local ports (see "
+"EF_TCP_SHARED_LOCAL_PORTS) or scalable active filters, and not to be bound "
+"to a port explicitly.  Such sockets keep their file descriptor and avoid "
+"inserting filters of their own when reused.",
            , , 0, MIN, SMAX, count)
 
 CI_CFG_OPT("EF_PER_SOCKET_CACHE_MAX", per_sock_cache_max, ci_int32,
@@ -913,6 +1118,40 @@ CI_CFG_OPT("EF_DEFER_WORK_LIMIT", defer_work_limit, ci_uint16,
 "before we force the unlocked thread to block and wait for the lock",
            , , 32, MIN, MAX, count)
 
+CI_CFG_OPT("EF_LOCK_PROFILE", lock_profile, ci_uint32,
+"Record how long the stack lock is held and waited for at each place in "
+"Onload that takes it from user level, with histograms of the hold times.  "
+"The results are shown by \"onload_stackdump lock_profile\" and reset by "
+"\"onload_stackdump clear_stats\".  This adds a read of the cycle counter "
+"and a table lookup to every lock and unlock, so is meant for enabling "
+"briefly when diagnosing contention; it can be turned on and off in a "
+"running stack with \"onload_stackdump set_opt lock_profile 1\".",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_RX_LATENCY_HIST", rx_latency_hist, ci_uint32,
+"Record histograms of UDP receive latency: from the hardware timestamp to "
+"pickup by the poll, from there to enqueue on the socket, and from there to "
+"delivery to the application.  The results are shown by \"onload_stackdump "
+"rx_latency\" and reset by \"onload_stackdump clear_stats\".  This adds two "
+"reads of the cycle counter and an atomic increment of shared state to "
+"each datagram received, so is meant for enabling briefly; it can be "
+"turned on and off in a running stack with \"onload_stackdump set_opt "
+"rx_latency_hist 1\".",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_POLL_PROFILE", poll_profile, ci_uint32,
+"Once in every this many polls of the stack, record how many cycles are "
+"spent in each phase of the poll (handling events, the post-poll list, "
+"refilling the receive rings, pushing the transmit queues, loopback, "
+"timers and the rest) and how much of the event handling goes on each "
+"type of event.  The results are shown by \"onload_stackdump "
+"poll_profile\" and \"onload_remote_monitor poll_profile\", and reset "
+"by \"onload_stackdump clear_stats\".  A sampled poll reads the cycle "
+"counter a few times per phase and once per event.  It can be changed in a "
+"running stack with \"onload_stackdump set_opt poll_profile N\".  0 (the "
+"default) disables this.",
+           , , 0, 0, MAX, count)
+
 CI_CFG_OPT("EF_IRQ_CORE", irq_core, ci_int16,
 "Specify which CPU core interrupts for this stack should be handled on."
 "\n"
@@ -934,6 +1173,33 @@ CI_CFG_OPT("EF_IRQ_CHANNEL", irq_channel, ci_int16,
 "driver receive channel.",
 	   , , -1, -1, SMAX, count)
 
+CI_CFG_OPT("EF_IRQ_FOLLOW", irq_follow, ci_uint32,
+"Move this stack's interrupts to the core of the threads that block on its "
+"sockets.  When this many consecutive blocking receives, polls or epoll "
+"waits on the stack's sockets are made from the same core, and that core "
+"is not the one the interrupts are steered to, the interrupts are moved to "
+"it.  Packets that arrive while the application is blocked are then "
+"processed on the core that will read them."
+"\n"
+"Onload already steers each connection's packets to the stack that owns "
+"the socket, so it is the stack's interrupt that needs to follow the "
+"reader.  Moves are limited by EF_IRQ_FOLLOW_INTERVAL and "
+"EF_IRQ_FOLLOW_MAX, and are only possible where Onload owns the "
+"interrupts (see onload_stack_irq_set_core()).  This option has no effect "
+"when EF_IRQ_CORE or EF_IRQ_CHANNEL is set.  0 (the default) disables it.",
+           , , 0, 0, MAX, count)
+
+CI_CFG_OPT("EF_IRQ_FOLLOW_INTERVAL", irq_follow_interval, ci_uint32,
+"Minimum time in milliseconds between two moves of a stack's interrupts "
+"by EF_IRQ_FOLLOW, so that a stack whose readers wander between cores "
+"does not have its interrupt bounced between them.",
+           , , 100, 0, MAX, time:msec)
+
+CI_CFG_OPT("EF_IRQ_FOLLOW_MAX", irq_follow_max, ci_uint32,
+"Maximum number of times EF_IRQ_FOLLOW moves a stack's interrupts over "
+"the lifetime of the stack.",
+           , , 16, 0, MAX, count)
+
 CI_CFG_OPT("EF_RXQ_LIMIT", rxq_limit, ci_int32,
 "Maximum fill level for the receive descriptor ring.  This has no effect "
 "when it has a value larger than the ring size (EF_RXQ_SIZE).",
@@ -951,6 +1217,16 @@ CI_CFG_OPT("EF_SHARED_RXQ_NUM", shared_rxq_num, ci_int32,
 "available queues.",
            , , -1, -1, 7, count)
 
+CI_CFG_OPT("EF_POLL_PREFETCH", poll_prefetch, ci_uint32,
+"When polling the stack, handle the events in batches of up to this many, "
+"and before handling each batch prefetch, in turn, the headers of the "
+"packets it received, the filter table entries for their IPv4 TCP and UDP "
+"flows and the state of the sockets those entries refer to.  With many "
+"active sockets the cache misses for the packets of a batch then overlap, "
+"rather than being taken one after another.  Applies to NICs that deliver "
+"one event per packet.  0 (the default) disables this.",
+           , , 0, 0, 32, count)
+
 CI_CFG_OPT("EF_EVS_PER_POLL", evs_per_poll, ci_uint32,
 "Sets the number of hardware network events to handle before performing other "
 "work.  This is a hint for internal tuning, and the actual number handled "
@@ -978,6 +1254,10 @@ CI_CFG_OPT("EF_SPIN_USEC", spin_usec, ci_uint32,
            "" /* documented in opts_citp_def.h */,
            ,  poll_cycles, 0, MIN, MAX, time:usec)
 
+CI_CFG_OPT("EF_SPIN_ADAPT", spin_adapt, ci_uint32,
+           "" /* documented in opts_citp_def.h */,
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_BUZZ_USEC", buzz_usec, ci_uint32,
 "Sets the timeout in microseconds for lock buzzing options.  Set to zero to "
 "disable lock buzzing (spinning).  Will buzz forever if set to -1.  Also set "
@@ -1081,7 +1361,17 @@ CI_CFG_OPT("EF_MAX_ENDPOINTS", max_ep_bufs, ci_uint32,
 "accelerated."
 "\n"
 "Note: ~4 syn-receive states consume one endpoint, see also "
-"EF_TCP_SYNRECV_MAX.",
+"EF_TCP_SYNRECV_MAX."
+"\n"
+"Endpoint buffers are not allocated up front: a stack starts with one chunk "
+"of them and adds further chunks as sockets are created, mapping each into "
+"user space when it is first touched, so their memory follows the largest "
+"number of endpoints the stack has used rather than this limit.  The "
+"sock_buf_chunks line of 'onload_stackdump dump' shows how many have been "
+"added.  Chunks are not returned until the stack is destroyed.  Some "
+"smaller tables are sized from this limit when the stack is created, among "
+"them the software filter table and, unless EF_TCP_ISN_CACHE_SIZE is set, "
+"the ISN cache, so a large value still costs some memory in idle stacks.",
            , , CI_CFG_NETIF_MAX_ENDPOINTS, 4, CI_CFG_NETIF_MAX_ENDPOINTS_MAX,
            count)
 
@@ -1244,6 +1534,28 @@ CI_CFG_OPT("EF_TCP_MIN_CWND", min_cwnd, ci_uint32,
 "WARNING: Modifying this option may violate the TCP protocol.",
            ,  , 0, 0, SMAX, count)
 
+CI_CFG_OPT("EF_TCP_CONG_ALG", tcp_cong_alg, ci_uint32,
+"Selects the default congestion control algorithm for TCP sockets in this "
+"stack.  Individual sockets may override it with the TCP_CONGESTION "
+"socket option, using the names given here.\n"
+"onload-reno - the Onload default: NewReno/SACK recovery with RFC3465 "
+"window growth.\n"
+"cubic       - CUBIC window growth (RFC8312), more suitable for paths with "
+"a large bandwidth-delay product.\n"
+"bbr         - model-based BBR, which sizes the congestion window from "
+"the measured bottleneck bandwidth and minimum RTT rather than from loss.",
+           2, , 0, 0, 2, oneof:onload-reno;cubic;bbr)
+
+CI_CFG_OPT("EF_TCP_FLIGHT_RECORDER", tcp_flight_bufs, ci_uint32,
+"When non-zero, each TCP connection keeps a ring of its most recent "
+"events (segments received and sent, retransmits, RTOs, congestion "
+"window and peer window changes) with timestamps, recorded from the "
+"moment the connection is established.  onload_stackdump prints the "
+"ring with each socket, which helps to work out why a connection "
+"stalled.  The value is the size of the ring in aux buffers, each of "
+"which holds six events.  0 (the default) disables the recorder.",
+           8, , 0, 0, 16, count)
+
 #if CI_CFG_TCP_FASTSTART
 CI_CFG_OPT("EF_TCP_FASTSTART_INIT", tcp_faststart_init, ci_uint32,
 "The FASTSTART feature prevents Onload from delaying ACKs during times when "
@@ -1283,6 +1595,25 @@ CI_CFG_OPT("EF_TCP_EARLY_RETRANSMIT", tcp_early_retransmit, ci_uint32,
 "the default.",
            1, , 1, 0, 1, yesno)
 
+CI_CFG_OPT("EF_TCP_RACK", tcp_rack, ci_uint32,
+"Use RACK (RFC 8985) time-based loss detection on TCP connections that "
+"negotiate SACK.  Fast recovery is entered when a segment has been "
+"outstanding for longer than the RTT of a segment sent after it and since "
+"delivered, plus a reordering window, rather than after a number of "
+"duplicate ACKs.  This avoids spurious fast retransmits on paths that "
+"reorder packets.  Tail losses are probed by EF_TAIL_DROP_PROBE.",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_TCP_RTT_US", tcp_rtt_us, ci_uint32,
+"Estimate the RTT of TCP connections in microseconds, from the CPU cycle "
+"counter at the time each segment is sent and the time it is acknowledged, "
+"rather than in timer ticks from the TCP timestamp option or a single timed "
+"segment.  On short paths this gives a much smaller RTT variance, and so an "
+"RTO close to the real RTT, although the RTO is still a whole number of "
+"ticks and no less than EF_RFC_RTO_MIN, which must be lowered to benefit.  "
+"Retransmitted segments are not measured.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_RFC_RTO_INITIAL", rto_initial, ci_iptime_t,
 "Initial retransmit timeout in milliseconds.  i.e. The number of "
 "milliseconds to wait for an ACK before retransmitting packets.",
@@ -1388,6 +1719,20 @@ CI_CFG_OPT("EF_CTPIO_SWITCH_BYPASS", ctpio_switch_bypass, ci_uint32,
            1, , 0, 0, 1, yesno)
 #endif
 
+#if CI_CFG_TX_ADAPTIVE
+CI_CFG_OPT("EF_TX_ADAPTIVE", tx_adaptive, ci_uint32,
+"Choose between CTPIO, PIO and DMA for each send from measurements rather "
+"than by fixed preference.  When enabled, Onload measures the time from "
+"posting each packet to handling its completion, and counts PIO and CTPIO "
+"fallbacks, for each mechanism and each of several frame length buckets.  "
+"Where more than one mechanism is permitted for a packet (see EF_PIO, "
+"EF_PIO_THRESHOLD, EF_CTPIO and EF_CTPIO_MAX_FRAME_LEN), the one with the "
+"lowest expected latency is used, and the others are still tried "
+"occasionally so that their measurements stay current.  The decision table "
+"is shown by onload_stackdump.",
+           1, , 0, 0, 1, yesno)
+#endif
+
 CI_CFG_OPT("EF_TX_PUSH_THRESHOLD", tx_push_thresh, ci_uint16,
 "Sets a threshold for the number of outstanding sends before we stop using "
 "TX descriptor push.  This has no effect if EF_TX_PUSH=0.  This "
@@ -1395,6 +1740,28 @@ CI_CFG_OPT("EF_TX_PUSH_THRESHOLD", tx_push_thresh, ci_uint16,
 "hardware. It makes sense to set this value similar to EF_SEND_POLL_THRESH",
            , , 100, 1, MAX, count)
 
+CI_CFG_OPT("EF_TX_COALESCE", tx_coalesce, ci_uint32,
+"When enabled, DMA sends made while the stack is being polled (such as ACKs "
+"and data released by an opening congestion window) are queued rather than "
+"posted individually, and each VI's doorbell is rung once when the poll "
+"finishes.  This saves doorbell writes when one poll generates sends on "
+"many sockets, at the expense of the latency of the first of them.  Sends "
+"that go by PIO or CTPIO are not deferred, and nor are sends made directly "
+"by the application.  Latency-critical sockets can avoid the deferral "
+"altogether by being placed in a separate stack that does not set this "
+"option (see EF_NAME and onload_set_stackopt()).",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_TX_BULK_FILL_MAX", tx_bulk_fill_max, ci_uint32,
+"When non-zero, TCP data sent by sockets with the lowest priorities, "
+"TC_PRIO_BULK and TC_PRIO_FILLER (set with SO_PRIORITY, or derived from "
+"IP_TOS), is only posted to the TX ring while fewer than this many "
+"descriptors are in it.  The rest waits in a separate queue, which sends "
+"from other sockets do not wait behind, so that a burst of bulk data delays "
+"latency-critical sends by at most this many descriptors.  Zero disables "
+"this, and all sockets share the TX ring in the order they send.",
+           , , 0, 0, MAX, count)
+
 #define CI_EF_LOG_DEFAULT ((1 << EF_LOG_BANNER) | (1 << EF_LOG_RESOURCE_WARNINGS) | (1 << EF_LOG_CONFIG_WARNINGS) | (1 << EF_LOG_USAGE_WARNINGS))
 CI_CFG_OPT("EF_LOG", log_category, ci_uint32,
 "Designed to control how chatty Onload's informative/warning messages are.  "
@@ -1558,6 +1925,33 @@ CI_CFG_OPT("EF_PERIODIC_TIMER_CPU", periodic_timer_cpu, ci_int32,
            "periodic timer ticks."
            , , , -1, -1, SMAX, count)
 
+CI_CFG_OPT("EF_SHARED_POLL", shared_poll, ci_uint32,
+"Lets the onload module's shared poller thread poll this stack.  The thread "
+"is started when the shared_poll_cpu module option names a CPU, and polls "
+"the event queues of all stacks with this option set in turn, delivering "
+"events to their sockets.  Many small stacks can then be kept responsive by "
+"a single dedicated core while their application threads block, rather "
+"than each spinning or relying on interrupts."
+"\n"
+"The option has no effect unless shared_poll_cpu is set.  It can be "
+"combined with EF_INT_DRIVEN so that events arriving while the poller is "
+"busy with other stacks still raise an interrupt.",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_TIMER_CASCADE_BUDGET", timer_cascade_budget, ci_uint32,
+"Selects how the stack's hierarchical timer wheel moves timers down to "
+"lower levels of the wheel.\n"
+"When 0 (the default) all of the timers in a bucket are moved at once, when "
+"the bucket's time is reached.  With many thousands of sockets a bucket "
+"can hold a large fraction of all timers, and that poll is then stalled "
+"for the time needed to move them.\n"
+"When non-zero, each time the stack's clock advances up to this many timers "
+"are moved ahead of time from the next bucket of each level into buckets "
+"that the level below has already passed, so that little work is left to "
+"do when the bucket is reached.  The timer_poll_cycles_max and "
+"timer_cascade_max stack statistics show the effect.",
+           ,  , 0, 0, SMAX, count)
+
 #define CITP_SCALABLE_FILTERS_DISABLE 0
 #define CITP_SCALABLE_FILTERS_ENABLE  1
 #define CITP_SCALABLE_FILTERS_ENABLE_WORKER  2
@@ -1620,6 +2014,16 @@ CI_CFG_STR_OPT("EF_INTERFACE_BLACKLIST", iface_blacklist, ci_string256,
                "interface is present on both lists it will not be accelerated." ,
                ,  , "", none, none, )
 
+#if CI_CFG_TEAMING
+CI_CFG_OPT("EF_BOND_KERNEL_HASH", bond_kernel_hash, ci_uint32,
+"When sending through a bond or team with the layer3+4 transmit hash policy, "
+"choose the port with the same hash as the kernel's bonding driver, so that "
+"Onload and the kernel send each flow through the same port.  By default "
+"Onload uses a hash of its own that spreads flows with a predictable pattern "
+"of port numbers more evenly.",
+           1, , 0, 0, 1, yesno)
+#endif
+
 CI_CFG_OPT("EF_KERNEL_PACKETS_BATCH_SIZE", kernel_packets_batch_size, ci_uint32,
 "In some cases (for example, when using scalable filters), packets that "
 "should be delivered to the kernel stack are "
@@ -1671,6 +2075,20 @@ CI_CFG_OPT("EF_TCP_ISN_CACHE_SIZE", tcp_isn_cache_size, ci_uint32,
 "Relevant when EF_TCP_ISN_MODE is set to clocked+cache.",
            , , 0, MIN, MAX, time:sec)
 
+CI_CFG_OPT("EF_TCP_TIME_WAIT_COMPACT", tcp_tw_compact, ci_uint32,
+"Size of a table of compact TIME_WAIT connections.  When non-zero, a "
+"passively opened IPv4 connection that reaches TIME_WAIT after the "
+"application has closed it gives up its endpoint at the end of the poll, "
+"and is remembered in this table (rounded up to a power of two) until the "
+"TIME_WAIT period expires.  Retransmitted FINs are still acknowledged, "
+"old SYNs for the same four-tuple are still rejected and RSTs are handled "
+"as EF_TCP_TIME_WAIT_ASSASSINATION says, but the endpoint is "
+"free for new connections.  This helps servers with a high connection "
+"rate that would otherwise run out of endpoints (EF_MAX_ENDPOINTS).  "
+"Connections that cannot be compacted, or find the table full, keep their "
+"endpoint for TIME_WAIT as usual.  0 disables the table.",
+           , , 0, MIN, MAX, count)
+
 #if CI_CFG_IPV6
 #define CITP_IP6_AUTO_FLOW_LABEL_OFF     0
 #define CITP_IP6_AUTO_FLOW_LABEL_OPTOUT  1
@@ -28,6 +28,42 @@ extern ci_int32 ci_pio_buddy_alloc(ci_netif* ni, ci_pio_buddy_allocator*,
 extern void ci_pio_buddy_free(ci_netif* ni, ci_pio_buddy_allocator*,
                               ci_int32 offset, ci_uint8 order);
 
+/*! Allocate a block of at least 1 << *order bytes for a templated send on
+ * socket [sock_id], and update *order to the order of the block returned.
+ * The block is the one reserved for the socket if that is free and big
+ * enough; otherwise a new block is allocated and, if there is room, becomes
+ * the socket's reservation.  Freeing a reserved block with
+ * ci_pio_buddy_free() keeps it for the socket.
+ * Returns less than 0 (errno) on failure.
+ */
+extern ci_int32 ci_pio_buddy_alloc_reserved(ci_netif* ni,
+                                            ci_pio_buddy_allocator*,
+                                            oo_sp sock_id, ci_uint8* order);
+
+/*! Give up the reservation held by [sock_id], if any.  If the block is in
+ * use it is returned to the free lists when it is freed.  Returns true if
+ * there was a reservation.
+ */
+extern int ci_pio_buddy_unreserve(ci_netif* ni, ci_pio_buddy_allocator*,
+                                  oo_sp sock_id);
+
+/*! Returns true if ci_pio_buddy_relocate() might be able to reduce
+ * fragmentation.
+ */
+extern int ci_pio_buddy_can_compact(ci_netif* ni, ci_pio_buddy_allocator*);
+
+/*! Move an allocated block, if by doing so its buddy can merge with the
+ * space it leaves.  Returns the new offset of the block, which is [offset]
+ * if it was not moved.  The caller is responsible for copying the contents.
+ */
+extern ci_int32 ci_pio_buddy_relocate(ci_netif* ni, ci_pio_buddy_allocator*,
+                                      ci_int32 offset, ci_uint8 order);
+
+/*! Relocate reservations that are not in use.  Returns true if any moved.
+ */
+extern int ci_pio_buddy_compact_reserved(ci_netif* ni,
+                                         ci_pio_buddy_allocator*);
+
 
 #endif  /* __CI_INTERNAL_PIO_BUDDY_H__ */
 
@@ -68,6 +68,14 @@ OO_STAT("Number of network events handled by periodic timer.  Indicates your "
 OO_STAT("Number of times periodic timer could not get the stack lock.  "
         "Not severe.",
         ci_uint32, periodic_lock_contends, count)
+OO_STAT("Number of times the shared poller thread has polled this stack "
+        "and found events (see EF_SHARED_POLL).",
+        ci_uint32, shared_polls, count)
+OO_STAT("Number of network events handled by the shared poller thread.",
+        ci_uint32, shared_poll_evs, count)
+OO_STAT("Number of times the shared poller thread found events but could "
+        "not get the stack lock.  The lock holder will handle them.",
+        ci_uint32, shared_poll_lock_contends, count)
 OO_STAT("Number of interrupts.  Expected if interrupt driven; otherwise "
         "suggests timeout of one kind or another.",
         ci_uint32, interrupts, count)
@@ -140,6 +148,9 @@ OO_STAT("Times a thread has blocked on a single socket.",
         ci_uint32, sock_sleeps, count)
 OO_STAT("Times a thread has enabled interrupts before blocking on a socket.",
         ci_uint32, sock_sleep_primes, count)
+OO_STAT("Times EF_IRQ_FOLLOW moved the stack's interrupts to the core of a "
+        "blocking reader.",
+        ci_uint32, irq_follow_moves, count)
 OO_STAT("Times Onload has woken threads waiting on a socket for receive.",
         ci_uint32, sock_wakes_rx, count)
 OO_STAT("Times Onload has woken threads waiting on a socket for transmit.",
@@ -163,6 +174,29 @@ OO_STAT("Indicates that we've reclaimed from the pkt_nonb (e.g. due to "
         "memory pressure; but may be just contention with the ring refill "
         "path).  Check for memory_pressure.",
         ci_uint32, pkt_nonb_steal, count)
+OO_STAT("Number of packet buffers put on the nonb pool by a send that had "
+        "to take the stack lock because the pool was empty.  See "
+        "EF_NONB_POOL_REFILL.",
+        ci_uint32, pkt_nonb_refill, count)
+OO_STAT("Number of batches of packet buffers moved from the nonb pool to "
+        "a per-thread cache.  See EF_PKT_MAGAZINE.",
+        ci_uint32, pkt_mag_refill, count)
+OO_STAT("Number of packet buffers allocated from a per-thread cache.",
+        ci_uint32, pkt_mag_alloc, count)
+OO_STAT("Number of packet buffers returned from per-thread caches to the "
+        "nonb pool, either because a batch was larger than the cache or "
+        "because the process forked, exec()ed or stopped using the stack.",
+        ci_uint32, pkt_mag_drain, count)
+OO_STAT("Number of blocking waits with EF_SPIN_ADAPT enabled that were "
+        "satisfied while spinning.",
+        ci_uint32, spin_adapt_hit, count)
+OO_STAT("Number of blocking waits with EF_SPIN_ADAPT enabled that spun "
+        "until the spin time ran out, and then slept.",
+        ci_uint32, spin_adapt_miss, count)
+OO_STAT("Number of blocking waits for which EF_SPIN_ADAPT chose not to "
+        "spin, because recent waits on the same socket mostly outlasted "
+        "the spin time.",
+        ci_uint32, spin_adapt_skip, count)
 OO_STAT("Times we've woken threads waiting for free packet buffers.  Can "
         "occur during memory_pressure.",
         ci_uint32, pkt_wakes, count)
@@ -175,6 +209,10 @@ OO_STAT("Number of times we've scrambled (l1) to find free buffers.  "
 OO_STAT("Number of times we've scrambled (l2) to find free buffers.  "
         "Indication of severe memory_pressure.",
         ci_uint32, pkt_scramble2, count)
+OO_STAT("Number of packet buffers freed while scrambling from TCP sockets "
+        "holding more than EF_MAX_RX_PACKETS >> EF_TCP_SOCKBUF_MAX_FRACTION "
+        "receive buffers.  These sockets are tried before all others.",
+        ci_uint32, pkt_scramble_hog_freed, count)
 OO_STAT("Number of times something tried to allocate memory, and "
         "span, waiting to do so.",
         ci_uint32, pkt_wait_spin, count)
@@ -214,6 +252,15 @@ OO_STAT("Times a thread has spun waiting for the stack lock.  Indication of "
         "contention (not high) wanted to take the lock; smoething else had "
         "it, so it retried for a while.  See  EF_BUZZ_USEC.",
         ci_uint32, stack_lock_buzz, count)
+OO_STAT("Times a thread had to wait for the stack lock, by spinning or by "
+        "blocking, because it could not defer its work to the lock holder.",
+        ci_uint32, stack_lock_waits, count)
+OO_STAT("Total time threads have spent waiting for the stack lock, in CPU "
+        "cycles.  Divide by stack_lock_waits for the mean wait.",
+        ci_uint64, stack_lock_wait_cycles, count)
+OO_STAT("Longest time a thread has waited for the stack lock, in CPU "
+        "cycles.",
+        ci_uint32, stack_lock_wait_cycles_max, val)
 OO_STAT("Times work has been done by the lock holder for another thread.  "
         "This is a mitigation mechanism for contention - which means that "
         "multiple threads are accessing this stack simultaneously.",
@@ -228,6 +275,12 @@ OO_STAT("Number of times TCP sendmsg() contended the stack lock.",
         ci_uint32, tcp_send_ni_lock_contends, count)
 OO_STAT("Number of times TCP sendmsg() failed to find an acceleratable route.",
         ci_uint32, tcp_send_fail_noroute, count)
+#if CI_CFG_TEAMING
+OO_STAT("Number of times a route through a bond or team moved to a different "
+        "port.  Each failover of an active-backup bond adds one per socket "
+        "sending through it.",
+        ci_uint32, bond_tx_port_switches, count)
+#endif
 OO_STAT("Number of times UDP sendmsg() contended the stack lock.",
         ci_uint32, udp_send_ni_lock_contends, count)
 OO_STAT("Number of times getsockopt() contended the stack lock.",
@@ -304,6 +357,21 @@ OO_STAT("Number of slots occupied in IPv6 software-filter hash table.",
 OO_STAT("Number of retransmit timeouts, across all TCP sockets that stack "
         "has had.",
         ci_uint32, tcp_rtos, count)
+OO_STAT("Longest time spent running the timer wheel in a single poll, in "
+        "CPU cycles.  Includes the time spent in timer callbacks.",
+        ci_uint32, timer_poll_cycles_max, val)
+OO_STAT("Largest number of timers moved down the timer wheel when a bucket's "
+        "time was reached, in a single poll.  See EF_TIMER_CASCADE_BUDGET.",
+        ci_uint32, timer_cascade_max, val)
+OO_STAT("Number of timers moved down the timer wheel ahead of time.  See "
+        "EF_TIMER_CASCADE_BUDGET.",
+        ci_uint32, timer_cascade_early, count)
+OO_STAT("Number of times TCP transmit was limited by SO_MAX_PACING_RATE or "
+        "by the congestion control module's pacing rate.",
+        ci_uint32, tcp_tx_stop_pacing, count)
+OO_STAT("Number of times UDP sendmsg() waited, or failed with EAGAIN, "
+        "because of SO_MAX_PACING_RATE.",
+        ci_uint32, udp_tx_paced, count)
 #if CI_CFG_TAIL_DROP_PROBE
 OO_STAT("Number of tail-drop probes sent from retransmit queue.",
         ci_uint32, tail_drop_probe_retrans, count)
@@ -440,6 +508,24 @@ OO_STAT("We received a SYN, but we don't have an accelerated outgoing route "
 OO_STAT("Number of times a LISTEN socket has started a new half-open socket"
         "(in the listen queue; the SYN-RECV state)",
         ci_uint32, listen2synrecv, count)
+OO_STAT("Number of SYNs answered with a syncookie by LISTEN sockets in "
+        "this stack, rather than starting a half-open socket",
+        ci_uint32, listen2syncookie, count)
+OO_STAT("Number of SYN-ACKs sent with a TCP Fast Open cookie.",
+        ci_uint32, tfo_cookie_sent, count)
+OO_STAT("Number of connections accepted by LISTEN sockets with the data in "
+        "the SYN, thanks to a valid TCP Fast Open cookie.",
+        ci_uint32, tfo_passive, count)
+OO_STAT("Number of SYNs with data refused by LISTEN sockets because of a bad "
+        "or missing TCP Fast Open cookie.  The data is retransmitted by the "
+        "client once the connection is established.",
+        ci_uint32, tfo_passive_fail, count)
+OO_STAT("Number of connections opened with data in the SYN using a cached "
+        "TCP Fast Open cookie.",
+        ci_uint32, tfo_active, count)
+OO_STAT("Number of connections opened with data in the SYN which the server "
+        "did not accept, so had to be retransmitted.",
+        ci_uint32, tfo_active_fail, count)
 OO_STAT("Number of times a socket has moved from the SYN-RECV state to the "
         "fully ESTABLISHED state.",
         ci_uint32, synrecv2established, count)
@@ -447,6 +533,9 @@ OO_STAT("Number of times accept() was accelerated.",
         ci_uint32, ul_accepts, count)
 OO_STAT("Number of times accept() returned EAGAIN.",
         ci_uint32, accept_eagain, count)
+OO_STAT("Times accept() found another thread popping the accept queue and "
+        "waited for it without sleeping on the socket lock.",
+        ci_uint32, accept_lock_contended, count)
 OO_STAT("Number of failed aux-buffer allocations.",
         ci_uint32, aux_alloc_fails, count)
 OO_STAT("Number of failed bucket-aux-buffer allocations.",
@@ -459,6 +548,9 @@ OO_STAT("Times that accept() was called, but as a result of the "
 OO_STAT("Number of times we have sent a pure ACK packet.  Indicates that we "
         "are receiving data substantially more often than we are sending any.",
         ci_uint32, acks_sent, count)
+OO_STAT("Number of pure ACKs queued to be posted together at the end of a "
+        "poll (EF_TCP_ACK_BATCH).",
+        ci_uint32, acks_batched, count)
 OO_STAT("Number of TCP window updates sent.",
         ci_uint32, wnd_updates_sent, count)
 OO_STAT("This means that Onload received a packet, and had to do something "
@@ -466,6 +558,10 @@ OO_STAT("This means that Onload received a packet, and had to do something "
         "(indicates TCP where we have to update state machinery, reset "
         "timers, update windows, send out ACKs etc.)",
         ci_uint32, rx_slow, count)
+OO_STAT("Number of TCP segments delivered without a filter table lookup, "
+        "because they followed an in-order segment of the same connection "
+        "in the same poll.",
+        ci_uint32, rx_tcp_flow_hit, count)
 OO_STAT("Packets arrived out of the expected sequence.  This could indicate "
         "loss or re-ordering in the network.",
         ci_uint32, rx_out_of_order, count)
@@ -548,6 +644,24 @@ OO_STAT("Entering the low-memory state that will cause rx_refill_recv.",
         ci_uint32, reap_buf_limited, count)
 OO_STAT("Number of packet buffers reclaimed by reaping.",
         ci_uint32, pkts_reaped, count)
+OO_STAT("Number of packet buffers freed from idle TCP sockets by the "
+        "EF_TCP_IDLE_RECLAIM_MS sweep.",
+        ci_uint32, tcp_idle_reclaimed, count)
+#if CI_CFG_IP_REASM
+OO_STAT("Number of IPv4 fragments taken for reassembly in the stack.",
+        ci_uint32, ip_reasm_frags, count)
+OO_STAT("Number of datagrams reassembled in the stack.",
+        ci_uint32, ip_reasm_ok, count)
+OO_STAT("Number of incomplete datagrams dropped because they were not "
+        "complete within EF_IP_REASM_TIMEOUT_MS.",
+        ci_uint32, ip_reasm_timeouts, count)
+OO_STAT("Number of incomplete datagrams dropped to stay within "
+        "EF_IP_REASM_MAX_PKTS, or for lack of a free reassembly slot.",
+        ci_uint32, ip_reasm_evicted, count)
+OO_STAT("Number of datagrams dropped during reassembly because their "
+        "fragments overlapped or disagreed, or their UDP checksum was bad.",
+        ci_uint32, ip_reasm_bad, count)
+#endif
 OO_STAT("We wanted to refill the RX ring, but lacked available buffers to "
         "do so.  This is likely to lead to nodesc drops at the interface.",
         ci_uint32, refill_rx_limited, count)
@@ -569,6 +683,12 @@ OO_STAT("Indicates that you're sending faster than we can push packets on to "
         ci_uint32, tx_dma_max, val)
 OO_STAT("Number of TX DMA doorbells.",
         ci_uint32, tx_dma_doorbells, count)
+OO_STAT("Number of times a DMA send made while polling was held back so that "
+        "its doorbell could be rung at the end of the poll (EF_TX_COALESCE).",
+        ci_uint32, tx_coalesce_deferred, count)
+OO_STAT("Number of TCP packets from bulk sockets that waited in the bulk queue "
+        "because EF_TX_BULK_FILL_MAX descriptors were already in the TX ring.",
+        ci_uint32, tx_bulk_queued, count)
 OO_STAT("Unable to allocate more packet buffers.  It's possible that this is "
         "transient; or due to needing memory in a context where allocating "
         "is forbidden.  It's also posisble we're about to enter "
@@ -584,6 +704,13 @@ OO_STAT("Number of attempts to allocate packet buffer set which have failed "
         "unlikely for this to increment multiple times.  To resolve this, "
         "make huge pages available, or look into EF_PACKET_BUFFER_MODE.",
         ci_uint32, bufset_alloc_nospace, count)
+OO_STAT("Number of times a packet set on another NUMA node was used because "
+        "no set on the wanted node had enough free buffers.  See "
+        "EF_PKT_NUMA.",
+        ci_uint32, pkt_set_numa_remote, count)
+OO_STAT("Number of packet sets whose memory was allocated on a different "
+        "NUMA node from the one requested.  See EF_PKT_NUMA.",
+        ci_uint32, pkt_set_alloc_numa_remote, count)
 OO_STAT("Something has requested a larger MSS than we can support in a "
         "single packet buffer; so we've reduced it.  The maximum mss has "
         "multiple possibilities depending on card version.  "
@@ -640,8 +767,12 @@ OO_STAT("Number of times CTPIO has been used to send a packet",
 OO_STAT("Number of times CTPIO transmits have fallen back to DMA",
         ci_uint32, ctpio_dma_fallbacks, count)
 #endif
-OO_STAT("Number of calls to sendpage() for a connected TCP socket.",
+OO_STAT("Number of calls to sendpage(), or batches of pages spliced, for a "
+        "connected TCP socket.",
         ci_uint32, tcp_sendpages, count)
+OO_STAT("Number of received TCP segments moved by onload_zc_forward() onto "
+        "another socket's send queue without copying.",
+        ci_uint32, tcp_zc_forward_pkts, count)
 OO_STAT("TCP wants to reply; (e.g. sending an ACK) was not able to re-use "
         "the packet buffer (e.g. because it contains data that the "
         "application has not yet consumed) and was further unable to "
@@ -688,6 +819,9 @@ OO_STAT("Number of passive sockets not cached owing to stack limit.  "
 OO_STAT("Number of active sockets not cached owing to stack limit  "
         "See EF_SOCKET_CACHE_MAX",
         ci_uint32, active_sockcache_stacklim, count)
+OO_STAT("Number of active sockets not cached as having a backing socket, "
+        "which happens when they do not use EF_TCP_SHARED_LOCAL_PORTS",
+        ci_uint32, active_sockcache_os_backed, count)
 #if ! CI_CFG_IPV6
 OO_STAT("Number of active sockets not cached as being non-IPv4",
         ci_uint32, active_sockcache_non_ip4, count)
@@ -752,6 +886,13 @@ OO_STAT("Number of times when TCP SO_RCVBUF value was found to be abused "
         "by too small incoming segments even after taking measures "
         "against it",
         ci_uint32, tcp_rcvbuf_abused_badly, count)
+OO_STAT("Number of times EF_TCP_RCVBUF_MODE=1 grew the receive buffer of a "
+        "TCP socket to match the data delivered per RTT.",
+        ci_uint32, tcp_rcvbuf_drs_grows, count)
+OO_STAT("Number of times EF_TCP_RCVBUF_MODE=1 wanted to grow the receive "
+        "buffer of a TCP socket but was held back by "
+        "EF_TCP_SOCKBUF_MAX_FRACTION or by memory pressure.",
+        ci_uint32, tcp_rcvbuf_drs_capped, count)
 OO_STAT("Number of times when TCP listening socket failed to retransmit "
         "SYNACK because it failed to allocate more packet buffers "
         "(probably postponing packet buffers allocation).",
@@ -790,6 +931,10 @@ OO_STAT("Number of times that we rejected a shared local port for any reason.",
 OO_STAT("Number of times that we rejected a shared local port because it "
         "would have resulted in a duplicate four-tuple.",
         ci_uint32, tcp_shared_local_ports_skipped_in_use, count)
+OO_STAT("Number of times that we rejected a shared local port because the "
+        "resulting four-tuple would be spread by RSS to a different stack in "
+        "the cluster.",
+        ci_uint32, tcp_shared_local_ports_skipped_rss, count)
 OO_STAT("Number of active-opened connections which require at least one "
         "SYN retransmission.",
         ci_uint32, tcp_syn_retrans_once, count)
@@ -851,6 +996,24 @@ OO_STAT("Number of insertions with short expiry.",
 OO_STAT("Number of times there was no need to create entry.",
         ci_uint32, tcp_seq_table_avoided, count)
 
+OO_STAT("Number of TIME_WAIT connections that gave up their endpoint for an "
+        "entry in the compact TIME_WAIT table (EF_TCP_TIME_WAIT_COMPACT).",
+        ci_uint32, tcp_tw_compact, count)
+OO_STAT("Number of TIME_WAIT connections that kept a full endpoint.",
+        ci_uint32, tcp_tw_full, count)
+OO_STAT("Number of TIME_WAIT connections that kept a full endpoint because "
+        "the compact TIME_WAIT table had no room near their hash.",
+        ci_uint32, tcp_tw_compact_no_room, count)
+OO_STAT("Number of segments answered with an ACK from a compact TIME_WAIT "
+        "entry.",
+        ci_uint32, tcp_tw_compact_acks, count)
+OO_STAT("Number of SYNs that ended a compact TIME_WAIT entry by reusing its "
+        "four-tuple.",
+        ci_uint32, tcp_tw_compact_reuse, count)
+OO_STAT("Number of small TCP segments copied onto the previous packet in the "
+        "receive queue, freeing their packet buffer (EF_TCP_RX_COPYBREAK).",
+        ci_uint32, tcp_rx_copybreak, count)
+
 OO_STAT("Number of times the urgent flag was ignored in received packets",
         ci_uint32, tcp_urgent_ignore_rx, count)
 OO_STAT("Number of times the urgent flag was processed in received packets",
@@ -59,6 +59,13 @@
 #define CI_CFG_CONG_NOTIFY_THRESH 24
 #endif
 
+/* USDT probe points at user level (see ci/internal/ip_probes.h).  These
+ * cost a nop each when not in use, so are on by default where <sys/sdt.h>
+ * is available. */
+#ifndef CI_CFG_USDT_PROBES
+#define CI_CFG_USDT_PROBES		1
+#endif
+
 /* Debug aids.  Off by default, as some add lots of overhead. */
 #ifndef CI_CFG_RANDOM_DROP
 #define CI_CFG_RANDOM_DROP		0
@@ -446,6 +453,28 @@
 #define CI_CFG_SPIN_STATS 1
 #endif
 
+/* Per-netif histograms of UDP receive latency, from hardware timestamp to
+ * pickup by the poll, from the poll to enqueue on the socket, and from there
+ * to delivery to the application, when enabled by EF_RX_LATENCY_HIST. */
+#define CI_CFG_RX_LATENCY_HIST 1
+
+/* Per-netif profile of how long the stack lock is held and waited for, by
+ * the source line that took it, when EF_LOCK_PROFILE is set.  Only
+ * user-level lockers are profiled.  With the option clear this costs a test
+ * of the option each time the lock is taken or dropped. */
+#define CI_CFG_LOCK_PROFILE 1
+
+/* Per-netif breakdown of the cycles spent in ci_netif_poll_n() by phase and
+ * by event type, for one in every EF_POLL_PROFILE polls.  With the option
+ * clear this costs a test of the option in each poll. */
+#define CI_CFG_POLL_PROFILE 1
+
+/* Reassembly of fragmented IPv4 UDP datagrams in the stack, when
+ * EF_IP_REASM_MAX_PKTS is set.  CI_CFG_IP_REASM_SLOTS bounds the number of
+ * datagrams that can be under reassembly at once. */
+#define CI_CFG_IP_REASM 1
+#define CI_CFG_IP_REASM_SLOTS 32
+
 /* Size of packet buffers.  Must be 2048 or 4096.  The larger value reduces
  * overhead when packets are large, but wastes memory when they aren't.
  */
@@ -480,6 +509,17 @@
 #define CI_CFG_DUMPQUEUE_LEN 128
 #endif /* CI_CFG_TCPDUMP */
 
+/* Sampling of 1 in N packets into a ring of copies in the stack, for
+ * continuous capture (onload_tcpdump --sample) without holding packets. */
+#define CI_CFG_PKT_SAMPLE CI_CFG_TCPDUMP
+
+#if CI_CFG_PKT_SAMPLE
+/* Sample ring length, should be 2^x */
+#define CI_CFG_PKT_SAMPLE_RING_LEN 64
+/* Maximum bytes copied from each sampled frame */
+#define CI_CFG_PKT_SAMPLE_SNAPLEN  128
+#endif
+
 
 /* Support for reducing ACK rate at high throughput to improve efficiency */
 #define CI_CFG_DYNAMIC_ACK_RATE 1
@@ -513,6 +553,11 @@
  * set. */
 #define CI_CFG_PKT_SET_HIGH_WATER (PKTS_PER_SET - PKTS_PER_SET / 32)
 
+/* Number of per-thread packet caches each process keeps for each stack (see
+ * EF_PKT_MAGAZINE).  Threads beyond this number share them.  Must be a
+ * power of 2. */
+#define CI_CFG_PKT_MAGAZINES      16
+
 /* Whether to include code to transmit small packets via PIO */
 #define CI_CFG_PIO 1
 #define CI_CFG_MIN_PIO_BLOCK_ORDER 7
@@ -520,6 +565,10 @@
 /* Whether to include code to transmit packets via CTPIO */
 #define CI_CFG_CTPIO 1
 
+/* Whether to include code to choose between DMA, PIO and CTPIO at runtime
+ * from measured completion latency (see EF_TX_ADAPTIVE) */
+#define CI_CFG_TX_ADAPTIVE 1
+
 /* How many epolls sets will have a ready list maintained by the stack */
 #define CI_CFG_EPOLL1_SETS_PER_STACK 4
 /* How many ready lists are maintained */
@@ -559,6 +608,12 @@
  * to enable whatever application-specific processing it has. */
 #define CI_CFG_TCP_PLUGIN_EXTRA_VIS 0
 
+/* Maximum number of VIs per interface that a stack may use to transmit
+ * ordinary traffic.  Sockets are spread over them so that sends on disjoint
+ * sets of sockets do not share a TXQ and doorbell.  See EF_TX_VIS.  Set to
+ * 1 to remove support. */
+#define CI_CFG_TX_VIS_MAX 4
+
 #ifdef NDEBUG
 /* When using a SmartNIC plugin which can cause complex data to be received by
  * the host (e.g. pointers to non-local memory regions), implement recv().
@@ -79,6 +79,9 @@ struct ci_tcp_info
   ci_uint32 tcpi_rcv_space;
 
   ci_uint32 tcpi_total_retrans;
+
+  ci_uint64 tcpi_pacing_rate;
+  ci_uint64 tcpi_max_pacing_rate;
 };
 
 #endif /* __CI_NET_SOCKOPTS_H__ */
@@ -15,12 +15,30 @@
 #ifndef __CI_TOOLS_CRC32C_H__
 #define __CI_TOOLS_CRC32C_H__
 
+/* Add [buflen] bytes to a CRC32C.  There is no inversion on the way in or
+ * out; see ci_crc32c(). */
 extern ci_uint32 ci_crc32c_partial(const ci_uint8 *buf, ci_uint32 buflen,
                                    ci_uint32 crc);
 
 extern ci_uint32 ci_crc32c_partial_copy(ci_uint8 *dest, const ci_uint8 *buf,
                                         ci_uint32 buflen, ci_uint32 crc);
 
+/* As above, but never use SIMD instructions. */
+extern ci_uint32 ci_crc32c_partial_c(const ci_uint8 *buf, ci_uint32 buflen,
+                                     ci_uint32 crc);
+
+extern ci_uint32 ci_crc32c_partial_copy_c(ci_uint8 *dest, const ci_uint8 *buf,
+                                          ci_uint32 buflen, ci_uint32 crc);
+
+/* At user level on x86_64 the SSE4.2 crc32 instruction is used when the
+ * CPU has it. */
+#if ! defined(__KERNEL__) && defined(__x86_64__)
+# define CI_CRC32C_SSE42  1
+extern int ci_crc32c_sse42_ok(void);
+#else
+# define CI_CRC32C_SSE42  0
+#endif
+
 ci_inline ci_uint32 ci_crc32c(const ci_uint8 *buf, ci_uint32 buflen)
 {
   return ~ci_crc32c_partial(buf, buflen, 0xffffffff);
@@ -90,6 +90,13 @@ extern int ci_copy_iovec(void* dest, int dest_len, ci_iovec_ptr* src) CI_HF;
 extern int ci_copy_to_iovec(ci_iovec_ptr* dest, const void* src,
 			    int src_len) CI_HF;
 
+#ifndef __KERNEL__
+  /*! As memcpy(), but using non-temporal stores where the CPU has them,
+  ** so that [dest] is not pulled into the cache.
+  */
+extern void ci_memcpy_nt(void* dest, const void* src, size_t len) CI_HF;
+#endif
+
 
 ci_inline int ci_iovec_bytes(const ci_iovec* iov, int iovlen) {
   int n = 0;
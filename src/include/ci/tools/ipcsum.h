@@ -249,6 +249,35 @@ extern unsigned ci_ip_csum_copy_asm(void* dest, const void* src,
 extern unsigned ci_ip_csum_copy2(void* dest, const void* src,
 				 int n, unsigned sum) CI_HF;
 
+  /*! As ci_ip_csum_copy2(), but never uses SIMD instructions. */
+extern unsigned ci_ip_csum_copy2_c(void* dest, const void* src,
+				   int n, unsigned sum) CI_HF;
+
+
+/* At user level on x86_64, checksums of larger buffers use AVX2 when the
+ * CPU has it. */
+#if ! defined(__KERNEL__) && defined(__x86_64__)
+# define CI_IP_CSUM_AVX2      1
+#else
+# define CI_IP_CSUM_AVX2      0
+#endif
+/* Buffers shorter than this are not worth vectorising. */
+#define CI_IP_CSUM_AVX2_MIN   64
+
+#if CI_IP_CSUM_AVX2
+  /*! Whether the AVX2 checksum routines below can be used on this CPU. */
+extern int ci_ip_csum_avx2_ok(void) CI_HF;
+
+  /*! AVX2 implementations of ci_ip_csum_partial() and ci_ip_csum_copy2().
+  ** [bytes] and [n] must be multiples of 32.  The returned sum is folded
+  ** to 16 bits.
+  */
+extern unsigned ci_ip_csum_partial_avx2(unsigned sum, const void* buf,
+					int bytes) CI_HF;
+extern unsigned ci_ip_csum_copy2_avx2(void* dest, const void* src, int n,
+				      unsigned sum) CI_HF;
+#endif
+
 
   /*! Copy from [src] to [dest] whilst checksumming. If [dest] is not
   ** aligned on a 2-byte boundary from start of checksum then
@@ -27,3 +27,7 @@ extern unsigned ci_ip_checksum(const struct ci_ip4_hdr_s* ip) CI_HF;
   */
 extern unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
 				   int bytes) CI_HF;
+
+/*! As ci_ip_csum_partial(), but never uses SIMD instructions. */
+extern unsigned ci_ip_csum_partial_c(unsigned sum, const volatile void* in_buf,
+				     int bytes) CI_HF;
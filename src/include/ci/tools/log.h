@@ -225,6 +225,44 @@ extern void ci_log_buffer_till_fail(void) CI_HF;
 extern void ci_log_buffer_dump(void) CI_HF;
 
 
+#ifndef __KERNEL__
+/**********************************************************************
+ * Binary logging (src/citools/log_binary.c)
+ *
+ * ci_blog(fmt, ...) records [fmt] and up to CI_BLOG_MAX_ARGS integer or
+ * pointer arguments in a per-thread ring without formatting them, for a
+ * fraction of the cost of ci_log().  [fmt] must be a string literal and
+ * must use long-sized conversions (%lu, %lx, %p); the records are
+ * formatted later by ci_blog_dump().  ci_blog() does nothing until
+ * ci_blog_till_exit() has been called.
+ */
+
+#define CI_BLOG_MAX_ARGS  6
+
+extern int ci_blog_enabled CI_HV;
+
+extern void __ci_blog(const char* fmt, unsigned long a0, unsigned long a1,
+                      unsigned long a2, unsigned long a3, unsigned long a4,
+                      unsigned long a5) CI_HF;
+
+#define __ci_blog6(fmt, a0, a1, a2, a3, a4, a5, ...)                    \
+  __ci_blog((fmt), (unsigned long) (a0), (unsigned long) (a1),          \
+            (unsigned long) (a2), (unsigned long) (a3),                 \
+            (unsigned long) (a4), (unsigned long) (a5))
+
+#define ci_blog(...)                                                    \
+  do{ if(CI_UNLIKELY( ci_blog_enabled ))                                \
+        __ci_blog6(__VA_ARGS__, 0, 0, 0, 0, 0, 0);                      \
+  }while(0)
+
+/*! Enable ci_blog(), and dump the records on ci_fail() and at exit. */
+extern void ci_blog_till_exit(void) CI_HF;
+
+/*! Format all threads' new binary log records with ci_log(). */
+extern void ci_blog_dump(void) CI_HF;
+#endif
+
+
 /**********************************************************************
  * Some useful pretty-printing.
  */
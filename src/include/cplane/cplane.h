@@ -223,6 +223,13 @@ __oo_cp_route_resolve(struct oo_cplane_handle* cp,
                     struct cp_fwd_data* data,
                     cp_fwd_table_id fwd_table_id);
 
+/* Ask the server to add the route for [key] to the fwd table, without
+ * waiting for it to do so.  Returns 0 if the route is already there, or 1
+ * if it has been requested. */
+extern int
+oo_cp_route_prefetch(struct oo_cplane_handle* cp, struct cp_fwd_key* key,
+                     cp_fwd_table_id fwd_table_id);
+
 static inline int
 oo_cp_verinfo_is_valid(struct oo_cplane_handle* cp,
                        cicp_verinfo_t* verinfo,
@@ -541,6 +548,8 @@ oo_cp_ifindex_to_ip(struct oo_cplane_handle* cp, ci_ifid_t ifindex)
 #define CICP_HASH_STATE_FLAGS_IS_IP      0x1
 #define CICP_HASH_STATE_FLAGS_IS_TCP_UDP 0x2
 #define CICP_HASH_STATE_FLAGS_IS_FRAG    0x4
+/* Hash as the kernel's bonding driver does, rather than with our own hash */
+#define CICP_HASH_STATE_FLAGS_KERNEL     0x8
 
 struct cicp_hash_state {
   int flags;
@@ -569,8 +578,33 @@ ci_inline int cicp_layer23_hash(struct cicp_hash_state *hs, int num_slaves)
     return cicp_layer2_hash(hs, num_slaves);
 }
 
+/* The layer3+4 hash of the kernel's bonding driver (bond_xmit_hash()) */
+ci_inline int cicp_kernel_layer34_hash(struct cicp_hash_state *hs,
+                                       int num_slaves)
+{
+  ci_uint16 ports[2] = { 0, 0 };
+  ci_uint32 hash;
+
+  if( !(hs->flags & CICP_HASH_STATE_FLAGS_IS_FRAG) &&
+      (hs->flags & CICP_HASH_STATE_FLAGS_IS_TCP_UDP) ) {
+    ports[0] = hs->src_port_be16;
+    ports[1] = hs->dst_port_be16;
+  }
+  /* The kernel takes both ports as one word, as they are in the header */
+  memcpy(&hash, ports, sizeof(hash));
+  hash ^= hs->src_addr_be32 ^ hs->dst_addr_be32;
+  hash ^= hash >> 16;
+  hash ^= hash >> 8;
+  /* The kernel discards the lowest bit because of the even ports pattern */
+  return (hash >> 1) % num_slaves;
+}
+
 ci_inline int cicp_layer34_hash(struct cicp_hash_state *hs, int num_slaves)
 {
+  if( (hs->flags & CICP_HASH_STATE_FLAGS_KERNEL) &&
+      (hs->flags & CICP_HASH_STATE_FLAGS_IS_IP) )
+    return cicp_kernel_layer34_hash(hs, num_slaves);
+
   /* TODO do we ever call this with non-IP traffic */
   if( hs->flags & CICP_HASH_STATE_FLAGS_IS_IP ) {
     ci_uint32 addrs = CI_BSWAP_BE32(hs->src_addr_be32 ^ hs->dst_addr_be32);
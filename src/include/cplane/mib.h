@@ -77,7 +77,13 @@ typedef ci_uint16 ci_mtu_t;
 #define IPTOS_TOS_MASK         0x1E
 #define IPTOS_RT_MASK  (IPTOS_TOS_MASK & ~3)
 
-/*! flags for types of encapsulation supported by the NIC */
+/*! flags for types of encapsulation supported by the NIC
+ *
+ * VLAN tags are matched by the NIC's RX filters and inserted by Onload on
+ * transmit.  Tunnel devices such as VXLAN and GENEVE have no type here, so
+ * the control plane treats them as unaccelerated and their traffic is
+ * handled by the kernel.
+ */
 enum {
   CICP_LLAP_TYPE_NONE                = 0x00000000,
   CICP_LLAP_TYPE_VLAN                = 0x00000001,
@@ -696,6 +702,25 @@ struct cp_svc_ep_array {
   struct cp_svc_endpoint eps[CP_SVC_BACKENDS_PER_ARRAY];
 };
 
+/* Number of slots in a service's Maglev lookup table.  This must be prime,
+ * and services with more backends than this fall back to walking the
+ * backend arrays. */
+#define CP_SVC_MAGLEV_SIZE 1021
+
+/* Maglev consistent-hash lookup table for a service.  Each backend fills
+ * about the same share of the slots, and adding or removing a backend moves
+ * few slots between the others.  The table belongs to the service whose head
+ * backend array has the same index in svc_arrays. */
+struct cp_svc_maglev {
+  /* Backend in each slot, as CP_SVC_MAGLEV_SLOT() */
+  ci_uint32 slots[CP_SVC_MAGLEV_SIZE];
+};
+
+#define CP_SVC_MAGLEV_SLOT(array_id, index) \
+  (((ci_uint32) (array_id) << 8) | (index))
+#define CP_SVC_MAGLEV_SLOT_ARRAY(slot) ((cicp_rowid_t) ((slot) >> 8))
+#define CP_SVC_MAGLEV_SLOT_INDEX(slot) ((slot) & 0xff)
+
 #define CP_STRING_LEN 256
 
 typedef struct cp_string { char value[CP_STRING_LEN]; } cp_string_t;
@@ -761,6 +786,10 @@ struct cp_mibs {
   /* Table of k8s service backends organised by service.
    * Logically an array of arrays, each of length CP_SVC_BACKENDS_PER_ARRAY. */
   struct cp_svc_ep_array* svc_arrays;
+
+  /* Maglev lookup table for each service, indexed by the service's head
+   * backend array. */
+  struct cp_svc_maglev* svc_maglev;
 };
 
 
@@ -20,6 +20,7 @@ extern "C" {
 #endif
 
 #include <etherfabric/base.h>
+#include <etherfabric/ef_vi.h>
 
 /*
  * List of capabilities that can be queried.
@@ -204,6 +205,29 @@ ef_vi_capabilities_get(ef_driver_handle handle, int ifindex,
                        enum ef_vi_capability cap, unsigned long* value);
 
 
+/*! \brief Add the flags for the lowest latency transmit method available
+**
+** \param handle  The ef_driver_handle associated with the interface.
+** \param ifindex The index of the interface, as for ef_vi_capabilities_get().
+** \param flags   Flags to pass to ef_vi_alloc_from_pd(), updated on return.
+**
+** \return 0 on success, or a negative error code if the capabilities of
+**         the interface could not be retrieved.
+**
+** This adds EF_VI_TX_CTPIO to flags where the interface supports CTPIO, so
+** that an application can allocate the fastest virtual interface the NIC
+** offers without naming each NIC type.  Allocation with the flags may
+** still fail if CTPIO is supported but not currently available, in which
+** case the caller can retry without them.
+**
+** PIO is not selected here because it needs an ef_pio to be allocated and
+** linked separately; use EF_VI_CAP_PIO to decide whether to do that.
+**/
+extern int
+ef_vi_capabilities_tx_flags(ef_driver_handle handle, int ifindex,
+                            enum ef_vi_flags* flags);
+
+
 /*! \brief Gets the maximum supported value of \ref ef_vi_capability
 **
 ** \return The maximum capability value, or a negative error code.
@@ -681,6 +681,10 @@ typedef struct {
   uint32_t  ct_removed;
   /** Timestamp in nanoseconds */
   uint32_t  ts_nsec;
+  /** Wakeups requested to start transmitting */
+  uint32_t  xdp_kicks;                          /* af_xdp only */
+  /** Wakeups not needed because the kernel was already transmitting */
+  uint32_t  xdp_kicks_avoided;                  /* af_xdp only */
 } ef_vi_txq_state;
 
 /*! \brief State of efct receive queue
@@ -719,16 +723,23 @@ typedef struct {
   uint32_t  added;
   /** Descriptors removed from the ring */
   uint32_t  removed;
-  /** Packets received as part of a jumbo (7000-series only) */
-  uint32_t  in_jumbo;                           /* ef10 only */
-  /** Bytes received as part of a jumbo (7000-series only) */
-  uint32_t  bytes_acc;                          /* ef10 only */
+  /** Packets received as part of a jumbo (7000-series and AF_XDP only) */
+  uint32_t  in_jumbo;                           /* ef10 and af_xdp only */
+  /** Bytes received as part of a jumbo (7000-series and AF_XDP only) */
+  uint32_t  bytes_acc;                          /* ef10 and af_xdp only */
   /** Last descriptor index completed (7000-series only) */
   uint16_t  last_desc_i;                        /* ef10 only */
   /** Credit for packed stream handling (7000-series only) */
   uint16_t  rx_ps_credit_avail;                 /* ef10 only */
   ef_vi_efct_rxq_ptr rxq_ptr[EF_VI_MAX_EFCT_RXQS]; /* efct only */
   int16_t sb_desc_free_head[EF_VI_MAX_EFCT_RXQS]; /* efct only */
+  /** Wakeups requested to resume receiving after refilling */
+  uint32_t  xdp_fill_kicks;                     /* af_xdp only */
+  /** Software counters reported by efct_vi_rxq_get_stats() (efct only) */
+  struct {
+    uint32_t sw_filtered;
+    uint32_t sbseq_gaps;
+  } efct_stats[EF_VI_MAX_EFCT_RXQS];
 } ef_vi_rxq_state;
 
 /*! \brief State of event queue
@@ -853,6 +864,13 @@ typedef struct {
   ef_vi_efct_rxq                q[EF_VI_MAX_EFCT_RXQS];
   /** Buffer access/management operations */
   ef_vi_efct_rxq_ops*           ops;
+  /** Software receive match set by efct_vi_rx_set_match() */
+  const struct efct_vi_rx_match* rx_match;
+  int                           rx_match_n;
+  /** Number of packets ahead of the current one to prefetch when polling */
+  int                           rx_prefetch;
+  /** Index in q of the queue to poll first */
+  unsigned                      poll_next;
 
   /** efct kernel/userspace shared queue area. Exposed for debugging.
    ** TODO provide generic access to stats and hide this */
@@ -1153,6 +1171,14 @@ typedef struct ef_vi {
                                    size_t len, ef_request_id dma_id);
     int (*transmitv_ctpio_fallback)(struct ef_vi* vi, const ef_iovec* dma_iov,
                                     int dma_iov_len, ef_request_id dma_id);
+    /** Initialize and submit RX descriptors for an array of packet
+     * buffers */
+    int (*receive_post_burst)(struct ef_vi*, const ef_addr*,
+                              const ef_request_id*, int n);
+    /** Initialize and submit TX descriptors for an array of packets, each
+     * in a single packet buffer */
+    int (*transmitv_burst)(struct ef_vi*, const ef_iovec*,
+                           const ef_request_id*, int n);
   } ops;  /**< Driver-dependent operations. */
   /* Doxygen comment above is documentation for the ops member of ef_vi */
 
@@ -1439,6 +1465,30 @@ ef_vi_inline int ef_vi_receive_capacity(const ef_vi* vi)
 extern int ef_vi_receive_post(ef_vi* vi, ef_addr addr, ef_request_id dma_id);
 
 
+/*! \brief Initialize RX descriptors for an array of packet buffers, and
+**         submit them to the NIC together
+**
+** \param vi      The virtual interface for which to post RX descriptors.
+** \param addrs   Array of DMA addresses of the packet buffers, as obtained
+**                from ef_memreg_dma_addr().
+** \param dma_ids Array of DMA ids to associate with the descriptors.
+** \param n       Number of buffers to post.
+**
+** \return The number of buffers posted, which is less than n if the RX
+**         descriptor ring fills up, or a negative error code.
+**
+** This has the same effect as calling ef_vi_receive_init() for each
+** buffer in turn followed by ef_vi_receive_push() once, but checks for
+** space in the ring once for the whole array and avoids an indirect call
+** per buffer.
+**
+** The rule about Solarflare 7000-series NICs submitting RX descriptors in
+** multiples of 8 given for ef_vi_receive_push() applies here too.
+*/
+#define ef_vi_receive_post_burst(vi, addrs, dma_ids, n)         \
+  (vi)->ops.receive_post_burst((vi), (addrs), (dma_ids), (n))
+
+
 /*! \brief _Deprecated:_ use ef_vi_receive_get_timestamp_with_sync_flags()
 ** instead.
 **
@@ -1878,6 +1928,28 @@ extern int ef_vi_transmit_init(ef_vi* vi, ef_addr addr, int bytes,
   (vi)->ops.transmitv((vi), (iov), (iov_len), (dma_id))
 
 
+/*! \brief Transmit an array of packets, each from a single packet buffer
+**
+** \param vi      The virtual interface from which to transmit.
+** \param iov     Array of n iovecs, each describing one whole packet.
+** \param dma_ids Array of n DMA ids to associate with the packets.
+** \param n       Number of packets to transmit.
+**
+** \return The number of packets queued, which is less than n if the TX
+**         descriptor ring fills up.  0 means that nothing was queued.
+**
+** This has the same effect as calling ef_vi_transmitv_init() for each
+** packet in turn followed by ef_vi_transmit_push() once, so there is a
+** single doorbell for the whole array, but avoids an indirect call per
+** packet.
+**
+** Note that iov is not a vector of buffers making up one packet, as it is
+** for ef_vi_transmitv(): iov[i] is the i'th packet.
+*/
+#define ef_vi_transmitv_burst(vi, iov, dma_ids, n)              \
+  (vi)->ops.transmitv_burst((vi), (iov), (dma_ids), (n))
+
+
 /*! \brief Transmit a packet already resident in Programmed I/O
 **
 ** \param vi     The virtual interface from which to transmit.
@@ -2067,6 +2139,32 @@ extern int ef_vi_transmit_unbundle(ef_vi* ep, const ef_event* event,
                                    ef_request_id* ids);
 
 
+/*! \brief Complete transmits up to an event of type EF_EVENT_TYPE_TX or
+**         EF_EVENT_TYPE_TX_ERROR, without returning their DMA ids
+**
+** \param vi    The virtual interface that has raised the event.
+** \param event The event, of type EF_EVENT_TYPE_TX or
+**              EF_EVENT_TYPE_TX_ERROR
+**
+** \return The number of packets whose transmission has completed.
+**
+** This is for senders that do not need the DMA ids of completed transmits,
+** for example because they reuse packet buffers in the order they were
+** sent.
+**
+** Each TX event reports completion of every descriptor up to a point in
+** the TX ring, so when several TX events for the same virtual interface
+** are polled together, only the last one need be passed here.  The
+** earlier ones can be skipped, which saves walking the ring once per
+** event.  Unlike ef_vi_transmit_unbundle(), the number of transmits
+** completed by one call is not limited to EF_VI_TRANSMIT_BATCH.
+**
+** Do not mix this with ef_vi_transmit_unbundle() for events that have
+** been skipped.
+*/
+extern int ef_vi_transmit_complete(ef_vi* vi, const ef_event* event);
+
+
 /*! \brief Return the number of TX alternatives allocated for a virtual
 ** interface.
 **
@@ -2604,6 +2702,30 @@ ef_vi_inline unsigned ef_eventq_current(ef_vi* evq)
 }
 
 
+/*! \brief Get the virtual interface that an event refers to.
+**
+** \param evq  The event queue the event was polled from.
+** \param q_id The queue ID from the event, for example from
+**             EF_EVENT_RX_Q_ID() or EF_EVENT_TX_Q_ID().
+**
+** \return The virtual interface whose queue generated the event, or NULL
+**         if q_id is not a queue using this event queue.
+**
+** Several virtual interfaces can share one event queue by passing it as
+** evq_opt to ef_vi_alloc_from_pd(), so that one call to ef_eventq_poll()
+** covers all of them.  Each event then carries the queue ID returned when
+** its virtual interface was allocated, and this finds the virtual
+** interface to pass to functions such as ef_vi_transmit_unbundle() and
+** ef_vi_receive_post().
+*/
+ef_vi_inline struct ef_vi* ef_eventq_vi(ef_vi* evq, int q_id)
+{
+  if( (unsigned) q_id >= (unsigned) evq->vi_qs_n )
+    return NULL;
+  return evq->vi_qs[q_id];
+}
+
+
 /**********************************************************************
  * ef_vi layout *******************************************************
  **********************************************************************/
@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2026 Advanced Micro Devices, Inc. */
+
+#ifndef __EFAB_EF_VI_ARCH_H__
+#define __EFAB_EF_VI_ARCH_H__
+
+/*! \file
+**  \brief Fast path \a ef_vi calls specialised for one NIC architecture
+**
+** ef_vi_transmit(), ef_vi_receive_init() and ef_eventq_poll() and friends
+** call through \a ef_vi::ops, because the architecture of a VI is only known
+** once it has been allocated.  An application that only ever drives one
+** architecture can define one of \a EF_VI_ARCH_ONLY_EF10,
+** \a EF_VI_ARCH_ONLY_EF100 or \a EF_VI_ARCH_ONLY_EFCT before including
+** this header, and use the ef_vi_arch_*() calls below in its fast path.
+** These then compile to direct calls to that architecture's implementation,
+** which the compiler and CPU can see through, rather than indirect calls.
+**
+** When none of these is defined the ef_vi_arch_*() calls are the same as
+** the generic ones.
+**
+** The direct calls are only correct for a VI of the selected architecture
+** whose fast path is not overridden by its flags.  Call ef_vi_arch_check()
+** once after allocating the VI, and do not use the ef_vi_arch_*() calls on
+** it if that fails.
+**/
+
+#include <etherfabric/ef_vi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int ef_vi_ef10_transmit(ef_vi*, ef_addr, int, ef_request_id);
+extern int ef_vi_ef10_transmitv(ef_vi*, const ef_iovec*, int, ef_request_id);
+extern void ef_vi_ef10_transmit_push(ef_vi*);
+extern int ef_vi_ef10_receive_init(ef_vi*, ef_addr, ef_request_id);
+extern void ef_vi_ef10_receive_push(ef_vi*);
+extern int ef_vi_ef10_eventq_poll(ef_vi*, ef_event*, int);
+
+extern int ef_vi_ef100_transmit(ef_vi*, ef_addr, int, ef_request_id);
+extern int ef_vi_ef100_transmitv(ef_vi*, const ef_iovec*, int, ef_request_id);
+extern void ef_vi_ef100_transmit_push(ef_vi*);
+extern int ef_vi_ef100_receive_init(ef_vi*, ef_addr, ef_request_id);
+extern void ef_vi_ef100_receive_push(ef_vi*);
+extern int ef_vi_ef100_eventq_poll(ef_vi*, ef_event*, int);
+
+extern int ef_vi_efct_transmit(ef_vi*, ef_addr, int, ef_request_id);
+extern int ef_vi_efct_transmitv(ef_vi*, const ef_iovec*, int, ef_request_id);
+extern void ef_vi_efct_transmit_push(ef_vi*);
+extern int ef_vi_efct_eventq_poll(ef_vi*, ef_event*, int);
+
+
+#if defined(EF_VI_ARCH_ONLY_EF10)
+# define EF_VI_ARCH_ONLY    EF_VI_ARCH_EF10
+# define EF_VI_ARCH_FN(op)  ef_vi_ef10_##op
+#elif defined(EF_VI_ARCH_ONLY_EF100)
+# define EF_VI_ARCH_ONLY    EF_VI_ARCH_EF100
+# define EF_VI_ARCH_FN(op)  ef_vi_ef100_##op
+#elif defined(EF_VI_ARCH_ONLY_EFCT)
+# define EF_VI_ARCH_ONLY    EF_VI_ARCH_EFCT
+# define EF_VI_ARCH_FN(op)  ef_vi_efct_##op
+/* The EFCT receive path does not use descriptors. */
+# define EF_VI_ARCH_NO_RX_DESC  1
+#endif
+
+
+/*! \brief Check that a VI can use the ef_vi_arch_*() calls
+**
+** \param vi The virtual interface to check.
+**
+** \return 0 if the ef_vi_arch_*() calls may be used with \p vi, or
+**         -EOPNOTSUPP if \p vi has a different architecture from the
+**         one selected or uses a different fast path.
+*/
+ef_vi_inline int ef_vi_arch_check(ef_vi* vi)
+{
+#ifdef EF_VI_ARCH_FN
+  if( vi->nic_type.arch != EF_VI_ARCH_ONLY )
+    return -EOPNOTSUPP;
+  /* Packed stream mode has its own receive_init(). */
+  if( vi->nic_type.arch == EF_VI_ARCH_EF10 &&
+      (vi->vi_flags & EF_VI_RX_PACKED_STREAM) )
+    return -EOPNOTSUPP;
+#else
+  (void) vi;
+#endif
+  return 0;
+}
+
+
+#ifdef EF_VI_ARCH_FN
+
+ef_vi_inline int ef_vi_arch_transmit(ef_vi* vi, ef_addr base, int len,
+                                     ef_request_id dma_id)
+{
+  return EF_VI_ARCH_FN(transmit)(vi, base, len, dma_id);
+}
+
+ef_vi_inline int ef_vi_arch_transmitv(ef_vi* vi, const ef_iovec* iov,
+                                      int iov_len, ef_request_id dma_id)
+{
+  return EF_VI_ARCH_FN(transmitv)(vi, iov, iov_len, dma_id);
+}
+
+ef_vi_inline void ef_vi_arch_transmit_push(ef_vi* vi)
+{
+  EF_VI_ARCH_FN(transmit_push)(vi);
+}
+
+#ifndef EF_VI_ARCH_NO_RX_DESC
+ef_vi_inline int ef_vi_arch_receive_init(ef_vi* vi, ef_addr addr,
+                                         ef_request_id dma_id)
+{
+  return EF_VI_ARCH_FN(receive_init)(vi, addr, dma_id);
+}
+
+ef_vi_inline void ef_vi_arch_receive_push(ef_vi* vi)
+{
+  EF_VI_ARCH_FN(receive_push)(vi);
+}
+
+ef_vi_inline int ef_vi_arch_receive_post(ef_vi* vi, ef_addr addr,
+                                         ef_request_id dma_id)
+{
+  int rc = EF_VI_ARCH_FN(receive_init)(vi, addr, dma_id);
+  if( rc == 0 )
+    EF_VI_ARCH_FN(receive_push)(vi);
+  return rc;
+}
+#else
+# define ef_vi_arch_receive_init   ef_vi_receive_init
+# define ef_vi_arch_receive_push   ef_vi_receive_push
+# define ef_vi_arch_receive_post   ef_vi_receive_post
+#endif
+
+ef_vi_inline int ef_eventq_arch_poll(ef_vi* evq, ef_event* evs, int evs_len)
+{
+  return EF_VI_ARCH_FN(eventq_poll)(evq, evs, evs_len);
+}
+
+#else
+
+# define ef_vi_arch_transmit       ef_vi_transmit
+# define ef_vi_arch_transmitv      ef_vi_transmitv
+# define ef_vi_arch_transmit_push  ef_vi_transmit_push
+# define ef_vi_arch_receive_init   ef_vi_receive_init
+# define ef_vi_arch_receive_push   ef_vi_receive_push
+# define ef_vi_arch_receive_post   ef_vi_receive_post
+# define ef_eventq_arch_poll       ef_eventq_poll
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EFAB_EF_VI_ARCH_H__ */
@@ -199,6 +199,138 @@ int efct_vi_rx_future_poll(ef_vi* vi, ef_event* evs, int evs_len);
 */
 #define EFCT_FUTURE_VALID_BYTES 62
 
+/*! \brief Maximum number of terms in a software receive match */
+#define EFCT_VI_RX_MATCH_MAX_TERMS 8
+
+/*! \brief Maximum offset of a software receive match term */
+#define EFCT_VI_RX_MATCH_MAX_OFFSET 248
+
+/*! \brief One term of a software receive match
+**
+** The term matches a packet if the 8 bytes at \a offset from the start of the
+** frame, masked with \a mask, are equal to \a value. \a mask and \a value are
+** compared with the packet bytes as they are stored in memory, so should be
+** built by copying bytes in network order, rather than by assigning integer
+** constants.
+*/
+struct efct_vi_rx_match {
+  /** Offset in bytes from the start of the Ethernet header */
+  uint16_t offset;
+  /** Bits of the 8 bytes at \a offset to compare */
+  uint64_t mask;
+  /** Value to compare with, which must have no bits set outside \a mask */
+  uint64_t value;
+};
+
+/*! \brief Set a software match for received packets
+**
+** \param vi      The virtual interface to configure
+** \param terms   Array of match terms, or NULL to remove the match
+** \param n_terms Number of elements in the terms array
+**
+** \return 0 on success, or a negative error code: -EINVAL if a term is
+**         invalid or there are more than EFCT_VI_RX_MATCH_MAX_TERMS terms.
+**
+** The receive buffers of an EFCT queue are shared by every application that
+** has a filter directing traffic to that queue, so each application sees all
+** of the packets delivered to the queue. A software match lets a consumer
+** narrow this down to the packets it is interested in, e.g. a particular
+** UDP destination port, without the cost of an event and a release for each
+** packet it would ignore anyway.
+**
+** A packet is delivered if it matches all of the terms. Other packets are
+** released by \a ef_eventq_poll without generating an event, and counted in
+** the sw_filtered field of \a efct_vi_rxq_stats. Packets shorter than
+** \a offset + 8 bytes do not match a term. Discarded packets are not subject
+** to the match: they are reported as usual according to \a rx_discard_mask.
+**
+** The terms array is not copied and must remain valid until the match is
+** removed or the virtual interface is freed.
+*/
+extern int efct_vi_rx_set_match(struct ef_vi* vi,
+                                const struct efct_vi_rx_match* terms,
+                                int n_terms);
+
+/*! \brief Statistics for an EFCT receive queue, from this consumer's view */
+struct efct_vi_rxq_stats {
+  /** Superbuffers filled by the adapter but not yet reached by this
+   ** virtual interface: how far the consumer is behind the adapter */
+  uint32_t lag_superbufs;
+  /** Superbuffers that were reused before this consumer reached them,
+   ** because it was too far behind */
+  uint32_t skipped_superbufs;
+  /** Times the kernel could not pass on a superbuffer because this
+   ** consumer's queue of filled superbuffers was full */
+  uint32_t no_rxq_space;
+  /** Times the kernel could not pass on a superbuffer because this
+   ** consumer already held too many */
+  uint32_t too_many_owned;
+  /** Times this consumer found no filled superbuffer when it needed one */
+  uint32_t no_bufs;
+  /** Gaps in the superbuffer sequence seen by this consumer */
+  uint32_t sbseq_gaps;
+  /** Packets released because they did not pass the software match */
+  uint32_t sw_filtered;
+};
+
+/*! \brief Get the statistics for an EFCT receive queue
+**
+** \param vi    The virtual interface to query
+** \param ix    Index of the receive queue within this virtual interface,
+**              from 0 to EF_VI_MAX_EFCT_RXQS - 1
+** \param stats Structure to fill in
+**
+** \return 0 on success, or -EINVAL if \a ix is out of range.
+**
+** The counters are cumulative and wrap on overflow. Those maintained by the
+** kernel are zero if they are not available to this virtual interface.
+*/
+extern int efct_vi_rxq_get_stats(struct ef_vi* vi, int ix,
+                                 struct efct_vi_rxq_stats* stats);
+
+/*! \brief Maximum value of the EF_VI_EFCT_RX_PREFETCH environment variable
+**
+** When polling, ef_vi can prefetch the metadata and protocol headers of the
+** packet this many places ahead of the one being reported, which helps when
+** the application has fallen behind and packets are no longer in cache. It
+** is disabled (0) by default.
+*/
+#define EFCT_VI_RX_PREFETCH_MAX 16
+
+/*! \brief A packet found by \a efct_vi_rx_peek */
+struct efct_vi_rx_peek_pkt {
+  /** Packet data, typically the first byte of the Ethernet header */
+  const void* data;
+  /** Length of the packet in bytes */
+  uint16_t len;
+  /** Discard flags, as for an RX_REF_DISCARD event, or zero */
+  uint16_t discard_flags;
+};
+
+/*! \brief Look at received packets without consuming them
+**
+** \param vi   The virtual interface to check for received packets
+** \param pkts Array in which to return the packets found
+** \param max  Length of the pkts array
+**
+** \return The number of packets found
+**
+** This reports the metadata of packets that have arrived and will be returned
+** by the next calls to \a ef_eventq_poll, so that an application can see how
+** much work is waiting and start fetching packet data before handling the
+** events. Packets are reported in the order that their events will be
+** returned for each queue; packets from different queues are not ordered with
+** respect to each other. Packets which will be released by the software match
+** are not reported.
+**
+** Nothing is consumed. The data pointers remain valid until the packet is
+** released after its event has been polled, or until it is released by the
+** software match. This may not be called concurrently with
+** \a ef_eventq_poll.
+*/
+extern int efct_vi_rx_peek(struct ef_vi* vi, struct efct_vi_rx_peek_pkt* pkts,
+                           int max);
+
 /*! \brief Start transmit warming for this VI
 **
 ** Calling transmit functions during warming will exercise the code path but
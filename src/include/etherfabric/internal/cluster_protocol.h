@@ -36,6 +36,14 @@ enum cluster_req {
   CLUSTERD_VERSION_RESP,
   CLUSTERD_ALLOC_CLUSTER_REQ,
   CLUSTERD_ALLOC_CLUSTER_RESP,
+  /* Change the number of channels that a cluster's RSS spreads over.  A
+   * request for 0 channels just reports the current number. */
+  CLUSTERD_RESIZE_CLUSTER_REQ,
+  CLUSTERD_RESIZE_CLUSTER_RESP,
+  /* Sent unprompted to every other client holding the cluster after a
+   * successful resize.  New values must only be appended: clients that
+   * predate resizing never read their socket after allocation. */
+  CLUSTERD_CLUSTER_RESIZED,
 };
 
 enum cluster_result_code {
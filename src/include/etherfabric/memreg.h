@@ -76,6 +76,37 @@ extern int ef_memreg_alloc(ef_memreg* mr, ef_driver_handle mr_dh,
                            struct ef_pd* pd, ef_driver_handle pd_dh,
                            void* p_mem, size_t len_bytes);
 
+/*! \brief Register part of a dma-buf for use with ef_vi
+**
+** \param mr        The ef_memreg object to initialize.
+** \param mr_dh     Driver handle for the ef_memreg.
+** \param pd        Protection domain in which to register memory.
+** \param pd_dh     Driver handle for the protection domain.
+** \param dmabuf_fd File descriptor of a dma-buf, for example one exported
+**                  by a GPU driver for device memory.
+** \param offset    Offset of the region within the dma-buf. This must be
+**                  on a 4K boundary.
+** \param len_bytes Length of the region to be registered.
+**
+** \return 0 on success, or a negative error code.
+**
+** Register memory that is not mapped into this process, so that the NIC
+** can receive into and transmit from it directly.  The exporter of the
+** dma-buf maps it for the NIC, and ef_memreg_dma_addr() then gives DMA
+** addresses within the region as for ef_memreg_alloc(), with offsets
+** relative to \p offset.
+**
+** The application cannot read or write the memory through the ef_memreg,
+** so received packets must be handled by the device that owns it.
+**
+** This is only supported by adapters that DMA to and from packet buffers,
+** and returns -EOPNOTSUPP for others.
+*/
+extern int ef_memreg_alloc_dmabuf(ef_memreg* mr, ef_driver_handle mr_dh,
+                                  struct ef_pd* pd, ef_driver_handle pd_dh,
+                                  int dmabuf_fd, uint64_t offset,
+                                  size_t len_bytes);
+
 /*! \brief Unregister a memory region
 **
 ** \param mr    The ef_memreg object to unregister.
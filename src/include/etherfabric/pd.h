@@ -170,6 +170,44 @@ extern int ef_pd_alloc_with_vport(ef_pd* pd, ef_driver_handle pd_dh,
 */
 extern const char* ef_pd_interface_name(ef_pd* pd);
 
+/*! \brief Change the number of channels in use by a cluster
+**
+** \param pd         Memory used by a protection domain allocated from a
+**                   cluster with ef_pd_alloc_by_name().
+** \param n_channels Number of channels to spread received packets across,
+**                   or 0 to just look up the current number.
+**
+** \return The number of channels in use on success, or a negative error
+**         code.
+**
+** Ask solar_clusterd to re-spread the cluster's received packets across
+** the first @p n_channels channels.  Those channels can be given to new
+** consumers with ef_pd_alloc_by_name("<idx>@<cluster>") while existing
+** consumers keep running.  The number of channels can not exceed the
+** cluster's MaxChannels setting.
+**
+** Every other consumer of the cluster is notified of the change, see
+** ef_pd_cluster_poll_resize().
+*/
+extern int ef_pd_cluster_resize(ef_pd* pd, int n_channels);
+
+/*! \brief Check whether a cluster has been resized
+**
+** \param pd Memory used by a protection domain allocated from a cluster
+**           with ef_pd_alloc_by_name().
+**
+** \return The new number of channels in use if the cluster has been
+**         resized since the last call, 0 if not, or a negative error code.
+**
+** This call does not block.  The pd_cluster_sock member of @p pd becomes
+** readable when a notification is waiting, so can be added to a poll set.
+**
+** A consumer whose channel index is no longer in use receives no new
+** packets, but should drain its receive ring before freeing its virtual
+** interface.
+*/
+extern int ef_pd_cluster_poll_resize(ef_pd* pd);
+
 /*! \brief Free a protection domain
 **
 ** \param pd    Memory used by the protection domain.
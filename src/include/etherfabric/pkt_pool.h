@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/**************************************************************************\
+*//*! \file
+** \author    Advanced Micro Devices, Inc.
+** \brief     Packet buffer pool for ef_vi applications.
+** \date      2023/11/29
+** \copyright Copyright &copy; 2023 Advanced Micro Devices, Inc.
+*//*
+\**************************************************************************/
+
+#ifndef __EFAB_PKT_POOL_H__
+#define __EFAB_PKT_POOL_H__
+
+#include <etherfabric/ef_vi.h>
+#include <etherfabric/memreg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Number of buffers posted per batch by ef_pkt_pool_refill_rx() */
+#define EF_PKT_POOL_REFILL_BATCH  16
+
+
+/*! \brief A pool of packet buffers in registered memory
+**
+** The pool hands out fixed-size buffers from a region of memory registered
+** with ef_memreg_alloc().  Free buffers are kept on a LIFO stack, so the
+** buffer handed out next is the one most recently freed, which is the one
+** most likely to still be in cache.
+**
+** Each buffer is identified by its index in the pool, which is suitable for
+** use as the DMA id of a descriptor.
+**
+** A pool is not thread-safe.  For a multi-threaded application, register
+** one arena (ideally backed by huge pages) and give each thread a pool over
+** its own slice of it.
+*/
+typedef struct ef_pkt_pool {
+  /** Start of the buffers */
+  char*         base;
+  /** Registered memory that contains the buffers */
+  ef_memreg*    mr;
+  /** Offset of base within the registered memory */
+  size_t        mr_offset;
+  /** Size of each buffer */
+  unsigned      buf_size;
+  /** Number of buffers in the pool */
+  unsigned      n_bufs;
+  /** Stack of free buffer ids */
+  uint32_t*     free;
+  /** Number of entries in the free stack */
+  unsigned      n_free;
+} ef_pkt_pool;
+
+
+/*! \brief Initialise a packet buffer pool, with all buffers free
+**
+** \param pool      The pool to initialise.
+** \param mr        Registered memory that contains the buffers.
+** \param mr_base   The start of the memory registered as mr.
+** \param mr_offset Offset of the first buffer from mr_base.
+** \param buf_size  Size of each buffer.  This must be a power of two no
+**                  larger than EF_VI_NIC_PAGE_SIZE, and at least
+**                  EF_VI_DMA_ALIGN.
+** \param n_bufs    Number of buffers in the pool.
+** \param free      Storage for n_bufs free stack entries.
+**
+** \return 0 on success, or -EINVAL if buf_size or mr_offset is not valid.
+**
+** mr_offset must be a multiple of buf_size so that no buffer crosses a NIC
+** page.
+*/
+extern int ef_pkt_pool_init(ef_pkt_pool* pool, ef_memreg* mr, void* mr_base,
+                            size_t mr_offset, unsigned buf_size,
+                            unsigned n_bufs, uint32_t* free);
+
+
+/*! \brief Post free buffers to a virtual interface's RX ring
+**
+** \param pool       The pool.
+** \param vi         The virtual interface to post to.
+** \param dma_offset Offset into each buffer at which to receive.
+** \param fill_level Fill level of the RX ring to refill up to.
+**
+** \return The number of buffers posted, or a negative error code.
+**
+** Nothing is posted until the RX ring is at least EF_PKT_POOL_REFILL_BATCH
+** below fill_level.  Then buffers are posted in batches of that size, each
+** with one call to ef_vi_receive_post_burst(), until the ring reaches
+** fill_level or the pool runs low.  Call this after handling each batch of
+** RX events to keep the ring filled.
+*/
+extern int ef_pkt_pool_refill_rx(ef_pkt_pool* pool, ef_vi* vi,
+                                 unsigned dma_offset, int fill_level);
+
+
+/*! \brief Take a buffer from a pool
+**
+** \param pool The pool.
+**
+** \return The id of the buffer, or -ENOBUFS if the pool is empty.
+*/
+ef_vi_inline int ef_pkt_pool_get(ef_pkt_pool* pool)
+{
+  if( pool->n_free == 0 )
+    return -ENOBUFS;
+  return pool->free[--pool->n_free];
+}
+
+
+/*! \brief Return a buffer to a pool
+**
+** \param pool The pool.
+** \param id   The id of the buffer, as returned by ef_pkt_pool_get() or
+**             delivered as the DMA id of a completed descriptor.
+*/
+ef_vi_inline void ef_pkt_pool_put(ef_pkt_pool* pool, int id)
+{
+  pool->free[pool->n_free++] = id;
+}
+
+
+/*! \brief Return the address of a buffer
+**
+** \param pool The pool.
+** \param id   The id of the buffer.
+**
+** \return The address of the start of the buffer.
+*/
+ef_vi_inline void* ef_pkt_pool_ptr(const ef_pkt_pool* pool, int id)
+{
+  return pool->base + (size_t) id * pool->buf_size;
+}
+
+
+/*! \brief Return the DMA address of a buffer
+**
+** \param pool The pool.
+** \param id   The id of the buffer.
+**
+** \return The DMA address of the start of the buffer.
+*/
+ef_vi_inline ef_addr ef_pkt_pool_dma_addr(const ef_pkt_pool* pool, int id)
+{
+  return ef_memreg_dma_addr(pool->mr,
+                            pool->mr_offset + (size_t) id * pool->buf_size);
+}
+
+
+/*! \brief Return the number of free buffers in a pool
+**
+** \param pool The pool.
+**
+** \return The number of buffers that ef_pkt_pool_get() can return.
+*/
+ef_vi_inline unsigned ef_pkt_pool_n_free(const ef_pkt_pool* pool)
+{
+  return pool->n_free;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __EFAB_PKT_POOL_H__ */
@@ -0,0 +1,272 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/**************************************************************************\
+*//*! \file
+** \author    Advanced Micro Devices, Inc.
+** \brief     Shared memory packet ring for one writer and many readers.
+** \date      2023/11/20
+** \copyright Copyright &copy; 2023 Advanced Micro Devices, Inc.
+*//*
+\**************************************************************************/
+
+#ifndef __EFAB_SHM_RING_H__
+#define __EFAB_SHM_RING_H__
+
+#include <etherfabric/base.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Value of ef_shm_ring::magic in an initialised ring */
+#define EF_SHM_RING_MAGIC        0x65667266u
+
+/*! \brief Alignment of a ring, and of the first buffer within it */
+#define EF_SHM_RING_ALIGN        4096
+
+/*! \brief Value of ef_shm_ring_buf::flags for a packet received intact */
+#define EF_SHM_RING_BUF_GOOD     0x1
+
+
+/*! \brief Header at the start of a shared memory ring
+**
+** A ring is a header followed by a power-of-two number of fixed-size
+** buffers, all in one region of memory shared between processes.  The
+** region contains no pointers, so each process may map it at a different
+** address.  Several rings may share a region, each starting at a multiple
+** of EF_SHM_RING_ALIGN.
+*/
+typedef struct ef_shm_ring {
+  /** EF_SHM_RING_MAGIC once initialised */
+  uint32_t          magic;
+  /** Number of buffers; a power of two */
+  uint32_t          n_bufs;
+  /** Bytes per buffer, including its ef_shm_ring_buf; a power of two */
+  uint32_t          buf_size;
+  /** Offset from the start of the ring to the first buffer */
+  uint32_t          buf_offset;
+  /** Number of buffers published by the writer since initialisation */
+  volatile uint64_t published;
+} ef_shm_ring;
+
+
+/*! \brief Header at the start of each buffer in a shared memory ring */
+typedef struct ef_shm_ring_buf {
+  /** Generation count: odd while the buffer is being written */
+  volatile uint64_t gen_c;
+  /** Status of the packet, from EF_SHM_RING_BUF_* */
+  int32_t           flags;
+  /** Length of the packet */
+  int32_t           len;
+  /** Offset of the packet from the start of this buffer */
+  int32_t           data_off;
+  int32_t           reserved;
+} ef_shm_ring_buf;
+
+
+/*! \brief Return the number of bytes needed for a shared memory ring
+**
+** \param n_bufs   Number of buffers in the ring.
+** \param buf_size Bytes per buffer.
+**
+** \return The size of the ring, which is a multiple of EF_SHM_RING_ALIGN.
+*/
+extern size_t ef_shm_ring_bytes(unsigned n_bufs, unsigned buf_size);
+
+
+/*! \brief Initialise a shared memory ring
+**
+** \param mem       Memory for the ring, aligned to EF_SHM_RING_ALIGN.
+** \param mem_bytes Size of mem.
+** \param n_bufs    Number of buffers, which must be a power of two.
+** \param buf_size  Bytes per buffer, which must be a power of two large
+**                  enough to hold an ef_shm_ring_buf.
+**
+** \return 0 on success, or -EINVAL if the parameters are not valid or
+**         mem is too small.
+**
+** Initialise a ring for writing.  This must be done by the writer before
+** any reader attaches.
+**
+** The memory can come from anywhere that can be shared between processes
+** and, if the packets are to be received into it by DMA, registered with
+** ef_memreg_alloc().  For large rings, backing it with huge pages (for
+** example with shmget(SHM_HUGETLB) or a file on hugetlbfs) reduces the
+** time taken to register it and the number of IOTLB misses.
+*/
+extern int ef_shm_ring_init(void* mem, size_t mem_bytes, unsigned n_bufs,
+                            unsigned buf_size);
+
+
+/*! \brief Attach to a shared memory ring initialised by another process
+**
+** \param ring_out  Updated with the ring on success.
+** \param mem       Start of the ring in this process.
+** \param mem_bytes Size of the mapping at mem.
+**
+** \return 0 on success, or -EINVAL if mem does not hold an initialised
+**         ring that fits within mem_bytes.
+*/
+extern int ef_shm_ring_attach(ef_shm_ring** ring_out, void* mem,
+                              size_t mem_bytes);
+
+
+/*! \brief Return the offset of a buffer from the start of its ring
+**
+** \param ring The ring.
+** \param seq  Sequence number of the buffer.
+**
+** \return The offset, which can be passed to ef_memreg_dma_addr() when the
+**         ring is registered from its start.
+*/
+ef_vi_inline size_t ef_shm_ring_buf_offset(const ef_shm_ring* ring,
+                                           uint64_t seq)
+{
+  return ring->buf_offset +
+    (size_t) (seq & (ring->n_bufs - 1)) * ring->buf_size;
+}
+
+
+/*! \brief Return the buffer for a sequence number
+**
+** \param ring The ring.
+** \param seq  Sequence number of the buffer.
+**
+** \return The buffer.  Sequence numbers wrap onto the buffers modulo the
+**         size of the ring.
+*/
+ef_vi_inline ef_shm_ring_buf* ef_shm_ring_buf_at(ef_shm_ring* ring,
+                                                 uint64_t seq)
+{
+  return (ef_shm_ring_buf*) ((char*) ring +
+                              ef_shm_ring_buf_offset(ring, seq));
+}
+
+
+/*! \brief Return the sequence number of the next buffer to be published
+**
+** \param ring The ring.
+**
+** \return The sequence number.  A reader attaching to a live ring starts
+**         here to see only new packets.
+*/
+ef_vi_inline uint64_t ef_shm_ring_head(const ef_shm_ring* ring)
+{
+  return __atomic_load_n(&ring->published, __ATOMIC_ACQUIRE);
+}
+
+
+/*! \brief Return how far a reader is behind the writer
+**
+** \param ring The ring.
+** \param seq  Sequence number of the next buffer the reader will read.
+**
+** \return The number of buffers published that the reader has not yet
+**         read.  If this exceeds the size of the ring the reader has been
+**         overrun and has lost packets.
+*/
+ef_vi_inline uint64_t ef_shm_ring_lag(const ef_shm_ring* ring,
+                                      uint64_t seq)
+{
+  return ef_shm_ring_head(ring) - seq;
+}
+
+
+/*! \brief Start writing a buffer
+**
+** \param ring The ring.
+** \param seq  Sequence number of the buffer.
+**
+** \return The buffer, which readers will not accept until
+**         ef_shm_ring_write_end() is called for it.
+**
+** The writer calls this before giving the buffer to the NIC, and must use
+** sequence numbers in order starting from zero.
+*/
+ef_vi_inline ef_shm_ring_buf* ef_shm_ring_write_begin(ef_shm_ring* ring,
+                                                      uint64_t seq)
+{
+  ef_shm_ring_buf* buf = ef_shm_ring_buf_at(ring, seq);
+  __atomic_store_n(&buf->gen_c, buf->gen_c + 1, __ATOMIC_RELAXED);
+  /* Readers must see the odd generation before any change to the buffer */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return buf;
+}
+
+
+/*! \brief Finish writing a buffer and publish it to readers
+**
+** \param ring The ring.
+** \param buf  The buffer from ef_shm_ring_write_begin().
+**
+** Buffers must be published in the order in which they were begun.
+*/
+ef_vi_inline void ef_shm_ring_write_end(ef_shm_ring* ring,
+                                        ef_shm_ring_buf* buf)
+{
+  __atomic_store_n(&buf->gen_c, buf->gen_c + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->published, ring->published + 1, __ATOMIC_RELEASE);
+}
+
+
+/*! \brief Start reading a buffer
+**
+** \param ring    The ring.
+** \param seq     Sequence number of the buffer.
+** \param buf_out Updated with the buffer on success.
+** \param gen_out Updated with the generation to pass to
+**                ef_shm_ring_read_valid().
+**
+** \return 0 on success, -EAGAIN if the buffer has not yet been published,
+**         or -ENOBUFS if it has already been overwritten because the
+**         reader fell more than the size of the ring behind.
+**
+** The contents of the buffer may be overwritten while they are read, so
+** anything done with them must be reversible until
+** ef_shm_ring_read_valid() confirms that they were intact.
+*/
+ef_vi_inline int ef_shm_ring_read_begin(ef_shm_ring* ring, uint64_t seq,
+                                        ef_shm_ring_buf** buf_out,
+                                        uint64_t* gen_out)
+{
+  ef_shm_ring_buf* buf = ef_shm_ring_buf_at(ring, seq);
+  /* Each pass of the writer around the ring adds two to the generation */
+  uint64_t gen = ((seq / ring->n_bufs) + 1) * 2;
+  uint64_t gen_c;
+
+  if( (int64_t) (ef_shm_ring_head(ring) - seq) <= 0 )
+    return -EAGAIN;
+  gen_c = __atomic_load_n(&buf->gen_c, __ATOMIC_ACQUIRE);
+  if( gen_c != gen )
+    return -ENOBUFS;
+  *buf_out = buf;
+  *gen_out = gen_c;
+  return 0;
+}
+
+
+/*! \brief Check that a buffer was not overwritten while it was read
+**
+** \param buf The buffer from ef_shm_ring_read_begin().
+** \param gen The generation from ef_shm_ring_read_begin().
+**
+** \return Non-zero if the reads since ef_shm_ring_read_begin() saw the
+**         buffer intact, or zero if the reader was overrun.
+*/
+ef_vi_inline int ef_shm_ring_read_valid(const ef_shm_ring_buf* buf,
+                                        uint64_t gen)
+{
+  /* Order the reads of the contents before the re-read of gen_c */
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&buf->gen_c, __ATOMIC_RELAXED) == gen;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __EFAB_SHM_RING_H__ */
@@ -176,6 +176,39 @@ int ef_extension_send_message(ef_extension* ext, uint32_t message,
                               void* payload, size_t payload_size,
                               unsigned flags);
 
+/* One message in a batch passed to ef_extension_send_messages(). */
+struct ef_extension_msg {
+  /* The message to send, as for ef_extension_send_message(). */
+  uint32_t message;
+  /* Result of the message, with the same meaning as the return value of
+   * ef_extension_send_message(). */
+  int rc;
+  void* payload;
+  size_t payload_size;
+};
+
+/* Sends a batch of requests to a FPGA plugin.
+ *
+ * This has the same effect as calling ef_extension_send_message() for each
+ * element of msgs in turn, with the result of each stored in its rc field,
+ * but enters the kernel once per batch of up to 64 messages rather than once
+ * per message.  The plugin still handles each message separately, so this
+ * is for applications that have many messages to send at once, such as when
+ * setting up many connections.
+ *
+ * One failed message does not stop the remaining messages from being sent.
+ *
+ * The flags parameter is currently unused and must be 0.
+ *
+ * Return values:
+ *  >=0: the number of messages sent; each has its result in rc.  This is
+ *       less than n_msgs only if a later batch could not be submitted.
+ *  -EFAULT: bad msgs pointer
+ *  <0: any other error submitting the first batch
+ */
+int ef_extension_send_messages(ef_extension* ext, struct ef_extension_msg* msgs,
+                               int n_msgs, unsigned flags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/**************************************************************************\
+*//*! \file
+** \author    Advanced Micro Devices, Inc.
+** \brief     Software pacing of transmits on a virtual interface.
+** \date      2023/11/27
+** \copyright Copyright &copy; 2023 Advanced Micro Devices, Inc.
+*//*
+\**************************************************************************/
+
+#ifndef __EFAB_TX_PACER_H__
+#define __EFAB_TX_PACER_H__
+
+#include <etherfabric/ef_vi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief A transmit held by an ef_tx_pacer until its departure time */
+typedef struct ef_tx_pacer_desc {
+  /** DMA address of the packet */
+  ef_addr       addr;
+  /** Departure time, in nanoseconds on the pacer's clock */
+  uint64_t      due_ns;
+  /** Length of the packet */
+  int           len;
+  /** DMA id reported when the transmit completes */
+  ef_request_id dma_id;
+} ef_tx_pacer_desc;
+
+
+/*! \brief Software pacing queue for a virtual interface
+**
+** Holds transmits in a FIFO until their departure time and then releases
+** them to the TXQ.  This is for applications such as replaying captured
+** traffic at its original inter-packet gaps, on NICs where ef_vi_pace() is
+** not supported or its granularity is too coarse.
+**
+** Transmits depart in the order they were queued: one with a departure
+** time earlier than its predecessor goes immediately after it.  The
+** accuracy of departure is bounded by how often the application polls.
+*/
+typedef struct ef_tx_pacer {
+  /** The virtual interface transmits are released to */
+  ef_vi*            vi;
+  /** Queue storage; the size is a power of two */
+  ef_tx_pacer_desc* descs;
+  /** Size of the queue minus one */
+  unsigned          mask;
+  /** Number of transmits queued since initialisation */
+  unsigned          added;
+  /** Number of transmits released since initialisation */
+  unsigned          removed;
+} ef_tx_pacer;
+
+
+/*! \brief Initialise a software pacing queue
+**
+** \param pacer   The pacer to initialise.
+** \param vi      The virtual interface to transmit on.
+** \param descs   Storage for the queue.
+** \param n_descs Number of entries in descs, which must be a power of two.
+**
+** \return 0 on success, or -EINVAL if n_descs is not a power of two.
+*/
+extern int ef_tx_pacer_init(ef_tx_pacer* pacer, ef_vi* vi,
+                            ef_tx_pacer_desc* descs, unsigned n_descs);
+
+
+/*! \brief Queue a transmit to depart at a given time
+**
+** \param pacer  The pacer.
+** \param addr   DMA address of the packet, as for ef_vi_transmit().
+** \param len    Length of the packet.
+** \param dma_id DMA id to associate with the transmit.
+** \param due_ns Departure time on the clock passed to ef_tx_pacer_release().
+**
+** \return 0 on success, or -EAGAIN if the queue is full.
+**
+** The packet buffer must not be reused until the transmit completes, as
+** reported by an EF_EVENT_TYPE_TX event in the usual way.
+*/
+extern int ef_tx_pacer_queue(ef_tx_pacer* pacer, ef_addr addr, int len,
+                             ef_request_id dma_id, uint64_t due_ns);
+
+
+/*! \brief Release the transmits that are due
+**
+** \param pacer  The pacer.
+** \param now_ns The current time.
+**
+** \return The number of transmits released.
+**
+** Transmits that are due are pushed to the NIC as one batch.  Those that do
+** not fit in the TXQ stay queued until there is space.
+*/
+extern int ef_tx_pacer_release(ef_tx_pacer* pacer, uint64_t now_ns);
+
+
+/*! \brief Release due transmits and then poll the event queue
+**
+** \param pacer   The pacer.
+** \param evs     Array in which to return polled events.
+** \param evs_len Length of the evs array, as for ef_eventq_poll().
+**
+** \return The number of events returned by ef_eventq_poll().
+**
+** This calls ef_tx_pacer_release() with the time from CLOCK_MONOTONIC, so
+** departure times passed to ef_tx_pacer_queue() must be on that clock.  An
+** application that calls this in place of ef_eventq_poll() gets pacing
+** without further changes to its event loop.
+*/
+extern int ef_tx_pacer_eventq_poll(ef_tx_pacer* pacer, ef_event* evs,
+                                   int evs_len);
+
+
+/*! \brief Return the number of transmits waiting to depart
+**
+** \param pacer The pacer.
+**
+** \return The number of transmits queued but not yet released.
+*/
+ef_vi_inline unsigned ef_tx_pacer_fill_level(const ef_tx_pacer* pacer)
+{
+  return pacer->added - pacer->removed;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __EFAB_TX_PACER_H__ */
@@ -78,6 +78,13 @@ struct in6_addr;
 ** - the maximum size of the event queue effectively limits how many
 **   descriptor ring slots can be supported without risking the event queue
 **   overflowing.
+**
+** To poll many virtual interfaces with one call to ef_eventq_poll(),
+** allocate the first with an event queue and the others with
+** evq_capacity=0 and the first as evq_opt.  Up to EF_VI_MAX_QS virtual
+** interfaces can share an event queue, which must be large enough for all
+** of their descriptor rings.  Use ef_eventq_vi() to find which one each
+** event refers to.
 */
 extern int ef_vi_alloc_from_pd(ef_vi* vi, ef_driver_handle vi_dh,
                                struct ef_pd* pd, ef_driver_handle pd_dh,
@@ -239,6 +246,9 @@ extern int ef_vi_flush(ef_vi* vi, ef_driver_handle nic);
 **
 ** This can be used to give priority to latency sensitive traffic over bulk
 ** traffic.
+**
+** Where this returns -EOPNOTSUPP, or per-packet departure times are
+** needed, the software pacer in etherfabric/tx_pacer.h can be used instead.
 */
 extern int ef_vi_pace(ef_vi* vi, ef_driver_handle nic, int val);
 
@@ -327,6 +337,12 @@ typedef struct {
 **
 ** A virtual interface set is usually used to spread the load of handling
 ** received packets. This is sometimes called receive-side scaling, or RSS.
+**
+** The RSS key and indirection table are chosen by the driver, and are not
+** exposed.  The virtual interface that a given flow is delivered to does
+** not change for the life of the set, unless ef_vi_set_rss_spread() is
+** used, so applications that keep per-flow state should partition it by
+** the virtual interface on which each flow is first seen.
 */
 extern int ef_vi_set_alloc_from_pd(ef_vi_set* vi_set,
                                    ef_driver_handle vi_set_dh,
@@ -334,6 +350,27 @@ extern int ef_vi_set_alloc_from_pd(ef_vi_set* vi_set,
                                    int n_vis);
 
 
+/*! \brief Spread received packets over part of a virtual interface set
+**
+** \param vi_set    The virtual interface set.
+** \param vi_set_dh The ef_driver_handle associated with the virtual
+**                  interface set.
+** \param n_active  The number of virtual interfaces to spread across.
+**
+** \return 0 on success, or a negative error code.
+**
+** Reprogram the RSS indirection table of the virtual interface set so
+** that received packets are spread evenly across only the first @p
+** n_active virtual interfaces.  The remaining virtual interfaces stay
+** allocated but receive no new packets, so they can be drained and
+** brought back into use later without reallocating the set.
+**
+** Returns -EOPNOTSUPP if the set does not have its own RSS context.
+*/
+extern int ef_vi_set_rss_spread(ef_vi_set* vi_set,
+                                ef_driver_handle vi_set_dh, int n_active);
+
+
 /*! \brief Free a virtual interface set
 **
 ** \param vi_set    Memory for the allocated virtual interface set.
@@ -1027,6 +1064,13 @@ extern int ef_filter_spec_set_dest(ef_filter_spec* filter_spec, int dest,
 **
 ** After calling this function, any local copy of the filter can be
 ** deleted.
+**
+** Each call makes a separate request to the driver, which in turn waits
+** for the NIC to insert the filter, so adding thousands of filters takes
+** a noticeable time.  An application joining a large number of multicast
+** groups may do better with a single filter from
+** ef_filter_spec_set_multicast_all(), discarding unwanted groups in
+** software.
 */
 extern int ef_vi_filter_add(ef_vi* vi, ef_driver_handle vi_dh,
                             const ef_filter_spec* filter_spec,
@@ -81,6 +81,9 @@ typedef struct ci_resource_onload_alloc_s {
   char                    in_version[OO_VER_STR_LEN + 1];
   char                    in_uk_intf_ver[CI_CHSUM_STR_LEN + 1];
   char                    in_name[CI_CFG_STACK_NAME_LEN + 1];
+  /* Name for a clustered stack allocated on behalf of a single thread
+   * (EF_CLUSTER_PER_THREAD), or empty. */
+  char                    in_stack_name[CI_CFG_STACK_NAME_LEN + 1];
   int                     in_cluster_size;
   int                     in_cluster_restart;
   int                     in_efct_memfd;
@@ -157,6 +160,13 @@ typedef struct {
   ci_int32      buf_len;
 } oo_cluster_dump_t;
 
+typedef struct {
+  ci_user_ptr_t fds;        /* in: array of ci_fixed_descriptor_t */
+  ci_int32      fds_n;      /* in */
+  ci_int32      moved_n;    /* out */
+  ci_int32      rc;         /* out: why fds[moved_n] was not moved */
+} oo_move_fds_t;
+
 typedef struct {
   oo_sp         sock_id;
   ci_user_ptr_t buf;
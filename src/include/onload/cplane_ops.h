@@ -152,6 +152,29 @@ cicp_user_build_fwd_key(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
                         const struct oo_sock_cplane* sock_cp, ci_addr_t daddr,
                         int af, struct cp_fwd_key* key);
 
+#ifndef __KERNEL__
+/* Populate the control plane's route table with the routes that a socket
+ * with [ipcache] and [sock_cp] would use to send to each of [daddrs], so
+ * that the first send to each does not wait for the cplane server, and
+ * start ARP for them.
+ *
+ * [verinfos] identify the routes found; initialise them with
+ * oo_cp_verinfo_init() before the first call.  Routes that are still valid
+ * on later calls are not looked up again, but are marked as in use so
+ * that they do not expire.  [flags_out] gets CICP_PREWARM_* flags for each
+ * destination.
+ *
+ * Returns the number of destinations for which a route was found. */
+#define CICP_PREWARM_CHANGED   0x1  /* route differs from [verinfos] */
+#define CICP_PREWARM_NO_ROUTE  0x2
+#define CICP_PREWARM_NO_MAC    0x4  /* ARP is not (yet) resolved */
+extern int
+cicp_user_prewarm(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
+                  const struct oo_sock_cplane* sock_cp,
+                  const ci_addr_t* daddrs, cicp_verinfo_t* verinfos,
+                  int* flags_out, int n_daddrs);
+#endif
+
 /* Given the result of a route lookup, find the _RX_ hwports associated with
  * the egress interface.  This is a bizarre thing to want to know on the face
  * of it, but there are two use-cases:
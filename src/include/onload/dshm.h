@@ -19,11 +19,16 @@ extern "C" {
 enum {
   OO_DSHM_CLASS_ZF_STACK,
   OO_DSHM_CLASS_ZF_PACKETS,
+  OO_DSHM_CLASS_ZC_SHM,       /* onload_zc_shm_create() */
   OO_DSHM_CLASS_COUNT,
 };
 
 
-/* "Donation" shared memory ioctl structures. */
+/* "Donation" shared memory ioctl structures.
+ *
+ * If [buffer] is NULL on registration, the driver allocates the pages
+ * itself.  Mappings of such buffers are backed by ordinary pages, so that
+ * the mapping process can register them for DMA with its own stack. */
 
 typedef struct {
   ci_int32       shm_class;
@@ -34,6 +34,17 @@
 /* Internal!  Do not call. */
 extern int
 __ef_eplock_lock_slow(ci_netif *, long tiemout, int maybe_wedged) CI_HF;
+
+#if CI_CFG_LOCK_PROFILE && ! defined(__KERNEL__)
+# define OO_LOCK_PROFILE 1
+/* Record that the lock has just been taken at [file]:[line], and that it is
+ * now being released (EF_LOCK_PROFILE). */
+extern void
+ci_netif_lock_profile_acquired(ci_netif*, const char* file, int line) CI_HF;
+extern void ci_netif_lock_profile_released(ci_netif*) CI_HF;
+#else
+# define OO_LOCK_PROFILE 0
+#endif
 #ifdef __KERNEL__
 #define OO_EPLOCK_TIMEOUT_INFTY MAX_SCHEDULE_TIMEOUT
 #else
@@ -54,11 +65,17 @@ ci_inline int ef_eplock_trylock(ci_eplock_t* l) {
    * when invoked in kernel.  So return value *must* be checked when
    * invoked in kernel, else risk of proceeding without the lock held.
    */
-ci_inline int ef_eplock_lock(ci_netif *ni) OO_MUST_CHECK_RET_IN_KERNEL;
-ci_inline int ef_eplock_lock(ci_netif *ni) {
+ci_inline int __ef_eplock_lock(ci_netif *ni, const char* file, int line)
+  OO_MUST_CHECK_RET_IN_KERNEL;
+ci_inline int __ef_eplock_lock(ci_netif *ni, const char* file, int line) {
   int rc = 0;
   if( ci_cas64u_fail(&ni->state->lock.lock, 0, CI_EPLOCK_LOCKED) )
     rc = __ef_eplock_lock_slow(ni, OO_EPLOCK_TIMEOUT_INFTY, 0);
+#if OO_LOCK_PROFILE
+  /* This is NI_OPTS(ni), which is not defined yet. */
+  if(CI_UNLIKELY( ni->state->opts.lock_profile ))
+    ci_netif_lock_profile_acquired(ni, file, line);
+#endif
 #ifdef __KERNEL__
   return rc;
 #else
@@ -69,6 +86,7 @@ ci_inline int ef_eplock_lock(ci_netif *ni) {
   return 0;
 #endif
 }
+#define ef_eplock_lock(ni)  __ef_eplock_lock((ni), __FILE__, __LINE__)
 
 
 #ifdef __KERNEL__
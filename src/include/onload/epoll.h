@@ -68,6 +68,16 @@ struct oo_epoll1_set_home_arg {
   ci_int32              ready_list;  /**< id of ready list to use */
 };
 
+/* Maximum number of stacks other than the home stack in which an epoll set
+ * may hold a ready list. */
+#define OO_EPOLL1_SATELLITES_MAX  8
+
+struct oo_epoll1_satellite_arg {
+  ci_fixed_descriptor_t sockfd CI_ALIGN(8); /**< descriptor for fd in stack */
+  ci_int32              ready_list;  /**< id of ready list held */
+  ci_int32              slot;        /**< 0 <= slot < SATELLITES_MAX */
+};
+
 struct oo_epoll1_spin_on_arg {
   ci_uint64     timeout_us CI_ALIGN(8);
   ci_fixed_descriptor_t epoll_fd;
@@ -125,6 +135,13 @@ enum {
   OO_EPOLL1_OP_REMOVE_HOME_STACK,
 #define OO_EPOLL1_IOC_REMOVE_HOME_STACK \
   _IO(OO_EPOLL_IOC_BASE, OO_EPOLL1_OP_REMOVE_HOME_STACK)
+  OO_EPOLL1_OP_ADD_SATELLITE,
+#define OO_EPOLL1_IOC_ADD_SATELLITE \
+  _IOW(OO_EPOLL_IOC_BASE, OO_EPOLL1_OP_ADD_SATELLITE, \
+       struct oo_epoll1_satellite_arg)
+  OO_EPOLL1_OP_REMOVE_SATELLITE,
+#define OO_EPOLL1_IOC_REMOVE_SATELLITE \
+  _IOW(OO_EPOLL_IOC_BASE, OO_EPOLL1_OP_REMOVE_SATELLITE, ci_int32)
 #endif
 
   OO_EPOLL1_OP_BLOCK_ON,
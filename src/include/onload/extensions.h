@@ -15,6 +15,7 @@
 #define __ONLOAD_EXTENSIONS_H__
 
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <stdint.h>
 #include <onload/extensions_timestamping.h>
 
@@ -250,6 +251,49 @@ extern int onload_fd_check_feature(int fd, enum onload_fd_feature feature);
  */
 extern int onload_move_fd(int fd);
 
+/**********************************************************************
+ * onload_move_fds: Move several file descriptors to the current stack.
+ *
+ * As onload_move_fd(), for [n_fds] descriptors at once.  A thread that
+ * accepts connections and hands them to per-thread stacks can move a whole
+ * batch of newly accepted sockets with one call, which is cheaper than
+ * moving them one at a time.  The same limitations apply.
+ *
+ * Descriptors are moved in order, and the first one that can't be moved
+ * stops the batch.  Returns the number of descriptors moved, so if this is
+ * less than [n_fds] then fds[rc] and those after it have not been moved.
+ * In any case, all of the descriptors are good accelerated sockets after
+ * this call.
+ */
+extern int onload_move_fds(const int* fds, int n_fds);
+
+
+/**********************************************************************
+ * onload_connect_batch: Start connecting many sockets at once.
+ *
+ * Each request connects the TCP socket [fd] to [addr], as connect() would.
+ * Sockets should be non-blocking: accelerated sockets in the same stack
+ * are then connected with the stack locked once for all of them, and their
+ * SYNs are pushed to the NIC together, which is much cheaper than calling
+ * connect() for each when opening many connections at start-up.  Other
+ * sockets are connected one at a time with connect().
+ *
+ * On return each request's [rc] is 0 or -errno as connect() would give,
+ * so typically -EINPROGRESS.  Completion of each connection is reported as
+ * for connect(): the socket becomes writable, and SO_ERROR gives its
+ * result.
+ *
+ * Returns the number of requests whose [rc] is 0 or -EINPROGRESS.
+ */
+struct onload_connect_req {
+  int                    fd;
+  const struct sockaddr* addr;
+  socklen_t              addrlen;
+  int                    rc;
+};
+
+extern int onload_connect_batch(struct onload_connect_req* reqs, int n_reqs);
+
 
 /**********************************************************************
  * onload_ordered_epoll_wait: Wire order delivery via epoll
@@ -482,6 +526,19 @@ enum onload_delegated_send_rc {
 /* Resolve ARP if necessary - it might take some time */
 #define ONLOAD_DELEGATED_SEND_FLAG_RESOLVE_ARP 0x2
 
+/* One socket's part in onload_delegated_send_prepare_batch() and
+ * onload_delegated_send_complete_batch(). */
+struct onload_delegated_send_batch {
+  int                 fd;
+  int                 size;    /* prepare: bytes to reserve */
+  const struct iovec* iov;     /* complete: data sent via EF_VI */
+  int                 iovlen;
+  struct onload_delegated_send ds;
+  /* Out: enum onload_delegated_send_rc from prepare; from complete, the
+   * number of bytes, or -errno. */
+  int                 rc;
+};
+
 #ifndef ONLOAD_INCLUDE_DS_DATA_ONLY
 /* Prepare to make a delegated send.  
  *
@@ -602,6 +659,45 @@ extern int
 onload_delegated_send_cancel(int fd);
 
 
+/* Prepare delegated sends on several sockets at once.
+ *
+ * This behaves as onload_delegated_send_prepare() for each entry in turn,
+ * using its fd and size and filling in its ds and rc.  The sockets in a
+ * stack are prepared under a single hold of the stack lock, so the headers
+ * for all of them come from the same snapshot of the stacks' state and
+ * are ready to be sent back-to-back.
+ *
+ * If "headers" is not NULL then the headers are written to one contiguous
+ * buffer of n * headers_stride bytes, entry i at headers + i *
+ * headers_stride, and each ds.headers and ds.headers_len is set
+ * accordingly.  Otherwise the caller must set ds.headers and
+ * ds.headers_len in each entry as for onload_delegated_send_prepare().
+ *
+ * Returns the number of entries for which rc is
+ * ONLOAD_DELEGATED_SEND_RC_OK, or -1 with errno set if the arguments are
+ * invalid.
+ */
+
+extern int
+onload_delegated_send_prepare_batch(struct onload_delegated_send_batch* batch,
+                                    int n, unsigned flags, void* headers,
+                                    int headers_stride);
+
+/* Complete delegated sends on several sockets at once.
+ *
+ * This calls onload_delegated_send_complete() for each entry with its fd,
+ * iov, iovlen and the given flags, and stores the result in rc (or -errno
+ * on failure).  Entries are completed in order; each may block as
+ * onload_delegated_send_complete() does unless MSG_DONTWAIT is given.
+ *
+ * Returns the number of entries that completed successfully.
+ */
+
+extern int
+onload_delegated_send_complete_batch(struct onload_delegated_send_batch* batch,
+                                     int n, int flags);
+
+
 /**********************************************************************
  * onload_get_tcp_info: Onload-specific call similar to Linux TCP_INFO
  *
@@ -709,6 +805,130 @@ onload_socket_nonaccel(int domain, int type, int protocol);
 extern int
 onload_socket_unicast_nonaccel(int domain, int type, int protocol);
 
+
+/**********************************************************************
+ * onload_route_prewarm: look up routes to destinations in advance
+ *
+ * The first send from an Onload socket to a new destination may have to
+ * wait while the Onload control plane looks up the route, and then for
+ * ARP.  This function resolves the routes that [fd] would use to send to
+ * each of the [n_dsts] addresses in [dsts] (AF_INET or AF_INET6; the port
+ * is ignored), so that this wait does not happen in the fast path.  The
+ * lookups for all destinations are requested together, and ARP is started
+ * for each.
+ *
+ * Routes depend on the socket's local address, SO_BINDTODEVICE, IP_TOS and
+ * so on, so call this once those are set.  Routes expire again if they are
+ * not used for some time.
+ *
+ * Returns the number of destinations for which a route was found, or -1
+ * with errno set: EINVAL if [fd] is not an Onload TCP or UDP socket, or
+ * ENOSYS if the onload extensions library is not in use.
+ */
+extern int
+onload_route_prewarm(int fd, const struct sockaddr_storage* dsts, int n_dsts);
+
+
+/**********************************************************************
+ * onload_route_pin: keep routes to destinations resolved
+ *
+ * This is like onload_route_prewarm(), but remembers the route found for
+ * each destination.  Call it again on the same array from time to time
+ * (for example once a second) until the destinations are needed.  Routes
+ * which are still valid are not looked up again, and are kept from
+ * expiring; those which have changed or gone away are resolved afresh; and
+ * ARP is kept fresh for each.
+ *
+ * On return, [flags] in each entry tells the caller about that route:
+ *
+ *   ONLOAD_ROUTE_PIN_CHANGED: the route is not the one found by the
+ *     previous call for this entry (always set on the first successful
+ *     call);
+ *   ONLOAD_ROUTE_PIN_NO_ROUTE: there is no route to the destination;
+ *   ONLOAD_ROUTE_PIN_NO_MAC: the MAC address of the next hop is not known,
+ *     so a packet sent now would be delayed by ARP.
+ *
+ * Zero [priv] before the first call.  Returns the number of entries with
+ * a route, or -1 with errno set as for onload_route_prewarm().
+ */
+struct onload_route_pin {
+  struct sockaddr_storage dst;  /* set by the caller */
+  unsigned flags;               /* ONLOAD_ROUTE_PIN_* */
+  uint32_t priv[2];
+};
+
+#define ONLOAD_ROUTE_PIN_CHANGED   0x1
+#define ONLOAD_ROUTE_PIN_NO_ROUTE  0x2
+#define ONLOAD_ROUTE_PIN_NO_MAC    0x4
+
+extern int
+onload_route_pin(int fd, struct onload_route_pin* pins, int n_pins);
+
+
+/**********************************************************************
+ * onload_rx_drop_rule_set: drop unwanted traffic early
+ *
+ * Installs rule [rule_id] (0 to ONLOAD_RX_DROP_RULES_MAX - 1) in the stack
+ * of [fd], replacing any rule with the same id; if [rule] is NULL the rule
+ * is removed.  Each IPv4 packet received by the stack is checked against
+ * the rules in order of id before it is looked up in the socket tables.
+ * A packet matches a rule if the top [src_prefix_len] bits of its source
+ * address match [src], and its protocol and (for TCP and UDP) destination
+ * port match [protocol] and [dst_port] where those are non-zero.
+ *
+ * The first matching rule decides: if [rate_pps] is zero then the packet
+ * is dropped, otherwise it is only dropped if more than [rate_pps] packets
+ * per second have matched the rule.  Dropped packets are not seen by
+ * tcpdump or passed to the kernel.  onload_stackdump shows the rules and
+ * their counters.
+ *
+ * Returns 0, or -1 with errno set: EINVAL if [fd] is not an Onload TCP or
+ * UDP socket or the rule is invalid, or ENOSYS if the onload extensions
+ * library is not in use.
+ */
+#define ONLOAD_RX_DROP_RULES_MAX  16
+
+struct onload_rx_drop_rule {
+  struct in_addr src;
+  int src_prefix_len;     /* 0 to 32; 0 matches any source */
+  uint16_t dst_port;      /* host order; 0 matches any port */
+  uint8_t protocol;       /* IPPROTO_*; 0 matches any protocol */
+  uint32_t rate_pps;      /* 0 to drop every matching packet */
+};
+
+extern int
+onload_rx_drop_rule_set(int fd, int rule_id,
+                        const struct onload_rx_drop_rule* rule);
+
+/* Reads the number of packets that have matched rule [rule_id] in the
+ * stack of [fd], and how many of those were dropped, since the rule was
+ * set.  Returns 0, or -1 with errno set as for onload_rx_drop_rule_set().
+ */
+extern int
+onload_rx_drop_rule_stats(int fd, int rule_id, uint64_t* n_matched,
+                          uint64_t* n_dropped);
+
+
+/**********************************************************************
+ * onload_stack_irq_set_core: move a stack's interrupts
+ *
+ * Steers the interrupts that wake threads blocked on the stack of [fd] to
+ * [core], for use when the threads servicing the stack have moved since it
+ * was created with EF_IRQ_CORE.  If [core] is negative the core the caller
+ * is running on is used, so a polling thread can call this after it has
+ * been migrated.
+ *
+ * This is only possible on NICs whose interrupts Onload manages itself.
+ * An interrupt may be shared with other stacks, which then move too.
+ *
+ * Returns 0, or -1 with errno set: EINVAL if [fd] is not an Onload socket
+ * or [core] is not online, EOPNOTSUPP if none of the stack's interfaces
+ * allows its interrupts to be moved, or ENOSYS if the onload extensions
+ * library is not in use.
+ */
+extern int
+onload_stack_irq_set_core(int fd, int core);
+
 #endif /* ONLOAD_INCLUDE_DS_DATA_ONLY */
 
 #ifdef __cplusplus
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_HEADER >
+**  \brief  Onload submission/completion ring API
+** </L5_PRIVATE>
+**
+** Lets an application queue socket operations on many Onload sockets and
+** collect their results in batches, rather than making one system call
+** (and one fd table lookup) per operation.
+*//*
+\**************************************************************************/
+
+#ifndef __ONLOAD_EXTENSIONS_RING_H__
+#define __ONLOAD_EXTENSIONS_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Submission/completion rings
+ ******************************************************************************/
+
+/* An onload_ring is a pair of queues owned by the application.  Operations
+ * are described by filling in submission queue entries obtained from
+ * onload_ring_get_sqe() and handed to Onload with onload_ring_submit().
+ * Each operation produces exactly one completion queue entry, which is
+ * collected with onload_ring_reap().
+ *
+ * Operations never block.  Those which can complete immediately do so
+ * during onload_ring_submit(); the rest are retried on each call to
+ * onload_ring_reap(), which also polls the stacks they belong to.
+ * Operations on the same fd with the same opcode complete in the order
+ * they were submitted.
+ *
+ * A ring holds at most 'entries' operations at a time, counting those
+ * submitted but not yet completed and completions not yet reaped, so the
+ * completion queue cannot overflow.
+ *
+ * Only TCP and UDP sockets accelerated by Onload are supported.  A ring is
+ * not thread-safe: callers sharing one between threads must serialise all
+ * calls on it.
+ */
+
+struct onload_ring;
+
+enum onload_ring_op {
+  /* send(fd, buf, len, flags) */
+  ONLOAD_RING_OP_SEND = 1,
+  /* recv(fd, buf, len, flags) */
+  ONLOAD_RING_OP_RECV = 2,
+  /* accept4(fd, NULL, NULL, flags); buf and len are ignored.  Listening
+   * sockets shared with other threads calling accept() should be
+   * non-blocking, as otherwise a connection taken by another thread after
+   * it was seen to be ready will make the ring block. */
+  ONLOAD_RING_OP_ACCEPT = 3,
+};
+
+struct onload_ring_sqe {
+  int fd;
+  /* One of enum onload_ring_op */
+  uint8_t op;
+  uint8_t reserved[3];
+  /* MSG_* flags for send and recv, SOCK_* flags for accept.  MSG_DONTWAIT
+   * is implied. */
+  int flags;
+  void* buf;
+  size_t len;
+  /* Returned unchanged in the operation's completion */
+  uint64_t user_data;
+};
+
+struct onload_ring_cqe {
+  uint64_t user_data;
+  /* Bytes transferred or new fd on success, -errno on failure.  A stream
+   * send may complete with fewer bytes than requested, as with send(). */
+  int64_t res;
+  /* Reserved, currently 0 */
+  uint32_t flags;
+};
+
+/* Create a ring able to hold 'entries' operations, rounded up to a power
+ * of two.  Use onload_ring_free() to deallocate.
+ *
+ * flags must be 0
+ *
+ * Returns zero on success, or <0 to indicate an error
+ */
+extern int onload_ring_alloc(unsigned entries, int flags,
+                             struct onload_ring** ring_out);
+
+/* Free a ring created by onload_ring_alloc().  Outstanding operations are
+ * abandoned and unreaped completions discarded.
+ *
+ * Returns zero on success, or <0 to indicate an error
+ */
+extern int onload_ring_free(struct onload_ring* ring);
+
+/* Return the next free submission queue entry, or NULL if the ring is
+ * full.  The entry is not seen by Onload until onload_ring_submit().
+ */
+extern struct onload_ring_sqe* onload_ring_get_sqe(struct onload_ring* ring);
+
+/* Hand all entries obtained since the last call to Onload, attempting each
+ * one immediately.
+ *
+ * Returns the number of entries submitted, or <0 to indicate an error
+ */
+extern int onload_ring_submit(struct onload_ring* ring);
+
+/* Retry outstanding operations, then copy up to 'max' completions into
+ * 'cqes'.
+ *
+ * Returns the number of completions copied, which may be zero
+ */
+extern int onload_ring_reap(struct onload_ring* ring,
+                            struct onload_ring_cqe* cqes, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ONLOAD_EXTENSIONS_RING_H__ */
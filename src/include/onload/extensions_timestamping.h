@@ -27,8 +27,13 @@ extern "C" {
  * available, then its "sec" field will be zero and the value of other fields is
  * unspecified.
  *
+ * ONLOAD_TIMESTAMPING_FLAG_TX_RING reports TX timestamps through the stack's
+ * TX timestamp ring; see onload_tx_timestamp_ring_read() below.
+ *
  * Returns 0 on success, or a negative error code on failure.
  *   -EINVAL     unknown flag is set
+ *   -ENOSPC     ONLOAD_TIMESTAMPING_FLAG_TX_RING is set but the stack has no
+ *               TX timestamp ring (EF_TX_TIMESTAMP_RING is 0)
  *   -ENOTTY     fd does not refer to an onload-accelerated socket
  *   -EOPNOTSUPP this build of onload does not support timestamping
  */
@@ -53,10 +58,57 @@ enum onload_timestamping_flags {
   /* Request NIC and/or external timestamps for received packets */
   ONLOAD_TIMESTAMPING_FLAG_RX_NIC = 1 << 1,
   ONLOAD_TIMESTAMPING_FLAG_RX_CPACKET = 1 << 2,
+
+  /* Deliver NIC timestamps for sent packets to the stack's TX timestamp
+   * ring rather than the socket's error queue.  Implies
+   * ONLOAD_TIMESTAMPING_FLAG_TX_NIC. */
+  ONLOAD_TIMESTAMPING_FLAG_TX_RING = 1 << 3,
 };
 
 extern int onload_timestamping_request(int fd, unsigned flags);
 
+
+/**********************************************************************
+ * onload_tx_timestamp_ring_read: collect TX timestamps in bulk
+ *
+ * When EF_TX_TIMESTAMP_RING is set, each stack has a ring of that many
+ * transmit timestamp records in its shared state.  Sockets that have
+ * requested ONLOAD_TIMESTAMPING_FLAG_TX_RING have a record added for each
+ * packet they send (but not for retransmissions) when the NIC reports its
+ * timestamp, and do not queue anything on their error queue.  This avoids
+ * a recvmsg(MSG_ERRQUEUE) call per timestamp.
+ *
+ * onload_tx_timestamp_ring_read copies up to "max" records from the ring
+ * of the stack that "fd" belongs to, oldest first, and returns the number
+ * copied.  It does not take the stack lock, and can be called from any
+ * number of threads.  If "dropped" is not NULL it is set to the number of
+ * records that have been lost since the last call because the ring was
+ * full.
+ *
+ * Each record gives:
+ *  - endpoint_id: the socket, as reported by onload_fd_stat();
+ *  - id: as the SOF_TIMESTAMPING_OPT_ID key: for TCP the offset of the last
+ *    byte of the segment in the stream (or its sequence number if OPT_ID
+ *    has not been enabled); for UDP the datagram counter;
+ *  - ts: the NIC timestamp, with sec zero if it is not available (e.g.
+ *    because the NIC was reset).
+ *
+ * Returns the number of records copied, or a negative error code:
+ *   -ENOTTY     fd does not refer to an onload-accelerated socket
+ *   -ENOSPC     fd's stack has no TX timestamp ring
+ *   -EOPNOTSUPP this build of onload does not support timestamping
+ */
+
+struct onload_tx_timestamp {
+  int32_t  endpoint_id;
+  uint32_t id;
+  struct onload_timestamp ts;
+};
+
+extern int onload_tx_timestamp_ring_read(int fd,
+                                         struct onload_tx_timestamp* out,
+                                         int max, unsigned* dropped);
+
 #ifdef __cplusplus
 }
 #endif
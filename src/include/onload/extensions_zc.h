@@ -28,7 +28,8 @@ extern "C" {
  *  - Zero-copy UDP-TX
  *  - allow application to signal that fd table checks aren't necessary
  *  - forwarding: zero-copy receive into a buffer, app can then do a
- *    zero-copy send on the same buffer.
+ *    zero-copy send on the same buffer.  (TCP to TCP is covered by
+ *    onload_zc_forward().)
  */
 
 
@@ -277,6 +278,41 @@ struct onload_zc_recv_args {
 extern int onload_zc_recv(int fd, struct onload_zc_recv_args *args);
 
 
+/* onload_zc_recv_mmsg delivers the datagrams that are ready on each of a
+ * set of UDP sockets, using the same callback model as onload_zc_recv().
+ * Each element of the msgs array names a socket (msgs[i].fd) and the
+ * onload_zc_recv_args to use for it (msgs[i].args), set up as for
+ * onload_zc_recv().  The callback is passed &msgs[i].args, and returning
+ * ONLOAD_ZC_TERMINATE stops delivery for that socket only.
+ *
+ * The stack is polled once for all of the sockets that share it, rather
+ * than once per socket, so this is cheaper than calling onload_zc_recv()
+ * for each socket when an application has many sockets in one stack.
+ * Sockets in the same stack should be adjacent in the array for this to
+ * have full effect.
+ *
+ * The call never blocks: ONLOAD_MSG_DONTWAIT is implied, and the
+ * socket's SO_RCVTIMEO is ignored.  ONLOAD_MSG_RECV_OS_INLINE is honoured
+ * per socket as for onload_zc_recv().
+ *
+ * On return msgs[i].rc holds the number of datagrams delivered for that
+ * socket, or <0 to indicate an error for that socket: -ESOCKTNOSUPPORT if it
+ * is not an accelerated UDP socket, or -ENOTEMPTY if there is only kernel
+ * traffic and ONLOAD_MSG_RECV_OS_INLINE is not set.
+ *
+ * Returns the total number of datagrams delivered, or -EINVAL if mlen is
+ * less than 1.
+ */
+
+struct onload_zc_recv_mmsg {
+  struct onload_zc_recv_args args;
+  int fd;
+  int rc;
+};
+
+extern int onload_zc_recv_mmsg(struct onload_zc_recv_mmsg* msgs, int mlen);
+
+
 /* Use onload_recvmsg_kernel() to access packets delivered by
  * kernel/OS rather than Onload, when onload_zc_recv() returns
  * -ENOTEMPTY
@@ -343,6 +379,31 @@ extern int onload_recvmsg_kernel(int fd, struct msghdr *msg, int flags);
 extern int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags);
 
 
+/* onload_zc_forward moves data received on one TCP socket (in_fd) to the
+ * send queue of another (out_fd), as a proxy would with recv() and
+ * send(), but without copying through an application buffer.
+ *
+ * When both sockets are in the same stack, each received segment is moved
+ * onto out_fd's send queue in the packet buffer it arrived in, provided
+ * that its payload fits within out_fd's MSS and leaves room in front for
+ * out_fd's headers.  Other segments, and all segments when the sockets
+ * are in different stacks, are copied once, straight from the receive
+ * buffer, and resegmented by the normal send path.
+ *
+ * Whole received segments are forwarded: as many as are ready, up to the
+ * room in out_fd's send queue.  flags may be ONLOAD_MSG_DONTWAIT, in
+ * which case the call fails with -EAGAIN rather than waiting for data on
+ * in_fd or for room on out_fd.  Data taken from in_fd is always queued on
+ * out_fd in full, waiting if need be, and is dropped only if out_fd
+ * fails.  SIGPIPE is never raised.
+ *
+ * Returns the number of bytes forwarded, 0 at end of file on in_fd, or
+ * -errno.  Both sockets must be accelerated TCP sockets, otherwise
+ * -ESOCKTNOSUPPORT is returned.
+ */
+extern int onload_zc_forward(int in_fd, int out_fd, int flags);
+
+
 
 /******************************************************************************
  * Receive filtering 
@@ -435,9 +496,38 @@ extern int onload_set_recv_filter(int fd,
  * PIO AND trying to allocate the PIO in later calls to
  * onload_msg_template_update().
  *
+ * Setting ONLOAD_TEMPLATE_FLAGS_PIO_RESERVE reserves the PIO region
+ * allocated for the template for the socket.  Once the template has been
+ * sent or aborted the region is kept rather than being made available to
+ * other sockets, and the next template allocated with this flag on the same
+ * socket uses it (if it is big enough; otherwise a bigger region replaces
+ * the reservation).  The reservation lasts until the socket is shut down for
+ * writing or closed.  A few sockets on each interface can hold a
+ * reservation; beyond that, this flag has no effect.  It is intended for
+ * the small number of sockets whose sends are most latency-critical.
+ *
+ * When a template is freed Onload moves the PIO regions of other templates
+ * so that free space coalesces, and it does the same before failing an
+ * allocation, so a PIO region that has been fragmented by templates of
+ * different sizes can still satisfy larger templates.
+ *
  * onload_msg_template_update can be called multiple times and updates
  * are cumulative.
  *
+ * onload_msg_template_update_batch applies updates to several templates,
+ * which may be on different sockets, in a single call.  Each entry of the
+ * batch array names a socket, a template and its updates, as for
+ * onload_msg_template_update, and the result for the entry is returned
+ * in otmb_rc.  Templates on sockets in the same stack are handled with a
+ * single acquisition of the stack lock, and when sending with
+ * ONLOAD_TEMPLATE_FLAGS_SEND_NOW all that can take the fast path are
+ * prepared first and then pushed to the adapter back-to-back.  Entries are
+ * processed in order.  An entry that has to fall back to a normal send is
+ * sent after those before it and before those after it, and without
+ * ONLOAD_TEMPLATE_FLAGS_DONTWAIT it may block the rest of the batch.  The
+ * return value is zero if every entry succeeded, or otherwise the result
+ * of the first entry that failed.
+ *
  * onload_msg_template_abort can be used to abort a templated send
  * without sending.
  * 
@@ -477,16 +567,27 @@ struct onload_template_msg_update_iovec {
   unsigned otmu_flags;        /* For future use.  Must be set to 0. */
 };
 
+/* One entry of the array passed to onload_msg_template_update_batch() */
+struct onload_template_msg_update_batch {
+  int                    otmb_fd;      /* Socket the template belongs to */
+  onload_template_handle otmb_handle;  /* Template to update */
+  const struct onload_template_msg_update_iovec* otmb_updates;
+  int                    otmb_ulen;    /* Length of otmb_updates */
+  int                    otmb_rc;      /* Out: result for this entry */
+};
+
 /* Flags for use with onload_msg_template_alloc() and
  * onload_msg_template_update()
  */
 enum onload_template_flags {
   ONLOAD_TEMPLATE_FLAGS_SEND_NOW  = 0x1, /* Send the packet now */
   ONLOAD_TEMPLATE_FLAGS_PIO_RETRY = 0x2, /* Retry acquiring PIO */
+  ONLOAD_TEMPLATE_FLAGS_PIO_RESERVE = 0x4, /* Keep PIO for this socket */
   ONLOAD_TEMPLATE_FLAGS_DONTWAIT = MSG_DONTWAIT, /* Don't block (0x40) */
 };
 
-/* Valid options for flags are: ONLOAD_TEMPLATE_FLAGS_PIO_RETRY */
+/* Valid options for flags are: ONLOAD_TEMPLATE_FLAGS_PIO_RETRY,
+ * ONLOAD_TEMPLATE_FLAGS_PIO_RESERVE */
 extern int onload_msg_template_alloc(int fd, const struct iovec* initial_msg,
                                      int mlen, onload_template_handle* handle,
                                      unsigned flags);
@@ -500,6 +601,13 @@ onload_msg_template_update(int fd, onload_template_handle handle,
                            const struct onload_template_msg_update_iovec*,
                            int ulen, unsigned flags);
 
+/* Valid options for flags are: ONLOAD_TEMPLATE_FLAGS_SEND_NOW,
+ * ONLOAD_TEMPLATE_FLAGS_DONTWAIT.  They apply to every entry.
+ */
+extern int
+onload_msg_template_update_batch(struct onload_template_msg_update_batch*
+                                 batch, int n, unsigned flags);
+
 extern int onload_msg_template_abort(int fd, onload_template_handle handle);
 
 #ifdef __cplusplus
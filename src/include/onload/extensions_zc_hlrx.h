@@ -130,6 +130,35 @@ extern int onload_zc_register_buffers(int fd,
 extern int onload_zc_unregister_buffers(int fd,
                                         onload_zc_handle handle, int flags);
 
+
+/* Zero-copy memory shared between processes.
+ *
+ * onload_zc_shm_create() allocates a region of len bytes (a multiple of the
+ * page size), maps it into the caller at *addr_out and returns its id in
+ * *id_out.  Other processes run by the same user find the region with
+ * onload_zc_shm_list() and map it with onload_zc_shm_map().  Any process
+ * that has the region mapped can pass the mapping to
+ * onload_zc_register_buffers() on its own stack and then send from it
+ * with onload_zc_send() without copying, so one process can write
+ * messages that others send.
+ *
+ * fd may be any socket on a stack of the calling process.  A region can
+ * be found by onload_zc_shm_list() until that stack is freed by its
+ * creator, and its memory stays valid until every mapping is unmapped with
+ * munmap().  The processes must agree among themselves on the use of the
+ * memory.
+ *
+ * onload_zc_shm_list() fills ids with up to *n_in_out ids and sets
+ * *n_in_out to the number returned.
+ *
+ * These return zero on success, or <0 to indicate an error.  They return
+ * -ENOTSUP on platforms without driver-managed shared memory.
+ */
+extern int onload_zc_shm_create(int fd, uint64_t len, int* id_out,
+                                void** addr_out);
+extern int onload_zc_shm_list(int fd, int* ids, int* n_in_out);
+extern int onload_zc_shm_map(int fd, int id, uint64_t len, void** addr_out);
+
 /* Reports the location of Onload's rx packet buffers
  *
  * The intended use is to allow a client to preregister Onload's packet
@@ -205,7 +234,10 @@ extern int onload_zc_query_rx_memregs(int fd, struct onload_zc_iovec* iov,
  * cmsg_type=ONLOAD_SO_ONLOADZC_COMPLETE. The body is a single
  * void* containing the onload_zc_iovec::app_cookie field originally
  * passed in the onload_zc_send() call. Multiple completions may be
- * delivered in a single recvmsg() call, as multiple cmsgs.
+ * delivered in a single recvmsg() call, as multiple cmsgs. On TCP
+ * sockets a single call returns the completions of as many acked
+ * segments as fit in msg_control, so a buffer with room for many
+ * CMSG_SPACE(sizeof(void*)) entries reduces the number of calls needed.
  *
  * Applications are required to track incomplete buffers themselves. At
  * any close() (even after correct use of shutdown()) it cannot be
@@ -299,6 +331,21 @@ extern int onload_zc_hlrx_free(struct onload_zc_hlrx* hlrx);
  */
 extern int onload_zc_hlrx_buffer_release(int fd, onload_zc_handle buf);
 
+/* Frees an array of zc handles returned by onload_zc_hlrx_recv_zc(), with
+ * the same effect as calling onload_zc_hlrx_buffer_release() on each of
+ * them.  The stack lock is taken once for all the packets which the batch
+ * frees, rather than once per packet, so this is the cheaper way to return
+ * the buffers of several messages a parser has been holding.
+ *
+ * fd is as for onload_zc_hlrx_buffer_release(), and all the handles must
+ * come from the same stack.
+ *
+ * Returns 0 on success, or <0 to indicate an error
+ */
+extern int onload_zc_hlrx_buffer_release_batch(int fd,
+                                               const onload_zc_handle* bufs,
+                                               int n_bufs);
+
 /* Performs a copying receive on an hlrx state. This function operates
  * identically to recvmsg(), however it returns errors by return code
  * rather than by errno.
@@ -146,6 +146,8 @@ void oo_iobufset_kfree(struct oo_buffer_pages *pages);
  * \param order         page order to allocate
  * \param min_nic_order minimum NIC page order
  * \param flags         see OO_IOBUFSET_FLAG_*, in/out
+ * \param numa_node     node to allocate on, or NUMA_NO_NODE for the
+ *                      current node; not applied to huge pages
  * \param pages_out     pointer to return the allocated pages
  * \param hugetlb_alloc pointer to the allocator, can be NULL
  *
@@ -157,7 +159,7 @@ void oo_iobufset_kfree(struct oo_buffer_pages *pages);
  */
 extern int
 oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int *flags,
-                        struct oo_buffer_pages **pages_out,
+                        int numa_node, struct oo_buffer_pages **pages_out,
                         struct oo_hugetlb_allocator *hugetlb_alloc);
 extern void oo_iobufset_pages_release(struct oo_buffer_pages *);
 
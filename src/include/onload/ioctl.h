@@ -85,7 +85,7 @@ enum {
   OO_OP_TCP_PKT_WAIT,
 #define OO_IOC_TCP_PKT_WAIT         OO_IOC_W(TCP_PKT_WAIT, ci_int32)
   OO_OP_TCP_MORE_BUFS,
-#define OO_IOC_TCP_MORE_BUFS        OO_IOC_NONE(TCP_MORE_BUFS)
+#define OO_IOC_TCP_MORE_BUFS        OO_IOC_W(TCP_MORE_BUFS, ci_int32)
   OO_OP_TCP_MORE_SOCKS,
 #define OO_IOC_TCP_MORE_SOCKS       OO_IOC_NONE(TCP_MORE_SOCKS)
 
@@ -189,6 +189,9 @@ enum {
 #define OO_IOC_MOVE_FD              OO_IOC_W(MOVE_FD, \
                                              ci_fixed_descriptor_t)
 
+  OO_OP_MOVE_FDS,
+#define OO_IOC_MOVE_FDS             OO_IOC_RW(MOVE_FDS, oo_move_fds_t)
+
   OO_OP_EP_REUSEPORT_BIND,
 #define OO_IOC_EP_REUSEPORT_BIND                        \
   OO_IOC_W(EP_REUSEPORT_BIND, oo_tcp_reuseport_bind_t)
@@ -251,6 +254,10 @@ enum {
 #define OO_IOC_DESIGN_PARAMETERS OO_IOC_RW(DESIGN_PARAMETERS, \
                                            oo_design_parameters_t)
 
+  /* Steer the stack's interrupts to a core; negative for the caller's */
+  OO_OP_IRQ_SET_CORE,
+#define OO_IOC_IRQ_SET_CORE OO_IOC_W(IRQ_SET_CORE, ci_int32)
+
   OO_OP_CONTIG_END,  /* This is the last in range of contigous opcodes */
 
   /* Here come only placeholder for operations with arbitrary codes */
@@ -20,6 +20,13 @@ struct oo_shmbuf {
   /* Number of continuous chank allocated initially */
   int init_num;
 
+  /* Whether to try to give chunks added later physically-contiguous
+   * memory, and how many of them got it.  Such chunks are accessed via the
+   * kernel's direct mapping, which uses huge pages, instead of vmalloc
+   * space. */
+  int contig;
+  int n_contig;
+
   void** addrs;
 #define OO_SHMBUF_INIT_CHUNK ((void*)1UL)
 
@@ -71,7 +78,7 @@ static inline long oo_shmbuf_size(struct oo_shmbuf* sh)
 }
 
 extern int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order,
-                           int max, int init_num);
+                           int max, int init_num, int contig);
 extern void oo_shmbuf_free(struct oo_shmbuf* sh);
 extern int oo_shmbuf_add(struct oo_shmbuf* sh);
 extern int oo_shmbuf_fault(struct oo_shmbuf* sh, struct vm_area_struct* vma,
@@ -35,6 +35,7 @@ enum {
 
 extern int oof_shared_keep_thresh;
 extern int oof_shared_steal_thresh;
+extern int oof_filter_pressure_thresh;
 extern int oof_all_ports_required;
 extern int oof_use_all_local_ip_addresses;
 
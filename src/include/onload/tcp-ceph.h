@@ -84,6 +84,17 @@ union ceph_control_pkt {
 #define XSN_CEPH_CTRL_ADD_CREDIT       0
 #define XSN_CEPH_CTRL_CONSUME_PAYLOAD  1
 
+/* The plugin delivers a stream's received bytes to the host as a sequence of
+ * these messages.  Message headers and small payloads arrive inline.  The
+ * plugin writes larger data segments into the stream's ring in on-NIC
+ * memory, whose size is set by in_data_buf_capacity, and sends only a
+ * REMOTE descriptor.  onload_zc_recv() passes each REMOTE segment to the
+ * app as an iovec in the plugin's address space.  The app moves the segment
+ * into its own buffers with a NIC memcpy, then frees the ring space with
+ * ONLOAD_SIOC_CEPH_REMOTE_CONSUME.
+ *
+ * The plugin picks where in the ring each segment lands.  This protocol
+ * cannot name a host buffer as the destination for a segment. */
 struct ceph_data_pkt {
   uint16_t msg_type;
   uint16_t msg_len;
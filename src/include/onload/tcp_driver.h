@@ -88,6 +88,9 @@ typedef struct efab_tcp_driver_s {
   struct page        *timesync_page;
   struct oo_timesync *timesync;
 
+  /* Thread polling stacks with EF_SHARED_POLL, if shared_poll_cpu is set */
+  struct task_struct *shared_poller;
+
 } efab_tcp_driver_t;
 
 
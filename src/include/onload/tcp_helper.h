@@ -133,6 +133,11 @@ typedef struct tcp_helper_cluster_s {
    * the tcp_helper_resource_t instances that use it for the packet buffer
    * allocation. */
   struct oo_hugetlb_allocator*    thc_pktbuf_alloc;
+
+  /* State of tcp_helper_cluster_rebalance(), protected by thc_mutex. */
+  unsigned long                   thc_rebalance_next;
+  unsigned                        thc_rebalance_moves;
+  unsigned                        thc_rebalance_fails;
 } tcp_helper_cluster_t;
 
 
@@ -215,8 +220,17 @@ typedef struct tcp_helper_resource_s {
   /*! Link for global list of stacks. */
   ci_dllink              all_stacks_link;
 
-  /* VI descruction completion helper. */
+  /*! For EF_STACK_LINGER: [linger_held] is set while the stack holds an
+   * app-level reference on itself, which [linger_work] drops once the stack
+   * has been idle for long enough. */
+  struct delayed_work    linger_work;
+  ci_uint32              linger_held;
+  int                    linger_idle;
+
+  /* VI descruction completion helper, completed once [n_vis_flushing]
+   * drops to zero. */
   struct completion complete;
+  atomic_t n_vis_flushing;
 
 #if ! CI_CFG_UL_INTERRUPT_HELPER
   /* For pinning periodic work */
@@ -231,6 +245,17 @@ typedef struct tcp_helper_resource_s {
   /* List of endpoints requiring work in non-atomic context. */
   ci_sllist     non_atomic_list;
 
+  /* For EF_IRQ_FOLLOW: the core the interrupts are steered to, the core
+   * that blocking readers have recently been seen on and how many times
+   * in a row, and when and how often [irq_follow_work] has moved them.
+   * Updated without locks; a lost update only delays a move. */
+  struct work_struct irq_follow_work;
+  int                irq_follow_core;
+  int                irq_follow_cand;
+  unsigned           irq_follow_hits;
+  unsigned           irq_follow_moves;
+  unsigned long      irq_follow_last;
+
 #if CI_CFG_NIC_RESET_SUPPORT
   /* For deferring resets to a non-atomic context. */
 #define ONLOAD_RESET_WQ_NAME "onload-rst-wq:%s"
@@ -351,6 +376,8 @@ typedef struct tcp_helper_resource_s {
   ci_dllink             thc_thr_link;
   /* bucket of rss hardware filter */
   int thc_rss_instance;
+  /* rx_evs at the cluster's last rebalance check */
+  ci_uint32 thc_rebalance_rx_evs;
   /* backing store for efct's mmappable hugepages */
   struct oo_hugetlb_allocator* thc_efct_alloc;
   /* backing store for packet buffers */
@@ -231,7 +231,11 @@ extern int efab_tcp_helper_map_usermem(tcp_helper_resource_t* trs,
 extern void efab_tcp_helper_unmap_usermem(tcp_helper_resource_t* trs,
                                           struct oo_iobufs_usermem* ioum);
 
-extern int efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs);
+/* Allocate another packet set.  If [rx_intf_i] is non-negative the buffers
+ * are wanted for that interface's receive ring, which affects where they
+ * are placed with EF_PKT_NUMA. */
+extern int efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs,
+                                     int rx_intf_i);
 
 extern int efab_tcp_helper_more_socks(tcp_helper_resource_t* trs);
 
@@ -285,7 +289,11 @@ tcp_helper_cluster_post_filter_add(tcp_helper_cluster_t* thc, int hwport,
 extern int
 tcp_helper_cluster_dump(tcp_helper_resource_t* thr, void* buf, int buf_len);
 
+extern void
+tcp_helper_cluster_rebalance(tcp_helper_resource_t* thr);
+
 extern int tcp_helper_cluster_alloc_thr(const char* name,
+                                        const char* stack_name,
                                         int cluster_size,
                                         int cluster_restart,
                                         int pktbuf_memfd,
@@ -369,6 +377,18 @@ ci_inline void tcp_helper_request_wakeup(tcp_helper_resource_t* trs) {
 
 void tcp_helper_request_timer(tcp_helper_resource_t* trs);
 
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+/* EF_IRQ_FOLLOW: called in the context of a thread about to block on one
+ * of the stack's sockets. */
+extern void tcp_helper_irq_follow_sleeper(tcp_helper_resource_t* trs);
+
+ci_inline void tcp_helper_irq_follow(tcp_helper_resource_t* trs)
+{
+  if( NI_OPTS(&trs->netif).irq_follow )
+    tcp_helper_irq_follow_sleeper(trs);
+}
+#endif
+
 extern void generic_tcp_helper_close(ci_private_t* priv);
 
 
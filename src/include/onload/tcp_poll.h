@@ -23,14 +23,17 @@ ci_tcp_poll_events_listen(ci_netif *ni, ci_tcp_socket_listen *tls)
 }
 
 /* The timestamp_q is subtly managed to ensure that tx_pending packets do not
- * appear to be visible. See doc at ci_tcp_state::timestamp_q */
+ * appear to be visible. See doc at ci_tcp_state::timestamp_q
+ *
+ * MSG_ZEROCOPY notifications share the error queue, so count here too. */
 ci_inline bool
 ci_tcp_poll_timestamp_q_nonempty(ci_netif *ni, ci_tcp_state *ts)
 {
 #if CI_CFG_TIMESTAMPING
-  return ! ci_udp_recv_q_is_empty(&ts->timestamp_q);
+  return ! ci_udp_recv_q_is_empty(&ts->timestamp_q) ||
+         ci_sock_zc_pending(&ts->s);
 #else
-  return 0;
+  return ci_sock_zc_pending(&ts->s);
 #endif
 }
 
@@ -152,6 +155,7 @@ ci_udp_poll_events(ci_netif* ni, ci_udp_state* us)
 #if CI_CFG_TIMESTAMPING
      ci_udp_recv_q_not_empty(&us->timestamp_q) ||
 #endif
+      ci_sock_zc_pending(&us->s) ||
       (us->s.os_sock_status & OO_OS_STATUS_ERR) ) {
     events |= POLLERR;
     if( us->s.s_aflags & CI_SOCK_AFLAG_SELECT_ERR_QUEUE )
@@ -36,6 +36,24 @@
 #endif
 
 
+/* Number of waited-on objects whose wait times each thread remembers for
+ * EF_SPIN_ADAPT, and the number of (power-of-two microsecond) buckets in
+ * the histogram kept for each. */
+#define OO_SPIN_ADAPT_KEYS     4
+#define OO_SPIN_ADAPT_BUCKETS  16
+
+struct oo_spin_adapt {
+  /* Socket or epoll set; NULL if unused */
+  const void* key;
+  /* Sum of [hist], which is halved when it becomes large, so that old
+   * samples fade out. */
+  ci_uint16   n;
+  /* Number of waits in a row for which spinning was skipped */
+  ci_uint16   n_skipped;
+  /* hist[i] counts waits shorter than 2^i usec (and at least 2^(i-1)) */
+  ci_uint16   hist[OO_SPIN_ADAPT_BUCKETS];
+};
+
 struct oo_per_thread {
   ci_netif_config_opts*      thread_local_netif_opts;
   int                        initialised;
@@ -45,9 +63,15 @@ struct oo_per_thread {
   ci_uint64                  poll_nonblock_fast_frc;
   ci_uint64                  select_nonblock_fast_frc;
   struct oo_timesync         timesync;
+  /* ns per frc tick, derived from [timesync] when it was last refreshed */
+  double                     timesync_ns_rate;
   unsigned                   spinstate; 
   int                        in_vfork_child;
   void*                      vfork_scratch[OO_VFORK_SCRATCH_SIZE];
+  /* Packet cache index plus one, or 0 if not yet chosen */
+  unsigned                   pkt_mag_slot;
+  struct oo_spin_adapt       spin_adapt[OO_SPIN_ADAPT_KEYS];
+  unsigned                   spin_adapt_next;
 };
 
 
@@ -43,6 +43,10 @@ extern void oo_stackname_init(void) CI_HF;
 
 extern void oo_stackname_get(char **stackname) CI_HF;
 
+/* Whether the calling thread's stack name was set for it alone, with
+ * onload_set_stackname(ONLOAD_THIS_THREAD, ...). */
+extern int oo_stackname_is_thread_local(void) CI_HF;
+
 extern void oo_stackname_thread_init(struct oo_stackname_state*) CI_HF;
 
 extern void 
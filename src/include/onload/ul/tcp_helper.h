@@ -17,7 +17,7 @@
 extern int ci_tcp_helper_more_socks(struct ci_netif_s*) CI_HF;
 
 /*! Comment? */
-extern int ci_tcp_helper_more_bufs(struct ci_netif_s* ni) CI_HF;
+extern int ci_tcp_helper_more_bufs(struct ci_netif_s* ni, int rx_intf_i) CI_HF;
 
 /* Allocate fd for a stack; attach the stack from [from_fd] to thie new fd;
  * specialise it as a netif-fd. */
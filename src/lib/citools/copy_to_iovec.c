@@ -13,6 +13,9 @@
 
 /*! \cidoxg_lib_citools */
 #include "citools_internal.h"
+#if ! defined(__KERNEL__) && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 
 int ci_copy_to_iovec(ci_iovec_ptr* dest, const void* src, int src_len)
@@ -48,4 +51,48 @@ int ci_copy_to_iovec(ci_iovec_ptr* dest, const void* src, int src_len)
   }
 }
 
+
+#ifndef __KERNEL__
+
+void ci_memcpy_nt(void* dest, const void* src, size_t len)
+{
+#ifdef __SSE2__
+  char* d = dest;
+  const char* s = src;
+  size_t head = -(uintptr_t) d & 15;
+  __m128i x0, x1, x2, x3;
+
+  /* Not worth it for less than a few cache lines. */
+  if( len < head + 256 ) {
+    memcpy(dest, src, len);
+    return;
+  }
+
+  /* Streaming stores need an aligned destination. */
+  memcpy(d, s, head);
+  d += head;
+  s += head;
+  len -= head;
+
+  for( ; len >= 64; len -= 64, d += 64, s += 64 ) {
+    x0 = _mm_loadu_si128((const __m128i*) s);
+    x1 = _mm_loadu_si128((const __m128i*) (s + 16));
+    x2 = _mm_loadu_si128((const __m128i*) (s + 32));
+    x3 = _mm_loadu_si128((const __m128i*) (s + 48));
+    _mm_stream_si128((__m128i*) d, x0);
+    _mm_stream_si128((__m128i*) (d + 16), x1);
+    _mm_stream_si128((__m128i*) (d + 32), x2);
+    _mm_stream_si128((__m128i*) (d + 48), x3);
+  }
+  memcpy(d, s, len);
+  /* Streaming stores are weakly ordered, so make sure they're visible
+   * before anything the caller does next. */
+  _mm_sfence();
+#else
+  memcpy(dest, src, len);
+#endif
+}
+
+#endif
+
 /*! \cidoxg_end */
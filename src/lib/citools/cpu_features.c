@@ -152,6 +152,27 @@ get_cpuid(int op, int *eax, int *ebx, int *ecx, int *edx)
                         : "a" (op));
 }
 
+ci_inline void
+get_cpuid_count(int op, int count, int *eax, int *ebx, int *ecx, int *edx)
+{
+  __asm__ __volatile__ ("cpuid\n\t"
+                        : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                        : "a" (op), "c" (count));
+}
+
+/* Whether the OS saves the AVX (YMM) register state across context
+ * switches.  Without that AVX instructions can't be used even if the CPU
+ * has them. */
+ci_inline int os_saves_ymm(int leaf1_ecx)
+{
+  unsigned lo, hi;
+
+  if( ! (leaf1_ecx & 0x08000000) )  /* OSXSAVE */
+    return 0;
+  __asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+  return (lo & 0x6) == 0x6;
+}
+
 #else
 
 /*****************************************************************************
@@ -177,6 +198,19 @@ int ci_cpu_has_feature(char* feature)
 
   if( ! strcmp(feature, "pclmul") )
     return ecx & 0x00000002;
+  if( ! strcmp(feature, "sse4.2") )
+    return ecx & 0x00100000;
+#endif
+#if defined(__x86_64__)
+  if( ! strcmp(feature, "avx2") ) {
+    if( ! os_saves_ymm(ecx) )
+      return 0;
+    get_cpuid(0, &eax, &ebx, &ecx, &edx);
+    if( eax < 7 )
+      return 0;
+    get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+    return ebx & 0x00000020;
+  }
 #endif
 
   /* Not supported on platforms that don't implement the CPUID instruction */
@@ -23,7 +23,7 @@ typedef union {
 
 
 /* Length must be a multiple of half-words */
-unsigned ci_ip_csum_copy2(void* dest, const void* src, int n, unsigned sum)
+unsigned ci_ip_csum_copy2_c(void* dest, const void* src, int n, unsigned sum)
 {
   ci_uint32* d4 = (ci_uint32*) dest;
   const ci_uint32 *es4, *s4 = (const ci_uint32*) src;
@@ -50,4 +50,19 @@ unsigned ci_ip_csum_copy2(void* dest, const void* src, int n, unsigned sum)
   return sum;
 }
 
+
+unsigned ci_ip_csum_copy2(void* dest, const void* src, int n, unsigned sum)
+{
+#if CI_IP_CSUM_AVX2
+  if( n >= CI_IP_CSUM_AVX2_MIN && ci_ip_csum_avx2_ok() ) {
+    int n32 = n & ~31;
+    sum = ci_ip_csum_copy2_avx2(dest, src, n32, sum);
+    dest = (char*) dest + n32;
+    src = (const char*) src + n32;
+    n -= n32;
+  }
+#endif
+  return ci_ip_csum_copy2_c(dest, src, n, sum);
+}
+
 /*! \cidoxg_end */
@@ -15,10 +15,11 @@
  
 #include "citools_internal.h"
 #include <ci/net/ipv4.h>
+#include <ci/tools/ipcsum_base.h>
 
 
-unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
-			    int bytes)
+unsigned ci_ip_csum_partial_c(unsigned sum, const volatile void* in_buf,
+			      int bytes)
 {
   const ci_uint16* buf = (const ci_uint16*) in_buf;
 
@@ -38,4 +39,19 @@ unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
   return sum;
 }
 
+
+unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
+			    int bytes)
+{
+#if CI_IP_CSUM_AVX2
+  if( bytes >= CI_IP_CSUM_AVX2_MIN && ci_ip_csum_avx2_ok() ) {
+    int n = bytes & ~31;
+    sum = ci_ip_csum_partial_avx2(sum, (const void*) in_buf, n);
+    in_buf = (const volatile char*) in_buf + n;
+    bytes -= n;
+  }
+#endif
+  return ci_ip_csum_partial_c(sum, in_buf, bytes);
+}
+
 /*! \cidoxg_end */
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+** \author
+**  \brief  Internet checksum, and checksum with copy, using AVX2.
+**   \date  2023/10/14
+**    \cop  (c) Advanced Micro Devices, Inc.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_citools */
+
+#include "citools_internal.h"
+#include <ci/tools/cpu_features.h>
+
+#if CI_IP_CSUM_AVX2
+
+#include <immintrin.h>
+
+/* Each iteration adds at most 0xffff to each 32-bit lane of an
+ * accumulator, so lanes can't overflow within this many iterations. */
+#define AVX2_CSUM_BLOCK  (32 * 0x8000)
+
+#define AVX2 __attribute__((target("avx2")))
+
+
+int ci_ip_csum_avx2_ok(void)
+{
+  static int avx2_support = -1;
+
+  if(CI_UNLIKELY( avx2_support < 0 ))
+    avx2_support = ci_cpu_has_feature("avx2") != 0;
+  return avx2_support;
+}
+
+
+/* Add the 32-bit lanes of [acc] into 64-bit lanes of [acc64]. */
+AVX2 ci_inline __m256i avx2_widen_add(__m256i acc64, __m256i acc)
+{
+  acc64 = _mm256_add_epi64(acc64,
+                 _mm256_cvtepu32_epi64(_mm256_castsi256_si128(acc)));
+  return _mm256_add_epi64(acc64,
+                 _mm256_cvtepu32_epi64(_mm256_extracti128_si256(acc, 1)));
+}
+
+
+AVX2 ci_inline unsigned avx2_finish(__m256i acc64, unsigned sum)
+{
+  ci_uint64 s = sum;
+
+  s += (ci_uint64) _mm256_extract_epi64(acc64, 0);
+  s += (ci_uint64) _mm256_extract_epi64(acc64, 1);
+  s += (ci_uint64) _mm256_extract_epi64(acc64, 2);
+  s += (ci_uint64) _mm256_extract_epi64(acc64, 3);
+  /* 2^16 == 1 in ones' complement arithmetic, so folding preserves the
+   * checksum. */
+  s = (s & 0xffffffff) + (s >> 32);
+  s = (s & 0xffffffff) + (s >> 32);
+  s = (s & 0xffff) + (s >> 16);
+  s = (s & 0xffff) + (s >> 16);
+  s = (s & 0xffff) + (s >> 16);
+  return (unsigned) s;
+}
+
+
+/* The low and high half-words of each 32-bit lane are summed into
+ * separate accumulators, so that there are two independent dependency
+ * chains and no lane ever carries into its neighbour. */
+AVX2 unsigned ci_ip_csum_partial_avx2(unsigned sum, const void* buf,
+                                      int bytes)
+{
+  const __m256i mask = _mm256_set1_epi32(0xffff);
+  const char* p = buf;
+  __m256i acc64 = _mm256_setzero_si256();
+  __m256i lo, hi, v;
+  int n;
+
+  ci_assert(buf || bytes == 0);
+  ci_assert_equal(bytes & 31, 0);
+
+  while( bytes > 0 ) {
+    n = CI_MIN(bytes, AVX2_CSUM_BLOCK);
+    bytes -= n;
+    lo = hi = _mm256_setzero_si256();
+    for( ; n > 0; n -= 32, p += 32 ) {
+      v = _mm256_loadu_si256((const __m256i*) p);
+      lo = _mm256_add_epi32(lo, _mm256_and_si256(v, mask));
+      hi = _mm256_add_epi32(hi, _mm256_srli_epi32(v, 16));
+    }
+    acc64 = avx2_widen_add(acc64, lo);
+    acc64 = avx2_widen_add(acc64, hi);
+  }
+
+  return avx2_finish(acc64, sum);
+}
+
+
+AVX2 unsigned ci_ip_csum_copy2_avx2(void* dest, const void* src, int n,
+                                    unsigned sum)
+{
+  const __m256i mask = _mm256_set1_epi32(0xffff);
+  const char* s = src;
+  char* d = dest;
+  __m256i acc64 = _mm256_setzero_si256();
+  __m256i lo, hi, v;
+  int block;
+
+  ci_assert(dest || n == 0);
+  ci_assert(src  || n == 0);
+  ci_assert_equal(n & 31, 0);
+
+  while( n > 0 ) {
+    block = CI_MIN(n, AVX2_CSUM_BLOCK);
+    n -= block;
+    lo = hi = _mm256_setzero_si256();
+    for( ; block > 0; block -= 32, s += 32, d += 32 ) {
+      v = _mm256_loadu_si256((const __m256i*) s);
+      _mm256_storeu_si256((__m256i*) d, v);
+      lo = _mm256_add_epi32(lo, _mm256_and_si256(v, mask));
+      hi = _mm256_add_epi32(hi, _mm256_srli_epi32(v, 16));
+    }
+    acc64 = avx2_widen_add(acc64, lo);
+    acc64 = avx2_widen_add(acc64, hi);
+  }
+
+  return avx2_finish(acc64, sum);
+}
+
+#endif  /* CI_IP_CSUM_AVX2 */
+
+/*! \cidoxg_end */
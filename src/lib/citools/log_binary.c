@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/*! \cidoxg_lib_citools */
+
+/*
+** Binary logging: ci_blog() stores the format string pointer, a timestamp
+** and the raw arguments in a ring private to the calling thread, without
+** taking a lock or formatting anything.  The rings are formatted and
+** passed to ci_log() by ci_blog_dump().
+**
+** To enable binary logging call ci_blog_till_exit(), which also dumps the
+** rings on ci_fail() and at exit.
+*/
+
+#include "citools_internal.h"
+#include <pthread.h>
+
+
+#define BLOG_RING_SIZE  4096u   /* records per thread; power of 2 */
+
+struct ci_blog_rec {
+  const char*   fmt;
+  ci_uint64     frc;
+  unsigned long args[CI_BLOG_MAX_ARGS];
+};
+
+struct ci_blog_ring {
+  struct ci_blog_ring* next;
+  unsigned long        thread;
+  /* Only the owning thread writes [write_i].  [read_i] is only touched by
+   * ci_blog_dump(), which is serialised by [blog_dump_lock]. */
+  volatile ci_uint32   write_i;
+  ci_uint32            read_i;
+  struct ci_blog_rec   recs[BLOG_RING_SIZE];
+};
+
+
+int ci_blog_enabled = 0;
+
+static __thread struct ci_blog_ring* blog_ring;
+static struct ci_blog_ring* volatile blog_rings;
+static pthread_mutex_t blog_dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static CI_NORETURN (*real_stop_fn)(void);
+
+
+static struct ci_blog_ring* blog_ring_alloc(void)
+{
+  struct ci_blog_ring* r = malloc(sizeof(*r));
+  struct ci_blog_ring* head;
+
+  if( r == NULL )
+    return NULL;
+  r->thread = (unsigned long) pthread_self();
+  r->write_i = r->read_i = 0;
+  do
+    r->next = head = blog_rings;
+  while( ! ci_cas_uintptr_succeed(&blog_rings, (ci_uintptr_t) head,
+                                  (ci_uintptr_t) r) );
+  return r;
+}
+
+
+void __ci_blog(const char* fmt, unsigned long a0, unsigned long a1,
+               unsigned long a2, unsigned long a3, unsigned long a4,
+               unsigned long a5)
+{
+  struct ci_blog_ring* r = blog_ring;
+  struct ci_blog_rec* rec;
+
+  if(CI_UNLIKELY( r == NULL )) {
+    if( (r = blog_ring = blog_ring_alloc()) == NULL )
+      return;
+  }
+
+  /* When the ring is full the oldest records are overwritten. */
+  rec = &r->recs[r->write_i & (BLOG_RING_SIZE - 1)];
+  rec->fmt = fmt;
+  ci_frc64(&rec->frc);
+  rec->args[0] = a0;
+  rec->args[1] = a1;
+  rec->args[2] = a2;
+  rec->args[3] = a3;
+  rec->args[4] = a4;
+  rec->args[5] = a5;
+  ci_wmb();
+  r->write_i = r->write_i + 1;
+}
+
+
+void ci_blog_dump(void)
+{
+  struct ci_blog_ring* r;
+  char line[CI_LOG_MAX_LINE];
+
+  pthread_mutex_lock(&blog_dump_lock);
+  for( r = blog_rings; r != NULL; r = r->next ) {
+    ci_uint32 write_i = r->write_i;
+    ci_uint32 i = r->read_i;
+    unsigned lost = 0;
+
+    ci_rmb();
+    if( write_i - i > BLOG_RING_SIZE ) {
+      lost = write_i - i - BLOG_RING_SIZE;
+      i = write_i - BLOG_RING_SIZE;
+    }
+    for( ; i != write_i; ++i ) {
+      struct ci_blog_rec rec = r->recs[i & (BLOG_RING_SIZE - 1)];
+      ci_rmb();
+      /* The owner may have wrapped round and rewritten this record while
+       * we copied it. */
+      if( r->write_i - i > BLOG_RING_SIZE ) {
+        ++lost;
+        continue;
+      }
+      snprintf(line, sizeof(line), rec.fmt, rec.args[0], rec.args[1],
+               rec.args[2], rec.args[3], rec.args[4], rec.args[5]);
+      ci_log("%lx %010"CI_PRIu64" %s", r->thread,
+             (ci_uint64) (rec.frc & 0xffffffffffull), line);
+    }
+    r->read_i = write_i;
+    if( lost )
+      ci_log("%lx: %u binary log records lost", r->thread, lost);
+  }
+  pthread_mutex_unlock(&blog_dump_lock);
+}
+
+
+static CI_NORETURN blog_stop_fn(void)
+{
+  ci_blog_dump();
+  real_stop_fn();
+}
+
+
+static void blog_exit_fn(int status, void* arg)
+{
+  ci_blog_dump();
+}
+
+
+void ci_blog_till_exit(void)
+{
+  if( ci_blog_enabled )  return;
+
+  real_stop_fn = ci_fail_stop_fn;
+  ci_fail_stop_fn = blog_stop_fn;
+  /* Not atexit(), which needs __dso_handle from the CRT that libonload is
+   * built without. */
+  on_exit(blog_exit_fn, NULL);
+  ci_blog_enabled = 1;
+}
+
+/*! \cidoxg_end */
@@ -10,6 +10,7 @@ LIB_SRCS	:= \
 		bufrange.c \
 		crc16.c \
 		crc32.c \
+		crc32c.c \
 		toeplitz.c \
 		cpu_features.c \
 		dllist.c \
@@ -45,7 +46,8 @@ LIB_SRCS	:= \
 ifeq ($(DRIVER),1)
 LIB_SRCS	+= drv_log_fn.c memleak_debug.c
 else
-LIB_SRCS	+= get_cpu_khz.c log_fn.c log_file.c
+LIB_SRCS	+= get_cpu_khz.c log_fn.c log_file.c log_binary.c
+LIB_SRCS	+= ipcsum_avx2.c
 LIB_SRCS	+= glibc_version.c
 endif
 
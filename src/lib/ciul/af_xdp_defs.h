@@ -5,4 +5,12 @@
 
 #include <ci/driver/efab/hardware/af_xdp.h>
 
+/* These are part of the kernel ABI, but may be missing from older headers */
+#ifndef XDP_RING_NEED_WAKEUP
+#define XDP_RING_NEED_WAKEUP (1 << 0)
+#endif
+#ifndef XDP_PKT_CONTD
+#define XDP_PKT_CONTD (1 << 0)
+#endif
+
 #endif /* AF_XDP_DEFS_H */
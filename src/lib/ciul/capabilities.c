@@ -120,6 +120,22 @@ int ef_pd_capabilities_get(ef_driver_handle handle, ef_pd* pd,
 }
 
 
+int ef_vi_capabilities_tx_flags(ef_driver_handle handle, int ifindex,
+                                enum ef_vi_flags* flags)
+{
+  unsigned long val;
+  int rc = ef_vi_capabilities_get(handle, ifindex, EF_VI_CAP_CTPIO, &val);
+
+  if( rc == -EOPNOTSUPP )
+    return 0;
+  if( rc < 0 )
+    return rc;
+  if( val )
+    *flags |= EF_VI_TX_CTPIO;
+  return 0;
+}
+
+
 int ef_vi_capabilities_max(void)
 {
   return EF_VI_CAP_MAX - 1;
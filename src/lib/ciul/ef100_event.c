@@ -24,6 +24,9 @@ typedef ci_qword_t ef_vi_event;
   ((((q)->ep_state->evq.evq_ptr + sizeof(ef_vi_event) * (i)) &    \
     ((q)->evq_mask + 1)) != 0)
 
+/* Events are 8 bytes, so this many share a cache line of the ring. */
+#define EF100_EVS_PER_LINE  (EF_VI_DMA_ALIGN / sizeof(ef_vi_event))
+
 #define INC_ERROR_STAT(vi, name)		\
   do {                                          \
     if ((vi)->vi_stats != NULL)                 \
@@ -39,12 +42,6 @@ static inline ef_vi_event* ef100_eventq_get_event_by_offset(ef_vi* evq,
 }
 
 
-static inline ef_vi_event* ef100_eventq_get_event(ef_vi* evq)
-{
-  return ef100_eventq_get_event_by_offset(evq, 0);
-}
-
-
 static inline bool ef100_eventq_is_overflow(ef_vi* evq)
 {
   return ef100_eventq_get_event_by_offset(evq, evq->ep_state->evq.evq_clear_stride - 1) == NULL;
@@ -134,17 +131,51 @@ static void ef100_driver_event(ef_vi* evq, const ef_vi_event* ev,
 }
 
 
-ef_vi_inline void ef100_rx_event(ef_vi* evq_vi, const ef_vi_event* ev,
-				ef_event** evs, int* evs_len)
+/* Handle a run of RX events for the same queue with a single lookup of the
+ * queue.  Returns the number of events handled.
+ */
+ef_vi_inline unsigned ef100_rx_event_run(ef_vi* evq_vi, const ef_vi_event* ev,
+                                         unsigned n_ev, ef_event** evs,
+                                         int* evs_len)
 {
   unsigned q_label = QWORD_GET_U(ESF_GZ_EV_RXPKTS_Q_LABEL, *ev);
   ef_vi* vi = evq_vi->vi_qs[q_label];
-  if(likely( vi != NULL )) {
-    riverhead_rx_pkts_consumed(vi, ev, evs, evs_len, q_label);
-  }
-  else {
+  unsigned i;
+
+  if(unlikely( vi == NULL )) {
     INC_ERROR_STAT(evq_vi, rx_ev_bad_q_label);
+    return 1;
+  }
+  if( n_ev > (unsigned) *evs_len )
+    n_ev = *evs_len;
+
+  i = 0;
+  do
+    riverhead_rx_pkts_consumed(vi, &ev[i], evs, evs_len, q_label);
+  while( ++i < n_ev &&
+         QWORD_GET_U(ESF_GZ_E_TYPE, ev[i]) == ESE_GZ_EF100_EV_RX_PKTS &&
+         QWORD_GET_U(ESF_GZ_EV_RXPKTS_Q_LABEL, ev[i]) == q_label );
+  return i;
+}
+
+
+/* Copy out the events from the read pointer to the end of its cache line,
+ * and return how many of them, from the first, are present.  The line
+ * never wraps, so all of its events share the same expected phase.
+ */
+ef_vi_inline unsigned ef100_eventq_read_line(ef_vi* evq, ef_vi_event* line)
+{
+  const ef_vi_event* pev = EF_VI_EVENT_PTR(evq, 0);
+  unsigned n = EF100_EVS_PER_LINE -
+    EF_VI_EVENT_OFFSET(evq, 0) / sizeof(ef_vi_event) % EF100_EVS_PER_LINE;
+  unsigned phase = EF_VI_EVQ_PHASE(evq, 0);
+  unsigned i, absent = 1u << n;
+
+  for( i = 0; i < n; ++i ) {
+    line[i] = pev[i];
+    absent |= (unsigned) (EF_VI_EVENT_PHASE(&line[i]) != phase) << i;
   }
+  return __builtin_ctz(absent);
 }
 
 
@@ -217,7 +248,8 @@ int ef100_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
 {
   unsigned ev_type;
   int evs_len_orig = evs_len;
-  ef_vi_event *pev, ev;
+  ef_vi_event line[EF100_EVS_PER_LINE], ev;
+  unsigned i, n, n_done;
   static int overflow_logged = 0;
   unsigned tx_desc_id[EF_VI_MAX_QS];
   unsigned tx_desc_init = 0;
@@ -228,57 +260,61 @@ int ef100_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
   if(unlikely( ef100_eventq_is_overflow(evq) ))
     goto overflow;
 
-  pev = ef100_eventq_get_event(evq);
-  if( !pev )
+  n = ef100_eventq_read_line(evq, line);
+  if( n == 0 )
     return 0;
 
   do {
-    ev = *pev;
-
-    /* Ugly: Exploit the fact that event code lies in top bits
-     * of event. */
-    ev_type = QWORD_GET_U(ESF_GZ_E_TYPE, ev);
-    switch( ev_type ) {
-    case ESE_GZ_EF100_EV_RX_PKTS:
-      ef100_rx_event(evq, &ev, &evs, &evs_len);
-      break;
-
-    case ESE_GZ_EF100_EV_TX_COMPLETION:
-      ef100_tx_event(evq, &ev, pev, &evs, &evs_len, tx_desc_id, &tx_desc_init);
-      break;
-
-    case ESE_GZ_EF100_EV_MCDI:
-      /* Do not process MCDI events if we have
-       * already delivered other events to the
-       * app */
-      if (evs_len != evs_len_orig)
-        goto out;
-      ef100_mcdi_event(evq, &ev, &evs, &evs_len);
-      break;
+    for( i = 0; i < n; i += n_done ) {
+      ev = line[i];
+      n_done = 1;
+
+      /* Ugly: Exploit the fact that event code lies in top bits
+       * of event. */
+      ev_type = QWORD_GET_U(ESF_GZ_E_TYPE, ev);
+      switch( ev_type ) {
+      case ESE_GZ_EF100_EV_RX_PKTS:
+        n_done = ef100_rx_event_run(evq, &line[i], n - i, &evs, &evs_len);
+        break;
+
+      case ESE_GZ_EF100_EV_TX_COMPLETION:
+        ef100_tx_event(evq, &ev, EF_VI_EVENT_PTR(evq, 0), &evs, &evs_len,
+                       tx_desc_id, &tx_desc_init);
+        break;
 
-    case ESE_GZ_EF100_EV_DRIVER:
-      ef100_driver_event(evq, &ev, &evs, &evs_len);
-      break;
+      case ESE_GZ_EF100_EV_MCDI:
+        /* Do not process MCDI events if we have
+         * already delivered other events to the
+         * app */
+        if (evs_len != evs_len_orig)
+          goto out;
+        ef100_mcdi_event(evq, &ev, &evs, &evs_len);
+        break;
 
-    case ESE_GZ_EF100_EV_CONTROL:
-      ef_log("%s: ERROR: ESE_GZ_EF100_EV_CONTROL is not supported", __FUNCTION__);
-      --evs_len;
+      case ESE_GZ_EF100_EV_DRIVER:
+        ef100_driver_event(evq, &ev, &evs, &evs_len);
         break;
-      /* ...deliberate fall-through... */
-    default:
-      ef_log("%s: ERROR: event ev="CI_QWORD_FMT,
-             __FUNCTION__,
-             CI_QWORD_VAL(ev));
-      break;
-    }
 
-    evq->ep_state->evq.evq_ptr += sizeof(ef_vi_event);
+      case ESE_GZ_EF100_EV_CONTROL:
+        ef_log("%s: ERROR: ESE_GZ_EF100_EV_CONTROL is not supported", __FUNCTION__);
+        --evs_len;
+          break;
+        /* ...deliberate fall-through... */
+      default:
+        ef_log("%s: ERROR: event ev="CI_QWORD_FMT,
+               __FUNCTION__,
+               CI_QWORD_VAL(ev));
+        break;
+      }
+
+      evq->ep_state->evq.evq_ptr += n_done * sizeof(ef_vi_event);
 
-    if (evs_len == 0)
-      break;
+      if (evs_len == 0)
+        goto out;
+    }
 
-    pev = ef100_eventq_get_event(evq);
-  } while( pev );
+    n = ef100_eventq_read_line(evq, line);
+  } while( n != 0 );
 
  out:
   return evs_len_orig - evs_len;
@@ -299,6 +335,8 @@ int ef100_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
   return 1;
 }
 
+EF_VI_ARCH_EXPORT(ef100_ef_eventq_poll, ef_vi_ef100_eventq_poll)
+
 
 int ef_eventq_check_event_phase_bit(const ef_vi* vi, int look_ahead)
 {
@@ -329,6 +329,29 @@ static void ef100_ef_vi_receive_push(ef_vi* vi)
   }
 }
 
+static int ef100_ef_vi_receive_post_burst(ef_vi* vi, const ef_addr* addrs,
+                                          const ef_request_id* dma_ids, int n)
+{
+  ef_vi_rxq* q = &vi->vi_rxq;
+  ef_vi_rxq_state* qs = &vi->ep_state->rxq;
+  int i, space = ef_vi_receive_space(vi);
+  unsigned di;
+
+  if( n > space )
+    n = space;
+
+  for( i = 0; i < n; ++i ) {
+    di = qs->added++ & q->mask;
+    EF_VI_BUG_ON(q->ids[di] !=  EF_REQUEST_ID_MASK);
+    q->ids[di] = dma_ids[i];
+    ef100_rx_desc_fill(addrs[i],
+                       (ef_vi_ef100_dma_rx_desc*) q->descriptors + di,
+                       vi->rx_buffer_len);
+  }
+  ef100_ef_vi_receive_push(vi);
+  return n;
+}
+
 
 static int ef100_ef_vi_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
                                 ef_request_id dma_id)
@@ -342,6 +365,22 @@ static int ef100_ef_vi_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
 }
 
 
+static int ef100_ef_vi_transmitv_burst(ef_vi* vi, const ef_iovec* iov,
+                                       const ef_request_id* dma_ids, int n)
+{
+  int i;
+
+  for( i = 0; i < n; ++i )
+    if( ef100_ef_vi_transmitv_init(vi, &iov[i], 1, dma_ids[i]) < 0 )
+      break;
+  if( i > 0 ) {
+    wmb();
+    ef100_ef_vi_transmit_push(vi);
+  }
+  return i;
+}
+
+
 ef_vi_inline void
 ef100_pio_set_desc(ef_vi* vi, ef_vi_txq* q, ef_vi_txq_state* qs,
                   int offset, int len, ef_request_id dma_id)
@@ -580,6 +619,13 @@ static int ef100_ef_vi_transmit_memcpy_sync(struct ef_vi* vi,
 }
 
 
+EF_VI_ARCH_EXPORT(ef100_ef_vi_transmit, ef_vi_ef100_transmit)
+EF_VI_ARCH_EXPORT(ef100_ef_vi_transmitv, ef_vi_ef100_transmitv)
+EF_VI_ARCH_EXPORT(ef100_ef_vi_transmit_push, ef_vi_ef100_transmit_push)
+EF_VI_ARCH_EXPORT(ef100_ef_vi_receive_init, ef_vi_ef100_receive_init)
+EF_VI_ARCH_EXPORT(ef100_ef_vi_receive_push, ef_vi_ef100_receive_push)
+
+
 static void ef100_vi_initialise_ops(ef_vi* vi)
 {
   vi->ops.transmit               = ef100_ef_vi_transmit;
@@ -617,6 +663,8 @@ static void ef100_vi_initialise_ops(ef_vi* vi)
   }
   vi->ops.transmit_ctpio_fallback = ef100_ef_vi_transmit_ctpio_fallback;
   vi->ops.transmitv_ctpio_fallback = ef100_ef_vi_transmitv_ctpio_fallback;
+  vi->ops.receive_post_burst     = ef100_ef_vi_receive_post_burst;
+  vi->ops.transmitv_burst        = ef100_ef_vi_transmitv_burst;
 }
 
 void ef100_vi_init(ef_vi* vi)
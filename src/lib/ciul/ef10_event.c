@@ -34,6 +34,10 @@ typedef ci_qword_t ef_vi_event;
      CI_DWORD_IS_ALL_ONES((evp)->dword[1])))
 
 
+/* Events are 8 bytes, so this many share a cache line of the ring. */
+#define EF10_EVS_PER_LINE  (EF_VI_DMA_ALIGN / sizeof(ef_vi_event))
+
+
 #define INC_ERROR_STAT(vi, name)		\
   do {                                          \
     if ((vi)->vi_stats != NULL)                 \
@@ -282,6 +286,60 @@ ef_vi_inline void ef10_rx_event(ef_vi* evq_vi, const ef_vi_event* ev,
 }
 
 
+/* Handle a run of RX events that each complete one error-free, non-jumbo
+ * descriptor of the same normal RXQ, which is what we see when receiving
+ * small packets at a high rate.  The per-queue lookups are done once for
+ * the whole run.  Returns the number of events handled, which is zero if
+ * the first one doesn't qualify.
+ */
+ef_vi_inline unsigned ef10_rx_event_run(ef_vi* evq_vi, const ef_vi_event* ev,
+                                        unsigned n_ev, ef_event** evs,
+                                        int* evs_len)
+{
+  const unsigned short_di_mask = (1u << ESF_DZ_RX_DSC_PTR_LBITS_WIDTH) - 1u;
+  unsigned q_label = QWORD_GET_U(ESF_DZ_RX_QLABEL, *ev);
+  ef_vi* vi = evq_vi->vi_qs[q_label];
+  ef_event* ev_out = *evs;
+  ef_vi_rxq_state* qs;
+  unsigned i, desc_i;
+
+  if( vi == NULL || ! vi->vi_is_normal )
+    return 0;
+  qs = &vi->ep_state->rxq;
+  if( qs->in_jumbo )
+    return 0;
+  if( n_ev > (unsigned) *evs_len )
+    n_ev = *evs_len;
+
+  for( i = 0; i < n_ev; ++i, ++ev ) {
+    if( CI_QWORD_FIELD(*ev, ESF_DZ_EV_CODE) != ESE_DZ_EV_CODE_RX_EV ||
+        QWORD_GET_U(ESF_DZ_RX_QLABEL, *ev) != q_label ||
+        ((QWORD_GET_U(ESF_DZ_RX_DSC_PTR_LBITS, *ev) - qs->removed) &
+         short_di_mask) != 1 ||
+        QWORD_GET_U(ESF_DZ_RX_CONT, *ev) ||
+        (ev->u64[0] & vi->rx_discard_mask) )
+      break;
+    desc_i = qs->removed & vi->vi_rxq.mask;
+    ev_out->rx.type = EF_EVENT_TYPE_RX;
+    ev_out->rx.ofs = 0;
+    ev_out->rx.q_id = q_label;
+    ev_out->rx.rq_id = vi->vi_rxq.ids[desc_i];
+    vi->vi_rxq.ids[desc_i] = EF_REQUEST_ID_MASK;
+    ev_out->rx.flags = EF_EVENT_FLAG_SOP;
+    if( QWORD_GET_U(ESF_DZ_RX_MAC_CLASS, *ev) == ESE_DZ_MAC_CLASS_MCAST )
+      ev_out->rx.flags |= EF_EVENT_FLAG_MULTICAST;
+    qs->bytes_acc = QWORD_GET_U(ESF_DZ_RX_BYTES, *ev);
+    ev_out->rx.len = qs->bytes_acc;
+    ++(qs->removed);
+    ++ev_out;
+  }
+
+  *evs = ev_out;
+  *evs_len -= i;
+  return i;
+}
+
+
 /* These constants describe useful values to combine major ticks with
  * TX timestamp events on Medford
  */
@@ -848,10 +906,41 @@ static void ef10_mcdi_event(ef_vi* evq, const ef_vi_event* ev,
 }
 
 
+/* Copy out the events from the read pointer to the end of its cache line,
+ * and return how many of them, from the first, are present.  The presence
+ * tests don't depend on one another, so checking the whole line costs
+ * little more than checking one event.  The ring size is a multiple of the
+ * line size, so the line never wraps.
+ */
+ef_vi_inline unsigned ef10_eventq_read_line(ef_vi* evq, ef_vi_event* line)
+{
+  const ef_vi_event* pev = EF_VI_EVENT_PTR(evq, 0);
+  unsigned n = EF10_EVS_PER_LINE -
+    EF_VI_EVENT_OFFSET(evq, 0) / sizeof(ef_vi_event) % EF10_EVS_PER_LINE;
+  unsigned i, absent = 1u << n;
+
+  for( i = 0; i < n; ++i ) {
+    line[i] = pev[i];
+    absent |= (unsigned) ! EF_VI_IS_EVENT(&line[i]) << i;
+  }
+  return __builtin_ctz(absent);
+}
+
+
+ef_vi_inline void ef10_eventq_consume(ef_vi* evq, unsigned n)
+{
+  do {
+    CI_SET_QWORD(*EF_VI_EVENT_PTR(evq, evq->ep_state->evq.evq_clear_stride));
+    evq->ep_state->evq.evq_ptr += sizeof(ef_vi_event);
+  } while( --n );
+}
+
+
 int ef10_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
 {
   int evs_len_orig = evs_len;
-  ef_vi_event *pev, ev;
+  ef_vi_event line[EF10_EVS_PER_LINE], ev;
+  unsigned i, n, n_done;
   static int overflow_logged = 0;
 
   EF_VI_BUG_ON(evs == NULL);
@@ -861,61 +950,66 @@ int ef10_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
     goto overflow;
 
  not_empty:
-  /* Read the event out of the ring, then fiddle with copied version.
+  /* Read the events out of the ring, then fiddle with copied versions.
    * Reason is that the ring is likely to get pushed out of cache by
    * another event being delivered by hardware.
    */
-  pev = EF_VI_EVENT_PTR(evq, 0);
-  ev = *pev;
-  if (!EF_VI_IS_EVENT(&ev))
+  n = ef10_eventq_read_line(evq, line);
+  if (n == 0)
     goto empty;
   do {
-    /* Ugly: Exploit the fact that event code lies in top bits
-     * of event. */
-    BUG_ON(ESF_DZ_EV_CODE_LBN < 32u);
-    switch( CI_QWORD_FIELD(ev, ESF_DZ_EV_CODE) ) {
-    case ESE_DZ_EV_CODE_RX_EV:
-      ef10_rx_event(evq, &ev, &evs, &evs_len);
-      break;
+    for( i = 0; i < n; i += n_done ) {
+      ev = line[i];
+      n_done = 1;
+      /* Ugly: Exploit the fact that event code lies in top bits
+       * of event. */
+      BUG_ON(ESF_DZ_EV_CODE_LBN < 32u);
+      switch( CI_QWORD_FIELD(ev, ESF_DZ_EV_CODE) ) {
+      case ESE_DZ_EV_CODE_RX_EV:
+        n_done = ef10_rx_event_run(evq, &line[i], n - i, &evs, &evs_len);
+        if( n_done == 0 ) {
+          ef10_rx_event(evq, &ev, &evs, &evs_len);
+          n_done = 1;
+        }
+        break;
 
-    case ESE_DZ_EV_CODE_TX_EV:
-      ef10_tx_event(evq, &ev, &evs, &evs_len);
-      break;
+      case ESE_DZ_EV_CODE_TX_EV:
+        ef10_tx_event(evq, &ev, &evs, &evs_len);
+        break;
 
-    case ESE_DZ_EV_CODE_MCDI_EV:
-      /* Do not process MCDI events if we have
-       * already delivered other events to the
-       * app */
-      if (evs_len != evs_len_orig)
-        goto out;
-      ef10_mcdi_event(evq, &ev, &evs, &evs_len);
-      break;
+      case ESE_DZ_EV_CODE_MCDI_EV:
+        /* Do not process MCDI events if we have
+         * already delivered other events to the
+         * app */
+        if (evs_len != evs_len_orig)
+          goto out;
+        ef10_mcdi_event(evq, &ev, &evs, &evs_len);
+        break;
 
-    case ESE_DZ_EV_CODE_DRIVER_EV:
-      if (QWORD_GET_U(ESF_DZ_DRV_SUB_CODE, ev) ==
-          ESE_DZ_DRV_START_UP_EV)
-        /* Ignore. */
+      case ESE_DZ_EV_CODE_DRIVER_EV:
+        if (QWORD_GET_U(ESF_DZ_DRV_SUB_CODE, ev) ==
+            ESE_DZ_DRV_START_UP_EV)
+          /* Ignore. */
+          break;
+        ci_fallthrough;
+      default:
+        ef_log("%s: ERROR: event type=%u ev="CI_QWORD_FMT,
+               __FUNCTION__,
+               (unsigned) CI_QWORD_FIELD(ev, ESF_DZ_EV_CODE),
+               CI_QWORD_VAL(ev));
         break;
-      ci_fallthrough;
-    default:
-      ef_log("%s: ERROR: event type=%u ev="CI_QWORD_FMT,
-             __FUNCTION__,
-             (unsigned) CI_QWORD_FIELD(ev, ESF_DZ_EV_CODE),
-             CI_QWORD_VAL(ev));
-      break;
-    }
+      }
 
-    /* Consume event.  Must do after event checking above,
-     * in case we don't want to consume it. */
-    CI_SET_QWORD(*EF_VI_EVENT_PTR(evq, evq->ep_state->evq.evq_clear_stride));
-    evq->ep_state->evq.evq_ptr += sizeof(ef_vi_event);
+      /* Consume event.  Must do after event checking above,
+       * in case we don't want to consume it. */
+      ef10_eventq_consume(evq, n_done);
 
-    if (evs_len == 0)
-      break;
+      if (evs_len == 0)
+        goto out;
+    }
 
-    pev = EF_VI_EVENT_PTR(evq, 0);
-    ev = *pev;
-  } while (EF_VI_IS_EVENT(&ev));
+    n = ef10_eventq_read_line(evq, line);
+  } while (n != 0);
 
  out:
   return evs_len_orig - evs_len;
@@ -954,6 +1048,8 @@ int ef10_ef_eventq_poll(ef_vi* evq, ef_event* evs, int evs_len)
   return 1;
 }
 
+EF_VI_ARCH_EXPORT(ef10_ef_eventq_poll, ef_vi_ef10_eventq_poll)
+
 
 void ef10_ef_eventq_prime(ef_vi* vi)
 {
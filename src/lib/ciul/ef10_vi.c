@@ -280,6 +280,22 @@ static int ef10_ef_vi_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
 }
 
 
+static int ef10_ef_vi_transmitv_burst(ef_vi* vi, const ef_iovec* iov,
+                                      const ef_request_id* dma_ids, int n)
+{
+  int i;
+
+  for( i = 0; i < n; ++i )
+    if( ef10_ef_vi_transmitv_init(vi, &iov[i], 1, dma_ids[i]) < 0 )
+      break;
+  if( i > 0 ) {
+    wmb();
+    ef10_ef_vi_transmit_push(vi);
+  }
+  return i;
+}
+
+
 ef_vi_inline void
 ef10_pio_set_desc(ef_vi* vi, ef_vi_txq* q, ef_vi_txq_state* qs,
                   int offset, int len, ef_request_id dma_id)
@@ -478,6 +494,38 @@ static inline __attribute__((always_inline)) void
                       copy_to_fallback, fallback);
 }
 
+#if defined(__x86_64__) && ! defined(__KERNEL__)
+/* As the fast method, but with 32-byte stores for frames in one buffer.
+ * Only selected when the CPU has AVX2.
+ */
+static __attribute__((target("avx2"))) void
+  ef10_ef_vi_transmitv_ctpio_wide(ef_vi* vi, size_t frame_len,
+                                  const struct iovec* iov, int iovcnt,
+                                  unsigned threshold)
+{
+  int time_stamp_req = (vi->vi_flags & EF_VI_TX_TIMESTAMPS) != 0;
+  ci_dword_t header;
+
+  if( iovcnt != 1 ) {
+    ef10_ef_vi_transmitv_ctpio(vi, frame_len, iov, iovcnt, threshold,
+                               0, 0, 0, NULL);
+    return;
+  }
+
+  EF_VI_ASSERT( vi->vi_flags & EF_VI_TX_CTPIO );
+  EF_VI_ASSERT( vi->vi_ctpio_mmap_ptr != NULL );
+  EF_VI_ASSERT( frame_len == iov[0].iov_len );
+
+  CI_POPULATE_DWORD_3(header,
+                      ESF_FZ_USER_THRESHOLD, threshold,
+                      ESF_FZ_TIME_STAMP_REQ, time_stamp_req,
+                      ESF_FZ_FRAME_LENGTH, frame_len);
+
+  memcpy_to_ctpio_avx2((void*) vi->vi_ctpio_mmap_ptr, header.u32[0],
+                       iov[0].iov_base, frame_len);
+}
+#endif
+
 /* Use this if CPU generally emits write-combined writes in-order.
  */
 static void
@@ -782,6 +830,50 @@ static void ef10_ef_vi_receive_push(ef_vi* vi)
 }
 
 
+static int ef10_ef_vi_receive_post_burst(ef_vi* vi, const ef_addr* addrs,
+                                         const ef_request_id* dma_ids, int n)
+{
+  ef_vi_rxq* q = &vi->vi_rxq;
+  ef_vi_rxq_state* qs = &vi->ep_state->rxq;
+  int i, space = ef_vi_receive_space(vi);
+  unsigned di;
+
+  if( n > space )
+    n = space;
+
+  for( i = 0; i < n; ++i ) {
+    di = qs->added++ & q->mask;
+    EF_VI_BUG_ON(q->ids[di] !=  EF_REQUEST_ID_MASK);
+    q->ids[di] = dma_ids[i];
+
+    if( vi->vi_flags & EF_VI_RX_PHYS_ADDR )
+      ef10_dma_rx_calc_ip_phys(addrs[i],
+                               (ef_vi_ef10_dma_rx_phys_desc*) q->descriptors
+                               + di, vi->rx_buffer_len);
+    else
+      ef10_dma_rx_calc_ip_buf(addrs[i],
+                              (ef_vi_ef10_dma_rx_buf_desc*) q->descriptors
+                              + di, vi->rx_buffer_len);
+  }
+  ef10_ef_vi_receive_push(vi);
+  return n;
+}
+
+
+static int ef10_ef_vi_receive_post_burst_ps(ef_vi* vi, const ef_addr* addrs,
+                                            const ef_request_id* dma_ids,
+                                            int n)
+{
+  int i, rc = 0;
+
+  for( i = 0; i < n; ++i )
+    if( (rc = ef10_ef_vi_receive_init_ps(vi, addrs[i], dma_ids[i])) < 0 )
+      break;
+  ef10_ef_vi_receive_push(vi);
+  return i > 0 || rc == -EAGAIN ? i : rc;
+}
+
+
 static void select_ctpio_method(ef_vi* vi)
 {
 #ifndef __KERNEL__
@@ -799,6 +891,18 @@ static void select_ctpio_method(ef_vi* vi)
       vi->ops.transmitv_ctpio      = ef10_ef_vi_transmitv_ctpio_in_order;
       vi->ops.transmitv_ctpio_copy = ef10_ef_vi_transmitv_ctpio_copy_in_order;
     }
+#ifdef __x86_64__
+    else if( ! strcmp(s, "wide") ) {
+      vi->ops.transmitv_ctpio_copy = ef10_ef_vi_transmitv_ctpio_copy_fast;
+      if( __builtin_cpu_supports("avx2") ) {
+        vi->ops.transmitv_ctpio    = ef10_ef_vi_transmitv_ctpio_wide;
+      }
+      else {
+        ef_log("ef_vi: EF_VI_CTPIO_MODE=wide needs AVX2, using fast");
+        vi->ops.transmitv_ctpio    = ef10_ef_vi_transmitv_ctpio_fast;
+      }
+    }
+#endif
     else {
       ef_log("ef_vi: ERROR: bad EF_VI_CTPIO_MODE='%s'", s);
       abort();
@@ -815,6 +919,13 @@ static void select_ctpio_method(ef_vi* vi)
 }
 
 
+EF_VI_ARCH_EXPORT(ef10_ef_vi_transmit, ef_vi_ef10_transmit)
+EF_VI_ARCH_EXPORT(ef10_ef_vi_transmitv, ef_vi_ef10_transmitv)
+EF_VI_ARCH_EXPORT(ef10_ef_vi_transmit_push, ef_vi_ef10_transmit_push)
+EF_VI_ARCH_EXPORT(ef10_ef_vi_receive_init, ef_vi_ef10_receive_init)
+EF_VI_ARCH_EXPORT(ef10_ef_vi_receive_push, ef_vi_ef10_receive_push)
+
+
 static void ef10_vi_initialise_ops(ef_vi* vi)
 {
   vi->ops.transmit               = ef10_ef_vi_transmit;
@@ -835,8 +946,10 @@ static void ef10_vi_initialise_ops(ef_vi* vi)
   vi->ops.transmit_alt_discard   = ef10_ef_vi_transmit_alt_discard;
   if( vi->vi_flags & EF_VI_RX_PACKED_STREAM ) {
     vi->ops.receive_init   = ef10_ef_vi_receive_init_ps;
+    vi->ops.receive_post_burst = ef10_ef_vi_receive_post_burst_ps;
   } else {
     vi->ops.receive_init   = ef10_ef_vi_receive_init;
+    vi->ops.receive_post_burst = ef10_ef_vi_receive_post_burst;
   }
   vi->ops.receive_push           = ef10_ef_vi_receive_push;
   vi->ops.eventq_poll            = ef10_ef_eventq_poll;
@@ -850,6 +963,7 @@ static void ef10_vi_initialise_ops(ef_vi* vi)
   vi->ops.eventq_timer_zero      = ef10_ef_eventq_timer_zero;
   vi->ops.transmit_memcpy        = ef10_ef_vi_transmit_memcpy;
   vi->ops.transmit_memcpy_sync   = ef10_ef_vi_transmit_memcpy_sync;
+  vi->ops.transmitv_burst        = ef10_ef_vi_transmitv_burst;
   if( vi->vi_flags & EF_VI_TX_CTPIO ) {
     vi->ops.transmit_ctpio_fallback = ef10_ef_vi_transmit_ctpio_fallback;
     vi->ops.transmitv_ctpio_fallback = ef10_ef_vi_transmitv_ctpio_fallback;
@@ -99,6 +99,12 @@ void ef10ct_receive_push(struct ef_vi *vi) {
     ef10ct_unsupported_msg(__func__);
 }
 
+static int ef10ct_receive_post_burst(struct ef_vi *vi, const ef_addr *addrs,
+                                     const ef_request_id *ids, int n) {
+    ef10ct_unsupported_msg(__func__);
+    return -EOPNOTSUPP;
+}
+
 int ef10ct_eventq_poll(struct ef_vi *vi, ef_event *evs, int evs_len) {
     int n = 0;
     /* TODO EF10CT poll receive queue(s) */
@@ -215,6 +221,8 @@ static void ef10ct_initialise_ops(ef_vi *vi) {
     vi->ops.transmit_memcpy_sync        = ef10ct_transmit_memcpy_sync;
     vi->ops.transmit_ctpio_fallback     = ef10ct_transmit_ctpio_fallback;
     vi->ops.transmitv_ctpio_fallback    = ef10ct_transmitv_ctpio_fallback;
+    vi->ops.receive_post_burst          = ef10ct_receive_post_burst;
+    vi->ops.transmitv_burst             = efct_ef_vi_transmitv_burst;
 
     vi->internal_ops.design_parameters = ef10ct_design_parameters;
 }
@@ -144,6 +144,30 @@ static int clusterd_recv(int sock, char* resp_buf, int resp_buflen, int* fd_out)
 }
 
 
+/* Receive a single newline-terminated message.  Resize notifications can
+ * arrive at any time, so don't consume more than one message at once.
+ */
+static int clusterd_recv_line(int sock, char* buf, int buflen, int flags)
+{
+  char* nl;
+  int rc;
+
+  rc = recv(sock, buf, buflen - 1, flags | MSG_PEEK);
+  if( rc < 0 )
+    return -errno;
+  if( rc == 0 )
+    return -EOF;
+  buf[rc] = '\0';
+  if( (nl = strchr(buf, '\n')) == NULL )
+    return -EAGAIN;
+  rc = recv(sock, buf, nl - buf + 1, flags);
+  if( rc < 0 )
+    return -errno;
+  buf[rc] = '\0';
+  return rc;
+}
+
+
 static int clusterd_check_version(int sock, int my_version)
 {
   char* req_buf;
@@ -329,6 +353,77 @@ int ef_pd_alloc_by_name(ef_pd* pd, ef_driver_handle pd_dh,
 }
 
 
+int ef_pd_cluster_resize(ef_pd* pd, int n_channels)
+{
+  char* req_buf;
+  char resp_buf[MSGLEN_MAX + 1];
+  int rc, req_len, reply, result, val;
+
+  if( pd->pd_cluster_sock == -1 )
+    return -EINVAL;
+
+  req_len = asprintf(&req_buf, "%d %s %d\n", CLUSTERD_RESIZE_CLUSTER_REQ,
+                     pd->pd_cluster_name, n_channels);
+  if( req_len < 0 ) {
+    LOG(ef_log("%s: ERROR: asprintf() failed: %d", __FUNCTION__, errno));
+    return -errno;
+  }
+  rc = send(pd->pd_cluster_sock, req_buf, req_len, MSG_NOSIGNAL);
+  free(req_buf);
+  if( rc != req_len ) {
+    LOG(ef_log("%s: ERROR: send() failed: %d", __FUNCTION__, errno));
+    return -errno;
+  }
+
+  /* Skip any notifications queued ahead of our response. */
+  while( 1 ) {
+    rc = clusterd_recv_line(pd->pd_cluster_sock, resp_buf, sizeof(resp_buf), 0);
+    if( rc == -EAGAIN )
+      continue;
+    if( rc < 0 ) {
+      LOG(ef_log("%s: ERROR: clusterd_recv_line() failed: %d",
+                 __FUNCTION__, rc));
+      return rc;
+    }
+    if( sscanf(resp_buf, "%d", &reply) == 1 &&
+        reply != CLUSTERD_CLUSTER_RESIZED )
+      break;
+  }
+
+  if( sscanf(resp_buf, "%d %d %d", &reply, &result, &val) == 3 &&
+      reply == CLUSTERD_RESIZE_CLUSTER_RESP ) {
+    if( result == CLUSTERD_ERR_SUCCESS )
+      return val;
+    LOG(ef_log("%s: ERROR: daemon returned error %d", __FUNCTION__, val));
+    return -val;
+  }
+  LOG(ef_log("%s: ERROR: Unexpected reponse from daemon: %s",
+             __FUNCTION__, resp_buf));
+  return -EIO;
+}
+
+
+int ef_pd_cluster_poll_resize(ef_pd* pd)
+{
+  char buf[MSGLEN_MAX + 1];
+  int rc, reply, n_channels = 0, n;
+
+  if( pd->pd_cluster_sock == -1 )
+    return -EINVAL;
+
+  /* Only the most recent notification matters. */
+  while( (rc = clusterd_recv_line(pd->pd_cluster_sock, buf, sizeof(buf),
+                                  MSG_DONTWAIT)) > 0 )
+    if( sscanf(buf, "%d %d", &reply, &n) == 2 &&
+        reply == CLUSTERD_CLUSTER_RESIZED )
+      n_channels = n;
+
+  if( rc < 0 && rc != -EAGAIN && rc != -EWOULDBLOCK )
+    return rc;
+  return n_channels;
+}
+
+
 int ef_pd_cluster_free(ef_pd* pd, ef_driver_handle pd_dh)
 {
   free(pd->pd_cluster_name);
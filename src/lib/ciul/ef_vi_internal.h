@@ -19,6 +19,7 @@
 #include <etherfabric/ef_vi.h>
 #include <etherfabric/internal/internal.h>
 #include <etherfabric/pd.h>
+#include <etherfabric/ef_vi_arch.h>
 #include "sysdep.h"
 #include "ef_vi_ef10.h"
 #include "ef_vi_ef100.h"
@@ -67,6 +68,16 @@
  * Miscellaneous goodies
  */
 
+/* Exports the fast path call [fn] under the [name] declared in
+ * <etherfabric/ef_vi_arch.h>.  Not needed in the kernel.
+ */
+#ifdef __KERNEL__
+# define EF_VI_ARCH_EXPORT(fn, name)
+#else
+# define EF_VI_ARCH_EXPORT(fn, name)                                    \
+  extern __typeof__(fn) name __attribute__((alias(#fn)));
+#endif
+
 #ifdef NDEBUG
 # define EF_VI_DEBUG(x)
 #else
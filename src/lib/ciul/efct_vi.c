@@ -332,26 +332,20 @@ ci_inline void efct_tx_block(struct efct_tx_state* __restrict__ tx, char* base,
   }
 }
 
-/* complete a tx operation, writing leftover bytes and padding as needed */
-ci_inline void efct_tx_complete(ef_vi* vi, struct efct_tx_state* tx, uint32_t dma_id, int len)
+/* write leftover bytes and padding to finish a packet in the aperture */
+ci_inline void efct_tx_pad(struct efct_tx_state* tx)
 {
-  ef_vi_txq* q = &vi->vi_txq;
-  ef_vi_txq_state* qs = &vi->ep_state->txq;
-  struct efct_tx_descriptor* desc = q->descriptors;
-  int i = qs->added & q->mask;
-
   if( tx->tail_len != 0 ) {
     tx->tail <<= (8 - tx->tail_len) * 8;
     efct_tx_word(tx, CI_BSWAP_BE64(tx->tail));
   }
   while( tx->offset % (EFCT_TX_ALIGNMENT >> 3) != 0 )
     efct_tx_word(tx, 0);
+}
 
-  /* Force the write-combined traffic to be flushed to PCIe, to limit the
-   * maximum possible reordering the NIC will see to one packet. Benchmarks
-   * demonstrate that this sfence is well-parallelised by the CPU, so smarter
-   * algorithms trying to avoid it for small packets are unlikely to be
-   * cost-effective */
+/* flush write-combined aperture writes to PCIe */
+ci_inline void efct_tx_fence(void)
+{
 #if defined __x86_64__ || defined __i386__
   /* Our compat tools define ci_wmb() as just a compiler fence on x86, since
    * that's usually right due to TSO. Not in this case. */
@@ -359,6 +353,15 @@ ci_inline void efct_tx_complete(ef_vi* vi, struct efct_tx_state* tx, uint32_t dm
 #else
   ci_wmb();
 #endif
+}
+
+/* record a packet written to the aperture in the txq state */
+ci_inline void efct_tx_record(ef_vi* vi, uint32_t dma_id, int len)
+{
+  ef_vi_txq* q = &vi->vi_txq;
+  ef_vi_txq_state* qs = &vi->ep_state->txq;
+  struct efct_tx_descriptor* desc = q->descriptors;
+  int i = qs->added & q->mask;
 
   len = CI_ROUND_UP(len + EFCT_TX_HEADER_BYTES, EFCT_TX_ALIGNMENT);
   desc[i].len = len;
@@ -367,6 +370,21 @@ ci_inline void efct_tx_complete(ef_vi* vi, struct efct_tx_state* tx, uint32_t dm
   qs->added += 1;
 }
 
+/* complete a tx operation, writing leftover bytes and padding as needed */
+ci_inline void efct_tx_complete(ef_vi* vi, struct efct_tx_state* tx, uint32_t dma_id, int len)
+{
+  efct_tx_pad(tx);
+
+  /* Force the write-combined traffic to be flushed to PCIe, to limit the
+   * maximum possible reordering the NIC will see to one packet. Benchmarks
+   * demonstrate that this sfence is well-parallelised by the CPU, so smarter
+   * algorithms trying to avoid it for small packets are unlikely to be
+   * cost-effective */
+  efct_tx_fence();
+
+  efct_tx_record(vi, dma_id, len);
+}
+
 /* get a tx completion event, or null if no valid event available */
 ci_qword_t* efct_tx_get_event(const ef_vi* vi, uint32_t evq_ptr)
 {
@@ -498,6 +516,45 @@ void efct_ef_vi_transmit_push(ef_vi* vi)
 {
 }
 
+/* Most aperture bytes a transmit burst writes between fences: the slot
+ * taken by one standard 1514-byte frame and its header.  The NIC already
+ * copes with that much reordering within a single packet, so a run of small
+ * frames that fits can share one sfence. */
+#define EFCT_TX_BURST_FENCE_BYTES  (24 * EFCT_TX_ALIGNMENT)
+
+int efct_ef_vi_transmitv_burst(ef_vi* vi, const ef_iovec* iov,
+                               const ef_request_id* dma_ids, int n)
+{
+  struct efct_tx_state tx;
+  unsigned unfenced = 0, slot;
+  int i, len;
+
+  /* There is no doorbell to share, but the frames go back to back through
+   * the aperture and small ones share a fence. */
+  for( i = 0; i < n; ++i ) {
+    len = iov[i].iov_len;
+    if( ! efct_tx_check(vi, len) )
+      break;
+
+    slot = CI_ROUND_UP(len + EFCT_TX_HEADER_BYTES, EFCT_TX_ALIGNMENT);
+    if( unfenced != 0 && unfenced + slot > EFCT_TX_BURST_FENCE_BYTES ) {
+      efct_tx_fence();
+      unfenced = 0;
+    }
+
+    efct_tx_init(vi, &tx);
+    efct_tx_word(&tx, efct_tx_pkt_header(vi, len, EFCT_TX_CT_DISABLE));
+    efct_tx_block(&tx, (void*)(uintptr_t)iov[i].iov_base, len);
+    efct_tx_pad(&tx);
+    efct_tx_record(vi, dma_ids[i], len);
+    unfenced += slot;
+  }
+
+  if( unfenced != 0 )
+    efct_tx_fence();
+  return i;
+}
+
 static int efct_ef_vi_transmit_pio(ef_vi* vi, int offset, int len,
                                    ef_request_id dma_id)
 {
@@ -682,6 +739,13 @@ static void efct_ef_vi_receive_push(ef_vi* vi)
   /* TODO X3 */
 }
 
+static int efct_ef_vi_receive_post_burst(ef_vi* vi, const ef_addr* addrs,
+                                         const ef_request_id* dma_ids, int n)
+{
+  /* TODO X3 */
+  return -ENOSYS;
+}
+
 static int rx_rollover(ef_vi* vi, int qid)
 {
   uint32_t pkt_id;
@@ -709,6 +773,7 @@ static int rx_rollover(ef_vi* vi, int qid)
     /* nodescdrop on the swrxq. This is the same as the startup case, but it
      * also means that we're going to discard the last packet of the previous
      * superbuf */
+    ++vi->ep_state->rxq.efct_stats[qid].sbseq_gaps;
     efct_vi_rxpkt_release(vi, rxq_ptr->prev);
     rxq_ptr->prev = pkt_id;
     ++next;
@@ -779,13 +844,37 @@ static inline uint16_t header_status_flags(const ci_oword_t *header)
   return flags;
 }
 
-static inline int efct_poll_rx(ef_vi* vi, int qid, ef_event* evs, int evs_len)
+static bool efct_rx_match(const ef_vi* vi, uint32_t pkt_id, unsigned len)
+{
+  const struct efct_vi_rx_match* term = vi->efct_rxqs.rx_match;
+  const char* frame = (const char*)efct_rx_header(vi, pkt_id) +
+                      EFCT_RX_HEADER_NEXT_FRAME_LOC_1;
+  int i;
+
+  for( i = 0; i < vi->efct_rxqs.rx_match_n; ++i, ++term ) {
+    uint64_t v;
+    if( len < term->offset + sizeof(v) )
+      return false;
+    memcpy(&v, frame + term->offset, sizeof(v));
+    if( (v & term->mask) != term->value )
+      return false;
+  }
+  return true;
+}
+
+/* If [apply_match] is set then packets which don't pass the software match
+ * are released here, and consume the poll budget without producing an
+ * event. */
+static inline int efct_poll_rx(ef_vi* vi, int qid, ef_event* evs, int evs_len,
+                               bool apply_match)
 {
   ef_vi_rxq_state* qs = &vi->ep_state->rxq;
   ef_vi_efct_rxq_ptr* rxq_ptr = &qs->rxq_ptr[qid];
   ef_vi_efct_rxq* rxq = &vi->efct_rxqs.q[qid];
   int i;
 
+  apply_match = apply_match && vi->efct_rxqs.rx_match_n != 0;
+
   if( efct_rxq_need_rollover(rxq_ptr) )
     if( rx_rollover(vi, qid) < 0 )
       /* ef_eventq_poll() has historically never been able to fail, so we
@@ -816,16 +905,29 @@ static inline int efct_poll_rx(ef_vi* vi, int qid, ef_event* evs, int evs_len)
   evs_len = CI_MIN(evs_len, (int)(rxq_ptr->end -
                                   rxq_ptr_to_pkt_id(rxq_ptr->next)));
 
-  for( i = 0; i < evs_len; ++i ) {
+  for( i = 0; i < evs_len; ) {
     const ci_oword_t* header;
     struct efct_rx_descriptor* desc;
     uint32_t pkt_id;
     uint16_t discard_flags = 0;
+    bool filtered = false;
 
     header = efct_rx_next_header(vi, rxq_ptr->next);
     if( header == NULL )
       break;
 
+    if( vi->efct_rxqs.rx_prefetch ) {
+      /* Fetch the metadata and packet headers some way ahead, so that they
+       * have arrived by the time that we get to them */
+      uint32_t ahead = rxq_ptr_to_pkt_id(rxq_ptr->next) +
+                       vi->efct_rxqs.rx_prefetch;
+      if( ahead < rxq_ptr->end ) {
+        const char* p = (const char*)efct_rx_header(vi, ahead);
+        ci_prefetch(p);
+        ci_prefetch(p + EFCT_RX_HEADER_NEXT_FRAME_LOC_1);
+      }
+    }
+
     pkt_id = rxq_ptr->prev;
     desc = efct_rx_desc(vi, pkt_id);
 
@@ -863,7 +965,16 @@ static inline int efct_poll_rx(ef_vi* vi, int qid, ef_event* evs, int evs_len)
         break;
       }
 
-      efct_rx_discard(rxq->qid, pkt_id, discard_flags, header, &evs[i]);
+      efct_rx_discard(rxq->qid, pkt_id, discard_flags, header, &evs[i++]);
+    }
+    else if( apply_match &&
+             ! efct_rx_match(vi, pkt_id,
+                             CI_OWORD_FIELD(*header,
+                                            EFCT_RX_HEADER_PACKET_LENGTH)) ) {
+      /* The budget was limited to the packets left in this superbuf, so
+       * spend it even though there's no event */
+      filtered = true;
+      --evs_len;
     }
     else {
       /* For simplicity, require configuration for a fixed data offset.
@@ -882,6 +993,7 @@ static inline int efct_poll_rx(ef_vi* vi, int qid, ef_event* evs, int evs_len)
       evs[i].rx_ref.q_id = rxq->qid;
       evs[i].rx_ref.filter_id = CI_OWORD_FIELD(*header, EFCT_RX_HEADER_FILTER);
       evs[i].rx_ref.user = CI_OWORD_FIELD(*header, EFCT_RX_HEADER_USER);
+      ++i;
     }
 
     /* This is only necessary for the final packet of each superbuf, storing
@@ -892,6 +1004,11 @@ static inline int efct_poll_rx(ef_vi* vi, int qid, ef_event* evs, int evs_len)
                                            EFCT_RX_HEADER_TIMESTAMP_STATUS);
 
     rxq_ptr->prev = rxq_ptr_to_pkt_id(rxq_ptr->next++);
+
+    if( filtered ) {
+      ++qs->efct_stats[qid].sw_filtered;
+      efct_vi_rxpkt_release(vi, pkt_id);
+    }
   }
 
   return i;
@@ -993,14 +1110,26 @@ int efct_poll_tx(ef_vi* vi, ef_event* evs, int evs_len)
 static int efct_ef_eventq_poll(ef_vi* vi, ef_event* evs, int evs_len)
 {
   int n = 0;
-  uint64_t qs = *vi->efct_rxqs.active_qs;
+  uint64_t all_qs = *vi->efct_rxqs.active_qs;
+  /* Start from the queue after the one that last filled evs, so that a
+   * busy queue can't take all the space in every poll and starve those
+   * after it when many are attached. */
+  uint64_t qs = all_qs & (~0ull << vi->efct_rxqs.poll_next);
+  uint64_t wrapped_qs = all_qs & ~qs;
   for ( ; ; ) {
-    int i = __builtin_ffsll(qs);
-    if (i == 0)
-      break;
-    --i;
-    qs &= ~(1ull << i);
-    n += efct_poll_rx(vi, i, evs + n, evs_len - n);
+    int i, had_space;
+    if( qs == 0 ) {
+      if( wrapped_qs == 0 )
+        break;
+      qs = wrapped_qs;
+      wrapped_qs = 0;
+    }
+    i = __builtin_ctzll(qs);
+    qs &= qs - 1;
+    had_space = n < evs_len;
+    n += efct_poll_rx(vi, i, evs + n, evs_len - n, true);
+    if( had_space && n == evs_len )
+      vi->efct_rxqs.poll_next = (i + 1) % EF_VI_MAX_EFCT_RXQS;
   }
   if( vi->vi_txq.mask )
     n += efct_poll_tx(vi, evs + n, evs_len - n);
@@ -1157,6 +1286,51 @@ void efct_vi_rxpkt_release(ef_vi* vi, uint32_t pkt_id)
                             pkt_id_to_local_superbuf_ix(pkt_id));
 }
 
+int efct_vi_rx_set_match(ef_vi* vi, const struct efct_vi_rx_match* terms,
+                         int n_terms)
+{
+  int i;
+
+  EF_VI_ASSERT(vi->nic_type.arch == EF_VI_ARCH_EFCT);
+
+  if( terms == NULL )
+    n_terms = 0;
+  if( n_terms < 0 || n_terms > EFCT_VI_RX_MATCH_MAX_TERMS )
+    return -EINVAL;
+  for( i = 0; i < n_terms; ++i )
+    if( terms[i].offset > EFCT_VI_RX_MATCH_MAX_OFFSET ||
+        (terms[i].value & ~terms[i].mask) != 0 )
+      return -EINVAL;
+
+  vi->efct_rxqs.rx_match = terms;
+  vi->efct_rxqs.rx_match_n = n_terms;
+  return 0;
+}
+
+int efct_vi_rxq_get_stats(ef_vi* vi, int ix, struct efct_vi_rxq_stats* stats)
+{
+  const struct efab_efct_rxq_uk_shm_base* shm = vi->efct_rxqs.shm;
+
+  EF_VI_ASSERT(vi->nic_type.arch == EF_VI_ARCH_EFCT);
+
+  if( ix < 0 || ix >= EF_VI_MAX_EFCT_RXQS )
+    return -EINVAL;
+
+  memset(stats, 0, sizeof(*stats));
+  if( shm != NULL && (uint64_t)ix < vi->efct_rxqs.max_qs ) {
+    const struct efab_efct_rxq_uk_shm_q* q = &shm->q[ix];
+    stats->lag_superbufs = OO_ACCESS_ONCE(q->rxq.added) -
+                           OO_ACCESS_ONCE(q->rxq.removed);
+    stats->skipped_superbufs = OO_ACCESS_ONCE(q->stats.skipped_bufs);
+    stats->no_rxq_space = OO_ACCESS_ONCE(q->stats.no_rxq_space);
+    stats->too_many_owned = OO_ACCESS_ONCE(q->stats.too_many_owned);
+    stats->no_bufs = OO_ACCESS_ONCE(q->stats.no_bufs);
+  }
+  stats->sbseq_gaps = vi->ep_state->rxq.efct_stats[ix].sbseq_gaps;
+  stats->sw_filtered = vi->ep_state->rxq.efct_stats[ix].sw_filtered;
+  return 0;
+}
+
 const void* efct_vi_rx_future_peek(ef_vi* vi)
 {
   uint64_t qs = *vi->efct_rxqs.active_qs;
@@ -1185,13 +1359,56 @@ const void* efct_vi_rx_future_peek(ef_vi* vi)
   return NULL;
 }
 
+int efct_vi_rx_peek(ef_vi* vi, struct efct_vi_rx_peek_pkt* pkts, int max)
+{
+  uint64_t qs = *vi->efct_rxqs.active_qs;
+  int n = 0;
+
+  for( ; qs && n < max; qs &= (qs - 1) ) {
+    unsigned qid = __builtin_ctzll(qs);
+    const ef_vi_efct_rxq_ptr* rxq_ptr = &vi->ep_state->rxq.rxq_ptr[qid];
+    uint32_t pkt_id, next;
+
+    /* As in efct_vi_rx_future_peek, leave queues needing work to poll */
+    if( efct_rxq_need_rollover(rxq_ptr)  ||
+        efct_rxq_need_config(&vi->efct_rxqs.q[qid]) )
+      continue;
+
+    /* The same walk as efct_poll_rx, without consuming anything */
+    pkt_id = rxq_ptr->prev;
+    for( next = rxq_ptr->next;
+         n < max && rxq_ptr_to_pkt_id(next) < rxq_ptr->end;
+         pkt_id = rxq_ptr_to_pkt_id(next++) ) {
+      const ci_oword_t* header = efct_rx_next_header(vi, next);
+      uint16_t flags = 0;
+      unsigned len;
+
+      if( header == NULL || CI_OWORD_FIELD(*header, EFCT_RX_HEADER_ROLLOVER) )
+        break;
+      len = CI_OWORD_FIELD(*header, EFCT_RX_HEADER_PACKET_LENGTH);
+      if(unlikely( header->u64[0] & CHECK_FIELDS ))
+        flags = header_status_flags(header) & vi->rx_discard_mask;
+      if( flags == 0 && vi->efct_rxqs.rx_match_n != 0 &&
+          ! efct_rx_match(vi, pkt_id, len) )
+        continue;
+
+      pkts[n].data = (const char*)efct_rx_header(vi, pkt_id) +
+                     EFCT_RX_HEADER_NEXT_FRAME_LOC_1;
+      pkts[n].len = len;
+      pkts[n].discard_flags = flags;
+      ++n;
+    }
+  }
+  return n;
+}
+
 int efct_vi_rx_future_poll(ef_vi* vi, ef_event* evs, int evs_len)
 {
   int count;
 
   EF_VI_ASSERT(((ci_int8) vi->future_qid) >= 0);
   EF_VI_ASSERT(efct_rxq_is_active(&vi->efct_rxqs.q[vi->future_qid]));
-  count = efct_poll_rx(vi, vi->future_qid, evs, evs_len);
+  count = efct_poll_rx(vi, vi->future_qid, evs, evs_len, false);
 #ifndef NDEBUG
   if( count )
     vi->future_qid = -1;
@@ -1295,6 +1512,12 @@ void efct_vi_stop_transmit_warm(ef_vi* vi)
   vi->vi_txq.efct_fixed_header = qword.u64[0];
 }
 
+EF_VI_ARCH_EXPORT(efct_ef_vi_transmit, ef_vi_efct_transmit)
+EF_VI_ARCH_EXPORT(efct_ef_vi_transmitv, ef_vi_efct_transmitv)
+EF_VI_ARCH_EXPORT(efct_ef_vi_transmit_push, ef_vi_efct_transmit_push)
+EF_VI_ARCH_EXPORT(efct_ef_eventq_poll, ef_vi_efct_eventq_poll)
+
+
 static void efct_vi_initialise_ops(ef_vi* vi)
 {
   vi->ops.transmit               = efct_ef_vi_transmit;
@@ -1325,11 +1548,23 @@ static void efct_vi_initialise_ops(ef_vi* vi)
   vi->ops.transmit_memcpy_sync   = efct_ef_vi_transmit_memcpy_sync;
   vi->ops.transmit_ctpio_fallback = efct_ef_vi_transmit_ctpio_fallback;
   vi->ops.transmitv_ctpio_fallback = efct_ef_vi_transmitv_ctpio_fallback;
+  vi->ops.receive_post_burst = efct_ef_vi_receive_post_burst;
+  vi->ops.transmitv_burst = efct_ef_vi_transmitv_burst;
   vi->internal_ops.design_parameters = efct_design_parameters;
   vi->internal_ops.post_filter_add = efct_post_filter_add;
   vi->ops.eventq_poll = efct_ef_eventq_poll;
 }
 
+static int efct_vi_rx_prefetch_default(void)
+{
+#ifndef __KERNEL__
+  const char* s = getenv("EF_VI_EFCT_RX_PREFETCH");
+  if( s != NULL )
+    return CI_MIN(CI_MAX(atoi(s), 0), EFCT_VI_RX_PREFETCH_MAX);
+#endif
+  return 0;
+}
+
 void efct_vi_init(ef_vi* vi)
 {
   int i;
@@ -1357,4 +1592,6 @@ void efct_vi_init(ef_vi* vi)
   vi->efct_rxqs.active_qs = &vi->efct_rxqs.max_qs;
   for( i = 0; i < EF_VI_MAX_EFCT_RXQS; ++i )
     vi->efct_rxqs.q[i].live.superbuf_pkts = &vi->efct_rxqs.q[i].config_generation;
+
+  vi->efct_rxqs.rx_prefetch = efct_vi_rx_prefetch_default();
 }
@@ -20,4 +20,7 @@ int efct_ef_vi_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
 
 void efct_ef_vi_transmit_push(ef_vi* vi);
 
+int efct_ef_vi_transmitv_burst(ef_vi* vi, const ef_iovec* iov,
+                               const ef_request_id* dma_ids, int n);
+
 #endif  /* __CIUL_EFCT_VI_H__ */
@@ -20,7 +20,34 @@
 #include "af_xdp_defs.h"
 #include "logging.h"
 
-/* Currently, AF_XDP requires a system call to start transmitting.
+/* Access the AF_XDP rings, using the offsets provided in the mapped memory.
+ * The (fake) event queue pointer must be initialised to point to the start
+ * of this memory in order to access the offsets.
+ */
+static struct efab_af_xdp_offsets* xdp_offsets(ef_vi* vi)
+{
+  return (struct efab_af_xdp_offsets*)vi->evq_base;
+}
+
+#define RING_THING(vi, ring, thing) \
+  ((void*)(vi->evq_base + xdp_offsets(vi)->rings.ring.thing))
+
+#define RING_PRODUCER(vi, ring) \
+  ((volatile uint32_t*)RING_THING(vi, ring, producer))
+
+#define RING_CONSUMER(vi, ring) \
+  ((volatile uint32_t*)RING_THING(vi, ring, consumer))
+
+#define RING_DESC(vi, ring) RING_THING(vi, ring, desc)
+
+/* With need_wakeup, the kernel tells us whether it will notice new
+ * descriptors by itself, or needs a system call to get going again.
+ * Without it, we must always assume the latter. */
+#define RING_NEEDS_WAKEUP(vi, ring) \
+  (xdp_offsets(vi)->rings.ring.flags < 0 || \
+   (*(volatile uint32_t*)RING_THING(vi, ring, flags) & XDP_RING_NEED_WAKEUP))
+
+/* AF_XDP may require a system call to start transmitting.
  *
  * There is a limit (undocumented, so we can't rely on it being 16) to the
  * number of packets which will be sent each time. We use the "previous"
@@ -36,50 +63,59 @@ static int efxdp_tx_need_kick(ef_vi* vi)
 
 static void efxdp_tx_kick(ef_vi* vi)
 {
-  if( vi->xdp_kick(vi) == 0 ) {
-    ef_vi_txq_state* qs = &vi->ep_state->txq;
+  ef_vi_txq_state* qs = &vi->ep_state->txq;
+
+  /* Order the producer update before reading the flags, so that we can't
+   * miss the kernel going to sleep */
+  ci_mb();
+  if( ! RING_NEEDS_WAKEUP(vi, tx) ) {
+    ++qs->xdp_kicks_avoided;
     qs->previous = qs->added;
+    return;
   }
+
+  ++qs->xdp_kicks;
+  if( vi->xdp_kick(vi) == 0 )
+    qs->previous = qs->added;
 }
 
-/* Access the AF_XDP rings, using the offsets provided in the mapped memory.
- * The (fake) event queue pointer must be initialised to point to the start
- * of this memory in order to access the offsets.
- */
-static struct efab_af_xdp_offsets* xdp_offsets(ef_vi* vi)
+/* Kick the kernel if it stopped receiving because the fill ring was empty */
+static void efxdp_fill_kick(ef_vi* vi)
 {
-  return (struct efab_af_xdp_offsets*)vi->evq_base;
+  ci_mb();
+  if( xdp_offsets(vi)->rings.fr.flags >= 0 && RING_NEEDS_WAKEUP(vi, fr) ) {
+    ++vi->ep_state->rxq.xdp_fill_kicks;
+    vi->xdp_kick(vi);
+  }
 }
 
-#define RING_THING(vi, ring, thing) \
-  ((void*)(vi->evq_base + xdp_offsets(vi)->rings.ring.thing))
-
-#define RING_PRODUCER(vi, ring) \
-  ((volatile uint32_t*)RING_THING(vi, ring, producer))
-
-#define RING_CONSUMER(vi, ring) \
-  ((volatile uint32_t*)RING_THING(vi, ring, consumer))
-
-#define RING_DESC(vi, ring) RING_THING(vi, ring, desc)
-
 static int efxdp_ef_vi_transmitv_init(ef_vi* vi, const ef_iovec* iov,
                                       int iov_len, ef_request_id dma_id)
 {
   ef_vi_txq* q = &vi->vi_txq;
   ef_vi_txq_state* qs = &vi->ep_state->txq;
   struct xdp_desc* dq = RING_DESC(vi, tx);
-  int i;
+  int i = 0, n;
 
-  if( iov_len != 1 )
-    return -EINVAL; /* Multiple buffers per packet not supported */
+  /* Multiple buffers per packet need the kernel to support multi-buffer
+   * frames. */
+  if( iov_len < 1 ||
+      (iov_len > 1 &&
+       ! (xdp_offsets(vi)->features & EFAB_AF_XDP_FEATURE_SG)) )
+    return -EINVAL;
 
-  if( qs->added - qs->removed >= q->mask )
+  if( qs->added - qs->removed + iov_len > q->mask )
     return -EAGAIN;
 
-  i = qs->added++ & q->mask;
-  dq[i].addr = iov->iov_base;
-  dq[i].len = iov->iov_len;
-  EF_VI_BUG_ON(q->ids[i] != EF_REQUEST_ID_MASK);
+  for( n = 0; n < iov_len; ++n ) {
+    i = qs->added++ & q->mask;
+    dq[i].addr = iov[n].iov_base;
+    dq[i].len = iov[n].iov_len;
+    dq[i].options = n + 1 < iov_len ? XDP_PKT_CONTD : 0;
+    EF_VI_BUG_ON(q->ids[i] != EF_REQUEST_ID_MASK);
+  }
+  /* As for other architectures, only the last descriptor of a packet
+   * carries its id */
   q->ids[i] = dma_id;
   return 0;
 }
@@ -87,18 +123,22 @@ static int efxdp_ef_vi_transmitv_init(ef_vi* vi, const ef_iovec* iov,
 static void efxdp_ef_vi_transmit_push(ef_vi* vi)
 {
   *RING_PRODUCER(vi, tx) = vi->ep_state->txq.added;
-  /* Kicking TX is very expensinve, hence the need to moderate it.
+  /* Kicking TX is very expensive, hence the need to moderate it.
    *  Two cases are allowed:
    *  * if there is nothing or almost nothing in the TX queue
    *    - as we cannot rely on interrupt to pick TX up
    *    - we kick after 1st and 2nd packet to make sure latency is low
    *      for typical ping-pong usecases even if interrupts are moderated.
-   *  * at least every packets if queue is quarter stuffed.
+   *  * once a full batch has built up since the last kick, as that is as
+   *    much as the kernel will send for one kick anyway.
+   *  Anything left over is kicked when the event queue is next polled.
+   *  If the kernel is already busy transmitting, efxdp_tx_kick() skips the
+   *  system call.
    */
   EF_VI_BUG_ON(vi->ep_state->txq.added == vi->ep_state->txq.previous);
   if( vi->ep_state->txq.added - vi->ep_state->txq.removed < 3 ||
-      (vi->ep_state->txq.added ^ vi->ep_state->txq.previous) /
-      (AF_XDP_TX_BATCH_MAX >> 2) )
+      vi->ep_state->txq.added - vi->ep_state->txq.previous >=
+      AF_XDP_TX_BATCH_MAX )
     efxdp_tx_kick(vi);
 }
 
@@ -125,6 +165,32 @@ static int efxdp_ef_vi_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
   return rc;
 }
 
+static int efxdp_ef_vi_transmitv_burst(ef_vi* vi, const ef_iovec* iov,
+                                       const ef_request_id* dma_ids, int n)
+{
+  ef_vi_txq* q = &vi->vi_txq;
+  ef_vi_txq_state* qs = &vi->ep_state->txq;
+  struct xdp_desc* dq = RING_DESC(vi, tx);
+  int i, space = q->mask - (qs->added - qs->removed);
+
+  if( n > space )
+    n = space;
+  if( n <= 0 )
+    return 0;
+
+  for( i = 0; i < n; ++i ) {
+    unsigned di = qs->added++ & q->mask;
+    dq[di].addr = iov[i].iov_base;
+    dq[di].len = iov[i].iov_len;
+    dq[di].options = 0;
+    EF_VI_BUG_ON(q->ids[di] != EF_REQUEST_ID_MASK);
+    q->ids[di] = dma_ids[i];
+  }
+  wmb();
+  efxdp_ef_vi_transmit_push(vi);
+  return n;
+}
+
 static int efxdp_ef_vi_transmit_pio(ef_vi* vi, int offset, int len,
                                     ef_request_id dma_id)
 {
@@ -261,6 +327,25 @@ static void efxdp_ef_vi_receive_push(ef_vi* vi)
 {
   wmb();
   *RING_PRODUCER(vi, fr) = vi->ep_state->rxq.added;
+  efxdp_fill_kick(vi);
+}
+
+/* Note: for AF_XDP devices dma_ids are disregarded */
+static int efxdp_ef_vi_receive_post_burst(ef_vi* vi, const ef_addr* addrs,
+                                          const ef_request_id* dma_ids, int n)
+{
+  ef_vi_rxq* q = &vi->vi_rxq;
+  ef_vi_rxq_state* qs = &vi->ep_state->rxq;
+  uint64_t* dq = RING_DESC(vi, fr);
+  int i, space = q->mask - (qs->added - qs->removed);
+
+  if( n > space )
+    n = space;
+
+  for( i = 0; i < n; ++i )
+    dq[qs->added++ & q->mask] = addrs[i];
+  efxdp_ef_vi_receive_push(vi);
+  return n;
 }
 
 static void efxdp_ef_eventq_prime(ef_vi* vi)
@@ -301,6 +386,7 @@ static int efxdp_ef_eventq_poll(ef_vi* vi, ef_event* evs, int evs_len)
 
         evs[n].rx.type = EF_EVENT_TYPE_RX;
         evs[n].rx.q_id = 0;
+        evs[n].rx.flags = 0;
 
         /* AF_XDP devices do not use dma_ids as
          * FIFO behaviour of rx ring is not guaranteed (Zerocopy).
@@ -313,12 +399,22 @@ static int efxdp_ef_eventq_poll(ef_vi* vi, ef_event* evs, int evs_len)
 
         q->ids[desc_i] = EF_REQUEST_ID_MASK;  /* Debug only? */
 
-        /* FIXME: handle jumbo, multicast */
-        evs[n].rx.flags = EF_EVENT_FLAG_SOP;
+        /* Frames spanning several buffers are reported as for ef10
+         * jumbos: SOP on the first, CONT on all but the last, and the
+         * length accumulated so far on each.
+         * FIXME: handle multicast */
+        if( ! qs->in_jumbo ) {
+          evs[n].rx.flags = EF_EVENT_FLAG_SOP;
+          qs->bytes_acc = 0;
+        }
+        qs->bytes_acc += dq[desc_i].len;
+        qs->in_jumbo = !! (dq[desc_i].options & XDP_PKT_CONTD);
+        if( qs->in_jumbo )
+          evs[n].rx.flags |= EF_EVENT_FLAG_CONT;
         /* In case of AF_XDP offset of the placement of payload from
          * the beginning of the packet buffer may vary. */
-        evs[n].rx.ofs = dq[desc_i].addr & (vi->rx_buffer_len - 1); 
-        evs[n].rx.len = dq[desc_i].len;
+        evs[n].rx.ofs = dq[desc_i].addr & (vi->rx_buffer_len - 1);
+        evs[n].rx.len = qs->bytes_acc;
 
         ++n;
         ++cons;
@@ -413,6 +509,8 @@ void efxdp_vi_init(ef_vi* vi)
   vi->ops.eventq_timer_zero      = efxdp_ef_eventq_timer_zero;
   vi->ops.transmit_memcpy        = efxdp_ef_vi_transmit_memcpy;
   vi->ops.transmit_memcpy_sync   = efxdp_ef_vi_transmit_memcpy_sync;
+  vi->ops.receive_post_burst     = efxdp_ef_vi_receive_post_burst;
+  vi->ops.transmitv_burst        = efxdp_ef_vi_transmitv_burst;
   if( vi->vi_flags & EF_VI_TX_CTPIO ) {
     vi->ops.transmit_ctpio_fallback = efxdp_ef_vi_transmit_ctpio_fallback;
     vi->ops.transmitv_ctpio_fallback = efxdp_ef_vi_transmitv_ctpio_fallback;
@@ -71,11 +71,13 @@ int ef_memreg_alloc(ef_memreg* mr, ef_driver_handle mr_dh,
   /* In openonload-201509-u2 and earlier the driver has an overflow bug so
    * that registering >= 4GiB goes wrong.  We work around this bug here,
    * with some care to ensure we register chunks that are nicely aligned to
-   * take advantage of large NIC page sizes.
+   * take advantage of large NIC page sizes.  Align to 1GiB so that a chunk
+   * boundary never splits a 1GiB hugepage, which would force the driver to
+   * map that part of the region with smaller pages.
    */
   char* chunk_start = p_mem_sys_base;
   char* chunk_end = p_mem_sys_end;
-  size_t align = 1 << 22;
+  size_t align = (size_t) 1 << 30;
   size_t max_chunk = ((uint64_t) 1u << 32) - align;
   if( chunk_end - chunk_start >= ((uint64_t) 1u << 32) ) {
     chunk_end = chunk_start + max_chunk;
@@ -107,6 +109,52 @@ int ef_memreg_alloc(ef_memreg* mr, ef_driver_handle mr_dh,
 }
 
 
+int ef_memreg_alloc_dmabuf(ef_memreg* mr, ef_driver_handle mr_dh,
+                           ef_pd* pd, ef_driver_handle pd_dh,
+                           int dmabuf_fd, uint64_t offset, size_t len_bytes)
+{
+  ci_resource_alloc_t ra;
+  size_t n_nic_pages;
+  int rc;
+
+  if( (offset & (EFHW_NIC_PAGE_SIZE - 1)) != 0 || len_bytes == 0 )
+    return -EINVAL;
+
+  n_nic_pages = CI_ALIGN_FWD(len_bytes, EFHW_NIC_PAGE_SIZE)
+                >> EFHW_NIC_PAGE_SHIFT;
+  mr->mr_dma_addrs_base = malloc(n_nic_pages * sizeof(mr->mr_dma_addrs[0]));
+  if( mr->mr_dma_addrs_base == NULL )
+    return -ENOMEM;
+
+  /* For a pd in a cluster, use the handle from clusterd */
+  if( pd->pd_cluster_sock != -1 )
+    pd_dh = pd->pd_cluster_dh;
+
+  memset(&ra, 0, sizeof(ra));
+  ef_vi_set_intf_ver(ra.intf_ver, sizeof(ra.intf_ver));
+  ra.ra_type = EFRM_RESOURCE_MEMREG;
+  ra.u.memreg.in_vi_or_pd_id = efch_make_resource_id(pd->pd_resource_id);
+  ra.u.memreg.in_vi_or_pd_fd = pd_dh;
+  ra.u.memreg.in_flags = EFCH_MEMREG_FLAG_DMABUF;
+  ra.u.memreg.in_dmabuf_fd = dmabuf_fd;
+  ra.u.memreg.in_mem_ptr = offset;
+  ra.u.memreg.in_mem_bytes = len_bytes;
+  ra.u.memreg.in_addrs_out_ptr = (uintptr_t) mr->mr_dma_addrs_base;
+  ra.u.memreg.in_addrs_out_stride = sizeof(mr->mr_dma_addrs[0]);
+
+  rc = ci_resource_alloc(mr_dh, &ra);
+  if( rc < 0 ) {
+    LOGVV(ef_log("ef_memreg_alloc_dmabuf(fd=%d, offset=%"PRIx64", len=%zu): "
+                 "ERROR: rc=%d", dmabuf_fd, offset, len_bytes, rc));
+    free(mr->mr_dma_addrs_base);
+    return rc;
+  }
+
+  mr->mr_dma_addrs = mr->mr_dma_addrs_base;
+  return 0;
+}
+
+
 int ef_memreg_free(ef_memreg* mr, ef_driver_handle mr_dh)
 {
   free(mr->mr_dma_addrs_base);
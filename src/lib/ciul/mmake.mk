@@ -47,7 +47,10 @@ LIB_SRCS	+=		\
 		vi_prime.c	\
 		capabilities.c	\
 		smartnic_exts.c	\
-		ctpio.c
+		ctpio.c		\
+		shm_ring.c	\
+		tx_pacer.c	\
+		pkt_pool.c
 
 # librt is needed on old glibc, e.g. on RHEL 6
 MMAKE_DIR_LINKFLAGS	:= $(MMAKE_DIR_LINKFLAGS) -lrt
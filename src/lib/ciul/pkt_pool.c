@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* Pool of packet buffers in registered memory, with RX ring refill. */
+
+#include <etherfabric/pkt_pool.h>
+#include <errno.h>
+
+
+int ef_pkt_pool_init(ef_pkt_pool* pool, ef_memreg* mr, void* mr_base,
+                     size_t mr_offset, unsigned buf_size, unsigned n_bufs,
+                     uint32_t* free)
+{
+  unsigned i;
+
+  if( buf_size < EF_VI_DMA_ALIGN || buf_size > EF_VI_NIC_PAGE_SIZE ||
+      (buf_size & (buf_size - 1)) != 0 || (mr_offset & (buf_size - 1)) != 0 )
+    return -EINVAL;
+
+  pool->base = (char*) mr_base + mr_offset;
+  pool->mr = mr;
+  pool->mr_offset = mr_offset;
+  pool->buf_size = buf_size;
+  pool->n_bufs = n_bufs;
+  pool->free = free;
+  /* Lowest ids on top, so buffers are first handed out in address order */
+  for( i = 0; i < n_bufs; ++i )
+    free[i] = n_bufs - 1 - i;
+  pool->n_free = n_bufs;
+  return 0;
+}
+
+
+int ef_pkt_pool_refill_rx(ef_pkt_pool* pool, ef_vi* vi,
+                          unsigned dma_offset, int fill_level)
+{
+  ef_addr addrs[EF_PKT_POOL_REFILL_BATCH];
+  ef_request_id ids[EF_PKT_POOL_REFILL_BATCH];
+  int i, rc, n_ok, n_posted = 0;
+
+  while( ef_vi_receive_fill_level(vi) + EF_PKT_POOL_REFILL_BATCH <=
+           fill_level &&
+         pool->n_free >= EF_PKT_POOL_REFILL_BATCH ) {
+    for( i = 0; i < EF_PKT_POOL_REFILL_BATCH; ++i ) {
+      ids[i] = ef_pkt_pool_get(pool);
+      addrs[i] = ef_pkt_pool_dma_addr(pool, ids[i]) + dma_offset;
+    }
+    rc = ef_vi_receive_post_burst(vi, addrs, ids, EF_PKT_POOL_REFILL_BATCH);
+    /* Put back whatever did not fit, in reverse so the stack is as before */
+    n_ok = rc < 0 ? 0 : rc;
+    for( i = EF_PKT_POOL_REFILL_BATCH - 1; i >= n_ok; --i )
+      ef_pkt_pool_put(pool, ids[i]);
+    if( rc < 0 )
+      return n_posted ? n_posted : rc;
+    n_posted += rc;
+    if( rc < EF_PKT_POOL_REFILL_BATCH )
+      break;
+  }
+  return n_posted;
+}
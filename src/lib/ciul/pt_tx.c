@@ -64,6 +64,30 @@ int ef_vi_transmit_unbundle(ef_vi* vi, const ef_event* ev,
 }
 
 
+int ef_vi_transmit_complete(ef_vi* vi, const ef_event* ev)
+{
+  ef_vi_txq* q = &vi->vi_txq;
+  ef_vi_txq_state* qs = &vi->ep_state->txq;
+  unsigned i, stop = ev->tx.desc_id & q->mask;
+  int n = 0;
+
+  EF_VI_BUG_ON(EF_EVENT_TYPE(*ev) != EF_EVENT_TYPE_TX &&
+               EF_EVENT_TYPE(*ev) != EF_EVENT_TYPE_TX_ERROR);
+  /* Should not complete more than we've posted. */
+  EF_VI_BUG_ON(((ev->tx.desc_id - qs->removed) & q->mask) >
+               qs->added - qs->removed);
+
+  /* As ef_vi_transmit_unbundle(), but with no limit on how many
+   * descriptors one call completes. */
+  for( i = qs->removed & q->mask; i != stop; i = ++qs->removed & q->mask )
+    if( q->ids[i] != EF_REQUEST_ID_MASK ) {
+      q->ids[i] = EF_REQUEST_ID_MASK;
+      ++n;
+    }
+  return n;
+}
+
+
 int ef_pio_memcpy(ef_vi* vi, const void* base, int offset, int len)
 {
   /* PIO region on NIC is write only, and to avoid silicon bugs must
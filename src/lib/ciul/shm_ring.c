@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* Shared memory packet ring: setup.  The data path is inline in
+ * etherfabric/shm_ring.h.
+ */
+
+#include <etherfabric/shm_ring.h>
+#include <string.h>
+
+
+#define SHM_RING_ROUND_UP(x)                                    \
+  (((x) + EF_SHM_RING_ALIGN - 1) & ~((size_t) EF_SHM_RING_ALIGN - 1))
+
+static int is_pow2(unsigned x)
+{
+  return x != 0 && (x & (x - 1)) == 0;
+}
+
+
+static int shm_ring_params_ok(unsigned n_bufs, unsigned buf_size)
+{
+  return is_pow2(n_bufs) && is_pow2(buf_size) &&
+    buf_size >= sizeof(ef_shm_ring_buf);
+}
+
+
+size_t ef_shm_ring_bytes(unsigned n_bufs, unsigned buf_size)
+{
+  return SHM_RING_ROUND_UP(sizeof(ef_shm_ring)) +
+    SHM_RING_ROUND_UP((size_t) n_bufs * buf_size);
+}
+
+
+int ef_shm_ring_init(void* mem, size_t mem_bytes, unsigned n_bufs,
+                     unsigned buf_size)
+{
+  ef_shm_ring* ring = mem;
+  uint64_t seq;
+
+  if( ((uintptr_t) mem & (EF_SHM_RING_ALIGN - 1)) != 0 ||
+      ! shm_ring_params_ok(n_bufs, buf_size) ||
+      mem_bytes < ef_shm_ring_bytes(n_bufs, buf_size) )
+    return -EINVAL;
+
+  /* Zero only the buffer headers: the rest may be large, and is written
+   * by the NIC before anyone reads it. */
+  memset(ring, 0, sizeof(*ring));
+  ring->n_bufs = n_bufs;
+  ring->buf_size = buf_size;
+  ring->buf_offset = SHM_RING_ROUND_UP(sizeof(ef_shm_ring));
+  for( seq = 0; seq < n_bufs; ++seq )
+    memset(ef_shm_ring_buf_at(ring, seq), 0, sizeof(ef_shm_ring_buf));
+  /* Readers check the magic before trusting anything else */
+  __atomic_store_n(&ring->magic, EF_SHM_RING_MAGIC, __ATOMIC_RELEASE);
+  return 0;
+}
+
+
+int ef_shm_ring_attach(ef_shm_ring** ring_out, void* mem, size_t mem_bytes)
+{
+  ef_shm_ring* ring = mem;
+
+  if( mem_bytes < sizeof(*ring) ||
+      __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != EF_SHM_RING_MAGIC ||
+      ! shm_ring_params_ok(ring->n_bufs, ring->buf_size) ||
+      ring->buf_offset != SHM_RING_ROUND_UP(sizeof(ef_shm_ring)) ||
+      mem_bytes < ef_shm_ring_bytes(ring->n_bufs, ring->buf_size) )
+    return -EINVAL;
+
+  *ring_out = ring;
+  return 0;
+}
@@ -80,4 +80,39 @@ int ef_extension_send_message(ef_extension* ext, uint32_t message,
   return ci_resource_op(ext->dh, &op);
 }
 
+
+int ef_extension_send_messages(ef_extension* ext, struct ef_extension_msg* msgs,
+                               int n_msgs, unsigned flags)
+{
+  struct efch_ext_msg batch[EFCH_EXT_MSG_BATCH_MAX];
+  ci_resource_op_t op;
+  int i, n, done, rc;
+
+  if( flags )
+    return -EINVAL;
+
+  for( done = 0; done < n_msgs; done += n ) {
+    n = CI_MIN(n_msgs - done, EFCH_EXT_MSG_BATCH_MAX);
+    for( i = 0; i < n; ++i ) {
+      batch[i].payload_ptr = (uintptr_t)msgs[done + i].payload;
+      batch[i].payload_len = msgs[done + i].payload_size;
+      batch[i].msg_id = msgs[done + i].message;
+      batch[i].rc = 0;
+    }
+
+    op.op = CI_RSOP_EXT_MSG_BATCH;
+    op.id = ext->id;
+    op.u.ext_msg_batch.msgs_ptr = (uintptr_t)batch;
+    op.u.ext_msg_batch.n_msgs = n;
+    op.u.ext_msg_batch.flags = 0;
+    rc = ci_resource_op(ext->dh, &op);
+    if( rc < 0 )
+      return done ? done : rc;
+
+    for( i = 0; i < n; ++i )
+      msgs[done + i].rc = batch[i].rc;
+  }
+  return done;
+}
+
 /*! \cidoxg_end */
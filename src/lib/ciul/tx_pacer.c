@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* Software pacing of transmits.  Descriptors are released through the
+ * ef_vi ops, so this works with any back-end that supports DMA sends.
+ */
+
+#include <etherfabric/tx_pacer.h>
+#include <errno.h>
+#include <time.h>
+
+
+int ef_tx_pacer_init(ef_tx_pacer* pacer, ef_vi* vi, ef_tx_pacer_desc* descs,
+                     unsigned n_descs)
+{
+  if( n_descs == 0 || (n_descs & (n_descs - 1)) != 0 )
+    return -EINVAL;
+
+  pacer->vi = vi;
+  pacer->descs = descs;
+  pacer->mask = n_descs - 1;
+  pacer->added = 0;
+  pacer->removed = 0;
+  return 0;
+}
+
+
+int ef_tx_pacer_queue(ef_tx_pacer* pacer, ef_addr addr, int len,
+                      ef_request_id dma_id, uint64_t due_ns)
+{
+  ef_tx_pacer_desc* desc;
+
+  if( ef_tx_pacer_fill_level(pacer) > pacer->mask )
+    return -EAGAIN;
+
+  desc = &pacer->descs[pacer->added++ & pacer->mask];
+  desc->addr = addr;
+  desc->due_ns = due_ns;
+  desc->len = len;
+  desc->dma_id = dma_id;
+  return 0;
+}
+
+
+int ef_tx_pacer_release(ef_tx_pacer* pacer, uint64_t now_ns)
+{
+  ef_vi* vi = pacer->vi;
+  int n = 0;
+
+  while( pacer->removed != pacer->added ) {
+    ef_tx_pacer_desc* desc = &pacer->descs[pacer->removed & pacer->mask];
+    ef_iovec iov = { desc->addr, desc->len };
+
+    if( (int64_t) (now_ns - desc->due_ns) < 0 )
+      break;
+    if( ef_vi_transmitv_init(vi, &iov, 1, desc->dma_id) < 0 )
+      break;
+    ++pacer->removed;
+    ++n;
+  }
+
+  if( n )
+    ef_vi_transmit_push(vi);
+  return n;
+}
+
+
+int ef_tx_pacer_eventq_poll(ef_tx_pacer* pacer, ef_event* evs, int evs_len)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ef_tx_pacer_release(pacer, ts.tv_sec * 1000000000ull + ts.tv_nsec);
+  return ef_eventq_poll(pacer->vi, evs, evs_len);
+}
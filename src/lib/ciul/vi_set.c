@@ -70,6 +70,17 @@ int ef_vi_set_alloc_from_pd(ef_vi_set* viset, ef_driver_handle dh,
 }
 
 
+int ef_vi_set_rss_spread(ef_vi_set* viset, ef_driver_handle dh, int n_active)
+{
+  ci_resource_op_t op;
+
+  op.op = CI_RSOP_VI_SET_RSS_SPREAD;
+  op.id = efch_make_resource_id(viset->vis_res_id);
+  op.u.vi_set_rss_spread.n_active = n_active;
+  return ci_resource_op(dh, &op);
+}
+
+
 int ef_vi_set_free(ef_vi_set* vi_set, ef_driver_handle dh)
 {
   return 0;
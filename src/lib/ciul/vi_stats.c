@@ -55,6 +55,54 @@ ef10_query_layout(ef_vi* vi, const ef_vi_stats_layout**const layout_out)
   return 0;
 }
 
+/* AF_XDP has no hardware statistics, but ef_vi counts the system calls it
+ * makes to wake up the kernel, and those it avoids. */
+#define AF_XDP_STATS_SIZE 12
+
+static int
+af_xdp_query_layout(ef_vi* vi, const ef_vi_stats_layout**const layout_out)
+{
+  static const ef_vi_stats_layout layout = {
+    .evsl_data_size = AF_XDP_STATS_SIZE,
+    .evsl_fields_num = 3,
+    .evsl_fields = {
+      {
+        .evsfl_name = "TX wakeups",
+        .evsfl_offset = 0,
+        .evsfl_size = 4,
+      },
+      {
+        .evsfl_name = "TX wakeups avoided",
+        .evsfl_offset = 4,
+        .evsfl_size = 4,
+      },
+      {
+        .evsfl_name = "RX fill wakeups",
+        .evsfl_offset = 8,
+        .evsfl_size = 4,
+      },
+    }
+  };
+  *layout_out = &layout;
+  return 0;
+}
+
+static int
+af_xdp_query(ef_vi* vi, void* data, int do_reset)
+{
+  uint32_t* stats = data;
+
+  stats[0] = vi->ep_state->txq.xdp_kicks;
+  stats[1] = vi->ep_state->txq.xdp_kicks_avoided;
+  stats[2] = vi->ep_state->rxq.xdp_fill_kicks;
+  if( do_reset ) {
+    vi->ep_state->txq.xdp_kicks = 0;
+    vi->ep_state->txq.xdp_kicks_avoided = 0;
+    vi->ep_state->rxq.xdp_fill_kicks = 0;
+  }
+  return 0;
+}
+
 int
 ef_vi_stats_query_layout(ef_vi* vi,
                          const ef_vi_stats_layout**const layout_out)
@@ -62,6 +110,8 @@ ef_vi_stats_query_layout(ef_vi* vi,
   switch( vi->nic_type.arch ) {
   case EF_VI_ARCH_EF10:
     return ef10_query_layout(vi, layout_out);
+  case EF_VI_ARCH_AF_XDP:
+    return af_xdp_query_layout(vi, layout_out);
   default:
     return -EINVAL;
   }
@@ -86,6 +136,8 @@ ef_vi_stats_query(ef_vi* vi, ef_driver_handle dh, void* data, int do_reset)
   switch( vi->nic_type.arch ) {
   case EF_VI_ARCH_EF10:
     return ef10_query(vi, dh, data, do_reset);
+  case EF_VI_ARCH_AF_XDP:
+    return af_xdp_query(vi, data, do_reset);
   default:
     EF_VI_BUG_ON(1);
     return -EINVAL;
@@ -250,6 +250,24 @@ int __oo_cp_route_resolve(struct oo_cplane_handle* cp,
   return 0;
 }
 
+int oo_cp_route_prefetch(struct oo_cplane_handle* cp, struct cp_fwd_key* key,
+                         cp_fwd_table_id fwd_table_id)
+{
+  struct cp_fwd_table* fwd_table = oo_cp_get_fwd_table(cp, fwd_table_id);
+  struct cp_fwd_key req = *key;
+  cicp_mac_rowid_t id;
+
+  id = cp_fwd_find_match(fwd_table, key, CP_FWD_MULTIPATH_WEIGHT_NONE);
+  if( id != CICP_MAC_ROWID_BAD &&
+      cp_get_fwd_by_id(fwd_table, id)->flags & CICP_FWD_FLAG_DATA_VALID &&
+      cp_fwd_find_row_found_perfect_match(fwd_table, id, key) )
+    return 0;
+
+  req.flag &= ~CP_FWD_KEY_REQ_WAIT;
+  oo_op_route_resolve(cp, &req CI_KERNEL_ARG(fwd_table_id));
+  return 1;
+}
+
 int
 oo_cp_get_hwport_properties(struct oo_cplane_handle* cp, ci_hwport_id_t hwport,
                             cp_hwport_flags_t* out_mib_flags,
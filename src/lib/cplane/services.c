@@ -12,7 +12,8 @@
 
 
 /* Returns a backend endpoint randomly selected from a service's set of
- * backends */
+ * backends.  The choice is made through the service's Maglev table, so it
+ * costs the same however many backends there are. */
 static struct cp_svc_endpoint*
 cp_svc_select_backend(const struct cp_mibs* mib, const cicp_mac_rowid_t id)
 {
@@ -26,6 +27,14 @@ cp_svc_select_backend(const struct cp_mibs* mib, const cicp_mac_rowid_t id)
     return NULL;
   ci_assert( CICP_ROWID_IS_VALID(svc->u.service.head_array_id) );
 
+  if( svc->u.service.n_backends <= CP_SVC_MAGLEV_SIZE ) {
+    const struct cp_svc_maglev* maglev =
+      &mib->svc_maglev[svc->u.service.head_array_id];
+    ci_uint32 slot = maglev->slots[(ci_frc64_get() >> 4) % CP_SVC_MAGLEV_SIZE];
+    return &mib->svc_arrays[CP_SVC_MAGLEV_SLOT_ARRAY(slot)]
+              .eps[CP_SVC_MAGLEV_SLOT_INDEX(slot)];
+  }
+
   /* Copy approximate hash generator from oo_cp_multipath_hash */
   element_id = (ci_frc64_get() >> 4) % svc->u.service.n_backends;
   cp_svc_walk_array_chain(mib, svc->u.service.head_array_id, element_id,
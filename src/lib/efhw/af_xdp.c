@@ -37,6 +37,19 @@ int enable_af_xdp_flow_filters = 1;
 module_param(enable_af_xdp_flow_filters, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(enable_af_xdp_flow_filters,
                  "Enables flow filter use for AF_XDP devices ");
+#ifdef EFRM_XSK_HAS_FQ_TMP
+static int af_xdp_share_umem = 1;
+module_param(af_xdp_share_umem, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(af_xdp_share_umem,
+                 "Share one UMEM between the AF_XDP sockets of a protection "
+                 "domain on different queues, rather than registering the "
+                 "same memory for each");
+#else
+/* Sharing a UMEM between queues needs per-socket fill and completion rings,
+ * which arrived in linux-5.10 */
+static const int af_xdp_share_umem = 0;
+#endif
+
 /* filter id when no actual filter is installed */
 #define AF_XDP_NO_FILTER_MAGIC_ID 0x7FFFFF00
 
@@ -170,6 +183,8 @@ struct efhw_af_xdp_vi
   int rxq_capacity;
   int txq_capacity;
   unsigned flags;
+  /* Bound with XDP_SHARED_UMEM, rather than registering its own UMEM */
+  bool shared_umem;
 
   struct efab_af_xdp_offsets kernel_offsets;
   struct efhw_page user_offsets_page;
@@ -183,6 +198,13 @@ struct protection_domain
   struct umem_pages umem;
   long buffer_table_count;
   long freed_buffer_table_count;
+
+  /* VI whose socket registered the UMEM most recently, which later VIs on
+   * other queues can share, and how many pages it covered. */
+  struct efhw_af_xdp_vi* umem_vi;
+  long umem_vi_pages;
+  int umem_vi_chunk_size;
+  int umem_vi_headroom;
 };
 
 /* Per-NIC AF_XDP resources */
@@ -454,6 +476,60 @@ static int xdp_bind(struct socket* sock, int ifindex, unsigned queue, unsigned f
   return kernel_bind(sock, (struct sockaddr*)&sxdp, sizeof(sxdp));
 }
 
+/* Bind an AF_XDP socket to an interface, using the UMEM registered with
+ * another socket. The mode flags are inherited from that socket, and must
+ * not be given here. */
+static int xdp_bind_shared(struct socket* sock, int ifindex, unsigned queue,
+                           struct file* umem_sock)
+{
+  struct sockaddr_xdp sxdp = {};
+  int rc, umem_fd;
+
+  rc = umem_fd = xdp_alloc_fd(umem_sock);
+  if( rc < 0 )
+    return rc;
+
+  sxdp.sxdp_family = PF_XDP;
+  sxdp.sxdp_ifindex = ifindex;
+  sxdp.sxdp_queue_id = queue;
+  sxdp.sxdp_flags = XDP_SHARED_UMEM;
+  sxdp.sxdp_shared_umem_fd = umem_fd;
+
+  rc = kernel_bind(sock, (struct sockaddr*)&sxdp, sizeof(sxdp));
+  ci_close_fd(umem_fd);
+  return rc;
+}
+
+/* Bind, asking for multi-buffer frames if the kernel supports them, so that
+ * frames bigger than a buffer can be used. Not all drivers support them in
+ * zero-copy mode, so do without if necessary. */
+static int xdp_bind_vi(struct efhw_af_xdp_vi* vi, struct efhw_af_xdp_vi* umem_vi,
+                       int ifindex, unsigned queue)
+{
+  if( umem_vi != NULL ) {
+    /* The socket inherits need_wakeup from the one that registered the
+     * UMEM, but multi-buffer frames are not available when sharing */
+    vi->flags = umem_vi->flags;
+#ifdef XDP_USE_SG
+    vi->flags &= ~XDP_USE_SG;
+#endif
+    return xdp_bind_shared(vi->sock, ifindex, queue, umem_vi->sock->file);
+  }
+
+#ifdef XDP_USE_NEED_WAKEUP
+  /* The ring flags offsets given to ef_vi are only meaningful with this */
+  vi->flags |= XDP_USE_NEED_WAKEUP;
+#endif
+#ifdef XDP_USE_SG
+  int rc = xdp_bind(vi->sock, ifindex, queue, vi->flags | XDP_USE_SG);
+  if( rc == 0 )
+    vi->flags |= XDP_USE_SG;
+  if( rc != -EOPNOTSUPP )
+    return rc;
+#endif
+  return xdp_bind(vi->sock, ifindex, queue, vi->flags);
+}
+
 /* Link an XDP program to an interface */
 static int xdp_set_link(struct net_device* dev, int prog_fd)
 {
@@ -658,6 +734,14 @@ static int xdp_create_ring(struct socket* sock,
   user_offset->consumer = user_base + xdp_offset->consumer;
   user_offset->desc     = user_base + xdp_offset->desc;
 
+#ifdef XDP_USE_NEED_WAKEUP
+  kern_offset->flags = kern_base + xdp_offset->flags;
+  user_offset->flags = user_base + xdp_offset->flags;
+#else
+  kern_offset->flags = -1;
+  user_offset->flags = -1;
+#endif
+
   return 0;
 }
 
@@ -760,6 +844,7 @@ static void xdp_release_pd(struct efhw_nic* nic, int owner)
 
 static void xdp_release_vi(struct efhw_nic* nic, struct efhw_af_xdp_vi* vi)
 {
+  struct protection_domain* pd;
   int i;
 
   if( !vi->sock )
@@ -768,6 +853,12 @@ static void xdp_release_vi(struct efhw_nic* nic, struct efhw_af_xdp_vi* vi)
      * This can happen on cleanup from failure of stack allocation */
     return;
 
+  /* Sockets already sharing our UMEM hold their own references to it, but
+   * new ones can't share it through us any more. */
+  pd = pd_by_owner(nic, vi->owner_id);
+  if( pd != NULL && pd->umem_vi == vi )
+    pd->umem_vi = NULL;
+
   /* Stop from using this socket */
   if( vi->waiter.wait.func != NULL )
     remove_wait_queue(sk_sleep(vi->sock->sk), &vi->waiter.wait);
@@ -816,6 +907,7 @@ static int af_xdp_init(struct efhw_nic* nic, int instance,
 {
   int rc;
   struct efhw_af_xdp_vi* vi;
+  struct efhw_af_xdp_vi* umem_vi;
   int owner_id;
   struct protection_domain* pd;
   struct socket* sock;
@@ -863,9 +955,19 @@ static int af_xdp_init(struct efhw_nic* nic, int instance,
   if( rc < 0 )
     goto fail;
 
-  rc = xdp_register_umem(sock, &pd->umem, chunk_size, headroom);
-  if( rc < 0 )
-    goto fail;
+  /* A socket on another queue which registered this PD's memory can share
+   * its UMEM with us, unless the PD has gained more memory since then. This
+   * saves pinning and mapping the same memory again for each queue. */
+  umem_vi = pd->umem_vi;
+  if( ! af_xdp_share_umem || pd->umem_vi_pages != pd->umem.used_page_count ||
+      chunk_size != pd->umem_vi_chunk_size || headroom != pd->umem_vi_headroom )
+    umem_vi = NULL;
+
+  if( umem_vi == NULL ) {
+    rc = xdp_register_umem(sock, &pd->umem, chunk_size, headroom);
+    if( rc < 0 )
+      goto fail;
+  }
 
   rc = xdp_create_rings(sock, page_map, &vi->kernel_offsets,
                         vi->rxq_capacity, vi->txq_capacity,
@@ -879,7 +981,7 @@ static int af_xdp_init(struct efhw_nic* nic, int instance,
     goto fail;
 
   /* TODO AF_XDP: currently instance number matches net_device channel */
-  rc = xdp_bind(sock, nic->net_dev->ifindex, instance, vi->flags);
+  rc = xdp_bind_vi(vi, umem_vi, nic->net_dev->ifindex, instance);
   if( rc == -EBUSY ) {
     /* AF_XDP resource release happens asynchronously - the socket through RCU
      * and the associated umem through deferred work on the global workqueue.
@@ -897,15 +999,30 @@ static int af_xdp_init(struct efhw_nic* nic, int instance,
 #else
     flush_scheduled_work();
 #endif
-    rc = xdp_bind(sock, nic->net_dev->ifindex, instance, vi->flags);
+    rc = xdp_bind_vi(vi, umem_vi, nic->net_dev->ifindex, instance);
   }
   if( rc < 0 )
     goto fail;
 
+  if( umem_vi != NULL ) {
+    vi->shared_umem = true;
+  }
+  else {
+    pd->umem_vi = vi;
+    pd->umem_vi_pages = pd->umem.used_page_count;
+    pd->umem_vi_chunk_size = chunk_size;
+    pd->umem_vi_headroom = headroom;
+  }
+
   if( vi->waiter.wait.func != NULL )
     add_wait_queue(sk_sleep(vi->sock->sk), &vi->waiter.wait);
 
   user_offsets->mmap_bytes = efhw_page_map_bytes(page_map);
+#ifdef XDP_USE_SG
+  if( vi->flags & XDP_USE_SG )
+    user_offsets->features |= EFAB_AF_XDP_FEATURE_SG;
+#endif
+  vi->kernel_offsets.features = user_offsets->features;
   return 0;
 
  fail:
@@ -914,15 +1031,36 @@ static int af_xdp_init(struct efhw_nic* nic, int instance,
   return rc;
 }
 
+static bool af_xdp_ring_needs_wakeup(struct efhw_af_xdp_vi* vi,
+                                     const struct efab_af_xdp_offsets_ring* ring)
+{
+#ifdef XDP_USE_NEED_WAKEUP
+  return READ_ONCE(*(u32*)((char*)&vi->kernel_offsets + ring->flags)) &
+         XDP_RING_NEED_WAKEUP;
+#else
+  return true;
+#endif
+}
+
+/* Wake up whichever of TX and RX the kernel is waiting to be told about */
 static int af_xdp_dmaq_kick(struct efhw_nic *nic, int instance)
 {
   struct efhw_af_xdp_vi* vi;
   struct msghdr msg = {.msg_flags = MSG_DONTWAIT};
+  int rc = 0;
   vi = vi_by_instance(nic, instance);
   if( vi == NULL )
     return -ENODEV;
 
-  return kernel_sendmsg(vi->sock, &msg, NULL, 0, 0);
+#ifdef XDP_USE_NEED_WAKEUP
+  if( af_xdp_ring_needs_wakeup(vi, &vi->kernel_offsets.rings.fr) ) {
+    struct msghdr rx_msg = {.msg_flags = MSG_DONTWAIT};
+    kernel_recvmsg(vi->sock, &rx_msg, NULL, 0, 0, MSG_DONTWAIT);
+  }
+#endif
+  if( af_xdp_ring_needs_wakeup(vi, &vi->kernel_offsets.rings.tx) )
+    rc = kernel_sendmsg(vi->sock, &msg, NULL, 0, 0);
+  return rc;
 }
 
 /*----------------------------------------------------------------------------
@@ -93,6 +93,16 @@ static int efhw_debugfs_read_nic_queue_sizes(struct seq_file *file,
   return 0;
 }
 
+static int efhw_debugfs_read_filters(struct seq_file *file, const void *data)
+{
+  const struct efhw_nic *nic = data;
+
+  seq_printf(file, "in_use: %d\ninsert_full: %d\n",
+             atomic_read(&nic->filters_in_use),
+             atomic_read(&nic->filter_insert_full));
+  return 0;
+}
+
 /* Per-NIC parameters */
 static const struct efrm_debugfs_parameter efhw_debugfs_nic_parameters[] = {
   _EFRM_RAW_PARAMETER(dev, efhw_debugfs_read_devname),
@@ -122,6 +132,7 @@ static const struct efrm_debugfs_parameter efhw_debugfs_nic_parameters[] = {
   EFRM_U32_PARAMETER(struct efhw_nic, vi_irq_n_ranges),
   _EFRM_RAW_PARAMETER(vi_irq_ranges, efhw_debugfs_read_irq_ranges),
   _EFRM_RAW_PARAMETER(q_sizes, efhw_debugfs_read_nic_queue_sizes),
+  _EFRM_RAW_PARAMETER(filters, efhw_debugfs_read_filters),
   {NULL},
 };
 
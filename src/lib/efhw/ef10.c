@@ -126,6 +126,41 @@ int ef10_ef100_mcdi_rpc_client(struct efhw_nic *nic, uint32_t client_id,
 }
 
 
+static void ef10_ef100_mcdi_async_complete(struct efx_dl_device *efx_dev,
+					   unsigned long cmd, int rc,
+					   const u8 *outbuf,
+					   size_t outlen_actual)
+{
+	/* Nobody is waiting for the result, so all we can do with a
+	 * failure is report it. */
+	if (rc != 0 && rc != -ENETDOWN)
+		EFHW_ERR_LIMITED("%s: MCDI command 0x%lx failed rc=%d",
+				 __FUNCTION__, cmd, rc);
+}
+
+
+/* Issue a command whose result the caller doesn't need, without waiting for
+ * it.  Commands queue behind one another in the net driver, so a burst of
+ * them costs the caller one enqueue each rather than one round trip each.
+ * Commands issued this way complete in order with respect to each other,
+ * but not with respect to ef10_ef100_mcdi_rpc().
+ */
+int ef10_ef100_mcdi_rpc_async(struct efhw_nic *nic, unsigned int cmd,
+			      size_t inlen, const void *inbuf)
+{
+	int rc;
+	struct efx_dl_device *efx_dev;
+
+	EFX_DL_PRE(efx_dev, nic, rc)
+		rc = efx_dl_mcdi_rpc_async(efx_dev, cmd, inlen,
+					   (const u8*) inbuf,
+					   ef10_ef100_mcdi_async_complete,
+					   cmd);
+	EFX_DL_POST(efx_dev, nic, rc)
+	return rc;
+}
+
+
 void
 ef10_ef100_mcdi_check_response(const char* caller, const char* failed_cmd,
 			       int rc, int expected_len, int actual_len,
@@ -874,15 +909,18 @@ void
 ef10_ef100_mcdi_cmd_driver_event(struct efhw_nic *nic, uint64_t data, uint32_t evq)
 {
 	int rc;
-	size_t out_size;
 	EFHW_MCDI_DECLARE_BUF(in, MC_CMD_DRIVER_EVENT_IN_LEN);
 	EFHW_MCDI_INITIALISE_BUF(in);
 	EFHW_MCDI_SET_DWORD(in, DRIVER_EVENT_IN_EVQ, evq);
 	EFHW_MCDI_SET_QWORD(in, DRIVER_EVENT_IN_DATA, data);
 
-	rc = ef10_ef100_mcdi_rpc(nic, MC_CMD_DRIVER_EVENT, sizeof(in), 0, &out_size,
-				 in, NULL);
-	MCDI_CHECK(MC_CMD_DRIVER_EVENT, rc, out_size, 0);
+	/* The event itself is what the caller is after, so there is no
+	 * reason to wait for the MC to acknowledge the command. */
+	rc = ef10_ef100_mcdi_rpc_async(nic, MC_CMD_DRIVER_EVENT, sizeof(in),
+				       in);
+	if (rc < 0)
+		EFHW_ERR_LIMITED("%s: MC_CMD_DRIVER_EVENT failed rc=%d",
+				 __FUNCTION__, rc);
 }
 
 
@@ -24,6 +24,9 @@ extern int ef10_ef100_mcdi_rpc_client(struct efhw_nic *nic, uint32_t client_id,
 			       size_t inlen, size_t outlen, size_t *outlen_actual,
 			       void *inbuf, void *outbuf);
 
+extern int ef10_ef100_mcdi_rpc_async(struct efhw_nic *nic, unsigned int cmd,
+				     size_t inlen, const void *inbuf);
+
 #define MCDI_CHECK(op, rc, actual_len, rate_limit)			   \
 	ef10_ef100_mcdi_check_response(__func__, #op, (rc), op##_OUT_LEN,  \
 				       (actual_len), (rate_limit))
@@ -59,7 +59,8 @@ static void ef100_device_type_init(struct efhw_device_type *dt,
 				   char variant, int device_id,
 				   int class_revision)
 {
-	dt->function = EFHW_FUNCTION_PF;
+	dt->function = device_id & 0x1000 ? EFHW_FUNCTION_VF :
+		       EFHW_FUNCTION_PF;
 	dt->arch = EFHW_ARCH_EF100;
 	dt->variant = variant;
 	dt->revision = class_revision;
@@ -117,6 +118,7 @@ int efhw_sfc_device_type_init(struct efhw_device_type *dt, struct pci_dev* dev)
 		ef10_device_type_init(dt, 'C', dev->device, class_revision);
 		break;
 	case 0x0100:
+	case 0x1100:
 		/* FIXME: add properly variants and revisions for EF100 */
 		ef100_device_type_init(dt, 'A', dev->device, class_revision);
 		break;
@@ -33,6 +33,159 @@
 #include "bt_manager.h"
 #include <ci/driver/efab/hardware.h>
 #include <ci/efhw/efhw_buftable.h>
+#include <ci/driver/resource/linux_efhw_nic.h>
+#include "efrm_internal.h"
+
+
+/* Blocks that an allocation no longer needs are not returned to the NIC
+ * straight away, but kept in a per-NIC pool indexed by owner id and order.
+ * On EF10 allocating and freeing a block each take an MCDI round trip, as
+ * much again as programming its entries, so taking blocks from the pool
+ * halves the MCDI needed to create a stack with EF_PREALLOC_PACKETS or to
+ * grow its packet sets, and destroying a stack needs none to free them.
+ * Owner ids are allocated lowest first, so a new stack usually inherits the
+ * blocks of one destroyed before it.
+ *
+ * Entries are cleared before a block is pooled, just as before it is freed.
+ * AF_XDP depends on consecutive allocations being consecutive, so only EF10
+ * and EF100 pool blocks.  The NIC forgets its blocks across a reset, so the
+ * pool is emptied without MCDI when a reset begins and again once it has
+ * completed.
+ */
+
+int efrm_bt_pool_ctor(struct efrm_nic *rnic)
+{
+	struct efhw_nic *nic = &rnic->efhw_nic;
+	struct efrm_bt_pool *pool = &rnic->bt_pool;
+
+	spin_lock_init(&pool->btp_lock);
+	pool->btp_heads = NULL;
+	pool->btp_n_owners = 0;
+	pool->btp_n_blocks = 0;
+
+	if ((nic->devtype.arch != EFHW_ARCH_EF10 &&
+	     nic->devtype.arch != EFHW_ARCH_EF100) ||
+	    efhw_nic_buffer_table_orders_num(nic) > EFRM_BT_POOL_ORDERS_MAX)
+		return 0;
+
+	/* Owner ids run from 1 to max_vis; see efrm_nic_ctor(). */
+	pool->btp_n_owners = rnic->max_vis + 1;
+	pool->btp_heads = vzalloc(pool->btp_n_owners *
+				  sizeof(pool->btp_heads[0]));
+	if (pool->btp_heads == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+
+void efrm_bt_pool_dtor(struct efrm_nic *rnic)
+{
+	struct efrm_bt_pool *pool = &rnic->bt_pool;
+
+	/* The hardware is gone by now, so the blocks can only be forgotten. */
+	efrm_bt_pool_flush(&rnic->efhw_nic, 1);
+	vfree(pool->btp_heads);
+	pool->btp_heads = NULL;
+	spin_lock_destroy(&pool->btp_lock);
+}
+
+
+void efrm_bt_pool_flush(struct efhw_nic *nic, int reset_pending)
+{
+	struct efrm_bt_pool *pool = &efrm_nic(nic)->bt_pool;
+	struct efhw_buffer_table_block *blocks = NULL, *block;
+	int owner, ord_idx;
+
+	if (pool->btp_heads == NULL)
+		return;
+
+	spin_lock_bh(&pool->btp_lock);
+	for (owner = 0; owner < pool->btp_n_owners; owner++)
+		for (ord_idx = 0; ord_idx < EFRM_BT_POOL_ORDERS_MAX; ord_idx++)
+			while ((block = pool->btp_heads[owner][ord_idx])
+			       != NULL) {
+				pool->btp_heads[owner][ord_idx] =
+					block->btb_next;
+				block->btb_next = blocks;
+				blocks = block;
+			}
+	pool->btp_n_blocks = 0;
+	spin_unlock_bh(&pool->btp_lock);
+
+	while ((block = blocks) != NULL) {
+		blocks = block->btb_next;
+		efhw_nic_buffer_table_free(nic, block, reset_pending);
+	}
+}
+
+
+/* Returns the list of blocks in the pool for [manager], or NULL if there is
+ * none. */
+static struct efhw_buffer_table_block **
+efrm_bt_pool_list(struct efhw_nic *nic, struct efrm_bt_manager *manager)
+{
+	struct efrm_bt_pool *pool = &efrm_nic(nic)->bt_pool;
+	int ord_idx;
+
+	if (pool->btp_heads == NULL || nic->resetting ||
+	    manager->owner <= 0 || manager->owner >= pool->btp_n_owners)
+		return NULL;
+	for (ord_idx = 0; ord_idx < efhw_nic_buffer_table_orders_num(nic);
+	     ord_idx++)
+		if (efhw_nic_buffer_table_orders(nic)[ord_idx] ==
+		    manager->order)
+			return &pool->btp_heads[manager->owner][ord_idx];
+	return NULL;
+}
+
+
+static struct efhw_buffer_table_block *
+efrm_bt_pool_get(struct efhw_nic *nic, struct efrm_bt_manager *manager)
+{
+	struct efrm_bt_pool *pool = &efrm_nic(nic)->bt_pool;
+	struct efhw_buffer_table_block **list;
+	struct efhw_buffer_table_block *block = NULL;
+
+	list = efrm_bt_pool_list(nic, manager);
+	if (list == NULL)
+		return NULL;
+
+	spin_lock_bh(&pool->btp_lock);
+	if ((block = *list) != NULL) {
+		*list = block->btb_next;
+		block->btb_next = NULL;
+		--pool->btp_n_blocks;
+	}
+	spin_unlock_bh(&pool->btp_lock);
+	return block;
+}
+
+
+/* Puts a block whose entries have been cleared into the pool.  Returns
+ * zero on success, or non-zero if the caller should free the block. */
+static int
+efrm_bt_pool_put(struct efhw_nic *nic, struct efrm_bt_manager *manager,
+		 struct efhw_buffer_table_block *block)
+{
+	struct efrm_bt_pool *pool = &efrm_nic(nic)->bt_pool;
+	struct efhw_buffer_table_block **list;
+	int rc = -ENOSPC;
+
+	list = efrm_bt_pool_list(nic, manager);
+	if (list == NULL)
+		return -ENOSPC;
+
+	spin_lock_bh(&pool->btp_lock);
+	if (pool->btp_n_blocks < efrm_bt_pool_max_blocks()) {
+		block->btb_next = *list;
+		*list = block;
+		++pool->btp_n_blocks;
+		rc = 0;
+	}
+	spin_unlock_bh(&pool->btp_lock);
+	return rc;
+}
+
 
 static int
 efrm_bt_block_reuse_try(struct efhw_buffer_table_block *block,
@@ -74,9 +227,13 @@ efrm_bt_blocks_alloc(struct efhw_nic *nic,
 	 * FIXME AF_XDP: for AF_XDP this is guaranteed and is required behaviour for
 	 * descriptor address->pkt_id resolution */
 	for (i = 0; i < n_blocks; i++) {
-		rc = efhw_nic_buffer_table_alloc(nic, manager->owner,
-						 manager->order, &block,
-						 reset_pending);
+		block = reset_pending ? NULL : efrm_bt_pool_get(nic, manager);
+		if (block != NULL)
+			rc = 0;
+		else
+			rc = efhw_nic_buffer_table_alloc(nic, manager->owner,
+							 manager->order, &block,
+							 reset_pending);
 		/* ENETDOWN indicates absent hardware, in which case we should
 		 * not report failure as we wish to preserve all software state
 		 * in anticipation of the hardware's reappearance. */
@@ -122,7 +279,7 @@ efrm_bt_block_clear(struct efhw_nic *nic, int bta_flags,
                     
 
 static void
-efrm_bt_blocks_free(struct efhw_nic *nic,
+efrm_bt_blocks_free(struct efhw_nic *nic, struct efrm_bt_manager *manager,
 		    struct efrm_buffer_table_allocation *a, int reset_pending)
 {
 	int n = a->bta_size;
@@ -135,7 +292,11 @@ efrm_bt_blocks_free(struct efhw_nic *nic,
                                     reset_pending);
 		n -= EFHW_BUFFER_TABLE_BLOCK_SIZE;
 		a->bta_blocks = block->btb_next;
-		efhw_nic_buffer_table_free(nic, block, reset_pending);
+		/* Only blocks whose entries were cleared above may be
+		 * pooled. */
+		if (reset_pending || a->bta_flags != 0 ||
+		    efrm_bt_pool_put(nic, manager, block) != 0)
+			efhw_nic_buffer_table_free(nic, block, reset_pending);
 	}
 }
 
@@ -214,11 +375,23 @@ efrm_bt_free_small(struct efhw_nic *nic, struct efrm_bt_manager *manager,
 		manager->btm_block = NULL;
 	spin_unlock_bh(&manager->btm_lock);
 
+	atomic_dec(&manager->btm_blocks);
+
+	/* Other allocations from the block may have skipped clearing their
+	 * entries after a reset, so clear the whole block before pooling it.
+	 * That costs no more than freeing it would. */
+	if (! reset_pending && a->bta_flags == 0 &&
+	    efrm_bt_pool_list(nic, manager) != NULL) {
+		efhw_nic_buffer_table_clear(nic, a->bta_blocks, 0,
+					    EFHW_BUFFER_TABLE_BLOCK_SIZE);
+		if (efrm_bt_pool_put(nic, manager, a->bta_blocks) == 0)
+			return;
+	}
+
 	if (! reset_pending &&
 	    (a->bta_flags & (EFRM_BTA_FLAG_IN_RESET | EFRM_BTA_FLAG_FRAUD))
              != EFRM_BTA_FLAG_IN_RESET)
 		efhw_nic_buffer_table_free(nic, a->bta_blocks, reset_pending);
-	atomic_dec(&manager->btm_blocks);
 }
 
 
@@ -299,7 +472,7 @@ efrm_bt_manager_free(struct efhw_nic *nic, struct efrm_bt_manager *manager,
 
 	atomic_sub((a->bta_size - 1) / EFHW_BUFFER_TABLE_BLOCK_SIZE + 1,
 		   &manager->btm_blocks);
-	efrm_bt_blocks_free(nic, a, reset_pending);
+	efrm_bt_blocks_free(nic, manager, a, reset_pending);
 	a->bta_size = 0;
 }
 
@@ -158,6 +158,13 @@ int efrm_nic_ctor(struct efrm_nic *efrm_nic,
 		goto fail4;
 	}
 
+	rc = efrm_bt_pool_ctor(efrm_nic);
+	if (rc < 0) {
+		EFRM_ERR("%s: efrm_bt_pool_ctor failed (%d)",
+			 __FUNCTION__, rc);
+		goto fail5;
+	}
+
 	spin_lock_init(&efrm_nic->lock);
 	INIT_LIST_HEAD(&efrm_nic->clients);
 	efrm_nic->rx_sniff_rxq = EFRM_PORT_SNIFF_NO_OWNER;
@@ -171,6 +178,8 @@ int efrm_nic_ctor(struct efrm_nic *efrm_nic,
 
 	return 0;
 
+fail5:
+	efrm_interrupt_vectors_dtor(efrm_nic);
 fail4:
 	efrm_pd_owner_ids_dtor(efrm_nic->owner_ids);
 fail3:
@@ -191,6 +200,7 @@ void efrm_nic_dtor(struct efrm_nic *efrm_nic)
         EFRM_ASSERT(list_empty(&efrm_nic->dmaq_state.q[EFHW_RXQ]));
         EFRM_ASSERT(list_empty(&efrm_nic->dmaq_state.q[EFHW_TXQ]));
 
+	efrm_bt_pool_dtor(efrm_nic);
 	efrm_interrupt_vectors_dtor(efrm_nic);
 	efrm_pd_owner_ids_dtor(efrm_nic->owner_ids);
 	efrm_vi_allocator_dtor(efrm_nic);
@@ -299,6 +309,9 @@ int efrm_nic_post_reset(struct efhw_nic *nic)
 
 	INIT_LIST_HEAD(&reset_list);
 
+	/* Blocks may have been pooled while the reset was in progress. */
+	efrm_bt_pool_flush(nic, 1);
+
 	spin_lock_bh(&efrm_nic_tablep->lock);
 	list_for_each(client_link, &rnic->clients) {
 		client = container_of(client_link, struct efrm_client, link);
@@ -334,6 +347,9 @@ int efrm_nic_reset_suspend(struct efhw_nic *nic)
 	struct efrm_client *client;
 	struct list_head *client_link;
 
+	/* The NIC will forget the blocks in the buffer table pool. */
+	efrm_bt_pool_flush(nic, 1);
+
 	spin_lock_bh(&efrm_nic_tablep->lock);
 	list_for_each(client_link, &rnic->clients) {
 		client = container_of(client_link, struct efrm_client, link);
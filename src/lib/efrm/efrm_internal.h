@@ -58,6 +58,9 @@ extern int efrm_nic_reset_suspend(struct efhw_nic *nic);
 #define EFRM_FLUSH_QUEUES_F_NOHW 1
 #define EFRM_FLUSH_QUEUES_F_INJECT_EV 2
 extern void efrm_nic_flush_all_queues(struct efhw_nic *nic, int flags);
+extern int efrm_bt_pool_ctor(struct efrm_nic *);
+extern void efrm_bt_pool_dtor(struct efrm_nic *);
+extern void efrm_bt_pool_flush(struct efhw_nic *nic, int reset_pending);
 #endif
 
 
@@ -1141,6 +1141,58 @@ void efrm_pd_dma_unmap(struct efrm_pd *pd, int n_pages, int nic_order,
 }
 EXPORT_SYMBOL(efrm_pd_dma_unmap);
 
+
+int efrm_pd_dma_map_premapped(struct efrm_pd *pd, int n_pages, int nic_order,
+			      dma_addr_t *pci_addrs, dma_addr_t *free_addrs,
+			      uint64_t *user_addrs, int user_addrs_stride,
+			      void (*user_addr_put)(uint64_t, uint64_t *),
+			      struct efrm_bt_collection *bt_alloc,
+			      int reset_pending)
+{
+	struct efhw_nic* nic = efrm_client_get_nic(pd->rs.rs_client);
+	int rc;
+
+	switch (nic->devtype.arch) {
+	case EFHW_ARCH_EF10:
+	case EFHW_ARCH_EF100:
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	if (pd->min_nic_order > nic_order) {
+		EFRM_ERR("%s: ERROR: min_nic_order(%d) > nic_order(%d)",
+			 __FUNCTION__, pd->min_nic_order, nic_order);
+		return -EPROTO;
+	}
+
+	rc = efhw_nic_translate_dma_addrs(nic, free_addrs, pci_addrs,
+					  n_pages);
+	if (rc < 0)
+		return rc;
+
+	if (pd->owner_id != OWNER_ID_PHYS_MODE)
+		return efrm_pd_dma_map_bt(pd, n_pages, nic_order, pci_addrs,
+					  user_addrs, user_addrs_stride,
+					  user_addr_put, bt_alloc,
+					  reset_pending, NULL);
+
+	efrm_pd_copy_user_addrs(pd, n_pages, nic_order, pci_addrs,
+				user_addrs, user_addrs_stride, user_addr_put);
+	return 0;
+}
+EXPORT_SYMBOL(efrm_pd_dma_map_premapped);
+
+
+void efrm_pd_dma_unmap_premapped(struct efrm_pd *pd,
+				 struct efrm_bt_collection *bt_alloc,
+				 int reset_pending)
+{
+	if (pd->owner_id != OWNER_ID_PHYS_MODE)
+		efrm_pd_dma_unmap_bt(pd, bt_alloc, reset_pending);
+}
+EXPORT_SYMBOL(efrm_pd_dma_unmap_premapped);
+
 /**********************************************************************/
 
 static void efrm_pd_rm_dtor(struct efrm_resource_manager *rm)
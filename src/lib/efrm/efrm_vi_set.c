@@ -320,6 +320,113 @@ int efrm_vi_set_get_rss_context(struct efrm_vi_set *vi_set, unsigned rss_id)
 EXPORT_SYMBOL(efrm_vi_set_get_rss_context);
 
 
+int efrm_vi_set_rss_table_size(struct efrm_vi_set *vi_set, unsigned rss_id)
+{
+	struct efrm_rss_context *context;
+
+	EFRM_ASSERT(rss_id <= EFRM_RSS_MODE_ID_MAX);
+	context = &vi_set->rss_context[rss_id];
+	if (context->rss_context_id == -1 ||
+	    context->indirection_table == NULL)
+		return 0;
+	return context->indirection_table_size;
+}
+EXPORT_SYMBOL(efrm_vi_set_rss_table_size);
+
+
+const u8 *efrm_vi_set_rss_key(struct efrm_vi_set *vi_set, unsigned rss_id)
+{
+	EFRM_ASSERT(rss_id <= EFRM_RSS_MODE_ID_MAX);
+	return vi_set->rss_context[rss_id].rss_hash_key;
+}
+EXPORT_SYMBOL(efrm_vi_set_rss_key);
+
+
+int efrm_vi_set_rss_bucket_get(struct efrm_vi_set *vi_set, unsigned rss_id,
+			       int bucket)
+{
+	struct efrm_rss_context *context;
+
+	EFRM_ASSERT(efrm_vi_set_rss_table_size(vi_set, rss_id) > bucket);
+	context = &vi_set->rss_context[rss_id];
+	return context->indirection_table[bucket];
+}
+EXPORT_SYMBOL(efrm_vi_set_rss_bucket_get);
+
+
+int efrm_vi_set_rss_bucket_move(struct efrm_vi_set *vi_set, unsigned rss_id,
+				int bucket, int instance)
+{
+	struct efrm_rss_context *context;
+	uint32_t old_instance;
+	int rc;
+
+	if (bucket < 0 ||
+	    bucket >= efrm_vi_set_rss_table_size(vi_set, rss_id) ||
+	    instance < 0 || instance >= vi_set->n_vis)
+		return -EINVAL;
+
+	context = &vi_set->rss_context[rss_id];
+	old_instance = context->indirection_table[bucket];
+	if (old_instance == instance)
+		return 0;
+
+	context->indirection_table[bucket] = instance;
+	rc = efrm_rss_context_update(vi_set->rs.rs_client,
+				     context->rss_context_id,
+				     context->indirection_table,
+				     context->rss_hash_key,
+				     context->rss_mode);
+	if (rc < 0) {
+		context->indirection_table[bucket] = old_instance;
+		return rc;
+	}
+	context->indirected_vis |= 1ull << instance;
+	return 0;
+}
+EXPORT_SYMBOL(efrm_vi_set_rss_bucket_move);
+
+
+int efrm_vi_set_rss_spread(struct efrm_vi_set *vi_set, unsigned rss_id,
+			   int n_active)
+{
+	struct efrm_rss_context *context;
+	uint32_t *old_table;
+	int table_size, bucket, rc;
+
+	table_size = efrm_vi_set_rss_table_size(vi_set, rss_id);
+	if (table_size == 0)
+		return -EOPNOTSUPP;
+	if (n_active < 1 || n_active > vi_set->n_vis)
+		return -EINVAL;
+
+	context = &vi_set->rss_context[rss_id];
+	old_table = kmalloc_array(table_size, sizeof(uint32_t), GFP_KERNEL);
+	if (old_table == NULL)
+		return -ENOMEM;
+	memcpy(old_table, context->indirection_table,
+	       table_size * sizeof(uint32_t));
+
+	/* Same striping as at allocation, over the first [n_active] VIs. */
+	for (bucket = 0; bucket < table_size; bucket++)
+		context->indirection_table[bucket] = bucket % n_active;
+	rc = efrm_rss_context_update(vi_set->rs.rs_client,
+				     context->rss_context_id,
+				     context->indirection_table,
+				     context->rss_hash_key,
+				     context->rss_mode);
+	if (rc < 0)
+		memcpy(context->indirection_table, old_table,
+		       table_size * sizeof(uint32_t));
+	else
+		context->indirected_vis =
+			(n_active < 64 ? (1ull << n_active) : 0) - 1;
+	kfree(old_table);
+	return rc;
+}
+EXPORT_SYMBOL(efrm_vi_set_rss_spread);
+
+
 struct efrm_resource * efrm_vi_set_to_resource(struct efrm_vi_set *vi_set)
 {
 	return &vi_set->rs;
@@ -55,6 +55,7 @@
 #include <etherfabric/vi.h>
 #include <etherfabric/internal/internal.h>
 #include <linux/file.h>
+#include <linux/irq.h>
 #include "efrm_internal.h"
 #include "efrm_vi_set.h"
 #include "efrm_pd.h"
@@ -208,6 +209,10 @@ efrm_vi_irq_free(struct efrm_interrupt_vector *vec)
 	if( vec->irq == IRQ_NOTCONNECTED )
 		return;
 
+	/* Drop any affinity set by efrm_vi_irq_set_affinity(); free_irq()
+	 * complains about a hint left behind. */
+	irq_set_affinity_hint(vec->irq, NULL);
+
 	/* linux>=4.13: free_irq() returns name */
 #ifdef EFRM_IRQ_FREE_RETURNS_NAME
 	name = free_irq(vec->irq, &vec->tasklet);
@@ -247,37 +252,73 @@ static void efrm_interrupt_vector_release(struct efrm_interrupt_vector *vec)
 }
 
 
+/* Rank a vector by how close its interrupt affinity is to the given CPU.
+ * Vectors that have no affinity to speak of (e.g. all CPUs on a multi-node
+ * system) rank as NODE, so that a vector that is actually steered to the
+ * requesting core is preferred over them. */
+static int
+efrm_interrupt_vector_locality(struct efrm_interrupt_vector *vec, int cpu)
+{
+#ifdef EFRM_HAVE_IRQ_GET_AFFINITY_MASK
+	const struct cpumask *mask;
+	const struct cpumask *node_mask = cpumask_of_node(cpu_to_node(cpu));
+
+	if (vec->irq == IRQ_NOTCONNECTED)
+		return EFRM_IRQ_LOCALITY_REMOTE;
+	mask = irq_get_affinity_mask(vec->irq);
+	if (mask == NULL)
+		return EFRM_IRQ_LOCALITY_NODE;
+	if (cpumask_test_cpu(cpu, mask) && cpumask_subset(mask, node_mask))
+		return EFRM_IRQ_LOCALITY_CORE;
+	if (cpumask_intersects(mask, node_mask))
+		return EFRM_IRQ_LOCALITY_NODE;
+	return EFRM_IRQ_LOCALITY_REMOTE;
+#else
+	return EFRM_IRQ_LOCALITY_NODE;
+#endif
+}
+
+
+/* Choose a vector for the VI, preferring the best locality to [cpu] and
+ * then the fewest VIs already sharing it. */
 static int
-efrm_interrupt_vector_choose(struct efrm_nic *nic, struct efrm_vi *virs)
+efrm_interrupt_vector_choose(struct efrm_nic *nic, struct efrm_vi *virs,
+			     int cpu)
 {
-	struct efrm_interrupt_vector *vec = NULL, *least_used_vec = NULL;
+	struct efrm_interrupt_vector *vec = NULL, *best_vec = NULL;
+	int locality, best_locality = EFRM_IRQ_LOCALITY_MAX;
 	int rc;
 
 	mutex_lock(&nic->irq_list_lock);
 	list_for_each_entry(vec, &nic->irq_list, link) {
+		locality = efrm_interrupt_vector_locality(vec, cpu);
 		/* The num_vis could be changing under our feet, but it's not
 		 * worth locking each vector to prevent this. */
-		if (least_used_vec == NULL ||
-		    vec->num_vis < least_used_vec->num_vis)
-			least_used_vec = vec;
-		if (vec->num_vis == 0)
+		if (locality < best_locality ||
+		    (locality == best_locality &&
+		     vec->num_vis < best_vec->num_vis)) {
+			best_vec = vec;
+			best_locality = locality;
+		}
+		if (vec->num_vis == 0 && locality == EFRM_IRQ_LOCALITY_CORE)
 			break;
 	}
 	mutex_unlock(&nic->irq_list_lock);
 
-	EFRM_ASSERT(least_used_vec);
+	EFRM_ASSERT(best_vec);
 
-	rc = efrm_interrupt_vector_acquire(least_used_vec);
+	rc = efrm_interrupt_vector_acquire(best_vec);
 
 	if (rc >= 0) {
-		virs->vec = least_used_vec;
-		spin_lock(&least_used_vec->vi_irq_lock);
-		list_add(&virs->irq_link, &least_used_vec->vi_list);
-		spin_unlock(&least_used_vec->vi_irq_lock);
+		virs->vec = best_vec;
+		virs->irq_locality = best_locality;
+		spin_lock(&best_vec->vi_irq_lock);
+		list_add(&virs->irq_link, &best_vec->vi_list);
+		spin_unlock(&best_vec->vi_irq_lock);
 		/* Move the vector to the end of the list in order to
 		 * discourage re-use. */
 		mutex_lock(&nic->irq_list_lock);
-		list_move_tail(&least_used_vec->link, &nic->irq_list);
+		list_move_tail(&best_vec->link, &nic->irq_list);
 		mutex_unlock(&nic->irq_list_lock);
 	}
 
@@ -358,7 +399,8 @@ void efrm_interrupt_vectors_release(struct efrm_nic *nic)
 }
 
 
-static int efrm_vi_request_irq(struct efhw_nic *nic, struct efrm_vi *virs)
+static int efrm_vi_request_irq(struct efhw_nic *nic, struct efrm_vi *virs,
+			       int interrupt_core)
 {
 	int rc;
 
@@ -367,7 +409,14 @@ static int efrm_vi_request_irq(struct efhw_nic *nic, struct efrm_vi *virs)
 	    (nic->devtype.variant == 'L') )
 		return 0;
 
-	rc = efrm_interrupt_vector_choose(efrm_nic(nic), virs);
+	/* Without an explicit core, aim for the one we're running on, which
+	 * is where the stack's threads are most likely to be. */
+	if (interrupt_core < 0 || interrupt_core >= nr_cpu_ids ||
+	    !cpu_online(interrupt_core))
+		interrupt_core = raw_smp_processor_id();
+
+	rc = efrm_interrupt_vector_choose(efrm_nic(nic), virs,
+					  interrupt_core);
 	if (rc != 0) {
 		EFRM_ERR("%s: Failed to assign IRQ: %d\n", __FUNCTION__, rc);
 		return rc;
@@ -433,6 +482,34 @@ int efrm_vi_af_xdp_kick(struct efrm_vi *virs)
 EXPORT_SYMBOL(efrm_vi_af_xdp_kick);
 
 
+/* Steer the VI's interrupt to [cpu].  The vector may be shared with other
+ * VIs, whose interrupts move with it.  Only applies where efrm owns the
+ * interrupts; where wakeups arrive on the net driver's channels the
+ * channel is fixed when the event queue is created. */
+int efrm_vi_irq_set_affinity(struct efrm_vi *virs, int cpu)
+{
+	struct efrm_interrupt_vector *vec = virs->vec;
+	int rc;
+
+	if (vec == NULL)
+		return -EOPNOTSUPP;
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return -EINVAL;
+
+	mutex_lock(&vec->vec_acquire_lock);
+	if (vec->irq == IRQ_NOTCONNECTED)
+		rc = -ENODEV;
+	else
+		rc = irq_set_affinity_hint(vec->irq, cpumask_of(cpu));
+	mutex_unlock(&vec->vec_acquire_lock);
+
+	if (rc == 0)
+		virs->irq_locality = efrm_interrupt_vector_locality(vec, cpu);
+	return rc;
+}
+EXPORT_SYMBOL(efrm_vi_irq_set_affinity);
+
+
 /* Try to allocate an instance out of the VIset.  If no free instances
  * and some instances are flushing, block.  Else return error.
  */
@@ -1038,16 +1115,57 @@ efrm_vi_evq_id(struct efrm_vi *virs, enum efhw_q_type queue_type)
 }
 
 
+#ifdef CONFIG_DEBUG_FS
+static const char *const efrm_irq_locality_names[] = {
+	[EFRM_IRQ_LOCALITY_CORE] = "core",
+	[EFRM_IRQ_LOCALITY_NODE] = "node",
+	[EFRM_IRQ_LOCALITY_REMOTE] = "remote",
+};
+static const int efrm_irq_locality_max = EFRM_IRQ_LOCALITY_MAX;
+
+static int efrm_debugfs_read_vi_irq(struct seq_file *file, const void *data)
+{
+	const struct efrm_vi *virs = data;
+	return efrm_debugfs_read_u32(file, &virs->vec->irq);
+}
+
+static int efrm_debugfs_read_vi_irq_channel(struct seq_file *file,
+					    const void *data)
+{
+	const struct efrm_vi *virs = data;
+	return efrm_debugfs_read_u32(file, &virs->vec->channel);
+}
+
+static int efrm_debugfs_read_vi_irq_locality(struct seq_file *file,
+					     const void *data)
+{
+	const struct efrm_vi *virs = data;
+	const char *name = STRING_TABLE_LOOKUP(virs->irq_locality,
+					       efrm_irq_locality);
+	return efrm_debugfs_read_string(file, &name);
+}
+
+static const struct efrm_debugfs_parameter efrm_debugfs_vi_irq_parameters[] = {
+	_EFRM_RAW_PARAMETER(irq, efrm_debugfs_read_vi_irq),
+	_EFRM_RAW_PARAMETER(irq_channel, efrm_debugfs_read_vi_irq_channel),
+	_EFRM_RAW_PARAMETER(irq_locality, efrm_debugfs_read_vi_irq_locality),
+	{NULL},
+};
+#endif
+
 static void efrm_init_debugfs_vi(struct efrm_vi *virs)
 {
 #ifdef CONFIG_DEBUG_FS
-	/* Currently only need vi debugfs folders to hold efct queues
-	 * Avoid creating others to avoid empty folder clutter */
-	if (virs->efct_shm) {
+	/* Only need vi debugfs folders to hold efct queues and to report
+	 * interrupt placement.  Avoid creating others to avoid empty folder
+	 * clutter */
+	if (virs->efct_shm || virs->vec) {
 		struct efrm_resource *rs = &virs->rs;
 		efrm_debugfs_add_rs(rs, NULL, rs->rs_instance);
 	}
-	/* VI resource doesn't currently have debugfs files */
+	if (virs->vec)
+		efrm_debugfs_add_rs_files(&virs->rs,
+					  efrm_debugfs_vi_irq_parameters, virs);
 #endif
 }
 
@@ -1732,7 +1850,8 @@ int  efrm_vi_alloc(struct efrm_client *client,
 	 * See ON-10914.
 	 */
 	if ((client->nic->flags & NIC_FLAG_EVQ_IRQ) && attr->want_interrupt) {
-		rc = efrm_vi_request_irq(client->nic, virs);
+		rc = efrm_vi_request_irq(client->nic, virs,
+					 attr->interrupt_core);
 		if (rc != 0)
 			goto fail_irq;
 	}
@@ -152,4 +152,10 @@ extern void oo_hw_filter_transfer(struct oo_hw_filter* oofilter_old,
  */
 extern unsigned oo_hw_filter_hwports(struct oo_hw_filter* oofilter);
 
+
+/* Return the number of hardware filters currently installed on [hwport] by
+ * all oo_hw_filters.
+ */
+extern int oo_hw_filter_count(int hwport);
+
 #endif  /* __ONLOAD_HW_FILTER_H__ */
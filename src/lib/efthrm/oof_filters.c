@@ -77,6 +77,14 @@ int oof_shared_keep_thresh = 100;
  */
 int oof_shared_steal_thresh = 200;
 
+/* If non-zero, and any hwport used by a filter manager has at least this
+ * many hardware filters installed, the NIC's filter table is considered to
+ * be under pressure.  Sockets sharing a wild-match filter then keep sharing
+ * it when the wild socket goes away, rather than each being given its own
+ * full-match filter, regardless of [oof_shared_keep_thresh].
+ */
+int oof_filter_pressure_thresh = 0;
+
 /* Module option to handle all local IP addresses. */
 int oof_use_all_local_ip_addresses = 0;
 
@@ -1301,6 +1309,18 @@ oof_socket_add_full_hw(struct oof_manager* fm, struct oof_socket* skf,
                        struct oof_local_port_addr* lpa, int af);
 
 
+/* Returns true if any socket on [lp] could want a filter for the address
+ * that [lpa] refers to. */
+static int
+oof_local_port_addr_has_users(struct oof_local_port* lp,
+                              struct oof_local_port_addr* lpa)
+{
+  return ci_dllist_not_empty(&lp->lp_wild_socks) ||
+         ci_dllist_not_empty(&lpa->lpa_semi_wild_socks) ||
+         ci_dllist_not_empty(&lpa->lpa_full_socks);
+}
+
+
 static void
 __oof_manager_addr_add(struct oof_manager *fm, int af, ci_addr_t laddr,
                        unsigned ifindex)
@@ -1402,6 +1422,10 @@ __oof_manager_addr_add(struct oof_manager *fm, int af, ci_addr_t laddr,
     CI_DLLIST_FOR_EACH2(struct oof_local_port, lp, lp_manager_link,
                         &fm->fm_local_ports[hash]) {
       lpa = &lp->lp_addr[la_i];
+      /* Most local ports belong only to connected sockets on other
+       * addresses, and there is nothing to install for them here. */
+      if( ! oof_local_port_addr_has_users(lp, lpa) )
+        continue;
       skf = oof_wild_socket(lp, lpa, OO_AF_FAMILY2SPACE(af));
       if( skf != NULL )
         oof_hw_filter_set(fm, skf, &lpa->lpa_filter,
@@ -1889,6 +1913,7 @@ void __oof_do_deferred_work(struct oof_manager* fm)
   unsigned hwports_up_new, hwports_down_new,
            hwports_changed, hwports_removed;
   unsigned hwports_avail_new[OOF_HWPORT_AVAIL_TAG_NUM];
+  int avail_changed = 0;
   IPF_LOG("%s:", __FUNCTION__);
 
   spin_lock_bh(&fm->fm_cplane_updates_lock);
@@ -1925,6 +1950,27 @@ void __oof_do_deferred_work(struct oof_manager* fm)
 
   spin_unlock_bh(&fm->fm_cplane_updates_lock);
 
+  /* Apply availability changes before walking the filters, so that a
+   * change of both link state and availability (as on bond failover) costs
+   * a single pass over the local ports rather than two. */
+  {
+    int tag;
+    unsigned not_available = 0;
+
+    for( tag = 0; tag < OOF_HWPORT_AVAIL_TAG_NUM; tag++ ) {
+      if( fm->fm_hwports_avail_per_tag[tag] != hwports_avail_new[tag] ) {
+        IPF_LOG("%s: tag %d: available=%x unavailable=%x", __FUNCTION__, tag,
+                hwports_avail_new[tag] &~ fm->fm_hwports_avail_per_tag[tag],
+                ~hwports_avail_new[tag] & fm->fm_hwports_avail_per_tag[tag]);
+        fm->fm_hwports_avail_per_tag[tag] = hwports_avail_new[tag];
+        not_available |= ~fm->fm_hwports_avail_per_tag[tag];
+        avail_changed = 1;
+      }
+    }
+    if( avail_changed )
+      fm->fm_hwports_available = ~not_available;
+  }
+
   if( hwports_changed ) {
     /* some ports might have changed down then up before we got here.
      * if this was in result of hotplug than we might be seeing a new interface
@@ -1946,7 +1992,9 @@ void __oof_do_deferred_work(struct oof_manager* fm)
             hwports_up_new, hwports_down_new,
             fm->fm_hwports_mcast_replicate_capable,
             fm->fm_hwports_vlan_filters);
+  }
 
+  if( hwports_changed || avail_changed ) {
     /* the ports, which went from up -> down -> up might have stale filter ids if
      * up was result of hotplug, lets remove the filters by indicating that
      * the ports are down */
@@ -1963,27 +2011,6 @@ void __oof_do_deferred_work(struct oof_manager* fm)
     }
   }
 
-  {
-    int tag;
-    unsigned not_available = 0;
-    int changed = 0;
-
-    for( tag = 0; tag < OOF_HWPORT_AVAIL_TAG_NUM; tag++ ) {
-      if( fm->fm_hwports_avail_per_tag[tag] != hwports_avail_new[tag] ) {
-        IPF_LOG("%s: tag %d: available=%x unavailable=%x", __FUNCTION__, tag,
-                hwports_avail_new[tag] &~ fm->fm_hwports_avail_per_tag[tag],
-                ~hwports_avail_new[tag] & fm->fm_hwports_avail_per_tag[tag]);
-        fm->fm_hwports_avail_per_tag[tag] = hwports_avail_new[tag];
-        not_available |= ~fm->fm_hwports_avail_per_tag[tag];
-        changed = 1;
-      }
-    }
-    if( changed ) {
-      fm->fm_hwports_available = ~not_available;
-      oof_manager_update_all_filters(fm);
-    }
-  }
-
   BUG_ON(~(fm->fm_hwports_up | fm->fm_hwports_down) &
          fm->fm_hwports_mcast_replicate_capable);
   BUG_ON(~(fm->fm_hwports_up | fm->fm_hwports_down) &
@@ -2158,6 +2185,22 @@ oof_full_socks_add_hw_filters(struct oof_manager* fm,
 }
 
 
+static int
+oof_manager_filter_pressure(struct oof_manager* fm)
+{
+  unsigned hwports = fm->fm_hwports_available & fm->fm_hwports_up;
+  int hwport;
+
+  if( oof_filter_pressure_thresh <= 0 )
+    return 0;
+  for( hwport = 0; hwport < CI_CFG_MAX_HWPORTS; ++hwport )
+    if( (hwports & (1 << hwport)) &&
+        oo_hw_filter_count(hwport) >= oof_filter_pressure_thresh )
+      return 1;
+  return 0;
+}
+
+
 static void
 oof_local_port_addr_fixup_wild(struct oof_manager* fm,
                                struct oof_local_port* lp,
@@ -2203,6 +2246,18 @@ oof_local_port_addr_fixup_wild(struct oof_manager* fm,
        */
       unshare_full_match = 0;
   }
+  if( unshare_full_match && skf == NULL &&
+      oof_manager_filter_pressure(fm) ) {
+    /* Nobody else wants the wild filter, and giving each sharer its own
+     * full-match filter is what would fill the table.  Keep sharing, and
+     * leave the demux to the software filters.
+     */
+    IPF_LOG("%s: "IPX_TRIPLE_FMT" kept for %d sharers in stack %d "
+            "(filter table pressure)", __FUNCTION__,
+            IPX_TRIPLE_ARGS(lp->lp_protocol, AF_IP(laddr), lp->lp_lport),
+            lpa->lpa_n_full_sharers, oof_cb_stack_id(lpa->lpa_filter.trs));
+    unshare_full_match = 0;
+  }
   if( unshare_full_match && lpa->lpa_n_full_sharers > thresh ) {
     /* There are lots of sockets still using this wild filter.  We choose
      * not to transfer them all to their own full-match filters, as that
@@ -5330,6 +5385,13 @@ oof_manager_dump(struct oof_manager* fm,
       ~fm->fm_hwports_available, fm->fm_hwports_mcast_update_seen,
       fm->fm_local_addr_n);
 
+  for( i = 0; i < CI_CFG_MAX_HWPORTS; ++i )
+    if( (fm->fm_hwports_up | fm->fm_hwports_down) & (1 << i) )
+      log(loga, "  hwport %d: hw_filters=%d", i, oo_hw_filter_count(i));
+  if( oof_manager_filter_pressure(fm) )
+    log(loga, "%s: filter table pressure (thresh=%d)", __FUNCTION__,
+        oof_filter_pressure_thresh);
+
   for( la_i = 0; la_i < fm->fm_local_addr_n; ++la_i ) {
     la = &fm->fm_local_addrs[la_i];
 
@@ -45,6 +45,11 @@
  */
 int oof_all_ports_required = 1;
 
+/* Number of hardware filters installed through this module on each hwport,
+ * so that the filter manager can tell when a NIC's table is filling up.
+ */
+static ci_atomic_t oo_hw_filters_n[CI_CFG_MAX_HWPORTS];
+
 
 static struct efrm_client* get_client(int hwport)
 {
@@ -84,6 +89,7 @@ static void oo_hw_filter_clear_hwport(struct oo_hw_filter* oofilter,
   if( oofilter->filter_id[hwport] >= 0 ) {
     efrm_filter_remove(get_client(hwport), oofilter->filter_id[hwport]);
     oofilter->filter_id[hwport] = -1;
+    ci_atomic_dec(&oo_hw_filters_n[hwport]);
   }
 }
 
@@ -285,6 +291,7 @@ oo_hw_filter_set_hwport(struct oo_hw_filter* oofilter, int hwport,
          *  * does not support move the move operation - we cannot leak the filter
          */
         oofilter->filter_id[hwport] = rc;
+        ci_atomic_dec(&oo_hw_filters_n[hwport]);
       }
       else {
         /* Moving filter either:
@@ -307,6 +314,8 @@ oo_hw_filter_set_hwport(struct oo_hw_filter* oofilter, int hwport,
      * storing [rc] in the [filter_id] array. */
     if( rc >= 0 || rc == -ENETDOWN ) {
       oofilter->filter_id[hwport] = rc;
+      if( rc >= 0 )
+        ci_atomic_inc(&oo_hw_filters_n[hwport]);
       rc = 0;
     }
     if( rc == 0 && oofilter->filter_id[hwport] >= 0 ) {
@@ -509,6 +518,13 @@ void oo_hw_filter_transfer(struct oo_hw_filter* oofilter_old,
 }
 
 
+int oo_hw_filter_count(int hwport)
+{
+  ci_assert((unsigned) hwport < CI_CFG_MAX_HWPORTS);
+  return ci_atomic_read(&oo_hw_filters_n[hwport]);
+}
+
+
 unsigned oo_hw_filter_hwports(struct oo_hw_filter* oofilter)
 {
   unsigned hwport_mask = 0;
@@ -105,6 +105,21 @@ static int thc_get_next_thr_name(tcp_helper_cluster_t* thc, char* name_out)
 }
 
 
+/* As thc_get_next_thr_name(), but a stack allocated for a thread that has a
+ * stack name of its own is given that name, so that the thread can find it
+ * again.  Such stacks still count against the cluster size. */
+static int thc_get_thr_name(tcp_helper_cluster_t* thc, const char* stack_name,
+                            char* name_out)
+{
+  if( stack_name == NULL || stack_name[0] == '\0' )
+    return thc_get_next_thr_name(thc, name_out);
+  if( oo_atomic_read(&thc->thc_thr_count) >= thc->thc_cluster_size )
+    return -ENOSPC;
+  snprintf(name_out, CI_CFG_STACK_NAME_LEN, "%s", stack_name);
+  return thc_is_thr_name_taken(thc, name_out) ? -EEXIST : 0;
+}
+
+
 /* If the thc has any orphan stacks, return one of them with a kernel reference.
  * Returns
  *  * -EBUSY - if a stack is being destructed (no need to kill)
@@ -836,12 +851,14 @@ static void thc_round_robin_add(tcp_helper_cluster_t*   thc,
 }
 
 
-/* Allocates a new stack in thc.
+/* Allocates a new stack in thc.  [stack_name] names the stack; if it is
+ * NULL or empty the stack gets the next free "<cluster>-c<n>" name.
  *
  * You need to oo_thr_ref_drop(OO_THR_REF_APP) the stack returned by this
  * function when done.
  */
 static int thc_alloc_thr(tcp_helper_cluster_t* thc,
+                         const char* stack_name,
                          int cluster_restart_opt,
                          int cluster_hot_restart_opt,
                          int pktbuf_memfd,
@@ -860,7 +877,7 @@ static int thc_alloc_thr(tcp_helper_cluster_t* thc,
 
   memset(&roa, 0, sizeof(roa));
 
-  if( (rc = thc_get_next_thr_name(thc, roa.in_name)) != 0 ) {
+  if( (rc = thc_get_thr_name(thc, stack_name, roa.in_name)) != 0 ) {
     /* All stack names taken i.e. cluster is full.  Based on setting
      * of cluster_restart_opt, either kill a orphan or return error. */
     if( cluster_restart_opt == 1 ) {
@@ -870,7 +887,7 @@ static int thc_alloc_thr(tcp_helper_cluster_t* thc,
        * orphan stacks. It means that all instances in cluster already
        * allocated, so proper(ENOSPC) return code should be set. */
       if( rc == 0 )
-        rc = thc_get_next_thr_name(thc, roa.in_name);
+        rc = thc_get_thr_name(thc, stack_name, roa.in_name);
       else if( rc == -ENOENT )
         rc = -ENOSPC;
 
@@ -1176,6 +1193,7 @@ static int tcp_helper_cluster_thc_flags(const ci_netif_config_opts* ni_opts)
 
 
 int tcp_helper_cluster_alloc_thr(const char* cname,
+                                 const char* stack_name,
                                  int cluster_size,
                                  int cluster_restart,
                                  int pktbuf_memfd,
@@ -1218,7 +1236,8 @@ int tcp_helper_cluster_alloc_thr(const char* cname,
     goto fail;
   }
 
-  rc = thc_alloc_thr(thc, cluster_restart, /* cluster_hot_restart_opt */ 0,
+  rc = thc_alloc_thr(thc, stack_name, cluster_restart,
+                     /* cluster_hot_restart_opt */ 0,
                      pktbuf_memfd, ni_opts, ni_flags, &thr);
 
  fail:
@@ -1521,7 +1540,7 @@ int efab_tcp_helper_reuseport_bind(ci_private_t *priv, void *arg)
     /* There's no pktbuf_memfd at hand at this point, but it's not a problem
      * because the newly created THR will get an instance of the already
      * existing hugepage allocator from THC. */
-    rc = thc_alloc_thr(thc, trb->cluster_restart_opt,
+    rc = thc_alloc_thr(thc, NULL, trb->cluster_restart_opt,
                        trb->cluster_hot_restart_opt,
                        /* pktbuf_memfd */ -1,
                        &ni->opts,
@@ -1659,6 +1678,184 @@ int tcp_helper_cluster_post_filter_add(tcp_helper_cluster_t* thc, int hwport,
 }
 
 
+#if CI_CFG_STATS_NETIF
+/* Index of the bucket in an RSS indirection table of [table_size] entries
+ * that the NIC hashes packets for connected socket [s] to.  Matches the
+ * four-tuple hash in __ci_netif_active_wild_hash(), but uses [key], the
+ * key that the cluster's RSS context was programmed with.
+ */
+static int thc_sock_rss_bucket(const u8* key, ci_sock_cmn* s, int table_size)
+{
+  ci_addr_t laddr = sock_ipx_laddr(s);
+  ci_addr_t raddr = sock_ipx_raddr(s);
+  ci_uint32 hash;
+
+#if CI_CFG_IPV6
+  if( CI_IS_ADDR_IP6(laddr) ) {
+    struct {
+      ci_ip6_addr_t raddr;
+      ci_ip6_addr_t laddr;
+      ci_uint16 rport_be16;
+      ci_uint16 lport_be16;
+    } __attribute__((packed)) data;
+    memcpy(data.raddr, raddr.ip6, sizeof(ci_ip6_addr_t));
+    memcpy(data.laddr, laddr.ip6, sizeof(ci_ip6_addr_t));
+    data.rport_be16 = sock_rport_be16(s);
+    data.lport_be16 = sock_lport_be16(s);
+    hash = ci_toeplitz_hash(key, (ci_uint8*) &data, sizeof(data));
+  }
+  else
+#endif
+  {
+    struct {
+      ci_uint32 raddr_be32;
+      ci_uint32 laddr_be32;
+      ci_uint16 rport_be16;
+      ci_uint16 lport_be16;
+    } __attribute__((packed)) data = {
+      raddr.ip4, laddr.ip4, sock_rport_be16(s), sock_lport_be16(s) };
+    hash = ci_toeplitz_hash(key, (ci_uint8*) &data, sizeof(data));
+  }
+  return hash % table_size;
+}
+
+
+/* Point one bucket of the cluster's RSS indirection table that currently
+ * spreads to [hot] at [cold] instead.  Only buckets that carry none of
+ * [hot]'s connected sockets are candidates, so that established flows stay
+ * where their state is; it is new flows hashing to the bucket that move.
+ * [hot] keeps at least one bucket.
+ */
+static int thc_rebalance_bucket(tcp_helper_cluster_t* thc,
+                                tcp_helper_resource_t* hot,
+                                tcp_helper_resource_t* cold)
+{
+  const unsigned rss_id = EFRM_RSS_MODE_ID_DEFAULT;
+  ci_netif* ni = &hot->netif;
+  struct efrm_vi_set* vi_set = NULL;
+  unsigned long* busy;
+  int table_size = 0, n_hot = 0, bucket = -1;
+  unsigned id;
+  int i, rc = 0;
+
+  ci_assert(mutex_is_locked(&thc_mutex));
+
+  for( i = 0; i < CI_CFG_MAX_HWPORTS; ++i )
+    if( thc->thc_vi_set[i] != NULL &&
+        efrm_vi_set_rss_table_size(thc->thc_vi_set[i], rss_id) > 0 ) {
+      vi_set = thc->thc_vi_set[i];
+      table_size = efrm_vi_set_rss_table_size(vi_set, rss_id);
+      break;
+    }
+  if( vi_set == NULL )
+    return -ENODEV;
+
+  busy = kcalloc(BITS_TO_LONGS(table_size), sizeof(*busy), GFP_KERNEL);
+  if( busy == NULL )
+    return -ENOMEM;
+
+  /* We do not hold [hot]'s stack lock, so this walk can miss a flow that
+   * is being set up right now.  Such a flow would have to re-establish
+   * itself on [cold]. */
+  for( id = 0; id < ni->state->n_ep_bufs; ++id ) {
+    citp_waitable_obj* wo = ID_TO_WAITABLE_OBJ(ni, id);
+    citp_waitable* w = &wo->waitable;
+    ci_sock_cmn* s = CI_CONTAINER(ci_sock_cmn, b, w);
+    if( ! CI_TCP_STATE_IS_SOCKET(w->state) ||
+        CI_IPX_ADDR_IS_ANY(sock_ipx_raddr(s)) )
+      continue;
+    __set_bit(thc_sock_rss_bucket(efrm_vi_set_rss_key(vi_set, rss_id), s,
+                                  table_size), busy);
+  }
+
+  for( i = 0; i < table_size; ++i ) {
+    if( efrm_vi_set_rss_bucket_get(vi_set, rss_id, i) !=
+        hot->thc_rss_instance )
+      continue;
+    ++n_hot;
+    if( bucket < 0 && ! test_bit(i, busy) )
+      bucket = i;
+  }
+  kfree(busy);
+  if( bucket < 0 || n_hot < 2 )
+    return -EBUSY;
+
+  /* Every hwport has its own context; keep them in step. */
+  for( i = 0; i < CI_CFG_MAX_HWPORTS && rc == 0; ++i )
+    if( thc->thc_vi_set[i] != NULL &&
+        efrm_vi_set_rss_table_size(thc->thc_vi_set[i], rss_id) > bucket )
+      rc = efrm_vi_set_rss_bucket_move(thc->thc_vi_set[i], rss_id, bucket,
+                                       cold->thc_rss_instance);
+  if( rc == 0 )
+    OO_DEBUG_TCPH(ci_log("%s: %s: bucket %d from %s to %s", __FUNCTION__,
+                         thc->thc_name, bucket, hot->name, cold->name));
+  return rc;
+}
+
+
+/* Called from the periodic timer of each stack in a cluster.  At most once
+ * a second per cluster, compare the number of receive events handled by
+ * each stack since the last look.  If the busiest stack has handled more
+ * than EF_CLUSTER_REBALANCE percent more than the quietest, move one RSS
+ * bucket from the busiest to the quietest.
+ */
+void tcp_helper_cluster_rebalance(tcp_helper_resource_t* thr)
+{
+  unsigned pct = NI_OPTS(&thr->netif).cluster_rebalance;
+  tcp_helper_resource_t* hot = NULL;
+  tcp_helper_resource_t* cold = NULL;
+  ci_uint32 hot_evs = 0, cold_evs = 0;
+  tcp_helper_cluster_t* thc;
+  ci_dllink* link;
+
+  if( pct == 0 || thr->thc == NULL )
+    return;
+  /* Not worth waiting for: another stack's timer will be along soon. */
+  if( ! mutex_trylock(&thc_mutex) )
+    return;
+  thc = thr->thc;
+  if( thc == NULL || thc->thc_cluster_size < 2 ||
+      time_before(jiffies, thc->thc_rebalance_next) )
+    goto out;
+  thc->thc_rebalance_next = jiffies + HZ;
+
+  CI_DLLIST_FOR_EACH(link, &thc->thc_thr_list) {
+    tcp_helper_resource_t* walk = CI_CONTAINER(tcp_helper_resource_t,
+                                               thc_thr_link, link);
+    ci_uint32 rx_evs = walk->netif.state->stats.rx_evs;
+    ci_uint32 evs = rx_evs - walk->thc_rebalance_rx_evs;
+
+    walk->thc_rebalance_rx_evs = rx_evs;
+    if( walk->thc_rss_instance < 0 )
+      continue;
+    if( hot == NULL || evs > hot_evs ) {
+      hot = walk;
+      hot_evs = evs;
+    }
+    if( cold == NULL || evs < cold_evs ) {
+      cold = walk;
+      cold_evs = evs;
+    }
+  }
+
+  if( hot != NULL && hot != cold &&
+      (ci_uint64) hot_evs * 100 > (ci_uint64) cold_evs * (100 + pct) ) {
+    if( thc_rebalance_bucket(thc, hot, cold) == 0 )
+      ++thc->thc_rebalance_moves;
+    else
+      ++thc->thc_rebalance_fails;
+  }
+
+ out:
+  mutex_unlock(&thc_mutex);
+}
+#else
+void tcp_helper_cluster_rebalance(tcp_helper_resource_t* thr)
+{
+}
+#endif
+
+
 /****************************************************************
 Cluster dump functions
 *****************************************************************/
@@ -1720,6 +1917,8 @@ static void thc_dump_fn(void* not_used, oo_dump_log_fn_t log, void* log_arg)
         walk->thc_name, walk->thc_cluster_size,
         ci_current_from_kuid_munged(walk->thc_keuid),
         walk->thc_flags, hwports);
+    log(log_arg, "  rebalance: moves=%u failed=%u", walk->thc_rebalance_moves,
+        walk->thc_rebalance_fails);
     thc_dump_thrs(walk, log, log_arg);
     walk = walk->thc_next;
   }
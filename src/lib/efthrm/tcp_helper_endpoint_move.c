@@ -75,6 +75,7 @@ static int efab_file_move_supported_tcp(ci_netif *ni, ci_tcp_state *ts,
       ci_ip_timer_pending(ni, &ts->rto_tid) ||
       ci_ip_timer_pending(ni, &ts->zwin_tid) ||
       ci_ip_timer_pending(ni, &ts->cork_tid) ||
+      ci_ip_timer_pending(ni, &ts->rack_tid) ||
       OO_PP_NOT_NULL(ts->pmtus) ) {
     if( do_assert ) {
       ci_assert(ci_ip_queue_is_empty(&ts->send));
@@ -84,6 +85,7 @@ static int efab_file_move_supported_tcp(ci_netif *ni, ci_tcp_state *ts,
       ci_assert(! ci_ip_timer_pending(ni, &ts->rto_tid));
       ci_assert(! ci_ip_timer_pending(ni, &ts->zwin_tid));
       ci_assert(! ci_ip_timer_pending(ni, &ts->cork_tid));
+      ci_assert(! ci_ip_timer_pending(ni, &ts->rack_tid));
       ci_assert(OO_PP_IS_NULL(ts->pmtus));
     }
     return false;
@@ -222,6 +224,10 @@ static int efab_ip_queue_copy(ci_netif *ni_to, ci_ip_pkt_queue *q_to,
   return 0;
 }
 
+/* Size of the intermediate copy of the socket state used by a move. */
+#define EFAB_FILE_MOVE_MID_SIZE \
+  CI_MAX(sizeof(ci_tcp_state), sizeof(ci_udp_state))
+
 /* Move priv file to the alien_ni stack.
  * Should be called with the locked priv stack and socket;
  * the function returns with this stack being unlocked.
@@ -229,9 +235,14 @@ static int efab_ip_queue_copy(ci_netif *ni_to, ci_ip_pkt_queue *q_to,
  * otherwise, both stacks are unlocked.
  * Original socket is always unlocked on return,
  * while on success the new_socket is kept locked.
- * Filters might be requested to be dropped in the process */
-int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
-                                  int drop_filter, oo_sp* new_sock_id)
+ * Filters might be requested to be dropped in the process.
+ * [mid_buf] is EFAB_FILE_MOVE_MID_SIZE bytes of scratch space, or NULL to
+ * allocate it here; callers moving several sockets pass one buffer to all
+ * the moves. */
+static int
+__efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
+                                int drop_filter, oo_sp* new_sock_id,
+                                void* mid_buf)
 {
   tcp_helper_resource_t *old_thr = priv->thr;
   tcp_helper_resource_t *new_thr = netif2tcp_helper_resource(alien_ni);
@@ -305,7 +316,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
   }
 
   /* Allocate an intermediate "socket" outside of everything */
-  mid_s = ci_alloc(CI_MAX(sizeof(ci_tcp_state), sizeof(ci_udp_state)));
+  mid_s = mid_buf != NULL ? mid_buf : ci_alloc(EFAB_FILE_MOVE_MID_SIZE);
   if( mid_s == NULL )
     goto fail3;
 
@@ -314,7 +325,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
                        new_thr->id, new_s->b.bufid));
 
   /* Copy TCP/UDP state */
-  memcpy(mid_s, old_s, CI_MAX(sizeof(ci_tcp_state), sizeof(ci_udp_state)));
+  memcpy(mid_s, old_s, EFAB_FILE_MOVE_MID_SIZE);
 
   /* do not copy old_s->b.bufid
    * and other fields in stack adress space */
@@ -343,6 +354,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     mid_ts->zwin_tid = new_ts->zwin_tid;
     mid_ts->kalive_tid = new_ts->kalive_tid;
     mid_ts->cork_tid = new_ts->cork_tid;
+    mid_ts->rack_tid = new_ts->rack_tid;
 #if CI_CFG_TCP_SOCK_STATS
     mid_ts->stats_tid = new_ts->stats_tid;
 #endif
@@ -369,15 +381,13 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     oo_p_dllink_init(alien_ni, link);
 #endif
 
-    /* free temporary mid_ts storage */
-    CI_FREE_OBJ(mid_ts);
   }
   else {
-    ci_udp_state *mid_us = SOCK_TO_UDP(mid_s);
-
-    *SOCK_TO_UDP(new_s) = *mid_us;
-    CI_FREE_OBJ(mid_us);
+    *SOCK_TO_UDP(new_s) = *SOCK_TO_UDP(mid_s);
   }
+  /* free temporary mid_s storage */
+  if( mid_buf == NULL )
+    ci_free(mid_s);
 
   /* Move the filter */
   old_ep = ci_trs_ep_get(old_thr, priv->sock_id);
@@ -494,6 +504,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     new_ts->dsack_start = new_ts->dsack_end = 0;
     for( i = 0; i <= CI_TCP_SACK_MAX_BLOCKS; i++ )
       new_ts->last_sack[i] = OO_PP_NULL;
+    new_ts->rob_tail_block = OO_PP_NULL;
     ci_tcp_rx_queue_drop(&old_thr->netif, old_ts, &old_ts->rob);
 
     /* Adjust netif reserved_pktbufs value because the socket is removed from
@@ -579,9 +590,18 @@ fail1_ni_unlocked:
   return rc;
 }
 
-int efab_file_move_to_alien_stack_rsop(ci_private_t *stack_priv, void *arg)
+int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
+                                  int drop_filter, oo_sp* new_sock_id)
+{
+  return __efab_file_move_to_alien_stack(priv, alien_ni, drop_filter,
+                                         new_sock_id, NULL);
+}
+
+/* Move socket [sock_fd] into the stack of [stack_priv]: the guts of
+ * onload_move_fd(). */
+static int efab_file_move_fd(ci_private_t *stack_priv,
+                             ci_fixed_descriptor_t sock_fd, void* mid_buf)
 {
-  ci_fixed_descriptor_t sock_fd = *(ci_fixed_descriptor_t *)arg;
   struct file *sock_file = fget(sock_fd);
   ci_private_t *sock_priv;
   tcp_helper_resource_t *old_thr;
@@ -630,8 +650,8 @@ int efab_file_move_to_alien_stack_rsop(ci_private_t *stack_priv, void *arg)
   if( rc != 0 )
     goto ref_get_fail;
 
-  rc = efab_file_move_to_alien_stack(sock_priv, &stack_priv->thr->netif, 0,
-                                     &new_sock_id);
+  rc = __efab_file_move_to_alien_stack(sock_priv, &stack_priv->thr->netif, 0,
+                                       &new_sock_id, mid_buf);
 
   if( rc == 0 ) {
     ci_netif_unlock(&new_thr->netif);
@@ -656,6 +676,49 @@ int efab_file_move_to_alien_stack_rsop(ci_private_t *stack_priv, void *arg)
   return rc;
 }
 
+int efab_file_move_to_alien_stack_rsop(ci_private_t *stack_priv, void *arg)
+{
+  return efab_file_move_fd(stack_priv, *(ci_fixed_descriptor_t *)arg, NULL);
+}
+
+/* onload_move_fds(): move a batch of sockets, typically ones just accepted
+ * by a dispatcher thread, into the caller's stack.  This saves a syscall
+ * and a state buffer allocation per socket over onload_move_fd().  Stops
+ * at the first socket that can't be moved, and reports its error in [rc]
+ * rather than failing the ioctl, so that [moved_n] reaches the caller. */
+int efab_file_move_fds_to_alien_stack_rsop(ci_private_t *stack_priv,
+                                           void *arg)
+{
+  oo_move_fds_t *op = arg;
+  ci_fixed_descriptor_t __user *fds = CI_USER_PTR_GET(op->fds);
+  ci_fixed_descriptor_t sock_fd;
+  void* mid_buf;
+  int i;
+
+  op->moved_n = 0;
+  op->rc = 0;
+  if( op->fds_n <= 0 )
+    return op->fds_n == 0 ? 0 : -EINVAL;
+
+  mid_buf = ci_alloc(EFAB_FILE_MOVE_MID_SIZE);
+  if( mid_buf == NULL )
+    return -ENOMEM;
+
+  for( i = 0; i < op->fds_n; ++i ) {
+    if( copy_from_user(&sock_fd, &fds[i], sizeof(sock_fd)) ) {
+      op->rc = -EFAULT;
+      break;
+    }
+    op->rc = efab_file_move_fd(stack_priv, sock_fd, mid_buf);
+    if( op->rc != 0 )
+      break;
+    ++op->moved_n;
+  }
+
+  ci_free(mid_buf);
+  return 0;
+}
+
 /* Locking policy:
  * Enterance: priv->thr->netif is assumed to be locked.
  * Exit: all stacks (the client stack and the listener's stack) are
@@ -950,11 +950,11 @@ efab_tcp_helper_pkt_wait_rsop(ci_private_t* priv, void *lock_flags)
   return efab_tcp_helper_pkt_wait(priv->thr, (int *)lock_flags);
 }
 static int
-efab_tcp_helper_more_bufs_rsop(ci_private_t* priv, void *unused)
+efab_tcp_helper_more_bufs_rsop(ci_private_t* priv, void *arg)
 {
   if (priv->thr == NULL)
     return -EINVAL;
-  return efab_tcp_helper_more_bufs(priv->thr);
+  return efab_tcp_helper_more_bufs(priv->thr, *(ci_int32*)arg);
 }
 static int
 efab_tcp_helper_more_socks_rsop(ci_private_t* priv, void *unused)
@@ -1189,6 +1189,8 @@ ioctl_kill_self(ci_private_t *priv, void *unused)
 
 #if CI_CFG_ENDPOINT_MOVE
 extern int efab_file_move_to_alien_stack_rsop(ci_private_t *priv, void *arg);
+extern int efab_file_move_fds_to_alien_stack_rsop(ci_private_t *priv,
+                                                  void *arg);
 extern int efab_tcp_loopback_connect(ci_private_t *priv, void *arg);
 extern int efab_tcp_helper_reuseport_bind(ci_private_t *priv, void *arg);
 #endif
@@ -1560,6 +1562,34 @@ static int oo_af_xdp_kick_rsop(ci_private_t *priv, void *arg)
 }
 
 
+static int oo_irq_set_core_rsop(ci_private_t *priv, void *arg)
+{
+  int core = *(ci_int32*)arg;
+  int intf_i, rc, n_set = 0, last_rc = -EOPNOTSUPP;
+
+  if( priv->thr == NULL )
+    return -EINVAL;
+  /* The ioctl runs on the caller's CPU, so this follows whichever thread
+   * is polling the stack. */
+  if( core < 0 )
+    core = raw_smp_processor_id();
+
+  OO_STACK_FOR_EACH_INTF_I(&priv->thr->netif, intf_i) {
+    rc = efrm_vi_irq_set_affinity(tcp_helper_vi(priv->thr, intf_i), core);
+    if( rc == 0 )
+      ++n_set;
+    else if( rc != -EOPNOTSUPP )
+      last_rc = rc;
+  }
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+  /* Let EF_IRQ_FOLLOW know where they are now. */
+  if( n_set > 0 )
+    priv->thr->irq_follow_core = core;
+#endif
+  return n_set > 0 ? 0 : last_rc;
+}
+
+
 /*************************************************************************
  * ATTENTION! ACHTUNG! ATENCION!                                         *
  * This table MUST be synchronised with enum of OO_OP_* operations!      *
@@ -1674,6 +1704,7 @@ oo_operations_table_t oo_operations[] = {
 #if CI_CFG_ENDPOINT_MOVE
   op(OO_IOC_TCP_LOOPBACK_CONNECT, efab_tcp_loopback_connect),
   op(OO_IOC_MOVE_FD, efab_file_move_to_alien_stack_rsop),
+  op(OO_IOC_MOVE_FDS, efab_file_move_fds_to_alien_stack_rsop),
   op(OO_IOC_EP_REUSEPORT_BIND, efab_tcp_helper_reuseport_bind),
   op(OO_IOC_CLUSTER_DUMP,      efab_cluster_dump),
 #endif
@@ -1706,6 +1737,7 @@ oo_operations_table_t oo_operations[] = {
   op(OO_IOC_EFCT_SUPERBUF_CONFIG_REFRESH,oo_efct_superbuf_config_refresh_rsop),
   op(OO_IOC_PKT_BUF_MMAP, oo_pkt_buf_map_rsop),
   op(OO_IOC_DESIGN_PARAMETERS, oo_design_parameters_rsop),
+  op(OO_IOC_IRQ_SET_CORE, oo_irq_set_core_rsop),
 
 /* Here come non contigous operations only, their position need to match
  * index according to their placeholder */
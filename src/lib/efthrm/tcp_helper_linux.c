@@ -191,6 +191,9 @@ efab_fop_poll__prime_if_needed(tcp_helper_resource_t* trs,
                             __FUNCTION__, trs->id, ep->id));
       tcp_helper_request_wakeup(trs);
       CITP_STATS_NETIF_INC(&trs->netif, muxer_primes);
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+      tcp_helper_irq_follow(trs);
+#endif
     }
   }
 }
@@ -876,26 +879,41 @@ static unsigned linux_tcp_helper_fop_poll_alien(struct file* filp,
 #ifndef EFRM_HAVE_FOP_SENDPAGE
 /* Linux >= 6.5 */
 #include <linux/splice.h>
+
+/* Maximum number of pipe buffers passed to the socket in one go by
+ * ci_splice_to_socket(). */
+#define CI_SPLICE_BVEC_MAX 16
+
+/* Send the pages of a splice.  The data is copied into packet buffers, as
+ * the stack may free or retransmit them from user level, where we cannot
+ * hold references to page-cache pages.  We do at least copy a whole batch
+ * of pages under one call to ci_tcp_sendmsg(), without allocating.
+ */
 static int
 tcp_helper_bvec_sendmsg(ci_netif* ni, ci_tcp_state* ts, struct msghdr *msg)
 {
-  int i, ret;
-  struct iovec *io = CI_ALLOC_ARRAY(typeof(*io), msg->msg_iter.nr_segs);
+  struct iovec io[CI_SPLICE_BVEC_MAX];
+  int i, ret, n = msg->msg_iter.nr_segs;
+
+  ci_assert_le(n, CI_SPLICE_BVEC_MAX);
+  if(CI_UNLIKELY( n > CI_SPLICE_BVEC_MAX ))
+    n = CI_SPLICE_BVEC_MAX;
 
-  if( io == NULL )
-    return -ENOMEM;
+  CITP_STATS_NETIF(++ni->state->stats.tcp_sendpages);
 
-  for( i = 0; i < msg->msg_iter.nr_segs; ++i ) {
+  for( i = 0; i < n; ++i ) {
     const struct bio_vec *bvec = &msg->msg_iter.bvec[i];
 
     io[i].iov_base = (char*)kmap(bvec->bv_page) + bvec->bv_offset;
     io[i].iov_len = bvec->bv_len;
   }
 
-  ret = ci_tcp_sendmsg(ni, ts, io, msg->msg_iter.nr_segs,
+  ret = ci_tcp_sendmsg(ni, ts, io, n,
                         (ts->s.b.sb_aflags & CI_SB_AFLAG_O_NONBLOCK) | msg->msg_flags,
                         CI_ADDR_SPC_KERNEL);
-  ci_free(io);
+
+  for( i = 0; i < n; ++i )
+    kunmap(msg->msg_iter.bvec[i].bv_page);
   return ret;
 }
 
@@ -948,7 +966,7 @@ static ssize_t ci_splice_to_socket(struct pipe_inode_info *pipe, struct file *ou
   struct file* os_sock;
 
 	struct socket *sock;
-	struct bio_vec bvec[16];
+	struct bio_vec bvec[CI_SPLICE_BVEC_MAX];
 	struct msghdr msg = {};
 	ssize_t ret = 0;
 	size_t spliced = 0;
@@ -1045,7 +1063,7 @@ static ssize_t ci_splice_to_socket(struct pipe_inode_info *pipe, struct file *ou
                   else {
                     /* Closed or listening.  Return epipe.  Do not send SIGPIPE,
                      * because Linux will do it for us. */
-                    return -s->tx_errno;
+                    ret = -s->tx_errno;
                   }
                 }
                 else {
@@ -12,6 +12,7 @@
 /*! \cidoxg_driver_efab */
 #include <ci/internal/transport_config_opt.h>
 #include <onload_kernel_compat.h>
+#include <linux/kthread.h>
 #include <onload/linux_onload_internal.h>
 #include <onload/linux_onload.h>
 #include <onload/linux_ip_protocols.h>
@@ -129,6 +130,13 @@ MODULE_PARM_DESC(periodic_poll_skew,
                  "Allowed time skew for periodic polls.  "
                  "Defaults to 10ms.");
 
+static int shared_poll_cpu = -1;
+module_param(shared_poll_cpu, int, S_IRUGO);
+MODULE_PARM_DESC(shared_poll_cpu,
+                 "Start a thread bound to this CPU which continuously polls "
+                 "all stacks created with EF_SHARED_POLL=1.  Defaults to -1, "
+                 "meaning no such thread.");
+
 unsigned int xdp_headroom = offsetof(ci_ip_pkt_fmt, dma_start);
 static const struct kernel_param_ops xdp_headroom_param_ops;
 module_param_cb(xdp_headroom, &xdp_headroom_param_ops, &xdp_headroom,
@@ -162,6 +170,8 @@ static void
 tcp_helper_initialize_and_start_periodic_timer(tcp_helper_resource_t*);
 static void
 tcp_helper_stop_periodic_work(tcp_helper_resource_t*);
+static void oo_shared_poller_start(void);
+static void oo_shared_poller_stop(void);
 
 static void
 tcp_helper_close_pending_endpoints(tcp_helper_resource_t*);
@@ -462,6 +472,70 @@ efab_tcp_helper_netif_lock_or_set_flags(tcp_helper_resource_t* trs,
 #endif /* CI_CFG_UL_INTERRUPT_HELPER */
 
 
+/*----------------------------------------------------------------------------
+ *
+ * Lingering named stacks (EF_STACK_LINGER)
+ *
+ * A named stack created with EF_STACK_LINGER holds an app-level reference of
+ * its own, so that it outlives its last application and the next process
+ * with the same EF_NAME attaches to it instead of creating a new stack.  The
+ * linger work checks the app-level refcount once per EF_STACK_LINGER, and
+ * drops our reference when it has found only that one twice in a row.  The
+ * stack is then destroyed in the usual way.
+ *
+ *---------------------------------------------------------------------------*/
+
+static void tcp_helper_linger_release(tcp_helper_resource_t* trs)
+{
+  if( ci_cas32u_succeed(&trs->linger_held, 1, 0) ) {
+    OO_DEBUG_TCPH(ci_log("%s: [%u] ref "OO_THR_REF_FMT, __func__, trs->id,
+                         OO_THR_REF_ARG(trs->ref)));
+    oo_thr_ref_drop(trs->ref, OO_THR_REF_APP);
+  }
+}
+
+
+static void tcp_helper_linger_work(struct work_struct* data)
+{
+  tcp_helper_resource_t* trs = container_of(data, tcp_helper_resource_t,
+                                            linger_work.work);
+
+  if( ! trs->linger_held )
+    return;
+
+  if( OO_ACCESS_ONCE(trs->ref[OO_THR_REF_APP]) == 1 ) {
+    if( trs->linger_idle ) {
+      tcp_helper_linger_release(trs);
+      return;
+    }
+    trs->linger_idle = 1;
+  }
+  else {
+    trs->linger_idle = 0;
+  }
+  queue_delayed_work(CI_GLOBAL_WORKQUEUE, &trs->linger_work,
+                     msecs_to_jiffies(NI_OPTS(&trs->netif).stack_linger));
+}
+
+
+static void tcp_helper_linger_start(tcp_helper_resource_t* trs)
+{
+  if( oo_thr_ref_get(trs->ref, OO_THR_REF_APP) != 0 )
+    return;
+  trs->linger_idle = 0;
+  trs->linger_held = 1;
+  queue_delayed_work(CI_GLOBAL_WORKQUEUE, &trs->linger_work,
+                     msecs_to_jiffies(NI_OPTS(&trs->netif).stack_linger));
+}
+
+
+static void tcp_helper_linger_stop(tcp_helper_resource_t* trs)
+{
+  cancel_delayed_work_sync(&trs->linger_work);
+  tcp_helper_linger_release(trs);
+}
+
+
 /*----------------------------------------------------------------------------
  *
  * tcp helpers table implementation
@@ -512,6 +586,13 @@ void tcp_helper_kill_stack(tcp_helper_resource_t *thr)
     ci_ip_timer_clear(netif, &netif->state->timeout_tid);
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
     ci_ip_timer_clear(netif, &netif->state->recycle_tid);
+#endif
+#if CI_CFG_STATS_NETIF
+    ci_ip_timer_clear(netif, &netif->state->stats_pub_tid);
+#endif
+    ci_ip_timer_clear(netif, &netif->state->idle_reclaim_tid);
+#if CI_CFG_IP_REASM
+    ci_ip_timer_clear(netif, &netif->state->ip_reasm_tid);
 #endif
     ci_netif_timeout_state(netif);
     ci_netif_unlock(netif);
@@ -561,6 +642,8 @@ static void thr_table_dtor(tcp_helpers_table_t *table)
       continue;
     ci_irqlock_unlock(&table->lock, &lock_flags);
 
+    tcp_helper_linger_stop(thr);
+
     if( thr->ref[OO_THR_REF_FILE] != 0 )
       ci_log("%s: ERROR: non-orphaned stack=%u ref "OO_THR_REF_FMT,
              __FUNCTION__, thr->id, OO_THR_REF_ARG(thr->ref));
@@ -1471,8 +1554,11 @@ static int allocate_vi(ci_netif* ni, struct vi_allocate_info* info,
   int i;
   size_t n_shm_rxqs;
 
-  /* Choose DMA queue sizes, and calculate suitable size for EVQ. */
+  /* Choose DMA queue sizes, and calculate suitable size for EVQ.  The EVQ of
+   * the primary VI also takes the completions of any extra transmit VIs. */
   evq_min = info->txq_capacity;
+  if( evq_virs == NULL )
+    evq_min *= ci_netif_num_tx_vis(ni);
   if( ! (info->oo_vi_flags & OO_VI_FLAGS_RX_SHARED) )
     evq_min += info->rxq_capacity;
   for( info->evq_capacity = 512; info->evq_capacity <= evq_min;
@@ -1811,6 +1897,7 @@ static int allocate_vis(tcp_helper_resource_t* trs,
 #endif
     dev = efrm_vi_get_dev(vi_rs);
     strncpy(nsn->dev_name, dev ? dev_name(dev) : "?", sizeof(nsn->dev_name));
+    nsn->numa_node = dev ? dev_to_node(dev) : -1;
     if( dev )
       put_device(dev);
     nsn->dev_name[sizeof(nsn->dev_name) - 1] = '\0';
@@ -1866,7 +1953,7 @@ static int allocate_vis(tcp_helper_resource_t* trs,
     }
 #endif
 
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
+#if CI_MAX_VIS_PER_INTF > 1
     /* The TCP plugin uses multiple VIs per intf to distinguish various types
      * of traffic.
      *  - The 'normal' VI (CI_Q_ID_NORMAL) isn't used at all by the plugin; it
@@ -1882,14 +1969,32 @@ static int allocate_vis(tcp_helper_resource_t* trs,
      *    payloads are in a structure of their own which allows some parts to
      *    be inline while other parts are pointers to remote memory which must
      *    be mem2mem-copied to get at it.
-     * All of this is discussed in detail in the design doc: SF-123622 */
-    if( NI_OPTS(ni).tcp_offload_plugin ) {
+     * All of this is discussed in detail in the design doc: SF-123622
+     *
+     * Without a plugin, EF_TX_VIS asks for extra VIs over which ordinary
+     * transmit traffic is spread.  They are never the target of a filter,
+     * so receive nothing, and they use DMA only: PIO and CTPIO stay with
+     * the primary VI. */
+    if( ci_netif_num_vis(ni) > 1 ) {
       int release_pd = alloc_info.release_pd;
       int vi_i;
       int num_vis = ci_netif_num_vis(ni);
 
+      if( ci_netif_num_tx_vis(ni) > 1 &&
+          nic->devtype.arch != EFHW_ARCH_EF10 &&
+          nic->devtype.arch != EFHW_ARCH_EF100 ) {
+        NI_LOG(ni, RESOURCE_WARNINGS,
+               "[%s]: EF_TX_VIS=%d is not supported on interface %d",
+               ns->pretty_name, ci_netif_num_tx_vis(ni), intf_i);
+        if( release_pd )
+          efrm_pd_release(alloc_info.pd); /* vi keeps a ref to pd */
+        rc = -EOPNOTSUPP;
+        goto error_out;
+      }
+
       /* The TCP plugin is a throughput-oriented feature - tweak the alloc
-       * to be the best for that */
+       * to be the best for that.  The extra transmit VIs do not use CTPIO
+       * either. */
       alloc_info.try_ctpio = false;
 
       for( vi_i = 1; vi_i < num_vis; ++vi_i) {
@@ -1969,7 +2074,7 @@ static int deferred_vis(tcp_helper_resource_t* trs)
     }
 
     /* All buffers need to be allocated before AF_XDP sockets are usable. */
-    while( (rc = efab_tcp_helper_more_bufs(trs)) == 0 );
+    while( (rc = efab_tcp_helper_more_bufs(trs, -1)) == 0 );
     if( rc != -ENOSPC )
       return rc;
   }
@@ -2010,9 +2115,11 @@ static int deferred_vis(tcp_helper_resource_t* trs)
 }
 
 
-static void vi_complete(void *completion_void)
+static void vi_complete(void *trs_void)
 {
-  complete((struct completion *)completion_void);
+  tcp_helper_resource_t* trs = trs_void;
+  if( atomic_dec_and_test(&trs->n_vis_flushing) )
+    complete(&trs->complete);
 }
 
 #if CI_CFG_NIC_RESET_SUPPORT
@@ -2078,17 +2185,24 @@ static void release_vi(tcp_helper_resource_t* trs)
 {
   int intf_i;
 
-  /* Flush vis first to ensure our bufs won't be used any more */
+  /* Flush vis first to ensure our bufs won't be used any more.  Start the
+   * flushes of all of them before waiting for any, so that they proceed in
+   * parallel rather than costing a round trip each.  The extra count held
+   * until they have all been started stops an early completion from
+   * finishing the wait. */
+  reinit_completion(&trs->complete);
+  atomic_set(&trs->n_vis_flushing, 1);
   OO_STACK_FOR_EACH_INTF_I(&trs->netif, intf_i) {
     int vi_i;
     for( vi_i = ci_netif_num_vis(&trs->netif) - 1; vi_i >= 0; --vi_i ) {
       struct efrm_vi *vi_rs = trs->nic[intf_i].thn_vi_rs[vi_i];
-      reinit_completion(&trs->complete);
-      efrm_vi_register_flush_callback(vi_rs, &vi_complete, &trs->complete);
+      atomic_inc(&trs->n_vis_flushing);
+      efrm_vi_register_flush_callback(vi_rs, &vi_complete, trs);
       efrm_vi_resource_stop_callback(vi_rs);
-      wait_for_completion(&trs->complete);
     }
   }
+  vi_complete(trs);
+  wait_for_completion(&trs->complete);
 
   /* Now do the rest of vi release */
   OO_STACK_FOR_EACH_INTF_I(&trs->netif, intf_i) {
@@ -2242,10 +2356,14 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   int no_active_wild_pools, no_active_wild_table_entries;
 #endif
   int no_seq_table_entries;
+  int no_tw_table_entries;
   unsigned vi_state_bytes;
   unsigned dma_addrs_bytes;
 #if CI_CFG_PIO
   unsigned pio_bufs_ofs = 0;
+#endif
+#if CI_CFG_TIMESTAMPING
+  ci_uint32 tx_ts_ring_size = 0;
 #endif
   ci_uint32 filter_table_size;
   ci_uint32 filter_table_ext_size;
@@ -2281,6 +2399,11 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
     no_seq_table_entries = 0;
   }
 
+  if( NI_OPTS(ni).tcp_tw_compact != 0 )
+    no_tw_table_entries = 1u << ci_log2_ge(NI_OPTS(ni).tcp_tw_compact, 1);
+  else
+    no_tw_table_entries = 0;
+
   /* pkt_sets_n should be zeroed before possible NIC reset */
   if( NI_OPTS(ni).max_packets > max_packets_per_stack ) {
     OO_DEBUG_ERR(ci_log("WARNING: EF_MAX_PACKETS reduced from %d to %d due to "
@@ -2358,8 +2481,16 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
 #endif
   sz = CI_ROUND_UP(sz, __alignof__(ci_tcp_prev_seq_t));
   sz += sizeof(ci_tcp_prev_seq_t) * no_seq_table_entries;
+  sz = CI_ROUND_UP(sz, __alignof__(ci_tcp_tw_compact_t));
+  sz += sizeof(ci_tcp_tw_compact_t) * no_tw_table_entries;
   sz = CI_ROUND_UP(sz, __alignof__(struct oo_deferred_pkt));
   sz += sizeof(struct oo_deferred_pkt) * NI_OPTS(ni).defer_arp_pkts;
+#if CI_CFG_TIMESTAMPING
+  if( NI_OPTS(ni).tx_ts_ring != 0 )
+    tx_ts_ring_size = 1u << ci_log2_ge(NI_OPTS(ni).tx_ts_ring, 0);
+  sz = CI_ROUND_UP(sz, CI_CACHE_LINE_SIZE);
+  sz += sizeof(ci_tx_ts_rec) * tx_ts_ring_size;
+#endif
   sz = CI_ROUND_UP(sz, __alignof__(ci_netif_filter_table));
   sz += filter_table_size;
   sz = CI_ROUND_UP(sz, __alignof__(ci_netif_filter_table_entry_ext));
@@ -2404,7 +2535,8 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
    * for the sockets).  These pages get zeroed, so all fields in the shared
    * state can be assumed to have been zero-initialised. */
   rc = oo_shmbuf_alloc(&ni->shmbuf, OO_SHARED_BUFFER_CHUNK_ORDER, i,
-                       sz / OO_SHARED_BUFFER_CHUNK_SIZE);
+                       sz / OO_SHARED_BUFFER_CHUNK_SIZE,
+                       NI_OPTS(ni).state_huge_pages);
   if( rc < 0 ) {
     OO_DEBUG_ERR(ci_log("%s: failed to alloc shmbuf for shared state and "
                         "socket buffers (%d)", __FUNCTION__, rc));
@@ -2471,10 +2603,22 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ns->seq_table_entries_n = no_seq_table_entries;
   ns_ofs += sizeof(ci_tcp_prev_seq_t) * ns->seq_table_entries_n;
 
+  ns_ofs = CI_ROUND_UP(ns_ofs, __alignof__(ci_tcp_tw_compact_t));
+  ns->tw_table_ofs = ns_ofs;
+  ns->tw_table_entries_n = no_tw_table_entries;
+  ns_ofs += sizeof(ci_tcp_tw_compact_t) * ns->tw_table_entries_n;
+
   ns_ofs = CI_ROUND_UP(ns_ofs, __alignof__(struct oo_deferred_pkt));
   ns->deferred_pkts_ofs = ns_ofs;
   ns_ofs += sizeof(struct oo_deferred_pkt) * NI_OPTS(ni).defer_arp_pkts;
 
+#if CI_CFG_TIMESTAMPING
+  ns_ofs = CI_ROUND_UP(ns_ofs, CI_CACHE_LINE_SIZE);
+  ns->tx_ts_ring_ofs = ns_ofs;
+  ns->tx_ts_ring_size = tx_ts_ring_size;
+  ns_ofs += sizeof(ci_tx_ts_rec) * tx_ts_ring_size;
+#endif
+
   ns_ofs = CI_ROUND_UP(ns_ofs, __alignof__(ci_netif_filter_table));
   ns->table_ofs = ns_ofs;
   ns_ofs += filter_table_size;
@@ -2511,7 +2655,14 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ni->active_wild_table = (void*) ((char*) ns + ns->active_wild_ofs);
 #endif
   ni->seq_table = (void*) ((char*) ns + ns->seq_table_ofs);
+  ni->tw_table = (void*) ((char*) ns + ns->tw_table_ofs);
   ni->deferred_pkts = (void*) ((char*) ns + ns->deferred_pkts_ofs);
+#if CI_CFG_TIMESTAMPING
+  if( tx_ts_ring_size != 0 ) {
+    ni->tx_ts_ring = (void*) ((char*) ns + ns->tx_ts_ring_ofs);
+    ni->tx_ts_ring_mask = tx_ts_ring_size - 1;
+  }
+#endif
   ni->filter_table = (void*) ((char*) ns + ns->table_ofs);
   ni->filter_table_ext = (void*) ((char*) ns + ns->table_ext_ofs);
 
@@ -2534,6 +2685,9 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ni->packets->sets_max = ni->pkt_sets_max;
   ni->packets->sets_n = 0;
   ni->packets->n_pkts_allocated = 0;
+  /* Until efab_tcp_helper_more_bufs() fills a set, its node is unknown. */
+  for( i = 0; i < ni->pkt_sets_max; ++i )
+    ni->packets->set[i].numa_node = -1;
 
   /* Initialize the free list of synrecv/aux bufs */
   oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ni->state->free_aux_mem));
@@ -2543,6 +2697,8 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
   ns->max_aux_bufs[CI_TCP_AUX_TYPE_BUCKET] = ni->opts.max_ep_bufs;
   ns->max_aux_bufs[CI_TCP_AUX_TYPE_EPOLL] = ni->opts.max_ep_bufs;
   ns->max_aux_bufs[CI_TCP_AUX_TYPE_PMTUS] = ni->opts.max_ep_bufs;
+  ns->max_aux_bufs[CI_TCP_AUX_TYPE_CONG] = ni->opts.max_ep_bufs;
+  ns->max_aux_bufs[CI_TCP_AUX_TYPE_FLIGHT] = ni->opts.max_ep_bufs;
 
   /* The shared netif-state buffer and EP buffers are part of the mem mmap */
   trs->mem_mmap_bytes += ns->netif_mmap_bytes;
@@ -3470,7 +3626,9 @@ tcp_helper_rm_alloc_proxy(ci_resource_onload_alloc_t* alloc,
      */
     ci_uint16 in_flags =
       alloc->in_flags & ~CI_NETIF_FLAG_DO_ALLOCATE_SCALABLE_FILTERS_RSS;
+    alloc->in_stack_name[CI_CFG_STACK_NAME_LEN] = '\0';
     rc = tcp_helper_cluster_alloc_thr(alloc->in_name,
+                                      alloc->in_stack_name,
                                       alloc->in_cluster_size,
                                       alloc->in_cluster_restart,
                                       alloc->in_pktbuf_memfd,
@@ -4510,8 +4668,11 @@ int tcp_helper_rm_alloc(ci_resource_onload_alloc_t* alloc,
   INIT_WORK(&rs->work_item_dtor, tcp_helper_destroy_work);
   INIT_WORK(&rs->non_atomic_work, tcp_helper_do_non_atomic);
   ci_sllist_init(&rs->non_atomic_list);
+  INIT_WORK(&rs->irq_follow_work, tcp_helper_irq_follow_work);
   ci_sllist_init(&rs->ep_tobe_closed);
 #endif
+  INIT_DELAYED_WORK(&rs->linger_work, tcp_helper_linger_work);
+  rs->linger_held = 0;
   ci_irqlock_ctor(&rs->lock);
   init_completion(&rs->complete);
 #if CI_CFG_HANDLE_ICMP
@@ -4543,6 +4704,18 @@ int tcp_helper_rm_alloc(ci_resource_onload_alloc_t* alloc,
   if( rs->periodic_timer_cpu < 0 )
     rs->periodic_timer_cpu = WORK_CPU_UNBOUND;
 
+  /* The interrupts start on this core: see get_vi_settings(). */
+  rs->irq_follow_core = raw_smp_processor_id();
+  rs->irq_follow_cand = -1;
+  rs->irq_follow_hits = 0;
+  rs->irq_follow_last = jiffies -
+                        msecs_to_jiffies(NI_OPTS(ni).irq_follow_interval);
+  /* An explicitly placed interrupt is never moved. */
+  if( NI_OPTS(ni).irq_core >= 0 || NI_OPTS(ni).irq_channel >= 0 )
+    rs->irq_follow_moves = NI_OPTS(ni).irq_follow_max;
+  else
+    rs->irq_follow_moves = 0;
+
   /* "onload-wq:pretty_name workqueue for non-atomic works */
   snprintf(rs->wq_name, sizeof(rs->wq_name), ONLOAD_WQ_NAME,
            ni->state->pretty_name);
@@ -4825,6 +4998,10 @@ int tcp_helper_rm_alloc(ci_resource_onload_alloc_t* alloc,
 
   efab_notify_stacklist_change(rs);
 
+  /* Clustered stacks have their own restart semantics. */
+  if( NI_OPTS(ni).stack_linger && alloc->in_name[0] && thc == NULL )
+    tcp_helper_linger_start(rs);
+
   alloc->out_netif_mmap_bytes = rs->mem_mmap_bytes;
   alloc->out_nic_set = ni->nic_set;
   *rs_out = rs;
@@ -4975,8 +5152,7 @@ thr_reset_stack_tx_cb_state_init(struct thr_reset_stack_tx_cb_state* cb_state,
 {
   cb_state->intf_i = intf_i;
   cb_state->thr = thr;
-  cb_state->ps.tx_pkt_free_list_insert = &cb_state->ps.tx_pkt_free_list;
-  cb_state->ps.tx_pkt_free_list_n = 0;
+  ci_netif_poll_state_init(&cb_state->ps);
 }
 
 static void thr_reset_stack_tx_cb(ef_request_id id, void* arg)
@@ -5037,8 +5213,11 @@ static void tcp_helper_purge_txq_locked(tcp_helper_resource_t* thr)
       if( nic->resetting & NIC_RESETTING_FLAG_UNPLUGGED ) {
         struct thr_reset_stack_tx_cb_state cb_state;
         ef_vi* vi = ci_netif_vi(ni, intf_i);
+        int vi_i;
         thr_reset_stack_tx_cb_state_init(&cb_state, thr, intf_i);
-        ef_vi_txq_reinit(vi, thr_reset_stack_tx_cb, &cb_state);
+        for( vi_i = 0; vi_i < ci_netif_num_vis(ni); ++vi_i )
+          ef_vi_txq_reinit(&ni->nic_hw[intf_i].vis[vi_i],
+                           thr_reset_stack_tx_cb, &cb_state);
         /* Purge the eventq as well, to get rid of any references to TX
          * descriptors that we just purged. */
         ef_vi_evq_reinit(vi);
@@ -5077,7 +5256,7 @@ static void tcp_helper_reset_stack_locked(tcp_helper_resource_t* thr)
 {
   ci_irqlock_state_t lock_flags;
   unsigned intfs_to_reset;
-  int intf_i, i, pkt_sets_n;
+  int intf_i, i, vi_i, pkt_sets_n;
   ci_netif* ni = &thr->netif;
   ef_vi* vi;
   struct thr_reset_stack_tx_cb_state cb_state;
@@ -5202,15 +5381,24 @@ static void tcp_helper_reset_stack_locked(tcp_helper_resource_t* thr)
 
       thr_reset_stack_tx_cb_state_init(&cb_state, thr, intf_i);
       ef_vi_txq_reinit(vi, thr_reset_stack_tx_cb, &cb_state);
+      for( vi_i = 1; vi_i < ci_netif_num_tx_vis(ni); ++vi_i )
+        ef_vi_txq_reinit(&ni->nic_hw[intf_i].vis[vi_i],
+                         thr_reset_stack_tx_cb, &cb_state);
 
       /* Reset hw queues.  This must be done after resetting the sw
          queues as the hw will start delivering events after being reset.  If
          we failed to map packet buffers, we don't bring the hw queues back up
          to ensure that we don't attempt to DMA to an invalid address. */
-      if( ~nsn->nic_error_flags & CI_NETIF_NIC_ERROR_REMAP )
+      if( ~nsn->nic_error_flags & CI_NETIF_NIC_ERROR_REMAP ) {
         efrm_vi_qs_reinit(tcp_helper_vi(thr, intf_i));
-      else
+        for( vi_i = 1; vi_i < ci_netif_num_tx_vis(ni); ++vi_i )
+          efrm_vi_qs_reinit(thr->nic[intf_i].thn_vi_rs[vi_i]);
+      }
+      else {
         efrm_vi_resource_mark_shut_down(tcp_helper_vi(thr, intf_i));
+        for( vi_i = 1; vi_i < ci_netif_num_tx_vis(ni); ++vi_i )
+          efrm_vi_resource_mark_shut_down(thr->nic[intf_i].thn_vi_rs[vi_i]);
+      }
 
       if( cb_state.ps.tx_pkt_free_list_n )
         ci_netif_poll_free_pkts(ni, &cb_state.ps);
@@ -5728,6 +5916,8 @@ efab_tcp_helper_rm_free_locked(tcp_helper_resource_t* trs)
    *  \TODO: for now just clear in_poll flag
    */
   netif->state->in_poll = 0;
+  netif->state->tx_coalesce_active = 0;
+  netif->state->ack_batch_active = 0;
 
   /* If netif is wedged then for now instead of getting netif in
    * a valid state we instead try never to touch it again.  For most of our
@@ -6072,6 +6262,10 @@ efab_tcp_driver_ctor()
 
   efab_tcp_driver.load_numa_node = numa_node_id();
 
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+  oo_shared_poller_start();
+#endif
+
   return 0;
 
 fail_timesync:
@@ -6097,6 +6291,10 @@ efab_tcp_driver_stop(void)
 {
   OO_DEBUG_TCPH(ci_log("%s: kill stacks", __FUNCTION__));
 
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+  oo_shared_poller_stop();
+#endif
+
   thr_table_dtor(&efab_tcp_driver.thr_table);
 
   flush_workqueue(CI_GLOBAL_WORKQUEUE);
@@ -6217,6 +6415,8 @@ int efab_tcp_helper_more_socks(tcp_helper_resource_t* trs)
     OO_DEBUG_ERR(ci_log("%s: demand failed (%d)", __FUNCTION__, rc));
     return rc;
   }
+  ni->state->sock_buf_chunks = ni->shmbuf.num - ni->shmbuf.init_num;
+  ni->state->sock_buf_huge_chunks = ni->shmbuf.n_contig;
 
   return install_socks(trs, ni->ep_tbl_n,
                        EP_BUF_PER_PAGE << OO_SHARED_BUFFER_CHUNK_ORDER);
@@ -6327,6 +6527,7 @@ efab_tcp_helper_min_nics_order(tcp_helper_resource_t* trs)
 
 static int
 efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs,
+                               int numa_node,
                                struct oo_iobufset** all_out,
                                struct oo_buffer_pages** pages_out,
                                uint64_t* hw_addrs,
@@ -6376,7 +6577,7 @@ efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs,
   }
 #endif
   rc = oo_iobufset_pages_alloc(HW_PAGES_PER_SET_S, min_nics_order, &flags,
-                               &pages, trs->thc_pktbuf_alloc);
+                               numa_node, &pages, trs->thc_pktbuf_alloc);
   if( rc != 0 )
     return rc;
 #if CI_CFG_PKTS_AS_HUGE_PAGES
@@ -6705,8 +6906,24 @@ void efab_tcp_helper_unmap_usermem(tcp_helper_resource_t* trs,
 }
 
 
+/* Returns the node on which to allocate a new packet set, or NUMA_NO_NODE
+ * to allocate wherever the caller is running. */
+static int
+efab_tcp_helper_pkt_set_numa_node(tcp_helper_resource_t* trs, int rx_intf_i)
+{
+  ci_netif* ni = &trs->netif;
+  int node = -1;
+
+  if( NI_OPTS(ni).pkt_numa == 0 )
+    return NUMA_NO_NODE;
+  if( rx_intf_i >= 0 && rx_intf_i < oo_stack_intf_max(ni) )
+    node = ni->state->nic[rx_intf_i].numa_node;
+  return node >= 0 ? node : numa_node_id();
+}
+
+
 int
-efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
+efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs, int rx_intf_i)
 {
   struct oo_iobufset* iobrs[CI_CFG_MAX_INTERFACES];
   struct oo_buffer_pages* pages;
@@ -6716,7 +6933,7 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
   uint64_t *hw_addrs;
   ci_irqlock_state_t lock_flags;
   ci_netif* ni = &trs->netif;
-  int i, rc, bufset_id, intf_i, page_order;
+  int i, rc, bufset_id, intf_i, page_order, numa_node, actual_node;
 
   ci_assert(ci_netif_is_locked(ni));
 
@@ -6739,7 +6956,8 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
     return -ENOMEM;
   }
 
-  rc = efab_tcp_helper_iobufset_alloc(trs, iobrs, &pages, hw_addrs,
+  numa_node = efab_tcp_helper_pkt_set_numa_node(trs, rx_intf_i);
+  rc = efab_tcp_helper_iobufset_alloc(trs, numa_node, iobrs, &pages, hw_addrs,
                                       &page_order);
   if(CI_UNLIKELY( rc < 0 )) {
     /* With highly fragmented memory, iobufset_alloc may fail in
@@ -6820,6 +7038,10 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
   else
     page_order += ci_log2_ge(PAGE_SIZE / CI_CFG_PKT_BUF_SIZE, 0);
   ni->packets->set[bufset_id].page_order = page_order;
+  actual_node = page_to_nid(pages->pages[0]);
+  ni->packets->set[bufset_id].numa_node = actual_node;
+  if( numa_node != NUMA_NO_NODE && actual_node != numa_node )
+    CITP_STATS_NETIF_INC(ni, pkt_set_alloc_numa_remote);
   ni->dma_addr_next += (PKTS_PER_SET >> page_order) * CI_CFG_MAX_INTERFACES;
   ni->packets->n_free += PKTS_PER_SET;
 
@@ -6847,7 +7069,7 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
   }
   ci_vfree(hw_addrs);
 
-  trs->netif.state->packet_alloc_numa_nodes |= 1 << numa_node_id();
+  trs->netif.state->packet_alloc_numa_nodes |= 1 << actual_node;
   CHECK_FREEPKTS(ni);
   return 0;
 }
@@ -7320,6 +7542,71 @@ tcp_helper_request_timer(tcp_helper_resource_t* trs)
   }
 }
 
+
+static void tcp_helper_irq_follow_work(struct work_struct* data)
+{
+  tcp_helper_resource_t* trs = container_of(data, tcp_helper_resource_t,
+                                            irq_follow_work);
+  int core = trs->irq_follow_cand;
+  int intf_i, rc, n_set = 0, n_unsupported = 0;
+
+  if( core == trs->irq_follow_core || ! cpu_online(core) )
+    return;
+
+  OO_STACK_FOR_EACH_INTF_I(&trs->netif, intf_i) {
+    rc = efrm_vi_irq_set_affinity(tcp_helper_vi(trs, intf_i), core);
+    if( rc == 0 )
+      ++n_set;
+    else if( rc == -EOPNOTSUPP )
+      ++n_unsupported;
+  }
+
+  if( n_set == 0 && n_unsupported > 0 ) {
+    /* No interface can be moved: don't try again. */
+    trs->irq_follow_moves = NI_OPTS(&trs->netif).irq_follow_max;
+    return;
+  }
+  if( n_set > 0 ) {
+    trs->irq_follow_core = core;
+    ++trs->irq_follow_moves;
+    CITP_STATS_NETIF_INC(&trs->netif, irq_follow_moves);
+  }
+}
+
+
+/* Called by a thread that is about to block waiting for one of the stack's
+ * sockets.  Once EF_IRQ_FOLLOW consecutive sleepers have been on the same
+ * core, other than the one the interrupts go to, the interrupts are moved
+ * there from the workqueue.  [irq_follow_last] is stamped when the move is
+ * queued, so the interval holds whether or not it succeeds. */
+void tcp_helper_irq_follow_sleeper(tcp_helper_resource_t* trs)
+{
+  ci_netif* ni = &trs->netif;
+  int cpu = raw_smp_processor_id();
+
+  if( cpu == trs->irq_follow_core ) {
+    trs->irq_follow_hits = 0;
+    return;
+  }
+  if( cpu != trs->irq_follow_cand ) {
+    trs->irq_follow_cand = cpu;
+    trs->irq_follow_hits = 1;
+  }
+  else {
+    ++trs->irq_follow_hits;
+  }
+
+  if( trs->irq_follow_hits < NI_OPTS(ni).irq_follow ||
+      trs->irq_follow_moves >= NI_OPTS(ni).irq_follow_max ||
+      time_before(jiffies, trs->irq_follow_last +
+                  msecs_to_jiffies(NI_OPTS(ni).irq_follow_interval)) )
+    return;
+
+  trs->irq_follow_hits = 0;
+  trs->irq_follow_last = jiffies;
+  queue_work(trs->wq, &trs->irq_follow_work);
+}
+
 static void
 ci_netif_collect_periodic_metrics(ci_netif* ni)
 {
@@ -7371,6 +7658,11 @@ linux_tcp_timer_do(tcp_helper_resource_t* rs, unsigned long* next_timer)
     }
     ci_netif_collect_periodic_metrics(ni);
   }
+
+#if CI_CFG_ENDPOINT_MOVE
+  if( rs->thc != NULL )
+    tcp_helper_cluster_rebalance(rs);
+#endif
 }
 
 static void
@@ -7403,6 +7695,81 @@ tcp_helper_initialize_and_start_periodic_timer(tcp_helper_resource_t* rs)
 }
 
 
+
+/* The shared poller polls, in turn, every stack that asked for it with
+ * EF_SHARED_POLL.  It is meant to have a core to itself, so it does not
+ * sleep while any such stack exists; it just yields to anything else
+ * runnable on its CPU between passes.
+ */
+static int oo_shared_poller(void* arg)
+{
+  while( ! kthread_should_stop() ) {
+    ci_netif* ni = NULL;
+    int n_stacks = 0;
+
+    while( iterate_netifs_unlocked(&ni, OO_THR_REF_BASE,
+                                   OO_THR_REF_INFTY) == 0 ) {
+      tcp_helper_resource_t* trs = netif2tcp_helper_resource(ni);
+      int rc;
+
+      if( ! NI_OPTS(ni).shared_poll )
+        continue;
+      ++n_stacks;
+      if( ! ci_netif_has_event(ni) )
+        continue;
+      if( efab_tcp_helper_netif_try_lock(trs, 0) ) {
+        rc = ci_netif_poll(ni);
+        oo_inject_packets_kernel_force(ni);
+        efab_tcp_helper_netif_unlock(trs, 0);
+        CITP_STATS_NETIF_INC(ni, shared_polls);
+        if( rc > 0 )
+          CITP_STATS_NETIF_ADD(ni, shared_poll_evs, rc);
+      }
+      else {
+        CITP_STATS_NETIF_INC(ni, shared_poll_lock_contends);
+      }
+    }
+
+    if( n_stacks == 0 )
+      msleep_interruptible(10);
+    else
+      cond_resched();
+  }
+  return 0;
+}
+
+static void oo_shared_poller_start(void)
+{
+  struct task_struct* task;
+
+  if( shared_poll_cpu < 0 )
+    return;
+  if( shared_poll_cpu >= nr_cpu_ids || ! cpu_online(shared_poll_cpu) ) {
+    ci_log("%s: shared_poll_cpu=%d is not an online CPU; not starting "
+           "the shared poller", __FUNCTION__, shared_poll_cpu);
+    return;
+  }
+
+  task = kthread_create(oo_shared_poller, NULL, "onload-poll/%d",
+                        shared_poll_cpu);
+  if( IS_ERR(task) ) {
+    ci_log("%s: failed to start the shared poller (%ld)", __FUNCTION__,
+           PTR_ERR(task));
+    return;
+  }
+  kthread_bind(task, shared_poll_cpu);
+  efab_tcp_driver.shared_poller = task;
+  wake_up_process(task);
+}
+
+static void oo_shared_poller_stop(void)
+{
+  if( efab_tcp_driver.shared_poller != NULL ) {
+    kthread_stop(efab_tcp_driver.shared_poller);
+    efab_tcp_driver.shared_poller = NULL;
+  }
+}
+
 /* This function is used when stopping a stack, and also on error paths when
  * creating a stack fails.  The workqueue and the purge_txq_work work item
  * must be initialised, but the periodic timer need not be initialised. */
@@ -8044,7 +8411,7 @@ efab_tcp_helper_netif_lock_callback(eplock_helper_t* epl, ci_uint64 lock_val,
         (!orphaned && oo_want_proactive_packet_allocation(ni)) ) {
       OO_DEBUG_TCPH(ci_log("%s: [%u] NEED_PKT_SET now",
                            __FUNCTION__, thr->id));
-      efab_tcp_helper_more_bufs(thr);
+      efab_tcp_helper_more_bufs(thr, -1);
       flags_set &=~ CI_EPLOCK_NETIF_NEED_PKT_SET;
     }
 
@@ -8319,29 +8686,49 @@ efab_tcp_helper_vi_stats_query(tcp_helper_resource_t* trs, unsigned int intf_i,
 
 
 #if CI_CFG_INJECT_PACKETS
-static int oo_inject_packet_kernel(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+/* Returns the net device to inject [pkt] to, with a reference held.  The
+ * device found for the previous packet of the batch is kept in [*dev], and
+ * is reused if [pkt] arrived on the same port, which is the common case.
+ */
+static struct net_device*
+oo_inject_packet_dev(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                     struct net_device** dev, ci_hwport_id_t* dev_hwport)
 {
-  struct net_device* dev;
-  struct sk_buff* skb;
   ci_hwport_id_t hwport;
-  ci_ip_pkt_fmt* frag;
-  ci_uint32 pay_len;
-  int len;
 
   if( pkt->intf_i < 0 || pkt->intf_i >= CI_CFG_MAX_INTERFACES ) {
     /* We should have checked this before adding the packet to the list. */
     ci_assert(0);
-    return -ENODEV;
+    return NULL;
   }
 
   hwport = ni->state->intf_i_to_hwport[pkt->intf_i];
-
-  dev = efhw_nic_get_net_dev(efrm_client_get_nic(oo_nics[hwport].efrm_client));
-  if( dev == NULL ) {
+  if( *dev != NULL && *dev_hwport == hwport )
+    return *dev;
+
+  if( *dev != NULL )
+    dev_put(*dev);
+  *dev = efhw_nic_get_net_dev(efrm_client_get_nic(oo_nics[hwport].efrm_client));
+  *dev_hwport = hwport;
+  if( *dev == NULL ) {
     /* There is a race against unplugging */
     CITP_STATS_NETIF_INC(ni, no_match_bad_netdev);
-    return -ENODEV;
   }
+  return *dev;
+}
+
+
+/* Copies [pkt] into an skb and queues it to the kernel's backlog.  The
+ * caller has bottom halves disabled, so the kernel processes the whole
+ * batch in one go when they are re-enabled.
+ */
+static int oo_inject_packet_kernel(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                   struct net_device* dev)
+{
+  struct sk_buff* skb;
+  ci_ip_pkt_fmt* frag;
+  ci_uint32 pay_len;
+  int len;
 
   /* Allocate an skb for the kernel's consumption. */
   /* pkt is in the shared memory and may be modified from UL.  So we store
@@ -8351,7 +8738,6 @@ static int oo_inject_packet_kernel(ci_netif* ni, ci_ip_pkt_fmt* pkt)
   skb = netdev_alloc_skb(dev, pay_len);
   if( skb == NULL ) {
     CITP_STATS_NETIF_INC(ni, no_match_oom);
-    dev_put(dev);
     return -ENOMEM;
   }
   skb_put(skb, pay_len);
@@ -8384,17 +8770,16 @@ static int oo_inject_packet_kernel(ci_netif* ni, ci_ip_pkt_fmt* pkt)
   /* Infer the protocol from the Ethernet payload. */
   skb->protocol = eth_type_trans(skb, dev);
 
-  /* Inject the skb into the kernel.  The return value indicates whether the
-   * kernel decided to drop the packet, but we don't need to check that. */
-  ci_netif_rx_non_irq(skb);
-
-  dev_put(dev);
+  /* Queue the skb to the kernel's network stack.  The return value
+   * indicates whether the kernel decided to drop the packet, but we don't
+   * need to check that.  netif_rx() only raises the softirq; it runs when
+   * the caller re-enables bottom halves. */
+  netif_rx(skb);
   return 0;
 
 corrupted:
   CITP_STATS_NETIF_INC(ni, no_match_corrupted);
   kfree_skb(skb);
-  dev_put(dev);
   return -EINVAL;
 }
 
@@ -8414,21 +8799,30 @@ static void oo_inject_packets_work(struct work_struct* work)
   struct oo_inject_packets_work_data* data =
             container_of(work, struct oo_inject_packets_work_data, work);
   ci_netif* ni = &data->trs->netif;
+  struct net_device* dev = NULL;
+  ci_hwport_id_t dev_hwport = 0;
   ci_ip_pkt_fmt* pkt;
   int netif_is_locked;
   unsigned n;
 
-  /* Part one: inject all packets to the kernel without stack lock. */
+  /* Part one: inject all packets to the kernel without stack lock.  The
+   * whole batch is queued with bottom halves disabled, so that the kernel
+   * handles it in one softirq run rather than one per packet. */
+  local_bh_disable();
   for( pkt = PKT_CHK(ni, data->pkt_head), n = 0;
        n < data->n_pkts;
        pkt = PKT_CHK(ni, pkt->next), n++ ) {
     /* No need to check the return value here.  If the function fails, the
      * packet is dropped, and a counter is incremented. */
-    oo_inject_packet_kernel(ni, pkt);
+    if( oo_inject_packet_dev(ni, pkt, &dev, &dev_hwport) != NULL )
+      oo_inject_packet_kernel(ni, pkt, dev);
 
     if( OO_PP_IS_NULL(pkt->next) )
       break;
   }
+  local_bh_enable();
+  if( dev != NULL )
+    dev_put(dev);
 
   /* If the packet list was not corrupted, then we break from the above
    * loop just before n becomes equal to data->n_pkts. */
@@ -128,6 +128,8 @@ efab_tcp_helper_sock_sleep(tcp_helper_resource_t* trs,
     tcp_helper_request_wakeup(trs);
 #if ! CI_CFG_UL_INTERRUPT_HELPER
     tcp_helper_request_timer(trs);
+    if( op->why & CI_SB_FLAG_WAKE_RX )
+      tcp_helper_irq_follow(trs);
 #endif
     ci_frc64(&ni->state->last_sleep_frc);
   }
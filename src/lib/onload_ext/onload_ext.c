@@ -16,6 +16,7 @@
 #include <onload/extensions.h>
 #include <onload/extensions_zc.h>
 #include <onload/extensions_zc_hlrx.h>
+#include <onload/extensions_ring.h>
 
 unsigned int onload_ext_version[] = 
   {ONLOAD_EXT_VERSION_MAJOR,
@@ -122,6 +123,24 @@ int onload_zc_unregister_buffers(int fd, onload_zc_handle handle, int flags)
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_zc_shm_create(int fd, uint64_t len, int* id_out, void** addr_out)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_zc_shm_list(int fd, int* ids, int* n_in_out)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_zc_shm_map(int fd, int id, uint64_t len, void** addr_out)
+{
+  return -ENOSYS;
+}
+
 __attribute__((weak))
 int onload_zc_query_rx_memregs(int fd, struct onload_zc_iovec* iov,
                                int* iovecs_len, int flags)
@@ -147,12 +166,24 @@ int onload_zc_recv(int fd, struct onload_zc_recv_args* args)
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_zc_recv_mmsg(struct onload_zc_recv_mmsg* msgs, int mlen)
+{
+  return -ENOSYS;
+}
+
 __attribute__((weak))
 int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 {
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_zc_forward(int in_fd, int out_fd, int flags)
+{
+  return -ENOSYS;
+}
+
 /**************************************************************************/
 
 __attribute__((weak))
@@ -182,6 +213,13 @@ int onload_zc_hlrx_buffer_release(int fd, onload_zc_handle buf)
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_zc_hlrx_buffer_release_batch(int fd, const onload_zc_handle* bufs,
+                                        int n_bufs)
+{
+  return -ENOSYS;
+}
+
 __attribute__((weak))
 ssize_t onload_zc_hlrx_recv_copy(struct onload_zc_hlrx* hlrx,
                                  struct msghdr* msg, int flags)
@@ -208,6 +246,40 @@ onload_zc_hlrx_recv_oob(struct onload_zc_hlrx* hlrx,
 
 /**************************************************************************/
 
+__attribute__((weak))
+int onload_ring_alloc(unsigned entries, int flags,
+                      struct onload_ring** ring_out)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_ring_free(struct onload_ring* ring)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+struct onload_ring_sqe* onload_ring_get_sqe(struct onload_ring* ring)
+{
+  return NULL;
+}
+
+__attribute__((weak))
+int onload_ring_submit(struct onload_ring* ring)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_ring_reap(struct onload_ring* ring,
+                     struct onload_ring_cqe* cqes, int max)
+{
+  return -ENOSYS;
+}
+
+/**************************************************************************/
+
 __attribute__((weak))
 int onload_msg_template_alloc(int fd, const struct iovec* initial_msg,
                               int mlen, onload_template_handle* handle,
@@ -225,6 +297,14 @@ onload_msg_template_update(int fd, onload_template_handle handle,
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int
+onload_msg_template_update_batch(struct onload_template_msg_update_batch* batch,
+                                 int n, unsigned flags)
+{
+  return -ENOSYS;
+}
+
 __attribute__((weak))
 int onload_msg_template_abort(int fd, onload_template_handle handle)
 {
@@ -280,6 +360,28 @@ int onload_move_fd(int fd)
   return 0;
 }
 
+__attribute__((weak))
+int onload_move_fds(const int* fds, int n_fds)
+{
+  return n_fds;
+}
+
+__attribute__((weak))
+int onload_connect_batch(struct onload_connect_req* reqs, int n_reqs)
+{
+  int i, n_ok = 0;
+
+  for( i = 0; i < n_reqs; ++i ) {
+    if( connect(reqs[i].fd, reqs[i].addr, reqs[i].addrlen) == 0 )
+      reqs[i].rc = 0;
+    else
+      reqs[i].rc = -errno;
+    if( reqs[i].rc == 0 || reqs[i].rc == -EINPROGRESS )
+      ++n_ok;
+  }
+  return n_ok;
+}
+
 
 /**************************************************************************/
 
@@ -289,6 +391,13 @@ int onload_timestamping_request(int fd, unsigned flags)
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_tx_timestamp_ring_read(int fd, struct onload_tx_timestamp* out,
+                                  int max, unsigned* dropped)
+{
+  return -ENOSYS;
+}
+
 
 /**************************************************************************/
 
@@ -309,6 +418,25 @@ onload_delegated_send_complete(int fd, const struct iovec* iov, int iovlen,
   return -1;
 }
 
+__attribute__((weak))
+int
+onload_delegated_send_prepare_batch(struct onload_delegated_send_batch* batch,
+                                    int n, unsigned flags, void* headers,
+                                    int headers_stride)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+__attribute__((weak))
+int
+onload_delegated_send_complete_batch(struct onload_delegated_send_batch* batch,
+                                     int n, int flags)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
 __attribute__((weak))
 int
 onload_delegated_send_cancel(int fd)
@@ -333,6 +461,48 @@ onload_get_tcp_info(int fd, struct onload_tcp_info* info, int* len_in_out)
   return -1;
 }
 
+__attribute__((weak))
+int
+onload_route_prewarm(int fd, const struct sockaddr_storage* dsts, int n_dsts)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+__attribute__((weak))
+int
+onload_route_pin(int fd, struct onload_route_pin* pins, int n_pins)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+__attribute__((weak))
+int
+onload_rx_drop_rule_set(int fd, int rule_id,
+                        const struct onload_rx_drop_rule* rule)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+__attribute__((weak))
+int
+onload_rx_drop_rule_stats(int fd, int rule_id, uint64_t* n_matched,
+                          uint64_t* n_dropped)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+__attribute__((weak))
+int
+onload_stack_irq_set_core(int fd, int core)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
 __attribute__((weak))
 int
 onload_socket_nonaccel(int domain, int type, int protocol)
@@ -15,6 +15,7 @@
 #include <onload/extensions.h>
 #include <onload/extensions_zc.h>
 #include <onload/extensions_zc_hlrx.h>
+#include <onload/extensions_ring.h>
 #include <dlfcn.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -160,6 +161,14 @@ wrap(int, onload_zc_unregister_buffers, (int fd, onload_zc_handle handle,
                                          int flags),
      (fd, handle, flags), -ENOSYS)
 
+wrap(int, onload_zc_shm_create, (int fd, uint64_t len, int* id_out,
+                                 void** addr_out),
+     (fd, len, id_out, addr_out), -ENOSYS)
+wrap(int, onload_zc_shm_list, (int fd, int* ids, int* n_in_out),
+     (fd, ids, n_in_out), -ENOSYS)
+wrap(int, onload_zc_shm_map, (int fd, int id, uint64_t len, void** addr_out),
+     (fd, id, len, addr_out), -ENOSYS)
+
 wrap(int, onload_zc_query_rx_memregs, (int fd, struct onload_zc_iovec* iov,
                                        int* iovecs_len, int flags),
      (fd, iov, iovecs_len, flags), -ENOSYS)
@@ -173,9 +182,15 @@ wrap(int, onload_zc_buffer_decref, (int fd, onload_zc_handle buf),
 wrap(int, onload_zc_recv, (int fd, struct onload_zc_recv_args* args),
      (fd, args), -ENOSYS)
 
+wrap(int, onload_zc_recv_mmsg, (struct onload_zc_recv_mmsg* msgs, int mlen),
+     (msgs, mlen), -ENOSYS)
+
 wrap(int, onload_zc_send, (struct onload_zc_mmsg* msgs, int mlen, int flags),
      (msgs, mlen, flags), -ENOSYS)
 
+wrap(int, onload_zc_forward, (int in_fd, int out_fd, int flags),
+     (in_fd, out_fd, flags), -ENOSYS)
+
 wrap(int, onload_set_recv_filter, (int fd, onload_zc_recv_filter_callback filter,
                                    void* cb_arg, int flags),
      (fd, filter, cb_arg, flags), -ENOSYS)
@@ -190,6 +205,10 @@ wrap(int, onload_zc_hlrx_free, (struct onload_zc_hlrx* hlrx),
 wrap(int, onload_zc_hlrx_buffer_release, (int fd, onload_zc_handle buf),
      (fd, buf), -ENOSYS)
 
+wrap(int, onload_zc_hlrx_buffer_release_batch,
+     (int fd, const onload_zc_handle* bufs, int n_bufs),
+     (fd, bufs, n_bufs), -ENOSYS)
+
 wrap(ssize_t, onload_zc_hlrx_recv_copy, (struct onload_zc_hlrx* hlrx,
                                          struct msghdr* msg, int flags),
      (hlrx, msg, flags), -ENOSYS)
@@ -204,6 +223,20 @@ wrap(ssize_t, onload_zc_hlrx_recv_oob,
       void* buf, size_t len, int* flags),
      (hlrx, inband, buf, len, flags), -ENOSYS)
 
+wrap(int, onload_ring_alloc, (unsigned entries, int flags,
+                              struct onload_ring** ring_out),
+     (entries, flags, ring_out), -ENOSYS)
+
+wrap(int, onload_ring_free, (struct onload_ring* ring), (ring), -ENOSYS)
+
+wrap(struct onload_ring_sqe*, onload_ring_get_sqe, (struct onload_ring* ring),
+     (ring), NULL)
+
+wrap(int, onload_ring_submit, (struct onload_ring* ring), (ring), -ENOSYS)
+
+wrap(int, onload_ring_reap, (struct onload_ring* ring,
+                             struct onload_ring_cqe* cqes, int max),
+     (ring, cqes, max), -ENOSYS)
 
 wrap(int, onload_msg_template_alloc, (int fd, const struct iovec* initial_msg,
                                       int mlen, onload_template_handle* handle,
@@ -217,6 +250,10 @@ wrap(int, onload_msg_template_update,
       unsigned flags),
      (fd, handle, updates, ulen, flags), -ENOSYS)
 
+wrap(int, onload_msg_template_update_batch,
+     (struct onload_template_msg_update_batch* batch, int n, unsigned flags),
+     (batch, n, flags), -ENOSYS)
+
 wrap(int, onload_msg_template_abort, (int fd, onload_template_handle handle),
      (fd, handle), -ENOSYS)
 
@@ -230,6 +267,27 @@ wrap(int, onload_thread_get_spin, (unsigned* state), (state), -ENOSYS)
 
 wrap(int, onload_move_fd, (int fd), (fd), 0)
 
+wrap(int, onload_move_fds, (const int* fds, int n_fds), (fds, n_fds), n_fds)
+
+static int connect_batch(struct onload_connect_req* reqs, int n_reqs)
+{
+  int i, n_ok = 0;
+
+  for( i = 0; i < n_reqs; ++i ) {
+    if( connect(reqs[i].fd, reqs[i].addr, reqs[i].addrlen) == 0 )
+      reqs[i].rc = 0;
+    else
+      reqs[i].rc = -errno;
+    if( reqs[i].rc == 0 || reqs[i].rc == -EINPROGRESS )
+      ++n_ok;
+  }
+  return n_ok;
+}
+
+wrap_with_fn(int, onload_connect_batch,
+             (struct onload_connect_req* reqs, int n_reqs),
+             (reqs, n_reqs), connect_batch)
+
 wrap( int, onload_fd_check_feature, (int fd, enum onload_fd_feature feature),
      (fd, feature), -ENOSYS)
 
@@ -241,6 +299,10 @@ wrap( int, onload_ordered_epoll_wait, (int epfd, struct epoll_event *events,
 wrap(int, onload_timestamping_request, (int fd, unsigned flags),
      (fd, flags), -ENOSYS)
 
+wrap(int, onload_tx_timestamp_ring_read,
+     (int fd, struct onload_tx_timestamp* out, int max, unsigned* dropped),
+     (fd, out, max, dropped), -ENOSYS)
+
 wrap(enum onload_delegated_send_rc,  onload_delegated_send_prepare,
      (int fd, int size, unsigned flags, struct onload_delegated_send* out),
      (fd, size, flags, out), ONLOAD_DELEGATED_SEND_RC_BAD_SOCKET)
@@ -251,6 +313,15 @@ wrap_with_errno(int,  onload_delegated_send_complete,
 
 wrap_with_errno(int, onload_delegated_send_cancel, (int fd), (fd), -1, ENOSYS)
 
+wrap_with_errno(int, onload_delegated_send_prepare_batch,
+                (struct onload_delegated_send_batch* batch, int n,
+                 unsigned flags, void* headers, int headers_stride),
+                (batch, n, flags, headers, headers_stride), -1, ENOSYS)
+
+wrap_with_errno(int, onload_delegated_send_complete_batch,
+                (struct onload_delegated_send_batch* batch, int n, int flags),
+                (batch, n, flags), -1, ENOSYS)
+
 wrap_with_errno(int, oo_raw_send,
                 (int fd, int hwport, const struct iovec* iov, int iovlen),
                 (fd, hwport, iov, iovlen), -1, ENOSYS)
@@ -259,6 +330,26 @@ wrap_with_errno(int, onload_get_tcp_info,
                 (int fd, struct onload_tcp_info* info, int* len),
                 (fd, info, len), -1, EINVAL)
 
+wrap_with_errno(int, onload_route_prewarm,
+                (int fd, const struct sockaddr_storage* dsts, int n_dsts),
+                (fd, dsts, n_dsts), -1, ENOSYS)
+
+wrap_with_errno(int, onload_route_pin,
+                (int fd, struct onload_route_pin* pins, int n_pins),
+                (fd, pins, n_pins), -1, ENOSYS)
+
+wrap_with_errno(int, onload_rx_drop_rule_set,
+                (int fd, int rule_id, const struct onload_rx_drop_rule* rule),
+                (fd, rule_id, rule), -1, ENOSYS)
+
+wrap_with_errno(int, onload_rx_drop_rule_stats,
+                (int fd, int rule_id, uint64_t* n_matched,
+                 uint64_t* n_dropped),
+                (fd, rule_id, n_matched, n_dropped), -1, ENOSYS)
+
+wrap_with_errno(int, onload_stack_irq_set_core, (int fd, int core),
+                (fd, core), -1, ENOSYS)
+
 wrap_with_fn(int, onload_socket_nonaccel,
              (int domain, int type, int protocol),
              (domain, type, protocol), socket)
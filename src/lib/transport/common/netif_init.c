@@ -283,7 +283,9 @@ citp_netif_use_scalable_clustered_stack(const char* stackname)
     ci_cfg_opts.netif_opts.scalable_filter_enable ==
       CITP_SCALABLE_FILTERS_ENABLE &&
     (ci_cfg_opts.netif_opts.scalable_filter_mode & CITP_SCALABLE_MODE_RSS) &&
-    stackname[0] == '\0' && ci_cfg_opts.netif_opts.cluster_ignore != 1;
+    (stackname[0] == '\0' ||
+     (CITP_OPTS.cluster_per_thread && oo_stackname_is_thread_local())) &&
+    ci_cfg_opts.netif_opts.cluster_ignore != 1;
 }
 
 
@@ -303,9 +305,14 @@ int citp_netif_get_process_stack(ci_netif** out_ni, const char* stackname)
             return 0;
       }
       else if( (*out_ni)->state->flags & CI_NETIF_FLAG_SCALABLE_FILTERS_RSS &&
-               (*out_ni)->state->pid == getpid() ) {
+               (*out_ni)->state->pid == getpid() &&
+               (stackname[0] == '\0' ||
+                strncmp((*out_ni)->state->name, stackname,
+                        CI_CFG_STACK_NAME_LEN) == 0) ) {
         /* We pick the stack that is marked with the above flag.
-         * A process is expected to have access only to one of these. */
+         * A process is expected to have access only to one of these,
+         * except with EF_CLUSTER_PER_THREAD, where each thread with a stack
+         * name of its own has one, under that name. */
         return 0;
      }
   }
@@ -696,6 +703,31 @@ void uncache_active_netifs(void)
 #endif
 
 
+/* Return packets held in this process's per-thread caches to each stack,
+ * before exit() or exec() loses track of them. */
+void drain_active_netifs_pkt_mags(void)
+{
+  ci_netif* ni;
+
+  CITP_FDTABLE_ASSERT_LOCKED(1);
+  CI_DLLIST_FOR_EACH2(ci_netif, ni, link, &citp_active_netifs)
+    ci_netif_pkt_mags_drain(ni);
+}
+
+
+/* Empty the per-thread caches in a fork() child without returning their
+ * packets: they are copies of the parent's caches, which are still in
+ * use. */
+void reset_active_netifs_pkt_mags(void)
+{
+  ci_netif* ni;
+
+  CITP_FDTABLE_ASSERT_LOCKED(1);
+  CI_DLLIST_FOR_EACH2(ci_netif, ni, link, &citp_active_netifs)
+    ci_netif_pkt_mags_init(ni);
+}
+
+
 void exit_lock_all_stacks(void)
 {
   int pid = getpid();
@@ -43,6 +43,7 @@
 #ifndef __KERNEL__
 #include <limits.h>
 #include <net/if.h>
+#include <netinet/tcp.h>
 
 /* Emulate Linux mapping between priority and TOS field */
 #include <linux/types.h>
@@ -705,6 +706,16 @@ int ci_get_sol_socket( ci_netif* netif, ci_sock_cmn* s,
     goto u_out;
   }
 
+  case SO_MAX_PACING_RATE:
+    /* As Linux: a 64-bit value if there is room for one. */
+    if( *optlen >= sizeof(ci_uint64) ) {
+      memcpy(optval, &s->so_max_pacing_rate, sizeof(ci_uint64));
+      *optlen = sizeof(ci_uint64);
+      break;
+    }
+    u = CI_MIN(s->so_max_pacing_rate, (ci_uint64) 0xffffffffu);
+    goto u_out;
+
 #ifdef SO_SELECT_ERR_QUEUE
   case SO_SELECT_ERR_QUEUE:
     if( s->s_aflags & CI_SOCK_AFLAG_SELECT_ERR_QUEUE )
@@ -714,6 +725,10 @@ int ci_get_sol_socket( ci_netif* netif, ci_sock_cmn* s,
     goto u_out;
 #endif
 
+  case SO_ZEROCOPY:
+    u = !!(s->s_aflags & CI_SOCK_AFLAG_ZEROCOPY);
+    goto u_out;
+
   default: /* Unexpected & known invalid options end up here */
     goto fail_noopt;
   }
@@ -1720,6 +1735,27 @@ int ci_set_sol_socket(ci_netif* netif, ci_sock_cmn* s,
     break;
   }
 
+  case SO_MAX_PACING_RATE:
+  {
+    /* Bytes per second.  As on Linux, a 64-bit value is accepted if
+     * there is room for one, and a 32-bit ~0 means unlimited. */
+    ci_uint64 rate;
+    if( (rc = opt_not_ok(optval, optlen, ci_uint32)) )
+      goto fail_inval;
+    if( optlen >= sizeof(ci_uint64) )
+      memcpy(&rate, optval, sizeof(rate));
+    else if( *(ci_uint32*) optval == 0xffffffffu )
+      rate = CI_PACING_RATE_UNLIMITED;
+    else
+      rate = *(ci_uint32*) optval;
+    s->so_max_pacing_rate = rate;
+    if( s->b.state == CI_TCP_STATE_UDP )
+      ci_udp_pacing_update(netif, SOCK_TO_UDP(s));
+    else if( s->b.state & CI_TCP_STATE_TCP_CONN )
+      ci_tcp_pacing_update(netif, SOCK_TO_TCP(s));
+    break;
+  }
+
 #if CI_CFG_TIMESTAMPING
   case ONLOAD_SO_TIMESTAMPING:
     if( (rc = opt_not_ok(optval, optlen, unsigned)) )
@@ -1825,6 +1861,21 @@ int ci_set_sol_socket(ci_netif* netif, ci_sock_cmn* s,
     break;
 #endif
 
+  case SO_ZEROCOPY:
+    /* We always copy the payload of MSG_ZEROCOPY sends, but still report
+     * their completion as Linux does, so that applications work unchanged.
+     */
+    v = ci_get_optval(optval, optlen);
+    if( v < 0 || v > 1 ) {
+      rc = -EINVAL;
+      goto fail_inval;
+    }
+    if( v )
+      ci_bit_set(&s->s_aflags, CI_SOCK_AFLAG_ZEROCOPY_BIT);
+    else
+      ci_bit_clear(&s->s_aflags, CI_SOCK_AFLAG_ZEROCOPY_BIT);
+    break;
+
   default:
     /* SOL_SOCKET options that are defined to fail with ENOPROTOOPT:
      *  SO_TYPE,  CI_SOSNDLOWAT,
@@ -1879,6 +1930,11 @@ int ci_setsockopt_os_fail_ignore(ci_netif* ni, ci_sock_cmn* s, int err,
            optname == ONLOAD_TCP_OFFLOAD && optlen >= sizeof(int) )
     return 1;
 #endif
+  /* Onload's module names (eg. "onload-reno") need not be known to the
+   * kernel. */
+  else if( s->b.state & CI_TCP_STATE_TCP && level == IPPROTO_TCP &&
+           optname == TCP_CONGESTION )
+    return 1;
   return 0;
 }
 
@@ -133,6 +133,8 @@ cicp_user_bond_hash_get_hwport(ci_netif* ni, ci_ip_cached_hdrs* ipcache,
       CICP_HASH_STATE_FLAGS_IS_IP;
   else
     hs.flags = CICP_HASH_STATE_FLAGS_IS_IP;
+  if( NI_OPTS(ni).bond_kernel_hash )
+    hs.flags |= CICP_HASH_STATE_FLAGS_KERNEL;
   memcpy(&hs.dst_mac, ci_ip_cache_ether_dhost(ipcache), ETH_ALEN);
   memcpy(&hs.src_mac, ci_ip_cache_ether_shost(ipcache), ETH_ALEN);
   hs.src_addr_be32 = onload_addr_xor(ipcache_laddr(ipcache));
@@ -261,6 +263,88 @@ cicp_user_build_fwd_key(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
 }
 
 
+#ifndef __KERNEL__
+/* Re-check a route which has already been resolved, and keep it in use.
+ * Returns CICP_PREWARM_* flags, or -1 if the route must be looked up
+ * again. */
+static int
+cicp_user_prewarm_check(ci_netif* ni, cicp_verinfo_t* verinfo)
+{
+  struct oo_cplane_handle* cp = ni->cplane;
+  struct cp_fwd_table* fwd_table;
+  ci_uint8 flags;
+
+  if( ! oo_cp_verinfo_is_valid(cp, verinfo, ci_ni_fwd_table_id(ni)) )
+    return -1;
+
+  fwd_table = oo_cp_get_fwd_table(cp, ci_ni_fwd_table_id(ni));
+  cp_get_fwd_rw(fwd_table, verinfo)->frc_used = ci_frc64_get();
+  flags = cp_get_fwd_data(fwd_table, verinfo)->flags;
+  ci_rmb();
+  if( ! cp_fwd_version_matches(fwd_table, verinfo) )
+    return -1;
+
+  if( flags & CICP_FWD_DATA_FLAG_ARP_VALID )
+    return 0;
+  oo_cp_arp_resolve(cp, verinfo, ci_ni_fwd_table_id(ni));
+  return CICP_PREWARM_NO_MAC;
+}
+
+
+int
+cicp_user_prewarm(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
+                  const struct oo_sock_cplane* sock_cp,
+                  const ci_addr_t* daddrs, cicp_verinfo_t* verinfos,
+                  int* flags_out, int n_daddrs)
+{
+  struct cp_fwd_key key;
+  struct cp_fwd_data data;
+  cicp_verinfo_t old;
+  int i, af, n_ok = 0;
+
+  /* Send requests for all the missing routes first, so that the server
+   * works through them back to back rather than one round trip each. */
+  for( i = 0; i < n_daddrs; ++i ) {
+    flags_out[i] = cicp_user_prewarm_check(ni, &verinfos[i]);
+    if( flags_out[i] >= 0 )
+      continue;
+    af = CI_IS_ADDR_IP6(daddrs[i]) ? AF_INET6 : AF_INET;
+    if( cicp_user_build_fwd_key(ni, ipcache, sock_cp, daddrs[i], af,
+                                &key) == 0 )
+      oo_cp_route_prefetch(ni->cplane, &key, ci_ni_fwd_table_id(ni));
+  }
+
+  /* Now wait for them.  This also resolves the routes which depend on the
+   * source address chosen by the first lookup, and starts ARP. */
+  for( i = 0; i < n_daddrs; ++i ) {
+    if( flags_out[i] >= 0 ) {
+      ++n_ok;
+      continue;
+    }
+    old = verinfos[i];
+    af = CI_IS_ADDR_IP6(daddrs[i]) ? AF_INET6 : AF_INET;
+    if( cicp_user_build_fwd_key(ni, ipcache, sock_cp, daddrs[i], af,
+                                &key) != 0 ||
+        cicp_user_resolve(ni, ni->cplane, &verinfos[i],
+                          sock_cp->sock_cp_flags, &key, &data) != 0 ) {
+      oo_cp_verinfo_init(&verinfos[i]);
+      flags_out[i] = CICP_PREWARM_NO_ROUTE;
+    }
+    else {
+      flags_out[i] = 0;
+      if( ! (data.flags & CICP_FWD_DATA_FLAG_ARP_VALID) )
+        flags_out[i] |= CICP_PREWARM_NO_MAC;
+      ++n_ok;
+    }
+    if( verinfos[i].id != old.id || verinfos[i].version != old.version )
+      flags_out[i] |= CICP_PREWARM_CHANGED;
+  }
+
+  return n_ok;
+}
+#endif
+
+
 void
 cicp_user_retrieve(ci_netif*                    ni,
                    ci_ip_cached_hdrs*           ipcache,
@@ -273,6 +357,9 @@ cicp_user_retrieve(ci_netif*                    ni,
   /* Initialise to placate compiler. */
   ci_addr_sh_t pre_nat_laddr = addr_sh_any;
   int /*bool*/ nat_applied = 0;
+#if CI_CFG_TEAMING
+  ci_hwport_id_t prev_hwport = ipcache->hwport;
+#endif
 
   /* This function must be called when "the route is unusable".  I.e. when
    * the route is invalid or if there is no ARP.  In the second case, we
@@ -371,6 +458,11 @@ cicp_user_retrieve(ci_netif*                    ni,
   else
 #endif
     ipcache->hwport = cp_hwport_mask_first(data.hwports);
+#if CI_CFG_TEAMING
+  if( (ipcache->encap.type & CICP_LLAP_TYPE_BOND) &&
+      prev_hwport != CI_HWPORT_ID_BAD && ipcache->hwport != prev_hwport )
+    CITP_STATS_NETIF_INC(ni, bond_tx_port_switches);
+#endif
 
   if( is_sock_cp_pmtu_probe_set(sock_cp, af) ) {
     int rc = oo_cp_find_llap(ni->cplane, data.base.ifindex, &data.base.mtu,
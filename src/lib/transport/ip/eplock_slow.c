@@ -40,13 +40,45 @@ static int __oo_eplock_lock(ci_netif* ni, long* timeout, int maybe_wedged)
 
 }
 
+#define EF_EPLOCK_TIME_WAITS  (CI_CFG_STATS_NETIF || OO_LOCK_PROFILE)
+
+#if EF_EPLOCK_TIME_WAITS
+/* Called with the lock newly held, so the stats are safe to update. */
+static void ef_eplock_waited(ci_netif* ni, ci_uint64 wait_start_frc)
+{
+  ci_uint64 wait;
+
+  ci_frc64(&wait);
+  wait -= wait_start_frc;
+#if CI_CFG_STATS_NETIF
+  ++ni->state->stats.stack_lock_waits;
+  ni->state->stats.stack_lock_wait_cycles += wait;
+  if( wait > ni->state->stats.stack_lock_wait_cycles_max )
+    ni->state->stats.stack_lock_wait_cycles_max =
+      (ci_uint32) CI_MIN(wait, (ci_uint64) 0xffffffff);
+#endif
+#if OO_LOCK_PROFILE
+  ni->state->lock_profile.holder_wait = wait;
+#endif
+}
+#endif
+
+
 int __ef_eplock_lock_slow(ci_netif *ni, long timeout, int maybe_wedged)
 {
 #ifndef __KERNEL__
   ci_uint64 start_frc, now_frc;
+#endif
+#if EF_EPLOCK_TIME_WAITS
+  ci_uint64 wait_start_frc;
 #endif
   int rc;
 
+#if EF_EPLOCK_TIME_WAITS
+  ci_frc64(&wait_start_frc);
+#endif
+  OO_PROBE1(netif_lock_contended, NI_ID(ni));
+
 #ifndef __KERNEL__
   ci_assert_equal(maybe_wedged, 0);
 #endif
@@ -62,14 +94,22 @@ int __ef_eplock_lock_slow(ci_netif *ni, long timeout, int maybe_wedged)
     while( now_frc - start_frc < ni->state->buzz_cycles ) {
       ci_spinloop_pause();
       ci_frc64(&now_frc);
-      if( ef_eplock_trylock(&ni->state->lock) )
+      if( ef_eplock_trylock(&ni->state->lock) ) {
+#if EF_EPLOCK_TIME_WAITS
+        ef_eplock_waited(ni, wait_start_frc);
+#endif
         return 0;
+      }
     }
   }
 #endif
 
   while( 1 ) {
     rc = __oo_eplock_lock(ni, &timeout, maybe_wedged);
+#if EF_EPLOCK_TIME_WAITS
+    if( rc == 0 )
+      ef_eplock_waited(ni, wait_start_frc);
+#endif
     if( rc == 0 || rc == -ETIMEDOUT )
       return rc;
 
@@ -102,4 +142,88 @@ int __ef_eplock_lock_slow(ci_netif *ni, long timeout, int maybe_wedged)
   return 0;
 }
 
+
+#if OO_LOCK_PROFILE
+/* Finds the entry for [file]:[line] in the profile, adding it if it is not
+ * there yet.  Returns NULL if the table is full. */
+static ci_netif_lock_profile_site*
+ci_netif_lock_profile_find(ci_netif_lock_profile* lp, const char* file,
+                           int line)
+{
+  const char* base = strrchr(file, '/');
+  unsigned i, n;
+
+  base = base ? base + 1 : file;
+  i = (unsigned) line % CI_LOCK_PROFILE_SITES;
+  for( n = 0; n < CI_LOCK_PROFILE_SITES; ++n ) {
+    ci_netif_lock_profile_site* site = &lp->sites[i];
+    if( site->file[0] == '\0' ) {
+      strncpy(site->file, base, sizeof(site->file) - 1);
+      site->line = line;
+      return site;
+    }
+    if( site->line == line &&
+        ! strncmp(site->file, base, sizeof(site->file) - 1) )
+      return site;
+    i = (i + 1) % CI_LOCK_PROFILE_SITES;
+  }
+  return NULL;
+}
+
+
+void ci_netif_lock_profile_acquired(ci_netif* ni, const char* file, int line)
+{
+  ci_netif_lock_profile* lp = &ni->state->lock_profile;
+  ci_netif_lock_profile_site* site;
+  ci_uint64 wait = lp->holder_wait;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  lp->holder_wait = 0;
+  lp->holder = 0;
+  site = ci_netif_lock_profile_find(lp, file, line);
+  if( site == NULL ) {
+    ++lp->n_unrecorded;
+    return;
+  }
+
+  ++site->n_locks;
+  if( wait != 0 ) {
+    ++site->n_waits;
+    site->wait_cycles += wait;
+    if( wait > site->wait_max )
+      site->wait_max = (ci_uint32) CI_MIN(wait, (ci_uint64) 0xffffffff);
+  }
+  lp->holder = site - lp->sites + 1;
+  ci_frc64(&lp->holder_frc);
+}
+
+
+void ci_netif_lock_profile_released(ci_netif* ni)
+{
+  ci_netif_lock_profile* lp = &ni->state->lock_profile;
+  ci_netif_lock_profile_site* site;
+  ci_uint64 now, hold;
+  unsigned i;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  /* Nothing to do if the lock was taken in the kernel, or before the
+   * profile was enabled. */
+  if( lp->holder == 0 || lp->holder > CI_LOCK_PROFILE_SITES )
+    return;
+  site = &lp->sites[lp->holder - 1];
+  lp->holder = 0;
+
+  ci_frc64(&now);
+  /* The lock may have been taken on another core. */
+  hold = now > lp->holder_frc ? now - lp->holder_frc : 0;
+  site->hold_cycles += hold;
+  if( hold > site->hold_max )
+    site->hold_max = (ci_uint32) CI_MIN(hold, (ci_uint64) 0xffffffff);
+  i = hold ? 64 - __builtin_clzll(hold) : 0;
+  ++site->hold_hist[CI_MIN(i, CI_LOCK_PROFILE_BUCKETS - 1)];
+}
+#endif
+
 /*! \cidoxg_end */
@@ -381,6 +381,45 @@ void ip_cmsg_recv_timestamping(ci_netif *ni, const ci_ip_pkt_fmt *pkt,
 }
 #endif
 
+/**
+ * Put a MSG_ZEROCOPY notification covering every id not yet reported on
+ * [s] into msg ancillary data buffer.  Caller holds the socket lock.
+ */
+void ip_cmsg_recv_zc_notification(ci_sock_cmn* s,
+                                  struct cmsg_state* cmsg_state)
+{
+  struct {
+    struct oo_sock_extended_err ee;
+    union {
+      struct sockaddr_in        offender;
+#if CI_CFG_IPV6
+      struct sockaddr_in6       offender6;
+#endif
+    };
+  } __attribute__((packed, aligned(sizeof(ci_uint32)))) errhdr;
+  ci_uint32 next = OO_ACCESS_ONCE(s->zc_id_next);
+
+  ci_assert(ci_sock_zc_pending(s));
+
+  /* As Linux, the range is [ee_info, ee_data] inclusive, and there is no
+   * offender. */
+  memset(&errhdr, 0, sizeof(errhdr));
+  errhdr.ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+  errhdr.ee.ee_code = SO_EE_CODE_ZEROCOPY_COPIED;
+  errhdr.ee.ee_info = s->zc_id_unreported;
+  errhdr.ee.ee_data = next - 1;
+  s->zc_id_unreported = next;
+
+#if CI_CFG_IPV6
+  if( IS_AF_INET6(s->domain) )
+    ci_put_cmsg(cmsg_state, SOL_IPV6, IPV6_RECVERR,
+                sizeof(errhdr.ee) + sizeof(errhdr.offender6), &errhdr);
+  else
+#endif
+    ci_put_cmsg(cmsg_state, SOL_IP, IP_RECVERR,
+                sizeof(errhdr.ee) + sizeof(errhdr.offender), &errhdr);
+}
+
 void ci_ip_cmsg_finish(struct cmsg_state* cmsg_state)
 {
 #ifndef NEED_A_WORKAROUND_FOR_GLIBC_BUG_13500
@@ -399,10 +438,12 @@ void ci_ip_cmsg_finish(struct cmsg_state* cmsg_state)
 
 /**
  * Fill in the msg ancillary data buffer with all control messages
- * according to cmsg_flags the user has set beforehand.
+ * according to cmsg_flags the user has set beforehand, plus UDP_GRO if
+ * [gro_size] is non-zero.
  */
 void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
-                     struct msghdr *msg, int netif_locked, int *p_msg_flags)
+                     struct msghdr *msg, int netif_locked, int *p_msg_flags,
+                     int gro_size)
 {
   unsigned flags = us->s.cmsg_flags;
   struct cmsg_state cmsg_state;
@@ -448,6 +489,10 @@ void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
     ip_cmsg_recv_timestamping(ni, pkt, us->s.timestamping_flags, &cmsg_state);
 #endif
 
+  if( gro_size != 0 )
+    ci_put_cmsg(&cmsg_state, IPPROTO_UDP, UDP_GRO, sizeof(gro_size),
+                &gro_size);
+
   ci_ip_cmsg_finish(&cmsg_state);
 }
 
@@ -459,8 +504,11 @@ void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
  *
  * \param info_out    Must be a valid pointer. Contains a pointer to
  * struct in_pktinfo or struct in6_pktinfo.
+ * \param gso_size_out Must be a valid pointer.  Set to the UDP_SEGMENT
+ * size if one is given, otherwise left unchanged.
  */
-int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out)
+int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out,
+                    ci_uint16* gso_size_out)
 {
   struct cmsghdr *cmsg;
 
@@ -499,6 +547,15 @@ int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out)
       else
         return -EINVAL;
     }
+    else if( cmsg->cmsg_level == IPPROTO_UDP ) {
+      if( cmsg->cmsg_type == UDP_SEGMENT ) {
+        if( cmsg->cmsg_len != CMSG_LEN(sizeof(ci_uint16)) )
+          return -EINVAL;
+        memcpy(gso_size_out, CMSG_DATA(cmsg), sizeof(ci_uint16));
+      }
+      else
+        return -EINVAL;
+    }
   }
 
   return 0;
@@ -138,6 +138,41 @@ ci_inline void ci_tcp_update_rtt(ci_netif* netif, ci_tcp_state* ts, int m)
 	        tcp_srtt(ts), tcp_rttvar(ts), ts->rto));
 }
 
+/* As ci_tcp_update_rtt(), for an RTT [m] in microseconds measured from
+ * the send time of an ACKed segment (EF_TCP_RTT_US).  The estimate is kept
+ * in microseconds, and the tick-based sa, sv and rto are derived from it.
+ */
+ci_inline void ci_tcp_update_rtt_us(ci_netif* netif, ci_tcp_state* ts,
+                                    ci_uint32 m)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(netif);
+  unsigned us2tick = its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us;
+  ci_int32 d;
+
+  m = CI_MAX(1u, m);
+  if( CI_LIKELY(ts->sa_us) ) {
+    d = m - (ts->sa_us >> 3u);
+    ts->sa_us += d;       /* SRTT <- SRTT + 0.125*(M-SRTT)  */
+    if( d < 0 ) d = -d;
+    d -= (ts->sv_us >> 2u);
+    ts->sv_us += d;       /* RTTVAR <- 0.75*RTTVAR + 0.25*|M-SRTT| */
+  }
+  else {
+    ts->sa_us = m << 3u;
+    ts->sv_us = m << 1u;
+  }
+
+  /* Round up, so that a sub-tick RTT still gives a non-zero RTO. */
+  ts->sa = CI_MAX(1u << 3u, ts->sa_us >> us2tick);
+  ts->sv = (ts->sv_us + (1u << us2tick) - 1) >> us2tick;
+  ts->rto = ((ts->sa_us >> 3u) + ts->sv_us + (1u << us2tick) - 1) >> us2tick;
+  ci_tcp_rto_bound(netif, ts);
+
+  CI_IP_SOCK_STATS_VAL_RTT_SRTT_RTO( ts, ts->sv >> 2, ts->sa >> 3, ts->rto );
+  LOG_TR(ci_log("TCP RX %d UPDATE RTT m=%u sa_us=%u sv_us=%u RTO=%u",
+                S_FMT(ts), m, ts->sa_us, ts->sv_us, ts->rto));
+}
+
 /*
 ** Turn timestamps into cmsg entries.
 */
@@ -147,6 +182,8 @@ void ip_cmsg_recv_timestampns(ci_netif *ni, ci_uint64 timestamp,
                                         struct cmsg_state *cmsg_state);
 void ip_cmsg_recv_timestamping(ci_netif *ni, const ci_ip_pkt_fmt *pkt,
                                int flags, struct cmsg_state *cmsg_state);
+void ip_cmsg_recv_zc_notification(ci_sock_cmn* s,
+                                  struct cmsg_state* cmsg_state);
 
 
 /**********************************************************************
@@ -433,6 +470,18 @@ struct oo_sock_extended_err {
  */
 #define ONLOAD_SO_BUSY_POLL 46
 
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE 47
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
 /* check [ov] is a non-NULL ptr & [ol] indicates the right space for
  * type [ty] */
 #define opt_ok(ov,ol,ty)     ((ov) && (ol) >= sizeof(ty))
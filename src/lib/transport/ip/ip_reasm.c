@@ -0,0 +1,329 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2026 Advanced Micro Devices, Inc. */
+/* Reassembly of fragmented IPv4 UDP datagrams.
+ *
+ * With EF_IP_REASM_MAX_PKTS set, fragments of UDP datagrams are held in
+ * the stack rather than passed to the kernel.  Each datagram under
+ * reassembly has a slot in a small table in the netif state, found by
+ * hashing its (source, destination, id, protocol) key, and its fragments
+ * are kept on a list ordered by offset.  Once the last fragment has
+ * arrived and the payload has no holes the fragments are turned into a
+ * single multi-buffer packet, just like a jumbo frame received in scatter
+ * mode, and handed back to the normal receive path.
+ *
+ * Resources are bounded in three ways: the number of slots, the total
+ * number of packet buffers held (the oldest datagram is dropped to make
+ * room), and a timeout from the arrival of the first fragment, run from
+ * ip_reasm_tid.  A datagram whose fragments overlap or disagree about its
+ * length is dropped, as the kernel does.
+ *
+ * The hardware does not check the UDP checksum of fragments, so it is
+ * checked here once the datagram is complete.
+ */
+
+#include "ip_internal.h"
+#include <ci/tools/ipcsum_base.h>
+
+#if CI_CFG_IP_REASM
+
+#define LPF "IP REASM "
+
+
+static unsigned ci_ip_reasm_hash(const ci_ip4_hdr* ip)
+{
+  return (ip->ip_saddr_be32 ^ ip->ip_daddr_be32 ^ ip->ip_id_be16 ^
+          ip->ip_protocol) % CI_CFG_IP_REASM_SLOTS;
+}
+
+
+static int ci_ip_reasm_frag_off(const ci_ip4_hdr* ip)
+{
+  return CI_IP4_FRAG_OFFSET(ip) << 3;
+}
+
+
+static int ci_ip_reasm_frag_len(const ci_ip4_hdr* ip)
+{
+  return CI_BSWAP_BE16(ip->ip_tot_len_be16) - CI_IP4_IHL(ip);
+}
+
+
+/* Drop a datagram under reassembly and free its slot. */
+static void ci_ip_reasm_drop(ci_netif* ni, ci_ip_reasm* r)
+{
+  oo_pkt_p pp = r->frags;
+  ci_ip_pkt_fmt* pkt;
+
+  while( OO_PP_NOT_NULL(pp) ) {
+    pkt = PKT_CHK(ni, pp);
+    pp = pkt->next;
+    pkt->next = OO_PP_NULL;
+    ci_netif_pkt_release_rx_1ref(ni, pkt);
+  }
+  ni->state->ip_reasm_n_pkts -= r->n_pkts;
+  ci_assert_ge(ni->state->ip_reasm_n_pkts, 0);
+  r->frags = OO_PP_NULL;
+  r->n_pkts = 0;
+}
+
+
+/* The slot with the earliest expiry other than [not], or NULL. */
+static ci_ip_reasm* ci_ip_reasm_oldest(ci_netif* ni, ci_ip_reasm* not)
+{
+  ci_ip_reasm* oldest = NULL;
+  ci_ip_reasm* r;
+
+  for( r = ni->state->ip_reasm;
+       r < ni->state->ip_reasm + CI_CFG_IP_REASM_SLOTS; ++r )
+    if( r->n_pkts != 0 && r != not &&
+        (oldest == NULL || ci_ip_time_before(r->expiry, oldest->expiry)) )
+      oldest = r;
+  return oldest;
+}
+
+
+/* Find the slot for the datagram [ip] belongs to, or start a new one. */
+static ci_ip_reasm* ci_ip_reasm_find(ci_netif* ni, const ci_ip4_hdr* ip)
+{
+  ci_ip_reasm* free_r = NULL;
+  ci_ip_reasm* r;
+  unsigned i, h = ci_ip_reasm_hash(ip);
+
+  for( i = 0; i < CI_CFG_IP_REASM_SLOTS; ++i ) {
+    r = &ni->state->ip_reasm[(h + i) % CI_CFG_IP_REASM_SLOTS];
+    if( r->n_pkts == 0 ) {
+      if( free_r == NULL )
+        free_r = r;
+    }
+    else if( r->saddr_be32 == ip->ip_saddr_be32 &&
+             r->daddr_be32 == ip->ip_daddr_be32 &&
+             r->id_be16 == ip->ip_id_be16 &&
+             r->protocol == ip->ip_protocol ) {
+      return r;
+    }
+  }
+
+  if( free_r == NULL ) {
+    free_r = ci_ip_reasm_oldest(ni, NULL);
+    CITP_STATS_NETIF_INC(ni, ip_reasm_evicted);
+    ci_ip_reasm_drop(ni, free_r);
+  }
+
+  r = free_r;
+  r->saddr_be32 = ip->ip_saddr_be32;
+  r->daddr_be32 = ip->ip_daddr_be32;
+  r->id_be16 = ip->ip_id_be16;
+  r->protocol = ip->ip_protocol;
+  r->total_len = -1;
+  r->bytes = 0;
+  r->expiry = ci_ip_time_now(ni) +
+              ci_ip_time_ms2ticks(ni, NI_OPTS(ni).ip_reasm_timeout_ms);
+  r->frags = OO_PP_NULL;
+  if( ! ci_ip_timer_pending(ni, &ni->state->ip_reasm_tid) )
+    ci_ip_timer_set(ni, &ni->state->ip_reasm_tid, r->expiry);
+  return r;
+}
+
+
+/* Insert [pkt] into the list of [r] in order of offset.  Returns 0 if it
+ * overlaps a fragment already held. */
+static int ci_ip_reasm_insert(ci_netif* ni, ci_ip_reasm* r,
+                              ci_ip_pkt_fmt* pkt, int off, int len)
+{
+  oo_pkt_p* p_pp = &r->frags;
+  ci_ip_pkt_fmt* p;
+  int p_off;
+
+  while( OO_PP_NOT_NULL(*p_pp) ) {
+    p = PKT_CHK(ni, *p_pp);
+    p_off = ci_ip_reasm_frag_off(oo_ip_hdr(p));
+    if( p_off >= off + len )
+      break;
+    if( p_off + ci_ip_reasm_frag_len(oo_ip_hdr(p)) > off )
+      return 0;
+    p_pp = &p->next;
+  }
+  pkt->next = *p_pp;
+  *p_pp = OO_PKT_P(pkt);
+  return 1;
+}
+
+
+static int ci_ip_reasm_udp_csum_correct(ci_netif* ni, ci_ip_pkt_fmt* head)
+{
+  ci_ip4_hdr* ip = oo_ip_hdr(head);
+  ci_udp_hdr* udp = (ci_udp_hdr*) ((char*) ip + CI_IP4_IHL(ip));
+  int udp_len = CI_BSWAP_BE16(udp->udp_len_be16);
+  ci_ip_pkt_fmt* pkt = head;
+  unsigned csum;
+  char* ptr = (char*) udp;
+  int n;
+
+  /* A bad length is left for ci_udp_handle_rx() to count. */
+  if( udp->udp_check_be16 == 0 ||
+      udp_len < sizeof(ci_udp_hdr) ||
+      udp_len > CI_BSWAP_BE16(ip->ip_tot_len_be16) - CI_IP4_IHL(ip) )
+    return 1;
+
+  csum = ci_ip_csum_partial(0, &ip->ip_saddr_be32, 8);
+  csum += CI_BSWAPC_BE16(IPPROTO_UDP);
+  csum += udp->udp_len_be16;
+  while( 1 ) {
+    n = CI_MIN(udp_len, oo_offbuf_end(&pkt->buf) - ptr);
+    csum = ci_ip_csum_partial(csum, ptr, n);
+    udp_len -= n;
+    if( udp_len == 0 )
+      break;
+    pkt = PKT_CHK(ni, pkt->frag_next);
+    ptr = oo_offbuf_ptr(&pkt->buf);
+  }
+  return ci_ip_hdr_csum_finish(csum) == 0;
+}
+
+
+/* Turn the complete datagram held by [r] into a multi-buffer packet and
+ * free the slot. */
+static ci_ip_pkt_fmt* ci_ip_reasm_complete(ci_netif* ni, ci_ip_reasm* r)
+{
+  ci_ip_pkt_fmt* head = PKT_CHK(ni, r->frags);
+  ci_ip_pkt_fmt* pkt = head;
+  ci_ip4_hdr* ip = oo_ip_hdr(head);
+  int n_buffers = r->n_pkts;
+  int ihl = CI_IP4_IHL(ip);
+  ci_ip4_hdr* fip;
+
+  ci_assert_equal(ci_ip_reasm_frag_off(ip), 0);
+
+  oo_offbuf_init(&head->buf, PKT_START(head),
+                 oo_pre_l3_len(head) + CI_BSWAP_BE16(ip->ip_tot_len_be16));
+  head->buf_len = oo_offbuf_left(&head->buf);
+  head->pay_len = oo_pre_l3_len(head) + ihl + r->total_len;
+
+  while( 1 ) {
+    pkt->n_buffers = n_buffers--;
+    pkt->frag_next = pkt->next;
+    pkt->next = OO_PP_NULL;
+    if( OO_PP_IS_NULL(pkt->frag_next) )
+      break;
+    pkt = PKT_CHK(ni, pkt->frag_next);
+    fip = oo_ip_hdr(pkt);
+    pkt->buf_len = ci_ip_reasm_frag_len(fip);
+    oo_offbuf_init(&pkt->buf, (char*) fip + CI_IP4_IHL(fip), pkt->buf_len);
+  }
+  ci_assert_equal(n_buffers, 0);
+
+  ni->state->ip_reasm_n_pkts -= r->n_pkts;
+  r->frags = OO_PP_NULL;
+  r->n_pkts = 0;
+
+  ip->ip_tot_len_be16 = CI_BSWAP_BE16((ci_uint16) (ihl + r->total_len));
+  ip->ip_frag_off_be16 &= CI_IP4_FRAG_DONT;
+  ip->ip_check_be16 = ci_ip_checksum(ip);
+
+  if( ! ci_ip_reasm_udp_csum_correct(ni, head) ) {
+    LOG_U(log(LPF "%d BAD UDP CHECKSUM id=%d", NI_ID(ni),
+              (int) CI_BSWAP_BE16(ip->ip_id_be16)));
+    CI_UDP_STATS_INC_IN_ERRS(ni);
+    CITP_STATS_NETIF_INC(ni, ip_reasm_bad);
+    ci_netif_pkt_release_rx_1ref(ni, head);
+    return NULL;
+  }
+
+  CITP_STATS_NETIF_INC(ni, ip_reasm_ok);
+  ASSERT_VALID_PKT(ni, head);
+  return head;
+}
+
+
+/* Offer the IPv4 fragment [*p_pkt] for reassembly.  Returns 0 if it is
+ * not taken, and the caller should deal with it as before.  Otherwise
+ * [*p_pkt] is set to the reassembled datagram if this fragment completed
+ * it, or to NULL.
+ */
+int ci_ip_reasm_rx(ci_netif* ni, ci_ip_pkt_fmt** p_pkt)
+{
+  ci_ip_pkt_fmt* pkt = *p_pkt;
+  ci_ip4_hdr* ip = oo_ip_hdr(pkt);
+  int ihl = CI_IP4_IHL(ip);
+  int off = ci_ip_reasm_frag_off(ip);
+  int len = ci_ip_reasm_frag_len(ip);
+  int more = (ip->ip_frag_off_be16 & CI_IP4_FRAG_MORE) != 0;
+  ci_ip_reasm* r;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE));
+
+  /* Anything we cannot or need not handle goes the way it always did. */
+  if( ip->ip_protocol != IPPROTO_UDP ||
+      (pkt->rx_flags & CI_PKT_RX_FLAG_RX_SHARED) ||
+      OO_PP_NOT_NULL(pkt->frag_next) ||
+      ni->state->mem_pressure ||
+      ihl < sizeof(ci_ip4_hdr) || len <= 0 ||
+      ihl + len > pkt->pay_len - oo_pre_l3_len(pkt) ||
+      (more && (len & 7)) ||
+      ihl + off + len > 0xffff )
+    return 0;
+
+  CITP_STATS_NETIF_INC(ni, ip_reasm_frags);
+  *p_pkt = NULL;
+  r = ci_ip_reasm_find(ni, ip);
+
+  if( (r->total_len >= 0 && (off + len > r->total_len ||
+                             (! more && off + len != r->total_len))) ||
+      ! ci_ip_reasm_insert(ni, r, pkt, off, len) ) {
+    LOG_U(log(LPF "%d BAD fragment id=%d off=%d len=%d more=%d", NI_ID(ni),
+              (int) CI_BSWAP_BE16(ip->ip_id_be16), off, len, more));
+    CITP_STATS_NETIF_INC(ni, ip_reasm_bad);
+    ci_netif_pkt_release_rx_1ref(ni, pkt);
+    ci_ip_reasm_drop(ni, r);
+    return 1;
+  }
+  ++r->n_pkts;
+  ++ni->state->ip_reasm_n_pkts;
+  r->bytes += len;
+  if( ! more ) {
+    /* Nothing already held may lie beyond the end. */
+    ci_ip_pkt_fmt* p = PKT_CHK(ni, r->frags);
+    while( OO_PP_NOT_NULL(p->next) )
+      p = PKT_CHK(ni, p->next);
+    if( p != pkt ) {
+      CITP_STATS_NETIF_INC(ni, ip_reasm_bad);
+      ci_ip_reasm_drop(ni, r);
+      return 1;
+    }
+    r->total_len = off + len;
+  }
+
+  if( r->bytes == r->total_len ) {
+    *p_pkt = ci_ip_reasm_complete(ni, r);
+    return 1;
+  }
+
+  while( ni->state->ip_reasm_n_pkts > NI_OPTS(ni).ip_reasm_max_pkts ) {
+    ci_ip_reasm* victim = ci_ip_reasm_oldest(ni, r);
+    CITP_STATS_NETIF_INC(ni, ip_reasm_evicted);
+    ci_ip_reasm_drop(ni, victim != NULL ? victim : r);
+  }
+  return 1;
+}
+
+
+void ci_ip_reasm_timeout(ci_netif* ni)
+{
+  ci_iptime_t now = ci_ip_time_now(ni);
+  ci_ip_reasm* r;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  for( r = ni->state->ip_reasm;
+       r < ni->state->ip_reasm + CI_CFG_IP_REASM_SLOTS; ++r )
+    if( r->n_pkts != 0 && ! ci_ip_time_before(now, r->expiry) ) {
+      CITP_STATS_NETIF_INC(ni, ip_reasm_timeouts);
+      ci_ip_reasm_drop(ni, r);
+    }
+
+  if( (r = ci_ip_reasm_oldest(ni, NULL)) != NULL )
+    ci_ip_timer_set(ni, &ni->state->ip_reasm_tid, r->expiry);
+}
+
+#endif
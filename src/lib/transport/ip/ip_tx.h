@@ -86,6 +86,23 @@ ci_inline void ci_ip_local_send(ci_netif* ni, ci_ip_pkt_fmt* pkt,
   ni->state->poll_work_outstanding = 1;
 }
 
+/* With EF_TX_VIS, choose the VI on which to send [pkt].  The choice depends
+ * only on [ipcache], so all packets of a socket go to the same TXQ and stay
+ * in order.
+ */
+ci_inline void
+ci_ip_set_tx_q_id(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
+                  ci_ip_pkt_fmt* pkt)
+{
+#if CI_CFG_TX_VIS_MAX > 1
+  int n_vis = ci_netif_num_tx_vis(ni);
+  if( n_vis > 1 )
+    pkt->q_id = onload_hash3(ipcache_laddr(ipcache), 0,
+                             ipcache_raddr(ipcache), ipcache->dport_be16,
+                             ipcache_protocol(ipcache)) % n_vis;
+#endif
+}
+
 ci_inline void
 ci_ip_set_mac_and_port(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
                        ci_ip_pkt_fmt* pkt)
@@ -96,6 +113,7 @@ ci_ip_set_mac_and_port(ci_netif* ni, const ci_ip_cached_hdrs* ipcache,
   memcpy(oo_tx_ether_hdr(pkt), ci_ip_cache_ether_hdr(ipcache),
          oo_tx_ether_hdr_size(pkt));
   pkt->intf_i = ipcache->intf_i;
+  ci_ip_set_tx_q_id(ni, ipcache, pkt);
 #if CI_CFG_PORT_STRIPING
   /* ?? FIXME: This code assumes that the two ports we're striping over
    * have macs that differ only in the bottom bit (both local and remote).
@@ -216,11 +216,7 @@ static inline int ci_ip_tx_timestamping_to_cmsg(int proto, ci_netif* ni,
   errhdr.ee.ee_info = 0;
   if( s->timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID ) {
     if( proto == IPPROTO_TCP ) {
-      errhdr.ee.ee_data = pkt->pf.tcp_tx.end_seq - 1 - s->ts_key;
-      /* FIN and SYN eat seq space, but the user is not interested in them */
-      if( TX_PKT_IPX_TCP(ipcache_af(&s->pkt), pkt)->tcp_flags &
-          (CI_TCP_FLAG_SYN|CI_TCP_FLAG_FIN) )
-        errhdr.ee.ee_data--;
+      errhdr.ee.ee_data = ci_tcp_tx_timestamp_id(s, pkt);
     }
     else {
       errhdr.ee.ee_data = pkt->ts_key;
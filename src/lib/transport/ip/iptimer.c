@@ -206,6 +206,8 @@ void __ci_ip_timer_set(ci_netif *netif, ci_ip_timer *ts, ci_iptime_t t)
 
 /* take the bucket corresponding to time t in the given wheel and 
 ** reinsert them back into the wheel (i.e. into wheelno -1)
+**
+** Returns the number of timers moved.
 */
 static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
 				     ci_iptime_t stime)
@@ -214,7 +216,7 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
   struct oo_p_dllink_state bucket;
   struct oo_p_dllink_state cur;
   oo_p lastp;
-  int changed = 0;
+  int n = 0;
 
   ci_assert(wheelno > 0 && wheelno < CI_IPTIME_WHEELS);
   /* check time is on the boundary expected by the wheel number passed in */
@@ -260,7 +262,7 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
 
     /* insert ts into wheel below */
     bucket = IPTIMER_BUCKET(netif, wheelno-1, ts->time);
-    changed = 1;
+    ++n;
 
     /* append onto the correct bucket 
     **
@@ -273,7 +275,68 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
     if( wheelno == 1 )
       __ci_timer_busy_set(netif, ts->time);
   }
-  return changed;
+  return n;
+}
+
+
+/* EF_TIMER_CASCADE_BUDGET: move timers out of the bucket that each wheel
+** will cascade next, ahead of time, so that a dense bucket doesn't stall
+** a single poll.
+**
+** A timer can't go into the wheel below before its bucket is reached in
+** the ordinary way, because the buckets there that are still to come
+** belong to the current rotation.  But buckets that the wheel below has
+** already passed in this rotation are empty, and won't be looked at again
+** until the next rotation, which is exactly the rotation that the timers
+** in the next bucket belong to.  So a timer can be moved early if its
+** bucket in the wheel below has been passed.  Others are rotated to the
+** back of the list and retried when the clock next advances; whatever is
+** left is cascaded as normal.
+**
+** Returns the number of timers moved into wheel0.
+*/
+static int ci_ip_timer_cascade_early(ci_netif* netif, ci_iptime_t stime,
+                                     int budget)
+{
+  ci_ip_timer* ts;
+  struct oo_p_dllink_state bucket;
+  struct oo_p_dllink_state cur, next;
+  ci_iptime_t span;
+  unsigned passed;
+  int w, n0 = 0;
+
+  for( w = 1; w < CI_IPTIME_WHEELS && budget > 0; ++w ) {
+    span = 1u << (CI_IPTIME_BUCKETBITS * w);
+    bucket = IPTIMER_BUCKET(netif, w, (stime & ~(span - 1)) + span);
+    /* Highest bucket of wheel w-1 already passed in this rotation. */
+    passed = IPTIMER_BUCKETNO(w - 1, stime);
+
+    next = oo_p_dllink_statep(netif, bucket.l->next);
+    while( budget > 0 && ! OO_P_EQ(next.p, bucket.p) ) {
+      cur = next;
+      next = oo_p_dllink_statep(netif, cur.l->next);
+      ts = LINK2TIMER(cur.l);
+      --budget;
+
+      oo_p_dllink_del(netif, cur);
+      if( IPTIMER_BUCKETNO(w - 1, ts->time) <= passed ) {
+        oo_p_dllink_add_tail(netif, IPTIMER_BUCKET(netif, w - 1, ts->time),
+                             cur);
+        if( w == 1 ) {
+          int b = IPTIMER_BUCKETNO(0, ts->time);
+          IPTIMER_STATE(netif)->busy_mask[b/64] |= 1ULL << (b%64);
+          ++n0;
+        }
+        ++netif->state->stats.timer_cascade_early;
+      }
+      else {
+        oo_p_dllink_add_tail(netif, bucket, cur);
+      }
+    }
+  }
+
+  DETAILED_CHECK_TIMERS(netif);
+  return n0;
 }
 
 
@@ -336,6 +399,10 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
     sp = oo_statep_to_sockp(netif, ts->statep);
     ci_tcp_timeout_cork(netif, SP_TO_TCP(netif, sp));
     break;
+  case CI_IP_TIMER_TCP_RACK:
+    sp = oo_statep_to_sockp(netif, ts->statep);
+    ci_tcp_timeout_rack(netif, SP_TO_TCP(netif, sp));
+    break;
   case CI_IP_TIMER_NETIF_TCP_RECYCLE:
     ci_ip_timer_do_recycle(netif);
     break;
@@ -349,6 +416,13 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
     ci_pmtu_timeout_pmtu(netif, &ci_ni_aux_p2aux(netif, pmtu_p)->u.pmtus);
     break;
   }
+  case CI_IP_TIMER_TCP_PACE:
+  {
+    oo_p cong_p = ts->statep;
+    OO_P_ADD(cong_p, -CI_MEMBER_OFFSET(ci_ni_aux_mem, u.cong.pace_tid));
+    ci_tcp_timeout_pace(netif, &ci_ni_aux_p2aux(netif, cong_p)->u.cong);
+    break;
+  }
 #if CI_CFG_TCP_SOCK_STATS
   case CI_IP_TIMER_TCP_STATS:
     sp = oo_statep_to_sockp(netif, ts->statep);
@@ -363,6 +437,19 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
                           CI_IP_STATS_OUTPUT_NONE, NULL, NULL );
     break;
 #endif
+#if CI_CFG_STATS_NETIF
+  case CI_IP_TIMER_NETIF_STATS_PUB:
+    ci_netif_stats_publish(netif);
+    break;
+#endif
+  case CI_IP_TIMER_NETIF_IDLE_RECLAIM:
+    ci_netif_idle_reclaim(netif);
+    break;
+#if CI_CFG_IP_REASM
+  case CI_IP_TIMER_NETIF_IP_REASM:
+    ci_ip_reasm_timeout(netif);
+    break;
+#endif
 #if CI_CFG_IP_TIMER_DEBUG
   case CI_IP_TIMER_DEBUG_HOOK:
     sp = oo_statep_to_sockp(netif, ts->statep);
@@ -382,7 +469,8 @@ void ci_ip_timer_poll(ci_netif *netif) {
   ci_iptime_t* stime = &ipts->sched_ticks;
   ci_ip_timer* ts;
   ci_iptime_t rtime;
-  int changed = 0;
+  int changed = 0, cascaded = 0;
+  ci_uint64 start_frc, end_frc;
   struct oo_p_dllink_state fire_list = oo_p_dllink_ptr(netif,
                                                        &ipts->fire_list);
   struct oo_p_dllink_state bucket;
@@ -398,6 +486,11 @@ void ci_ip_timer_poll(ci_netif *netif) {
   /* check the temp list used is OK before we start */
   OO_P_DLLINK_ASSERT_EMPTY(netif, fire_list);
 
+  if( TIME_LT(*stime, rtime) )
+    ci_frc64(&start_frc);
+  else
+    start_frc = 0;
+
   while( TIME_LT(*stime, rtime) ) {
 
     DETAILED_CHECK_TIMERS(netif);
@@ -407,13 +500,16 @@ void ci_ip_timer_poll(ci_netif *netif) {
 
     /* cascade through wheels if reached end of current wheel */
     if(IPTIMER_BUCKETNO(0, *stime) == 0) {
+      int n;
       if(IPTIMER_BUCKETNO(1, *stime) == 0) {
 	if(IPTIMER_BUCKETNO(2, *stime) == 0) {
-	  ci_ip_timer_cascadewheel(netif, 3, *stime);
+	  cascaded += ci_ip_timer_cascadewheel(netif, 3, *stime);
 	}
-	ci_ip_timer_cascadewheel(netif, 2, *stime);
+	cascaded += ci_ip_timer_cascadewheel(netif, 2, *stime);
       }
-      changed = ci_ip_timer_cascadewheel(netif, 1, *stime);
+      n = ci_ip_timer_cascadewheel(netif, 1, *stime);
+      cascaded += n;
+      changed = n > 0;
     }
 
 
@@ -453,6 +549,20 @@ void ci_ip_timer_poll(ci_netif *netif) {
 
   OO_P_DLLINK_ASSERT_EMPTY(netif, fire_list);
 
+  if( start_frc != 0 ) {
+    if( NI_OPTS(netif).timer_cascade_budget != 0 &&
+        ci_ip_timer_cascade_early(netif, *stime,
+                                  NI_OPTS(netif).timer_cascade_budget) )
+      changed = 1;
+
+    if( (ci_uint32) cascaded > netif->state->stats.timer_cascade_max )
+      netif->state->stats.timer_cascade_max = cascaded;
+    ci_frc64(&end_frc);
+    if( end_frc - start_frc > netif->state->stats.timer_poll_cycles_max )
+      netif->state->stats.timer_poll_cycles_max =
+        (ci_uint32) CI_MIN(end_frc - start_frc, (ci_uint64) 0xffffffff);
+  }
+
   /* What is our next timer?
    * Let's update if our previous "closest" timer have already been
    * handled, or we have cascaded some more timers into wheel0. */
@@ -461,14 +571,34 @@ void ci_ip_timer_poll(ci_netif *netif) {
     ci_iptime_t base = ipts->sched_ticks & IPTIMER_WHEEL0_MASK;
     ci_iptime_t b = ipts->sched_ticks - base;
     int i = b/64;
+    /* Buckets up to and including [b] have been run in this rotation.  They
+     * can only be busy with timers for the next rotation, which have been
+     * cascaded early. */
+    ci_uint64 passed = (2ULL << (b%64)) - 1;
+    ci_uint64 mask;
 
-    /* All the lower bits have been already unset in the bitmask: */
-    ci_assert_nflags(ipts->busy_mask[i], (1ULL << (b%64)) - 1);
+    ci_assert_impl(NI_OPTS(netif).timer_cascade_budget == 0,
+                   (ipts->busy_mask[i] & passed) == 0);
 
     /* We peek into the wheel0 */
     for( ; i < 4; i++ ) {
-      if( ipts->busy_mask[i] != 0 ) {
-        ipts->closest_timer = base + i*64 + ci_ffs64(ipts->busy_mask[i]) - 1;
+      mask = ipts->busy_mask[i];
+      if( i == b/64 )
+        mask &= ~passed;
+      if( mask != 0 ) {
+        ipts->closest_timer = base + i*64 + ci_ffs64(mask) - 1;
+        return;
+      }
+    }
+
+    /* Then into the buckets that we've passed. */
+    for( i = 0; i <= b/64; i++ ) {
+      mask = ipts->busy_mask[i];
+      if( i == b/64 )
+        mask &= passed;
+      if( mask != 0 ) {
+        ipts->closest_timer = base + CI_IPTIME_BUCKETS + i*64 +
+                              ci_ffs64(mask) - 1;
         return;
       }
     }
@@ -525,6 +655,10 @@ void ci_ip_timer_state_assert_valid(ci_netif* ni, const char* file, int line)
       /* max and min relative times for this bucket */
       bit_shift = CI_IPTIME_BUCKETBITS*w;
       min_time = wheel_base + (b << bit_shift);
+      /* Buckets already passed in this rotation can only hold timers for
+       * the next one: see ci_ip_timer_cascade_early(). */
+      if( w < CI_IPTIME_WHEELS - 1 && b <= IPTIMER_BUCKETNO(w, stime) )
+        min_time += CI_IPTIME_BUCKETS << bit_shift;
       max_time = min_time   + (1 << bit_shift);
 
       bucket = oo_p_dllink_ptr(ni, &ipts->warray[w*CI_IPTIME_BUCKETS + b]);
@@ -582,12 +716,21 @@ static const char* ci_ip_timer_dump(const ci_ip_timer* ts)
     MAKECASE(CI_IP_TIMER_TCP_KALIVE,   "kalive")
     MAKECASE(CI_IP_TIMER_TCP_LISTEN,   "listen")
     MAKECASE(CI_IP_TIMER_TCP_CORK,     "cork")
+    MAKECASE(CI_IP_TIMER_TCP_RACK,     "rack")
     MAKECASE(CI_IP_TIMER_NETIF_TIMEOUT, "netif")
     MAKECASE(CI_IP_TIMER_PMTU_DISCOVER, "pmtu")
+    MAKECASE(CI_IP_TIMER_TCP_PACE,      "pace")
+    MAKECASE(CI_IP_TIMER_NETIF_IDLE_RECLAIM, "idle-reclaim")
+#if CI_CFG_IP_REASM
+    MAKECASE(CI_IP_TIMER_NETIF_IP_REASM, "ip-reasm")
+#endif
 #if CI_CFG_SUPPORT_STATS_COLLECTION
     MAKECASE(CI_IP_TIMER_TCP_STATS,     "tcp-stats")
     MAKECASE(CI_IP_TIMER_NETIF_STATS,   "ni-stats")
 #endif
+#if CI_CFG_STATS_NETIF
+    MAKECASE(CI_IP_TIMER_NETIF_STATS_PUB, "ni-stats-pub")
+#endif
 #if CI_CFG_IP_TIMER_DEBUG
     MAKECASE(CI_IP_TIMER_DEBUG_HOOK,     "debug")
 #endif
@@ -632,6 +775,10 @@ void ci_ip_timer_state_dump(ci_netif* ni)
       /* max and min relative times for this bucket */
       bit_shift = CI_IPTIME_BUCKETBITS*w;
       min_time = wheel_base + (b << bit_shift);
+      /* Buckets already passed in this rotation can only hold timers for
+       * the next one: see ci_ip_timer_cascade_early(). */
+      if( w < CI_IPTIME_WHEELS - 1 && b <= IPTIMER_BUCKETNO(w, stime) )
+        min_time += CI_IPTIME_BUCKETS << bit_shift;
       max_time = min_time   + (1 << bit_shift);
 
       bucket = oo_p_dllink_ptr(ni, &ipts->warray[w*CI_IPTIME_BUCKETS + b]);
@@ -50,6 +50,10 @@ LIB_SRCS	:=		\
 		common_sockopts.c \
 		tcp_sockopts.c	\
 		tcp_syncookie.c	\
+		tcp_cong.c	\
+		tcp_flight.c	\
+		tcp_rack.c	\
+		ip_reasm.c	\
 		active_wild.c	\
 		pkt_checksum.c	\
 		netif_dtor.c	\
@@ -68,6 +72,7 @@ LIB_SRCS	+=		\
 		tcp_helper.c	\
 		syscall.c	\
 		per_thread.c	\
+		spin_adapt.c	\
 		rwlock.c
 endif
 
@@ -119,6 +119,12 @@ void ci_netif_timeout_remove(ci_netif* ni, ci_tcp_state* ts)
   /* remove from the list */
   oo_p_dllink_del_init(ni, link);
 
+  if( ts->tcpflags & CI_TCPT_FLAG_TW_COMPACT ) {
+    ts->tcpflags &= ~CI_TCPT_FLAG_TW_COMPACT;
+    ci_assert_gt(ni->state->tw_compact_pending, 0);
+    --ni->state->tw_compact_pending;
+  }
+
   /* if needed re-set or clear timer */
   if( ! is_first )
     return;
@@ -234,11 +240,17 @@ ci_netif_timeout_state(ci_netif* ni)
 void ci_netif_timeout_restart(ci_netif *ni, ci_tcp_state *ts)
 {
   int is_tw = (ts->s.b.state == CI_TCP_TIME_WAIT);
+  ci_uint32 compact = ts->tcpflags & CI_TCPT_FLAG_TW_COMPACT;
   ci_assert(ts);
   ci_assert( is_tw || ci_tcp_is_timeout_orphan(ts));
 
   /* take it off the list */
   ci_netif_timeout_remove(ni, ts);
+  /* ...but it is still waiting to be compacted */
+  if( compact ) {
+    ts->tcpflags |= compact;
+    ++ni->state->tw_compact_pending;
+  }
   /* store time to leave TIMEWAIT state */
   ts->t_last_sent = ci_ip_time_now(ni) +
       ( is_tw ?
@@ -250,6 +262,27 @@ void ci_netif_timeout_restart(ci_netif *ni, ci_tcp_state *ts)
 }
 
 
+/* Whether [ts], about to enter TIME_WAIT, can be moved to the compact
+ * TIME_WAIT table.  The table's entries have no filter of their own, so the
+ * peer's segments must keep arriving at the listening socket: only accepted
+ * IPv4 connections that share the listener's filter qualify.  The
+ * application must have finished with the socket too.
+ */
+static int /*bool*/ ci_netif_timewait_may_compact(ci_netif* ni,
+                                                  ci_tcp_state* ts)
+{
+  return ni->state->tw_table_entries_n != 0 &&
+         (ts->s.b.sb_aflags & CI_SB_AFLAG_ORPHAN) &&
+#if CI_CFG_FD_CACHING
+         ! (ts->s.b.sb_aflags & CI_SB_AFLAG_IN_CACHE) &&
+#endif
+         (ts->tcpflags & CI_TCPT_FLAG_PASSIVE_OPENED) &&
+         ! (ts->s.s_flags & CI_SOCK_FLAG_FILTER) &&
+         OO_SP_IS_NULL(ts->local_peer) &&
+         ! ipcache_is_ipv6(&ts->s.pkt);
+}
+
+
 /*
 ** - add a connection to the timewait queue,
 ** - stop its timers
@@ -281,6 +314,16 @@ void ci_netif_timewait_enter(ci_netif* ni, ci_tcp_state* ts)
   ts->t_last_sent = ci_ip_time_now(ni) + NI_CONF(ni).tconst_2msl_time;
   /* add to list */
   ci_netif_timeout_add(ni, ts, OO_TIMEOUT_Q_TIMEWAIT);
+
+  /* The caller is still using [ts], so ci_netif_timewait_compact() frees
+   * the endpoint at the end of the poll. */
+  if( ci_netif_timewait_may_compact(ni, ts) ) {
+    ts->tcpflags |= CI_TCPT_FLAG_TW_COMPACT;
+    ++ni->state->tw_compact_pending;
+  }
+  else {
+    CITP_STATS_NETIF_INC(ni, tcp_tw_full);
+  }
 }
 
 
@@ -325,6 +368,148 @@ int ci_netif_timewait_try_to_free_filter(ci_netif* ni)
 }
 
 
+/*--------------------------------------------------------------------
+ *
+ * Compact TIME_WAIT table
+ *
+ *--------------------------------------------------------------------*/
+
+#define CI_TCP_TW_COMPACT_DEPTH 8
+
+ci_inline unsigned ci_tcp_tw_compact_hash1(ci_netif* ni, ci_uint32 laddr_be32,
+                                           ci_uint16 lport_be16,
+                                           ci_uint32 raddr_be32,
+                                           ci_uint16 rport_be16)
+{
+  return __onload_hash1(ni->state->tw_table_entries_n - 1,
+                        laddr_be32, lport_be16, raddr_be32, rport_be16,
+                        IPPROTO_TCP);
+}
+
+
+ci_inline unsigned ci_tcp_tw_compact_hash2(ci_uint32 laddr_be32,
+                                           ci_uint16 lport_be16,
+                                           ci_uint32 raddr_be32,
+                                           ci_uint16 rport_be16)
+{
+  return __onload_hash2(laddr_be32, lport_be16, raddr_be32, rport_be16,
+                        IPPROTO_TCP);
+}
+
+
+ci_inline int /*bool*/ ci_tcp_tw_compact_is_live(ci_netif* ni,
+                                                 const ci_tcp_tw_compact_t* tw)
+{
+  return tw->lport_be16 != 0 &&
+         ! ci_ip_time_before(tw->expiry, ci_ip_time_now(ni));
+}
+
+
+/* Returns the live entry for the given four-tuple, or NULL. */
+ci_tcp_tw_compact_t*
+ci_tcp_tw_compact_lookup(ci_netif* ni, ci_uint32 laddr_be32,
+                         ci_uint16 lport_be16, ci_uint32 raddr_be32,
+                         ci_uint16 rport_be16)
+{
+  unsigned hash, hash2;
+  int depth;
+
+  if( ni->state->tw_table_entries_n == 0 )
+    return NULL;
+
+  hash = ci_tcp_tw_compact_hash1(ni, laddr_be32, lport_be16,
+                                 raddr_be32, rport_be16);
+  hash2 = ci_tcp_tw_compact_hash2(laddr_be32, lport_be16,
+                                  raddr_be32, rport_be16);
+  for( depth = 0; depth < CI_TCP_TW_COMPACT_DEPTH; ++depth ) {
+    ci_tcp_tw_compact_t* tw = &ni->tw_table[hash];
+    if( tw->lport_be16 == lport_be16 && tw->rport_be16 == rport_be16 &&
+        tw->laddr_be32 == laddr_be32 && tw->raddr_be32 == raddr_be32 )
+      return ci_tcp_tw_compact_is_live(ni, tw) ? tw : NULL;
+    hash = (hash + hash2) & (ni->state->tw_table_entries_n - 1);
+  }
+  return NULL;
+}
+
+
+/* Records [ts] in the compact TIME_WAIT table.  Entries are not moved once
+ * inserted, so the first free or expired slot on the probe path is taken.
+ * Returns false if there is none.
+ */
+static int /*bool*/ ci_tcp_tw_compact_insert(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint32 laddr_be32 = tcp_laddr_be32(ts);
+  ci_uint32 raddr_be32 = tcp_raddr_be32(ts);
+  ci_uint16 lport_be16 = tcp_lport_be16(ts);
+  ci_uint16 rport_be16 = tcp_rport_be16(ts);
+  ci_uint32 wnd;
+  unsigned hash, hash2;
+  int depth;
+
+  hash = ci_tcp_tw_compact_hash1(ni, laddr_be32, lport_be16,
+                                 raddr_be32, rport_be16);
+  hash2 = ci_tcp_tw_compact_hash2(laddr_be32, lport_be16,
+                                  raddr_be32, rport_be16);
+  for( depth = 0; depth < CI_TCP_TW_COMPACT_DEPTH; ++depth ) {
+    ci_tcp_tw_compact_t* tw = &ni->tw_table[hash];
+    if( ! ci_tcp_tw_compact_is_live(ni, tw) ) {
+      tw->laddr_be32 = laddr_be32;
+      tw->raddr_be32 = raddr_be32;
+      tw->lport_be16 = lport_be16;
+      tw->rport_be16 = rport_be16;
+      tw->snd_nxt = tcp_snd_nxt(ts);
+      tw->rcv_nxt = tcp_rcv_nxt(ts);
+      tw->tso = !! (ts->tcpflags & CI_TCPT_FLAG_TSO);
+      tw->tsrecent = ts->tsrecent;
+      tw->expiry = ts->t_last_sent;
+      wnd = tcp_rcv_wnd_advertised(ts) >> ts->rcv_wscl;
+      tw->window_be16 = CI_BSWAP_BE16((ci_uint16) CI_MIN(wnd, 0xffff));
+      return 1;
+    }
+    hash = (hash + hash2) & (ni->state->tw_table_entries_n - 1);
+  }
+  return 0;
+}
+
+
+/* Moves the TIME_WAIT connections marked by ci_netif_timewait_enter() to
+ * the compact table, and frees their endpoints.  They were added at the
+ * tail of the TIME_WAIT queue, so look there.
+ */
+void ci_netif_timewait_compact(ci_netif* ni)
+{
+  struct oo_p_dllink_state list =
+          oo_p_dllink_ptr(ni, &ni->state->timeout_q[OO_TIMEOUT_Q_TIMEWAIT]);
+  struct oo_p_dllink_state l = oo_p_dllink_statep(ni, list.l->prev);
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  while( ni->state->tw_compact_pending != 0 && l.l != list.l ) {
+    ci_tcp_state* ts = TCP_STATE_FROM_LINK(l.l);
+    l = oo_p_dllink_statep(ni, l.l->prev);
+
+    if( ~ts->tcpflags & CI_TCPT_FLAG_TW_COMPACT )
+      continue;
+    ci_assert_equal(ts->s.b.state, CI_TCP_TIME_WAIT);
+
+    if( ci_tcp_tw_compact_insert(ni, ts) ) {
+      LOG_TC(log(LPF "%d TIME_WAIT compacted", S_FMT(ts)));
+      CITP_STATS_NETIF_INC(ni, tcp_tw_compact);
+      /* ci_tcp_drop() takes it off the TIME_WAIT queue and clears its
+       * mark, via ci_netif_timeout_remove(). */
+      ci_tcp_drop(ni, ts, 0);
+    }
+    else {
+      ts->tcpflags &= ~CI_TCPT_FLAG_TW_COMPACT;
+      --ni->state->tw_compact_pending;
+      CITP_STATS_NETIF_INC(ni, tcp_tw_compact_no_room);
+      CITP_STATS_NETIF_INC(ni, tcp_tw_full);
+    }
+  }
+  ci_assert_equal(ni->state->tw_compact_pending, 0);
+}
+
+
 /*--------------------------------------------------------------------
  *
  * FIN_WAIT2 handling
@@ -470,6 +655,56 @@ void ci_netif_try_to_reap(ci_netif* ni, int stop_once_freed_n)
 }
 
 
+/* Number of endpoints looked at each time the idle reclaim timer fires. */
+#define IDLE_RECLAIM_BATCH  256
+
+void ci_netif_idle_reclaim(ci_netif* ni)
+{
+  /* Once the application has read everything, a TCP socket still keeps
+   * the last packet of its receive queue.  Normally that is only freed
+   * when the stack is short of buffers, which leaves a stack with very
+   * many idle connections holding a buffer for each of them.  Free it
+   * from sockets that have not received for a while, a batch of endpoints
+   * at a time, pacing the batches so that a full pass takes about
+   * EF_TCP_IDLE_RECLAIM_MS.
+   */
+  ci_iptime_t idle = ci_tcp_time_ms2ticks(ni, NI_OPTS(ni).tcp_idle_reclaim_ms);
+  ci_iptime_t now = ci_tcp_time_now(ni);
+  ci_uint32 n_ep = ni->state->n_ep_bufs;
+  ci_uint32 id = ni->state->idle_reclaim_next;
+  ci_uint32 n_batches;
+  int i;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  for( i = 0; i < IDLE_RECLAIM_BATCH && n_ep != 0; ++i, ++id ) {
+    citp_waitable_obj* wo;
+    ci_tcp_state* ts;
+
+    if( id >= n_ep )
+      id = 0;
+    wo = ID_TO_WAITABLE_OBJ(ni, id);
+    if( ! (wo->waitable.state & CI_TCP_STATE_TCP_CONN) )
+      continue;
+    ts = &wo->tcp;
+    if( OO_PP_IS_NULL(ts->recv1_extract) || tcp_rcv_usr(ts) != 0 ||
+        ci_ip_time_before(now, ts->t_last_recv_payload + idle) )
+      continue;
+    if( ci_sock_trylock(ni, &ts->s.b) ) {
+      ci_int32 q_num_b4 = ts->recv1.num;
+      ci_tcp_rx_reap_rxq_bufs_socklocked(ni, ts);
+      CITP_STATS_NETIF_ADD(ni, tcp_idle_reclaimed, q_num_b4 - ts->recv1.num);
+      ci_sock_unlock(ni, &ts->s.b);
+    }
+  }
+  ni->state->idle_reclaim_next = id;
+
+  n_batches = CI_MAX(n_ep / IDLE_RECLAIM_BATCH, 1);
+  ci_ip_timer_set(ni, &ni->state->idle_reclaim_tid,
+                  now + CI_MAX(idle / n_batches, 1));
+}
+
+
 void ci_netif_rxq_low_on_recv(ci_netif* ni, ci_sock_cmn* s,
                               int bytes_freed)
 {
@@ -718,6 +953,9 @@ int ci_netif_rx_post(ci_netif* netif, int intf_i, ef_vi* vi)
   int max_n_to_post, rx_allowed, n_to_post, n_posted = 0;
   int bufset_id = NI_PKT_SET(netif);
   int ask_for_more_packets = 0;
+  /* With EF_PKT_NUMA, the node that receive buffers should be on. */
+  int nic_node = NI_OPTS(netif).pkt_numa ?
+                 netif->state->nic[intf_i].numa_node : -1;
 
   if( vi->nic_type.arch == EF_VI_ARCH_EFCT )
     return 0;
@@ -733,8 +971,10 @@ int ci_netif_rx_post(ci_netif* netif, int intf_i, ef_vi* vi)
 
   ci_assert_ge(max_n_to_post, CI_CFG_RX_DESC_BATCH);
   /* We could have enough packets in all sets together, but we need them
-   * in one set. */
-  if( netif->packets->set[bufset_id].n_free < CI_CFG_RX_DESC_BATCH )
+   * in one set.  A set on an unknown node is not moved away from. */
+  if( netif->packets->set[bufset_id].n_free < CI_CFG_RX_DESC_BATCH ||
+      (nic_node >= 0 && netif->packets->set[bufset_id].numa_node >= 0 &&
+       netif->packets->set[bufset_id].numa_node != nic_node) )
     goto find_new_bufset;
 
  good_bufset:
@@ -756,7 +996,11 @@ int ci_netif_rx_post(ci_netif* netif, int intf_i, ef_vi* vi)
     }
 
  find_new_bufset:
-    bufset_id = ci_netif_pktset_best(netif);
+    if( nic_node >= 0 )
+      bufset_id = ci_netif_pktset_best_node(netif, nic_node,
+                                            CI_CFG_RX_DESC_BATCH);
+    else
+      bufset_id = ci_netif_pktset_best(netif);
     if( bufset_id == -1 ||
         netif->packets->set[bufset_id].n_free < CI_CFG_RX_DESC_BATCH )
       goto not_enough_pkts;
@@ -816,6 +1060,23 @@ int ci_netif_rx_post(ci_netif* netif, int intf_i, ef_vi* vi)
    * allocate more packets when time allows: */
   ask_for_more_packets = 1;
 
+  if( nic_node >= 0 ) {
+    /* A new set on the NIC's node is better than buffers from a set on
+     * another node, so try that first. */
+    if( netif->packets->sets_n < netif->packets->sets_max &&
+        ci_tcp_helper_more_bufs(netif, intf_i) == 0 ) {
+      bufset_id = netif->packets->sets_n - 1;
+      ask_for_more_packets = 0;
+      goto good_bufset;
+    }
+    bufset_id = ci_netif_pktset_best(netif);
+    if( bufset_id != -1 &&
+        netif->packets->set[bufset_id].n_free >= CI_CFG_RX_DESC_BATCH ) {
+      CITP_STATS_NETIF_INC(netif, pkt_set_numa_remote);
+      goto good_bufset;
+    }
+  }
+
   /* Grab buffers from the non-blocking pool. */
   while( (pkt = ci_netif_pkt_alloc_nonb(netif)) != NULL ) {
     --netif->state->n_async_pkts;
@@ -828,8 +1089,8 @@ int ci_netif_rx_post(ci_netif* netif, int intf_i, ef_vi* vi)
   }
 
   /* Still not enough -- allocate more memory if possible. */
-  if( netif->packets->sets_n < netif->packets->sets_max &&
-      ci_tcp_helper_more_bufs(netif) == 0 ) {
+  if( nic_node < 0 && netif->packets->sets_n < netif->packets->sets_max &&
+      ci_tcp_helper_more_bufs(netif, intf_i) == 0 ) {
     bufset_id = netif->packets->sets_n - 1;
     ci_assert_equal(netif->packets->set[bufset_id].n_free,
                     1 << CI_CFG_PKTS_PER_SET_S);
@@ -1170,7 +1431,7 @@ ci_uint64 ci_netif_unlock_slow_common(ci_netif* ni, ci_uint64 lock_val,
       oo_want_proactive_packet_allocation(ni) ) {
     /* assume caller always asks to handle this flag */
     ci_assert_flags(flags_to_handle, CI_EPLOCK_NETIF_NEED_PKT_SET);
-    ci_tcp_helper_more_bufs(ni);
+    ci_tcp_helper_more_bufs(ni, -1);
   }
 
   if( test_val & CI_EPLOCK_NETIF_NEED_SOCK_BUFS ) {
@@ -1287,6 +1548,10 @@ void ci_netif_unlock(ci_netif* ni)
   ci_assert_nflags(ni->state->flags, CI_NETIF_FLAG_PKT_ACCOUNT_PENDING);
 
   ci_assert_equal(ni->state->in_poll, 0);
+#if OO_LOCK_PROFILE
+  if(CI_UNLIKELY( NI_OPTS(ni).lock_profile ))
+    ci_netif_lock_profile_released(ni);
+#endif
   if(CI_LIKELY( ni->state->lock.lock == CI_EPLOCK_LOCKED &&
                 ci_cas64u_succeed(&ni->state->lock.lock,
                                   CI_EPLOCK_LOCKED, 0) ))
@@ -1621,7 +1886,6 @@ ci_netif_get_active_wild_list(ci_netif* ni, int aw_pool, ci_addr_t laddr)
 
 
 #ifndef __KERNEL__
-#ifndef NDEBUG
 static int __ci_netif_active_wild_rss_ok(ci_netif* ni,
                                          ci_addr_t laddr, ci_uint16 lport,
                                          ci_addr_t raddr, ci_uint16 rport)
@@ -1647,7 +1911,6 @@ static int __ci_netif_active_wild_rss_ok(ci_netif* ni,
     return 0;
 
 }
-#endif
 
 
 static int __ci_netif_active_wild_pool_select(ci_netif* ni, ci_addr_t laddr,
@@ -1749,9 +2012,16 @@ static oo_sp __ci_netif_active_wild_pool_get(ci_netif* ni, int aw_pool,
 
     /* We should have been provided with a list of active wilds where the
      * local port will direct to this stack when used with the provided
-     * 3-tuple.
+     * 3-tuple.  That relies on the pool placement matching the NIC's RSS
+     * spreading, so check the full 4-tuple before handing the port out:
+     * a port that hashes to another cluster member would have its replies
+     * land on the wrong stack.
      */
-    ci_assert(__ci_netif_active_wild_rss_ok(ni, laddr, lport, raddr, rport));
+    if(CI_UNLIKELY( ! __ci_netif_active_wild_rss_ok(ni, laddr, lport,
+                                                    raddr, rport) )) {
+      CITP_STATS_NETIF_INC(ni, tcp_shared_local_ports_skipped_rss);
+      goto skip;
+    }
 
     sp = ci_netif_filter_lookup(ni, af_space, laddr, lport, raddr, rport,
                                 sock_protocol(&aw->s));
@@ -1806,6 +2076,7 @@ static oo_sp __ci_netif_active_wild_pool_get(ci_netif* ni, int aw_pool,
       *port_out = lport;
       return SC_SP(&aw->s);
     }
+  skip:
     CITP_STATS_NETIF_INC(ni, tcp_shared_local_ports_skipped);
 
     /* We never remove any entry from the list, we push the entries to the
@@ -1952,6 +2223,52 @@ void oo_tcpdump_free_pkts(ci_netif* ni, ci_uint16 i)
 #endif
 
 
+#if CI_CFG_PKT_SAMPLE
+void oo_pkt_sample_copy(ci_netif* ni, ci_ip_pkt_fmt* pkt, int is_tx)
+{
+  ci_netif_state* ns = ni->state;
+  ci_uint32 write_i;
+  ci_pkt_sample* s;
+  int caplen;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( ns->pkt_sample_countdown > 1 ) {
+    --ns->pkt_sample_countdown;
+    return;
+  }
+  ns->pkt_sample_countdown = ns->pkt_sample_every;
+
+  /* Only the first buffer of a chain is copied, which always holds the
+   * headers. */
+  caplen = CI_MIN(pkt->pay_len, (int) ns->pkt_sample_snaplen);
+  caplen = CI_MIN(caplen, CI_CFG_PKT_SAMPLE_SNAPLEN);
+  if( pkt->n_buffers > 1 )
+    caplen = CI_MIN(caplen, pkt->buf_len);
+  if( caplen < 0 )
+    return;
+
+  write_i = ns->pkt_sample_write_i;
+  s = &ns->pkt_sample_ring[write_i % CI_CFG_PKT_SAMPLE_RING_LEN];
+  s->seq = ~0u;
+  ci_wmb();
+  s->len = pkt->pay_len;
+  s->caplen = caplen;
+  s->intf_i = pkt->intf_i;
+  s->is_tx = is_tx;
+  if( is_tx || pkt->tstamp_frc == 0 )
+    ci_frc64(&s->frc);
+  else
+    s->frc = pkt->tstamp_frc;
+  memcpy(s->data, oo_ether_hdr(pkt), caplen);
+  ci_wmb();
+  s->seq = write_i;
+  ci_wmb();
+  ns->pkt_sample_write_i = write_i + 1;
+}
+#endif
+
+
 #if CI_CFG_UL_INTERRUPT_HELPER && ! defined(__KERNEL__)
 
 static void sw_update_cb(void* arg, void* data)
@@ -11,6 +11,7 @@
 
 /*! \cidoxg_lib_transport_ip */
 #include "ip_internal.h"
+#include "netif_tx.h"
 #include "uk_intf_ver.h"
 #include <onload/version.h>
 #include <onload/sleep.h>
@@ -54,8 +55,10 @@ static void ci_netif_state_assert_valid(ci_netif* ni,
   /* check DMAQ overflow queue if non-empty */
   OO_STACK_FOR_EACH_INTF_I(ni, intf_i) {
     int i;
-    for( i = 0; i < ci_netif_num_vis(ni); ++i ) {
-      oo_pktq* dmaq = &nis->nic[intf_i].dmaq[i];
+    /* The last iteration checks the bulk queue. */
+    for( i = 0; i <= ci_netif_num_vis(ni); ++i ) {
+      oo_pktq* dmaq = i < ci_netif_num_vis(ni) ? &nis->nic[intf_i].dmaq[i] :
+                                                 &nis->nic[intf_i].dmaq_bulk;
       if( OO_PP_NOT_NULL(dmaq->head) ) {
         verify( IS_VALID_PKT_ID(ni, dmaq->head) );
         verify( IS_VALID_PKT_ID(ni, dmaq->tail) );
@@ -297,7 +300,8 @@ static void ci_netif_dump_pkt_summary(ci_netif* ni, oo_dump_log_fn_t logger,
          ni->packets->sets_n);
 
   for( i = 0; i < ni->packets->sets_n; i++ ) {
-    logger(log_arg, "  pkt_set[%d]: free=%d%s", i, ni->packets->set[i].n_free,
+    logger(log_arg, "  pkt_set[%d]: free=%d node=%d%s", i,
+           ni->packets->set[i].n_free, ni->packets->set[i].numa_node,
            i == ni->packets->id ? " current" : "");
   }
 
@@ -311,6 +315,7 @@ static void ci_netif_dump_pkt_summary(ci_netif* ni, oo_dump_log_fn_t logger,
       tx_ring += ef_vi_transmit_fill_level(pvi);
       tx_oflow += ns->nic[intf_i].dmaq[i].num;
     }
+    tx_oflow += ns->nic[intf_i].dmaq_bulk.num;
   }
   used = ni->packets->n_pkts_allocated - ni->packets->n_free - ns->n_async_pkts;
   rx_queued = ns->n_rx_pkts - rx_ring - ns->mem_pressure_pkt_pool_n;
@@ -706,6 +711,42 @@ void ci_stack_time_dump(ci_netif* ni, oo_dump_log_fn_t logger, void* log_arg)
 }
 
 
+#if CI_CFG_TX_ADAPTIVE
+static void ci_netif_dump_tx_adapt(ci_netif* ni, int intf_i,
+                                   oo_dump_log_fn_t logger, void* log_arg)
+{
+  static const char* const mech_names[CI_TX_MECH_N] = {
+    [CI_TX_MECH_DMA] = "dma",
+    [CI_TX_MECH_PIO] = "pio",
+    [CI_TX_MECH_CTPIO] = "ctpio",
+  };
+  const ci_tx_adapt_t* ta = &ni->state->nic[intf_i].tx_adapt;
+  const ci_tx_adapt_entry_t* e;
+  int bucket, mech, pref, last;
+
+  logger(log_arg, "  tx_adapt: decisions=%u (per mechanism: "
+         "attempts/fallbacks lat_cycles fallback_pct)", ta->n_decisions);
+  for( bucket = 0; bucket < CI_TX_ADAPT_N_BUCKETS; ++bucket ) {
+    char line[160];
+    int n = 0;
+    e = &ta->entry[bucket * CI_TX_MECH_N];
+    pref = -1;
+    for( mech = CI_TX_MECH_N - 1; mech >= 0; --mech ) {
+      n += snprintf(line + n, sizeof(line) - n, " %s=%u/%u %u %u%%",
+                    mech_names[mech], e[mech].attempts, e[mech].fallbacks,
+                    e[mech].lat_ewma, (e[mech].fallback_ewma * 100) >> 16);
+      if( pref < 0 && e[mech].lat_ewma != 0 )
+        pref = mech;
+    }
+    last = bucket == CI_TX_ADAPT_N_BUCKETS - 1;
+    logger(log_arg, "  tx_adapt[%s%d]:%s best=%s", last ? ">" : "<=",
+           1 << (bucket + CI_TX_ADAPT_BUCKET_MIN_ORDER - last), line,
+           pref < 0 ? "-" :
+           mech_names[ci_tx_adapt_best(e, (1u << CI_TX_MECH_N) - 1, pref)]);
+  }
+}
+#endif
+
 static void ci_netif_dump_vi(ci_netif* ni, int intf_i, oo_dump_log_fn_t logger,
                              void* log_arg)
 {
@@ -760,11 +801,13 @@ static void ci_netif_dump_vi(ci_netif* ni, int intf_i, oo_dump_log_fn_t logger,
   }
   for( i = 0; i < ci_netif_num_vis(ni); ++i )
     sum_dmaq_num += nic->dmaq[i].num;
-  logger(log_arg, "  txq: cap=%d lim=%d spc=%d level=%d pkts=%d oflow_pkts=%d",
+  sum_dmaq_num += nic->dmaq_bulk.num;
+  logger(log_arg, "  txq: cap=%d lim=%d spc=%d level=%d pkts=%d oflow_pkts=%d "
+         "bulk_pkts=%d",
          ef_vi_transmit_capacity(vi), ef_vi_transmit_capacity(vi),
          ef_vi_transmit_space(vi), ef_vi_transmit_fill_level(vi),
          nic->tx_dmaq_insert_seq - nic->tx_dmaq_done_seq - sum_dmaq_num,
-         nic->dmaq[0].num);
+         nic->dmaq[0].num, nic->dmaq_bulk.num);
   logger(log_arg, "  txq: pio_buf_size=%d tot_pkts=%d bytes=%d",
 #if CI_CFG_PIO
          nic->pio_io_len,
@@ -803,6 +846,10 @@ static void ci_netif_dump_vi(ci_netif* ni, int intf_i, oo_dump_log_fn_t logger,
   logger(log_arg, "  ctpio: max_frame_len=%u frame_len_check=%u ct_thresh=%u",
          nic->ctpio_max_frame_len, nic->ctpio_frame_len_check,
          nic->ctpio_ct_threshold);
+#endif
+#if CI_CFG_TX_ADAPTIVE
+  if( NI_OPTS(ni).tx_adaptive )
+    ci_netif_dump_tx_adapt(ni, intf_i, logger, log_arg);
 #endif
   if( nic->nic_error_flags )
     logger(log_arg, "  ERRORS: "CI_NETIF_NIC_ERRORS_FMT,
@@ -963,6 +1010,8 @@ void ci_netif_dump_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
 
   logger(log_arg, "  sock_bufs: max=%u n_allocated=%u free=%u",
          NI_OPTS(ni).max_ep_bufs, ns->n_ep_bufs, ns->free_eps_num);
+  logger(log_arg, "  sock_buf_chunks: n=%u huge=%u state_bytes=%u",
+         ns->sock_buf_chunks, ns->sock_buf_huge_chunks, ns->ep_ofs);
   /* aux buffers number is limited by tcp_synrecv_max*2 */
   logger(log_arg, "  aux_bufs: free=%u",
          ns->n_free_aux_bufs);
@@ -993,6 +1042,18 @@ void ci_netif_dump_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
              (int)(ci_uint16) (dwi - dri), CI_CFG_DUMPQUEUE_LEN, dwi, dri);
   }
 
+  for( i = 0; i < (int) ns->rx_drop_rules_n; ++i ) {
+    const ci_rx_drop_rule* r = &ns->rx_drop_rules[i];
+    if( ! r->in_use )
+      continue;
+    logger(log_arg, "  rx_drop_rule[%d]: src="CI_IP_PRINTF_FORMAT"/%u "
+           "proto=%u dport=%u rate=%u matched=%"CI_PRIu64" dropped=%"CI_PRIu64,
+           i, CI_IP_PRINTF_ARGS(&r->saddr_be32),
+           ci_ip_mask2prefix(CI_BSWAP_BE32(r->smask_be32)),
+           (unsigned) r->protocol, (unsigned) CI_BSWAP_BE16(r->dport_be16),
+           r->rate_pps, r->n_matched, r->n_dropped);
+  }
+
 #if CI_CFG_FD_CACHING
   logger(log_arg, "  active cache: hit=%d avail=%d cache=%s pending=%s",
          ns->stats.activecache_hit,
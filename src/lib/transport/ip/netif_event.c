@@ -113,6 +113,10 @@ static int ci_tcp_csum_correct(ci_ip_pkt_fmt* pkt, int ip_paylen)
 }
 
 
+/* Only a single 802.1Q tag is handled here.  Overlay traffic such as VXLAN
+ * never reaches a stack: the control plane does not accelerate tunnel
+ * interfaces, so no filters are installed for the inner flows.
+ */
 static void ci_parse_rx_vlan(ci_ip_pkt_fmt* pkt)
 {
   uint16_t* p_ether_type;
@@ -256,6 +260,63 @@ static inline unsigned unexpected_rx_log_flag(ci_ip_pkt_fmt* pkt)
          CI_TP_LOG_NR : CI_TP_LOG_U;
 }
 
+/* Takes a token from the bucket of a rate-limited drop rule.  The bucket
+ * holds up to one second's worth of tokens.  Returns zero if it is empty. */
+static int rx_drop_rule_take_token(ci_netif* ni, ci_rx_drop_rule* r)
+{
+  ci_uint64 frc = IPTIMER_STATE(ni)->frc;
+  ci_uint64 frc_per_sec = (ci_uint64) IPTIMER_STATE(ni)->khz * 1000;
+  ci_uint64 elapsed = frc - r->refill_frc;
+
+  if( elapsed >= frc_per_sec ) {
+    r->tokens = r->rate_pps;
+    r->refill_frc = frc;
+  }
+  else {
+    ci_uint64 n = elapsed * r->rate_pps / frc_per_sec;
+    if( n != 0 ) {
+      r->tokens = CI_MIN(r->tokens + n, (ci_uint64) r->rate_pps);
+      r->refill_frc += n * frc_per_sec / r->rate_pps;
+    }
+  }
+
+  if( r->tokens == 0 )
+    return 0;
+  --r->tokens;
+  return 1;
+}
+
+
+/* Checks an IPv4 packet against the rules set by onload_rx_drop_rule_set().
+ * Returns non-zero if the packet should be dropped. */
+static int rx_drop_rules_check(ci_netif* ni, const ci_ip4_hdr* ip,
+                               const char* payload, int ip_paylen)
+{
+  ci_uint16 dport_be16 = 0;
+  unsigned i;
+
+  /* TCP and UDP both keep the destination port at the same offset. */
+  if( (ip->ip_protocol == IPPROTO_TCP || ip->ip_protocol == IPPROTO_UDP) &&
+      ip_paylen >= sizeof(ci_udp_hdr) )
+    dport_be16 = ((const ci_udp_hdr*) payload)->udp_dest_be16;
+
+  for( i = 0; i < ni->state->rx_drop_rules_n; ++i ) {
+    ci_rx_drop_rule* r = &ni->state->rx_drop_rules[i];
+    if( ! r->in_use ||
+        ((ip->ip_saddr_be32 ^ r->saddr_be32) & r->smask_be32) != 0 ||
+        (r->protocol != 0 && r->protocol != ip->ip_protocol) ||
+        (r->dport_be16 != 0 && r->dport_be16 != dport_be16) )
+      continue;
+    ++r->n_matched;
+    if( r->rate_pps != 0 && rx_drop_rule_take_token(ni, r) )
+      return 0;
+    ++r->n_dropped;
+    return 1;
+  }
+  return 0;
+}
+
+
 static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
                           ci_ip_pkt_fmt* pkt)
 {
@@ -296,6 +357,18 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
     LOG_DR(ci_hex_dump(ci_log_fn, PKT_START(pkt),
                        ip_pkt_dump_len(ip_tot_len), 0));
 
+#if CI_CFG_IP_REASM
+    if(CI_UNLIKELY( (ip->ip_frag_off_be16 &
+                     (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE)) &&
+                    NI_OPTS(netif).ip_reasm_max_pkts != 0 &&
+                    ci_ip_reasm_rx(netif, &pkt) )) {
+      if( pkt == NULL )
+        return;
+      ip = oo_ip_hdr(pkt);
+      ip_tot_len = CI_BSWAP_BE16(ip->ip_tot_len_be16);
+    }
+#endif
+
     /* Hardware should not deliver us fragments when using scalable
      * filters, but it happens in some corner cases.  We can't handle them.
      * Also check for valid IP length for non-fragmented packets.*/
@@ -331,8 +404,16 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
       ** for the IP header.  The ULP is expected to notice...
       */
 
+      if(CI_UNLIKELY( netif->state->rx_drop_rules_n != 0 &&
+                      rx_drop_rules_check(netif, ip, payload, ip_paylen) )) {
+        LOG_NR(log(LPF "RX id=%d dropped by rule", OO_PKT_FMT(pkt)));
+        ci_netif_pkt_release_rx_1ref(netif, pkt);
+        return;
+      }
+
       get_rx_timestamp(netif, pkt);
 
+      oo_pkt_sample(netif, pkt, 0);
       if( oo_tcpdump_check(netif, pkt, pkt->intf_i) )
         oo_tcpdump_dump_pkt(netif, pkt);
 
@@ -400,6 +481,7 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
 
     get_rx_timestamp(netif, pkt);
 
+    oo_pkt_sample(netif, pkt, 0);
     if( oo_tcpdump_check(netif, pkt, pkt->intf_i) )
       oo_tcpdump_dump_pkt(netif, pkt);
 
@@ -772,7 +854,11 @@ ci_inline int handle_rx_pre_future(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     int ip_payload_offset = pkt->pkt_eth_payload_off + hdr_size;
     void* payload = (char*)ip + hdr_size;
 
+    /* Drop rules are checked, and fragments dealt with, in
+     * handle_rx_pkt() once the whole packet is here. */
     if( ip_payload_offset > valid_bytes ||
+        (ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE)) ||
+        ni->state->rx_drop_rules_n != 0 ||
         (hdr_size > sizeof(ci_ip4_hdr) &&
          ci_ip_options_parse(ni, ip, hdr_size)) )
       goto no_future;
@@ -858,6 +944,7 @@ ci_inline void handle_rx_post_future(ci_netif* ni,
     LOG_DR(ci_hex_dump(ci_log_fn, PKT_START(pkt),
                        ip_pkt_dump_len(ip_tot_len), 0));
 
+    oo_pkt_sample(ni, pkt, 0);
     if( oo_tcpdump_check(ni, pkt, pkt->intf_i) )
       oo_tcpdump_dump_pkt(ni, pkt);
 
@@ -1592,7 +1679,41 @@ static void process_post_poll_list(ci_netif* ni)
  * vi index known to be a constant so it's more optimisable */
 #define CI_NETIF_RX_VI(ni, nic_i, label) (&(ni)->nic_hw[(nic_i)].vis[0])
 #endif
+#if CI_MAX_VIS_PER_INTF > 1
+#define CI_NETIF_TX_VI(ni, nic_i, label) (&(ni)->nic_hw[(nic_i)].vis[(label)])
+#else
 #define CI_NETIF_TX_VI   CI_NETIF_RX_VI
+#endif
+
+
+#if CI_CFG_TIMESTAMPING
+/* Record the TX timestamp of [pkt] in the stack's TX timestamp ring.  The
+ * ring is never overwritten: if the application has not kept up, the
+ * record is dropped and counted. */
+static void ci_netif_tx_ts_ring_put(ci_netif* ni, ci_sock_cmn* s,
+                                    const ci_ip_pkt_fmt* pkt, ci_uint32 id)
+{
+  ci_netif_state* ns = ni->state;
+  ci_uint32 write = ns->tx_ts_ring_write;
+  ci_tx_ts_rec* rec;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( ni->tx_ts_ring == NULL )
+    return;
+  if( write - OO_ACCESS_ONCE(ns->tx_ts_ring_read) > ni->tx_ts_ring_mask ) {
+    ++ns->tx_ts_ring_dropped;
+    return;
+  }
+  rec = &ni->tx_ts_ring[write & ni->tx_ts_ring_mask];
+  rec->sock_id = SC_ID(s);
+  rec->id = id;
+  rec->stamp = pkt->hw_stamp;
+  /* Make the record visible before the index that covers it. */
+  ci_wmb();
+  ns->tx_ts_ring_write = write + 1;
+}
+#endif
 
 
 static void ci_netif_tx_pkt_complete_udp(ci_netif* netif,
@@ -1635,9 +1756,12 @@ static void ci_netif_tx_pkt_complete_udp(ci_netif* netif,
   /* linux/Documentation/networking/timestamping.txt:
    * If the outgoing packet has to be fragmented, then only the first
    * fragment is time stamped and returned to the sending socket. */
-  if( pkt->flags & CI_PKT_FLAG_TX_TIMESTAMPED &&
-      ci_udp_timestamp_q_enqueue(netif, us, pkt) == 0 )
-    return;
+  if( pkt->flags & CI_PKT_FLAG_TX_TIMESTAMPED ) {
+    if( onload_timestamping_want_tx_ring(us->s.timestamping_flags) )
+      ci_netif_tx_ts_ring_put(netif, &us->s, pkt, pkt->ts_key);
+    else if( ci_udp_timestamp_q_enqueue(netif, us, pkt) == 0 )
+      return;
+  }
 #endif
 
   /* Free this packet and all the fragments if possible. */
@@ -1676,6 +1800,15 @@ static void ci_netif_rx_pkt_complete_tcp(ci_netif* ni,
       unsigned n_bufs = 0;
       ci_ip_pkt_fmt* pp;
 
+      /* Retransmits are not reported, as with other onload-format
+       * timestamps. */
+      if( (pkt->flags & (CI_PKT_FLAG_TX_TIMESTAMPED |
+                         CI_PKT_FLAG_RTQ_RETRANS)) ==
+            CI_PKT_FLAG_TX_TIMESTAMPED &&
+          onload_timestamping_want_tx_ring(ts->s.timestamping_flags) )
+        ci_netif_tx_ts_ring_put(ni, &ts->s, pkt,
+                                ci_tcp_tx_timestamp_id(&ts->s, pkt));
+
       /* The socket may have been closed (and even reopened) by the time we
        * get this tx completion - that's the reason for the state checking
        * above. The following code, however, has no reliance at all on pkt, so
@@ -1709,6 +1842,10 @@ ci_inline void __ci_netif_tx_pkt_complete(ci_netif* ni,
   ci_assert(pkt->flags & CI_PKT_FLAG_TX_PENDING);
   nic->tx_bytes_removed += TX_PKT_LEN(pkt);
   ci_assert((int) (nic->tx_bytes_added - nic->tx_bytes_removed) >=0);
+#if CI_CFG_TX_ADAPTIVE
+  if( pkt->netif.tx.post_frc != 0 && ev != NULL )
+    ci_netif_tx_adapt_complete(ni, pkt, ev);
+#endif
 #if CI_CFG_PIO
   if( pkt->pio_addr >= 0 ) {
     ci_pio_buddy_free(ni, &nic->pio_buddy, pkt->pio_addr, pkt->pio_order);
@@ -1758,7 +1895,7 @@ ci_inline void __ci_netif_tx_pkt_complete(ci_netif* ni,
   if( pkt->flags & CI_PKT_FLAG_TX_CTPIO ) {
     /* We tried to send the packet by CTPIO.  Check whether this was
      * successful. */
-    if( ! EF_EVENT_TX_CTPIO(*ev) ) {
+    if( ev != NULL && ! EF_EVENT_TX_CTPIO(*ev) ) {
       ci_netif_ctpio_desist(ni, pkt->intf_i);
       CITP_STATS_NETIF_INC(ni, ctpio_dma_fallbacks);
     }
@@ -1781,6 +1918,136 @@ void ci_netif_tx_pkt_complete(ci_netif* ni, struct ci_netif_poll_state* ps,
   __ci_netif_tx_pkt_complete(ni, ps, pkt, NULL);
 }
 
+#if CI_CFG_POLL_PROFILE
+/* Charge the cycles since [*frc] to [phase] of a sampled poll. */
+ci_inline void ci_netif_poll_profile_phase(ci_netif* ni, int phase,
+                                           ci_uint64* frc)
+{
+  ci_uint64 now;
+  ci_frc64(&now);
+  ni->state->poll_profile.phase_cycles[phase] += now - *frc;
+  *frc = now;
+}
+
+
+ci_inline void ci_netif_poll_profile_ev(ci_netif* ni, const ef_event* ev,
+                                        ci_uint64* frc)
+{
+  ci_netif_poll_profile* pp = &ni->state->poll_profile;
+  ci_uint64 now;
+  int cls;
+
+  switch( EF_EVENT_TYPE(*ev) ) {
+  case EF_EVENT_TYPE_RX:
+  case EF_EVENT_TYPE_RX_REF:
+  case EF_EVENT_TYPE_RX_MULTI:
+  case EF_EVENT_TYPE_RX_MULTI_PKTS:
+    cls = CI_POLL_EV_RX;
+    break;
+  case EF_EVENT_TYPE_TX:
+  case EF_EVENT_TYPE_TX_WITH_TIMESTAMP:
+    cls = CI_POLL_EV_TX;
+    break;
+  case EF_EVENT_TYPE_RX_DISCARD:
+  case EF_EVENT_TYPE_RX_MULTI_DISCARD:
+  case EF_EVENT_TYPE_RX_REF_DISCARD:
+  case EF_EVENT_TYPE_RX_NO_DESC_TRUNC:
+    cls = CI_POLL_EV_RX_DISCARD;
+    break;
+  default:
+    cls = CI_POLL_EV_OTHER;
+    break;
+  }
+  ci_frc64(&now);
+  pp->ev_cycles[cls] += now - *frc;
+  ++pp->ev_count[cls];
+  *frc = now;
+}
+
+# define POLL_PROFILE_PHASE(ni, phase, frc)                     \
+  do {                                                          \
+    if(CI_UNLIKELY( (ni)->state->poll_profile.active ))        \
+      ci_netif_poll_profile_phase((ni), (phase), (frc));        \
+  } while( 0 )
+#else
+# define POLL_PROFILE_PHASE(ni, phase, frc)  do{ (void) (frc); }while(0)
+#endif
+
+
+/* Software pipeline for EF_POLL_PREFETCH: before handling a batch of
+ * events, walk it three times, touching first the packets' metadata and
+ * headers, then the filter-table entries at which the lookups of their
+ * IPv4 TCP and UDP tuples start, and then the sockets those entries name.
+ * The cache misses for the packets of the batch then overlap each other,
+ * instead of each packet taking its misses in turn as it is handled.
+ *
+ * Only whole packets delivered by EF_EVENT_TYPE_RX are looked at.  The
+ * headers are parsed just far enough to find the tuple, and nothing is
+ * written: a packet that turns out to be something else only wastes its
+ * prefetches.  Returns the index of the first event not covered.
+ */
+#define CI_POLL_PREFETCH_MAX  32
+
+static int ci_netif_poll_evq_prefetch(ci_netif* ni, ef_vi* evq,
+                                      const ef_event* ev, int i, int n_evs)
+{
+  ci_ip_pkt_fmt* pkts[CI_POLL_PREFETCH_MAX];
+  unsigned tbl_i[CI_POLL_PREFETCH_MAX];
+  int end, j, n_pkts = 0, n_ents = 0;
+  oo_pkt_p pp;
+
+  end = CI_MIN(n_evs, i + (int) CI_MIN(NI_OPTS(ni).poll_prefetch,
+                                        CI_POLL_PREFETCH_MAX));
+
+  for( j = i; j < end; ++j )
+    if( EF_EVENT_TYPE(ev[j]) == EF_EVENT_TYPE_RX &&
+        (ev[j].rx.flags & (EF_EVENT_FLAG_SOP | EF_EVENT_FLAG_CONT)) ==
+          EF_EVENT_FLAG_SOP &&
+        EF_EVENT_RX_BYTES(ev[j]) >= evq->rx_prefix_len + ETH_HLEN + 4 +
+                                    sizeof(ci_ip4_hdr) + 4 ) {
+      OO_PP_INIT(ni, pp, EF_EVENT_RX_RQ_ID(ev[j]));
+      pkts[n_pkts] = PKT_CHK(ni, pp);
+      ci_prefetch(pkts[n_pkts]);
+      ci_prefetch(pkts[n_pkts]->dma_start);
+      ++n_pkts;
+    }
+
+  /* AF_XDP only sets [pkt_start_off] as each packet is handled. */
+  if( evq->nic_type.arch == EF_VI_ARCH_AF_XDP )
+    return end;
+
+  for( j = 0; j < n_pkts; ++j ) {
+    char* l3 = PKT_START(pkts[j]) + ETH_HLEN;
+    ci_uint16 ether_type = *((ci_uint16*) l3 - 1);
+    const ci_ip4_hdr* ip;
+    const ci_uint16* ports;
+
+    if( ether_type == CI_ETHERTYPE_8021Q ) {
+      l3 += 4;
+      ether_type = *((ci_uint16*) l3 - 1);
+    }
+    if( ether_type != CI_ETHERTYPE_IP )
+      continue;
+    ip = (const ci_ip4_hdr*) l3;
+    if( (ip->ip_protocol != IPPROTO_TCP && ip->ip_protocol != IPPROTO_UDP) ||
+        (ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE)) ||
+        CI_IP4_IHL(ip) != sizeof(ci_ip4_hdr) )
+      continue;
+    ports = (const ci_uint16*) (ip + 1);
+    tbl_i[n_ents++] = ci_netif_filter_prefetch_entry(ni, ip->ip_daddr_be32,
+                                                     ports[1],
+                                                     ip->ip_saddr_be32,
+                                                     ports[0],
+                                                     ip->ip_protocol);
+  }
+
+  for( j = 0; j < n_ents; ++j )
+    ci_netif_filter_prefetch_sock(ni, tbl_i[j]);
+
+  return end;
+}
+
+
 static int ci_netif_poll_evq(ci_netif* ni, struct ci_netif_poll_state* ps,
                              int intf_i, int n_evs)
 {
@@ -1789,11 +2056,15 @@ static int ci_netif_poll_evq(ci_netif* ni, struct ci_netif_poll_state* ps,
   unsigned total_evs = 0;
   ci_ip_pkt_fmt* pkt;
   ef_event *ev = ni->state->events;
-  int i;
+  int i, prefetch_i;
   oo_pkt_p pp;
   int completed_tx = 0;
 #ifdef OO_HAS_POLL_IN_KERNEL
   int poll_in_kernel;
+#endif
+#if CI_CFG_POLL_PROFILE
+  int prof = ni->state->poll_profile.active;
+  ci_uint64 prof_frc = 0;
 #endif
   s.frag_pkt = NULL;
   s.frag_bytes = 0;  /*??*/
@@ -1840,7 +2111,15 @@ have_events:
      * measured benefit from allowing the CPU more time to prefetch the
      * relevant cache lines from L3. */
     s.rx_pkt = NULL;
+    prefetch_i = NI_OPTS(ni).poll_prefetch ? 0 : -1;
+#if CI_CFG_POLL_PROFILE
+    if(CI_UNLIKELY( prof ))
+      ci_frc64(&prof_frc);
+#endif
     for( i = 0; i < n_evs; ++i ) {
+      if(CI_UNLIKELY( i == prefetch_i ))
+        prefetch_i = ci_netif_poll_evq_prefetch(ni, evq, ev, i, n_evs);
+
       /* Look for RX events first to minimise latency. */
       if( EF_EVENT_TYPE(ev[i]) == EF_EVENT_TYPE_RX ) {
         CITP_STATS_NETIF_INC(ni, rx_evs);
@@ -2008,6 +2287,11 @@ have_events:
                   " *****",
                   EF_EVENT_PRI_ARG(ev[i]), EF_EVENT_TYPE(ev[i])));
       }
+
+#if CI_CFG_POLL_PROFILE
+      if(CI_UNLIKELY( prof ))
+        ci_netif_poll_profile_ev(ni, &ev[i], &prof_frc);
+#endif
     }
 
 #ifndef NDEBUG
@@ -2017,6 +2301,7 @@ have_events:
       for( vi_i = 0; vi_i < ci_netif_num_vis(ni); ++vi_i)
         txq_level += ef_vi_transmit_fill_level(&ni->nic_hw[intf_i].vis[vi_i]) +
                      ni->state->nic[intf_i].dmaq[vi_i].num;
+      txq_level += ni->state->nic[intf_i].dmaq_bulk.num;
       ci_assert_equiv(txq_level == 0,
                       (ni->state->nic[intf_i].tx_dmaq_insert_seq ==
                       ni->state->nic[intf_i].tx_dmaq_done_seq));
@@ -2042,11 +2327,45 @@ have_events:
 }
 
 
+ci_inline void ci_netif_poll_shove_intf(ci_netif* ni, int intf_i)
+{
+  if( ci_netif_dmaq_not_empty(ni, intf_i) )
+    ci_netif_dmaq_shove1(ni, intf_i);
+  if( oo_pktq_not_empty(ci_netif_dmaq_bulk(ni, intf_i)) )
+    ci_netif_dmaq_shove_bulk(ni, intf_i);
+
+#if CI_MAX_VIS_PER_INTF > 1
+  {
+    int i;
+    for( i = 1; i < ci_netif_num_vis(ni); ++i )
+      if( oo_pktq_not_empty(&ni->state->nic[intf_i].dmaq[i]) )
+        ci_netif_dmaq_shove_q(ni, intf_i, i);
+  }
+#endif
+}
+
+
+/* Ends a batch of sends made outside of a poll with [tx_coalesce_active]
+ * set, pushing the DMA sends it deferred to the NIC. */
+void ci_netif_tx_coalesce_end(ci_netif* ni)
+{
+  int intf_i;
+
+  ci_assert(ci_netif_is_locked(ni));
+  if( ! ni->state->tx_coalesce_active )
+    return;
+  ni->state->tx_coalesce_active = 0;
+  OO_STACK_FOR_EACH_INTF_I(ni, intf_i)
+    ci_netif_poll_shove_intf(ni, intf_i);
+}
+
+
 ci_inline int ci_netif_poll_intf(ci_netif* ni, int intf_i, int max_evs)
 {
   struct ci_netif_poll_state ps;
   int total_evs = 0;
   int rc;
+  ci_uint64 prof_frc = 0;
 
 #if defined(__KERNEL__) || ! defined(NDEBUG)
   if( ! ci_netif_may_poll_in_kernel(ni, intf_i) )
@@ -2054,14 +2373,19 @@ ci_inline int ci_netif_poll_intf(ci_netif* ni, int intf_i, int max_evs)
 #endif
 
   ci_assert(ci_netif_is_locked(ni));
-  ps.tx_pkt_free_list_insert = &ps.tx_pkt_free_list;
-  ps.tx_pkt_free_list_n = 0;
+  ci_netif_poll_state_init(&ps);
+#if CI_CFG_POLL_PROFILE
+  if(CI_UNLIKELY( ni->state->poll_profile.active ))
+    ci_frc64(&prof_frc);
+#endif
 
   do {
     rc = ci_netif_poll_evq(ni, &ps, intf_i, 0);
+    POLL_PROFILE_PHASE(ni, CI_POLL_PHASE_EVQ, &prof_frc);
     if( rc > 0 ) {
       total_evs += rc;
       process_post_poll_list(ni);
+      POLL_PROFILE_PHASE(ni, CI_POLL_PHASE_POST_POLL, &prof_frc);
     }
     else
       break;
@@ -2074,18 +2398,14 @@ ci_inline int ci_netif_poll_intf(ci_netif* ni, int intf_i, int max_evs)
    * events, but that is a rare case and so not worth testing for.
    */
   ci_netif_rx_post_all_batch(ni, intf_i);
+  POLL_PROFILE_PHASE(ni, CI_POLL_PHASE_RX_REFILL, &prof_frc);
 
-  if( ci_netif_dmaq_not_empty(ni, intf_i) )
-    ci_netif_dmaq_shove1(ni, intf_i);
-
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
-  {
-    int i;
-    for( i = 1; i < ci_netif_num_vis(ni); ++i )
-      if( oo_pktq_not_empty(&ni->state->nic[intf_i].dmaq[i]) )
-        ci_netif_dmaq_shove_plugin(ni, intf_i, i);
+  /* With EF_TX_COALESCE the dmaqs are pushed once all interfaces have been
+   * polled. */
+  if( ! ni->state->tx_coalesce_active ) {
+    ci_netif_poll_shove_intf(ni, intf_i);
+    POLL_PROFILE_PHASE(ni, CI_POLL_PHASE_TX_PUSH, &prof_frc);
   }
-#endif
 
   return total_evs;
 }
@@ -2156,8 +2476,7 @@ int ci_netif_poll_intf_future(ci_netif* ni, int intf_i, ci_uint64 start_frc)
   CITP_STATS_NETIF_INC(ni, rx_future);
   CITP_STATS_NETIF_INC(ni, rx_evs);
 
-  ps.tx_pkt_free_list_insert = &ps.tx_pkt_free_list;
-  ps.tx_pkt_free_list_n = 0;
+  ci_netif_poll_state_init(&ps);
 
   /* We expect the completion event within a microsecond or so. The timeout
    * of 10us is to avoid wedging the stack in the case of hardware
@@ -2311,9 +2630,68 @@ void ci_netif_loopback_pkts_send(ci_netif* ni)
 }
 
 
+/* Deliver queued loopback packets, and any they provoke in reply, without
+ * polling the interfaces or timers.  This is all a send on a loopback
+ * connection needs, so it need not pay for a full poll.
+ */
+void ci_netif_loopback_poll(ci_netif* ni)
+{
+#if defined(__KERNEL__) || ! defined(NDEBUG)
+  if( ni->error_flags )
+    return;
+#endif
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(ni->state->in_poll == 0);
+
+  ci_ip_time_resync(IPTIMER_STATE(ni));
+  ++ni->state->in_poll;
+  while( OO_PP_NOT_NULL(ni->state->looppkts) ) {
+    ci_netif_loopback_pkts_send(ni);
+    process_post_poll_list(ni);
+  }
+  ci_assert_equal(ni->state->n_looppkts, 0);
+  --ni->state->in_poll;
+}
+
+
+#if CI_CFG_POLL_PROFILE
+/* Decide whether to sample this poll. */
+static ci_uint64 ci_netif_poll_profile_start(ci_netif* ni)
+{
+  ci_netif_poll_profile* pp = &ni->state->poll_profile;
+  ci_uint64 frc = 0;
+
+  if( pp->countdown == 0 || pp->countdown > NI_OPTS(ni).poll_profile )
+    pp->countdown = NI_OPTS(ni).poll_profile;
+  if( --pp->countdown == 0 ) {
+    pp->active = 1;
+    ci_frc64(&frc);
+  }
+  return frc;
+}
+
+
+static void ci_netif_poll_profile_end(ci_netif* ni, ci_uint64 start_frc,
+                                      ci_uint64 frc)
+{
+  ci_netif_poll_profile* pp = &ni->state->poll_profile;
+
+  ci_netif_poll_profile_phase(ni, CI_POLL_PHASE_OTHER, &frc);
+  pp->total_cycles += frc - start_frc;
+  ++pp->n_polls;
+  pp->active = 0;
+}
+#endif
+
+
 int ci_netif_poll_n(ci_netif* netif, int max_evs)
 {
   int offset, intf_i, intf_max, n_evs_handled = 0;
+  ci_uint64 prof_frc = 0;
+#if CI_CFG_POLL_PROFILE
+  ci_uint64 prof_start = 0;
+#endif
 
 #if defined(__KERNEL__) || ! defined(NDEBUG)
   if( netif->error_flags )
@@ -2329,6 +2707,11 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
   CITP_STATS_NETIF_INC(netif, u_polls);
 #endif
 
+#if CI_CFG_POLL_PROFILE
+  if(CI_UNLIKELY( NI_OPTS(netif).poll_profile ))
+    prof_frc = prof_start = ci_netif_poll_profile_start(netif);
+#endif
+
   ci_ip_time_resync(IPTIMER_STATE(netif));
 #if CI_CFG_UL_INTERRUPT_HELPER && ! defined(__KERNEL__)
   ci_netif_handle_actions(netif);
@@ -2346,6 +2729,9 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
 
   ci_assert(netif->state->in_poll == 0);
   ++netif->state->in_poll;
+  netif->state->tx_coalesce_active = NI_OPTS(netif).tx_coalesce;
+  netif->state->ack_batch_active = NI_OPTS(netif).tcp_ack_batch;
+  POLL_PROFILE_PHASE(netif, CI_POLL_PHASE_OTHER, &prof_frc);
 
   /* Poll all interfaces in a cycle, then set the next interface we start with
    * to be the next interface in the cycle. For example, suppose we have three
@@ -2369,12 +2755,29 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
     n_evs_handled += n;
   }
   netif->state->poll_start_intf = (offset + 1 >= intf_max) ? 0 : offset + 1;
+#if CI_CFG_POLL_PROFILE
+  /* ci_netif_poll_intf() has charged its own time to its phases. */
+  if(CI_UNLIKELY( netif->state->poll_profile.active ))
+    ci_frc64(&prof_frc);
+#endif
 
   while( OO_PP_NOT_NULL(netif->state->looppkts) ) {
     ci_netif_loopback_pkts_send(netif);
     process_post_poll_list(netif);
   }
   ci_assert_equal(netif->state->n_looppkts, 0);
+  POLL_PROFILE_PHASE(netif, CI_POLL_PHASE_LOOPBACK, &prof_frc);
+
+  /* Ring one doorbell per VI for everything the poll has sent.  Without
+   * EF_TX_COALESCE each interface was pushed after it was polled, but with
+   * EF_TCP_ACK_BATCH an ACK may have been queued on it since. */
+  if( netif->state->tx_coalesce_active | netif->state->ack_batch_active ) {
+    netif->state->tx_coalesce_active = 0;
+    netif->state->ack_batch_active = 0;
+    OO_STACK_FOR_EACH_INTF_I(netif, intf_i)
+      ci_netif_poll_shove_intf(netif, intf_i);
+    POLL_PROFILE_PHASE(netif, CI_POLL_PHASE_TX_PUSH, &prof_frc);
+  }
   --netif->state->in_poll;
 
 #if CI_CFG_INJECT_PACKETS
@@ -2396,13 +2799,21 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
   }
 #endif
 
+  POLL_PROFILE_PHASE(netif, CI_POLL_PHASE_OTHER, &prof_frc);
+
   /* Timer code can't use in-poll wakeup, since endpoints are out of
    * post-poll list.  So, poll timers after --in_poll. */
   ci_ip_timer_poll(netif);
+  POLL_PROFILE_PHASE(netif, CI_POLL_PHASE_TIMERS, &prof_frc);
 
   /* Timers MUST NOT send via loopback. */
   ci_assert(OO_PP_IS_NULL(netif->state->looppkts));
 
+  /* Free the endpoints of connections that have reached TIME_WAIT and can
+   * be remembered in the compact table instead. */
+  if( netif->state->tw_compact_pending != 0 )
+    ci_netif_timewait_compact(netif);
+
   /* Perform proactive socket allocation check.
    * Proactive packet allocation check is more expensive, so we perform it
    * from the unlock hook only.
@@ -2423,6 +2834,12 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
 
   netif->state->poll_work_outstanding = 0;
 
+#if CI_CFG_POLL_PROFILE
+  if(CI_UNLIKELY( netif->state->poll_profile.active ))
+    ci_netif_poll_profile_end(netif, prof_start, prof_frc);
+#endif
+
+  OO_PROBE2(netif_poll, NI_ID(netif), n_evs_handled);
   /* returns the number of events handled */
   return n_evs_handled;
 }
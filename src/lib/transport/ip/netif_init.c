@@ -25,6 +25,7 @@
 #include <cplane/cplane.h>
 #include <cplane/create.h>
 #include <net/if.h>
+#include <sys/stat.h>
 #include <ci/internal/efabcfg.h>
 #endif
 
@@ -63,6 +64,7 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
     nn = &nis->nic[nic_i];
     for( i = 0; i < sizeof(nn->dmaq) / sizeof(nn->dmaq[0]); ++i )
       oo_pktq_init(&nn->dmaq[i]);
+    oo_pktq_init(&nn->dmaq_bulk);
     assert_zero(nn->tx_bytes_added);
     assert_zero(nn->tx_bytes_removed);
     assert_zero(nn->tx_dmaq_insert_seq);
@@ -174,6 +176,30 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
 
   ci_ip_timer_state_init(ni, cpu_khz);
   nis->last_spin_poll_frc = IPTIMER_STATE(ni)->frc;
+
+#if CI_CFG_STATS_NETIF
+  ci_ip_timer_init(ni, &nis->stats_pub_tid,
+                   oo_ptr_to_statep(ni, &nis->stats_pub_tid),
+                   "spub");
+  nis->stats_pub_tid.fn = CI_IP_TIMER_NETIF_STATS_PUB;
+  if( NI_OPTS(ni).stats_publish_ms )
+    ci_netif_stats_publish(ni);
+#endif
+  ci_ip_timer_init(ni, &nis->idle_reclaim_tid,
+                   oo_ptr_to_statep(ni, &nis->idle_reclaim_tid),
+                   "idlr");
+  nis->idle_reclaim_tid.fn = CI_IP_TIMER_NETIF_IDLE_RECLAIM;
+  nis->idle_reclaim_next = 0;
+  if( NI_OPTS(ni).tcp_idle_reclaim_ms )
+    ci_netif_idle_reclaim(ni);
+#if CI_CFG_IP_REASM
+  ci_ip_timer_init(ni, &nis->ip_reasm_tid,
+                   oo_ptr_to_statep(ni, &nis->ip_reasm_tid),
+                   "reas");
+  nis->ip_reasm_tid.fn = CI_IP_TIMER_NETIF_IP_REASM;
+  nis->ip_reasm_n_pkts = 0;
+  memset(nis->ip_reasm, 0, sizeof(nis->ip_reasm));
+#endif
   nis->last_sleep_frc = IPTIMER_STATE(ni)->frc;
   
   oo_timesync_update(efab_tcp_driver.timesync);
@@ -185,6 +211,11 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   nis->dump_write_i = 0;
   memset(nis->dump_intf, 0, sizeof(nis->dump_intf));
 #endif
+#if CI_CFG_PKT_SAMPLE
+  nis->pkt_sample_every = 0;
+  nis->pkt_sample_write_i = 0;
+  nis->pkt_sample_read_i = 0;
+#endif
 
   nis->uuid = ci_current_from_kuid_munged(ni->kuid);
 #ifdef EFRM_DO_NAMESPACES
@@ -201,7 +232,8 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   /* This gets set appropriately in tcp_helper_init_max_mss() */
   nis->max_mss = 0;
 
-  /* hash_salt is used for TCP syncookies and IPv6 flowlabel generation */
+  /* hash_salt is used for TCP syncookies, TCP Fast Open cookies and IPv6
+   * flowlabel generation */
   get_random_bytes(&nis->hash_salt, sizeof(nis->hash_salt));
 
 #if CI_CFG_EPOLL3
@@ -768,10 +800,14 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   }
   if( (s = getenv("EF_HELPER_PRIME_USEC")) )
     opts->timer_prime_usec = atoi(s);
+  if( (s = getenv("EF_TIMER_CASCADE_BUDGET")) )
+    opts->timer_cascade_budget = atoi(s);
 
   if( (s = getenv("EF_BUZZ_USEC")) ) {
     opts->buzz_usec = atoi(s);
   }
+  if( (s = getenv("EF_SPIN_ADAPT")) )
+    opts->spin_adapt = atoi(s);
 
   /* The options that follow are (at time of writing) not sensitive to the
    * order in which they are read.
@@ -811,6 +847,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   }
   if( (s = getenv("EF_MCAST_RECV_HW_LOOP")) )
     opts->mcast_recv_hw_loop = atoi(s);
+  if( (s = getenv("EF_POLL_PREFETCH")) )
+    opts->poll_prefetch = atoi(s);
   if( (s = getenv("EF_EVS_PER_POLL")) )
     opts->evs_per_poll = atoi(s);
 #if CI_CFG_WANT_BPF_NATIVE
@@ -868,6 +906,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->defer_arp_timeout = atoi(s);
   if ( (s = getenv("EF_SHARE_WITH")) )
     opts->share_with = atoi(s);
+  if ( (s = getenv("EF_STACK_LINGER")) )
+    opts->stack_linger = atoi(s);
 #if CI_CFG_PKTS_AS_HUGE_PAGES
   if( (s = getenv("EF_USE_HUGE_PAGES")) )
     opts->huge_pages = atoi(s);
@@ -877,8 +917,14 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->huge_pages = 0;
   }
 #endif
+  if( (s = getenv("EF_STATE_HUGE_PAGES")) )
+    opts->state_huge_pages = atoi(s);
+  if( (s = getenv("EF_STATS_PUBLISH_MS")) )
+    opts->stats_publish_ms = atoi(s);
   if ( (s = getenv("EF_COMPOUND_PAGES_MODE")) )
     opts->compound_pages = atoi(s);
+  if ( (s = getenv("EF_PKT_NUMA")) )
+    opts->pkt_numa = atoi(s);
   if ( (s = getenv("EF_RXQ_SIZE")) )
     opts->rxq_size = atoi(s);
   if ( (s = getenv("EF_RXQ_LIMIT")) )
@@ -887,14 +933,28 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->shared_rxq_num = atoi(s);
   if ( (s = getenv("EF_TXQ_SIZE")) )
     opts->txq_size = atoi(s);
+#if CI_CFG_TX_VIS_MAX > 1
+  if ( (s = getenv("EF_TX_VIS")) )
+    opts->tx_vis = atoi(s);
+#endif
   if ( (s = getenv("EF_SEND_POLL_THRESH")) )
     opts->send_poll_thresh = atoi(s);
   if ( (s = getenv("EF_SEND_POLL_MAX_EVS")) )
     opts->send_poll_max_events = atoi(s);
   if ( (s = getenv("EF_DEFER_WORK_LIMIT")) )
     opts->defer_work_limit = atoi(s);
+  if ( (s = getenv("EF_LOCK_PROFILE")) )
+    opts->lock_profile = atoi(s);
+  if ( (s = getenv("EF_RX_LATENCY_HIST")) )
+    opts->rx_latency_hist = atoi(s);
+  if ( (s = getenv("EF_POLL_PROFILE")) )
+    opts->poll_profile = atoi(s);
   if( (s = getenv("EF_UDP_SEND_UNLOCK_THRESH")) )
     opts->udp_send_unlock_thresh = atoi(s);
+  if( (s = getenv("EF_NONB_POOL_REFILL")) )
+    opts->nonb_pool_refill = atoi(s);
+  if( (s = getenv("EF_PKT_MAGAZINE")) )
+    opts->pkt_magazine = atoi(s);
   if( (s = getenv("EF_UDP_PORT_HANDOVER_MIN")) )
     opts->udp_port_handover_min = atoi(s);
   if( (s = getenv("EF_UDP_PORT_HANDOVER_MAX")) )
@@ -917,6 +977,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
    */
   opts->dynack_thresh = CI_MAX(opts->dynack_thresh, opts->delack_thresh);
 #endif
+  if ( (s = getenv("EF_TCP_ACK_BATCH")) )
+    opts->tcp_ack_batch = atoi(s);
 
   if ( (s = getenv("EF_INVALID_ACK_RATELIMIT")) )
     opts->oow_ack_ratelimit = atoi(s);
@@ -951,6 +1013,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->tx_push = atoi(s);
   if( opts->tx_push && (s = getenv("EF_TX_PUSH_THRESHOLD")) )
     opts->tx_push_thresh = atoi(s);
+  if( (s = getenv("EF_TX_COALESCE")) )
+    opts->tx_coalesce = atoi(s);
+  if( (s = getenv("EF_TX_BULK_FILL_MAX")) )
+    opts->tx_bulk_fill_max = atoi(s);
   if( (s = getenv("EF_PACKET_BUFFER_MODE")) )
     opts->packet_buffer_mode = atoi(s);
   if( (s = getenv("EF_TCP_RST_DELAYED_CONN")) )
@@ -965,8 +1031,22 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->tcp_rcvbuf_strict = atoi(s);
   if( (s = getenv("EF_TCP_RCVBUF_MODE")) )
     opts->tcp_rcvbuf_mode = atoi(s);
+  if( (s = getenv("EF_TCP_RX_COPYBREAK")) )
+    opts->tcp_rx_copybreak = atoi(s);
+  if( (s = getenv("EF_TCP_AUTOCORK_US")) )
+    opts->tcp_autocork_us = atoi(s);
+  if( (s = getenv("EF_TCP_IDLE_RECLAIM_MS")) )
+    opts->tcp_idle_reclaim_ms = atoi(s);
+  if( (s = getenv("EF_IP_REASM_MAX_PKTS")) )
+    opts->ip_reasm_max_pkts = atoi(s);
+  if( (s = getenv("EF_IP_REASM_TIMEOUT_MS")) )
+    opts->ip_reasm_timeout_ms = atoi(s);
+  if( (s = getenv("EF_TCP_RECV_NT_COPY_THRESH")) )
+    opts->tcp_recv_nt_copy_thresh = atoi(s);
   if( (s = getenv("EF_POLL_ON_DEMAND")) )
     opts->poll_on_demand = atoi(s);
+  if( (s = getenv("EF_POLL_HANDOFF")) )
+    opts->poll_handoff = atoi(s);
   if( (s = getenv("EF_INT_REPRIME")) )
     opts->int_reprime = atoi(s);
   if( (s = getenv("EF_NONAGLE_INFLIGHT_MAX")) )
@@ -977,6 +1057,12 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->irq_core = atoi(s);
   if( (s = getenv("EF_IRQ_CHANNEL")) )
     opts->irq_channel = atoi(s);
+  if( (s = getenv("EF_IRQ_FOLLOW")) )
+    opts->irq_follow = atoi(s);
+  if( (s = getenv("EF_IRQ_FOLLOW_INTERVAL")) )
+    opts->irq_follow_interval = atoi(s);
+  if( (s = getenv("EF_IRQ_FOLLOW_MAX")) )
+    opts->irq_follow_max = atoi(s);
   if( (s = getenv("EF_TCP_LISTEN_HANDOVER")) )
     opts->tcp_listen_handover = atoi(s);
   if( (s = getenv("EF_TCP_CONNECT_HANDOVER")) )
@@ -1113,6 +1199,13 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->loss_min_cwnd = atoi(s);
   if ( (s = getenv("EF_TCP_MIN_CWND")) )
     opts->min_cwnd = atoi(s);
+
+  static const char* const tcp_cong_alg_opts[] =
+    { "onload-reno", "cubic", "bbr", 0 };
+  opts->tcp_cong_alg =
+    parse_enum(opts, "EF_TCP_CONG_ALG", tcp_cong_alg_opts, "onload-reno");
+  if ( (s = getenv("EF_TCP_FLIGHT_RECORDER")) )
+    opts->tcp_flight_bufs = atoi(s);
 #if CI_CFG_TCP_FASTSTART
   if ( (s = getenv("EF_TCP_FASTSTART_INIT")) )
     opts->tcp_faststart_init = atoi(s);
@@ -1195,6 +1288,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 
   if( (s = getenv("EF_TX_TIMESTAMPING")) )
     opts->tx_timestamping = atoi(s);
+  if( (s = getenv("EF_TX_TIMESTAMP_RING")) )
+    opts->tx_ts_ring = atoi(s);
 
   if( (s = getenv("EF_TIMESTAMPING_REPORTING")) )
     opts->timestamping_reporting = atoi(s);
@@ -1221,8 +1316,13 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->periodic_timer_cpu = cpu;
   }
 
+  if( (s = getenv("EF_SHARED_POLL")) )
+    opts->shared_poll = atoi(s);
+
   if( (s = getenv("EF_TCP_SYNCOOKIES")) )
     opts->tcp_syncookies = atoi(s);
+  if( (s = getenv("EF_TCP_FASTOPEN")) )
+    opts->tcp_fastopen = atoi(s);
 
   if( (s = getenv("EF_CLUSTER_IGNORE")) ) {
     ci_log("EF_CLUSTER_IGNORE is deprecated use EF_CLUSTER_SIZE instead");
@@ -1233,6 +1333,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   }
   else
     opts->cluster_ignore = 1;
+  if( (s = getenv("EF_CLUSTER_REBALANCE")) )
+    opts->cluster_rebalance = atoi(s);
 
 #if CI_CFG_TCP_SHARED_LOCAL_PORTS
   if( (s = getenv("EF_TCP_SHARED_LOCAL_PORTS")) )
@@ -1259,6 +1361,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
                  sizeof(opts->iface_whitelist));
   handle_str_opt(opts, "EF_INTERFACE_BLACKLIST", opts->iface_blacklist,
                  sizeof(opts->iface_blacklist));
+#if CI_CFG_TEAMING
+  if( (s = getenv("EF_BOND_KERNEL_HASH")) )
+    opts->bond_kernel_hash = atoi(s);
+#endif
 
   if( (s = getenv("EF_KERNEL_PACKETS_BATCH_SIZE")) )
     opts->kernel_packets_batch_size = atoi(s);
@@ -1273,6 +1379,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->tcp_isn_2msl = atoi(s);
   if( (s = getenv("EF_TCP_ISN_CACHE_SIZE")) )
     opts->tcp_isn_cache_size = atoi(s);
+  if( (s = getenv("EF_TCP_TIME_WAIT_COMPACT")) )
+    opts->tcp_tw_compact = atoi(s);
   if( (s = getenv("EF_TCP_ISN_INCLUDE_PASSIVE")) )
     opts->tcp_isn_include_passive = atoi(s);
   if( (s = getenv("EF_TCP_ISN_OFFSET")) )
@@ -1299,8 +1407,17 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->ctpio_switch_bypass = atoi(s);
 #endif
 
+#if CI_CFG_TX_ADAPTIVE
+  if( (s = getenv("EF_TX_ADAPTIVE")) )
+    opts->tx_adaptive = atoi(s);
+#endif
+
   if( (s = getenv("EF_TCP_EARLY_RETRANSMIT")) )
     opts->tcp_early_retransmit = atoi(s);
+  if( (s = getenv("EF_TCP_RACK")) )
+    opts->tcp_rack = atoi(s);
+  if( (s = getenv("EF_TCP_RTT_US")) )
+    opts->tcp_rtt_us = atoi(s);
 
 #if CI_CFG_IPV6
   if( (s = getenv("EF_AUTO_FLOWLABELS")) )
@@ -1709,9 +1826,18 @@ static void netif_tcp_helper_build2(ci_netif* ni)
 #endif
   ni->seq_table =
     (ci_tcp_prev_seq_t*) ((char*) ni->state + ni->state->seq_table_ofs);
+  ni->tw_table =
+    (ci_tcp_tw_compact_t*) ((char*) ni->state + ni->state->tw_table_ofs);
   ni->deferred_pkts =
     (struct oo_deferred_pkt*) ((char*) ni->state +
                                ni->state->deferred_pkts_ofs);
+#if CI_CFG_TIMESTAMPING
+  if( ni->state->tx_ts_ring_size != 0 ) {
+    ni->tx_ts_ring =
+      (ci_tx_ts_rec*) ((char*) ni->state + ni->state->tx_ts_ring_ofs);
+    ni->tx_ts_ring_mask = ni->state->tx_ts_ring_size - 1;
+  }
+#endif
   ni->filter_table =
     (ci_netif_filter_table*) ((char*) ni->state + ni->state->table_ofs);
   ni->filter_table_ext =
@@ -2164,6 +2290,7 @@ static int netif_tcp_helper_build(ci_netif* ni)
   vi_state_offset = sizeof(*ni->state);
 
   ni->future_intf_mask = 0;
+  ci_netif_pkt_mags_init(ni);
 
   OO_STACK_FOR_EACH_INTF_I(ni, nic_i) {
     ci_netif_state_nic_t* nsn = &ns->nic[nic_i];
@@ -2416,6 +2543,8 @@ static void init_resource_alloc(ci_resource_onload_alloc_t* ra,
     ra->in_cluster_size = CITP_OPTS.cluster_size;
     ra->in_cluster_restart = CITP_OPTS.cluster_restart_opt;
     strncpy(ra->in_name, CITP_OPTS.cluster_name, CI_CFG_STACK_NAME_LEN);
+    if( name != NULL )
+      strncpy(ra->in_stack_name, name, CI_CFG_STACK_NAME_LEN);
   }
   else
   if( name != NULL )
@@ -2576,6 +2705,35 @@ fail:
 
 #ifndef __KERNEL__
 
+#define CI_MEMBER_END(c_type, mbr_name)                 \
+  (CI_MEMBER_OFFSET(c_type, mbr_name) + CI_MEMBER_SIZE(c_type, mbr_name))
+
+/* The TCP receive fast path fields (see the comment in ci_tcp_state_s)
+ * must stay together, ahead of the send, timer and cold groups.
+ */
+static void ci_tcp_state_layout_check(void)
+{
+  CI_BUILD_ASSERT( CI_MEMBER_END(ci_tcp_state, rcv_window_max) -
+                   CI_MEMBER_OFFSET(ci_tcp_state, tcpflags)
+                   <= 3 * CI_CACHE_LINE_SIZE );
+  CI_BUILD_ASSERT( CI_MEMBER_END(ci_tcp_state, rcv_window_max) <=
+                   CI_MEMBER_OFFSET(ci_tcp_state, send_in) );
+  CI_BUILD_ASSERT( CI_MEMBER_END(ci_tcp_state, cong) <=
+                   CI_MEMBER_OFFSET(ci_tcp_state, sa) );
+  CI_BUILD_ASSERT( CI_MEMBER_OFFSET(ci_tcp_state, rto_tid) <
+                   CI_MEMBER_OFFSET(ci_tcp_state, local_peer) );
+}
+
+/* UDP fields used on every receive and send precede the header cache. */
+static void ci_udp_state_layout_check(void)
+{
+  CI_BUILD_ASSERT( CI_MEMBER_END(ci_udp_state, tx_count) -
+                   CI_MEMBER_OFFSET(ci_udp_state, udpflags)
+                   <= 2 * CI_CACHE_LINE_SIZE );
+  CI_BUILD_ASSERT( CI_MEMBER_END(ci_udp_state, tx_count) <=
+                   CI_MEMBER_OFFSET(ci_udp_state, ephemeral_pkt) );
+}
+
 static void ci_netif_sanity_checks(void)
 {
   /* These had better be true, or there'll be trouble! */
@@ -2596,6 +2754,8 @@ static void ci_netif_sanity_checks(void)
   CI_BUILD_ASSERT( offsetof(citp_waitable, sb_aflags) +
                       sizeof(((citp_waitable*)0)->sb_aflags)
                    <= CI_AUX_HEADER_SIZE );
+  ci_tcp_state_layout_check();
+  ci_udp_state_layout_check();
 
 #ifndef NDEBUG
   {
@@ -2767,76 +2927,153 @@ void ci_netif_cluster_prefault(ci_netif* ni)
   ni->flags |= CI_NETIF_FLAGS_PREFAULTED;
 }
 
-static int ci_netif_init(ci_netif* ni, ef_driver_handle fd)
+/* Control plane mappings shared between the stacks in this process.  The
+ * MIBs belong to a network namespace, not to a stack, so all the stacks that
+ * this process creates in one namespace can use a single mapping; the same
+ * goes for the init_net mapping used for veth acceleration.  Each shared
+ * handle has its own driver handle, so that it outlives the stack that
+ * created it.  Applications create and free stacks under the fdtable lock,
+ * but the tools do not, hence the mutex. */
+typedef struct {
+  struct oo_cplane_handle cp;
+  ino_t                   netns;
+  int                     refs;
+} ci_netif_shared_cplane;
+
+static ci_netif_shared_cplane shared_cplane_local;
+static ci_netif_shared_cplane shared_cplane_init_net;
+static pthread_mutex_t shared_cplane_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Returns the inode of the calling thread's network namespace, which is the
+ * id the kernel puts in ci_netif_state::netns_id, or 0 if it can't tell. */
+static ino_t ci_netif_current_netns(void)
+{
+  struct stat st;
+  if( stat("/proc/thread-self/ns/net", &st) != 0 )
+    return 0;
+  return st.st_ino;
+}
+
+
+/* Takes a reference to [scp], mapping it if this is the first.  Returns
+ * -ENOENT if [scp] is already mapped for a different namespace. */
+static int ci_netif_shared_cplane_get(ci_netif_shared_cplane* scp,
+                                      ino_t netns, ci_uint32 flags)
+{
+  ef_driver_handle fd;
+  int rc = 0;
+
+  pthread_mutex_lock(&shared_cplane_lock);
+  if( scp->refs == 0 ) {
+    rc = ef_onload_driver_open(&fd, OO_STACK_DEV, 1);
+    if( rc != 0 ) {
+      ci_log("%s: failed to open driver handle: %d", __func__, rc);
+      goto out;
+    }
+    rc = oo_cp_create(fd, &scp->cp, CITP_OPTS.sync_cplane, flags);
+    if( rc != 0 ) {
+      ef_onload_driver_close(fd);
+      goto out;
+    }
+    scp->netns = netns;
+  }
+  else if( scp->netns != netns ) {
+    rc = -ENOENT;
+    goto out;
+  }
+  ++scp->refs;
+ out:
+  pthread_mutex_unlock(&shared_cplane_lock);
+  return rc;
+}
+
+
+static void ci_netif_shared_cplane_put(ci_netif_shared_cplane* scp)
+{
+  pthread_mutex_lock(&shared_cplane_lock);
+  ci_assert_gt(scp->refs, 0);
+  if( --scp->refs == 0 ) {
+    oo_cp_destroy(&scp->cp);
+    ef_onload_driver_close(scp->cp.fd);
+  }
+  pthread_mutex_unlock(&shared_cplane_lock);
+}
+
+
+/* [created] says that the stack was created by this thread, and so is in
+ * this thread's namespace and can use the shared local control plane.  A
+ * stack that we attach to may be in any namespace. */
+static int ci_netif_init(ci_netif* ni, ef_driver_handle fd, int created)
 {
+  ino_t netns = created ? ci_netif_current_netns() : 0;
   int rc;
-  ef_driver_handle init_net_fd;
 
   ni->driver_handle = fd;
   CI_MAGIC_SET(ni, NETIF_MAGIC);
   ni->flags = 0;
   ni->error_flags = 0;
+  ni->cplane = NULL;
   ni->cplane_init_net = NULL;
 
-  ni->cplane = malloc(sizeof(struct oo_cplane_handle));
-  if( ni->cplane == NULL )
-    return -ENOMEM;
+  if( netns != 0 ) {
+    rc = ci_netif_shared_cplane_get(&shared_cplane_local, netns, 0);
+    if( rc == 0 )
+      ni->cplane = &shared_cplane_local.cp;
+    else if( rc != -ENOENT )
+      goto fail;
+  }
+
+  if( ni->cplane == NULL ) {
+    ni->cplane = malloc(sizeof(struct oo_cplane_handle));
+    if( ni->cplane == NULL )
+      return -ENOMEM;
 
-  rc = oo_cp_create(fd, ni->cplane, CITP_OPTS.sync_cplane, 0);
-  if( rc != 0 ) {
-    ci_log("%s: failed to get local control plane handle: %d", __func__, rc);
-    goto fail;
+    rc = oo_cp_create(fd, ni->cplane, CITP_OPTS.sync_cplane, 0);
+    if( rc != 0 ) {
+      free(ni->cplane);
+      goto fail;
+    }
   }
 
   /* If we need veth acceleration, map in the control plane for the main
    * namespace. */
   rc = oo_resource_op(fd, OO_IOC_VETH_ACCELERATION_ENABLED, NULL);
   if( rc > 0 ) {
-    ni->cplane_init_net = malloc(sizeof(struct oo_cplane_handle));
-    if( ni->cplane_init_net == NULL )
-      goto fail;
-
-    rc = ef_onload_driver_open(&init_net_fd, OO_STACK_DEV, 1);
-    if( rc != 0 ) {
-      ci_log("%s: failed to open driver handle: %d", __func__, rc);
+    rc = ci_netif_shared_cplane_get(&shared_cplane_init_net, 0,
+                                    CP_CREATE_FLAGS_INIT_NET);
+    if( rc == 0 ) {
+      ni->cplane_init_net = &shared_cplane_init_net.cp;
     }
     else {
-      rc = oo_cp_create(init_net_fd, ni->cplane_init_net,
-                        CITP_OPTS.sync_cplane, CP_CREATE_FLAGS_INIT_NET);
-      if( rc != 0 ) {
-        ci_log("%s: failed to get init_net control plane handle: %d", __func__,
-               rc);
-        ef_onload_driver_close(init_net_fd);
-      }
-    }
-
-    if( rc != 0 ) {
       /* We can tolerate failure to map init_net's control plane. */
+      ci_log("%s: failed to get init_net control plane handle: %d", __func__,
+             rc);
       ci_log("%s: support for containers will be limited", __func__);
-      free(ni->cplane_init_net);
-      ni->cplane_init_net = NULL;
     }
   }
 
   return 0;
 
  fail:
-  free(ni->cplane);
+  ci_log("%s: failed to get local control plane handle: %d", __func__, rc);
   return rc;
 }
 
 static void ci_netif_deinit(ci_netif* ni)
 {
-  if( ni->cplane_init_net != NULL ) {
-    oo_cp_destroy(ni->cplane_init_net);
-    ef_onload_driver_close(ni->cplane_init_net->fd);
-    free(ni->cplane_init_net);
-  }
+  if( ni->cplane_init_net != NULL )
+    ci_netif_shared_cplane_put(&shared_cplane_init_net);
 
-  /* The local cplane handle uses the stack's fd, so we don't need to close
-   * that fd now. */
-  oo_cp_destroy(ni->cplane);
-  free(ni->cplane);
+  if( ni->cplane == &shared_cplane_local.cp ) {
+    ci_netif_shared_cplane_put(&shared_cplane_local);
+  }
+  else {
+    /* The private local cplane handle uses the stack's fd, so we don't need
+     * to close that fd now. */
+    oo_cp_destroy(ni->cplane);
+    free(ni->cplane);
+  }
 }
 
 #if CI_CFG_UL_INTERRUPT_HELPER
@@ -2982,7 +3219,7 @@ int ci_netif_ctor(ci_netif* ni, ef_driver_handle fd, const char* stack_name,
   ci_assert(ni);
   ci_netif_sanity_checks();
 
-  rc = ci_netif_init(ni, fd);
+  rc = ci_netif_init(ni, fd, 1);
   if( rc < 0 )
     return rc;
 
@@ -3089,7 +3326,7 @@ static int __ci_netif_init_fill_rx_rings(ci_netif* ni)
   OO_STACK_FOR_EACH_INTF_I(ni, intf_i) {
     int vi_i;
     int n_posted = 0;
-    for( vi_i = 0; vi_i < ci_netif_num_vis(ni); ++vi_i ) {
+    for( vi_i = 0; vi_i < ci_netif_num_rx_vis(ni); ++vi_i ) {
       ef_vi* vi = &ni->nic_hw[intf_i].vis[vi_i];
       n_posted = ci_netif_rx_post(ni, intf_i, vi);
       if( ef_vi_receive_fill_level(vi) < rxq_limit )
@@ -3115,7 +3352,7 @@ int ci_netif_init_fill_rx_rings(ci_netif* ni)
    * available buffers earlier in the initialisation process. So we check
    * whether there has been a successful allocation at some point, rather than
    * whether this particular attempt succeeds. */
-  rc = ci_tcp_helper_more_bufs(ni);
+  rc = ci_tcp_helper_more_bufs(ni, oo_stack_intf_max(ni) > 0 ? 0 : -1);
   if( ni->packets->n_free == 0 ) {
     if( rc != -EINTR )
       LOG_E(ci_log("%s: [%d] ERROR: failed to allocate initial packet set: %d",
@@ -3209,6 +3446,10 @@ int ci_netif_dtor(ci_netif* ni)
 {
   ci_assert(ni);
 
+  /* Packets cached by this process's threads would otherwise be lost to
+   * other users of the stack. */
+  ci_netif_pkt_mags_drain(ni);
+
   /* \TODO Check if we should be calling ci_ipid_dtor() here. */
   /* Free the TCP helper resource */
   netif_tcp_helper_free(ni);
@@ -3317,7 +3558,7 @@ int ci_netif_restore(ci_netif* ni, ef_driver_handle fd,
   
   LOG_NV(ci_log("%s: fd=%d", __FUNCTION__, fd));
 
-  CI_TRY_RET(ci_netif_init(ni, fd));
+  CI_TRY_RET(ci_netif_init(ni, fd, 0));
 
   if( (rc = netif_tcp_helper_restore(ni, netif_mmap_bytes)) != 0) {
     ci_netif_deinit(ni);
@@ -14,6 +14,8 @@
 
 #if !defined(__KERNEL__)
 #include <onload/mmap.h>
+#include <onload/ul/per_thread.h>
+#include <sys/syscall.h>
 
 pthread_mutex_t citp_pkt_map_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -125,6 +127,43 @@ int ci_netif_pktset_best(ci_netif* ni)
 }
 
 
+/* As ci_netif_pktset_best(), but considers only sets whose memory is known
+ * to be on [node], and returns -1 unless one of them has at least
+ * [min_free] free buffers. */
+int ci_netif_pktset_best_node(ci_netif* ni, int node, int min_free)
+{
+  int i, ret = -1, n_free = min_free - 1;
+
+  if( ! ni->packets->n_free )
+    return ret;
+
+  for( i = 0; i < ni->packets->sets_n; i ++ ) {
+    if( ni->packets->set[i].numa_node != node )
+      continue;
+    if( ni->packets->set[i].n_free > n_free ) {
+      n_free = ni->packets->set[i].n_free;
+      ret = i;
+    }
+    if( n_free >= CI_CFG_PKT_SET_HIGH_WATER )
+      return ret;
+  }
+  return ret;
+}
+
+
+int ci_netif_numa_node_here(void)
+{
+#ifdef __KERNEL__
+  return numa_node_id();
+#else
+  unsigned cpu, node;
+  if( syscall(SYS_getcpu, &cpu, &node, NULL) < 0 )
+    return -1;
+  return node;
+#endif
+}
+
+
 ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow_ptrerr(ci_netif* ni, int flags)
 {
   /* This is the slow path of ci_netif_pkt_alloc() and
@@ -157,7 +196,14 @@ ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow_ptrerr(ci_netif* ni, int flags)
 #if OO_DO_STACK_POLL
  again:
 #endif
-  bufset_id = ci_netif_pktset_best(ni);
+  bufset_id = -1;
+  if( NI_OPTS(ni).pkt_numa )
+    bufset_id = ci_netif_pktset_best_node(ni, ci_netif_numa_node_here(), 1);
+  if( bufset_id == -1 ) {
+    bufset_id = ci_netif_pktset_best(ni);
+    if( bufset_id != -1 && NI_OPTS(ni).pkt_numa )
+      CITP_STATS_NETIF_INC(ni, pkt_set_numa_remote);
+  }
   if( bufset_id != -1 ) {
     ci_netif_pkt_set_change(ni, bufset_id,
                             ci_netif_pkt_set_is_underfilled(ni, bufset_id));
@@ -166,7 +212,7 @@ ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow_ptrerr(ci_netif* ni, int flags)
 
   while( ni->packets->sets_n < ni->packets->sets_max ) {
     int old_n_freepkts = ni->packets->n_free;
-    int rc = ci_tcp_helper_more_bufs(ni);
+    int rc = ci_tcp_helper_more_bufs(ni, -1);
     if( rc != 0 ) {
       err = rc;
       break;
@@ -301,6 +347,8 @@ int ci_netif_pkt_try_to_free(ci_netif* ni, int desperation, int stop_once_freed_
 {
   unsigned id;
   int freed = 0;
+  unsigned hog_pkts = NI_OPTS(ni).max_rx_packets >>
+                      NI_OPTS(ni).tcp_sockbuf_max_fraction;
 
   ci_assert(ci_netif_is_locked(ni));
   ci_assert_ge(desperation, 0);
@@ -314,10 +362,29 @@ int ci_netif_pkt_try_to_free(ci_netif* ni, int desperation, int stop_once_freed_
             == CI_NETIF_PKT_TRY_TO_FREE_MAX_DESP);
   CITP_STATS_NETIF(++(&ni->state->stats.pkt_scramble0)[desperation]);
 
+  /* Go to the TCP sockets holding more than a fair share of the receive
+   * buffers first, so that one slow reader pays for the shortage it
+   * caused, rather than whichever sockets happen to have the lowest ids.
+   */
   for( id = 0; id < ni->state->n_ep_bufs; ++id ) {
     citp_waitable_obj* wo = ID_TO_WAITABLE_OBJ(ni, id);
-    if( wo->waitable.state & CI_TCP_STATE_TCP_CONN )
+    if( (wo->waitable.state & CI_TCP_STATE_TCP_CONN) &&
+        __ci_tcp_rx_buf_count(ni, &wo->tcp) > hog_pkts ) {
+      int n = ci_tcp_try_to_free_pkts(ni, &wo->tcp, desperation);
+      CITP_STATS_NETIF_ADD(ni, pkt_scramble_hog_freed, n);
+      freed += n;
+      if( freed >= stop_once_freed_n )
+        return freed;
+    }
+  }
+
+  for( id = 0; id < ni->state->n_ep_bufs; ++id ) {
+    citp_waitable_obj* wo = ID_TO_WAITABLE_OBJ(ni, id);
+    if( wo->waitable.state & CI_TCP_STATE_TCP_CONN ) {
+      if( __ci_tcp_rx_buf_count(ni, &wo->tcp) > hog_pkts )
+        continue;
       freed += ci_tcp_try_to_free_pkts(ni, &wo->tcp, desperation);
+    }
     else if( wo->waitable.state == CI_TCP_STATE_UDP )
       freed += ci_udp_try_to_free_pkts(ni, &wo->udp, desperation);
     if( freed >= stop_once_freed_n )
@@ -327,6 +394,190 @@ int ci_netif_pkt_try_to_free(ci_netif* ni, int desperation, int stop_once_freed_
 }
 
 
+/* Move up to EF_NONB_POOL_REFILL buffers from the free pool of the current
+ * packet set to the non-blocking pool.  Called by a sender that had to take
+ * the lock because the non-blocking pool was empty, so that other senders
+ * running concurrently can allocate without the lock.
+ */
+static void ci_netif_pkt_nonb_refill(ci_netif* ni)
+{
+  int bufset_id = NI_PKT_SET(ni);
+  ci_ip_pkt_fmt* tail = NULL;
+  ci_ip_pkt_fmt* pkt;
+  oo_pkt_p head = OO_PP_NULL;
+  int n;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  for( n = 0; n < NI_OPTS(ni).nonb_pool_refill; ++n ) {
+    if( ! ci_netif_pkt_tx_may_alloc(ni) ||
+        ni->packets->set[bufset_id].n_free == 0 )
+      break;
+    pkt = ci_netif_pkt_get(ni, bufset_id);
+    pkt->refcount = 0;
+    pkt->flags = CI_PKT_FLAG_NONB_POOL;
+    pkt->next = head;
+    head = OO_PKT_P(pkt);
+    if( tail == NULL )
+      tail = pkt;
+  }
+
+  if( n != 0 ) {
+    ci_netif_pkt_free_nonb_list(ni, head, tail);
+    ni->state->n_async_pkts += n;
+    CITP_STATS_NETIF_ADD(ni, pkt_nonb_refill, n);
+  }
+}
+
+
+#ifndef __KERNEL__
+
+/* Claim the calling thread's packet cache for this stack, or return NULL
+ * if another thread sharing the same cache is using it. */
+static union oo_pkt_magazine* ci_netif_pkt_mag_get(ci_netif* ni)
+{
+  static ci_uint32 next_slot;
+  struct oo_per_thread* pt = __oo_per_thread_get();
+  union oo_pkt_magazine* mag;
+  ci_uint32 slot;
+
+  if(CI_UNLIKELY( pt->pkt_mag_slot == 0 )) {
+    do
+      slot = next_slot;
+    while( ci_cas32u_fail(&next_slot, slot, slot + 1) );
+    pt->pkt_mag_slot = (slot & (CI_CFG_PKT_MAGAZINES - 1)) + 1;
+  }
+
+  mag = &ni->pkt_mags[pt->pkt_mag_slot - 1];
+  if( ci_cas32u_fail(&mag->m.busy, 0, 1) )
+    return NULL;
+  return mag;
+}
+
+
+ci_inline void ci_netif_pkt_mag_put(union oo_pkt_magazine* mag)
+{
+  ci_wmb();
+  mag->m.busy = 0;
+}
+
+
+/* Return the [n] packets starting at [head] to the non-blocking pool. */
+static void ci_netif_pkt_mag_give_back(ci_netif* ni, oo_pkt_p head, int n)
+{
+  ci_ip_pkt_fmt* tail = PKT(ni, head);
+  int i;
+
+  for( i = 1; i < n; ++i )
+    tail = PKT(ni, tail->next);
+  ci_netif_pkt_free_nonb_list(ni, head, tail);
+  CITP_STATS_NETIF_ADD(ni, pkt_mag_drain, n);
+}
+
+
+/* Fill an empty cache by taking the whole of the non-blocking pool in one
+ * go, keeping up to EF_PKT_MAGAZINE packets and putting the rest back.
+ * Taking the whole list leaves the pool's generation count as it was, but
+ * is safe from ABA because a racing ci_netif_pkt_alloc_nonb() can only
+ * succeed against a list that contains its packet, and any list put back
+ * afterwards has a new generation.
+ */
+static int ci_netif_pkt_mag_refill(ci_netif* ni, union oo_pkt_magazine* mag)
+{
+  volatile ci_uint64* nonb_pkt_pool_ptr = &ni->state->nonb_pkt_pool;
+  ci_ip_pkt_fmt* tail;
+  ci_uint64 link;
+  oo_pkt_p rest;
+  unsigned id;
+  int n;
+
+  ci_assert_equal(mag->m.n, 0);
+
+  do {
+    link = *nonb_pkt_pool_ptr;
+    id = link & 0xffffffff;
+    if( id == 0xffffffff )
+      return 0;
+  } while( ci_cas64u_fail(nonb_pkt_pool_ptr, link, link | 0xffffffff) );
+
+  OO_PP_INIT(ni, mag->m.head, id);
+  tail = PKT(ni, mag->m.head);
+  for( n = 1; n < NI_OPTS(ni).pkt_magazine && OO_PP_NOT_NULL(tail->next); ++n )
+    tail = PKT(ni, tail->next);
+  rest = tail->next;
+  tail->next = OO_PP_NULL;
+  mag->m.n = n;
+  CITP_STATS_NETIF_INC(ni, pkt_mag_refill);
+
+  if( OO_PP_NOT_NULL(rest) ) {
+    for( n = 1, tail = PKT(ni, rest); OO_PP_NOT_NULL(tail->next); ++n )
+      tail = PKT(ni, tail->next);
+    ci_netif_pkt_free_nonb_list(ni, rest, tail);
+    CITP_STATS_NETIF_ADD(ni, pkt_mag_drain, n);
+  }
+  return 1;
+}
+
+
+ci_ip_pkt_fmt* ci_netif_pkt_alloc_nonb_cached(ci_netif* ni)
+{
+  union oo_pkt_magazine* mag;
+  ci_ip_pkt_fmt* pkt = NULL;
+
+  if( NI_OPTS(ni).pkt_magazine == 0 ||
+      (mag = ci_netif_pkt_mag_get(ni)) == NULL )
+    return ci_netif_pkt_alloc_nonb(ni);
+
+  if( mag->m.n != 0 || ci_netif_pkt_mag_refill(ni, mag) ) {
+    pkt = PKT(ni, mag->m.head);
+    mag->m.head = pkt->next;
+    --mag->m.n;
+    ci_assert_equal(pkt->refcount, 0);
+    pkt->refcount = 1;
+    CI_DEBUG(pkt->intf_i = -1);
+    CITP_STATS_NETIF_INC(ni, pkt_mag_alloc);
+  }
+
+  ci_netif_pkt_mag_put(mag);
+  return pkt;
+}
+
+
+void ci_netif_pkt_mags_init(ci_netif* ni)
+{
+  int i;
+
+  for( i = 0; i < CI_CFG_PKT_MAGAZINES; ++i ) {
+    ni->pkt_mags[i].m.busy = 0;
+    ni->pkt_mags[i].m.n = 0;
+    ni->pkt_mags[i].m.head = OO_PP_NULL;
+  }
+}
+
+
+void ci_netif_pkt_mags_drain(ci_netif* ni)
+{
+  union oo_pkt_magazine* mag;
+  int i;
+
+  for( i = 0; i < CI_CFG_PKT_MAGAZINES; ++i ) {
+    mag = &ni->pkt_mags[i];
+    /* A cache in use is left alone: its thread is still running, and will
+     * carry on using it. */
+    if( mag->m.n == 0 || ci_cas32u_fail(&mag->m.busy, 0, 1) )
+      continue;
+    if( mag->m.n != 0 ) {
+      ci_netif_pkt_mag_give_back(ni, mag->m.head, mag->m.n);
+      mag->m.n = 0;
+      mag->m.head = OO_PP_NULL;
+    }
+    ci_netif_pkt_mag_put(mag);
+  }
+}
+
+#endif
+
+
 int ci_netif_pkt_alloc_block(ci_netif* ni, ci_sock_cmn* s,
                              int* p_netif_locked,
                              int can_block,
@@ -339,7 +590,7 @@ int ci_netif_pkt_alloc_block(ci_netif* ni, ci_sock_cmn* s,
 
  again:
   if( *p_netif_locked == 0 ) {
-    if( (pkt = ci_netif_pkt_alloc_nonb(ni)) ) {
+    if( (pkt = ci_netif_pkt_alloc_nonb_cached(ni)) ) {
       *p_pkt = pkt;
       return 0;
     }
@@ -362,6 +613,7 @@ int ci_netif_pkt_alloc_block(ci_netif* ni, ci_sock_cmn* s,
        * pool.  So arrange for it to be freed to that pool.
        */
       pkt->flags = CI_PKT_FLAG_NONB_POOL;
+      ci_netif_pkt_nonb_refill(ni);
     }
     *p_pkt = pkt;
     return 0;
@@ -15,6 +15,7 @@
 
   
 #include "ip_internal.h"
+#include <ci/internal/more_stats.h>
 
 
 #if OO_DO_STACK_POLL
@@ -682,6 +683,32 @@ ci_netif_stats_action(__NI_STRUCT__ *ni,
 }
 
 
+#if CI_CFG_STATS_NETIF
+void ci_netif_stats_publish(ci_netif* ni)
+{
+  ci_netif_stats_pub* pub = &ni->state->stats_pub;
+  ci_iptime_t ticks;
+
+  /* Readers treat an odd [seq] as a write in progress. */
+  ++pub->seq;
+  ci_wmb();
+  memcpy(&pub->stats, &ni->state->stats, sizeof(pub->stats));
+  get_more_stats(ni, &pub->more_stats);
+#if CI_CFG_SUPPORT_STATS_COLLECTION
+  memcpy(&pub->ip_stats, &ni->state->stats_snapshot, sizeof(pub->ip_stats));
+#endif
+  ci_frc64(&pub->frc);
+  pub->version = CI_NETIF_STATS_PUB_VERSION;
+  ci_wmb();
+  ++pub->seq;
+
+  ticks = ci_tcp_time_ms2ticks(ni, NI_OPTS(ni).stats_publish_ms);
+  ci_ip_timer_set(ni, &ni->state->stats_pub_tid,
+                  ci_tcp_time_now(ni) + CI_MAX(ticks, 1));
+}
+#endif
+
+
 #endif        /* CI_CFG_SUPPORT_STATS_COLLECTION */
 
 /*! \cidoxg_end */
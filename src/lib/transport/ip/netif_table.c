@@ -169,6 +169,33 @@ ci_netif_filter_lookup(ci_netif* netif, int af_space,
   return OO_SP_NULL;
 }
 
+/* The two stages of the socket prefetch in ci_netif_poll_evq().  The
+ * first finds where a lookup of the given IPv4 tuple starts and prefetches
+ * that entry.  The second, made once the entry is likely to have arrived,
+ * prefetches the socket it names.  Neither checks that the socket matches
+ * the tuple: a wrong guess only wastes a prefetch. */
+unsigned
+ci_netif_filter_prefetch_entry(ci_netif* netif, unsigned laddr, unsigned lport,
+                               unsigned raddr, unsigned rport,
+                               unsigned protocol)
+{
+  ci_netif_filter_table* tbl = netif->filter_table;
+  unsigned hash1;
+
+  hash1 = __onload_hash1(tbl->table_size_mask, laddr, lport,
+                         raddr, rport, protocol);
+  ci_prefetch(&tbl->table[hash1]);
+  return hash1;
+}
+
+void ci_netif_filter_prefetch_sock(ci_netif* netif, unsigned tbl_i)
+{
+  ci_netif_filter_table_entry_fast* entry = &netif->filter_table->table[tbl_i];
+
+  if( OCCUPIED(entry) )
+    ci_prefetch(ID_TO_SOCK(netif, __CI_TBL_ID(entry)));
+}
+
 int ci_netif_listener_lookup(ci_netif* netif, int af_space,
                              ci_addr_t laddr, unsigned lport)
 {
@@ -10,6 +10,18 @@
 #define TOMBSTONE  -1
 #define EMPTY      -2
 
+
+/* Compare [a] with an address stored in the table or a socket's cached
+ * headers.  These are only byte arrays, so copy out to compare as two
+ * 64-bit words rather than calling memcmp() on every probe. */
+static inline int ip6_addr_eq(const ci_addr_t* a, const ci_ip6_addr_t b)
+{
+  ci_addr_t b_addr;
+  memcpy(b_addr.ip6, b, sizeof(b_addr.ip6));
+  return CI_IPX_ADDR_EQ(*a, b_addr);
+}
+
+
 int ci_ip6_netif_filter_lookup(ci_netif* netif,
                                ci_addr_t laddr, unsigned lport,
                                ci_addr_t raddr, unsigned rport,
@@ -44,8 +56,8 @@ int ci_ip6_netif_filter_lookup(ci_netif* netif,
       if( ((lport    - sock_lport_be16(s)     ) |
            (rport    - sock_rport_be16(s)     ) |
            (protocol - sock_protocol(s)       )) == 0 &&
-          memcmp(laddr.ip6, tbl->table[hash1].laddr, sizeof(laddr)) == 0 &&
-          memcmp(raddr.ip6, sock_ip6_raddr(s), sizeof(raddr)) == 0 )
+          ip6_addr_eq(&laddr, tbl->table[hash1].laddr) &&
+          ip6_addr_eq(&raddr, sock_ip6_raddr(s)) )
         return hash1;
     }
     if( id == EMPTY )  break;
@@ -146,15 +158,14 @@ ci_netif_filter_for_each_match_ip6(ci_netif* ni,
       int is_match = 0;
 
       ci_sock_cmn* s = ID_TO_SOCK(ni, id);
-      if( memcmp(laddr_ptr, ip6_tbl->table[hash1].laddr,
-                 sizeof(ci_ip6_addr_t)) == 0 &&
-          lport == sock_lport_be16(s) &&
+      /* Ports first: they are cheaper and rule out most other entries. */
+      if( lport == sock_lport_be16(s) &&
           protocol == sock_protocol(s) &&
           ( (raddr_ptr == NULL && !(s->s_flags & CI_SOCK_FLAG_CONNECTED)) ||
             (raddr_ptr != NULL &&
-             memcmp(raddr_ptr, sock_ip6_raddr(s),
-                    sizeof(ci_ip6_addr_t)) == 0 &&
-             rport == sock_rport_be16(s)) )
+             rport == sock_rport_be16(s) &&
+             ip6_addr_eq(raddr_ptr, sock_ip6_raddr(s))) ) &&
+          ip6_addr_eq(laddr_ptr, ip6_tbl->table[hash1].laddr)
         )
         is_match = 1;
       LOG_NV(ci_log("%s match=%d: %s " IPX_PORT_FMT "->"
@@ -342,7 +353,7 @@ ci_ip6_netif_filter_remove(ci_ip6_netif_filter_table* tbl,
   while( 1 ) {
     entry = &tbl->table[tbl_i];
     if( entry->id == OO_SP_TO_INT(sock_p) ) {
-      if( !memcmp(laddr.ip6, entry->laddr, sizeof(entry->laddr)) )
+      if( ip6_addr_eq(&laddr, entry->laddr) )
         break;
     }
     else if( entry->id == EMPTY ) {
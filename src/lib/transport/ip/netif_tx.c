@@ -20,23 +20,10 @@
 
 #if OO_DO_STACK_POLL
 
+/* Only the primary VI may use PIO and CTPIO. */
 static inline bool is_to_primary_vi(ci_ip_pkt_fmt* pkt)
 {
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
-  return pkt->q_id == CI_Q_ID_NORMAL;
-#else
-  return true;
-#endif
-}
-
-
-static inline int pkt_q_id(ci_ip_pkt_fmt* pkt)
-{
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
-  return pkt->q_id;
-#else
-  return 0;
-#endif
+  return ci_netif_pkt_q_id(pkt) == CI_Q_ID_NORMAL;
 }
 
 
@@ -92,15 +79,18 @@ static inline int tx_ctpio(ci_netif* ni, int intf_i, ef_vi* vi,
   rc = ef_vi_transmitv_ctpio_fallback(vi, iov, iov_len,
                                       OO_PKT_ID(pkt));
   ci_assert_equal(rc, 0);
+  pkt->flags |= CI_PKT_FLAG_TX_CTPIO;
+  ci_netif_tx_adapt_posted(ni, pkt, CI_TX_MECH_CTPIO);
   return rc;
 }
 #endif
 
 
 /* [is_fresh] is a hint indicating that the requested TXs are latency-
- * sensitive. */
+ * sensitive.  Packets are moved only while the ring holds fewer than
+ * [fill_max] descriptors. */
 static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
-                                  int intf_i, int is_fresh)
+                                  int intf_i, int is_fresh, unsigned fill_max)
 {
   ci_ip_pkt_fmt* pkt = PKT_CHK(ni, dmaq->head);
   int rc;
@@ -108,7 +98,7 @@ static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
  #ifdef __KERNEL__
   int ctpio = 0;
  #else
-  int ctpio = is_fresh;
+  int ctpio = is_fresh && vi == ci_netif_vi(ni, intf_i);
  #endif
 
   /* In a non-CTPIO world, we don't need to track whether we've posted any DMA
@@ -124,7 +114,8 @@ static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
     pkt = PKT_CHK(ni, dmaq->head);
     ci_assert(pkt->flags & CI_PKT_FLAG_TX_PENDING);
     ci_assert_equal(intf_i, pkt->intf_i);
-    ci_assert_equal(dmaq, &ni->state->nic[intf_i].dmaq[pkt_q_id(pkt)]);
+    ci_assert(dmaq == &ni->state->nic[intf_i].dmaq[ci_netif_pkt_q_id(pkt)] ||
+              dmaq == ci_netif_dmaq_bulk(ni, intf_i));
     {
       ef_iovec iov[CI_IP_PKT_SEGMENTS_MAX];
       int iov_len;
@@ -172,6 +163,8 @@ static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
                       ! ci_netif_may_ctpio(ni, intf_i, pkt->pay_len) ||
                       pkt->flags & CI_PKT_FLAG_INDIRECT) )
           ctpio = 0;
+        else if( ctpio )
+          ctpio = ci_netif_tx_mech(ni, pkt, 0, 1) == CI_TX_MECH_CTPIO;
         ctpio |= !! (ni->state->nic[pkt->intf_i].oo_vi_flags & OO_VI_FLAGS_TX_CTPIO_ONLY);
         if( ctpio ) {
           ci_assert(! posted_dma);
@@ -181,10 +174,13 @@ static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
 #endif
         {
           rc = ef_vi_transmitv_init(vi, iov, iov_len, OO_PKT_ID(pkt));
+          if( rc >= 0 ) {
 #if CI_CFG_CTPIO
-          if( rc >= 0 )
             posted_dma = 1;
 #endif
+            if( vi == ci_netif_vi(ni, intf_i) )
+              ci_netif_tx_adapt_posted(ni, pkt, CI_TX_MECH_DMA);
+          }
         }
       }
       if( rc >= 0 ) {
@@ -201,7 +197,8 @@ static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
       }
     }
   }
-  while( oo_pktq_not_empty(dmaq) );
+  while( oo_pktq_not_empty(dmaq) &&
+         (unsigned) ef_vi_transmit_fill_level(vi) < fill_max );
 
 #if CI_CFG_CTPIO
   /* If everything went out by CTPIO, there will be no outstanding DMA
@@ -211,8 +208,9 @@ static void __ci_netif_dmaq_shove(ci_netif* ni, oo_pktq* dmaq, ef_vi* vi,
     return;
 
   /* We're doing a DMA send, so there's no point attempting CTPIO now until
-   * the TXQ has drained. */
-  ci_netif_ctpio_desist(ni, intf_i);
+   * the TXQ has drained.  Only the primary VI does CTPIO. */
+  if( vi == ci_netif_vi(ni, intf_i) )
+    ci_netif_ctpio_desist(ni, intf_i);
 #endif
 
   ef_vi_transmit_push(vi);
@@ -225,7 +223,7 @@ void ci_netif_dmaq_shove1(ci_netif* ni, int intf_i)
   ef_vi* vi = ci_netif_vi(ni, intf_i);
   if( ef_vi_transmit_space(vi) >= (ef_vi_transmit_capacity(vi) >> 1) )
     __ci_netif_dmaq_shove(ni, ci_netif_dmaq(ni, intf_i), vi, intf_i,
-                          0 /*is_fresh*/);
+                          0 /*is_fresh*/, ~0u);
 }
 
 
@@ -233,18 +231,31 @@ void ci_netif_dmaq_shove2(ci_netif* ni, int intf_i, int is_fresh)
 {
   ef_vi* vi = ci_netif_vi(ni, intf_i);
   if( ef_vi_transmit_space(vi) > CI_IP_PKT_SEGMENTS_MAX )
-    __ci_netif_dmaq_shove(ni, ci_netif_dmaq(ni, intf_i), vi, intf_i, is_fresh);
+    __ci_netif_dmaq_shove(ni, ci_netif_dmaq(ni, intf_i), vi, intf_i, is_fresh,
+                          ~0u);
 }
 
 
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
-void ci_netif_dmaq_shove_plugin(ci_netif* ni, int intf_i, int q_id)
+void ci_netif_dmaq_shove_bulk(ci_netif* ni, int intf_i)
+{
+  ef_vi* vi = ci_netif_vi(ni, intf_i);
+  unsigned fill_max = NI_OPTS(ni).tx_bulk_fill_max;
+  if( ci_netif_dmaq_is_empty(ni, intf_i) &&
+      (unsigned) ef_vi_transmit_fill_level(vi) < fill_max &&
+      ef_vi_transmit_space(vi) > CI_IP_PKT_SEGMENTS_MAX )
+    __ci_netif_dmaq_shove(ni, ci_netif_dmaq_bulk(ni, intf_i), vi, intf_i,
+                          0 /*is_fresh*/, fill_max);
+}
+
+
+#if CI_MAX_VIS_PER_INTF > 1
+void ci_netif_dmaq_shove_q(ci_netif* ni, int intf_i, int q_id)
 {
   ef_vi* vi = &ni->nic_hw[intf_i].vis[q_id];
   ci_assert_ge(q_id, 1);
   if( ef_vi_transmit_space(vi) > CI_IP_PKT_SEGMENTS_MAX )
     __ci_netif_dmaq_shove(ni, &ni->state->nic[intf_i].dmaq[q_id], vi, intf_i,
-                          0 /*is_fresh*/);
+                          0 /*is_fresh*/, ~0u);
 }
 #endif
 
@@ -292,44 +303,63 @@ void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
   intf_i = pkt->intf_i;
 
   ci_assert_lt(pkt->q_id, CI_MAX_VIS_PER_INTF);
-  dmaq = &netif->state->nic[intf_i].dmaq[pkt_q_id(pkt)];
-  vi = &netif->nic_hw[intf_i].vis[pkt_q_id(pkt)];
+  dmaq = &netif->state->nic[intf_i].dmaq[ci_netif_pkt_q_id(pkt)];
+  vi = &netif->nic_hw[intf_i].vis[ci_netif_pkt_q_id(pkt)];
 
   if( oo_pktq_is_empty(dmaq) && ! (pkt->flags & CI_PKT_FLAG_INDIRECT) ) {
+    int may_ctpio = is_to_primary_vi(pkt) &&
+                    ci_netif_may_ctpio(netif, intf_i, pkt->pay_len);
+    int may_pio = 0;
+    int mech;
 #if CI_CFG_PIO
     /* pio_thresh is set to zero if PIO disabled on this stack, so don't
      * need to check NI_OPTS().pio here
      */
+    if( netif->state->nic[intf_i].oo_vi_flags & OO_VI_FLAGS_PIO_EN &&
+        is_to_primary_vi(pkt) )
+      may_pio = pkt->pay_len <= NI_OPTS(netif).pio_thresh &&
+                pkt->n_buffers == 1;
+#endif
+    mech = ci_netif_tx_mech(netif, pkt, may_pio, may_ctpio);
+    /* While coalescing, DMA sends wait on the dmaq for the doorbell that
+     * ci_netif_poll_n() rings at the end of the poll.  PIO and CTPIO
+     * sends don't use the doorbell, so gain nothing by waiting. */
+    if( mech == CI_TX_MECH_DMA && netif->state->tx_coalesce_active ) {
+      CITP_STATS_NETIF_INC(netif, tx_coalesce_deferred);
+      goto enqueue;
+    }
+#if CI_CFG_PIO
     order = ci_log2_ge(pkt->pay_len, CI_CFG_MIN_PIO_BLOCK_ORDER);
     buddy = &netif->state->nic[intf_i].pio_buddy;
-    if( ! ci_netif_may_ctpio(netif, intf_i, pkt->pay_len) &&
-        netif->state->nic[intf_i].oo_vi_flags & OO_VI_FLAGS_PIO_EN &&
-        is_to_primary_vi(pkt) ) {
-      if( pkt->pay_len <= NI_OPTS(netif).pio_thresh && pkt->n_buffers == 1 ) {
-        if( (offset = ci_pio_buddy_alloc(netif, buddy, order)) >= 0 ) {
-          rc = ef_vi_transmit_copy_pio(vi,
-                                       offset, PKT_START(pkt), pkt->buf_len,
-                                       OO_PKT_ID(pkt));
-          if( rc == 0 ) {
-            CITP_STATS_NETIF_INC(netif, pio_pkts);
-            ci_assert(pkt->pio_addr == -1);
-            pkt->pio_addr = offset;
-            pkt->pio_order = order;
-            return;
-          }
-          else {
-            CITP_STATS_NETIF_INC(netif, no_pio_err);
-            ci_pio_buddy_free(netif, buddy, offset, order);
-            /* Continue and do normal send. */
-          }
+    if( mech == CI_TX_MECH_PIO ) {
+      if( (offset = ci_pio_buddy_alloc(netif, buddy, order)) >= 0 ) {
+        rc = ef_vi_transmit_copy_pio(vi,
+                                     offset, PKT_START(pkt), pkt->buf_len,
+                                     OO_PKT_ID(pkt));
+        if( rc == 0 ) {
+          CITP_STATS_NETIF_INC(netif, pio_pkts);
+          ci_assert(pkt->pio_addr == -1);
+          pkt->pio_addr = offset;
+          pkt->pio_order = order;
+          ci_netif_tx_adapt_posted(netif, pkt, CI_TX_MECH_PIO);
+          return;
         }
         else {
-          CI_DEBUG(CITP_STATS_NETIF_INC(netif, no_pio_busy));
+          CITP_STATS_NETIF_INC(netif, no_pio_err);
+          ci_pio_buddy_free(netif, buddy, offset, order);
+          /* Continue and do normal send. */
         }
       }
       else {
-        CI_DEBUG(CITP_STATS_NETIF_INC(netif, no_pio_too_long));
+        CI_DEBUG(CITP_STATS_NETIF_INC(netif, no_pio_busy));
       }
+      ci_netif_tx_adapt_pio_failed(netif, pkt);
+      mech = may_ctpio ? CI_TX_MECH_CTPIO : CI_TX_MECH_DMA;
+    }
+    else if( ! may_pio && ! may_ctpio &&
+             netif->state->nic[intf_i].oo_vi_flags & OO_VI_FLAGS_PIO_EN &&
+             is_to_primary_vi(pkt) ) {
+      CI_DEBUG(CITP_STATS_NETIF_INC(netif, no_pio_too_long));
     }
 #endif
     calc_csum_if_needed(netif, vi, pkt);
@@ -349,8 +379,7 @@ void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
 
 #if CI_CFG_CTPIO
     if( (iov_len > 0) && (iov_len <= CI_IP_PKT_SEGMENTS_MAX) &&
-        ci_netif_may_ctpio(netif, intf_i, pkt->pay_len) &&
-        is_to_primary_vi(pkt) ) {
+        mech == CI_TX_MECH_CTPIO ) {
       rc = tx_ctpio(netif, intf_i, vi, pkt, iov, iov_len);
     }
     else
@@ -358,7 +387,10 @@ void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
     if( (rc = ef_vi_transmitv(vi, iov, iov_len, OO_PKT_ID(pkt))) == 0 ) {
       /* After a DMA send, stop attempting CTPIO sends until the TXQ has
        * drained. */
-      ci_netif_ctpio_desist(netif, intf_i);
+      if( is_to_primary_vi(pkt) ) {
+        ci_netif_ctpio_desist(netif, intf_i);
+        ci_netif_tx_adapt_posted(netif, pkt, CI_TX_MECH_DMA);
+      }
       CITP_STATS_NETIF_INC(netif, tx_dma_doorbells);
     }
     if( rc == 0 ) {
@@ -368,6 +400,7 @@ void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
     }
   }
 
+enqueue:
   /* drop to here if any of the above methods to send directly failed
    * - put it on the DMA queue instead
    */
@@ -405,7 +438,7 @@ bool ci_netif_send_immediate(ci_netif* netif, ci_ip_pkt_fmt* pkt,
   intf_i = pkt->intf_i;
 
   ci_assert_lt(pkt->q_id, CI_MAX_VIS_PER_INTF);
-  vi = &netif->nic_hw[intf_i].vis[pkt_q_id(pkt)];
+  vi = &netif->nic_hw[intf_i].vis[ci_netif_pkt_q_id(pkt)];
 
   iov_len = ci_netif_pkt_to_iovec(netif, pkt, iov,
                                   sizeof(iov) / sizeof(iov[0]));
@@ -267,6 +267,178 @@ ci_inline void ci_netif_ctpio_resume(ci_netif* ni, int intf_i)
 #endif
 }
 
+/**********************************************************************
+ * Choice of TX mechanism (EF_TX_ADAPTIVE).
+ */
+
+#if CI_CFG_TX_ADAPTIVE
+/* One decision in CI_TX_ADAPT_EXPLORE_MASK + 1 is spent cycling through the
+ * permitted mechanisms, so that the ones not currently preferred keep being
+ * measured. */
+#define CI_TX_ADAPT_EXPLORE_MASK  63u
+#define CI_TX_ADAPT_LAT_SHIFT     3
+#define CI_TX_ADAPT_FB_SHIFT      4
+#define CI_TX_ADAPT_FB_ONE        (1u << 16)
+/* Latency samples are clamped to this, so that one completion handled late
+ * (e.g. because the stack was not being polled) does not dominate. */
+#define CI_TX_ADAPT_LAT_MAX       (1u << 24)
+
+ci_inline ci_tx_adapt_entry_t*
+ci_netif_tx_adapt_entry(ci_netif* ni, int intf_i, int frame_len)
+{
+  int bucket = ci_log2_ge(frame_len, CI_TX_ADAPT_BUCKET_MIN_ORDER) -
+               CI_TX_ADAPT_BUCKET_MIN_ORDER;
+  bucket = CI_MIN(bucket, CI_TX_ADAPT_N_BUCKETS - 1);
+  return &ni->state->nic[intf_i].tx_adapt.entry[bucket * CI_TX_MECH_N];
+}
+
+ci_inline void ci_tx_adapt_fallback_sample(ci_tx_adapt_entry_t* e,
+                                           int fell_back)
+{
+  ci_uint32 target = fell_back ? CI_TX_ADAPT_FB_ONE : 0;
+  e->fallback_ewma += (ci_int32) (target - e->fallback_ewma) >>
+                      CI_TX_ADAPT_FB_SHIFT;
+  e->fallbacks += fell_back;
+}
+
+/* Expected cost in cycles of sending with [e]: its measured latency, plus
+ * that of a DMA send for the fraction of attempts that fell back. */
+ci_inline ci_uint32 ci_tx_adapt_score(const ci_tx_adapt_entry_t* e,
+                                      const ci_tx_adapt_entry_t* dma)
+{
+  ci_uint32 fb_lat = dma->lat_ewma ? dma->lat_ewma : e->lat_ewma;
+  return e->lat_ewma +
+         (ci_uint32) (((ci_uint64) e->fallback_ewma * fb_lat) >> 16);
+}
+
+/* Returns the mechanism in [allowed] (a mask of 1 << CI_TX_MECH_*) with the
+ * lowest expected cost according to the bucket's entries [e].  [preferred]
+ * is the static choice, which is kept until it has been measured and wins
+ * ties. */
+ci_inline int ci_tx_adapt_best(const ci_tx_adapt_entry_t* e,
+                               unsigned allowed, int preferred)
+{
+  ci_uint32 score, best_score;
+  int mech, best = preferred;
+
+  if( e[preferred].lat_ewma == 0 )
+    return preferred;
+
+  best_score = ci_tx_adapt_score(&e[preferred], &e[CI_TX_MECH_DMA]);
+  for( mech = 0; mech < CI_TX_MECH_N; ++mech ) {
+    if( ! (allowed & (1u << mech)) || e[mech].lat_ewma == 0 )
+      continue;
+    score = ci_tx_adapt_score(&e[mech], &e[CI_TX_MECH_DMA]);
+    if( score < best_score ) {
+      best_score = score;
+      best = mech;
+    }
+  }
+  return best;
+}
+
+/* Chooses one of the mechanisms in [allowed] for a frame of [frame_len]
+ * bytes. */
+ci_inline int ci_netif_tx_adapt_choose(ci_netif* ni, int intf_i,
+                                       int frame_len, unsigned allowed,
+                                       int preferred)
+{
+  ci_tx_adapt_t* ta = &ni->state->nic[intf_i].tx_adapt;
+  int mech;
+
+  if( (++ta->n_decisions & CI_TX_ADAPT_EXPLORE_MASK) == 0 ) {
+    mech = (ta->n_decisions / (CI_TX_ADAPT_EXPLORE_MASK + 1)) % CI_TX_MECH_N;
+    if( allowed & (1u << mech) )
+      return mech;
+  }
+  return ci_tx_adapt_best(ci_netif_tx_adapt_entry(ni, intf_i, frame_len),
+                          allowed, preferred);
+}
+
+/* Records that [pkt] has been posted by [mech], and stamps it so that its
+ * completion latency can be measured. */
+ci_inline void ci_netif_tx_adapt_posted(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                        int mech)
+{
+  if( NI_OPTS(ni).tx_adaptive ) {
+    ci_tx_adapt_entry_t* e = ci_netif_tx_adapt_entry(ni, pkt->intf_i,
+                                                     pkt->pay_len);
+    ++e[mech].attempts;
+    if( mech == CI_TX_MECH_PIO )
+      ci_tx_adapt_fallback_sample(&e[mech], 0);
+    pkt->netif.tx.post_frc = ci_frc32_get() | 1;
+  }
+}
+
+/* Records that a PIO send of [pkt] could not be made. */
+ci_inline void ci_netif_tx_adapt_pio_failed(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  if( NI_OPTS(ni).tx_adaptive ) {
+    ci_tx_adapt_entry_t* e = ci_netif_tx_adapt_entry(ni, pkt->intf_i,
+                                                     pkt->pay_len);
+    ++e[CI_TX_MECH_PIO].attempts;
+    ci_tx_adapt_fallback_sample(&e[CI_TX_MECH_PIO], 1);
+  }
+}
+
+/* Called on completion of a packet stamped by ci_netif_tx_adapt_posted(),
+ * before its PIO region and CTPIO flag are released. */
+ci_inline void ci_netif_tx_adapt_complete(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                          const ef_event* ev)
+{
+  ci_tx_adapt_entry_t* e = ci_netif_tx_adapt_entry(ni, pkt->intf_i,
+                                                   pkt->pay_len);
+  ci_uint32 lat = ci_frc32_get() - pkt->netif.tx.post_frc;
+  int mech = CI_TX_MECH_DMA;
+
+#if CI_CFG_PIO
+  if( pkt->pio_addr >= 0 )
+    mech = CI_TX_MECH_PIO;
+#endif
+#if CI_CFG_CTPIO
+  if( pkt->flags & CI_PKT_FLAG_TX_CTPIO ) {
+    mech = CI_TX_MECH_CTPIO;
+    ci_tx_adapt_fallback_sample(&e[mech], ! EF_EVENT_TX_CTPIO(*ev));
+  }
+#endif
+  lat = CI_MIN(lat, CI_TX_ADAPT_LAT_MAX);
+  if( e[mech].lat_ewma == 0 )
+    e[mech].lat_ewma = lat;
+  else
+    e[mech].lat_ewma += (ci_int32) (lat - e[mech].lat_ewma) >>
+                        CI_TX_ADAPT_LAT_SHIFT;
+  e[mech].lat_ewma = CI_MAX(e[mech].lat_ewma, 1u);
+  pkt->netif.tx.post_frc = 0;
+}
+
+# define ci_netif_tx_adapt_prep(pkt)  ((pkt)->netif.tx.post_frc = 0)
+#else
+# define ci_netif_tx_adapt_posted(ni, pkt, mech)  do{}while(0)
+# define ci_netif_tx_adapt_pio_failed(ni, pkt)    do{}while(0)
+# define ci_netif_tx_adapt_prep(pkt)              do{}while(0)
+#endif
+
+/* Returns the mechanism to try first for [pkt], given whether PIO and CTPIO
+ * are permitted for it.  CTPIO is preferred over PIO, and both over DMA,
+ * unless EF_TX_ADAPTIVE has measured otherwise. */
+ci_inline int ci_netif_tx_mech(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                               int may_pio, int may_ctpio)
+{
+  int mech = may_ctpio ? CI_TX_MECH_CTPIO :
+             may_pio ? CI_TX_MECH_PIO : CI_TX_MECH_DMA;
+#if CI_CFG_TX_ADAPTIVE
+  if( NI_OPTS(ni).tx_adaptive && (may_pio || may_ctpio) &&
+      ! (ni->state->nic[pkt->intf_i].oo_vi_flags &
+         OO_VI_FLAGS_TX_CTPIO_ONLY) )
+    mech = ci_netif_tx_adapt_choose(ni, pkt->intf_i, pkt->pay_len,
+                                    (1u << CI_TX_MECH_DMA) |
+                                    (!! may_pio << CI_TX_MECH_PIO) |
+                                    (!! may_ctpio << CI_TX_MECH_CTPIO),
+                                    mech);
+#endif
+  return mech;
+}
+
 /**********************************************************************
  * DMA queues.
  */
@@ -281,13 +453,30 @@ extern void ci_netif_dmaq_shove1(ci_netif*, int intf_i);
  */
 extern void ci_netif_dmaq_shove2(ci_netif*, int intf_i, int is_fresh);
 
-#if CI_CFG_TCP_OFFLOAD_RECYCLER
-/* Moves packets from the non-first overflow queue (i.e. for communicating
- * with EF100 slice plugins) to the hardware ring if the hardware queue has at
- * least space for one packet.
+/* Moves packets from the bulk queue to the hardware ring while it holds
+ * fewer than EF_TX_BULK_FILL_MAX descriptors and the overflow queue is
+ * empty.
+ */
+extern void ci_netif_dmaq_shove_bulk(ci_netif*, int intf_i);
+
+#if CI_MAX_VIS_PER_INTF > 1
+/* Moves packets from a non-first overflow queue (i.e. for communicating
+ * with EF100 slice plugins, or for one of the extra VIs of EF_TX_VIS) to the
+ * hardware ring if the hardware queue has at least space for one packet.
  */
-void ci_netif_dmaq_shove_plugin(ci_netif* ni, int intf_i, int q_id);
+void ci_netif_dmaq_shove_q(ci_netif* ni, int intf_i, int q_id);
+#endif
+
+
+/* The VI/txq on which [pkt] is to be sent; see ci_ip_pkt_fmt::q_id. */
+ci_inline int ci_netif_pkt_q_id(ci_ip_pkt_fmt* pkt)
+{
+#if CI_MAX_VIS_PER_INTF > 1
+  return pkt->q_id;
+#else
+  return 0;
 #endif
+}
 
 
 #define ci_netif_dmaq(ni, nic_i)  (&(ni)->state->nic[nic_i].dmaq[0])
@@ -299,6 +488,8 @@ void ci_netif_dmaq_shove_plugin(ci_netif* ni, int intf_i, int q_id);
 #define ci_netif_dmaq_not_empty(ni, nic_i)               \
         oo_pktq_not_empty(ci_netif_dmaq((ni), (nic_i)))
 
+#define ci_netif_dmaq_bulk(ni, nic_i)  (&(ni)->state->nic[nic_i].dmaq_bulk)
+
 
 #define __ci_netif_dmaq_put(ni, q, pkt)                         \
   do {                                                          \
@@ -309,9 +500,25 @@ void ci_netif_dmaq_shove_plugin(ci_netif* ni, int intf_i, int q_id);
 
 ci_inline void ci_netif_dmaq_and_vi_for_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
                                             oo_pktq** dmaq, ef_vi** vi) {
-  ci_assert_equal(pkt->q_id, CI_Q_ID_NORMAL);
-  *dmaq = ci_netif_dmaq(ni, pkt->intf_i);
-  *vi = ci_netif_vi(ni, pkt->intf_i);
+  int q_id = ci_netif_pkt_q_id(pkt);
+  ci_assert_lt(q_id, ci_netif_num_tx_vis(ni));
+  *dmaq = &ni->state->nic[pkt->intf_i].dmaq[q_id];
+  *vi = &ni->nic_hw[pkt->intf_i].vis[q_id];
+}
+
+/* Moves packets from the overflow queue to which [pkt] has just been added
+ * to its hardware ring.
+ */
+ci_inline void ci_netif_dmaq_shove_for_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                           int is_fresh)
+{
+#if CI_MAX_VIS_PER_INTF > 1
+  if( ci_netif_pkt_q_id(pkt) != 0 ) {
+    ci_netif_dmaq_shove_q(ni, pkt->intf_i, ci_netif_pkt_q_id(pkt));
+    return;
+  }
+#endif
+  ci_netif_dmaq_shove2(ni, pkt->intf_i, is_fresh);
 }
 
 /* for use from __ci_netif_send() only */
@@ -319,6 +526,8 @@ ci_inline void ci_netif_dmaq_and_vi_for_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
   do {                                                                  \
     ++(ni)->state->nic[(pkt)->intf_i].tx_dmaq_insert_seq;               \
     (ni)->state->nic[(pkt)->intf_i].tx_bytes_added+=TX_PKT_LEN(pkt);    \
+    ci_netif_tx_adapt_prep(pkt);                                        \
+    oo_pkt_sample(ni, pkt, 1);                                          \
     if( oo_tcpdump_check(ni, pkt, (pkt)->intf_i) ) {                    \
       ci_frc64(&((pkt)->tstamp_frc));                                   \
       oo_tcpdump_dump_pkt(ni, pkt);                                     \
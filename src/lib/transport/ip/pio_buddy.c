@@ -116,6 +116,10 @@ ci_pio_buddy_ctor(ci_netif* ni, ci_pio_buddy_allocator* b, unsigned pio_len)
   /* At initialisation we have one free block containing the whole space. */
   ci_pio_buddy_free_list_add(ni, b, pio_order - CI_CFG_MIN_PIO_BLOCK_ORDER, 0);
 
+  for( o = 0; o < CI_PIO_BUDDY_MAX_RESV; ++o )
+    b->resv[o].offset = -1;
+  b->n_resv = 0;
+
   b->initialised = 1;
 }
 
@@ -173,9 +177,9 @@ ci_pio_buddy_alloc(ci_netif* ni, ci_pio_buddy_allocator* b, ci_uint8 order)
 }
 
 
-void
-ci_pio_buddy_free(ci_netif* ni, ci_pio_buddy_allocator* b, ci_int32 offset,
-                  ci_uint8 order)
+static void
+__ci_pio_buddy_free(ci_netif* ni, ci_pio_buddy_allocator* b, ci_int32 offset,
+                    ci_uint8 order)
 {
   ci_uint32 buddy_addr;
   ci_uint32 addr = offset / (1u << CI_CFG_MIN_PIO_BLOCK_ORDER);
@@ -223,4 +227,198 @@ ci_pio_buddy_free(ci_netif* ni, ci_pio_buddy_allocator* b, ci_int32 offset,
 }
 
 
+static ci_pio_buddy_resv*
+ci_pio_buddy_resv_find_offset(ci_pio_buddy_allocator* b, ci_int32 offset)
+{
+  int i;
+  for( i = 0; i < CI_PIO_BUDDY_MAX_RESV; ++i )
+    if( b->resv[i].offset == offset )
+      return &b->resv[i];
+  return NULL;
+}
+
+
+static ci_pio_buddy_resv*
+ci_pio_buddy_resv_find_sock(ci_pio_buddy_allocator* b, oo_sp sock_id)
+{
+  int i;
+  for( i = 0; i < CI_PIO_BUDDY_MAX_RESV; ++i )
+    if( b->resv[i].offset >= 0 && b->resv[i].sock_id == sock_id )
+      return &b->resv[i];
+  return NULL;
+}
+
+
+static void
+ci_pio_buddy_resv_drop(ci_netif* ni, ci_pio_buddy_allocator* b,
+                       ci_pio_buddy_resv* r)
+{
+  __ci_pio_buddy_free(ni, b, r->offset,
+                      r->order + CI_CFG_MIN_PIO_BLOCK_ORDER);
+  r->offset = -1;
+  r->sock_id = OO_SP_NULL;
+  r->in_use = 0;
+  --b->n_resv;
+}
+
+
+void
+ci_pio_buddy_free(ci_netif* ni, ci_pio_buddy_allocator* b, ci_int32 offset,
+                  ci_uint8 order)
+{
+  ci_pio_buddy_resv* r;
+
+  if( b->n_resv && (r = ci_pio_buddy_resv_find_offset(b, offset)) ) {
+    /* Reserved blocks go back to their socket, unless it has given up the
+     * reservation in the meantime. */
+    ci_assert(r->in_use);
+    ci_assert_equal(r->order + CI_CFG_MIN_PIO_BLOCK_ORDER, order);
+    r->in_use = 0;
+    if( OO_SP_IS_NULL(r->sock_id) )
+      ci_pio_buddy_resv_drop(ni, b, r);
+    return;
+  }
+  __ci_pio_buddy_free(ni, b, offset, order);
+}
+
+
+ci_int32
+ci_pio_buddy_alloc_reserved(ci_netif* ni, ci_pio_buddy_allocator* b,
+                            oo_sp sock_id, ci_uint8* order)
+{
+  ci_pio_buddy_resv* r = NULL;
+  ci_int32 offset;
+  int i;
+
+  if( b->n_resv && (r = ci_pio_buddy_resv_find_sock(b, sock_id)) ) {
+    if( r->in_use )
+      /* Another of this socket's templates has it: treat this one as an
+       * ordinary allocation. */
+      return ci_pio_buddy_alloc(ni, b, *order);
+    if( r->order + CI_CFG_MIN_PIO_BLOCK_ORDER >= *order ) {
+      r->in_use = 1;
+      *order = r->order + CI_CFG_MIN_PIO_BLOCK_ORDER;
+      return r->offset;
+    }
+    /* Too small.  Give it up, and reserve a bigger one. */
+    ci_pio_buddy_resv_drop(ni, b, r);
+  }
+
+  offset = ci_pio_buddy_alloc(ni, b, *order);
+  if( offset < 0 )
+    return offset;
+  for( i = 0; i < CI_PIO_BUDDY_MAX_RESV; ++i )
+    if( b->resv[i].offset < 0 ) {
+      r = &b->resv[i];
+      r->sock_id = sock_id;
+      r->offset = offset;
+      r->order = *order - CI_CFG_MIN_PIO_BLOCK_ORDER;
+      r->in_use = 1;
+      ++b->n_resv;
+      break;
+    }
+  return offset;
+}
+
+
+int
+ci_pio_buddy_unreserve(ci_netif* ni, ci_pio_buddy_allocator* b, oo_sp sock_id)
+{
+  ci_pio_buddy_resv* r;
+
+  if( ! b->n_resv || ! (r = ci_pio_buddy_resv_find_sock(b, sock_id)) )
+    return 0;
+  if( r->in_use )
+    /* Freed when the block comes back. */
+    r->sock_id = OO_SP_NULL;
+  else
+    ci_pio_buddy_resv_drop(ni, b, r);
+  return 1;
+}
+
+
+int
+ci_pio_buddy_can_compact(ci_netif* ni, ci_pio_buddy_allocator* b)
+{
+  struct oo_p_dllink_state l;
+  ci_uint8 o;
+  int n;
+
+  if( ! b->initialised )
+    return 0;
+  /* Moving a block can only help if there are two free blocks of the same
+   * order: its buddy, and somewhere to move it to. */
+  for( o = 0; o < CI_PIO_BUDDY_MAX_ORDER; ++o ) {
+    n = 0;
+    oo_p_dllink_for_each(ni, l, FREE_LIST(ni, b, o))
+      if( ++n == 2 )
+        return 1;
+  }
+  return 0;
+}
+
+
+ci_int32
+ci_pio_buddy_relocate(ci_netif* ni, ci_pio_buddy_allocator* b,
+                      ci_int32 offset, ci_uint8 order)
+{
+  struct oo_p_dllink_state l;
+  ci_uint32 addr = offset / (1u << CI_CFG_MIN_PIO_BLOCK_ORDER);
+  ci_uint32 buddy_addr, to;
+  ci_pio_buddy_resv* r;
+
+  order -= CI_CFG_MIN_PIO_BLOCK_ORDER;
+  ci_assert_le(order, CI_PIO_BUDDY_MAX_ORDER);
+  ci_assert(!ci_pio_buddy_addr_in_free_list(ni, b, addr));
+  if( order == CI_PIO_BUDDY_MAX_ORDER )
+    return offset;
+
+  /* Only worth moving if that would let the block's buddy merge. */
+  buddy_addr = addr ^ ci_pow2(order);
+  if( !ci_pio_buddy_addr_in_free_list(ni, b, buddy_addr) ||
+      b->orders[buddy_addr] != order )
+    return offset;
+
+  /* Any other free block of this order has an allocated buddy (else they
+   * would have merged), so filling it costs nothing. */
+  oo_p_dllink_for_each(ni, l, FREE_LIST(ni, b, order)) {
+    to = LINK_TO_ADDR(b, l.l);
+    if( to == buddy_addr )
+      continue;
+
+    DEBUG_ALLOC(ci_log("buddy - relocate %x to %x order %d",
+                       addr, to, order););
+    ci_pio_buddy_free_list_remove(ni, b, to);
+    b->orders[to] = order;
+    __ci_pio_buddy_free(ni, b, offset, order + CI_CFG_MIN_PIO_BLOCK_ORDER);
+    if( b->n_resv && (r = ci_pio_buddy_resv_find_offset(b, offset)) )
+      r->offset = to * (1u << CI_CFG_MIN_PIO_BLOCK_ORDER);
+    return to * (1u << CI_CFG_MIN_PIO_BLOCK_ORDER);
+  }
+  return offset;
+}
+
+
+int
+ci_pio_buddy_compact_reserved(ci_netif* ni, ci_pio_buddy_allocator* b)
+{
+  ci_pio_buddy_resv* r;
+  ci_int32 from;
+  int i, moved = 0;
+
+  /* Idle reservations hold nothing that needs to be copied, so the
+   * allocator can move them itself. */
+  for( i = 0; i < CI_PIO_BUDDY_MAX_RESV; ++i ) {
+    r = &b->resv[i];
+    if( r->offset < 0 || r->in_use )
+      continue;
+    from = r->offset;
+    if( ci_pio_buddy_relocate(ni, b, from,
+                              r->order + CI_CFG_MIN_PIO_BLOCK_ORDER) != from )
+      moved = 1;
+  }
+  return moved;
+}
+
+
 /*! \cidoxg_end */
@@ -306,6 +306,17 @@ static int oo_pipe_read_wait(ci_netif* ni, struct oo_pipe* p, int non_block)
 }
 
 
+/* Whether a reader that has freed a buffer, but not emptied the pipe, should
+ * wake the writer.  With CI_PFD_AFLAG_WAKE_BATCH the writer is left until
+ * the pipe has drained to half full, so that it is woken once to fill half
+ * a pipe rather than once for each buffer. */
+ci_inline int oo_pipe_tx_wake_due(struct oo_pipe* p)
+{
+  return ! (p->aflags & CI_PFD_AFLAG_WAKE_BATCH) ||
+         oo_pipe_data_len(p) <= p->bufs_max * OO_PIPE_BUF_MAX_SIZE / 2;
+}
+
+
 /* Advances from an arbitrary read-point to the next byte that would be read.
  * Returns number of buffers advanced. */
 ci_inline int
@@ -411,7 +422,7 @@ int ci_pipe_read(ci_netif* ni, struct oo_pipe* p,
   p->read_ptr.pp = OO_PKT_P(pkt);
   p->read_ptr.offset = offset;
  wake_and_unlock_out:
-  if( do_wake || bytes_available == rc )
+  if( (do_wake && oo_pipe_tx_wake_due(p)) || bytes_available == rc )
     __oo_pipe_wake_peer(ni, p, CI_SB_FLAG_WAKE_TX);
   ci_sock_unlock(ni, &p->b);
  out:
@@ -158,7 +158,7 @@ void citp_signal_run_pending(citp_signal_info *our_info)
   ci_wmb();
   ci_assert(our_info->c.aflags & OO_SIGNAL_FLAG_HAVE_PENDING);
 
-  ci_atomic32_and(&our_info->c.aflags, ~OO_SIGNAL_FLAG_HAVE_PENDING);
+  oo_signal_flags_and(&our_info->c.aflags, ~OO_SIGNAL_FLAG_HAVE_PENDING);
   for( i = 0; i < OO_SIGNAL_MAX_PENDING; i++ ) {
     siginfo_t saved_info;
     void *saved_context;
@@ -172,16 +172,16 @@ void citp_signal_run_pending(citp_signal_info *our_info)
       memcpy(&saved_info, &our_info->signals[i].saved_info,
              sizeof(saved_info));
     signum = our_info->signals[i].signum;
-    if( ci_cas32_fail(&our_info->signals[i].signum, signum, 0) )
+    if( oo_signal_cas_fail(&our_info->signals[i].signum, signum, 0) )
       break;
 
     if( citp_signal_run_app_handler(
                 signum,
                 saved_context == NULL ? NULL : &saved_info,
                 saved_context) )
-      ci_atomic32_or(&our_info->c.aflags, OO_SIGNAL_FLAG_NEED_RESTART);
+      oo_signal_flags_or(&our_info->c.aflags, OO_SIGNAL_FLAG_NEED_RESTART);
     else
-      ci_atomic32_and(&our_info->c.aflags, ~OO_SIGNAL_FLAG_NEED_RESTART);
+      oo_signal_flags_and(&our_info->c.aflags, ~OO_SIGNAL_FLAG_NEED_RESTART);
   }
   LOG_SIG(log("%s: end", __FUNCTION__));
   errno = old_errno;
@@ -207,7 +207,7 @@ ci_inline void citp_signal_set_pending(int signum, siginfo_t *info,
   for( i = 0; i < OO_SIGNAL_MAX_PENDING; i++ ) {
     if( our_info->signals[i].signum )
       continue;
-    if( ci_cas32_fail(&our_info->signals[i].signum, 0, signum) )
+    if( oo_signal_cas_fail(&our_info->signals[i].signum, 0, signum) )
       continue;
     LOG_SIG(log("%s: signal %d pending", __FUNCTION__, signum));
     ci_assert(info);
@@ -215,7 +215,7 @@ ci_inline void citp_signal_set_pending(int signum, siginfo_t *info,
     memcpy(&our_info->signals[i].saved_info, info, sizeof(siginfo_t));
     our_info->signals[i].saved_context = context;
 
-    ci_atomic32_or(&our_info->c.aflags, OO_SIGNAL_FLAG_HAVE_PENDING);
+    oo_signal_flags_or(&our_info->c.aflags, OO_SIGNAL_FLAG_HAVE_PENDING);
     return;
   }
 
@@ -250,9 +250,9 @@ ci_inline void citp_signal_run_now(int signum, siginfo_t *info,
     LOG_SIG(log("%s: SIGNAL %d - set need restart flag to %d", __FUNCTION__,
                 signum, need_restart));
     if( need_restart )
-      ci_atomic32_or(&our_info->c.aflags, OO_SIGNAL_FLAG_NEED_RESTART);
+      oo_signal_flags_or(&our_info->c.aflags, OO_SIGNAL_FLAG_NEED_RESTART);
     else
-      ci_atomic32_and(&our_info->c.aflags, ~OO_SIGNAL_FLAG_NEED_RESTART);
+      oo_signal_flags_and(&our_info->c.aflags, ~OO_SIGNAL_FLAG_NEED_RESTART);
   }
 }
 
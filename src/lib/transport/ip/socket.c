@@ -13,6 +13,7 @@
 
 /*! \cidoxg_lib_transport_ip */
 #include "ip_internal.h"
+#include <onload/sleep.h>
 
 
 void ci_sock_cmn_reinit(ci_netif* ni, ci_sock_cmn* s)
@@ -77,6 +78,8 @@ void ci_sock_cmn_init(ci_netif* ni, ci_sock_cmn* s, int can_poison)
   memset(&s->so, 0, sizeof(s->so));
   s->so.sndbuf = NI_OPTS(ni).tcp_sndbuf_def;
   s->so.rcvbuf = NI_OPTS(ni).tcp_rcvbuf_def;
+  s->so_max_pacing_rate = CI_PACING_RATE_UNLIMITED;
+  s->zc_id_next = s->zc_id_unreported = 0;
 
   s->rx_bind2dev_ifindex = CI_IFID_BAD;
   /* These don't really need to be initialised, as only significant when
@@ -115,6 +118,20 @@ void ci_sock_cmn_init(ci_netif* ni, ci_sock_cmn* s, int can_poison)
 }
 
 
+#ifndef __KERNEL__
+/* Account for [n] MSG_ZEROCOPY sends on [s].  We copied their payload, so
+ * they are already complete: make the notification visible on the error
+ * queue and wake anyone waiting for POLLERR. */
+void ci_sock_zc_copied(ci_netif* ni, ci_sock_cmn* s, unsigned n)
+{
+  ci_netif_lock(ni);
+  s->zc_id_next += n;
+  citp_waitable_wake_not_in_poll(ni, &s->b, CI_SB_FLAG_WAKE_RX);
+  ci_netif_unlock(ni);
+}
+#endif
+
+
 void ci_sock_cmn_dump(ci_netif* ni, ci_sock_cmn* s, const char* pf,
                       oo_dump_log_fn_t logger, void* log_arg)
 {
@@ -137,6 +154,9 @@ void ci_sock_cmn_dump(ci_netif* ni, ci_sock_cmn* s, const char* pf,
          s->os_sock_status >> OO_OS_STATUS_SEQ_SHIFT,
          (s->os_sock_status & OO_OS_STATUS_RX) ? ",RX":"",
          (s->os_sock_status & OO_OS_STATUS_TX) ? ",TX":"");
+  if( s->s_aflags & CI_SOCK_AFLAG_ZEROCOPY )
+    logger(log_arg, "%s  zerocopy: next_id=%u unreported=%u", pf,
+           s->zc_id_next, s->zc_id_next - s->zc_id_unreported);
 
   if( s->b.ready_lists_in_use != 0 ) {
     ci_uint32 tmp, i;
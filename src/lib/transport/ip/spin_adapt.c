@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Adaptive spinning (EF_SPIN_ADAPT).
+ *
+ * Each thread keeps a histogram of how long its recent blocking waits on
+ * each socket (or epoll set) lasted, in power-of-two microsecond buckets.
+ * Before spinning, the histogram is used to choose how long to spin for:
+ *
+ *  - If fewer than a quarter of recent waits ended within the configured
+ *    spin time, spinning is mostly wasted, so we go straight to sleep.
+ *    Every so often we spin anyway, in case things have changed.
+ *
+ *  - Otherwise we spin just long enough to have caught seven-eighths of
+ *    the waits that ended within the spin time.
+ *
+ * Waits that end after sleeping are recorded too, so the histogram keeps
+ * learning when spinning has been turned off.
+ */
+
+#include "ip_internal.h"
+#include <onload/ul/per_thread.h>
+
+
+/* Use the configured spin time until we have this many samples */
+#define OO_SPIN_ADAPT_MIN_SAMPLES  8
+/* Halve the histogram when it reaches this many samples */
+#define OO_SPIN_ADAPT_WINDOW       256
+/* When not spinning, spin anyway on one wait in this many */
+#define OO_SPIN_ADAPT_PROBE        16
+
+
+static struct oo_spin_adapt* oo_spin_adapt_find(struct oo_per_thread* pt,
+                                                const void* key)
+{
+  int i;
+  for( i = 0; i < OO_SPIN_ADAPT_KEYS; ++i )
+    if( pt->spin_adapt[i].key == key )
+      return &pt->spin_adapt[i];
+  return NULL;
+}
+
+
+ci_inline ci_uint64 cycles_per_usec(unsigned khz)
+{
+  return khz >= 1000 ? khz / 1000 : 1;
+}
+
+
+ci_uint64 oo_spin_adapt_limit(const void* key, ci_uint64 max_spin,
+                              unsigned khz)
+{
+  struct oo_spin_adapt* a = oo_spin_adapt_find(__oo_per_thread_get(), key);
+  ci_uint64 max_usec = max_spin / cycles_per_usec(khz);
+  unsigned hits = 0, sum = 0;
+  int i;
+
+  if( a == NULL || a->n < OO_SPIN_ADAPT_MIN_SAMPLES )
+    return max_spin;
+
+  for( i = 0; i < OO_SPIN_ADAPT_BUCKETS && (1ull << i) <= max_usec; ++i )
+    hits += a->hist[i];
+
+  if( hits * 4 < a->n ) {
+    if( ++a->n_skipped < OO_SPIN_ADAPT_PROBE )
+      return 0;
+    a->n_skipped = 0;
+    return max_spin;
+  }
+  a->n_skipped = 0;
+
+  for( i = 0; ; ++i ) {
+    sum += a->hist[i];
+    if( sum * 8 >= hits * 7 )
+      break;
+  }
+  return CI_MIN((1ull << i) * cycles_per_usec(khz), max_spin);
+}
+
+
+void oo_spin_adapt_record(const void* key, ci_uint64 waited, unsigned khz)
+{
+  struct oo_per_thread* pt = __oo_per_thread_get();
+  struct oo_spin_adapt* a = oo_spin_adapt_find(pt, key);
+  ci_uint64 usec = waited / cycles_per_usec(khz);
+  int i;
+
+  if( a == NULL ) {
+    a = &pt->spin_adapt[pt->spin_adapt_next++ % OO_SPIN_ADAPT_KEYS];
+    memset(a, 0, sizeof(*a));
+    a->key = key;
+  }
+
+  if( usec == 0 )
+    i = 0;
+  else if( usec >= 1u << (OO_SPIN_ADAPT_BUCKETS - 2) )
+    i = OO_SPIN_ADAPT_BUCKETS - 1;
+  else
+    i = ci_log2_le(usec) + 1;
+  ++a->hist[i];
+
+  if( ++a->n >= OO_SPIN_ADAPT_WINDOW ) {
+    a->n = 0;
+    for( i = 0; i < OO_SPIN_ADAPT_BUCKETS; ++i ) {
+      a->hist[i] /= 2;
+      a->n += a->hist[i];
+    }
+  }
+}
@@ -0,0 +1,620 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* TCP congestion control modules.
+ *
+ * The default module, "onload-reno", is the RFC5681/RFC3465 implementation
+ * that is open-coded on the ack path in tcp_rx.c.  Sockets using any other
+ * module (selected with EF_TCP_CONG_ALG or the TCP_CONGESTION socket
+ * option) have an aux buffer at ts->cong holding the module's private
+ * state, and the ack and loss paths call into the hooks here instead.
+ *
+ * The same aux buffer carries the transmit pacing state, which is used both
+ * by modules that set a pacing rate (BBR) and by sockets with
+ * SO_MAX_PACING_RATE; so a paced onload-reno socket has ts->cong too.
+ *
+ * All arithmetic is integer-only so that this code can run in the kernel.
+ */
+
+#include "ip_internal.h"
+
+#define LPF "TCP CONG "
+
+
+struct ci_tcp_cong_ops {
+  const char* name;
+  void (*init)(ci_netif*, ci_tcp_state*, ci_tcp_cong_state*);
+  void (*on_ack)(ci_netif*, ci_tcp_state*, ci_tcp_cong_state*, unsigned);
+  unsigned (*ssthresh)(ci_netif*, ci_tcp_state*, ci_tcp_cong_state*);
+};
+
+
+static void ci_tcp_pacing_set_rate(ci_netif* ni, ci_tcp_state* ts,
+                                   ci_tcp_cong_state* cong,
+                                   ci_uint64 cong_rate);
+
+
+static ci_uint32 ci_tcp_min_cwnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  return CI_MAX((ci_uint32) tcp_eff_mss(ts), NI_OPTS(ni).min_cwnd);
+}
+
+
+/* Microsecond-ish timestamp from the netif's cached cycle counter.  The
+ * unit is 2^ci_ip_time_frc2us cycles; use ci_tcp_cong_frcus2us() to get
+ * real microseconds.
+ */
+static ci_uint32 ci_tcp_cong_frcus(ci_netif* ni)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return (ci_uint32) (its->frc >> its->ci_ip_time_frc2us);
+}
+
+
+static ci_uint32 ci_tcp_cong_frcus2us(ci_netif* ni, ci_uint32 t)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint64 cycles = (ci_uint64) t << its->ci_ip_time_frc2us;
+  return (ci_uint32) (cycles * 1000 / its->khz);
+}
+
+
+/**********************************************************************
+ * CUBIC (RFC8312)
+ */
+
+/* beta_cubic = 0.7, C = 0.4, both scaled by 1024 where needed. */
+#define CUBIC_BETA          717
+#define CUBIC_SCALE_SHIFT   10
+/* Cap on |t - K| in ms so that t^3 stays well within 64 bits. */
+#define CUBIC_MAX_DT_MS     (1u << 19)
+
+
+/* floor(cbrt(a)) */
+static ci_uint32 ci_tcp_cubic_root(ci_uint64 a)
+{
+  ci_uint64 y = 0;
+  int s;
+
+  for( s = 63; s >= 0; s -= 3 ) {
+    ci_uint64 b;
+    y <<= 1;
+    b = 3 * y * (y + 1) + 1;
+    if( (a >> s) >= b ) {
+      a -= b << s;
+      ++y;
+    }
+  }
+  return (ci_uint32) y;
+}
+
+
+static void ci_tcp_cubic_init(ci_netif* ni, ci_tcp_state* ts,
+                              ci_tcp_cong_state* cong)
+{
+  memset(&cong->u.cubic, 0, sizeof(cong->u.cubic));
+}
+
+
+static void ci_tcp_cubic_on_ack(ci_netif* ni, ci_tcp_state* ts,
+                                ci_tcp_cong_state* cong, unsigned acked)
+{
+  ci_tcp_cubic_state* c = &cong->u.cubic;
+  unsigned mss = tcp_eff_mss(ts);
+  ci_iptime_t now = ci_tcp_time_now(ni);
+  ci_uint32 t_ms, target, cnt;
+  ci_uint64 dt, delta;
+
+  if( ts->cwnd < ts->ssthresh ) {
+    /* Slow start, as for onload-reno. */
+    unsigned cwnd_inc = CI_MIN(ts->ssthresh - ts->cwnd, ts->bytes_acked);
+    ts->cwnd += cwnd_inc;
+    ts->bytes_acked -= cwnd_inc;
+    if( ts->cwnd < ts->ssthresh )
+      return;
+  }
+
+  if( c->epoch_start == 0 ) {
+    c->epoch_start = now ? now : 1;
+    if( ts->cwnd < c->last_max_cwnd ) {
+      /* K = cbrt(W_max * (1 - beta) / C) in seconds; in ms with W in
+       * segments that is cbrt((W_max - cwnd) / mss * 2.5e9). */
+      ci_uint64 segs = (c->last_max_cwnd - ts->cwnd) / mss;
+      c->k = ci_tcp_cubic_root(segs * 2500000000ull);
+      c->origin_point = c->last_max_cwnd;
+    }
+    else {
+      c->k = 0;
+      c->origin_point = ts->cwnd;
+    }
+    c->tcp_cwnd = ts->cwnd;
+    c->tcp_acked = 0;
+  }
+
+  /* W_cubic(t + RTT) */
+  t_ms = ci_ip_time_ticks2ms(ni, now - c->epoch_start + tcp_srtt(ts));
+  dt = t_ms > c->k ? t_ms - c->k : c->k - t_ms;
+  dt = CI_MIN(dt, (ci_uint64) CUBIC_MAX_DT_MS);
+  /* C * dt^3 segments, with C = 0.4 and dt in ms: 4 * dt^3 / 10^10 */
+  delta = (4 * dt * dt * dt / 1000000) * mss / 10000;
+  if( t_ms < c->k )
+    target = c->origin_point - CI_MIN(delta, (ci_uint64) c->origin_point);
+  else
+    target = c->origin_point + (ci_uint32) CI_MIN(delta, (ci_uint64) 0x7fffffff);
+
+  /* TCP-friendly region: W_est grows by 3 * (1 - beta) / (1 + beta), ie.
+   * about 0.53 segments per RTT. */
+  c->tcp_acked += acked;
+  cnt = (ci_uint32) ((ci_uint64) c->tcp_cwnd * 100 / 53);
+  if( cnt != 0 && c->tcp_acked >= cnt ) {
+    c->tcp_cwnd += mss * (c->tcp_acked / cnt);
+    c->tcp_acked %= cnt;
+  }
+  target = CI_MAX(target, c->tcp_cwnd);
+
+  /* Number of bytes that must be acked to grow cwnd by one segment.  Grow
+   * by at most 1.5x per RTT, and very slowly while at the plateau. */
+  if( target > ts->cwnd )
+    cnt = CI_MAX((ci_uint32) ((ci_uint64) ts->cwnd * mss /
+                              (target - ts->cwnd)), 2 * mss);
+  else
+    cnt = 100 * ts->cwnd;
+  if( ts->bytes_acked >= cnt ) {
+    ts->cwnd += mss * (ts->bytes_acked / cnt);
+    ts->bytes_acked %= cnt;
+  }
+
+  LOG_TV(log(LPF "%d CUBIC: cwnd=%u target=%u k=%u t=%u", S_FMT(ts),
+             ts->cwnd, target, c->k, t_ms));
+}
+
+
+static unsigned ci_tcp_cubic_ssthresh(ci_netif* ni, ci_tcp_state* ts,
+                                      ci_tcp_cong_state* cong)
+{
+  ci_tcp_cubic_state* c = &cong->u.cubic;
+  unsigned mss = tcp_eff_mss(ts);
+
+  c->epoch_start = 0;
+  /* Fast convergence: release bandwidth to newer flows. */
+  if( ts->cwnd < c->last_max_cwnd )
+    c->last_max_cwnd = (ts->cwnd * (ci_uint64) ((1 << CUBIC_SCALE_SHIFT) +
+                                                CUBIC_BETA))
+                       >> (CUBIC_SCALE_SHIFT + 1);
+  else
+    c->last_max_cwnd = ts->cwnd;
+
+  return CI_MAX((ci_uint32) (((ci_uint64) ts->cwnd * CUBIC_BETA)
+                             >> CUBIC_SCALE_SHIFT), mss << 1);
+}
+
+
+/**********************************************************************
+ * BBR
+ *
+ * A simplified model-based controller after Cardwell et al: the delivery
+ * rate is sampled once per round trip, filtered with a windowed max, and
+ * combined with a windowed min RTT to estimate the BDP.  cwnd tracks a
+ * multiple of the BDP and the pacing rate tracks the bandwidth estimate
+ * scaled by the current phase's gain.
+ */
+
+#define BBR_UNIT            256
+#define BBR_HIGH_GAIN       739       /* 2/ln(2), for STARTUP */
+#define BBR_DRAIN_GAIN      89        /* 1/BBR_HIGH_GAIN */
+#define BBR_CWND_GAIN       512
+#define BBR_MIN_RTT_WIN_MS  10000
+#define BBR_PROBE_RTT_MS    200
+#define BBR_MIN_PIPE_SEGS   4
+#define BBR_CYCLE_LEN       8
+
+static const ci_uint16 bbr_pacing_gain[BBR_CYCLE_LEN] = {
+  320, 192, 256, 256, 256, 256, 256, 256
+};
+
+
+static ci_uint64 ci_tcp_bbr_max_bw(const ci_tcp_bbr_state* b)
+{
+  ci_uint64 bw = b->bw[0];
+  int i;
+  for( i = 1; i < CI_TCP_BBR_BW_SLOTS; ++i )
+    bw = CI_MAX(bw, b->bw[i]);
+  return bw;
+}
+
+
+static void ci_tcp_bbr_init(ci_netif* ni, ci_tcp_state* ts,
+                            ci_tcp_cong_state* cong)
+{
+  ci_tcp_bbr_state* b = &cong->u.bbr;
+
+  memset(b, 0, sizeof(*b));
+  b->mode = CI_TCP_BBR_STARTUP;
+  b->round_start = ci_tcp_cong_frcus(ni);
+  b->round_end_seq = tcp_snd_nxt(ts);
+  b->min_rtt_stamp = ci_tcp_time_now(ni);
+}
+
+
+/* Called once per round trip, when all data sent at the start of the
+ * round has been acked. */
+static void ci_tcp_bbr_round(ci_netif* ni, ci_tcp_state* ts,
+                             ci_tcp_bbr_state* b, ci_uint32 now_us)
+{
+  ci_uint32 rtt_us = ci_tcp_cong_frcus2us(ni, now_us - b->round_start);
+  ci_iptime_t now = ci_tcp_time_now(ni);
+  ci_uint64 bw;
+  int slot;
+
+  if( rtt_us == 0 )
+    rtt_us = 1;
+
+  if( b->round_delivered != 0 ) {
+    bw = (ci_uint64) b->round_delivered * 1000000 / rtt_us;
+    slot = (b->round_count / CI_TCP_BBR_BW_SLOT_ROUNDS) % CI_TCP_BBR_BW_SLOTS;
+    if( b->round_count % CI_TCP_BBR_BW_SLOT_ROUNDS == 0 )
+      b->bw[slot] = bw;
+    else
+      b->bw[slot] = CI_MAX(b->bw[slot], bw);
+
+    if( b->min_rtt_us == 0 || rtt_us <= b->min_rtt_us ) {
+      b->min_rtt_us = rtt_us;
+      b->min_rtt_stamp = now;
+    }
+  }
+
+  /* STARTUP ends when the bandwidth estimate stops growing by 25% per
+   * round for three rounds. */
+  if( ! b->full_pipe ) {
+    bw = ci_tcp_bbr_max_bw(b);
+    if( bw >= b->full_bw + (b->full_bw >> 2) ) {
+      b->full_bw = bw;
+      b->full_bw_cnt = 0;
+    }
+    else if( ++b->full_bw_cnt >= 3 ) {
+      b->full_pipe = 1;
+      if( b->mode == CI_TCP_BBR_STARTUP )
+        b->mode = CI_TCP_BBR_DRAIN;
+    }
+  }
+
+  ++b->round_count;
+  b->round_start = now_us;
+  b->round_end_seq = tcp_snd_nxt(ts);
+  b->round_delivered = 0;
+}
+
+
+static void ci_tcp_bbr_on_ack(ci_netif* ni, ci_tcp_state* ts,
+                              ci_tcp_cong_state* cong, unsigned acked)
+{
+  ci_tcp_bbr_state* b = &cong->u.bbr;
+  ci_uint32 now_us = ci_tcp_cong_frcus(ni);
+  ci_iptime_t now = ci_tcp_time_now(ni);
+  ci_uint32 min_cwnd = CI_MAX(ci_tcp_min_cwnd(ni, ts),
+                              BBR_MIN_PIPE_SEGS * tcp_eff_mss(ts));
+  unsigned pacing_gain;
+  ci_uint64 bw, bdp, target;
+
+  /* BBR does not use RFC3465 byte counting. */
+  ts->bytes_acked = 0;
+  b->round_delivered += acked;
+  if( SEQ_GE(tcp_snd_una(ts), b->round_end_seq) )
+    ci_tcp_bbr_round(ni, ts, b, now_us);
+
+  bw = ci_tcp_bbr_max_bw(b);
+  bdp = (bw * b->min_rtt_us) / 1000000;
+
+  if( b->mode == CI_TCP_BBR_DRAIN && ci_tcp_inflight(ts) <= bdp ) {
+    b->mode = CI_TCP_BBR_PROBE_BW;
+    b->cycle_idx = 0;
+    b->cycle_stamp = now_us;
+  }
+  else if( b->mode == CI_TCP_BBR_PROBE_BW &&
+           ci_tcp_cong_frcus2us(ni, now_us - b->cycle_stamp) >
+           b->min_rtt_us ) {
+    b->cycle_idx = (b->cycle_idx + 1) % BBR_CYCLE_LEN;
+    b->cycle_stamp = now_us;
+  }
+
+  /* Refresh min_rtt if it has not been seen for a while by draining the
+   * pipe for a short time. */
+  if( b->mode != CI_TCP_BBR_PROBE_RTT && b->min_rtt_us != 0 &&
+      TIME_GT(now, b->min_rtt_stamp +
+                   ci_tcp_time_ms2ticks(ni, BBR_MIN_RTT_WIN_MS)) ) {
+    b->mode = CI_TCP_BBR_PROBE_RTT;
+    b->prior_cwnd = ts->cwnd;
+    b->probe_rtt_done = now + ci_tcp_time_ms2ticks(ni, BBR_PROBE_RTT_MS);
+    /* Take a fresh sample in the next round. */
+    b->min_rtt_us = 0;
+  }
+  else if( b->mode == CI_TCP_BBR_PROBE_RTT &&
+           TIME_GE(now, b->probe_rtt_done) ) {
+    b->mode = b->full_pipe ? CI_TCP_BBR_PROBE_BW : CI_TCP_BBR_STARTUP;
+    b->cycle_idx = 0;
+    b->cycle_stamp = now_us;
+    b->min_rtt_stamp = now;
+    ts->cwnd = CI_MAX(ts->cwnd, b->prior_cwnd);
+  }
+
+  switch( b->mode ) {
+  case CI_TCP_BBR_STARTUP:
+    pacing_gain = BBR_HIGH_GAIN;
+    break;
+  case CI_TCP_BBR_DRAIN:
+    pacing_gain = BBR_DRAIN_GAIN;
+    break;
+  case CI_TCP_BBR_PROBE_BW:
+    pacing_gain = bbr_pacing_gain[b->cycle_idx];
+    break;
+  default:
+    pacing_gain = BBR_UNIT;
+    break;
+  }
+
+  if( b->mode == CI_TCP_BBR_PROBE_RTT ) {
+    ts->cwnd = min_cwnd;
+  }
+  else if( bw == 0 || b->min_rtt_us == 0 ) {
+    /* No model yet: grow as in slow start. */
+    ts->cwnd += acked;
+  }
+  else {
+    target = CI_MAX(bdp * BBR_CWND_GAIN / BBR_UNIT, (ci_uint64) min_cwnd);
+    target = CI_MIN(target, (ci_uint64) 0x7fffffff);
+    if( b->full_pipe )
+      ts->cwnd = (ci_uint32) CI_MIN((ci_uint64) ts->cwnd + acked, target);
+    else if( ts->cwnd < target )
+      ts->cwnd += acked;
+  }
+  ts->cwnd = CI_MAX(ts->cwnd, min_cwnd);
+
+  ci_tcp_pacing_set_rate(ni, ts, cong, bw * pacing_gain / BBR_UNIT);
+
+  LOG_TV(log(LPF "%d BBR: mode=%d bw=%"CI_PRIu64" min_rtt=%uus cwnd=%u",
+             S_FMT(ts), b->mode, bw, b->min_rtt_us, ts->cwnd));
+}
+
+
+static unsigned ci_tcp_bbr_ssthresh(ci_netif* ni, ci_tcp_state* ts,
+                                    ci_tcp_cong_state* cong)
+{
+  /* BBR does not treat loss as a congestion signal: it just saves cwnd so
+   * that it can be restored once the loss has been repaired. */
+  cong->u.bbr.prior_cwnd = CI_MAX(cong->u.bbr.prior_cwnd, ts->cwnd);
+  return CI_MAX((ci_uint32) ci_tcp_inflight(ts),
+                (ci_uint32) tcp_eff_mss(ts) << 1);
+}
+
+
+/**********************************************************************
+ * Dispatch
+ */
+
+static const struct ci_tcp_cong_ops ci_tcp_cong_ops[CI_TCP_CONG_ALG_NUM] = {
+  [CI_TCP_CONG_ALG_RENO] = {
+    .name = "onload-reno",
+  },
+  [CI_TCP_CONG_ALG_CUBIC] = {
+    .name = "cubic",
+    .init = ci_tcp_cubic_init,
+    .on_ack = ci_tcp_cubic_on_ack,
+    .ssthresh = ci_tcp_cubic_ssthresh,
+  },
+  [CI_TCP_CONG_ALG_BBR] = {
+    .name = "bbr",
+    .init = ci_tcp_bbr_init,
+    .on_ack = ci_tcp_bbr_on_ack,
+    .ssthresh = ci_tcp_bbr_ssthresh,
+  },
+};
+
+
+int ci_tcp_cong_alg_lookup(const char* name, int len)
+{
+  int alg;
+
+  /* Like Linux, accept a name that is not NUL-terminated. */
+  len = CI_MIN(len, CI_TCP_CONG_NAME_MAX);
+  if( len > 0 && name[len - 1] == '\0' )
+    len = strlen(name);
+  if( len == 4 && ! strncmp(name, "reno", 4) )
+    return CI_TCP_CONG_ALG_RENO;
+  for( alg = 0; alg < CI_TCP_CONG_ALG_NUM; ++alg )
+    if( strlen(ci_tcp_cong_ops[alg].name) == len &&
+        ! strncmp(name, ci_tcp_cong_ops[alg].name, len) )
+      return alg;
+  return -1;
+}
+
+
+const char* ci_tcp_cong_alg_name(unsigned alg)
+{
+  if( alg >= CI_TCP_CONG_ALG_NUM )
+    return "unknown";
+  return ci_tcp_cong_ops[alg].name;
+}
+
+
+/* Does this socket need ts->cong at all? */
+static int ci_tcp_cong_wanted(ci_tcp_state* ts)
+{
+  return ci_tcp_cong_ops[ts->c.cong_alg].init != NULL ||
+         ts->s.so_max_pacing_rate != CI_PACING_RATE_UNLIMITED;
+}
+
+
+static ci_uint64 ci_tcp_pacing_user_rate(ci_tcp_state* ts)
+{
+  return ts->s.so_max_pacing_rate == CI_PACING_RATE_UNLIMITED ?
+         0 : ts->s.so_max_pacing_rate;
+}
+
+
+void ci_tcp_cong_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  unsigned alg = ts->c.cong_alg;
+  ci_tcp_cong_state* cong;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_lt(alg, CI_TCP_CONG_ALG_NUM);
+
+  if( ! ci_tcp_cong_wanted(ts) ) {
+    ci_tcp_cong_release(ni, ts);
+    return;
+  }
+
+  if( OO_P_IS_NULL(ts->cong) ) {
+    oo_p sp;
+
+    ts->cong = ci_ni_aux_alloc(ni, CI_TCP_AUX_TYPE_CONG);
+    if( OO_P_IS_NULL(ts->cong) ) {
+      /* Without state we fall back to onload-reno and do not pace.  We'll
+       * try again the next time the congestion window is reset. */
+      LOG_U(log(LPF "%d: no aux buffer for %s, using %s", S_FMT(ts),
+                ci_tcp_cong_ops[alg].name,
+                ci_tcp_cong_ops[CI_TCP_CONG_ALG_RENO].name));
+      return;
+    }
+    cong = ci_ni_aux_p2cong(ni, ts->cong);
+    cong->sp = S_SP(ts);
+    cong->pace_tid.fn = CI_IP_TIMER_TCP_PACE;
+    sp = ts->cong;
+    OO_P_ADD(sp, CI_MEMBER_OFFSET(ci_ni_aux_mem, u.cong.pace_tid));
+    ci_ip_timer_init(ni, &cong->pace_tid, sp, "pace");
+  }
+  else {
+    cong = ci_ni_aux_p2cong(ni, ts->cong);
+  }
+
+  ci_pacing_bucket_init(ni, &cong->pace, ci_tcp_pacing_user_rate(ts),
+                        2 * tcp_eff_mss(ts));
+  if( ci_tcp_cong_ops[alg].init != NULL )
+    ci_tcp_cong_ops[alg].init(ni, ts, cong);
+}
+
+
+void ci_tcp_cong_release(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( OO_P_NOT_NULL(ts->cong) ) {
+    ci_tcp_cong_state_free(ni, ci_ni_aux_p2cong(ni, ts->cong));
+    ts->cong = OO_P_NULL;
+  }
+}
+
+
+void ci_tcp_cong_on_ack(ci_netif* ni, ci_tcp_state* ts, unsigned acked)
+{
+  ci_assert(OO_P_NOT_NULL(ts->cong));
+  ci_assert_lt(ts->c.cong_alg, CI_TCP_CONG_ALG_NUM);
+  ci_assert(ci_tcp_cong_ops[ts->c.cong_alg].on_ack != NULL);
+
+  ci_tcp_cong_ops[ts->c.cong_alg].on_ack(ni, ts,
+                                         ci_ni_aux_p2cong(ni, ts->cong),
+                                         acked);
+
+  ci_assert_ge(ts->cwnd, tcp_eff_mss(ts));
+}
+
+
+unsigned ci_tcp_cong_ssthresh_slow(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_assert(OO_P_NOT_NULL(ts->cong));
+  ci_assert_lt(ts->c.cong_alg, CI_TCP_CONG_ALG_NUM);
+
+  return ci_tcp_cong_ops[ts->c.cong_alg].ssthresh(ni, ts,
+                                              ci_ni_aux_p2cong(ni, ts->cong));
+}
+
+
+/**********************************************************************
+ * Transmit pacing
+ *
+ * TCP is paced with a token bucket in the cong aux buffer.  Acks refill it
+ * as they arrive; if the bucket runs dry with data still queued then
+ * [pace_tid] restarts transmit once enough tokens should have accrued.
+ * That timer has the granularity of the timer wheel, so the bucket is
+ * deep enough to hold a tick's worth of data at the pacing rate.
+ */
+
+/* The effective rate is the lower of SO_MAX_PACING_RATE and the rate wanted
+ * by the congestion control module, where 0 means "no limit". */
+static void ci_tcp_pacing_set_rate(ci_netif* ni, ci_tcp_state* ts,
+                                   ci_tcp_cong_state* cong,
+                                   ci_uint64 cong_rate)
+{
+  ci_uint64 rate = ci_tcp_pacing_user_rate(ts);
+
+  if( cong_rate != 0 && (rate == 0 || cong_rate < rate) )
+    rate = cong_rate;
+  if( rate != cong->pace.rate ) {
+    ci_pacing_bucket_refill(ni, &cong->pace,
+                            ci_pacing_bucket_depth(&cong->pace,
+                                                   2 * tcp_eff_mss(ts)));
+    cong->pace.rate = rate;
+  }
+}
+
+
+void ci_tcp_pacing_update(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( OO_P_IS_NULL(ts->cong) )
+    ci_tcp_cong_init(ni, ts);
+  else if( ! ci_tcp_cong_wanted(ts) )
+    ci_tcp_cong_release(ni, ts);
+  else
+    ci_tcp_pacing_set_rate(ni, ts, ci_ni_aux_p2cong(ni, ts->cong), 0);
+}
+
+
+void ci_tcp_pacing_tx_advance(ci_netif* ni, ci_tcp_state* ts,
+                              unsigned right_edge, ci_uint32* p_stop_cntr)
+{
+  ci_tcp_cong_state* cong = ci_ni_aux_p2cong(ni, ts->cong);
+  ci_pacing_bucket* b = &cong->pace;
+  unsigned eff_mss = tcp_eff_mss(ts);
+  unsigned snd_nxt_before;
+  int paced = 0;
+
+  if( b->rate == 0 ) {
+    ci_tcp_tx_advance_to(ni, ts, right_edge, p_stop_cntr);
+    return;
+  }
+
+  ci_pacing_bucket_refill(ni, b, ci_pacing_bucket_depth(b, 2 * eff_mss));
+  if( b->tokens > 0 ) {
+    /* Allow the segment that takes the bucket negative. */
+    unsigned pace_edge = tcp_snd_nxt(ts) + b->tokens + eff_mss - 1;
+    if( SEQ_LT(pace_edge, right_edge) ) {
+      right_edge = pace_edge;
+      paced = 1;
+      ++ni->state->stats.tcp_tx_stop_pacing;
+    }
+    snd_nxt_before = tcp_snd_nxt(ts);
+    ci_tcp_tx_advance_to(ni, ts, right_edge, p_stop_cntr);
+    b->tokens -= (ci_int32) SEQ_SUB(tcp_snd_nxt(ts), snd_nxt_before);
+  }
+  else {
+    paced = 1;
+    ++ni->state->stats.tcp_tx_stop_pacing;
+  }
+
+  if( paced && ci_ip_queue_not_empty(&ts->send) &&
+      ! ci_ip_timer_pending(ni, &cong->pace_tid) ) {
+    ci_uint32 us = ci_pacing_bucket_wait_us(b, eff_mss);
+    ci_ip_timer_set(ni, &cong->pace_tid, ci_tcp_time_now(ni) +
+                    CI_MAX(ci_tcp_time_ms2ticks(ni, us / 1000), 1));
+  }
+}
+
+
+void ci_tcp_timeout_pace(ci_netif* ni, ci_tcp_cong_state* cong)
+{
+  ci_tcp_state* ts = SP_TO_TCP(ni, cong->sp);
+
+  ci_assert(OO_P_NOT_NULL(ts->cong));
+  if( ci_ip_queue_not_empty(&ts->send) )
+    ci_tcp_tx_advance(ts, ni);
+}
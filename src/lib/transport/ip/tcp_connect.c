@@ -885,9 +885,16 @@ ci_inline void ci_tcp_connect_drop_implicit_address(ci_tcp_state *ts)
 #define CI_CONNECT_UL_LOCK_DROPPED	-3
 #define CI_CONNECT_UL_ALIEN_BOUND	-4
 
+/* The data to send in the SYN of a TCP Fast Open. */
+struct ci_tcp_connect_fastopen {
+  ci_iovec_ptr piov;
+  int          bytes;  /* out: bytes enqueued in the SYN */
+};
+
 /* The fd parameter is ignored when this is called in the kernel */
 static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
                                    ci_addr_t dst, unsigned dport_be16,
+                                   struct ci_tcp_connect_fastopen* tfo,
                                    int* fail_rc)
 {
   ci_ip_pkt_fmt* pkt;
@@ -915,6 +922,13 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
 
   /* Default smss until discovered by MSS option in SYN - RFC1122 4.2.2.6 */
   ts->smss = CI_CFG_TCP_DEFAULT_MSS;
+  if( tfo != NULL ) {
+    /* Data in the SYN is sized by what the server told us last time. */
+    const ci_tcp_fastopen_cache_entry* e =
+      ci_tcp_fastopen_cache_lookup(ni, dst.ip4);
+    if( e != NULL && e->mss > ts->smss )
+      ts->smss = e->mss;
+  }
 
   /* set pmtu, eff_mss, snd_buf and adjust windows */
   ci_tcp_set_eff_mss(ni, ts);
@@ -1170,7 +1184,20 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
   /* If ARP resolution fails, we have to drop the connection, so we store
    * the socket id in the SYN packet. */
   pkt->pf.tcp_tx.sock_id = ts->s.b.bufid;
-  ci_tcp_enqueue_no_data(ts, ni, pkt);
+  if( tfo != NULL ) {
+    /* Without a cookie, ask for one and send the data later. */
+    const ci_tcp_fastopen_cache_entry* e =
+      ci_tcp_fastopen_cache_lookup(ni, dst.ip4);
+    tfo->bytes = ci_tcp_enqueue_syn_fastopen(ts, ni, pkt,
+                                             e != NULL ? e->cookie : NULL,
+                                             e != NULL ? e->len : 0,
+                                             &tfo->piov);
+    if( tfo->bytes != 0 )
+      CITP_STATS_NETIF_INC(ni, tfo_active);
+  }
+  else {
+    ci_tcp_enqueue_no_data(ts, ni, pkt);
+  }
   ci_tcp_set_flags(ts, CI_TCP_FLAG_ACK);  
 
   if( ts->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY) ) {
@@ -1415,9 +1442,20 @@ ci_tcp_retrieve_addr(ci_netif* netif, const struct sockaddr* serv_addr,
  *
  *          CI_SOCKET_HANDOVER we tell the upper layers to handover, no need
  *                             to set errno since it isn't a real error
+ *
+ * [tfo] is non-NULL for a TCP Fast Open.
+ *
+ * [locked] is set by ci_tcp_connect_batch(), which holds the stack lock
+ * across the call and has already polled.  The lock is held again on
+ * return, and only dropped while waiting for a packet buffer: anything else
+ * which would need to drop it, block or hand over returns
+ * CI_SOCKET_HANDOVER, and the caller falls back to an ordinary connect(),
+ * which repeats the checks and does the rest.
  */
-int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
-		   socklen_t addrlen, ci_fd_t fd, int *p_moved)
+static int __ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
+                            socklen_t addrlen, ci_fd_t fd, int *p_moved,
+                            struct ci_tcp_connect_fastopen* tfo,
+                            int /*bool*/ locked)
 {
   ci_sock_cmn* s = ep->s;
   ci_tcp_state* ts = &SOCK_TO_WAITABLE_OBJ(s)->tcp;
@@ -1429,10 +1467,19 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
   if( NI_OPTS(ep->netif).tcp_connect_handover )
     return CI_SOCKET_HANDOVER;
 
-  /* Make sure we're up-to-date. */
-  ci_netif_lock(ep->netif);
-  CHECK_TEP(ep);
-  ci_netif_poll(ep->netif);
+  if( locked ) {
+    ci_assert(ci_netif_is_locked(ep->netif));
+    CHECK_TEP(ep);
+    if( s->b.state != CI_TCP_CLOSED ||
+        ! (s->b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY)) )
+      return CI_SOCKET_HANDOVER;
+  }
+  else {
+    /* Make sure we're up-to-date. */
+    ci_netif_lock(ep->netif);
+    CHECK_TEP(ep);
+    ci_netif_poll(ep->netif);
+  }
 
   /*
    * 1. Check if state of the socket is OK for connect operation.
@@ -1531,11 +1578,25 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
   rc = ci_tcp_connect_check_dest(ep, dst_addr, dst_port);
   if( rc )  goto unlock_out;
 
+  if( tfo != NULL ) {
+    /* Loopback connections gain nothing from TCP Fast Open, so refuse
+     * them.  The cookie cache only knows IPv4 servers, so connect to IPv6
+     * ones without it. */
+    if( ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE ) {
+      rc = CI_SOCKET_HANDOVER;
+      goto unlock_out;
+    }
+    if( CI_IS_ADDR_IP6(dst_addr) )
+      tfo = NULL;
+  }
+
 #if CI_CFG_ENDPOINT_MOVE
   if( (ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE) &&
       OO_SP_IS_NULL(ts->local_peer) ) {
     /* Try to connect to another stack; handover if can't */
     struct oo_op_loopback_connect op;
+    if( locked )
+      return CI_SOCKET_HANDOVER;
     op.dst_port = dst_port;
     op.dst_addr = dst_addr;
     /* this operation unlocks netif */
@@ -1561,7 +1622,7 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
   }
 
   crc = ci_tcp_connect_ul_start(ep->netif, ts, fd, dst_addr, dst_port,
-                                &rc);
+                                tfo, &rc);
   if( crc != CI_CONNECT_UL_OK ) {
     switch( crc ) {
     case CI_CONNECT_UL_ALIEN_BOUND:
@@ -1574,6 +1635,8 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
       }
       goto unlock_out;
     case CI_CONNECT_UL_LOCK_DROPPED:
+      if( locked )
+        ci_netif_lock(ep->netif);
       goto out;
     case CI_CONNECT_UL_START_AGAIN:
       goto start_again;
@@ -1585,15 +1648,97 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
   rc = ci_tcp_connect_ul_syn_sent(ep->netif, ts);
 
  unlock_out:
+  if( locked )
+    return rc;
   ci_netif_unlock(ep->netif);
  out:
-  if( rc == CI_SOCKET_HANDOVER && (s->s_flags & CI_SOCK_FLAG_DEFERRED_BIND) ) {
+  if( rc == CI_SOCKET_HANDOVER && (s->s_flags & CI_SOCK_FLAG_DEFERRED_BIND) &&
+      ! locked ) {
     int rc1 = complete_deferred_bind(ep->netif, &ts->s, fd);
     if( rc1 < 0 )
       return rc1;
   }
   return rc;
 }
+
+
+int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
+		   socklen_t addrlen, ci_fd_t fd, int *p_moved)
+{
+  return __ci_tcp_connect(ep, serv_addr, addrlen, fd, p_moved, NULL, 0);
+}
+
+
+/* Start non-blocking connects on [n_reqs] sockets of stack [ni].  The stack
+ * is locked and polled once for the whole batch, and the SYNs are queued
+ * and pushed to the NIC together at the end rather than ringing a doorbell
+ * for each one.
+ *
+ * Each request's [rc] is set to 0 or -errno (typically -EINPROGRESS) as
+ * connect() would return, or to CI_SOCKET_HANDOVER if the socket can't be
+ * connected in a batch (e.g. it is blocking, already connecting, or the
+ * destination is local or not accelerated) and the caller should connect()
+ * it as usual.
+ */
+void ci_tcp_connect_batch(ci_netif* ni, struct ci_tcp_connect_batch_req* reqs,
+                          int n_reqs)
+{
+  int i, moved, rc;
+
+  ci_netif_lock(ni);
+  ci_netif_poll(ni);
+  ni->state->tx_coalesce_active = 1;
+
+  for( i = 0; i < n_reqs; ++i ) {
+    ci_assert_equal(reqs[i].ep.netif, ni);
+    moved = 0;
+    rc = __ci_tcp_connect(&reqs[i].ep, reqs[i].addr, reqs[i].addrlen,
+                          reqs[i].fd, &moved, NULL, 1);
+    ci_assert(! moved);
+    if( rc == CI_SOCKET_HANDOVER )
+      reqs[i].rc = CI_SOCKET_HANDOVER;
+    else if( rc < 0 )
+      reqs[i].rc = -errno;
+    else
+      reqs[i].rc = rc;
+  }
+
+  ci_netif_tx_coalesce_end(ni);
+  ci_netif_unlock(ni);
+}
+
+
+/* Connect with TCP Fast Open, sending [iov] in the SYN if we have a cookie
+ * for the server.  As Linux, returns the number of bytes sent in the SYN,
+ * which is zero if there was nothing to send or we asked for a cookie, or
+ * fails with EINPROGRESS for a non-blocking socket if nothing was sent.
+ *
+ * Connections which can't use TCP Fast Open fail with EOPNOTSUPP, as when
+ * Linux has it disabled, so that the application falls back to connect().
+ */
+int ci_tcp_connect_fastopen(citp_socket* ep, const struct sockaddr* serv_addr,
+                            socklen_t addrlen, ci_fd_t fd,
+                            const ci_iovec* iov, int iovlen)
+{
+  struct ci_tcp_connect_fastopen tfo;
+  int moved = 0;
+  int rc;
+
+  if( iovlen > 0 )
+    ci_iovec_ptr_init_nz(&tfo.piov, iov, iovlen);
+  else
+    ci_iovec_ptr_init(&tfo.piov, iov, 0);
+  tfo.bytes = 0;
+
+  rc = __ci_tcp_connect(ep, serv_addr, addrlen, fd, &moved, &tfo, 0);
+  /* Loopback connections are not attempted, so the endpoint can't move. */
+  ci_assert(! moved);
+  if( rc == CI_SOCKET_HANDOVER )
+    RET_WITH_ERRNO(EOPNOTSUPP);
+  if( rc == 0 || (rc < 0 && errno == EINPROGRESS && tfo.bytes != 0) )
+    return tfo.bytes;
+  return rc;
+}
 #endif
 
 int ci_tcp_listen_init(ci_netif *ni, ci_tcp_socket_listen *tls)
@@ -1658,7 +1803,7 @@ int ci_tcp_connect_lo_samestack(ci_netif *ni, ci_tcp_state *ts, oo_sp tls_id,
 
   ts->local_peer = tls_id;
   crc = ci_tcp_connect_ul_start(ni, ts, CI_FD_BAD, sock_ipx_raddr(&ts->s),
-                                ts->s.pkt.dport_be16, &rc);
+                                ts->s.pkt.dport_be16, NULL, &rc);
 
   /* The connect is really finished, but we should return EINPROGRESS
    * for non-blocking connect and 0 for normal. */
@@ -1705,6 +1850,7 @@ int ci_tcp_connect_lo_toconn(ci_netif *c_ni, oo_sp c_id, ci_addr_t dst,
 
   /* init common tcp fields */
   ts->s.so = alien_tls->s.so;
+  ts->s.so_max_pacing_rate = alien_tls->s.so_max_pacing_rate;
   ts->s.cp.ip_ttl = alien_tls->s.cp.ip_ttl;
 #if CI_CFG_IPV6
   ts->s.cp.hop_limit = alien_tls->s.cp.hop_limit;
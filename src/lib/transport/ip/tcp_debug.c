@@ -348,11 +348,12 @@ static void ci_tcp_state_rob_assert_valid(ci_netif* ni, ci_tcp_state* ts,
   ci_ip_pkt_fmt *block, *pkt, *prev_pkt;
   ci_tcp_hdr* tcp;
   int block_num, num = 0;
-  oo_pkt_p id;
+  oo_pkt_p id, last_block = OO_PP_NULL;
 
   for( id = rob->head; OO_PP_NOT_NULL(id);
        id = block->pf.tcp_rx.misc.rob.next_block ) {
     block = PKT_CHK(ni, id);
+    last_block = id;
     block_num = 0;
     prev_pkt = 0;
 
@@ -378,6 +379,8 @@ static void ci_tcp_state_rob_assert_valid(ci_netif* ni, ci_tcp_state* ts,
   }
 
   verify(rob->num == num);
+  verify(num == 0 || OO_PP_IS_NULL(ts->rob_tail_block) ||
+         OO_PP_EQ(ts->rob_tail_block, last_block));
 }
 #endif
 
@@ -689,7 +692,8 @@ void ci_tcp_socket_listen_dump(ci_netif* ni, ci_tcp_socket_listen* tls,
          tls->n_buckets);
   logger(log_arg, "%s  acceptq: max=%d n=%d accepted=%d", pf,
          tls->acceptq_max, ci_tcp_acceptq_n(tls), tls->acceptq_n_out);
-  logger(log_arg, "%s  defer_accept=%d", pf, tls->c.tcp_defer_accept);
+  logger(log_arg, "%s  defer_accept=%d fastopen_qlen=%d", pf,
+         tls->c.tcp_defer_accept, tls->c.fastopen_qlen);
 #if CI_CFG_FD_CACHING
   logger(log_arg, "%s  sockcache: n=%d sock_n=%d cache=%s pending=%s connected=%s",
          pf, ni->state->passive_cache_avail_stack, tls->cache_avail_sock,
@@ -789,18 +793,27 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
          SEQ_SUB(ts->snd_max, tcp_snd_nxt(ts)));
   if( ts->snd_delegated != 0 )
     logger(log_arg, "%s  snd delegated=%d", pf, ts->snd_delegated);
-  logger(log_arg, "%s  snd: cwnd=%d+%d used=%d ssthresh=%d bytes_acked=%d %s",
+  logger(log_arg, "%s  snd: cwnd=%d+%d used=%d ssthresh=%d bytes_acked=%d %s %s",
          pf, ts->cwnd, ts->cwnd_extra, tcp_cwnd_used(ts),
-         ts->ssthresh, ts->bytes_acked, congstate_str(ts));
+         ts->ssthresh, ts->bytes_acked, congstate_str(ts),
+         ci_tcp_cong_alg_name(ts->c.cong_alg));
+  if( OO_P_NOT_NULL(ts->cong) &&
+      ci_ni_aux_p2cong(ni, ts->cong)->pace.rate != 0 ) {
+    ci_tcp_cong_state* cong = ci_ni_aux_p2cong(ni, ts->cong);
+    logger(log_arg, "%s  snd: pacing rate=%"CI_PRIu64" max=%"CI_PRIu64" tokens=%d%s",
+           pf, cong->pace.rate, ts->s.so_max_pacing_rate, cong->pace.tokens,
+           ci_ip_timer_pending(ni, &cong->pace_tid) ? " timer" : "");
+  }
   logger(log_arg, "%s  snd: timed_seq %x timed_ts %x",
          pf, ts->timed_seq, ts->timed_ts);
   logger(log_arg, "%s  snd: sndbuf_pkts=%d "OOF_IPCACHE_STATE" "
 	 OOF_IPCACHE_DETAIL,
 	 pf, ts->so_sndbuf_pkts, OOFA_IPCACHE_STATE(ni, &ts->s.pkt),
          OOFA_IPCACHE_DETAIL(&ts->s.pkt));
-  logger(log_arg, "%s  snd: limited rwnd=%d cwnd=%d nagle=%d more=%d app=%d",
-         pf, stats.tx_stop_rwnd, stats.tx_stop_cwnd, stats.tx_stop_nagle,
-         stats.tx_stop_more, stats.tx_stop_app);
+  logger(log_arg, "%s  snd: limited rwnd=%d cwnd=%d nagle=%d autocork=%d "
+         "more=%d app=%d", pf, stats.tx_stop_rwnd, stats.tx_stop_cwnd,
+         stats.tx_stop_nagle, stats.tx_stop_autocork, stats.tx_stop_more,
+         stats.tx_stop_app);
 #if CI_CFG_TAIL_DROP_PROBE
   if( ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_MARKED )
     logger(log_arg, "%s  snd: tail loss probe at %x", pf, ts->taildrop_mark);
@@ -831,11 +844,18 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
          "%s  curr_retrans=%d total_retrans=%d dupacks=%u congrecover=%x",
          pf, ts->retransmits, stats.total_retrans, ts->dup_acks,
          ts->congrecover);
+  if( ci_tcp_rack_enabled(ni, ts) && ts->rack.valid )
+    logger(log_arg, "%s  rack: xmit=%u end=%08x rtt=%u min_rtt=%u "
+           "reo_wnd_mult=%u", pf, ts->rack.xmit_us, ts->rack.end_seq,
+           ts->rack.rtt_us, ts->rack.min_rtt_us, ts->rack.reo_wnd_mult);
   logger(log_arg,
          "%s  rtos=%u frecs=%u seqerr=%u,%u ooo_pkts=%d "
          "ooo=%d", pf, stats.rtos,
          stats.fast_recovers, stats.rx_seq_errs, stats.rx_ack_seq_errs,
          stats.rx_ooo_pkts, stats.rx_ooo_fill);
+  if( stats.rx_ooo_pkts )
+    logger(log_arg, "%s  rob: tail=%u walk=%u max_walk=%u", pf,
+           stats.rx_ooo_tail, stats.rx_ooo_walk, stats.rx_ooo_max_walk);
   logger(log_arg, "%s  tx: defer=%d nomac=%u warm=%u warm_aborted=%u", pf,
          stats.tx_defer, stats.tx_nomac_defer, stats.tx_msg_warm,
          stats.tx_msg_warm_abort);
@@ -883,6 +903,7 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(ni, ts->pmtus);
     logger(log_arg, "%s  pmtu=%d: ", pf, pmtus->pmtu);
   }
+  ci_tcp_flight_dump(ni, ts, pf, logger, log_arg);
 }
 
 
@@ -943,8 +964,17 @@ static void tcp_rx_checks_cmn(ci_netif* ni, ci_sock_cmn* s,
   }
 
   /* Log packets with interesting flags. */
-  if( tcp->tcp_flags & NI_OPTS(ni).tcp_rx_log_flags )
-    *dump |= DUMP_SOCK | DUMP_PKT;
+  if( tcp->tcp_flags & NI_OPTS(ni).tcp_rx_log_flags ) {
+#ifndef __KERNEL__
+    if( ci_blog_enabled )
+      ci_blog(LPF "%lu:%lu pkt %lx:%lu=>%lu flags=%lx", NI_ID(ni), SC_ID(s),
+              CI_BSWAP_BE32(oo_ip_hdr(pkt)->ip_saddr_be32),
+              CI_BSWAP_BE16(tcp->tcp_source_be16),
+              CI_BSWAP_BE16(tcp->tcp_dest_be16), tcp->tcp_flags);
+    else
+#endif
+      *dump |= DUMP_SOCK | DUMP_PKT;
+  }
 }
 
 
@@ -21,9 +21,9 @@
 # error "kernel-only source file"
 #endif
 
-int ci_tcp_helper_more_bufs(ci_netif* ni)
+int ci_tcp_helper_more_bufs(ci_netif* ni, int rx_intf_i)
 {
-  return efab_tcp_helper_more_bufs(netif2tcp_helper_resource(ni));
+  return efab_tcp_helper_more_bufs(netif2tcp_helper_resource(ni), rx_intf_i);
 }
 
 int ci_tcp_helper_more_socks(ci_netif* ni)
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* TCP flight recorder.
+ *
+ * With EF_TCP_FLIGHT_RECORDER set, each connection keeps its most recent
+ * events in a ring of that many aux buffers, allocated when it becomes
+ * established.  ts->flight points at the buffer being written; when that
+ * fills, the recorder moves on to the next buffer and overwrites it, so
+ * the oldest events are lost a buffer at a time.  Sockets without a
+ * recorder pay only the NULL check in ci_tcp_flight_record().
+ *
+ * The ring is read without the stack lock by onload_stackdump, so a dump
+ * taken while the stack is busy may show a torn event.
+ */
+
+#include "ip_internal.h"
+
+
+void ci_tcp_flight_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  unsigned n = NI_OPTS(ni).tcp_flight_bufs;
+  ci_tcp_flight_buf* first = NULL;
+  ci_tcp_flight_buf* fb;
+  oo_p p;
+
+  ci_assert(ci_netif_is_locked(ni));
+  if( n == 0 || OO_P_NOT_NULL(ts->flight) )
+    return;
+
+  for( ; n > 0; --n ) {
+    p = ci_ni_aux_alloc(ni, CI_TCP_AUX_TYPE_FLIGHT);
+    if( OO_P_IS_NULL(p) )
+      break;
+    fb = ci_ni_aux_p2flight(ni, p);
+    fb->n_evs = 0;
+    if( first == NULL ) {
+      fb->next = p;
+      first = fb;
+      ts->flight = p;
+    }
+    else {
+      fb->next = first->next;
+      first->next = p;
+    }
+  }
+}
+
+
+void ci_tcp_flight_release(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_tcp_flight_buf* fb;
+  oo_p p, next;
+
+  if( OO_P_IS_NULL(ts->flight) )
+    return;
+  p = ts->flight;
+  do {
+    fb = ci_ni_aux_p2flight(ni, p);
+    next = fb->next;
+    ci_tcp_flight_buf_free(ni, fb);
+    p = next;
+  } while( ! OO_P_EQ(p, ts->flight) );
+  ts->flight = OO_P_NULL;
+}
+
+
+void ci_tcp_flight_record_slow(ci_netif* ni, ci_tcp_state* ts,
+                               int type, int flags, unsigned len,
+                               ci_uint32 a, ci_uint32 b)
+{
+  ci_tcp_flight_buf* fb = ci_ni_aux_p2flight(ni, ts->flight);
+  ci_tcp_flight_ev* ev;
+  ci_uint64 frc;
+
+  if( fb->n_evs == CI_TCP_FLIGHT_EVS_PER_BUF ) {
+    ts->flight = fb->next;
+    fb = ci_ni_aux_p2flight(ni, ts->flight);
+    fb->n_evs = 0;
+  }
+
+  ci_frc64(&frc);
+  ev = &fb->ev[fb->n_evs];
+  ev->time = frc >> IPTIMER_STATE(ni)->ci_ip_time_frc2us;
+  ev->type = type;
+  ev->flags = flags;
+  ev->len = CI_MIN(len, 0xffffu);
+  ev->a = a;
+  ev->b = b;
+  ++fb->n_evs;
+}
+
+
+static void flight_ev_dump(ci_tcp_flight_ev* ev, unsigned age_us,
+                           const char* pf, oo_dump_log_fn_t logger,
+                           void* log_arg)
+{
+  switch( ev->type ) {
+  case CI_TCP_FLIGHT_RX:
+  case CI_TCP_FLIGHT_TX:
+    logger(log_arg, "%s    -%u %s seq=%08x ack=%08x len=%u "
+           CI_TCP_FLAGS_FMT, pf, age_us,
+           ev->type == CI_TCP_FLIGHT_RX ? "rx" : "tx", ev->a, ev->b,
+           ev->len, CI_TCP_FLAGS_PRI_ARG(ev->flags));
+    break;
+  case CI_TCP_FLIGHT_RETRANS:
+    logger(log_arg, "%s    -%u retrans %08x-%08x retransmits=%u",
+           pf, age_us, ev->a, ev->b, ev->len);
+    break;
+  case CI_TCP_FLIGHT_RTO:
+    logger(log_arg, "%s    -%u rto snd_una=%08x rto=%uticks retransmits=%u",
+           pf, age_us, ev->a, ev->b, ev->len);
+    break;
+  case CI_TCP_FLIGHT_CWND:
+    logger(log_arg, "%s    -%u cwnd=%u ssthresh=%u congstate=%x",
+           pf, age_us, ev->a, ev->b, ev->flags);
+    break;
+  case CI_TCP_FLIGHT_WND:
+    logger(log_arg, "%s    -%u wnd ack=%08x window=%u",
+           pf, age_us, ev->a, ev->b);
+    break;
+  default:
+    logger(log_arg, "%s    -%u type=%u %x %x", pf, age_us, ev->type,
+           ev->a, ev->b);
+    break;
+  }
+}
+
+
+void ci_tcp_flight_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                        oo_dump_log_fn_t logger, void* log_arg)
+{
+  ci_tcp_flight_buf* fb;
+  ci_uint32 now;
+  ci_uint64 frc;
+  oo_p oldest, p;
+  int i, n, n_bufs = 0;
+
+  if( OO_P_IS_NULL(ts->flight) )
+    return;
+  ci_frc64(&frc);
+  now = frc >> IPTIMER_STATE(ni)->ci_ip_time_frc2us;
+
+  logger(log_arg, "%s  flight recorder (oldest first, ages in ~us):", pf);
+  /* The buffer after the one being written holds the oldest events. */
+  p = oldest = ci_ni_aux_p2flight(ni, ts->flight)->next;
+  do {
+    fb = ci_ni_aux_p2flight(ni, p);
+    n = CI_MIN(fb->n_evs, CI_TCP_FLIGHT_EVS_PER_BUF);
+    for( i = 0; i < n; ++i )
+      flight_ev_dump(&fb->ev[i], now - fb->ev[i].time, pf, logger, log_arg);
+    p = fb->next;
+    /* Bound the walk in case the ring changes under our feet. */
+  } while( ! OO_P_EQ(p, oldest) && ++n_bufs < NI_OPTS(ni).tcp_flight_bufs );
+}
@@ -26,10 +26,11 @@
 #define VERB(x)
 
 
-int ci_tcp_helper_more_bufs(ci_netif* ni)
+int ci_tcp_helper_more_bufs(ci_netif* ni, int rx_intf_i)
 {
+  ci_int32 arg = rx_intf_i;
   return oo_resource_op(ci_netif_get_driver_handle(ni),
-                        OO_IOC_TCP_MORE_BUFS, NULL);
+                        OO_IOC_TCP_MORE_BUFS, &arg);
 }
 
 int ci_tcp_helper_more_socks(ci_netif* ni)
@@ -44,6 +44,7 @@ static void ci_tcp_state_setup_timers(ci_netif* ni, ci_tcp_state* ts)
   ci_tcp_setup_timer(stats,    CI_IP_TIMER_TCP_STATS,  "stat");
 #endif
   ci_tcp_setup_timer(cork,     CI_IP_TIMER_TCP_CORK,   "cork");
+  ci_tcp_setup_timer(rack,     CI_IP_TIMER_TCP_RACK,   "rack");
 
 #undef ci_tcp_setup_timer
 }
@@ -74,6 +75,7 @@ static void ci_tcp_state_connected_opts_init(ci_netif* netif, ci_tcp_state* ts)
   ci_ip_queue_init(&ts->retrans);
   for(i = 0; i <= CI_TCP_SACK_MAX_BLOCKS; i++ )
       ts->last_sack[i] = OO_PP_NULL;
+  ts->rob_tail_block = OO_PP_NULL;
   ts->dsack_block = OO_PP_INVALID;
 
   oo_p_dllink_init(netif,
@@ -99,6 +101,8 @@ static void ci_tcp_state_tcb_init_fixed(ci_netif* netif, ci_tcp_state* ts,
                        CI_IP_DFLT_TTL, CI_IP_DFLT_TOS);
 
   ts->pmtus = OO_PP_NULL;
+  ts->cong = OO_P_NULL;
+  ts->flight = OO_P_NULL;
 
   ts->s.laddr = ip4_addr_any;
   TS_IPX_TCP(ts)->tcp_source_be16 = 0;
@@ -135,6 +139,8 @@ void ci_tcp_state_tcb_reinit_minimal(ci_netif* netif, ci_tcp_state* ts)
   ts->cwnd_extra = 0;
   ts->dup_acks = 0;
   ts->bytes_acked = 0;
+  memset(&ts->rack, 0, sizeof(ts->rack));
+  ts->rack.reo_wnd_mult = 1;
 
   /* ts->eff_mss is not cleared as might be used without lock on send path */
   ts->ssthresh = 0;
@@ -155,6 +161,7 @@ void ci_tcp_state_tcb_reinit_minimal(ci_netif* netif, ci_tcp_state* ts)
   /* TCP timers, RTO, SRTT, RTTVAR */
   ts->rto = NI_CONF(netif).tconst_rto_initial;
   ts->sa = 0; /* set to zero to provoke initialisation in ci_tcp_update_rtt */
+  ts->sa_us = 0;
   ts->sv = NI_CONF(netif).tconst_rto_initial; /* cwndrecover b4 rtt measured */
 
   ts->local_peer = OO_SP_NULL;
@@ -238,6 +245,8 @@ static void ci_tcp_state_tcb_reinit(ci_netif* netif, ci_tcp_state* ts,
 
   /* TCP_MAXSEG */
   ts->c.user_mss = 0;
+  ts->c.fastopen_qlen = 0;
+  ts->c.cong_alg = NI_OPTS(netif).tcp_cong_alg;
   ts->amss = 0;
   ts->eff_mss = 0;
 
@@ -261,6 +270,8 @@ static void ci_tcp_state_tcb_reinit(ci_netif* netif, ci_tcp_state* ts,
   memset(&ts->stats, 0, sizeof(ts->stats));
 
   ci_assert(OO_PP_IS_NULL(ts->pmtus));
+  ci_assert(OO_P_IS_NULL(ts->cong));
+  ci_assert(OO_P_IS_NULL(ts->flight));
 
   /* ts is in valid state now */
   ci_wmb();
@@ -188,6 +188,7 @@ void ci_tcp_state_verify_no_timers(ci_netif *ni, ci_tcp_state *ts)
   chk(zwin_tid);
   chk(kalive_tid);
   chk(cork_tid);
+  chk(rack_tid);
 #if CI_CFG_TCP_SOCK_STATS
   chk(stats_tid);
 #endif
@@ -261,6 +262,7 @@ static void __ci_tcp_state_free(ci_netif *ni, ci_tcp_state *ts)
 
 static void ci_tcp_set_state(ci_netif* ni, ci_tcp_state* ts, int new_state)
 {
+  OO_PROBE4(tcp_state, NI_ID(ni), S_ID(ts), ts->s.b.state, new_state);
   ci_tcp_rx_buf_account_begin(ni, ts);
   ts->s.b.state = new_state;
   ci_tcp_rx_buf_account_end(ni, ts);
@@ -370,6 +372,8 @@ void ci_tcp_set_established_state(ci_netif* ni, ci_tcp_state* ts)
   /* dirty hack to abuse this, init for faststart */
   CITP_TCP_FASTSTART(ts->tslastack = tcp_rcv_nxt(ts));
 
+  ci_tcp_flight_init(ni, ts);
+
   if( ci_tcp_can_use_fast_path(ts) )
     ci_tcp_fast_path_enable(ts);
 }
@@ -531,6 +535,18 @@ int ci_tcp_parse_options(ci_netif* ni, ciip_tcp_rx_pkt* rxp,
       }
       if( topts )  topts->flags |= CI_TCPT_FLAG_SACK;
       break;
+    case CI_TCP_OPT_FASTOPEN:
+      if( len != 2 && (len < 2 + CI_TCP_FASTOPEN_COOKIE_MIN ||
+                       len > 2 + CI_TCP_FASTOPEN_COOKIE_MAX) ) {
+        LOG_U(log(LPF "TFO(bad length %d)", len));
+        goto fail_out;
+      }
+      if( topts ) {
+        rxp->flags |= CI_TCP_FASTOPEN;
+        rxp->fastopen_len = len - 2;
+        memcpy(rxp->fastopen_cookie, opt + 2, len - 2);
+      }
+      break;
     default:
 #if CI_CFG_PORT_STRIPING
       if( opt[0] == NI_OPTS(ni).stripe_tcp_opt ) {
@@ -574,12 +590,15 @@ void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts)
   ci_ip_timer_clear_ool(netif, &ts->zwin_tid);
   ci_ip_timer_clear_ool(netif, &ts->kalive_tid);
   ci_ip_timer_clear_ool(netif, &ts->cork_tid);
+  ci_ip_timer_clear_ool(netif, &ts->rack_tid);
   if( OO_PP_NOT_NULL(ts->pmtus) ) {
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(netif, ts->pmtus);
     ci_ip_timer_clear_ool(netif, &pmtus->tid);
     ci_pmtu_state_free(netif, pmtus);
     ts->pmtus = OO_PP_NULL;
   }
+  ci_tcp_cong_release(netif, ts);
+  ci_tcp_flight_release(netif, ts);
 #if CI_CFG_TCP_SOCK_STATS
   ci_ip_timer_clear_ool(netif, &ts->stats_tid);
 #endif
@@ -1034,6 +1053,8 @@ void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts)
   LOG_TL(log(LNT_FMT "RECOVERED "TCP_SND_FMT" cwnd=%d ssthresh=%d rto=%d",
              LNT_PRI_ARGS(ni, ts), TCP_SND_PRI_ARG(ts),
              ts->cwnd, ts->ssthresh, ts->rto));
+  ci_tcp_flight_record(ni, ts, CI_TCP_FLIGHT_CWND, ts->congstate, 0,
+                       ts->cwnd, ts->ssthresh);
 
   ci_assert(ts->cwnd >= tcp_eff_mss(ts));
 }
@@ -1147,6 +1168,7 @@ void ci_tcp_drop_rob(ci_netif* ni, ci_tcp_state* ts)
   ci_tcp_rx_queue_drop(ni, ts, &ts->rob);
   for( i = 0; i <= CI_TCP_SACK_MAX_BLOCKS; ++i )
     ts->last_sack[i] = OO_PP_NULL;
+  ts->rob_tail_block = OO_PP_NULL;
   ts->dsack_block = OO_PP_INVALID;
 }
 
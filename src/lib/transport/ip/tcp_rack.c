@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* RACK: time-based TCP loss detection (RFC8985).
+ *
+ * With EF_TCP_RACK set, and SACK negotiated, the decision to enter fast
+ * recovery is taken from the send times of segments rather than from a
+ * count of dupacks.  Each segment is stamped with the time it was last
+ * (re)transmitted.  When a segment is ACKed or SACKed we note the most
+ * recently sent one to be delivered, and the unSACKed head of the
+ * retransmit queue is deemed lost once it was sent before that segment
+ * and has been outstanding for longer than its RTT plus a reordering
+ * window.  If the head was sent earlier but the window has not yet
+ * expired, rack_tid is armed to check again when it does.
+ *
+ * Reordering of less than the window therefore never triggers a fast
+ * retransmit, however many dupacks it generates.  The window starts at a
+ * quarter of the minimum RTT and is widened each time the peer reports a
+ * spurious retransmit with a DSACK, up to CI_TCP_RACK_REO_WND_MULT_MAX.
+ *
+ * Once in recovery, retransmission proceeds from the SACK scoreboard as
+ * usual.  The tail loss probe of RACK-TLP is the existing tail drop probe
+ * (EF_TAIL_DROP_PROBE).
+ */
+
+#include "ip_internal.h"
+
+
+#define LPF "TCP RACK "
+
+#define CI_TCP_RACK_REO_WND_MULT_MAX  8
+
+
+/* Whether a segment sent at [t1] ending at [seq1] was sent after one sent
+ * at [t2] ending at [seq2]; segments sent in the same microsecond are
+ * ordered by sequence number. */
+static int /*bool*/ ci_tcp_rack_sent_after(ci_uint32 t1, ci_uint32 seq1,
+                                           ci_uint32 t2, ci_uint32 seq2)
+{
+  return (ci_int32) (t1 - t2) > 0 || (t1 == t2 && SEQ_GT(seq1, seq2));
+}
+
+
+static ci_uint32 ci_tcp_rack_reo_wnd(ci_tcp_state* ts)
+{
+  ci_uint32 reo_wnd = (ts->rack.min_rtt_us >> 2) * ts->rack.reo_wnd_mult;
+  return CI_MIN(reo_wnd, ts->rack.rtt_us);
+}
+
+
+void ci_tcp_rack_update(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt,
+                        ci_uint32 now_us)
+{
+  ci_uint32 xmit_us = pkt->pf.tcp_tx.xmit_us;
+  ci_uint32 rtt_us = now_us - xmit_us;
+
+  ci_assert(ci_tcp_rack_enabled(ni, ts));
+
+  /* An ACK of a retransmitted segment may be for the original; if the RTT
+   * looks too short for the retransmit then it was (RFC8985 6.2 step 2). */
+  if( (pkt->flags & CI_PKT_FLAG_RTQ_RETRANS) && ts->rack.valid &&
+      rtt_us < ts->rack.min_rtt_us )
+    return;
+
+  if( ! ts->rack.valid || rtt_us < ts->rack.min_rtt_us )
+    ts->rack.min_rtt_us = rtt_us;
+
+  if( ! ts->rack.valid ||
+      ci_tcp_rack_sent_after(xmit_us, pkt->pf.tcp_tx.end_seq,
+                             ts->rack.xmit_us, ts->rack.end_seq) ) {
+    ts->rack.xmit_us = xmit_us;
+    ts->rack.end_seq = pkt->pf.tcp_tx.end_seq;
+    ts->rack.rtt_us = rtt_us;
+    ts->rack.valid = 1;
+  }
+}
+
+
+void ci_tcp_rack_dsack(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ts->rack.reo_wnd_mult < CI_TCP_RACK_REO_WND_MULT_MAX )
+    ++ts->rack.reo_wnd_mult;
+}
+
+
+int ci_tcp_rack_detect_loss(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_ip_pkt_queue* rtq = &ts->retrans;
+  ci_ip_pkt_fmt* pkt;
+  ci_uint32 now_us, wait_us;
+  ci_iptime_t t;
+
+  ci_assert(ci_tcp_rack_enabled(ni, ts));
+
+  if( ! ts->rack.valid || ci_ip_queue_is_empty(rtq) )
+    return 0;
+
+  /* Find the oldest segment not yet SACKed. */
+  pkt = PKT_CHK(ni, rtq->head);
+  while( pkt->flags & CI_PKT_FLAG_RTQ_SACKED ) {
+    if( OO_PP_IS_NULL(pkt->next) )
+      return 0;
+    pkt = PKT_CHK(ni, pkt->next);
+  }
+
+  /* It cannot be lost unless something sent after it has been delivered. */
+  if( ! ci_tcp_rack_sent_after(ts->rack.xmit_us, ts->rack.end_seq,
+                               pkt->pf.tcp_tx.xmit_us,
+                               pkt->pf.tcp_tx.end_seq) )
+    return 0;
+
+  ci_ip_time_get_us(its, &now_us);
+  wait_us = ts->rack.rtt_us + ci_tcp_rack_reo_wnd(ts);
+  if( now_us - pkt->pf.tcp_tx.xmit_us >= wait_us ) {
+    ci_ip_timer_clear(ni, &ts->rack_tid);
+    LOG_TL(log(LNT_FMT "RACK lost %08x-%08x rtt=%u reo_wnd=%u",
+               LNT_PRI_ARGS(ni, ts), pkt->pf.tcp_tx.start_seq,
+               pkt->pf.tcp_tx.end_seq, ts->rack.rtt_us,
+               ci_tcp_rack_reo_wnd(ts)));
+    return 1;
+  }
+
+  /* Not yet: look again when the reordering window expires.  The timer
+   * wheel has a resolution of a tick, so round up. */
+  wait_us -= now_us - pkt->pf.tcp_tx.xmit_us;
+  t = (wait_us >> (its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us)) + 1;
+  if( ci_ip_timer_pending(ni, &ts->rack_tid) )
+    ci_ip_timer_modify(ni, &ts->rack_tid, ci_tcp_time_now(ni) + t);
+  else
+    ci_ip_timer_set(ni, &ts->rack_tid, ci_tcp_time_now(ni) + t);
+  return 0;
+}
+
+
+/* Called when the RACK reordering window expires. */
+void ci_tcp_timeout_rack(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ! ci_tcp_rack_enabled(ni, ts) ||
+      ! ((ts->congstate == CI_TCP_CONG_OPEN) |
+         (ts->congstate == CI_TCP_CONG_NOTIFIED)) )
+    return;
+  ci_tcp_maybe_enter_fast_recovery(ni, ts);
+}
@@ -185,7 +185,7 @@ void ci_tcp_rcvbuf_drs(ci_netif* netif, ci_tcp_state* ts)
    * [prev RTT][current RTT][following RTT]
    */
 
-  if( ! (ts->s.s_flags & CI_SOCK_FLAG_SET_SNDBUF) ) {
+  if( ! (ts->s.s_flags & CI_SOCK_FLAG_SET_RCVBUF) ) {
     int rcv_wnd, rcvbuf;
 
     /* at least 2x factor to cope with packet loss, plus small extra cushion */
@@ -204,9 +204,22 @@ void ci_tcp_rcvbuf_drs(ci_netif* netif, ci_tcp_state* ts)
     rcvbuf = CI_MIN((ci_uint64)rcv_wnd, max_rcvbuf_packets * ts->amss);
 
     if( rcvbuf > ts->s.so.rcvbuf ) {
-      ts->s.so.rcvbuf = rcvbuf;
-      ci_tcp_set_rcvbuf(netif, ts);
-      /* Window will be calculated from this new value.  */
+      /* Packet buffers are the stack's to share out: do not hand more of
+       * them to one socket while the stack is short of them. */
+      if( netif->state->mem_pressure ) {
+        CITP_STATS_NETIF_INC(netif, tcp_rcvbuf_drs_capped);
+      }
+      else {
+        if( rcvbuf < rcv_wnd )
+          CITP_STATS_NETIF_INC(netif, tcp_rcvbuf_drs_capped);
+        CITP_STATS_NETIF_INC(netif, tcp_rcvbuf_drs_grows);
+        ts->s.so.rcvbuf = rcvbuf;
+        ci_tcp_set_rcvbuf(netif, ts);
+        /* Window will be calculated from this new value.  */
+      }
+    }
+    else if( rcvbuf < rcv_wnd ) {
+      CITP_STATS_NETIF_INC(netif, tcp_rcvbuf_drs_capped);
     }
   }
   ts->rcvbuf_drs.bytes = rcv_bytes;
@@ -283,6 +296,42 @@ ci_tcp_fill_recv_timestamp(struct tcp_recv_info* rinf, ci_ip_pkt_fmt* pkt)
       msg->msg_controllen = 0;
   }
 }
+
+
+/* Put a completion cmsg for each remote zc payload in [pkt] which asked
+ * for one.  Returns the number of completions. */
+static int ci_tcp_zc_put_cookies(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                 struct cmsg_state* cmsg_state)
+{
+  struct ci_pkt_zc_header* zch = oo_tx_zc_header(pkt);
+  struct ci_pkt_zc_payload* zcp;
+  int n = 0;
+
+  OO_TX_FOR_EACH_ZC_PAYLOAD(ni, zch, zcp) {
+    if( zcp->is_remote && zcp->use_remote_cookie ) {
+      if( cmsg_state != NULL )
+        ci_put_cmsg(cmsg_state, SOL_IP, ONLOAD_SO_ONLOADZC_COMPLETE,
+                    sizeof(zcp->remote.app_cookie),
+                    &zcp->remote.app_cookie);
+      ++n;
+    }
+  }
+  return n;
+}
+
+
+/* Is there room in the control buffer for all the completions of [pkt]?
+ * A packet's completions are never split between two recvmsg() calls. */
+static bool ci_tcp_zc_cookies_fit(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                  struct cmsg_state* cmsg_state)
+{
+  int space = cmsg_state->msg->msg_controllen - cmsg_state->cmsg_bytes_used;
+  int n = ci_tcp_zc_put_cookies(ni, pkt, NULL);
+
+  if( *cmsg_state->p_msg_flags & MSG_CTRUNC )
+    return false;
+  return space >= n * (int) CMSG_SPACE(sizeof(ci_uint64));
+}
 #endif
 #endif
 
@@ -462,6 +511,48 @@ static int copy_one_pkt(ci_netif* netif, struct tcp_recv_info* rinf,
 }
 
 
+#ifndef __KERNEL__
+/* Bulk variant of copy_one_pkt(), for reads of at least
+ * EF_TCP_RECV_NT_COPY_THRESH bytes.  The copy bypasses the cache, so
+ * start pulling in the next packet's payload before it's wanted.
+ */
+static int copy_one_pkt_nt(ci_netif* netif, struct tcp_recv_info* rinf,
+                           ci_ip_pkt_fmt* pkt, int peek_off, int* ndata)
+{
+  ci_iovec* iov = &rinf->piov.io;
+  size_t n;
+
+  if( OO_PP_NOT_NULL(pkt->next) )
+    ci_prefetch(oo_offbuf_ptr(&PKT_CHK_NNL(netif, pkt->next)->buf));
+
+  n = CI_MIN((size_t) oo_offbuf_left(&pkt->buf) - peek_off,
+             CI_IOVEC_LEN(iov));
+  ci_memcpy_nt(CI_IOVEC_BASE(iov), oo_offbuf_ptr(&pkt->buf) + peek_off, n);
+  CI_IOVEC_BASE(iov) = (char*) CI_IOVEC_BASE(iov) + n;
+  CI_IOVEC_LEN(iov) -= n;
+  *ndata = n;
+  return n;
+}
+
+
+static int ci_tcp_recvmsg_want_nt(const ci_tcp_recvmsg_args* a)
+{
+  ci_uint32 thresh = NI_OPTS(a->ni).tcp_recv_nt_copy_thresh;
+
+  if(CI_LIKELY( thresh == 0 ))
+    return 0;
+  if( a->flags & MSG_TRUNC )
+    return 0;
+#if CI_CFG_TCP_OFFLOAD_RECYCLER
+  if( ci_tcp_is_pluginized(a->ts) )
+    return 0;
+#endif
+  return (unsigned) ci_iovec_bytes(a->msg->msg_iov, a->msg->msg_iovlen) >=
+         thresh;
+}
+#endif
+
+
 /* Copy data from the receive queue to the app's buffer(s).  Returns the
 ** number of bytes copied.  This function also sends window updates as
 ** appropriate.
@@ -649,6 +740,9 @@ static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
   const uint32_t poison = CI_PKT_RX_POISON;
   const volatile uint32_t* future = ci_netif_intf_rx_future(ni, intf_i, &poison);
 
+  if( NI_OPTS(ni).spin_adapt )
+    max_spin = ci_netif_spin_adapt_limit(ni, ts, max_spin);
+
   if( ts->s.so.rcvtimeo_msec ) {
     ci_uint64 max_so_spin = (ci_uint64)ts->s.so.rcvtimeo_msec *
         IPTIMER_STATE(ni)->khz;
@@ -673,10 +767,7 @@ static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
 
       if( ni->state->poll_work_outstanding ||
           ci_netif_need_poll_spinning(ni, now_frc) ) {
-        if( ci_netif_trylock(ni) ) {
-          ci_netif_poll(ni);
-          ci_netif_unlock(ni);
-        }
+        ci_netif_spin_poll(ni);
         if( tcp_rcv_usr(ts) )
           goto out;
         future = ci_netif_intf_rx_future(ni, intf_i, &poison);
@@ -700,6 +791,8 @@ static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
   } while( now_frc - start_frc < max_spin );
 
   rc = spin_limit_by_so ? -EAGAIN : 0;
+  if( NI_OPTS(ni).spin_adapt && max_spin != 0 && ! spin_limit_by_so )
+    CITP_STATS_NETIF_INC(ni, spin_adapt_miss);
  out:
   ni->state->is_spinner = 0;
   return rc;
@@ -754,6 +847,7 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
   ci_uint64             start_frc = 0; /* suppress compiler warning */
 #ifndef __KERNEL__
   unsigned              tcp_recv_spin = 0;
+  int                   spin_adapt = 0;
 #endif
   ci_uint32             timeout = ts->s.so.rcvtimeo_msec;
   struct tcp_recv_info  rinf;
@@ -803,6 +897,7 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
 #ifndef __KERNEL__
   tcp_recv_spin = 
     oo_per_thread_get()->spinstate & (1 << ONLOAD_SPIN_TCP_RECV);
+  spin_adapt = tcp_recv_spin && NI_OPTS(ni).spin_adapt;
 #endif
   ci_frc64(&start_frc);
 
@@ -901,12 +996,17 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
         rinf.rc = rc2;
         goto unlock_out;
       }
+      if( spin_adapt )
+        ci_netif_spin_adapt_done(ni, ts, start_frc, 1);
       goto poll_recv_queue;
     }
 
     tcp_recv_spin = 0;
     if( timeout ) {
-      ci_uint32 spin_ms = NI_OPTS(ni).spin_usec >> 10;
+      /* An adaptive spin may have been cut short. */
+      ci_uint32 spin_ms = spin_adapt ?
+        (ci_frc64_get() - start_frc) / IPTIMER_STATE(ni)->khz :
+        NI_OPTS(ni).spin_usec >> 10;
       if( spin_ms < timeout )
         timeout -= spin_ms;
       else {
@@ -938,6 +1038,10 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
     rc2 = ci_sock_sleep(ni, &ts->s.b, CI_SB_FLAG_WAKE_RX,
                         CI_SLEEP_SOCK_LOCKED | CI_SLEEP_SOCK_RQ,
                         sleep_seq, &timeout);
+#ifndef __KERNEL__
+    if( rc2 == 0 && spin_adapt )
+      ci_netif_spin_adapt_done(ni, ts, start_frc, 0);
+#endif
     if( rc2 == 0 )
       rc2 = ci_sock_lock(ni, &ts->s.b);
     if( rc2 < 0 ) {
@@ -963,7 +1067,28 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
 #if CI_CFG_TIMESTAMPING
     ci_ip_pkt_fmt* pkt;
     int rc3 = 0;
+#endif
+
+    if( ci_sock_zc_pending(&ts->s) ) {
+      struct cmsg_state cmsg_state;
+
+      a->msg->msg_controllen = rinf.controllen;
+      cmsg_state.msg = a->msg;
+      cmsg_state.cm = a->msg->msg_control;
+      cmsg_state.cmsg_bytes_used = 0;
+      cmsg_state.p_msg_flags = &rinf.msg_flags;
+      ip_cmsg_recv_zc_notification(&ts->s, &cmsg_state);
+      ci_ip_cmsg_finish(&cmsg_state);
+      rinf.msg_flags |= MSG_ERRQUEUE;
+      if( rinf.stack_locked ) {
+        ci_netif_unlock(ni);
+        rinf.stack_locked = 0;
+      }
+      rinf.rc = 0;
+      goto unlock_out;
+    }
 
+#if CI_CFG_TIMESTAMPING
   timestamp_q_check:
 
     /* The timestamp is stored at TX complete event.  We should not read it
@@ -1008,13 +1133,23 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
 
       }
       if( pkt->flags & CI_PKT_FLAG_INDIRECT ) {
-        struct ci_pkt_zc_header* zch = oo_tx_zc_header(pkt);
-        struct ci_pkt_zc_payload* zcp;
-        OO_TX_FOR_EACH_ZC_PAYLOAD(ni, zch, zcp) {
-          if( zcp->is_remote && zcp->use_remote_cookie ) {
-            ci_put_cmsg(&cmsg_state, SOL_IP, ONLOAD_SO_ONLOADZC_COMPLETE,
-                        sizeof(zcp->remote.app_cookie),
-                        &zcp->remote.app_cookie);
+        ci_tcp_zc_put_cookies(ni, pkt, &cmsg_state);
+
+        /* Completions queued behind this packet go out in the same call
+         * while they fit in the control buffer, so that an application
+         * sending from its own memory does not need a recvmsg() for each
+         * acked segment.  Timestamps are still one packet per call. */
+        if( ! (pkt->flags & CI_PKT_FLAG_TX_TIMESTAMPED) ) {
+          ci_ip_pkt_fmt* next;
+          while( (next = ci_udp_recv_q_get(ni, &ts->timestamp_q)) != NULL &&
+                 (next->flags & (CI_PKT_FLAG_INDIRECT |
+                                 CI_PKT_FLAG_TX_TIMESTAMPED |
+                                 CI_PKT_FLAG_TX_PENDING)) ==
+                   CI_PKT_FLAG_INDIRECT &&
+                 ci_tcp_zc_cookies_fit(ni, next, &cmsg_state) ) {
+            ci_udp_recv_q_deliver(ni, &ts->timestamp_q, next);
+            ci_rmb();
+            ci_tcp_zc_put_cookies(ni, next, &cmsg_state);
           }
         }
       }
@@ -1117,7 +1252,15 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
 
 int ci_tcp_recvmsg(const ci_tcp_recvmsg_args* a)
 {
-  int rc = ci_tcp_recvmsg_impl(a, copy_one_pkt, NULL);
+  int rc;
+
+#ifndef __KERNEL__
+  if(CI_UNLIKELY( ci_tcp_recvmsg_want_nt(a) ))
+    rc = ci_tcp_recvmsg_impl(a, copy_one_pkt_nt, NULL);
+  else
+#endif
+    rc = ci_tcp_recvmsg_impl(a, copy_one_pkt, NULL);
+  OO_PROBE3(tcp_recv, NI_ID(a->ni), S_ID(a->ts), rc);
   if( rc < 0 )
     CI_SET_ERROR(rc, -rc);
   return rc;
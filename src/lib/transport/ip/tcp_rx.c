@@ -178,6 +178,14 @@ static void remove_from_last_sack(ci_tcp_state* ts, oo_pkt_p id)
 }
 
 
+/* Called when the block whose first packet is [id] leaves the rob. */
+static void remove_from_rob_tail_block(ci_tcp_state* ts, oo_pkt_p id)
+{
+  if( OO_PP_EQ(ts->rob_tail_block, id) )
+    ts->rob_tail_block = OO_PP_NULL;
+}
+
+
 static void ci_tcp_rx_add_to_recvq(ci_netif *netif, ci_tcp_state *ts,
                                    ci_ip_pkt_fmt *pkt, int bytes)
 {
@@ -185,6 +193,7 @@ static void ci_tcp_rx_add_to_recvq(ci_netif *netif, ci_tcp_state *ts,
   oo_pkt_p prevhead = rxq->head;
 
   ci_assert(ci_netif_is_locked(netif));
+  OO_PROBE3(tcp_enqueue, NI_ID(netif), S_ID(ts), bytes);
   pkt->next = OO_PP_NULL;
   /* Barrier ensures concurring thread is able to read metadata
    * of pkt buffers pointed to by recv1_extract. */
@@ -224,6 +233,7 @@ static void ci_tcp_rx_clean_plugin_rob(ci_netif *netif, ci_tcp_state *ts,
   while( (p = PKT_CHK(netif, ts->rob.head)) != NULL &&
          SEQ_LE(p->pf.tcp_rx.end_seq, nxt) ) {
     remove_from_last_sack(ts, ts->rob.head);
+    remove_from_rob_tail_block(ts, ts->rob.head);
     ci_ip_queue_dequeue(netif, &ts->rob, p);
     if( ci_ip_queue_is_empty(&ts->rob) ) {
       ci_netif_pkt_release_rx(netif, p);
@@ -244,6 +254,62 @@ static void ci_tcp_rx_clean_plugin_rob(ci_netif *netif, ci_tcp_state *ts,
 }
 
 
+/* Copy the payload of the small in-order segment [pkt] onto the end of the
+ * last packet in the receive queue and free [pkt], if it fits.  Returns
+ * true if it did.
+ *
+ * The receive path owns the packets from recv1_extract onwards under the
+ * socket lock, so this is only done when we can take that lock.  The tail
+ * must also hold unread data and no other references, so that it has not
+ * been handed out by zero-copy receive and is not about to be reaped.
+ */
+static int ci_tcp_rx_copybreak(ci_netif* netif, ci_tcp_state* ts,
+                               ci_ip_pkt_fmt* pkt)
+{
+  ci_ip_pkt_queue* rxq = &ts->recv1;
+  int bytes = oo_offbuf_left(&pkt->buf);
+  ci_ip_pkt_fmt* tail;
+  char* end;
+
+  if( bytes == 0 || bytes > NI_OPTS(netif).tcp_rx_copybreak ||
+      TS_QUEUE_RX(ts) != rxq || OO_PP_IS_NULL(rxq->tail) ||
+      (ts->s.cmsg_flags & CI_IP_CMSG_TIMESTAMP_ANY) ||
+      (PKT_IPX_TCP_HDR(ipcache_af(&ts->s.pkt), pkt)->tcp_flags &
+       CI_TCP_FLAG_FIN) )
+    return 0;
+
+  /* A reader holding the socket lock may consume or release the tail, so
+   * only look at it once we hold the lock too. */
+  if( ! ci_sock_trylock(netif, &ts->s.b) )
+    return 0;
+  if( OO_PP_IS_NULL(rxq->tail) )
+    goto unlock_out;
+  tail = PKT_CHK(netif, rxq->tail);
+  end = oo_offbuf_end(&tail->buf);
+  if( tail->refcount != 1 || tail->n_buffers != 1 ||
+      (tail->flags & CI_PKT_FLAG_INDIRECT) ||
+      (tail->rx_flags & (CI_PKT_RX_FLAG_KEEP | CI_PKT_RX_FLAG_RX_SHARED)) ||
+      oo_offbuf_is_empty(&tail->buf) ||
+      end + bytes > (char*) tail + CI_CFG_PKT_BUF_SIZE )
+    goto unlock_out;
+
+  memcpy(end, oo_offbuf_ptr(&pkt->buf), bytes);
+  oo_offbuf_set_end(&tail->buf, end + bytes);
+  tail->pay_len += bytes;
+  tail->pf.tcp_rx.end_seq = pkt->pf.tcp_rx.end_seq;
+  ci_sock_unlock(netif, &ts->s.b);
+
+  ci_tcp_rx_update_state_on_add(ts, bytes);
+  ci_netif_pkt_release_rx(netif, pkt);
+  CITP_STATS_NETIF_INC(netif, tcp_rx_copybreak);
+  return 1;
+
+ unlock_out:
+  ci_sock_unlock(netif, &ts->s.b);
+  return 0;
+}
+
+
 /** Enqueue a single packet pkt on the receive queue of [ts]. */
 static void ci_tcp_rx_enqueue_packet(ci_netif *netif, ci_tcp_state *ts,
                                      ci_ip_pkt_fmt *pkt)
@@ -265,6 +331,9 @@ static void ci_tcp_rx_enqueue_packet(ci_netif *netif, ci_tcp_state *ts,
   }
 
   tcp_rcv_nxt(ts) = pkt->pf.tcp_rx.end_seq;
+  if( NI_OPTS(netif).tcp_rx_copybreak != 0 &&
+      ci_tcp_rx_copybreak(netif, ts, pkt) )
+    return;
   ci_tcp_rx_add_to_recvq(netif, ts, pkt, oo_offbuf_left(&pkt->buf));
 }
 
@@ -334,6 +403,7 @@ static void ci_tcp_rx_enqueue_chain(ci_netif *netif, ci_tcp_state *ts,
 #endif
 
   tcp_rcv_nxt(ts) = last->pf.tcp_rx.end_seq;
+  OO_PROBE3(tcp_enqueue, NI_ID(netif), S_ID(ts), bytes);
 
   /* move between two rx queues */
   ci_ip_queue_move(netif, from, rxq, last, num);
@@ -774,22 +844,30 @@ ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
 
 static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
 {
-  ts->ssthresh = ci_tcp_losswnd(ts);
+  ts->ssthresh = ci_tcp_cong_ssthresh(ni, ts);
   ts->cwnd = ts->ssthresh + ci_tcp_base_dupack_thresh(ts) * tcp_eff_mss(ts);
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).loss_min_cwnd);
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).min_cwnd);
   ci_assert(ts->cwnd >= tcp_eff_mss(ts));
+  ci_tcp_flight_record(ni, ts, CI_TCP_FLIGHT_CWND, ts->congstate, 0,
+                       ts->cwnd, ts->ssthresh);
 }
 
 
-/* Enters fast recovery if we've received enough dupacks.  Returns non-zero
- * iff we enter fast recovery. */
+/* Enters fast recovery if we've received enough dupacks, or with RACK if
+ * the oldest outstanding segment is deemed lost.  Returns non-zero iff we
+ * enter fast recovery. */
 int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
 {
   ci_uint32 dup_thresh = ci_tcp_base_dupack_thresh(ts);
   ci_ip_pkt_fmt *pkt;
 
-  if( ts->dup_acks == 0 ) {
+  if( ci_tcp_rack_enabled(ni, ts) ) {
+    /* RACK replaces the dupack threshold and early retransmit. */
+    if( ! ci_tcp_rack_detect_loss(ni, ts) )
+      return 0;
+  }
+  else if( ts->dup_acks == 0 ) {
     return 0;
   }
   else if( ts->dup_acks >= dup_thresh ) {
@@ -1050,6 +1128,8 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
   ci_ip_pkt_fmt* end_pkt;
   ci_ip_pkt_fmt* pkt;
   oo_pkt_p next_pp;
+  int rack = ci_tcp_rack_enabled(ni, ts);
+  ci_uint32 now_us = 0;
 
   /* ?? TODO:
   **
@@ -1144,9 +1224,15 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
   while( 1 ) {
     if( SEQ_LT(end, pkt->pf.tcp_tx.end_seq) )  break;
     end_pkt = pkt;
+    /* Step over SACKed packets a block at a time. */
+    if( pkt->flags & CI_PKT_FLAG_RTQ_SACKED ) {
+      pkt = PKT_CHK(ni, pkt->pf.tcp_tx.block_end);
+      if( SEQ_LE(pkt->pf.tcp_tx.end_seq, end) )
+        end_pkt = pkt;
+    }
     /* This is a common case, so extra test for it here. */
-    if( SEQ_EQ(end, pkt->pf.tcp_tx.end_seq) )  break;
-    if( OO_PP_IS_NULL(pkt->next) )  break;
+    if( SEQ_EQ(end, end_pkt->pf.tcp_tx.end_seq) )  break;
+    if( OO_PP_IS_NULL(end_pkt->next) )  break;
     pkt = PKT_CHK(ni, end_pkt->next);
   }
   if( ! end_pkt ) {
@@ -1192,26 +1278,40 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
   if( OO_PP_NOT_NULL(end_pkt->next) ) {
     pkt = PKT_CHK(ni, end_pkt->next);
     if( pkt->flags & CI_PKT_FLAG_RTQ_SACKED ) {
+      next_pp = OO_PKT_P(ci_tcp_sacked_block_end(ni, pkt));
       LOG_TV(log(LNT_FMT "SACK %08x-%08x inconsistent with %08x-%08x",
                  LNT_PRI_ARGS(ni, ts), start, end,
                  pkt->pf.tcp_tx.start_seq,
-                 PKT_CHK(ni, pkt->pf.tcp_tx.block_end)->pf.tcp_tx.end_seq));
-      next_pp = pkt->pf.tcp_tx.block_end;
+                 PKT_CHK(ni, next_pp)->pf.tcp_tx.end_seq));
     }
   }
 
-  /* Set [block_end] pointers for the SACKed block. */
-  if( start_block->flags & CI_PKT_FLAG_RTQ_SACKED )
-    pkt = start_block;
-  else
+  /* Set [block_end] pointers for the SACKed block.  Packets that were
+  ** already SACKed are left alone: see ci_tcp_sacked_block_end().  So
+  ** growing a block costs only the packets added to it.
+  */
+  if( start_block->flags & CI_PKT_FLAG_RTQ_SACKED ) {
+    pkt = start_block_end;
+    start_block->pf.tcp_tx.block_end = next_pp;
+  }
+  else {
     pkt = start_pkt;
-  while( pkt != end_pkt ) {
-    pkt->pf.tcp_tx.block_end = next_pp;
-    pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+  }
+  if( rack )
+    ci_ip_time_get_us(IPTIMER_STATE(ni), &now_us);
+  while( 1 ) {
+    if( pkt->flags & CI_PKT_FLAG_RTQ_SACKED ) {
+      pkt = PKT_CHK(ni, pkt->pf.tcp_tx.block_end);
+    }
+    else {
+      if( rack )
+        ci_tcp_rack_update(ni, ts, pkt, now_us);
+      pkt->pf.tcp_tx.block_end = next_pp;
+      pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+    }
+    if( SEQ_LE(end_pkt->pf.tcp_tx.end_seq, pkt->pf.tcp_tx.end_seq) )  break;
     pkt = PKT_CHK(ni, pkt->next);
   }
-  pkt->pf.tcp_tx.block_end = next_pp;
-  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
 
   /* We took early exits from this function when this SACK block was contained
    * within an earlier one, so we know that we have recorded new SACK
@@ -1304,6 +1404,8 @@ static void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
 
   /* Check for DSACK.  If it is, then skip the first block. */
   i = ci_tcp_rx_dsack_check(netif, ts, rxp);
+  if( i && ci_tcp_rack_enabled(netif, ts) )
+    ci_tcp_rack_dsack(netif, ts);
 
   /* Iterate over each sack block, deciding what action to take */
   for( ; i < rxp->sack_blocks; i++ ) {
@@ -1369,6 +1471,12 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
   unsigned ts_q_bufs = 0;
 #endif
 
+  int rack = ci_tcp_rack_enabled(netif, ts);
+  int rtt_us = NI_OPTS(netif).tcp_rtt_us;
+  ci_uint32 now_us = 0;
+  ci_uint32 rtt_xmit_us = 0;
+  int rtt_valid = 0;
+
   ci_assert(ci_ip_queue_is_valid(netif, rtq));
   ts->retransmits=0;
 
@@ -1378,6 +1486,9 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
     goto done;
   }
 
+  if( rack | rtt_us )
+    ci_ip_time_get_us(IPTIMER_STATE(netif), &now_us);
+
   while( 1 ) {
     ci_ip_pkt_fmt* p = PKT_CHK(netif, rtq->head);
 #ifndef NDEBUG
@@ -1409,13 +1520,24 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
       ci_nvme_plugin_crc_free_acked_ids(netif, p);
 #endif
 
+    if( rack && ! (p->flags & CI_PKT_FLAG_RTQ_SACKED) )
+      ci_tcp_rack_update(netif, ts, p, now_us);
+    /* Time the most recently sent segment that this ACK delivers, unless
+     * it was retransmitted (Karn) or SACKed earlier. */
+    if( rtt_us && ! (p->flags & (CI_PKT_FLAG_RTQ_RETRANS |
+                                 CI_PKT_FLAG_RTQ_SACKED)) ) {
+      rtt_xmit_us = p->pf.tcp_tx.xmit_us;
+      rtt_valid = 1;
+    }
+
     ci_ip_queue_dequeue(netif, rtq, p);
 
     ci_assert(p->refcount > 0);
 
 #if CI_CFG_TIMESTAMPING
     if( (p->flags & CI_PKT_FLAG_TX_TIMESTAMPED &&
-         onload_timestamping_want_tx_nic(ts->s.timestamping_flags)) ||
+         onload_timestamping_want_tx_nic(ts->s.timestamping_flags) &&
+         ! onload_timestamping_want_tx_ring(ts->s.timestamping_flags)) ||
         (p->flags & CI_PKT_FLAG_INDIRECT &&
          ci_tcp_zc_has_cookies(netif, p)) ) {
       ci_udp_recv_q_put_pending(netif, &ts->timestamp_q, p);
@@ -1445,6 +1567,17 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
     }
   }
 
+  if( rtt_valid )
+    ci_tcp_update_rtt_us(netif, ts, now_us - rtt_xmit_us);
+
+  /* The new head may be part way into a SACKed block, so bring its
+   * [block_end] up to date: see ci_tcp_sacked_block_end(). */
+  if( ci_ip_queue_not_empty(rtq) ) {
+    ci_ip_pkt_fmt* p = PKT_CHK(netif, rtq->head);
+    if( p->flags & CI_PKT_FLAG_RTQ_SACKED )
+      ci_tcp_sacked_block_end(netif, p);
+  }
+
 #if CI_CFG_TIMESTAMPING
   ts->timestamp_q_pending = ts_q_pending;
   if( ts_q_bufs ) {
@@ -1521,6 +1654,8 @@ ci_inline int ci_tcp_rx_try_snd_wnd_inflate(ci_tcp_state *ts,
       ) {
     ci_uint32 prev_snd_max = ts->snd_max;
     ci_tcp_set_snd_max(ts, rxp->seq, rxp->ack, pkt->pf.tcp_rx.window);
+    ci_tcp_flight_record(rxp->ni, ts, CI_TCP_FLIGHT_WND, 0, 0,
+                         rxp->ack, pkt->pf.tcp_rx.window);
     ci_assert(SEQ_GE(ts->snd_max, ts->snd_una));
     return ts->snd_max - prev_snd_max;
   }
@@ -1564,8 +1699,12 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
 
     /* Left edge is acked: Update RTT estimation.
      * Following Linux implementation do not update RTT if segment does not
-     * contain TSO. */
-    if( ts->tcpflags & rxp->flags & CI_TCPT_FLAG_TSO ) {
+     * contain TSO.  With EF_TCP_RTT_US, ci_tcp_rx_free_acked_bufs() does
+     * it instead. */
+    if( NI_OPTS(netif).tcp_rtt_us ) {
+      /* Measured below. */
+    }
+    else if( ts->tcpflags & rxp->flags & CI_TCPT_FLAG_TSO ) {
       ci_tcp_update_rtt(netif, ts,
                         ci_tcp_time_now(netif) - rxp->timestamp_echo);
     }
@@ -1584,7 +1723,10 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
 
     /* Open the congestion window. */
     ts->bytes_acked += acked;
-    ci_tcp_opencwnd(netif, ts);
+    if( CI_LIKELY( ci_tcp_cong_is_reno(ts) ) )
+      ci_tcp_opencwnd(netif, ts);
+    else
+      ci_tcp_cong_on_ack(netif, ts, acked);
 
     /* New acknowledgement clears any dup_acks. */
     ts->dup_acks = 0;
@@ -1595,6 +1737,10 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
     if( ts->congstate != CI_TCP_CONG_OPEN && ts->congstate != CI_TCP_CONG_NOTIFIED)
       /* Congested: try to recover. */
       ci_tcp_try_cwndrecover(ts, netif, pkt);
+    else if( (rxp->flags & CI_TCP_SACKED) && ci_tcp_rack_enabled(netif, ts) )
+      /* RACK can detect loss from any ACK bearing new SACK info, not just
+       * from a dupack. */
+      ci_tcp_maybe_enter_fast_recovery(netif, ts);
 
     if( NI_OPTS(netif).tcp_sndbuf_mode == 2 &&
 	ci_tcp_should_expand_sndbuf(netif, ts) )
@@ -1852,6 +1998,7 @@ static int ci_tcp_rx_deliver_rob(ci_netif* netif, ci_tcp_state* ts)
                 S_FMT(ts), OO_PP_FMT(id), seq,
                 pkt->pf.tcp_rx.end_seq));
       remove_from_last_sack(ts, id);
+      remove_from_rob_tail_block(ts, id);
       ci_tcp_rx_queue_dequeue(netif, ts, rob, pkt);
       if( OO_PP_EQ(id, end_block_id) )
         end_block_id = OO_PP_NULL;
@@ -1897,6 +2044,7 @@ static int ci_tcp_rx_deliver_rob(ci_netif* netif, ci_tcp_state* ts)
         /* We should not break from for(), because duplicates are possible
          * after arriving new segment which glued two blocks. */
   }
+  remove_from_rob_tail_block(ts, id);
 
   /* Deliver all the block (whilst looking out for FINs). */
   last_seq = tcp_rcv_nxt(ts);
@@ -2098,7 +2246,8 @@ void ci_tcp_rx_deliver2(ci_tcp_state* ts, ci_netif* netif,
  * should be the first packet of some block. If the first block can be
  * glued with next block(s), it will be done.  It is supposed that all next
  * blocks can't be glued with each other. It is supposed that 'pkt' block
- * is not covered by other blocks.
+ * is not covered by other blocks.  If 'pkt' block ends up last in the
+ * re-order buffer it becomes ts->rob_tail_block.
  */
 static void ci_tcp_rx_glue_rob(ci_netif* netif, ci_tcp_state* ts,
                                ci_ip_pkt_fmt* pkt)
@@ -2117,7 +2266,7 @@ static void ci_tcp_rx_glue_rob(ci_netif* netif, ci_tcp_state* ts,
     next_pkt = PKT_CHK(netif, next_id);
     last_seq = PKT_TCP_RX_ROB(pkt)->end_block_seq;
     if( SEQ_LT(last_seq, CI_BSWAP_BE32(PKT_IPX_TCP_HDR(af, next_pkt)->tcp_seq_be32)) )
-        return;
+        break;
     LOG_TV(log(LPF "ROB glue %d and %d blocks",
                OO_PKT_FMT(pkt), OO_PP_FMT(next_id)));
 
@@ -2176,7 +2325,9 @@ static void ci_tcp_rx_glue_rob(ci_netif* netif, ci_tcp_state* ts,
       }
     }
   }
-  return;
+
+  if( OO_PP_IS_NULL(PKT_TCP_RX_ROB(pkt)->next_block) )
+    ts->rob_tail_block = OO_PKT_P(pkt);
 }
 
 
@@ -2265,6 +2416,7 @@ static int ci_tcp_rx_enqueue_ooo(ci_netif* netif, ci_tcp_state* ts,
   ci_ip_pkt_fmt* prev_pkt = NULL;  /* \todo Initialize in debug build only */
   oo_pkt_p       block_id;
   ci_ip_pkt_fmt* block_pkt = NULL;  /* \todo Initialize in debug build only */
+  unsigned       walk = 0;
   int af = ipcache_af(&ts->s.pkt);
 
   /* When Onload recycles packets, it bumps rcv_nxt to the end of the recycled
@@ -2287,13 +2439,31 @@ static int ci_tcp_rx_enqueue_ooo(ci_netif* netif, ci_tcp_state* ts,
 
   ci_assert(OO_SP_IS_NULL(ts->local_peer));
   ci_assert(ci_ip_queue_is_valid(netif, rob));
-  for( prev_id = OO_PP_NULL, block_id = rob->head;
+
+  /* With a large window and heavy loss there can be many blocks, and a
+   * segment usually lands at or beyond the last one, so look there before
+   * walking the blocks from the head. */
+  prev_id = OO_PP_NULL;
+  block_id = rob->head;
+  if( OO_PP_NOT_NULL(ts->rob_tail_block) && ci_ip_queue_not_empty(rob) ) {
+    block_pkt = PKT_CHK(netif, ts->rob_tail_block);
+    ci_assert(OO_PP_IS_NULL(PKT_TCP_RX_ROB(block_pkt)->next_block));
+    if( SEQ_LT(CI_BSWAP_BE32(PKT_IPX_TCP_HDR(af, block_pkt)->tcp_seq_be32),
+               rxp->seq) ) {
+      prev_id = ts->rob_tail_block;
+      prev_pkt = block_pkt;
+      block_id = OO_PP_NULL;
+      ++ts->stats.rx_ooo_tail;
+    }
+  }
+
+  for( ;
        OO_PP_NOT_NULL(block_id) &&
        (block_pkt = PKT_CHK(netif, block_id),
         SEQ_LT(CI_BSWAP_BE32(PKT_IPX_TCP_HDR(af, block_pkt)->tcp_seq_be32),
                rxp->seq));
        prev_id = block_id, prev_pkt = block_pkt,
-       block_id = PKT_TCP_RX_ROB(block_pkt)->next_block ) {
+       block_id = PKT_TCP_RX_ROB(block_pkt)->next_block, ++walk ) {
 
     LOG_TV(log(LNT_FMT "OOO check: from %08x-%08x to %08x-%08x",
                LNT_PRI_ARGS(netif, ts),
@@ -2306,6 +2476,9 @@ static int ci_tcp_rx_enqueue_ooo(ci_netif* netif, ci_tcp_state* ts,
                OO_PP_NOT_NULL(block_id) ?
                  PKT_TCP_RX_ROB(block_pkt)->end_block_seq : 0));
   }
+  ts->stats.rx_ooo_walk += walk;
+  if( walk > ts->stats.rx_ooo_max_walk )
+    ts->stats.rx_ooo_max_walk = CI_MIN(walk, 0xffff);
 
   /* Check if the packet is subset of existing blocks */
   if( (OO_PP_NOT_NULL(prev_id) &&
@@ -2760,6 +2933,130 @@ static void handle_rx_synrecv_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
 }
 
 
+/* Accept a connection with the data in its SYN, the client having
+ * presented a valid TCP Fast Open cookie.  The new socket goes straight to
+ * the accept queue with the data on its receive queue.  Its SYN-ACK is sent
+ * from its retransmit queue, so that the RTO retransmits it in the same way
+ * as the SYN of an active open.
+ *
+ * Returns 0 if the packet was consumed, or -ve if the caller should answer
+ * the SYN in the usual way; [tsr] is then still on the listen queue.
+ */
+static int handle_rx_listen_fastopen(ci_netif* netif,
+                                     ci_tcp_socket_listen* tls,
+                                     ci_tcp_state_synrecv* tsr,
+                                     ciip_tcp_rx_pkt* rxp,
+                                     ci_ip_cached_hdrs* ipcache)
+{
+  ci_ip_pkt_fmt* pkt = rxp->pkt;
+  ci_ip_pkt_fmt* tx_pkt;
+  ci_tcp_state* ts;
+  ci_uint32 isn = tsr->snd_isn;
+  int pay_len = pkt->pf.tcp_rx.pay_len;
+  int rc;
+
+  tx_pkt = ci_netif_pkt_alloc(netif, 0);
+  if( tx_pkt == NULL )
+    return -ENOBUFS;
+  rc = ci_tcp_listenq_try_promote(netif, tls, tsr, ipcache, pkt, &ts);
+  if( rc < 0 ) {
+    ci_netif_pkt_release(netif, tx_pkt);
+    return rc;
+  }
+
+  /* Promotion assumes that our SYN has been ACKed, so take it back into
+   * the sequence space.  A SYN's window is never scaled. */
+  tcp_snd_una(ts) = tcp_snd_nxt(ts) = tcp_enq_nxt(ts) = tcp_snd_up(ts) = isn;
+  ci_tcp_set_snd_max(ts, rxp->seq, tcp_snd_una(ts), pkt->pf.tcp_rx.window);
+
+  /* Deliver the data first so that the SYN-ACK ACKs it. */
+  if( ci_tcp_is_pluginized(ts) ) {
+    /* The plugin has not seen the SYN's payload; the client will
+     * retransmit it once the SYN-ACK fails to ACK it. */
+    ci_netif_pkt_release_rx(netif, pkt);
+  }
+  else {
+    ci_assert(SEQ_EQ(tcp_rcv_nxt(ts), rxp->seq + 1));
+    oo_offbuf_init(&pkt->buf, CI_TCP_PAYLOAD(rxp->tcp), pay_len);
+    ci_tcp_rx_enqueue_packet(netif, ts, pkt);
+    ci_tcp_wake(netif, ts, CI_SB_FLAG_WAKE_RX);
+  }
+
+  ci_tcp_set_flags(ts, CI_TCP_FLAG_SYN | CI_TCP_FLAG_ACK);
+  ci_tcp_enqueue_no_data(ts, netif, tx_pkt);
+  ci_tcp_set_flags(ts, CI_TCP_FLAG_ACK);
+
+  LOG_TC(log(LNTS_FMT "TFO accepted %d bytes in SYN",
+             LNTS_PRI_ARGS(netif, ts), pay_len));
+  CITP_STATS_NETIF_INC(netif, tfo_passive);
+  CI_TCP_STATS_INC_PASSIVE_OPENS(netif);
+  return 0;
+}
+
+
+/* Handle a segment for the compact TIME_WAIT entry [tw] as it would be for
+ * a full endpoint in TIME_WAIT.  Returns true if the segment was consumed,
+ * or false if it is a SYN that may start a new connection on the
+ * four-tuple, in which case [tw] has been freed.
+ */
+static int /*bool*/ handle_rx_listen_tw_compact(ci_netif* netif,
+                                                ci_tcp_socket_listen* tls,
+                                                ciip_tcp_rx_pkt* rxp,
+                                                ci_tcp_tw_compact_t* tw)
+{
+  ci_ip_pkt_fmt* pkt = rxp->pkt;
+  ci_uint8 flags = rxp->tcp->tcp_flags & CI_TCP_FLAG_MASK;
+
+  if( flags & CI_TCP_FLAG_RST ) {
+    /* As for a full endpoint in TIME_WAIT, a RST at exactly rcv_nxt may
+     * assassinate the connection unless EF_TCP_TIME_WAIT_ASSASSINATION is
+     * off (RFC1337), and other RSTs are ignored.  The entry lives for 2MSL
+     * at most, so PAWS needs no idle timeout.  A full endpoint sends a
+     * challenge ACK for a RST elsewhere in its window; we have no window
+     * scale to tell, so we don't. */
+    if( SEQ_EQ(rxp->seq, tw->rcv_nxt) &&
+        NI_OPTS(netif).time_wait_assassinate &&
+        ! (tw->tso && (rxp->flags & CI_TCPT_FLAG_TSO) &&
+           TIME_LT(rxp->timestamp, tw->tsrecent)) ) {
+      LOG_TC(log(LNT_FMT "compact TIME_WAIT reset",
+                 LNT_PRI_ARGS(netif, tls)));
+      tw->lport_be16 = 0;
+    }
+    else {
+      CITP_STATS_NETIF_INC(netif, rst_recv_unacceptable);
+    }
+    ci_netif_pkt_release_rx(netif, pkt);
+    return 1;
+  }
+  else if( flags == CI_TCP_FLAG_SYN ) {
+    /* A new incarnation may begin beyond the end of the old one, or, with
+     * timestamps, once the peer's clock has moved on (RFC6191). */
+    if( SEQ_GT(rxp->seq, tw->rcv_nxt) ||
+        (tw->tso && (rxp->flags & CI_TCPT_FLAG_TSO) &&
+         (ci_int32) (rxp->timestamp - tw->tsrecent) > 0) ) {
+      LOG_TC(log(LNT_FMT "compact TIME_WAIT reused by SYN",
+                 LNT_PRI_ARGS(netif, tls)));
+      tw->lport_be16 = 0;
+      CITP_STATS_NETIF_INC(netif, tcp_tw_compact_reuse);
+      return 0;
+    }
+  }
+  else if( (~flags & CI_TCP_FLAG_FIN) && pkt->pf.tcp_rx.pay_len == 0 ) {
+    /* Nothing to acknowledge. */
+    ci_netif_pkt_release_rx(netif, pkt);
+    return 1;
+  }
+  else if( flags & CI_TCP_FLAG_FIN ) {
+    /* Our last ACK was lost, so wait for this one to get through. */
+    tw->expiry = ci_ip_time_now(netif) + NI_CONF(netif).tconst_2msl_time;
+  }
+
+  CITP_STATS_NETIF_INC(netif, tcp_tw_compact_acks);
+  ci_tcp_reply_from_tw_compact(netif, &tls->s.cp, rxp, tw);
+  return 1;
+}
+
+
 /*
 ** This function is assumed to be called when a SYN packet is routed
 ** to a listening socket it:
@@ -2778,6 +3075,7 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
   ci_ipx_hdr_t* ip = RX_PKT_IPX_HDR(pkt);
   ci_tcp_hdr* tcp = rxp->tcp;
   ci_tcp_state_synrecv* tsr;
+  ci_tcp_state_synrecv tsr_cookie;
   ci_ip_cached_hdrs ipcache;
   oo_sp local_peer = OO_SP_NULL;
   int do_syncookie = 0;
@@ -2819,6 +3117,19 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
   if (!already_parsed)
     ci_tcp_parse_options(netif, rxp, NULL);
 
+  /* Segments for a connection whose TIME_WAIT has been compacted arrive
+   * here, as it no longer has a filter of its own. */
+  if( netif->state->tw_table_entries_n != 0 &&
+      ! IS_AF_INET6(oo_pkt_af(pkt)) ) {
+    ci_tcp_tw_compact_t* tw;
+    tw = ci_tcp_tw_compact_lookup(netif, oo_ip_hdr(pkt)->ip_daddr_be32,
+                                  tcp->tcp_dest_be16,
+                                  oo_ip_hdr(pkt)->ip_saddr_be32,
+                                  tcp->tcp_source_be16);
+    if( tw != NULL && handle_rx_listen_tw_compact(netif, tls, rxp, tw) )
+      return;
+  }
+
   if( CI_UNLIKELY(tcp->tcp_flags & CI_TCP_FLAG_RST) ) {
     handle_rx_listen_rst(netif, tls, rxp);
     return;
@@ -3083,27 +3394,16 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
       goto ignore_pkt;
   }
 
-  /* It is legal to pass data with a SYN, but it is not desirable to keep
-  ** the data because it provides a simple way to do a DOS.  So we bin the
-  ** data, and the other end can retransmit it.
-  */
-  if( pkt->pf.tcp_rx.pay_len ) {
-    LOG_U(log(LPF "%d LISTEN SYN with data (%d bytes)", S_FMT(tls),
-          pkt->pf.tcp_rx.pay_len));
-    LOG_DU(ci_hex_dump(ci_log_fn, PKT_START(pkt),
-                       ip_pkt_dump_len(RX_PKT_PAYLOAD_LEN(pkt)),
-		       0));
-  }
-
   /* Drop segment if it has a FIN. */
   if( tcp->tcp_flags & CI_TCP_FLAG_FIN ) {
     LOG_U(log(LPF "%d LISTEN got segment with FIN, will drop", S_FMT(tls)));
     goto freepkt_out;
   }
 
-  /* Allocate synrecv. */
+  /* Allocate synrecv.  A syncookie SYN needs it only until the SYN-ACK has
+   * been sent, so don't go to the heap for it. */
   if( do_syncookie ) {
-    tsr = ci_alloc(sizeof(ci_tcp_state_synrecv));
+    tsr = &tsr_cookie;
   }
   else {
     /* We've already called ci_ni_aux_can_alloc() above, so we are sure
@@ -3115,6 +3415,8 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
     tsr->hash = rxp->hash;
   }
 
+  tsr->fastopen = 0;
+
   /* parse the SYN options */
   memset(&tsr->tcpopts, 0, sizeof(tsr->tcpopts));
   tsr->tcpopts.smss = CI_CFG_TCP_DEFAULT_MSS;
@@ -3129,9 +3431,7 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
 #if CI_CFG_TCP_INVALID_OPT_RST
     /* bad option block, send reset rfc1122 4.2.2.5 */
     LOG_U(log(LPF "%d LISTEN bad SYN options will reset", S_FMT(tls)));
-    if( do_syncookie )
-      ci_free(tsr);
-    else
+    if( !do_syncookie )
       ci_tcp_synrecv_free(netif, tsr);
     CITP_STATS_NETIF_INC(netif, rst_sent_bad_options);
     goto reset_out;
@@ -3142,6 +3442,20 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
   if( tsr->tcpopts.flags & CI_TCPT_FLAG_TSO )
     tsr->tspeer = rxp->timestamp;
 
+  /* It is legal to pass data with a SYN, but it is not desirable to keep
+  ** the data because it provides a simple way to do a DOS.  So we bin the
+  ** data, and the other end can retransmit it.  The exception is a SYN
+  ** with a valid TCP Fast Open cookie, handled below; the options have
+  ** been parsed by now, so rxp->flags tells whether it has one.
+  */
+  if( pkt->pf.tcp_rx.pay_len && ~rxp->flags & CI_TCP_FASTOPEN ) {
+    LOG_U(log(LPF "%d LISTEN SYN with data (%d bytes)", S_FMT(tls),
+          pkt->pf.tcp_rx.pay_len));
+    LOG_DU(ci_hex_dump(ci_log_fn, PKT_START(pkt),
+                       ip_pkt_dump_len(RX_PKT_PAYLOAD_LEN(pkt)),
+		       0));
+  }
+
   if( !do_syncookie ) {
     if( ! ci_tcp_can_stripe(netif, ip->ip4.ip_daddr_be32,ip->ip4.ip_saddr_be32) )
       tsr->tcpopts.flags &=~ CI_TCPT_FLAG_STRIPE;
@@ -3174,8 +3488,10 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
     tsr->rcv_wscl = 0;
   }
 
-  if( do_syncookie )
+  if( do_syncookie ) {
     ci_tcp_syncookie_syn(netif, tls, tsr);
+    CITP_STATS_NETIF(++netif->state->stats.listen2syncookie);
+  }
   else {
     tsr->snd_isn = ci_tcp_initial_seqno(netif, tsr->l_addr, tsr->l_port,
                                         tsr->r_addr, tsr->r_port);
@@ -3183,6 +3499,24 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
     /* Insert synrecv into the listen queue. */
     ci_tcp_listenq_insert(netif, tls, tsr);
     CITP_STATS_NETIF(++netif->state->stats.listen2synrecv);
+
+    /* TCP Fast Open: accept the data in the SYN if the client has a valid
+     * cookie, and otherwise give it one for next time.  Syncookies and
+     * loopback connections don't get here. */
+    if( (NI_OPTS(netif).tcp_fastopen & EF_TCP_FASTOPEN_SERVER) &&
+        tls->c.fastopen_qlen != 0 && (rxp->flags & CI_TCP_FASTOPEN) &&
+        OO_SP_IS_NULL(tsr->local_peer) && ! CI_IS_ADDR_IP6(tsr->r_addr) ) {
+      if( pkt->pf.tcp_rx.pay_len != 0 ) {
+        if( ci_tcp_acceptq_n(tls) < tls->c.fastopen_qlen &&
+            ci_tcp_fastopen_cookie_ok(netif, tsr->l_addr.ip4,
+                                      tsr->r_addr.ip4, rxp) &&
+            handle_rx_listen_fastopen(netif, tls, tsr, rxp, &ipcache) == 0 )
+          return;
+        CITP_STATS_NETIF_INC(netif, tfo_passive_fail);
+      }
+      tsr->fastopen = 1;
+      CITP_STATS_NETIF_INC(netif, tfo_cookie_sent);
+    }
   }
 
   LOG_TC(if( tsr->amss == 0 ) tsr->amss = netif->state->max_mss;
@@ -3223,8 +3557,6 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
     ci_netif_pkt_release(netif, pkt);
   }
 
-  if( do_syncookie )
-    ci_free(tsr);
   return;
 
  ignore_pkt:
@@ -3334,11 +3666,44 @@ static int handle_syn_sent_opts(ci_netif* netif, ci_tcp_state* ts,
 }
 
 
+/* The server has ACKed our SYN but not all the data we sent with it, so our
+ * TCP Fast Open cookie was refused.  Turn the SYN into a data segment with
+ * what remains, to be retransmitted once we are established.  The headers
+ * have already been set up for the established connection.
+ */
+static void ci_tcp_fastopen_syn_to_data(ci_netif* netif, ci_tcp_state* ts,
+                                        ci_ip_pkt_fmt* pkt, ci_uint32 ack)
+{
+  int af = ipcache_af(&ts->s.pkt);
+  ci_tcp_hdr* tcp = TX_PKT_IPX_TCP(af, pkt);
+  int n = SEQ_SUB(pkt->pf.tcp_tx.end_seq, ack);
+  int hdr_len = sizeof(ci_tcp_hdr) + tcp_ipx_outgoing_opts_len(af, ts);
+  char* data = (char*) tcp + CI_TCP_HDR_LEN(tcp) +
+               SEQ_SUB(ack, pkt->pf.tcp_tx.start_seq + 1);
+
+  ci_assert(tcp->tcp_flags & CI_TCP_FLAG_SYN);
+  ci_assert(~pkt->flags & CI_PKT_FLAG_TX_PENDING);
+  ci_assert_gt(n, 0);
+
+  memmove((char*) tcp + hdr_len, data, n);
+  CI_TCP_HDR_SET_LEN(tcp, hdr_len);
+  tcp->tcp_flags = CI_TCP_FLAG_ACK | CI_TCP_FLAG_PSH;
+  pkt->buf_len = pkt->pay_len = (char*) tcp + hdr_len + n - PKT_START(pkt);
+  oo_offbuf_init(&pkt->buf, PKT_START(pkt) + pkt->buf_len, 0);
+  pkt->pf.tcp_tx.start_seq = ack;
+
+  LOG_TC(log(LNTS_FMT "TFO cookie refused, %d bytes to retransmit",
+             LNTS_PRI_ARGS(netif, ts), n));
+  CITP_STATS_NETIF_INC(netif, tfo_active_fail);
+}
+
+
 static void handle_rx_syn_sent(ci_netif* netif, ci_tcp_state* ts,
                                ciip_tcp_rx_pkt* rxp)
 {
   ci_ip_pkt_fmt* pkt = rxp->pkt;
   ci_tcp_hdr* tcp = rxp->tcp;
+  ci_ip_pkt_fmt* syn_pkt = NULL;
 
   /* RST handled elsewhere; we shouldn't see it here. */
   ci_assert(~tcp->tcp_flags & CI_TCP_FLAG_RST);
@@ -3412,6 +3777,23 @@ static void handle_rx_syn_sent(ci_netif* netif, ci_tcp_state* ts,
     goto free_out;
   }
 
+  /* Did the server refuse data we sent in the SYN?  If so, we rewrite the
+  ** SYN as a data segment, which we can't do while it is being sent.
+  ** That's very unlikely a round-trip later, and the server will
+  ** retransmit its SYN-ACK.
+  */
+  syn_pkt = PKT_CHK(netif, ts->retrans.head);
+  if( SEQ_LT(rxp->ack, syn_pkt->pf.tcp_tx.end_seq) ) {
+    if( syn_pkt->flags & CI_PKT_FLAG_TX_PENDING ) {
+      LOG_U(log(LPF "%d SYN-SENT TFO SYN still in flight (binned)",
+                S_FMT(ts)));
+      goto free_out;
+    }
+  }
+  else {
+    syn_pkt = NULL;
+  }
+
   /* we have an acceptable SYN/ACK here so we need to transition to
   ** established and setup any negotiated options.
   ** We need to parse options before ci_tcp_rx_handle_ack(),
@@ -3420,6 +3802,19 @@ static void handle_rx_syn_sent(ci_netif* netif, ci_tcp_state* ts,
 
   if( handle_syn_sent_opts(netif, ts, rxp) < 0 ) return;
 
+  /* Remember a TCP Fast Open cookie for next time. */
+  if( (rxp->flags & CI_TCP_FASTOPEN) &&
+      (NI_OPTS(netif).tcp_fastopen & EF_TCP_FASTOPEN_CLIENT) &&
+      ipcache_af(&ts->s.pkt) == AF_INET &&
+      rxp->fastopen_len >= CI_TCP_FASTOPEN_COOKIE_MIN &&
+      rxp->fastopen_len <= CI_TCP_FASTOPEN_COOKIE_CACHE_MAX )
+    ci_tcp_fastopen_cache_update(netif, ts->s.pkt.ipx.ip4.ip_daddr_be32,
+                                 ts->smss, rxp->fastopen_cookie,
+                                 rxp->fastopen_len);
+
+  if( syn_pkt != NULL )
+    ci_tcp_fastopen_syn_to_data(netif, ts, syn_pkt, rxp->ack);
+
   /* remove SYN (and any sent data) from retransmission queue
   ** and seed RTT */
   ci_assert(tcp->tcp_flags & CI_TCP_FLAG_ACK);
@@ -3488,8 +3883,15 @@ set_isn:
              S_FMT(ts), RCV_WND_ARGS(ts),
              tcp_snd_una(ts), tcp_snd_nxt(ts), ts->snd_max, tcp_enq_nxt(ts)));
 
-  /* Send any data that was enqueued in advance. */
-  if( ci_tcp_sendq_not_empty(ts) ) {
+  /* Retransmit the data refused in the SYN, then send any data that was
+   * enqueued in advance. */
+  if( syn_pkt != NULL ) {
+    ci_tcp_retrans_one(ts, netif, syn_pkt);
+    ci_netif_pkt_release_rx(netif, pkt);
+    if( ci_tcp_sendq_not_empty(ts) )
+      ci_tcp_tx_advance(ts, netif);
+  }
+  else if( ci_tcp_sendq_not_empty(ts) ) {
     ci_netif_pkt_release_rx(netif, pkt);
     ci_tcp_tx_advance(ts, netif);
   }
@@ -4670,6 +5072,9 @@ int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
   pkt->pf.tcp_rx.pay_len -= ts->incoming_tcp_hdr_len;
   pkt->pf.tcp_rx.end_seq = rxp->seq + pkt->pf.tcp_rx.pay_len;
 
+  ci_tcp_flight_record(ni, ts, CI_TCP_FLIGHT_RX, tcp->tcp_flags,
+                       pkt->pf.tcp_rx.pay_len, rxp->seq, rxp->ack);
+
 #if CI_CFG_BURST_CONTROL
   ts->burst_window = 0;
 #endif
@@ -4761,6 +5166,11 @@ int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
                    pkt->pf.tcp_rx.pay_len);
     ci_tcp_rx_enqueue_packet(ni, ts, pkt);
 
+    if( rxp->poll_state != NULL ) {
+      rxp->poll_state->tcp_rx_last_sock = S_SP(ts);
+      rxp->poll_state->tcp_rx_last_intf_i = pkt->intf_i;
+      rxp->poll_state->tcp_rx_last_vlan = pkt->vlan;
+    }
     rxp->pkt = NULL;
 
     return 1;  /* finished -- don't deliver to any other socket */
@@ -4964,6 +5374,30 @@ void ci_tcp_handle_rx(ci_netif* netif, struct ci_netif_poll_state* ps,
   else
 #endif
   {
+    if( ps != NULL && OO_SP_NOT_NULL(ps->tcp_rx_last_sock) &&
+        ps->tcp_rx_last_intf_i == pkt->intf_i &&
+        ps->tcp_rx_last_vlan == pkt->vlan ) {
+      /* Same interface as the last fast-path segment in this poll.  If it
+       * is also the same flow then the filter table would find the same
+       * socket, so skip it.  The socket is re-checked each time, as it may
+       * have been closed or reused since.
+       */
+      ci_sock_cmn* s = SP_TO_SOCK(netif, ps->tcp_rx_last_sock);
+      if( (s->b.state & (CI_TCP_STATE_TCP_CONN | CI_TCP_STATE_ACCEPT_DATA)) ==
+            (CI_TCP_STATE_TCP_CONN | CI_TCP_STATE_ACCEPT_DATA) &&
+          ! ipcache_is_ipv6(&s->pkt) &&
+          ((ip4->ip_daddr_be32 ^ sock_laddr_be32(s)) |
+           (ip4->ip_saddr_be32 ^ sock_raddr_be32(s)) |
+           (tcp->tcp_dest_be16 ^ sock_lport_be16(s)) |
+           (tcp->tcp_source_be16 ^ sock_rport_be16(s))) == 0 &&
+          sock_protocol(s) == IPPROTO_TCP ) {
+        CITP_STATS_NETIF_INC(netif, rx_tcp_flow_hit);
+        ci_tcp_rx_deliver_to_conn(s, &rxp);
+        ci_assert(rxp.pkt == NULL);
+        return;
+      }
+    }
+
     ci_netif_filter_for_each_match(netif,
                                    ip4->ip_daddr_be32, tcp->tcp_dest_be16,
                                    ip4->ip_saddr_be32, tcp->tcp_source_be16,
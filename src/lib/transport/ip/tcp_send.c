@@ -19,7 +19,7 @@
 #include <ci/internal/crc_offload_prefix.h>
 
 #if CI_CFG_NVME_LOCAL_CRC_MODE
-#include "crc32c.h"
+#include <ci/tools/crc32c.h>
 #endif
 
 #if !defined(__KERNEL__)
@@ -76,6 +76,45 @@ struct tcp_send_info {
 };
 
 
+/* Autocorking, for sockets with Nagle disabled (EF_TCP_AUTOCORK_US).
+ * Returns true if the small segment [pkt] at the head of the send queue
+ * should be held back because the previous segment sent on this socket is
+ * still waiting for the NIC to complete it: sending now would only queue
+ * behind it, and by holding on later sends can be added to this segment.
+ * The socket's post-poll pushes it out once the stack has handled its next
+ * events, which will include that completion, as does the ACK of the
+ * previous segment.  Should neither come, because nothing polls the
+ * stack, the cork timer bounds the wait.
+ */
+static int ci_tcp_tx_autocork(ci_netif* ni, ci_tcp_state* ts,
+                              ci_ip_pkt_fmt* pkt)
+{
+  ci_uint32 now_us;
+
+  if( NI_OPTS(ni).tcp_autocork_us == 0 ||
+      ci_ip_queue_is_empty(&ts->retrans) ||
+      ! (PKT_CHK(ni, ts->retrans.tail)->flags & CI_PKT_FLAG_TX_PENDING) )
+    return 0;
+
+  ci_ip_time_get_us(IPTIMER_STATE(ni), &now_us);
+  if( ts->autocork_seq != pkt->pf.tcp_tx.start_seq ) {
+    ts->autocork_seq = pkt->pf.tcp_tx.start_seq;
+    ts->autocork_us = now_us;
+    if( ! ci_ip_timer_pending(ni, &ts->cork_tid) )
+      ci_ip_timer_set(ni, &ts->cork_tid, ci_tcp_time_now(ni) +
+                      ci_tcp_time_ms2ticks(ni, (NI_OPTS(ni).tcp_autocork_us +
+                                                999) / 1000));
+  }
+  else if( now_us - ts->autocork_us >= NI_OPTS(ni).tcp_autocork_us ) {
+    return 0;
+  }
+
+  ts->s.b.sb_flags |= CI_SB_FLAG_TCP_POST_POLL;
+  ci_netif_put_on_post_poll(ni, &ts->s.b);
+  return 1;
+}
+
+
 static void ci_tcp_tx_advance_nagle(ci_netif* ni, ci_tcp_state* ts)
 {
   /* Nagle's algorithm (rfc896).  Summary: when user pushes data, don't
@@ -115,6 +154,14 @@ static void ci_tcp_tx_advance_nagle(ci_netif* ni, ci_tcp_state* ts)
     goto advance_now;
 
   if( ts->s.s_aflags & CI_SOCK_AFLAG_NODELAY ) {
+    if( ci_tcp_tx_autocork(ni, ts, pkt) ) {
+      LOG_TV(log(LPF "%d autocork enq=%08x pkt=%x-%x", S_FMT(ts),
+                 tcp_enq_nxt(ts), pkt->pf.tcp_tx.start_seq,
+                 pkt->pf.tcp_tx.end_seq));
+      ++ts->stats.tx_stop_autocork;
+      goto poll_and_out;
+    }
+
     /* With nagle off it is possible for a sender to push zillions of tiny
      * packets onto the network, which consumes loads of memory.  To
      * prevent this we choose not to advance if many packets are already
@@ -507,6 +554,58 @@ void ci_tcp_tmpl_handle_nic_reset(ci_netif* ni)
 }
 
 
+/* Move the PIO regions of templates on [intf_i] so that free space can
+ * coalesce.  Templates that are on a socket's list are not being
+ * transmitted, and their packet buffers hold a copy of everything written
+ * to the PIO region, so they can be copied to their new place.  Returns true
+ * if anything moved.
+ *
+ * Must be called with the stack lock held.
+ */
+static int ci_tcp_tmpl_pio_compact(ci_netif* ni, int intf_i)
+{
+  ci_pio_buddy_allocator* b = &ni->state->nic[intf_i].pio_buddy;
+  int moved = 0, pass_moved;
+  ci_int32 to;
+  unsigned i;
+
+  ci_assert(ci_netif_is_locked(ni));
+  if( ! (ni->state->nic[intf_i].oo_vi_flags & OO_VI_FLAGS_PIO_EN) )
+    return 0;
+
+  /* Each move can enable another at the next order up. */
+  do {
+    pass_moved = ci_pio_buddy_compact_reserved(ni, b);
+    for( i = 0; i < ni->state->n_ep_bufs &&
+                ci_pio_buddy_can_compact(ni, b); ++i ) {
+      citp_waitable_obj* wo = SP_TO_WAITABLE_OBJ(ni, i);
+      citp_waitable* w = &wo->waitable;
+      ci_tcp_state* ts = &wo->tcp;
+      oo_pkt_p pp;
+
+      if( ! ((w->state & CI_TCP_STATE_TCP_CONN) || w->state == CI_TCP_CLOSED) )
+        continue;
+      for( pp = ts->tmpl_head; OO_PP_NOT_NULL(pp); ) {
+        ci_ip_pkt_fmt* tmpl = PKT_CHK(ni, pp);
+        pp = tmpl->next;
+        if( tmpl->intf_i != intf_i || tmpl->pio_addr < 0 )
+          continue;
+        to = ci_pio_buddy_relocate(ni, b, tmpl->pio_addr, tmpl->pio_order);
+        if( to != tmpl->pio_addr ) {
+          CI_DEBUG_TRY(ef_pio_memcpy(ci_netif_vi(ni, intf_i), PKT_START(tmpl),
+                                     to, tmpl->buf_len));
+          tmpl->pio_addr = to;
+          pass_moved = 1;
+        }
+      }
+    }
+    moved |= pass_moved;
+  } while( pass_moved && ci_pio_buddy_can_compact(ni, b) );
+
+  return moved;
+}
+
+
 /* Remove this template from the socket's template list.
  */
 static void ci_tcp_tmpl_remove(ci_netif* ni, ci_tcp_state* ts,
@@ -547,23 +646,64 @@ static void ci_tcp_tmpl_free(ci_netif* ni, ci_tcp_state* ts,
 }
 
 
+
 /* Frees all of the socket's templates.
  *
  * Must be called with the stack lock held.
  */
 void ci_tcp_tmpl_free_all(ci_netif* ni, ci_tcp_state* ts)
 {
+  ci_uint32 released = 0;
+  int intf_i;
+
   ci_assert(ci_netif_is_locked(ni));
   while( OO_PP_NOT_NULL(ts->tmpl_head) ) {
     ci_ip_pkt_fmt* tmpl = PKT_CHK(ni, ts->tmpl_head);
     ts->tmpl_head = tmpl->next;
+    if( tmpl->pio_addr >= 0 )
+      released |= 1u << tmpl->intf_i;
     ci_tcp_tmpl_free(ni, ts, tmpl, 0);
   }
+  OO_STACK_FOR_EACH_INTF_I(ni, intf_i) {
+    ci_pio_buddy_allocator* b = &ni->state->nic[intf_i].pio_buddy;
+    if( ci_pio_buddy_unreserve(ni, b, S_SP(ts)) )
+      released |= 1u << intf_i;
+    if( released & (1u << intf_i) )
+      ci_tcp_tmpl_pio_compact(ni, intf_i);
+  }
 }
 
 
 #ifndef __KERNEL__
 
+/* Allocate a PIO region for [tmpl] of at least 1 << tmpl->pio_order bytes,
+ * from [ts]'s reservation if [reserve].  If the region is too fragmented,
+ * compact it and try again.  Sets tmpl->pio_addr to -1 on failure.
+ */
+static void ci_tcp_tmpl_pio_alloc(ci_netif* ni, ci_tcp_state* ts,
+                                  ci_ip_pkt_fmt* tmpl, int reserve)
+{
+  ci_pio_buddy_allocator* b = &ni->state->nic[tmpl->intf_i].pio_buddy;
+  ci_uint8 order = tmpl->pio_order;
+  int retried = 0;
+
+  while( 1 ) {
+    if( reserve )
+      tmpl->pio_addr = ci_pio_buddy_alloc_reserved(ni, b, S_SP(ts), &order);
+    else
+      tmpl->pio_addr = ci_pio_buddy_alloc(ni, b, order);
+    if( tmpl->pio_addr >= 0 ) {
+      tmpl->pio_order = order;
+      return;
+    }
+    if( retried || ! ci_tcp_tmpl_pio_compact(ni, tmpl->intf_i) )
+      break;
+    retried = 1;
+  }
+  tmpl->pio_addr = -1;
+}
+
+
 static ci_ip_pkt_fmt* ci_tcp_tmpl_omt_to_pkt(struct oo_msg_template* omt)
 {
   return (void*) ((char*) omt - ci_tcp_tmpl_offset());
@@ -656,7 +796,8 @@ int ci_tcp_tmpl_alloc(ci_netif* ni, ci_tcp_state* ts,
   /* This is needed to ensure that an app written to a later version of the
    * API gets an error if they try to use a flag we don't understand.
    */
-  if(CI_UNLIKELY( flags & ~ONLOAD_TEMPLATE_FLAGS_PIO_RETRY )) {
+  if(CI_UNLIKELY( flags & ~(ONLOAD_TEMPLATE_FLAGS_PIO_RETRY |
+                            ONLOAD_TEMPLATE_FLAGS_PIO_RESERVE) )) {
     LOG_E(ci_log("%s: called with unsupported flags=%x", __FUNCTION__, flags));
     return -EINVAL;
   }
@@ -768,9 +909,9 @@ int ci_tcp_tmpl_alloc(ci_netif* ni, ci_tcp_state* ts,
   pkt->intf_i = intf_i;
   pkt->pio_order = ci_log2_ge(ts->outgoing_hdrs_len + ETH_HLEN + ETH_VLAN_HLEN
                               + total_unsent, CI_CFG_MIN_PIO_BLOCK_ORDER);
-  pkt->pio_addr = ci_pio_buddy_alloc(ni, &nsn->pio_buddy, pkt->pio_order);
+  ci_tcp_tmpl_pio_alloc(ni, ts, pkt,
+                        flags & ONLOAD_TEMPLATE_FLAGS_PIO_RESERVE);
   if( pkt->pio_addr < 0 ) {
-    pkt->pio_addr = -1;
     if( ! (flags & ONLOAD_TEMPLATE_FLAGS_PIO_RETRY) ) {
       ci_netif_pkt_release_1ref(ni, pkt);
       --(ni->state->n_async_pkts);
@@ -851,11 +992,24 @@ int ci_tcp_tmpl_alloc(ci_netif* ni, ci_tcp_state* ts,
 }
 
 
-int
-ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
-                   struct oo_msg_template* omt,
-                   const struct onload_template_msg_update_iovec* updates,
-                   int ulen, unsigned flags)
+/* Outcomes of ci_tcp_tmpl_update_prep(). */
+#define CI_TCP_TMPL_DONE    0  /* Finished, with result in *rc_out */
+#define CI_TCP_TMPL_STAGED  1  /* Ready for ci_tcp_tmpl_post() */
+#define CI_TCP_TMPL_NORMAL  2  /* Needs __ci_tcp_tmpl_normal_send() */
+
+/* Apply the updates to a template and, if it is to be sent now and the
+ * fast path is available, do everything needed to send it except for
+ * pushing it to the adapter.  That is left to ci_tcp_tmpl_post(), so that
+ * several templates can be prepared and then posted back-to-back.
+ *
+ * [tx_staged] counts, per interface, the templates already staged but not
+ * yet posted, so that we do not stage more than the TXQ has room for.
+ */
+static int
+ci_tcp_tmpl_update_prep(ci_netif* ni, ci_tcp_state* ts,
+                        struct oo_msg_template* omt,
+                        const struct onload_template_msg_update_iovec* updates,
+                        int ulen, unsigned flags, int* tx_staged, int* rc_out)
 {
   /* XXX: In fast path, check if need to update ack.  If send next is
    * what we expect it to be, we are in fast path.  We should save
@@ -879,10 +1033,11 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
   if(CI_UNLIKELY( flags & ~(ONLOAD_TEMPLATE_FLAGS_SEND_NOW |
                             ONLOAD_TEMPLATE_FLAGS_DONTWAIT) )) {
     LOG_E(ci_log("%s: called with unsupported flags=%x", __FUNCTION__, flags));
-    return -EINVAL;
+    *rc_out = -EINVAL;
+    return CI_TCP_TMPL_DONE;
   }
 
-  ci_netif_lock(ni);
+  ci_assert(ci_netif_is_locked(ni));
 
   ipcache = &ts->s.pkt;
   pkt = ci_tcp_tmpl_omt_to_pkt(omt);
@@ -911,17 +1066,12 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
 
   if(CI_UNLIKELY( pkt->pio_addr == -1 &&
                   ! (flags & ONLOAD_TEMPLATE_FLAGS_SEND_NOW) )) {
-    pkt->pio_addr =
-      ci_pio_buddy_alloc(ni, &ni->state->nic[pkt->intf_i].pio_buddy,
-                         pkt->pio_order);
+    ci_tcp_tmpl_pio_alloc(ni, ts, pkt, 0);
     if( pkt->pio_addr >= 0 ) {
       rc = ef_pio_memcpy(vi, PKT_START(pkt),
                          pkt->pio_addr, pkt->buf_len);
       ci_assert(rc == 0);
     }
-    else {
-      pkt->pio_addr = -1;
-    }
   }
 
   /* Apply requested updates.
@@ -975,9 +1125,8 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
     /* We didn't get a PIO region.  This can happen due to various
      * reasons including a NIC reset while the template was allocated
      * or we never had one to start with so use normal send.
-     * __ci_tcp_tmpl_normal_send() releases the lock.
      */
-    return __ci_tcp_tmpl_normal_send(ni, ts, pkt, sinf, flags);
+    return CI_TCP_TMPL_NORMAL;
   }
   else if( cplane_is_valid ) {
     /* The pkt doesn't have the right cplane info but the socket does.
@@ -999,14 +1148,14 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
     ci_assert_equal(rc, 0);
   }
   else {
-    /* We could not get mac info, do a normal send.
-     * __ci_tcp_tmpl_normal_send() releases the lock. */
-    return __ci_tcp_tmpl_normal_send(ni, ts, pkt, sinf, flags);
+    /* We could not get mac info, do a normal send. */
+    return CI_TCP_TMPL_NORMAL;
   }
 
   ci_assert_ge(pkt->pio_addr, 0);
 
-  if( ci_ip_queue_is_empty(&ts->send) && ef_vi_transmit_space(vi) > 0 &&
+  if( ci_ip_queue_is_empty(&ts->send) &&
+      ef_vi_transmit_space(vi) > tx_staged[pkt->intf_i] &&
       ci_tcp_inflight(ts) + ts->smss < CI_MIN(ts->cwnd, tcp_snd_wnd(ts)) ) {
     /* Sendq is empty, TXQ is not full, and send window allows us to
      * send the requested amount of data, so go ahead and send
@@ -1045,46 +1194,132 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
                        (char*)TX_PKT_IPX_TCP(af, pkt));
     ci_assert_equal(rc, 0);
 
-    /* This cannot fail as we already checked that there is space in
-     * the TXQ */
-    rc = ef_vi_transmit_pio(vi, pkt->pio_addr, pkt->pay_len, OO_PKT_ID(pkt));
-    ci_assert_equal(rc, 0);
-
     /* Update tcp state machinery state */
     tcp_snd_nxt(ts) = pkt->pf.tcp_tx.end_seq;
     tcp_enq_nxt(ts) = pkt->pf.tcp_tx.end_seq;
     pkt->pf.tcp_tx.block_end = OO_PP_NULL;
+    if( ci_tcp_want_xmit_us(ni) )
+      ci_ip_time_get_us(IPTIMER_STATE(ni), &pkt->pf.tcp_tx.xmit_us);
     ci_tcp_tmpl_remove(ni, ts, pkt);
     ci_ip_queue_enqueue(ni, &ts->retrans, pkt);
     --ni->state->n_async_pkts;
     ++ts->stats.tx_tmpl_send_fast;
     CITP_STATS_NETIF_INC(ni, pio_pkts);
+    ++tx_staged[pkt->intf_i];
+    *rc_out = 0;
+    return CI_TCP_TMPL_STAGED;
   }
   else {
     /* Unable to send via pio due to tcp state machinery or full TXQ.
-     * So do a normal send.  __ci_tcp_tmpl_normal_send() releases the
-     * lock.
+     * So do a normal send.
      */
-    return __ci_tcp_tmpl_normal_send(ni, ts, pkt, sinf, flags);
+    return CI_TCP_TMPL_NORMAL;
   }
 
  out:
+  *rc_out = rc;
+  return CI_TCP_TMPL_DONE;
+}
+
+
+/* Push templates staged by ci_tcp_tmpl_update_prep() to the adapter. */
+static void ci_tcp_tmpl_post(ci_netif* ni, ci_ip_pkt_fmt** pkts, int n_pkts)
+{
+  ci_ip_pkt_fmt* pkt;
+  int i;
+
+  for( i = 0; i < n_pkts; ++i ) {
+    pkt = pkts[i];
+    /* This cannot fail as we already checked that there is space in
+     * the TXQ */
+    ci_verify(ef_vi_transmit_pio(ci_netif_vi(ni, pkt->intf_i), pkt->pio_addr,
+                                 pkt->pay_len, OO_PKT_ID(pkt)) == 0);
+  }
+}
+
+
+int
+ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
+                   struct oo_msg_template* omt,
+                   const struct onload_template_msg_update_iovec* updates,
+                   int ulen, unsigned flags)
+{
+  int tx_staged[CI_CFG_MAX_INTERFACES] = { 0 };
+  ci_ip_pkt_fmt* pkt;
+  int rc = 0;
+
+  ci_netif_lock(ni);
+  switch( ci_tcp_tmpl_update_prep(ni, ts, omt, updates, ulen, flags,
+                                  tx_staged, &rc) ) {
+  case CI_TCP_TMPL_STAGED:
+    pkt = ci_tcp_tmpl_omt_to_pkt(omt);
+    ci_tcp_tmpl_post(ni, &pkt, 1);
+    break;
+  case CI_TCP_TMPL_NORMAL:
+    /* __ci_tcp_tmpl_normal_send() releases the lock. */
+    return __ci_tcp_tmpl_normal_send(ni, ts, ci_tcp_tmpl_omt_to_pkt(omt),
+                                     ci_tcp_tmpl_omt_to_sinf(omt), flags);
+  }
   ci_netif_unlock(ni);
   return rc;
 }
 
 
+void
+ci_tcp_tmpl_update_batch(ci_netif* ni, ci_tcp_state** tss,
+                         struct onload_template_msg_update_batch* batch,
+                         int n, unsigned flags)
+{
+  ci_ip_pkt_fmt* staged[CI_TCP_TMPL_BATCH_MAX];
+  int tx_staged[CI_CFG_MAX_INTERFACES] = { 0 };
+  struct oo_msg_template* omt;
+  int i, n_staged = 0;
+
+  ci_assert_le(n, CI_TCP_TMPL_BATCH_MAX);
+
+  /* Templates are prepared in order and posted together.  A template that
+   * needs a normal send flushes those staged before it, so that sends on
+   * any one socket stay in order, and costs us the lock for the duration
+   * of the send.
+   */
+  ci_netif_lock(ni);
+  for( i = 0; i < n; ++i ) {
+    omt = batch[i].otmb_handle;
+    switch( ci_tcp_tmpl_update_prep(ni, tss[i], omt, batch[i].otmb_updates,
+                                    batch[i].otmb_ulen, flags, tx_staged,
+                                    &batch[i].otmb_rc) ) {
+    case CI_TCP_TMPL_STAGED:
+      staged[n_staged++] = ci_tcp_tmpl_omt_to_pkt(omt);
+      break;
+    case CI_TCP_TMPL_NORMAL:
+      ci_tcp_tmpl_post(ni, staged, n_staged);
+      n_staged = 0;
+      memset(tx_staged, 0, sizeof(tx_staged));
+      batch[i].otmb_rc =
+        __ci_tcp_tmpl_normal_send(ni, tss[i], ci_tcp_tmpl_omt_to_pkt(omt),
+                                  ci_tcp_tmpl_omt_to_sinf(omt), flags);
+      ci_netif_lock(ni);
+      break;
+    }
+  }
+  ci_tcp_tmpl_post(ni, staged, n_staged);
+  ci_netif_unlock(ni);
+}
+
+
 int ci_tcp_tmpl_abort(ci_netif* ni, ci_tcp_state* ts,
                       struct oo_msg_template* omt)
 {
   ci_ip_pkt_fmt* tmpl = ci_tcp_tmpl_omt_to_pkt(omt);
-  int rc = 0;
+  int intf_i, rc = 0;
   ci_netif_lock(ni);
   if( omt->oomt_sock_id != S_SP(ts) ) {
     rc = -EINVAL;
     goto out;
   }
+  intf_i = tmpl->intf_i;
   ci_tcp_tmpl_free(ni, ts, tmpl, 1);
+  ci_tcp_tmpl_pio_compact(ni, intf_i);
  out:
   ci_netif_unlock(ni);
   return rc;
@@ -1104,16 +1339,23 @@ static int ci_tcp_sendmsg_enqueue(ci_netif* ni, ci_tcp_state* ts,
   oo_pkt_p send_list = OO_PP_NULL;
   ci_ip_pkt_fmt* pkt;
   int n_pkts = 0;
+  ci_uint32 now_us = 0;
 
   ci_assert(ci_netif_is_locked(ni));
   ci_assert_equal(ts->s.tx_errno, 0);
 
+  /* Packets put straight onto the retransmit queue have been sent by the
+   * app (delegated sends), so now is the best send time we have. */
+  if( ci_tcp_want_xmit_us(ni) && sendq == &ts->retrans )
+    ci_ip_time_get_us(IPTIMER_STATE(ni), &now_us);
+
   do {
     pkt = reverse_list;
     reverse_list = (ci_ip_pkt_fmt *)CI_USER_PTR_GET(pkt->pf.tcp_tx.next);
 
     seq -= pkt->pf.tcp_tx.end_seq;
     ci_tcp_sendmsg_prep_pkt(ni, ts, pkt, seq);
+    pkt->pf.tcp_tx.xmit_us = now_us;
 
     pkt->next = send_list;
     send_list = OO_PKT_P(pkt);
@@ -1485,7 +1727,7 @@ static int ci_tcp_sendmsg_no_pkt_buf(ci_netif* ni, ci_tcp_state* ts,
 {
   ci_ip_pkt_fmt* pkt;
   do {
-    pkt = ci_netif_pkt_alloc_nonb(ni);
+    pkt = ci_netif_pkt_alloc_nonb_cached(ni);
     if( pkt ) 
       oo_pkt_filler_add_pkt(&sinf->pf, pkt);
     else
@@ -1559,7 +1801,7 @@ static int ci_tcp_sendmsg_no_pkt_buf(ci_netif* ni, ci_tcp_state* ts,
         return -1;
       }
       do {
-        pkt = ci_netif_pkt_alloc_nonb(ni);
+        pkt = ci_netif_pkt_alloc_nonb_cached(ni);
         if( pkt ) 
           oo_pkt_filler_add_pkt(&sinf->pf, pkt);
         else
@@ -2354,7 +2596,8 @@ ci_tcp_offload_zc_send_accum_crc(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     abort();
   }
   ci_uint32 crc = crc_prefix->accum_crc.reset ? 0 : ni->state->nvme_crc_plugin_idp[intf_i].crcs[id];
-  ni->state->nvme_crc_plugin_idp[intf_i].crcs[id] = crc32c(crc ^ 0xffffffff, zcp->local_addr, zcp->len);
+  ni->state->nvme_crc_plugin_idp[intf_i].crcs[id] =
+    ~ci_crc32c_partial(zcp->local_addr, zcp->len, ~crc);
 #endif
 #endif
 
@@ -2441,6 +2684,36 @@ zc_prefix_reservation(ci_netif* ni, const struct onload_zc_iovec* iov)
 }
 
 
+#ifndef __KERNEL__
+int ci_tcp_zc_adopt_rx_pkt(ci_netif* ni, ci_tcp_state* ts,
+                           ci_ip_pkt_fmt* pkt,
+                           const struct onload_zc_iovec* iov)
+{
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_equal(pkt->stack_id, ni->state->stack_id);
+
+  /* The receive queue and anyone else (e.g. onload_tcpdump) must have let
+   * go of it, and the payload must be in this one buffer. */
+  if( ! (pkt->flags & CI_PKT_FLAG_RX) || pkt->refcount != 1 ||
+      (pkt->rx_flags & CI_PKT_RX_FLAG_KEEP) ||
+      OO_PP_NOT_NULL(pkt->frag_next) )
+    return 0;
+
+  /* Once laid out for TX, the headers of [ts] start at dma_start+ETH_HLEN
+   * and must end before the payload. */
+  if( (char*) iov->iov_base < (char*) pkt->dma_start + ETH_HLEN +
+                              ts->outgoing_hdrs_len ||
+      iov->iov_len > tcp_eff_mss(ts) )
+    return 0;
+
+  --ni->state->n_rx_pkts;
+  __ci_netif_pkt_clean(pkt);
+  oo_tx_pkt_layout_init(pkt);
+  return 1;
+}
+#endif
+
+
 /* 
  * TODO:
  *  - improve TCP send path (in general) to handle fragmented buffers, then:
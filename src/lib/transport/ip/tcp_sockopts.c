@@ -121,8 +121,17 @@ ci_tcp_info_get(ci_netif* netif, ci_sock_cmn* s, struct ci_tcp_info* uinfo,
     info.tcpi_last_data_recv = ci_ip_time_ticks2ms(netif,
 						    now - ts->tspaws);
     
-    info.tcpi_rtt = ci_ip_time_ticks2ms(netif, ts->sa) * 1000 / 8;
-    info.tcpi_rttvar = ci_ip_time_ticks2ms(netif, ts->sv) * 1000 / 4;
+    if( ts->sa_us ) {
+      ci_ip_timer_state* its = IPTIMER_STATE(netif);
+      info.tcpi_rtt = ((ci_uint64) (ts->sa_us >> 3) <<
+                       its->ci_ip_time_frc2us) * 1000 / its->khz;
+      info.tcpi_rttvar = ((ci_uint64) (ts->sv_us >> 2) <<
+                          its->ci_ip_time_frc2us) * 1000 / its->khz;
+    }
+    else {
+      info.tcpi_rtt = ci_ip_time_ticks2ms(netif, ts->sa) * 1000 / 8;
+      info.tcpi_rttvar = ci_ip_time_ticks2ms(netif, ts->sv) * 1000 / 4;
+    }
     info.tcpi_rcv_ssthresh = ts->ssthresh;
     if( tcp_eff_mss(ts) != 0 ) {
       info.tcpi_snd_ssthresh = ts->ssthresh / tcp_eff_mss(ts);
@@ -151,10 +160,12 @@ ci_tcp_info_get(ci_netif* netif, ci_sock_cmn* s, struct ci_tcp_info* uinfo,
     }
     info.tcpi_total_retrans = ts->stats.total_retrans;
 
-    /* Starting from linux-3.15, there are tcpi_pacing_rate and
-     * tcpi_max_pacing_rate fields.  However, as Onload does not support
-     * pacing, we might as well pretend that we simulate older kernel
-     * with smaller tcp_info size. */
+    /* As Linux, ~0 means "not paced". */
+    info.tcpi_pacing_rate = ~0ull;
+    if( OO_P_NOT_NULL(ts->cong) &&
+        ci_ni_aux_p2cong(netif, ts->cong)->pace.rate != 0 )
+      info.tcpi_pacing_rate = ci_ni_aux_p2cong(netif, ts->cong)->pace.rate;
+    info.tcpi_max_pacing_rate = ts->s.so_max_pacing_rate;
   }
 
   if( *optlen > sizeof(info) )
@@ -231,6 +242,9 @@ int ci_get_sol_tcp(ci_netif* netif, ci_sock_cmn* s, int optname, void *optval,
       }
       goto u_out;
     }
+  case TCP_FASTOPEN:
+    u = c->fastopen_qlen;
+    goto u_out;
   case TCP_QUICKACK:
     {
       u = 0;
@@ -256,6 +270,18 @@ int ci_get_sol_tcp(ci_netif* netif, ci_sock_cmn* s, int optname, void *optval,
       goto u_out;
     }
 #endif
+  case TCP_CONGESTION:
+    {
+      /* As Linux, return the name NUL-padded to at most
+       * CI_TCP_CONG_NAME_MAX bytes. */
+      char name[CI_TCP_CONG_NAME_MAX];
+      socklen_t len = CI_MIN(*optlen, (socklen_t) sizeof(name));
+      memset(name, 0, sizeof(name));
+      strncpy(name, ci_tcp_cong_alg_name(c->cong_alg), sizeof(name) - 1);
+      memcpy(optval, name, len);
+      *optlen = len;
+      return 0;
+    }
 #endif
   default:
 #ifndef __KERNEL__
@@ -395,6 +421,36 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
     return ci_set_sol_ip6(netif, s, optname, optval, optlen);
   }
   else if( level == IPPROTO_TCP ) {
+#ifdef TCP_ULP
+    if( optname == TCP_ULP ) {
+      /* Kernel TLS would need records encrypted as payload is copied into
+       * packets, and kept for retransmission, which the stack does not do.
+       * Refusing the ULP makes TLS libraries fall back to user space. */
+      NI_LOG(netif, USAGE_WARNINGS, "TCP_ULP is not supported on accelerated "
+             "sockets, so kernel TLS is not available");
+      goto fail_unsup;
+    }
+#endif
+    if( optname == TCP_CONGESTION ) {
+      /* The only string-valued option, so handle it before the check
+       * below. */
+      int alg = ci_tcp_cong_alg_lookup(optval, optlen);
+      if( alg < 0 ) {
+        rc = -ENOENT;
+        goto fail_inval;
+      }
+      c->cong_alg = alg;
+      if( s->b.state & CI_TCP_STATE_TCP_CONN ) {
+        /* Switch modules on a live connection, keeping cwnd. */
+        ci_tcp_state* ts = SOCK_TO_TCP(s);
+        if( alg == CI_TCP_CONG_ALG_RENO )
+          ci_tcp_cong_release(netif, ts);
+        else
+          ci_tcp_cong_init(netif, ts);
+      }
+      return 0;
+    }
+
     /* These are ints values */
     if( (rc = opt_not_ok(optval, optlen, int)) )
       goto fail_inval;
@@ -489,6 +545,15 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
       else
         c->tcp_defer_accept = OO_TCP_DEFER_ACCEPT_OFF;
       break;
+    case TCP_FASTOPEN:
+      /* Value is the limit on connections accepted with data in the SYN
+       * and not yet accept()ed.  Zero disables TFO on this listener. */
+      if( *(int*) optval < 0 ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      c->fastopen_qlen = CI_MIN(*(int*) optval, 0xffff);
+      break;
     case TCP_QUICKACK:
       {
         if( s->b.state & CI_TCP_STATE_TCP_CONN ) {
@@ -538,6 +603,13 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
       goto fail_unsup;
     }
   }
+#ifdef SOL_TLS
+  else if( level == SOL_TLS ) {
+    /* The O/S socket must not accept these: the application would then
+     * believe that data we send in the clear is being encrypted. */
+    goto fail_unsup;
+  }
+#endif
   else {
     if( s->b.sb_aflags & CI_SB_AFLAG_OS_BACKED ) {
       LOG_U(log(FNS_FMT "unknown level=%d optname=%d accepted by O/S",
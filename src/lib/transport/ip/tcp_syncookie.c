@@ -17,132 +17,72 @@ static int syncookie_mss[8] =
 
 
 
-/* Siphash-2-4 implementation */
-
-struct siphash {
-  ci_uint64 v0, v1, v2, v3;
-
-  union {
-    ci_uint64 a;
-    unsigned char b[8];
-  } buf;
-  unsigned char* p;
-  ci_uint64 c;
-};
+/* Siphash-2-4 implementation, specialised for inputs of at most 15 bytes,
+ * which is enough for a syncookie and a TCP Fast Open cookie.  This runs
+ * for every SYN and cookie ACK when under attack, so avoid the buffering of
+ * a general implementation: the input is exactly one 8-byte word [w]
+ * followed by a [tail] of up to 7 bytes, with the input length in its top
+ * byte.
+ */
 
 #define SIP_ROTL(x, b) (ci_uint64)(((x) << (b)) | ( (x) >> (64 - (b))))
 
-static void
-sip_round(struct siphash* h, int rounds)
+#define SIP_ROUND(v0, v1, v2, v3)                       \
+  do {                                                  \
+    v0 += v1; v1 = SIP_ROTL(v1, 13); v1 ^= v0;          \
+    v0 = SIP_ROTL(v0, 32);                              \
+    v2 += v3; v3 = SIP_ROTL(v3, 16); v3 ^= v2;          \
+    v0 += v3; v3 = SIP_ROTL(v3, 21); v3 ^= v0;          \
+    v2 += v1; v1 = SIP_ROTL(v1, 17); v1 ^= v2;          \
+    v2 = SIP_ROTL(v2, 32);                              \
+  } while( 0 )
+
+static ci_uint64 ci_tcp_siphash(ci_netif* netif, ci_uint64 w, ci_uint64 tail)
 {
-  int i;
-
-  for( i = 0; i < rounds; i++ ) {
-    h->v0 += h->v1;
-    h->v1 = SIP_ROTL(h->v1, 13);
-    h->v1 ^= h->v0;
-    h->v0 = SIP_ROTL(h->v0, 32);
-
-    h->v2 += h->v3;
-    h->v3 = SIP_ROTL(h->v3, 16);
-    h->v3 ^= h->v2;
-
-    h->v0 += h->v3;
-    h->v3 = SIP_ROTL(h->v3, 21);
-    h->v3 ^= h->v0;
-
-    h->v2 += h->v1;
-    h->v1 = SIP_ROTL(h->v1, 17);
-    h->v1 ^= h->v2;
-    h->v2 = SIP_ROTL(h->v2, 32);
-  }
-}
+  const ci_uint64* key = (const ci_uint64*) netif->state->hash_salt;
+  ci_uint64 v0 = 0x736f6d6570736575ULL ^ key[0];
+  ci_uint64 v1 = 0x646f72616e646f6dULL ^ key[1];
+  ci_uint64 v2 = 0x6c7967656e657261ULL ^ key[0];
+  ci_uint64 v3 = 0x7465646279746573ULL ^ key[1];
 
-static ci_uint64
-sip_hash(ci_uint64* key, const void* data, int len)
-{
-  struct siphash h;
-  const unsigned char *p = data, *pe = p + len;
-  ci_uint64 m;
-  char left;
-  ci_uint64 b;
-
-  /* init */
-  memset(&h, 0, sizeof(h));
-  h.v0 = 0x736f6d6570736575ULL ^ key[0];
-  h.v1 = 0x646f72616e646f6dULL ^ key[1];
-  h.v2 = 0x6c7967656e657261ULL ^ key[0];
-  h.v3 = 0x7465646279746573ULL ^ key[1];
-  h.p = h.buf.b;
-
-  /* update */
-  do {
-    while( p < pe && h.p - h.buf.b < sizeof(h.buf.b) )
-      *h.p++ = *p++;
-
-    if( h.p - h.buf.b < sizeof(h.buf.b) )
-      break;
-
-    m = CI_BSWAP_LE64(h.buf.a);
-    h.v3 ^= m;
-    sip_round(&h, 2);
-    h.v0 ^= m;
-
-    h.p = h.buf.b;
-    h.c += 8;
-  } while( pe - p > 0 );
-
-  /* finish */
-  left = h.p - h.buf.b;
-  b = (h.c + left) << 56;
-
-  switch (left) {
-    case 7: b |= (uint64_t)h.buf.b[6] << 48; ci_fallthrough;
-    case 6: b |= (uint64_t)h.buf.b[5] << 40; ci_fallthrough;
-    case 5: b |= (uint64_t)h.buf.b[4] << 32; ci_fallthrough;
-    case 4: b |= (uint64_t)h.buf.b[3] << 24; ci_fallthrough;
-    case 3: b |= (uint64_t)h.buf.b[2] << 16; ci_fallthrough;
-    case 2: b |= (uint64_t)h.buf.b[1] << 8;  ci_fallthrough;
-    case 1: b |= (uint64_t)h.buf.b[0] << 0;  ci_fallthrough;
-    case 0: break;
-  }
+  ci_assert_equal(sizeof(netif->state->hash_salt),
+                  2 * sizeof(ci_uint64));
+
+  v3 ^= w;
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+  v0 ^= w;
 
-  h.v3 ^= b;
-  sip_round(&h, 2);
-  h.v0 ^= b;
-  h.v2 ^= 0xff;
-  sip_round(&h, 4);
+  v3 ^= tail;
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+  v0 ^= tail;
 
-  return h.v0 ^ h.v1 ^ h.v2  ^ h.v3;
+  v2 ^= 0xff;
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+
+  return v0 ^ v1 ^ v2 ^ v3;
 }
 
+/* End of siphash implementation */
+
+
 static ci_uint32
-ci_tcp_syncookie_hash(ci_netif* netif, ci_tcp_socket_listen* tls,
-                      ci_tcp_state_synrecv* tsr, int t, int m)
+ci_tcp_syncookie_hash(ci_netif* netif, ci_uint16 l_port, ci_uint16 r_port,
+                      ci_uint32 l_addr, ci_uint32 r_addr, int t, int m)
 {
-  ci_uint8 hash_data[13];
-
-  hash_data[0] = tsr->l_port & 0xff;
-  hash_data[1] = tsr->l_port >> 8;
-  hash_data[2] = tsr->r_port & 0xff;
-  hash_data[3] = tsr->r_port >> 8;
-  hash_data[4] = tsr->l_addr.ip4 & 0xff;
-  hash_data[5] = (tsr->l_addr.ip4 & 0xff00) >> 8;
-  hash_data[6] = (tsr->l_addr.ip4 & 0xff0000) >> 16;
-  hash_data[7] = (tsr->l_addr.ip4 & 0xff000000) >> 24;
-  hash_data[8] = tsr->r_addr.ip4 & 0xff;
-  hash_data[9] = (tsr->r_addr.ip4 & 0xff00) >> 8;
-  hash_data[10] = (tsr->r_addr.ip4 & 0xff0000) >> 16;
-  hash_data[11] = (tsr->r_addr.ip4 & 0xff000000) >> 24;
-  hash_data[12] = t << 3 | m;
+  /* Bytes 0-7 of the input, as a little-endian word: ports then local
+   * address, each least significant byte first. */
+  ci_uint64 w = l_port | (ci_uint64) r_port << 16 | (ci_uint64) l_addr << 32;
+  /* Bytes 8-12, plus the input length in the top byte. */
+  ci_uint64 tail = r_addr | (ci_uint64) (t << 3 | m) << 32 | 13ULL << 56;
 
-  ci_assert_equal(sizeof(netif->state->hash_salt),
-                  2 * sizeof(ci_uint64));
-  return (ci_uint32)sip_hash((void *)netif->state->hash_salt,
-                             hash_data, sizeof(hash_data));
+  return (ci_uint32) ci_tcp_siphash(netif, w, tail);
 }
 
-/* End of siphash implementation */
 
  
 
@@ -173,7 +113,8 @@ ci_tcp_syncookie_syn(ci_netif* netif, ci_tcp_socket_listen* tls,
 
   /* Calculate sequence number */
   tsr->snd_isn = (t << 3) | m |
-      (ci_tcp_syncookie_hash(netif, tls, tsr, t, m) << 8);
+      (ci_tcp_syncookie_hash(netif, tsr->l_port, tsr->r_port,
+                             tsr->l_addr.ip4, tsr->r_addr.ip4, t, m) << 8);
 
   /* disable all TCP options or put the info into timestamp */
   if( tsr->tcpopts.flags & NI_OPTS(netif).syn_opts & CI_TCPT_FLAG_TSO ) {
@@ -205,6 +146,8 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
   int t, m, t_now;
   ci_tcp_state_synrecv* tsr;
   ci_uint32 isn = rxp->ack - 1;
+  ci_uint32 l_addr = oo_ip_hdr(rxp->pkt)->ip_daddr_be32;
+  ci_uint32 r_addr = oo_ip_hdr(rxp->pkt)->ip_saddr_be32;
 
   CITP_STATS_TCP_LISTEN(++tls->stats.n_syncookie_ack_recv);
   *tsr_p = NULL;
@@ -219,6 +162,16 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
     return;
   }
 
+  /* Check the cookie before allocating anything, as a flood of bogus ACKs
+   * is as likely as a flood of SYNs. */
+  if( (isn >> 8) !=
+      (ci_tcp_syncookie_hash(netif, rxp->tcp->tcp_dest_be16,
+                             rxp->tcp->tcp_source_be16,
+                             l_addr, r_addr, t, m) & 0xffffff) ) {
+    CITP_STATS_TCP_LISTEN(++tls->stats.n_syncookie_ack_hash_rej);
+    return;
+  }
+
   tsr = ci_alloc(sizeof(ci_tcp_state_synrecv));
   if( tsr == NULL )
     return;
@@ -227,19 +180,12 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
 
   tsr->l_port = rxp->tcp->tcp_dest_be16;
   tsr->r_port = rxp->tcp->tcp_source_be16;
-  tsr->l_addr = CI_ADDR_FROM_IP4(oo_ip_hdr(rxp->pkt)->ip_daddr_be32);
-  tsr->r_addr = CI_ADDR_FROM_IP4(oo_ip_hdr(rxp->pkt)->ip_saddr_be32);
+  tsr->l_addr = CI_ADDR_FROM_IP4(l_addr);
+  tsr->r_addr = CI_ADDR_FROM_IP4(r_addr);
   tsr->tcpopts.smss = syncookie_mss[m];
   tsr->snd_isn = isn;
   tsr->rcv_nxt = rxp->seq;
 
-  if( (isn >> 8) !=
-      (ci_tcp_syncookie_hash(netif, tls, tsr, t, m) & 0xffffff) ) {
-    CITP_STATS_TCP_LISTEN(++tls->stats.n_syncookie_ack_hash_rej);
-    ci_free(tsr);
-    return;
-  }
-
   tsr->local_peer = OO_SP_NULL;
 
   *tsr_p = tsr;
@@ -258,3 +204,68 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
   CITP_STATS_TCP_LISTEN(++tls->stats.n_syncookie_ack_answ);
 }
 
+
+
+/* TCP Fast Open (RFC7413) cookies.  A server issues a client the siphash of
+ * the addresses of the connection, which the client presents in the SYN of
+ * later connections to have the data in the SYN accepted.
+ */
+
+void ci_tcp_fastopen_cookie(ci_netif* netif, ci_uint32 l_addr,
+                            ci_uint32 r_addr, ci_uint8* cookie)
+{
+  ci_uint64 h = ci_tcp_siphash(netif, l_addr | (ci_uint64) r_addr << 32,
+                               8ULL << 56);
+
+  CI_BUILD_ASSERT(sizeof(h) == CI_TCP_FASTOPEN_COOKIE_LEN);
+  memcpy(cookie, &h, sizeof(h));
+}
+
+int ci_tcp_fastopen_cookie_ok(ci_netif* netif, ci_uint32 l_addr,
+                              ci_uint32 r_addr, const ciip_tcp_rx_pkt* rxp)
+{
+  ci_uint8 cookie[CI_TCP_FASTOPEN_COOKIE_LEN];
+
+  if( rxp->fastopen_len != CI_TCP_FASTOPEN_COOKIE_LEN )
+    return 0;
+  ci_tcp_fastopen_cookie(netif, l_addr, r_addr, cookie);
+  return memcmp(cookie, rxp->fastopen_cookie, sizeof(cookie)) == 0;
+}
+
+
+/* The client's cache of cookies is direct-mapped by server address. */
+
+static ci_tcp_fastopen_cache_entry*
+ci_tcp_fastopen_cache_slot(ci_netif* netif, ci_uint32 raddr_be32)
+{
+  ci_uint32 h = CI_BSWAP_BE32(raddr_be32) * 0x9e3779b1u;
+  CI_BUILD_ASSERT(CI_TCP_FASTOPEN_CACHE_SIZE == 16);
+  return &netif->state->fastopen_cache[h >> 28];
+}
+
+const ci_tcp_fastopen_cache_entry*
+ci_tcp_fastopen_cache_lookup(ci_netif* netif, ci_uint32 raddr_be32)
+{
+  ci_tcp_fastopen_cache_entry* e = ci_tcp_fastopen_cache_slot(netif,
+                                                              raddr_be32);
+  if( e->len == 0 || e->raddr_be32 != raddr_be32 )
+    return NULL;
+  return e;
+}
+
+void ci_tcp_fastopen_cache_update(ci_netif* netif, ci_uint32 raddr_be32,
+                                  ci_uint16 mss, const ci_uint8* cookie,
+                                  int len)
+{
+  ci_tcp_fastopen_cache_entry* e = ci_tcp_fastopen_cache_slot(netif,
+                                                              raddr_be32);
+
+  ci_assert(ci_netif_is_locked(netif));
+  ci_assert_ge(len, CI_TCP_FASTOPEN_COOKIE_MIN);
+  ci_assert_le(len, CI_TCP_FASTOPEN_COOKIE_CACHE_MAX);
+
+  e->raddr_be32 = raddr_be32;
+  e->mss = mss;
+  e->len = len;
+  memcpy(e->cookie, cookie, len);
+}
@@ -583,6 +583,7 @@ static void ci_tcp_inherit_options(ci_netif* ni, ci_sock_cmn* s,
   ci_assert(ts);
 
   ts->s.so = s->so;
+  ts->s.so_max_pacing_rate = s->so_max_pacing_rate;
 #if CI_CFG_IPV6
   /* IPv6 link-local address requires an interface. Don't overwrite it. */
   if( !CI_IPX_IS_LINKLOCAL(ts->s.cp.laddr) ||
@@ -952,6 +953,7 @@ int ci_tcp_listenq_try_promote(ci_netif* netif, ci_tcp_socket_listen* tls,
 
     ts->smss = tsr->tcpopts.smss;
     ts->c.user_mss = tls->c.user_mss;
+    ts->c.cong_alg = tls->c.cong_alg;
     if (ts->c.user_mss && ts->c.user_mss < ts->smss)
       ts->smss = ts->c.user_mss;
 #if CI_CFG_LIMIT_SMSS
@@ -564,7 +564,7 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
       ts->ssthresh = CI_MAX(x, y);
     }
     else
-      ts->ssthresh = ci_tcp_losswnd(ts);
+      ts->ssthresh = ci_tcp_cong_ssthresh(netif, ts);
 
     ts->congstate = CI_TCP_CONG_RTO;
     ts->cwnd_extra = 0;
@@ -578,12 +578,22 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(netif).min_cwnd);
   ts->bytes_acked = 0;
 
+  /* RACK's reordering window goes back to its initial size, and any
+   * pending RACK check is now moot. */
+  ts->rack.reo_wnd_mult = 1;
+  ci_ip_timer_clear(netif, &ts->rack_tid);
+
   /* Backoff RTO timer and restart. */
   ts->rto <<= 1u;
   ts->rto = CI_MIN(ts->rto, NI_CONF(netif).tconst_rto_max);    
   ci_tcp_rto_set(netif, ts);
   ci_assert(!(ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_TIMING));
 
+  ci_tcp_flight_record(netif, ts, CI_TCP_FLIGHT_RTO, 0, ts->retransmits,
+                       tcp_snd_una(ts), ts->rto);
+  ci_tcp_flight_record(netif, ts, CI_TCP_FLIGHT_CWND, ts->congstate, 0,
+                       ts->cwnd, ts->ssthresh);
+
   /* Delete all SACK marks (RFC2018 p6).  The reason is that the receiver
   ** is permitted to drop data that it has SACKed but not ACKed.  This
   ** ensures that we will eventually retransmit such data.
@@ -18,6 +18,7 @@
 #include "ip_tx.h"
 #include <ci/internal/pio_buddy.h>
 #include "tcp_tx.h"
+#include <linux/pkt_sched.h>
 
 
 #if OO_DO_STACK_POLL
@@ -39,6 +40,21 @@ ci_inline void check_tx_timestamping(ci_tcp_state* ts, int af,
 }
 
 
+/* Whether data from [ts] should wait in the bulk queue rather than fill
+ * the TX ring ahead of other sockets; see EF_TX_BULK_FILL_MAX.  As with
+ * Linux's default qdisc, TC_PRIO_BULK and TC_PRIO_FILLER are the lowest
+ * priorities. */
+ci_inline int ci_tcp_tx_is_bulk(ci_netif* ni, ci_tcp_state* ts,
+                                ci_ip_pkt_fmt* pkt)
+{
+  return NI_OPTS(ni).tx_bulk_fill_max != 0 &&
+         (ts->s.so_priority == TC_PRIO_BULK ||
+          ts->s.so_priority == TC_PRIO_FILLER) &&
+         ci_netif_pkt_q_id(pkt) == CI_Q_ID_NORMAL &&
+         ! (ts->tcpflags & CI_TCPT_FLAG_MSG_WARM);
+}
+
+
 ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
                                       oo_pkt_p head_id, 
                                       ci_ip_pkt_fmt* tail_pkt)
@@ -72,6 +88,16 @@ ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
 
   ci_netif_dmaq_and_vi_for_pkt(ni, tail_pkt, &dmaq, &vi);
 
+  if(CI_UNLIKELY( ci_tcp_tx_is_bulk(ni, ts, tail_pkt) )) {
+    /* Bulk data goes out in order behind whatever is already queued from
+     * bulk sockets, so never by PIO. */
+    oo_pktq* bulkq = ci_netif_dmaq_bulk(ni, tail_pkt->intf_i);
+    __oo_pktq_put_list(ni, bulkq, head_id, tail_pkt, n, netif.tx.dmaq_next);
+    ci_netif_dmaq_shove_bulk(ni, tail_pkt->intf_i);
+    CITP_STATS_NETIF_ADD(ni, tx_bulk_queued, CI_MIN(n, bulkq->num));
+    return;
+  }
+
 #if CI_CFG_PIO
     /* pio_thresh is set to zero if PIO disabled on this stack, so don't
      * need to check NI_OPTS().pio here
@@ -79,10 +105,14 @@ ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
   order = ci_log2_ge(tail_pkt->pay_len, CI_CFG_MIN_PIO_BLOCK_ORDER);
   buddy = &ni->state->nic[tail_pkt->intf_i].pio_buddy;
   if( n == 1 && oo_pktq_is_empty(dmaq) &&
-      ! ci_netif_may_ctpio(ni, tail_pkt->intf_i, tail_pkt->pay_len) &&
+      ci_netif_pkt_q_id(tail_pkt) == CI_Q_ID_NORMAL &&
       ! (pkt->flags & CI_PKT_FLAG_INDIRECT) &&
       (ni->state->nic[tail_pkt->intf_i].oo_vi_flags & OO_VI_FLAGS_PIO_EN) ) {
-    if( tail_pkt->pay_len <= NI_OPTS(ni).pio_thresh ) {
+    int may_ctpio = ci_netif_may_ctpio(ni, tail_pkt->intf_i,
+                                       tail_pkt->pay_len);
+    int may_pio = tail_pkt->pay_len <= NI_OPTS(ni).pio_thresh;
+    if( ci_netif_tx_mech(ni, tail_pkt, may_pio, may_ctpio) ==
+        CI_TX_MECH_PIO ) {
       if( (offset = ci_pio_buddy_alloc(ni, buddy, order)) >= 0 ) {
         if(CI_UNLIKELY( ts->tcpflags & CI_TCPT_FLAG_MSG_WARM )) {
           __ci_netif_dmaq_insert_prep_pkt_warm_undo(ni, tail_pkt);
@@ -97,6 +127,7 @@ ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
           ci_assert(tail_pkt->pio_addr == -1);
           tail_pkt->pio_addr = offset;
           tail_pkt->pio_order = order;
+          ci_netif_tx_adapt_posted(ni, tail_pkt, CI_TX_MECH_PIO);
           return;
         }
         else {
@@ -108,8 +139,9 @@ ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
       else {
         CI_DEBUG(CITP_STATS_NETIF_INC(ni, no_pio_busy));
       }
+      ci_netif_tx_adapt_pio_failed(ni, tail_pkt);
     }
-    else {
+    else if( ! may_pio && ! may_ctpio ) {
       CI_DEBUG(CITP_STATS_NETIF_INC(ni, no_pio_too_long));
     }
   }
@@ -118,7 +150,7 @@ ci_inline void ci_ip_tcp_list_to_dmaq(ci_netif* ni, ci_tcp_state* ts,
   if(CI_LIKELY( ! (ts->tcpflags & CI_TCPT_FLAG_MSG_WARM) )) {
     int is_fresh = oo_pktq_is_empty(dmaq);
     __oo_pktq_put_list(ni, dmaq, head_id, tail_pkt, n, netif.tx.dmaq_next);
-    ci_netif_dmaq_shove2(ni, tail_pkt->intf_i, is_fresh);
+    ci_netif_dmaq_shove_for_pkt(ni, tail_pkt, is_fresh);
   }
   else {
     __ci_netif_dmaq_insert_prep_pkt_warm_undo(ni, tail_pkt);
@@ -229,10 +261,30 @@ static void ci_ip_send_tcp_list_loopback(ci_netif* ni, ci_tcp_state* ts,
     if( SEQ_LE(ts->ack_trigger, ts->rcv_delivered) )
       ci_tcp_send_ack_loopback(ni, ts);
     if( !ni->state->in_poll )
-      ci_netif_poll(ni);
+      ci_netif_loopback_poll(ni);
   }
 }
 
+static void ci_tcp_flight_record_tx(ci_netif* ni, ci_tcp_state* ts,
+                                    oo_pkt_p id, ci_ip_pkt_fmt* tail_pkt)
+{
+  int af = ipcache_af(&ts->s.pkt);
+  ci_ip_pkt_fmt* pkt;
+  ci_tcp_hdr* tcp;
+
+  do {
+    pkt = PKT_CHK(ni, id);
+    id = pkt->next;
+    tcp = TX_PKT_IPX_TCP(af, pkt);
+    ci_tcp_flight_record_slow(ni, ts, CI_TCP_FLIGHT_TX, tcp->tcp_flags,
+                              SEQ_SUB(pkt->pf.tcp_tx.end_seq,
+                                      pkt->pf.tcp_tx.start_seq),
+                              pkt->pf.tcp_tx.start_seq,
+                              CI_BSWAP_BE32(tcp->tcp_ack_be32));
+  } while( pkt != tail_pkt );
+}
+
+
 static void ci_ip_send_tcp_list(ci_netif* ni, ci_tcp_state* ts,
                                 oo_pkt_p head_id, ci_ip_pkt_fmt* tail_pkt)
 {
@@ -242,6 +294,9 @@ static void ci_ip_send_tcp_list(ci_netif* ni, ci_tcp_state* ts,
   ci_assert(ci_netif_is_locked(ni));
   ci_assert(~ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE);
 
+  if(CI_UNLIKELY( OO_P_NOT_NULL(ts->flight) ))
+    ci_tcp_flight_record_tx(ni, ts, head_id, tail_pkt);
+
   if(CI_LIKELY( ts->s.pkt.status == retrrc_success &&
                 oo_cp_ipcache_is_valid(ni, &ts->s.pkt) )) {
 fast:
@@ -324,6 +379,24 @@ ci_inline int ci_tcp_tx_opt_sack_perm(ci_uint8** opt)
   return 2;
 }
 
+/*
+** Fill out the TCP Fast Open option, padded to a dword boundary; [len] of
+** zero requests a cookie
+*/
+ci_inline int ci_tcp_tx_opt_fastopen(ci_uint8** opt, const ci_uint8* cookie,
+                                     int len)
+{
+  int optlen = 2 + len;
+
+  (*opt)[0] = CI_TCP_OPT_FASTOPEN;
+  (*opt)[1] = (ci_uint8) optlen;
+  memcpy(*opt + 2, cookie, len);
+  for( ; optlen & 3; ++optlen )
+    (*opt)[optlen] = CI_TCP_OPT_NOP;
+  *opt += optlen;
+  return optlen;
+}
+
 
 ci_inline bool rob_is_empty(ci_netif* netif, ci_tcp_state* ts)
 {
@@ -639,16 +712,19 @@ static int ci_tcp_tx_insert_syn_options(ci_netif* ni, ci_uint16 amss,
 }
 
 
-/*
-** called to enqueue a packet with no data (i.e. SYN/FIN) the segment
-** is placed on the TX queue and so is reliably transmitted
-*/
-void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
-                            ci_ip_pkt_fmt* pkt)
+/* Enqueue a SYN or FIN.  A SYN may carry a TCP Fast Open option if
+ * [fastopen_len] >= 0, and data from [piov].  Returns the number of bytes
+ * of data enqueued.
+ */
+static int __ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
+                                    ci_ip_pkt_fmt* pkt,
+                                    const ci_uint8* fastopen_cookie,
+                                    int fastopen_len, ci_iovec_ptr* piov)
 {
   ci_tcp_hdr* thdr;
   int af = ipcache_af(&ts->s.pkt);
   int optlen = tcp_ipx_outgoing_opts_len(af, ts);
+  int n = 0;
 
   ci_assert(ts);
   ci_assert(netif);
@@ -656,6 +732,8 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
   /* ASSERT_VALID_PKT(netif, pkt); iov_len may be -4 */
   ci_assert(pkt->refcount == 1 ); /* packet will be consumed. */
   ci_assert(TS_IPX_TCP(ts)->tcp_flags & (CI_TCP_FLAG_SYN|CI_TCP_FLAG_FIN));
+  ci_assert_impl(fastopen_len >= 0 || piov != NULL,
+                 TS_IPX_TCP(ts)->tcp_flags & CI_TCP_FLAG_SYN);
 
   oo_tx_pkt_layout_init(pkt);
   ci_ipcache_update_flowlabel(netif, &ts->s);
@@ -666,6 +744,8 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
   if( TS_IPX_TCP(ts)->tcp_flags & CI_TCP_FLAG_SYN ) {
     ci_uint8* opt = CI_TCP_HDR_OPTS(thdr);
     opt += optlen;
+    if( fastopen_len >= 0 )
+      optlen += ci_tcp_tx_opt_fastopen(&opt, fastopen_cookie, fastopen_len);
     optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss,
                                            ts->tcpflags, ts->rcv_wscl, &opt);
 
@@ -679,26 +759,76 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
   pkt->buf_len = ( oo_tx_ether_hdr_size(pkt) + CI_IPX_HDR_SIZE(af)
                    + sizeof(ci_tcp_hdr) + optlen );
   pkt->pay_len = pkt->buf_len;
+#ifndef __KERNEL__
+  if( piov != NULL && ! ci_iovec_ptr_is_empty_proper(piov) ) {
+    /* The SYN and the options beyond those of a data segment must fit in
+     * the MSS, so that the segment is not split on transmit. */
+    int max = tcp_eff_mss(ts) - 1 -
+              (optlen - tcp_ipx_outgoing_opts_len(af, ts));
+    if( max > 0 ) {
+      int hdrs_len = pkt->buf_len;
+      oo_offbuf_init(&pkt->buf, PKT_START(pkt) + hdrs_len, max);
+      n = ci_copy_iovec_to_pkt(netif, pkt, piov);
+      if( n < 0 ) {
+        /* Send the SYN alone, and let the data fault again in send(). */
+        pkt->buf_len = pkt->pay_len = hdrs_len;
+        n = 0;
+      }
+    }
+  }
+#endif
   oo_offbuf_init(&pkt->buf, PKT_START(pkt) + pkt->buf_len, 0);
   pkt->flags &= CI_PKT_FLAG_NONB_POOL;
   ASSERT_VALID_PKT(netif, pkt);
 
   pkt->pf.tcp_tx.start_seq = tcp_enq_nxt(ts);
-  tcp_enq_nxt(ts) += 1;
+  tcp_enq_nxt(ts) += 1 + n;
   pkt->pf.tcp_tx.end_seq = tcp_enq_nxt(ts);
   pkt->pf.tcp_tx.block_end = OO_PP_NULL;
 
   ci_ip_queue_enqueue(netif, &ts->send, pkt);
   ++ts->send_in;
 
-  LOG_TC(log(LNTS_FMT "enqueue ["CI_TCP_FLAGS_FMT"] seq=%x",
+  LOG_TC(log(LNTS_FMT "enqueue ["CI_TCP_FLAGS_FMT"] seq=%x len=%d",
              LNTS_PRI_ARGS(netif, ts),
              CI_TCP_HDR_FLAGS_PRI_ARG(TX_PKT_IPX_TCP(af, pkt)),
-             tcp_enq_nxt(ts) - 1));
+             pkt->pf.tcp_tx.start_seq, n));
+
+  /* An active open sends only the SYN until the peer opens its window;
+   * let data in the SYN go with it. */
+  if( n != 0 && SEQ_LT(ts->snd_max, tcp_enq_nxt(ts)) )
+    ts->snd_max = tcp_enq_nxt(ts);
 
   ci_tcp_tx_advance(ts, netif);
+  return n;
 }
 
+
+/*
+** called to enqueue a packet with no data (i.e. SYN/FIN) the segment
+** is placed on the TX queue and so is reliably transmitted
+*/
+void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
+                            ci_ip_pkt_fmt* pkt)
+{
+  __ci_tcp_enqueue_no_data(ts, netif, pkt, NULL, -1, NULL);
+}
+
+
+#ifndef __KERNEL__
+/* Enqueue the SYN of an active TCP Fast Open, with the server's [cookie]
+ * and as much of the data in [piov] as fits; [len] of zero requests a
+ * cookie, and then no data is sent.  Returns the number of bytes enqueued.
+ */
+int ci_tcp_enqueue_syn_fastopen(ci_tcp_state* ts, ci_netif* netif,
+                                ci_ip_pkt_fmt* pkt, const ci_uint8* cookie,
+                                int len, ci_iovec_ptr* piov)
+{
+  return __ci_tcp_enqueue_no_data(ts, netif, pkt, cookie, len,
+                                  len != 0 ? piov : NULL);
+}
+#endif
+
 /* Rewrite the first SYN packet as a SYNACK for simultaneous open */
 int ci_tcp_send_sim_synack(ci_netif* netif, ci_tcp_state *ts)
 {
@@ -876,6 +1006,11 @@ int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
        ipcache->status == retrrc_nomac ||
        OO_SP_NOT_NULL(tsr->local_peer)) ) {
     tsr->amss = ci_tcp_amss(netif, &tls->c, ipcache, __func__);
+    if( tsr->fastopen ) {
+      ci_uint8 cookie[CI_TCP_FASTOPEN_COOKIE_LEN];
+      ci_tcp_fastopen_cookie(netif, tsr->l_addr.ip4, tsr->r_addr.ip4, cookie);
+      optlen += ci_tcp_tx_opt_fastopen(&opt, cookie, sizeof(cookie));
+    }
     optlen += ci_tcp_tx_insert_syn_options(netif, tsr->amss,
                                            tsr->tcpopts.flags,
                                            tsr->rcv_wscl, &opt);
@@ -938,6 +1073,7 @@ int ci_tcp_retrans_one(ci_tcp_state* ts, ci_netif* netif, ci_ip_pkt_fmt* pkt)
 
   CITP_STATS_NETIF_INC(netif, retransmits);
   ++ts->stats.total_retrans;
+  OO_PROBE3(tcp_retrans, NI_ID(netif), S_ID(ts), pkt->pf.tcp_tx.start_seq);
 
   tcp = TX_PKT_IPX_TCP(af, pkt);
 
@@ -994,6 +1130,10 @@ int ci_tcp_retrans_one(ci_tcp_state* ts, ci_netif* netif, ci_ip_pkt_fmt* pkt)
     pkt->pf.tcp_tx.first_tx_hw_stamp = pkt->hw_stamp;
 #endif
   pkt->flags |= CI_PKT_FLAG_RTQ_RETRANS;
+  if( ci_tcp_want_xmit_us(netif) )
+    ci_ip_time_get_us(IPTIMER_STATE(netif), &pkt->pf.tcp_tx.xmit_us);
+  ci_tcp_flight_record(netif, ts, CI_TCP_FLIGHT_RETRANS, 0, ts->retransmits,
+                       pkt->pf.tcp_tx.start_seq, pkt->pf.tcp_tx.end_seq);
   ci_tcp_tx_maybe_do_striping(pkt, ts);
   __ci_ip_send_tcp(netif, pkt, ts);
   CI_TCP_STATS_INC_OUT_SEGS(netif);
@@ -1073,7 +1213,7 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
   while( 1 ) {
     /* Skip SACKed packets. */
     if( pkt->flags & CI_PKT_FLAG_RTQ_SACKED ) {
-      pkt = PKT_CHK(ni, pkt->pf.tcp_tx.block_end);
+      pkt = ci_tcp_sacked_block_end(ni, pkt);
       ts->retrans_ptr = pkt->next;
       if( OO_PP_IS_NULL(ts->retrans_ptr) )  break;
       pkt = PKT_CHK(ni, ts->retrans_ptr);
@@ -1347,6 +1487,10 @@ void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
   }
 #endif
 
+  if( CI_UNLIKELY( OO_P_NOT_NULL(ts->cong) ) ) {
+    ci_tcp_pacing_tx_advance(ni, ts, right_edge, p_stop_cntr);
+    return;
+  }
   ci_tcp_tx_advance_to(ni, ts, right_edge, p_stop_cntr);
 }
 
@@ -1359,6 +1503,10 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
   oo_pkt_p id = sendq->head;
   int sent_num = 0;
   int af = ipcache_af(&ts->s.pkt);
+  ci_uint32 now_us = 0;
+
+  if( ci_tcp_want_xmit_us(ni) )
+    ci_ip_time_get_us(IPTIMER_STATE(ni), &now_us);
 
   while( 1 ) {
     ci_ip_pkt_fmt* pkt = PKT_CHK(ni, id);
@@ -1442,6 +1590,7 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
                ci_tx_pkt_ipx_tcp_payload_len(af, pkt)));
 
     tcp_snd_nxt(ts) = pkt->pf.tcp_tx.end_seq;
+    pkt->pf.tcp_tx.xmit_us = now_us;
     sent_num++;
     CI_TCP_STATS_INC_OUT_SEGS(ni);
     last_pkt = pkt;
@@ -1711,14 +1860,13 @@ int ci_tcp_reset_untrusted(ci_netif *netif, ci_tcp_state *ts)
 }
 #endif
 
-void
-ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
-                      ciip_tcp_rx_pkt* rxp)
+/* Reply to [rxp] from outside of any socket: with a RST if [tw] is NULL,
+ * or otherwise with an ACK from the compact TIME_WAIT entry [tw].
+ */
+static void
+__ci_tcp_reply(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
+               ciip_tcp_rx_pkt* rxp, const ci_tcp_tw_compact_t* tw)
 {
-  /* If the incoming seg has an ACK, use that as the seq no, otherwise use
-  ** 0.  Calculate a proper ACK from the incoming seg.  A consequence of this
-  ** is that this function is invalid for synchronised TCP states.
-  */
   /*! ?? \TODO Check for dodgy source IP (to avoid broadcasting, for
   ** example).
   */
@@ -1729,6 +1877,7 @@ ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
   ci_ipx_hdr_t rip;
   ci_tcp_hdr* tcp;
   ci_ipx_hdr_t* ip;
+  int optlen = 0;
 
   ci_assert(netif);
   ASSERT_VALID_PKT(netif, pkt);
@@ -1773,34 +1922,46 @@ ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
   }
 #endif
 
+  if( tw != NULL ) {
+    ci_uint8* opt = CI_TCP_HDR_OPTS(tcp);
+    tcp->tcp_seq_be32 = CI_BSWAP_BE32(tw->snd_nxt);
+    tcp->tcp_flags = CI_TCP_FLAG_ACK;
+    tcp->tcp_ack_be32 = CI_BSWAP_BE32(tw->rcv_nxt);
+    tcp->tcp_window_be16 = tw->window_be16;
+    if( tw->tso )
+      optlen = ci_tcp_tx_opt_tso(&opt, ci_tcp_time_now(netif), tw->tsrecent);
+  }
   /* rfc793 p63-p75 describes ACK flag for RST generation
   ** if ACK flag set then use that as SEQ otherwise
   ** use 0 and fill out the ACK field of the reset segment
   */
-  if( (rtcp.tcp_flags & CI_TCP_FLAG_ACK) ) {
+  else if( (rtcp.tcp_flags & CI_TCP_FLAG_ACK) ) {
     tcp->tcp_seq_be32 = rtcp.tcp_ack_be32;
     tcp->tcp_flags = CI_TCP_FLAG_RST;
     tcp->tcp_ack_be32 = 0;
+    tcp->tcp_window_be16 = 0;
   } else {
     tcp->tcp_seq_be32 = 0;
     tcp->tcp_flags = CI_TCP_FLAG_RST | CI_TCP_FLAG_ACK;
     tcp->tcp_ack_be32 = CI_BSWAP_BE32(rtcp_endseq);
+    tcp->tcp_window_be16 = 0;
   }
-  CI_TCP_HDR_SET_LEN(tcp, sizeof(*tcp));
-  tcp->tcp_window_be16 = 0;
+  CI_TCP_HDR_SET_LEN(tcp, sizeof(*tcp) + optlen);
   tcp->tcp_check_be16 = 0;
-  ci_tcp_ipx_hdr_init(af, ip, CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr));
+  ci_tcp_ipx_hdr_init(af, ip,
+                      CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr) + optlen);
 
-  LOG_TR(log(LN_FMT "RSTACK "IPX_FMT":%u->"IPX_FMT":%u s=%08x a=%08x",
-             LN_PRI_ARGS(netif), IPX_ARG(AF_IP(ipx_hdr_saddr(af, ip))),
+  LOG_TR(log(LN_FMT "%s "IPX_FMT":%u->"IPX_FMT":%u s=%08x a=%08x",
+             LN_PRI_ARGS(netif), tw != NULL ? "TWACK" : "RSTACK",
+             IPX_ARG(AF_IP(ipx_hdr_saddr(af, ip))),
              (unsigned) CI_BSWAP_BE16(tcp->tcp_source_be16),
              IPX_ARG(AF_IP(ipx_hdr_daddr(af, ip))),
              (unsigned) CI_BSWAP_BE16(tcp->tcp_dest_be16),
              (unsigned) CI_BSWAP_BE32(tcp->tcp_seq_be32),
              (unsigned) CI_BSWAP_BE32(tcp->tcp_ack_be32)));
 
-  pkt->buf_len = pkt->pay_len = 
-    oo_tx_ether_hdr_size(pkt) + CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr);
+  pkt->buf_len = pkt->pay_len = oo_tx_ether_hdr_size(pkt) +
+    CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr) + optlen;
   if( pkt->intf_i == OO_INTF_I_LOOPBACK ) {
     ci_netif_pkt_hold(netif, pkt);
     ci_ip_local_send(netif, pkt, pkt->pf.tcp_tx.lo.rx_sock,
@@ -1815,7 +1976,30 @@ ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
   }
   CI_TCP_STATS_INC_OUT_SEGS(netif);
   ci_netif_pkt_release(netif, pkt);
-  CI_TCP_STATS_INC_OUT_RSTS( netif );
+  if( tw == NULL )
+    CI_TCP_STATS_INC_OUT_RSTS( netif );
+}
+
+
+void
+ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
+                      ciip_tcp_rx_pkt* rxp)
+{
+  /* If the incoming seg has an ACK, use that as the seq no, otherwise use
+  ** 0.  Calculate a proper ACK from the incoming seg.  A consequence of this
+  ** is that this function is invalid for synchronised TCP states.
+  */
+  __ci_tcp_reply(netif, sock_cp, rxp, NULL);
+}
+
+
+void
+ci_tcp_reply_from_tw_compact(ci_netif* netif,
+                             const struct oo_sock_cplane* sock_cp,
+                             ciip_tcp_rx_pkt* rxp,
+                             const ci_tcp_tw_compact_t* tw)
+{
+  __ci_tcp_reply(netif, sock_cp, rxp, tw);
 }
 
 
@@ -1944,6 +2128,33 @@ void ci_tcp_send_ack_loopback(ci_netif* netif, ci_tcp_state* ts)
              tcp_snd_nxt(peer), peer->snd_max, tcp_enq_nxt(peer)));
 }
 
+/* Queue an ACK on the dmaq rather than sending it now.  The end of
+ * ci_netif_poll_n() pushes the dmaqs, so the ACKs for all the sockets
+ * that received in this poll go to the NIC together.
+ */
+static void ci_tcp_send_ack_batched(ci_netif* netif, ci_tcp_state* ts,
+                                    ci_ip_pkt_fmt* pkt)
+{
+  oo_pktq* dmaq;
+  ef_vi* vi;
+
+  ci_assert(netif->state->ack_batch_active);
+  ci_assert(~ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE);
+
+#if CI_CFG_IPV6
+  if( ipcache_af(&ts->s.pkt) == AF_INET )
+    pkt->flags &=~ CI_PKT_FLAG_IS_IP6;
+  else
+    pkt->flags |= CI_PKT_FLAG_IS_IP6;
+#endif
+  ci_ip_set_mac_and_port(netif, &ts->s.pkt, pkt);
+  ci_netif_pkt_hold(netif, pkt);
+  __ci_netif_dmaq_insert_prep_pkt(netif, pkt);
+  ci_netif_dmaq_and_vi_for_pkt(netif, pkt, &dmaq, &vi);
+  __ci_netif_dmaq_put(netif, dmaq, pkt);
+  CITP_STATS_NETIF_INC(netif, acks_batched);
+}
+
 /* this function will always output an acknowledgement */
 void ci_tcp_send_ack_rx(ci_netif* netif, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt,
                         int sock_locked, int update_window)
@@ -2030,8 +2241,13 @@ void ci_tcp_send_ack_rx(ci_netif* netif, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt,
                    + sizeof(ci_tcp_hdr) + optlen );
   pkt->pay_len = pkt->buf_len;
 
+  ci_tcp_flight_record(netif, ts, CI_TCP_FLIGHT_TX, tcp->tcp_flags, 0,
+                       CI_BSWAP_BE32(tcp->tcp_seq_be32), tcp_rcv_nxt(ts));
   ci_tcp_tx_maybe_do_striping(pkt, ts);
-  __ci_ip_send_tcp(netif, pkt, ts);
+  if( ci_tcp_ack_may_batch(netif, ts) )
+    ci_tcp_send_ack_batched(netif, ts, pkt);
+  else
+    __ci_ip_send_tcp(netif, pkt, ts);
   CI_TCP_STATS_INC_OUT_SEGS(netif);
   CI_IP_SOCK_STATS_ADD_TXBYTE(ts,  pkt->buf_len);
   ci_netif_pkt_release(netif, pkt);
@@ -4,6 +4,20 @@
 #define __TCP_TX_H__
 
 
+/* May the ACK being built for [ts] be queued to the end of the poll
+ * (EF_TCP_ACK_BATCH)?  Only ci_netif_poll_n() sets [ack_batch_active], as
+ * only it pushes every dmaq when it finishes.  Other code that raises
+ * [in_poll], such as ci_netif_poll_intf_future(), sends its ACKs at once.
+ */
+ci_inline int ci_tcp_ack_may_batch(ci_netif* ni, ci_tcp_state* ts)
+{
+  return ni->state->ack_batch_active &&
+         ! (ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE) &&
+         ts->s.pkt.status == retrrc_success &&
+         oo_cp_ipcache_is_valid(ni, &ts->s.pkt);
+}
+
+
 /*
 ** Fill out the timestamp option on a given packet
 */
@@ -91,8 +91,12 @@ static void ci_udp_state_init(ci_netif* netif, ci_udp_state* us)
   us->tx_async_q = CI_ILL_END;
   oo_atomic_set(&us->tx_async_q_level, 0);
   us->tx_count = 0;
+  memset(&us->pace, 0, sizeof(us->pace));
   us->udpflags = CI_UDPF_MCAST_LOOP;
   us->future_intf_i = 0;
+  us->gso_size = 0;
+  us->ipid_next = 0;
+  us->ipid_left = 0;
   us->ip_pktinfo_cache.intf_i = -1;
   us->stamp = 0;
   memset(&us->stats, 0, sizeof(us->stats));
@@ -243,7 +247,8 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
   ci_udp_socket_stats uss = us->stats;
   unsigned rx_added = us->recv_q.pkts_added;
   unsigned rx_os = uss.n_rx_os + uss.n_rx_os_slow;
-  unsigned rx_total = rx_added + uss.n_rx_mem_drop + uss.n_rx_overflow + rx_os;
+  unsigned rx_total = rx_added + uss.n_rx_mem_drop + uss.n_rx_overflow +
+                      uss.n_rx_fanout_drop + rx_os;
   unsigned n_tx_onload = uss.n_tx_onload_uc + uss.n_tx_onload_c;
   unsigned tx_total = n_tx_onload + uss.n_tx_os;
   ci_ip_cached_hdrs* ipcache;
@@ -265,17 +270,23 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
   ci_udp_recvq_dump(ni, &us->recv_q, pf, "  rcv:", logger, log_arg);
   logger(log_arg,
          "%s  rcv: oflow_drop=%u(%u%%) mem_drop=%u eagain=%u pktinfo=%u "
-         "q_max_pkts=%u", pf, uss.n_rx_overflow,
+         "q_max_pkts=%u gro=%u", pf, uss.n_rx_overflow,
          percent(uss.n_rx_overflow, rx_total),
          uss.n_rx_mem_drop, uss.n_rx_eagain, uss.n_rx_pktinfo, 
-         uss.max_recvq_pkts);
+         uss.max_recvq_pkts, uss.n_rx_gro);
   logger(log_arg, "%s  rcv: os=%u(%u%%) os_slow=%u os_error=%u", pf,
          rx_os, percent(rx_os, rx_total), uss.n_rx_os_slow, uss.n_rx_os_error);
+  logger(log_arg, "%s  rcv: fanout=%u fanout_drop=%u(%u%%)", pf,
+         uss.n_rx_fanout, uss.n_rx_fanout_drop,
+         percent(uss.n_rx_fanout_drop, rx_total));
 
   /* Send path. */
   logger(log_arg, "%s  snd: q=%u+%u ul=%u os=%u(%u%%)", pf,
          us->tx_count, oo_atomic_read(&us->tx_async_q_level),
          n_tx_onload, uss.n_tx_os, percent(uss.n_tx_os, tx_total));
+  if( us->pace.rate != 0 )
+    logger(log_arg, "%s  snd: pacing rate=%"CI_PRIu64" tokens=%d", pf,
+           us->pace.rate, us->pace.tokens);
   logger(log_arg,
          "%s  snd: LOCK cp=%u(%u%%) pkt=%u(%u%%) snd=%u(%u%%) poll=%u(%u%%) "
          "defer=%u(%u%%)", pf,
@@ -317,8 +328,10 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
 
   logger(log_arg, "%s  snd: eagain=%d spin=%d block=%d", pf,
          uss.n_tx_eagain, uss.n_tx_spin, uss.n_tx_block);
-  logger(log_arg, "%s  snd: poll_avoids_full=%d fragments=%d confirm=%d", pf,
-         uss.n_tx_poll_avoids_full, uss.n_tx_fragments, uss.n_tx_msg_confirm);
+  logger(log_arg, "%s  snd: poll_avoids_full=%d fragments=%d confirm=%d "
+         "gso=%d gso_size=%d", pf, uss.n_tx_poll_avoids_full,
+         uss.n_tx_fragments, uss.n_tx_msg_confirm, uss.n_tx_gso,
+         us->gso_size);
   logger(log_arg,
          "%s  snd: os_slow=%d os_late=%d unconnect_late=%d nomac=%u(%u%%)", pf,
          uss.n_tx_os_slow, uss.n_tx_os_late, uss.n_tx_unconnect_late,
@@ -123,6 +123,8 @@ ci_inline void ci_udp_handle_rx_post_future(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     ci_assert_gt(pkt->pay_len, ip_paylen);
 
     oo_offbuf_set_start(&pkt->buf, udp + 1);
+    ci_udp_rx_latency_enqueue(ni, pkt);
+    OO_PROBE3(udp_enqueue, NI_ID(ni), S_ID(us), pkt->pf.udp.pay_len);
     ci_udp_recv_q_put(ni, &us->recv_q, pkt);
     us->s.b.sb_flags |= CI_SB_FLAG_RX_DELIVERED;
     ci_netif_put_on_post_poll(ni, &us->s.b);
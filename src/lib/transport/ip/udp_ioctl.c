@@ -21,7 +21,8 @@
 #include <onload/osfile.h>
 
 
-void ci_synchronise_clock(ci_netif *ni, struct oo_timesync* oo_ts_local)
+/* Returns true if the local copy was refreshed. */
+int ci_synchronise_clock(ci_netif *ni, struct oo_timesync* oo_ts_local)
 {
   ci_uint32 gc;
   struct oo_timesync *oo_ts = ni->timesync;
@@ -43,25 +44,29 @@ void ci_synchronise_clock(ci_netif *ni, struct oo_timesync* oo_ts_local)
       ci_rmb();
     } while (gc & 1 || gc != oo_ts->generation_count);
     oo_ts_local->generation_count = gc;
+    return 1;
   }
+  return 0;
 }
 
 
 void ci_udp_compute_stamp(ci_netif *ni, ci_uint64 stamp, struct timespec *ts)
 {
   ci_uint64 delta, delta_sec, delta_nsec;
-  struct oo_timesync* oo_ts_local;
+  struct oo_per_thread* pt = __oo_per_thread_get();
+  struct oo_timesync* oo_ts_local = &pt->timesync;
   double ns_rate;
 
-  oo_ts_local = &(__oo_per_thread_get()->timesync);
-  ci_synchronise_clock(ni, oo_ts_local);
+  /* The rate only changes when the kernel publishes a new datapoint, so
+   * divide once per update rather than once per timestamp. */
+  if( ci_synchronise_clock(ni, oo_ts_local) )
+    pt->timesync_ns_rate = (double)oo_ts_local->smoothed_ns /
+      (double)oo_ts_local->smoothed_ticks;
+  ns_rate = pt->timesync_ns_rate;
 
   ts->tv_sec = oo_ts_local->wall_clock.tv_sec;
   ts->tv_nsec = oo_ts_local->wall_clock.tv_nsec;
 
-  ns_rate = (double)oo_ts_local->smoothed_ns / 
-    (double)oo_ts_local->smoothed_ticks;
-  
   if( oo_ts_local->clock_made >= stamp ) {
     /* Calculate offset in nanosecs.  We have to use floating point
      * here and do division first as frc_delta * ns could overflow 64
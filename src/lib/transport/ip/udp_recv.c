@@ -111,6 +111,42 @@ ci_inline void ci_udp_recvmsg_fill_msghdr(ci_netif* ni, ci_msghdr* msg,
 }
 
 
+/* Record the latency of a datagram that is being delivered from the recv_q
+ * to the application.  Socket should be locked. */
+ci_inline void ci_udp_rx_latency_deliver(ci_netif* ni,
+                                         const ci_ip_pkt_fmt* pkt)
+{
+#if CI_CFG_RX_LATENCY_HIST
+  ci_netif_rx_latency* lat = &ni->state->rx_latency;
+  ci_uint64 now, enqueued;
+
+  if( CI_LIKELY(! ni->state->opts.rx_latency_hist) )
+    return;
+  enqueued = pkt->tstamp_frc + pkt->netif.rx.enqueue_cycles;
+  ci_frc64(&now);
+  ci_netif_rx_latency_add(lat->enqueue_to_recv,
+                          now > enqueued ? now - enqueued : 0);
+
+# if CI_CFG_TIMESTAMPING && ! defined(__KERNEL__)
+  /* The hardware timestamp is comparable with the poll's only when the
+   * adapter clock is synchronised to the system clock. */
+  if( pkt->hw_stamp.tv_nsec & CI_IP_PKT_HW_STAMP_FLAG_IN_SYNC ) {
+    struct timespec poll_ts;
+    ci_int64 ns;
+
+    ci_udp_compute_stamp(ni, pkt->tstamp_frc, &poll_ts);
+    ns = (poll_ts.tv_sec - (ci_int64) pkt->hw_stamp.tv_sec) * 1000000000 +
+         poll_ts.tv_nsec - pkt->hw_stamp.tv_nsec;
+    if( ns > 0 )
+      ci_netif_rx_latency_add(lat->hw_to_poll,
+                              CI_MIN(ns, 1000000000) *
+                              IPTIMER_STATE(ni)->khz / 1000000);
+  }
+# endif
+#endif
+}
+
+
 static int
 oo_copy_pkt_to_iovec_no_adv(ci_netif* ni, const ci_ip_pkt_fmt* pkt,
                             ci_iovec_ptr* piov, int bytes_to_copy)
@@ -234,6 +270,106 @@ static void ci_udp_filter_kernel_pkt(ci_netif* ni, ci_udp_state* us,
 #endif /* __KERNEL__ */
 
 
+#ifndef __KERNEL__
+/* Whether [next] can be merged by UDP_GRO with the datagram [pkt] before
+ * it: same flow, same interface, and not IP-fragmented. */
+static int ci_udp_gro_same_flow(ci_netif* ni, const ci_ip_pkt_fmt* pkt,
+                                const ci_ip_pkt_fmt* next)
+{
+  int af = oo_pkt_af(pkt);
+  const ci_udp_hdr* udp = oo_ipx_data(af, (ci_ip_pkt_fmt*) pkt);
+  const ci_udp_hdr* next_udp = oo_ipx_data(af, (ci_ip_pkt_fmt*) next);
+
+  return oo_pkt_af(next) == af && next->intf_i == pkt->intf_i &&
+         ! ((pkt->flags | next->flags) & CI_PKT_FLAG_INDIRECT) &&
+         OO_PP_IS_NULL(next->frag_next) &&
+         next_udp->udp_source_be16 == udp->udp_source_be16 &&
+         next_udp->udp_dest_be16 == udp->udp_dest_be16 &&
+         CI_IPX_ADDR_EQ(RX_PKT_SADDR((ci_ip_pkt_fmt*) next),
+                        RX_PKT_SADDR((ci_ip_pkt_fmt*) pkt)) &&
+         CI_IPX_ADDR_EQ(RX_PKT_DADDR((ci_ip_pkt_fmt*) next),
+                        RX_PKT_DADDR((ci_ip_pkt_fmt*) pkt));
+}
+
+
+/* UDP_GRO: count the datagrams at the head of the recv_q, starting with
+ * [pkt], that can be returned to the caller as one.  As with GRO in Linux
+ * they must be from the same flow and all of the size of the first except
+ * the last, which may be shorter.  They must also fit the caller's buffer,
+ * so that none is truncated.  Socket should be locked.
+ *
+ * Returns the number of datagrams and their total payload in [*bytes_out].
+ */
+static int ci_udp_recvmsg_gro_count(ci_netif* ni, ci_udp_state* us,
+                                    ci_ip_pkt_fmt* pkt,
+                                    const ci_iovec_ptr* piov, int* bytes_out)
+{
+  int seg_size = pkt->pf.udp.pay_len;
+  int space = ci_iovec_ptr_bytes_count(piov);
+  int max_bytes = CI_UDP_MAX_PAYLOAD_BYTES(oo_pkt_af(pkt));
+  /* Datagrams linked to the recv_q but not yet counted in [pkts_added] are
+   * not ours to take.  Each of those merged has a single buffer. */
+  int avail = ci_udp_recv_q_pkts(&us->recv_q);
+  int bytes = seg_size, n = 1;
+  ci_ip_pkt_fmt* next = pkt;
+
+  ci_rmb();
+  if( seg_size == 0 || (pkt->flags & CI_PKT_FLAG_INDIRECT) ||
+      OO_PP_NOT_NULL(pkt->frag_next) )
+    goto out;
+
+  while( n < CI_UDP_GSO_MAX_SEGS && n < avail &&
+         (next = ci_udp_recv_q_next(ni, next)) != NULL &&
+         next->pf.udp.pay_len != 0 && next->pf.udp.pay_len <= seg_size &&
+         bytes + next->pf.udp.pay_len <= CI_MIN(space, max_bytes) &&
+         ci_udp_gro_same_flow(ni, pkt, next) ) {
+    bytes += next->pf.udp.pay_len;
+    ++n;
+    if( next->pf.udp.pay_len < seg_size )
+      break;
+  }
+
+ out:
+  *bytes_out = bytes;
+  return n;
+}
+
+
+/* Copy the [n] datagrams counted by ci_udp_recvmsg_gro_count(), starting
+ * with [pkt], to [piov] back to back, and deliver them from the recv_q
+ * unless peeking.
+ */
+static int ci_udp_recvmsg_gro_copy(ci_udp_recv_info* rinf,
+                                   ci_ip_pkt_fmt* pkt, int n,
+                                   ci_iovec_ptr* piov)
+{
+  ci_netif* ni = rinf->a->ni;
+  ci_udp_state* us = rinf->a->us;
+  int peek = rinf->flags & MSG_PEEK;
+  int bytes = 0;
+
+  if( ! peek )
+    us->stats.n_rx_gro += n - 1;
+
+  while( 1 ) {
+    bytes += ci_copy_to_iovec(piov, oo_offbuf_ptr(&pkt->buf),
+                              pkt->pf.udp.pay_len);
+    if( ! peek ) {
+      ci_udp_rx_latency_deliver(ni, pkt);
+      ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
+    }
+    if( --n == 0 )
+      return bytes;
+    if( peek )
+      pkt = ci_udp_recv_q_next(ni, pkt);
+    else
+      pkt = ci_udp_recv_q_get(ni, &us->recv_q);
+    ci_assert(pkt);
+  }
+}
+#endif
+
+
 static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 {
   ci_netif* ni = rinf->a->ni;
@@ -241,6 +377,9 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
   ci_msghdr* msg = rinf->msg;
   ci_ip_pkt_fmt* pkt;
   int rc;
+#ifndef __KERNEL__
+  int gro_n = 1, gro_bytes;
+#endif
 
   /* NB. [msg] can be NULL for async recv. */
 
@@ -248,9 +387,17 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
     goto recv_q_is_empty;
 
 #ifndef __KERNEL__
+  if( CI_UNLIKELY(us->udpflags & CI_UDPF_GRO) && msg != NULL
+# if CI_CFG_ZC_RECV_FILTER
+      && ! us->recv_q_filter
+# endif
+      )
+    gro_n = ci_udp_recvmsg_gro_count(ni, us, pkt, piov, &gro_bytes);
+
   if( msg != NULL ) {
-    if( CI_UNLIKELY(us->s.cmsg_flags != 0 ) )
-      ci_ip_cmsg_recv(ni, us, pkt, msg, 0, &rinf->msg_flags);
+    if( CI_UNLIKELY((us->s.cmsg_flags != 0) | (gro_n > 1)) )
+      ci_ip_cmsg_recv(ni, us, pkt, msg, 0, &rinf->msg_flags,
+                      gro_n > 1 ? pkt->pf.udp.pay_len : 0);
     else
       msg->msg_controllen = 0;
   }
@@ -258,6 +405,18 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
   us->stamp = pkt->tstamp_frc;
   us->future_intf_i = pkt->intf_i;
 
+#ifndef __KERNEL__
+  if( CI_UNLIKELY(gro_n > 1) ) {
+    /* The whole train fits the caller's buffer, so is not truncated.  Take
+     * the source address first, as delivering [pkt] lets it be reaped. */
+    ci_udp_recvmsg_fill_msghdr(ni, msg, pkt, &us->s);
+    rc = ci_udp_recvmsg_gro_copy(rinf, pkt, gro_n, piov);
+    ci_assert_equal(rc, gro_bytes);
+    us->udpflags |= CI_UDPF_LAST_RECV_ON;
+    return rc;
+  }
+#endif
+
   rc = oo_copy_pkt_to_iovec_no_adv(ni, pkt, piov, pkt->pf.udp.pay_len);
 
   if(CI_LIKELY( rc >= 0 )) {
@@ -298,6 +457,7 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 # endif
 #endif
 
+      ci_udp_rx_latency_deliver(ni, pkt);
       ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
     }
     us->udpflags |= CI_UDPF_LAST_RECV_ON;
@@ -447,6 +607,18 @@ static int ci_udp_recvmsg_socklocked_slowpath(ci_udp_recv_info* rinf,
 
 #ifndef __KERNEL__
   if( rinf->flags & MSG_ERRQUEUE_CHK ) {
+    if( ci_sock_zc_pending(&us->s) ) {
+      struct cmsg_state cmsg_state;
+
+      cmsg_state.msg = rinf->msg;
+      cmsg_state.cm = rinf->msg->msg_control;
+      cmsg_state.cmsg_bytes_used = 0;
+      cmsg_state.p_msg_flags = &rinf->msg_flags;
+      ip_cmsg_recv_zc_notification(&us->s, &cmsg_state);
+      ci_ip_cmsg_finish(&cmsg_state);
+      rinf->msg_flags |= MSG_ERRQUEUE_CHK;
+      return SLOWPATH_RET_ZERO;
+    }
 #if CI_CFG_TIMESTAMPING
     ci_ip_pkt_fmt* pkt;
     if( (pkt = ci_udp_recv_q_get(ni, &us->timestamp_q)) != NULL ) {
@@ -514,6 +686,8 @@ struct recvmsg_spinstate {
   int spin_limit_by_so;
   ci_uint32 timeout;
 #ifndef __KERNEL__
+  /* Set if EF_SPIN_ADAPT chose max_spin */
+  int adapt;
   uint32_t poison;
   const volatile uint32_t* future;
   citp_signal_info* si;
@@ -618,9 +792,7 @@ ci_udp_recvmsg_socklocked_spin(ci_netif* ni, ci_udp_state* us,
 #endif
       if( ni->state->poll_work_outstanding ||
           ci_netif_need_poll_spinning(ni, now_frc) )
-        if( ci_netif_trylock(ni) ) {
-          ci_netif_poll(ni);
-          ci_netif_unlock(ni);
+        if( ci_netif_spin_poll(ni) ) {
 #ifndef __KERNEL__
           spin_state->future = &spin_state->poison;
 #endif
@@ -639,8 +811,19 @@ ci_udp_recvmsg_socklocked_spin(ci_netif* ni, ci_udp_state* us,
       return -EAGAIN;
     }
 
+#ifndef __KERNEL__
+    if( spin_state->adapt && spin_state->max_spin != 0 )
+      CITP_STATS_NETIF_INC(ni, spin_adapt_miss);
+#endif
     if( spin_state->timeout ) {
+#ifndef __KERNEL__
+      /* An adaptive spin may have been cut short. */
+      ci_uint32 spin_ms = spin_state->adapt ?
+        (now_frc - spin_state->start_frc) / IPTIMER_STATE(ni)->khz :
+        NI_OPTS(ni).spin_usec >> 10;
+#else
       ci_uint32 spin_ms = NI_OPTS(ni).spin_usec >> 10;
+#endif
       if( spin_ms < spin_state->timeout )
         spin_state->timeout -= spin_ms;
       else {
@@ -656,6 +839,39 @@ ci_udp_recvmsg_socklocked_spin(ci_netif* ni, ci_udp_state* us,
 }
 
 
+/* Decide without the sock lock whether a non-blocking receive would
+ * just fail with EAGAIN: nothing in the recv_q or the OS socket, no error
+ * pending and no poll due.  The recv_q counters are read unlocked, which
+ * is fine as a stale answer is indistinguishable from the datagram
+ * arriving just after the check.  Anything unusual goes the locked way.
+ */
+ci_inline int ci_udp_recvmsg_would_block(ci_udp_recv_info* rinf)
+{
+  ci_netif* ni = rinf->a->ni;
+  ci_udp_state* us = rinf->a->us;
+  ci_uint64 now_frc;
+
+  if( ! ((rinf->flags | us->s.b.sb_aflags) & MSG_DONTWAIT) ||
+      (rinf->flags & (MSG_OOB_CHK | MSG_ERRQUEUE_CHK)) ||
+      rinf->msg->msg_iovlen == 0 || rinf->msg->msg_iov == NULL ||
+      ci_udp_recv_q_not_empty(&us->recv_q) ||
+      (us->s.os_sock_status & OO_OS_STATUS_RX) ||
+      (us->udpflags & CI_UDPF_PEEK_FROM_OS) ||
+      UDP_RX_ERRNO(us) || us->s.so_error || ni->state->rxq_low )
+    return 0;
+#if CI_CFG_POSIX_RECV
+  if( udp_lport_be16(us) == 0 )
+    return 0;
+#endif
+  if( ci_netif_may_poll(ni) ) {
+    ci_frc64(&now_frc);
+    if( ci_netif_need_poll_spinning(ni, now_frc) )
+      return 0;
+  }
+  return 1;
+}
+
+
 static int 
 ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
 {
@@ -672,6 +888,14 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
 #endif
   spin_state.timeout = us->s.so.rcvtimeo_msec;
 
+  if( ! rinf->sock_locked && ci_udp_recvmsg_would_block(rinf) ) {
+    CI_SET_ERROR(rc, EAGAIN);
+    /* Other readers of this socket may be counting too. */
+    ci_atomic32_inc(&us->stats.n_rx_eagain);
+    ni->state->is_spinner = 0;
+    return rc;
+  }
+
   /* Grab the per-socket lock so we can access the receive queue. */
   if( !rinf->sock_locked ) {
     rc = ci_sock_lock(ni, &us->s.b);
@@ -769,6 +993,11 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
       spin_state.future = &spin_state.poison;
       spin_state.schedule_frc = spin_state.start_frc;
       spin_state.max_spin = us->s.b.spin_cycles;
+      if( NI_OPTS(ni).spin_adapt ) {
+        spin_state.adapt = 1;
+        spin_state.max_spin = ci_netif_spin_adapt_limit(ni, us,
+                                                        spin_state.max_spin);
+      }
       if( us->s.so.rcvtimeo_msec ) {
         ci_uint64 max_so_spin = (ci_uint64)us->s.so.rcvtimeo_msec *
             IPTIMER_STATE(ni)->khz;
@@ -805,6 +1034,11 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
   CI_SET_ERROR(rc, -rc);
 
  out:
+#ifndef __KERNEL__
+  if( spin_state.adapt && rc >= 0 )
+    ci_netif_spin_adapt_done(ni, us, spin_state.start_frc,
+                             spin_state.do_spin != 0);
+#endif
   ni->state->is_spinner = 0;
   return rc;
 
@@ -849,11 +1083,44 @@ int ci_udp_recvmsg(ci_udp_iomsg_args *a, ci_msghdr* msg, int flags)
     msg->msg_flags = rinf.msg_flags;
 #endif
 
+  OO_PROBE3(udp_recv, NI_ID(ni), S_ID(us), rc);
   return rc;
 }
 
 
 #ifndef __KERNEL__
+/* For the second and later messages of a recvmmsg(), which already hold
+ * the socket lock: take the next datagram straight from the receive queue
+ * if there is one and nothing needs the checks and polling of
+ * ci_udp_recvmsg_common().  Returns 1 and sets [*rc] if it did, else 0.
+ */
+static int ci_udp_recvmmsg_fast(ci_udp_recv_info* rinf, int* rc)
+{
+  ci_netif* ni = rinf->a->ni;
+  ci_udp_state* us = rinf->a->us;
+  ci_iovec_ptr piov;
+
+  ci_assert(rinf->sock_locked);
+
+  if( (rinf->flags & (MSG_OOB_CHK | MSG_ERRQUEUE_CHK)) |
+      (rinf->msg->msg_iovlen == 0) | (rinf->msg->msg_iov == NULL) |
+      ni->state->rxq_low | us->s.so_error |
+#if CI_CFG_POSIX_RECV
+      (udp_lport_be16(us) == 0) |
+#endif
+      (us->udpflags & CI_UDPF_PEEK_FROM_OS) |
+      ci_udp_recv_q_is_empty(&us->recv_q) )
+    return 0;
+
+#if HAVE_MSG_FLAGS
+  rinf->msg_flags = 0;
+#endif
+  ci_iovec_ptr_init_nz(&piov, rinf->msg->msg_iov, rinf->msg->msg_iovlen);
+  *rc = ci_udp_recvmsg_get(rinf, &piov);
+  return *rc >= 0;
+}
+
+
 int ci_udp_recvmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg, 
                     unsigned int vlen, int flags, 
                     const struct timespec* timeout)
@@ -877,7 +1144,8 @@ int ci_udp_recvmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
   i = 0;
   while( i < vlen ) {
     rinf.msg = &mmsg[i].msg_hdr;
-    rc = ci_udp_recvmsg_common(&rinf);
+    if( ! rinf.sock_locked || ! ci_udp_recvmmsg_fast(&rinf, &rc) )
+      rc = ci_udp_recvmsg_common(&rinf);
     if( rc >= 0 ) {
       mmsg[i].msg_len = rc;
 #if HAVE_MSG_FLAGS
@@ -1093,6 +1361,79 @@ static int ci_udp_zc_recv_from_os(ci_netif* ni, ci_udp_state* us,
 }
 
 
+/* Pass each datagram queued on [us] to the callback in [args], until the
+ * queue is empty or the callback asks us to stop.  [supplied] holds the
+ * caller's name and control buffers, which are reset for each datagram as the
+ * callback may change them.  Adds the number of datagrams delivered to
+ * [n_delivered], and returns the flags passed to the callback for the last.
+ */
+static unsigned
+ci_udp_zc_recv_q_drain(ci_netif* ni, ci_udp_state* us,
+                       struct onload_zc_recv_args* args,
+                       const struct msghdr* supplied,
+                       struct onload_zc_iovec* iovec,
+                       enum onload_zc_callback_rc* cb_rc_out,
+                       int* n_delivered)
+{
+  enum onload_zc_callback_rc cb_rc = ONLOAD_ZC_CONTINUE;
+  unsigned cb_flags = 0;
+  ci_ip_pkt_fmt* pkt;
+
+  while( (pkt = ci_udp_recv_q_get(ni, &us->recv_q)) != NULL ) {
+    /* Reinitialise our own state within [args] each time around the loop, as
+     * the app's callback might have changed it. */
+    args->msg.iov = iovec;
+    args->msg.msghdr.msg_name = supplied->msg_name;
+    args->msg.msghdr.msg_namelen = supplied->msg_namelen;
+    args->msg.msghdr.msg_flags = 0;
+
+    if( CI_UNLIKELY(us->s.cmsg_flags != 0 ) ) {
+      args->msg.msghdr.msg_controllen = supplied->msg_controllen;
+      args->msg.msghdr.msg_control = supplied->msg_control;
+      ci_ip_cmsg_recv(ni, us, pkt, &args->msg.msghdr, 0,
+                      &args->msg.msghdr.msg_flags, 0);
+    }
+    else
+      args->msg.msghdr.msg_controllen = 0;
+
+    ci_udp_recvmsg_fill_msghdr(ni, &args->msg.msghdr, pkt, 
+                               &us->s);
+
+    ci_udp_pkt_to_zc_msg(ni, pkt, &args->msg);
+
+    us->stamp = pkt->tstamp_frc;
+    us->udpflags |= CI_UDPF_LAST_RECV_ON;
+  
+    cb_flags = CI_IP_IS_MULTICAST(oo_ip_hdr(pkt)->ip_daddr_be32) ? 
+      ONLOAD_ZC_MSG_SHARED : 0;
+    if( (ci_udp_recv_q_pkts(&us->recv_q) == 1) &&
+        ((us->s.os_sock_status & OO_OS_STATUS_RX) == 0) )
+      cb_flags |= ONLOAD_ZC_END_OF_BURST;
+
+    /* Add KEEP flag before calling callback, and remove it after
+     * if not needed.  This prevents races where the app releases
+     * the pkt before we've added the flag.
+     */
+    pkt->rx_flags |= CI_PKT_RX_FLAG_KEEP;
+
+    cb_rc = (*args->cb)(args, cb_flags);
+
+    ci_pkt_zc_free_clean(pkt, cb_rc);
+
+    ci_udp_rx_latency_deliver(ni, pkt);
+    ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
+
+    ++*n_delivered;
+
+    if( cb_rc & ONLOAD_ZC_TERMINATE )
+      break;
+  }
+
+  *cb_rc_out = cb_rc;
+  return cb_flags;
+}
+
+
 int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
 {
   int rc, done_big_poll = 0, done_kernel_poll = 0, done_callback = 0;
@@ -1100,12 +1441,10 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
   ci_udp_state* us = a->us;
   enum onload_zc_callback_rc cb_rc = ONLOAD_ZC_CONTINUE;
   struct recvmsg_spinstate spin_state = {0};
-  size_t supplied_controllen = args->msg.msghdr.msg_controllen;
-  void* supplied_control = args->msg.msghdr.msg_control;
-  socklen_t supplied_namelen = args->msg.msghdr.msg_namelen;
-  void* supplied_name = args->msg.msghdr.msg_name;
+  struct msghdr supplied = args->msg.msghdr;
   struct onload_zc_iovec iovec[CI_UDP_ZC_IOVEC_MAX];
   unsigned cb_flags;
+  int n_delivered = 0;
 
   spin_state.do_spin = -1;
   spin_state.si = citp_signal_get_specific_inited();
@@ -1128,58 +1467,13 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
     goto empty;
 
   while( 1 ) {
-    ci_ip_pkt_fmt* pkt;
   not_empty:
-    cb_flags = 0;
-
-    while( (pkt = ci_udp_recv_q_get(ni, &us->recv_q)) != NULL ) {
-      /* Reinitialise our own state within [args] each time around the loop, as
-       * the app's callback might have changed it. */
-      args->msg.iov = iovec;
-      args->msg.msghdr.msg_name = supplied_name;
-      args->msg.msghdr.msg_namelen = supplied_namelen;
-      args->msg.msghdr.msg_flags = 0;
-
-      if( CI_UNLIKELY(us->s.cmsg_flags != 0 ) ) {
-        args->msg.msghdr.msg_controllen = supplied_controllen;
-        args->msg.msghdr.msg_control = supplied_control;
-        ci_ip_cmsg_recv(ni, us, pkt, &args->msg.msghdr, 0,
-                        &args->msg.msghdr.msg_flags);
-      }
-      else
-        args->msg.msghdr.msg_controllen = 0;
-
-      ci_udp_recvmsg_fill_msghdr(ni, &args->msg.msghdr, pkt, 
-                                 &us->s);
-
-      ci_udp_pkt_to_zc_msg(ni, pkt, &args->msg);
-
-      us->stamp = pkt->tstamp_frc;
-      us->udpflags |= CI_UDPF_LAST_RECV_ON;
-    
-      cb_flags = CI_IP_IS_MULTICAST(oo_ip_hdr(pkt)->ip_daddr_be32) ? 
-        ONLOAD_ZC_MSG_SHARED : 0;
-      if( (ci_udp_recv_q_pkts(&us->recv_q) == 1) &&
-          ((us->s.os_sock_status & OO_OS_STATUS_RX) == 0) )
-        cb_flags |= ONLOAD_ZC_END_OF_BURST;
-
-      /* Add KEEP flag before calling callback, and remove it after
-       * if not needed.  This prevents races where the app releases
-       * the pkt before we've added the flag.
-       */
-      pkt->rx_flags |= CI_PKT_RX_FLAG_KEEP;
-
-      cb_rc = (*args->cb)(args, cb_flags);
-
-      ci_pkt_zc_free_clean(pkt, cb_rc);
-
-      ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
-
+    cb_flags = ci_udp_zc_recv_q_drain(ni, us, args, &supplied, iovec,
+                                      &cb_rc, &n_delivered);
+    if( n_delivered != 0 )
       done_callback = 1;
-
-      if( cb_rc & ONLOAD_ZC_TERMINATE )
-        goto out;
-    }
+    if( cb_rc & ONLOAD_ZC_TERMINATE )
+      goto out;
 
     if( done_big_poll && done_kernel_poll && 
         (cb_flags & ONLOAD_ZC_END_OF_BURST) )
@@ -1239,10 +1533,10 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
     if( args->flags & ONLOAD_MSG_RECV_OS_INLINE ) {
       do {
         /* Restore these just in case they are needed */
-        args->msg.msghdr.msg_controllen = supplied_controllen;
-        args->msg.msghdr.msg_control = supplied_control;
-        args->msg.msghdr.msg_name = supplied_name;
-        args->msg.msghdr.msg_namelen = supplied_namelen;
+        args->msg.msghdr.msg_controllen = supplied.msg_controllen;
+        args->msg.msghdr.msg_control = supplied.msg_control;
+        args->msg.msghdr.msg_name = supplied.msg_name;
+        args->msg.msghdr.msg_namelen = supplied.msg_namelen;
         rc = ci_udp_zc_recv_from_os(ni, us, args, &cb_rc);
         done_callback = 1;
         if( rc != 0 || cb_rc & ONLOAD_ZC_TERMINATE ) {
@@ -1336,6 +1630,68 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
 }
 
 
+/* As ci_udp_zc_recv(), but delivers only the datagrams that are already
+ * waiting, without polling the stack and without blocking.  The caller is
+ * expected to have polled the stack on behalf of a batch of sockets.
+ * Returns the number of datagrams delivered, or -ve error.
+ */
+int ci_udp_zc_recv_ready(ci_udp_iomsg_args* a,
+                         struct onload_zc_recv_args* args)
+{
+  ci_netif* ni = a->ni;
+  ci_udp_state* us = a->us;
+  enum onload_zc_callback_rc cb_rc = ONLOAD_ZC_CONTINUE;
+  struct msghdr supplied = args->msg.msghdr;
+  struct onload_zc_iovec iovec[CI_UDP_ZC_IOVEC_MAX];
+  int rc, n_delivered = 0;
+
+  rc = ci_sock_lock(ni, &us->s.b);
+  if(CI_UNLIKELY( rc != 0 ))
+    return rc;
+
+#if CI_CFG_ZC_RECV_FILTER
+  ci_assert(!us->recv_q_filter);
+#endif
+
+  if( CI_UNLIKELY(us->s.so_error) ) {
+    if( (rc = ci_get_so_error(&us->s)) != 0 ) {
+      rc = -rc;
+      goto out;
+    }
+  }
+
+  if( ci_udp_recv_q_not_empty(&us->recv_q) )
+    ci_udp_zc_recv_q_drain(ni, us, args, &supplied, iovec,
+                           &cb_rc, &n_delivered);
+
+  while( ! (cb_rc & ONLOAD_ZC_TERMINATE) &&
+         (us->s.os_sock_status & OO_OS_STATUS_RX) ) {
+    if( ! (args->flags & ONLOAD_MSG_RECV_OS_INLINE) ) {
+      if( n_delivered == 0 )
+        rc = -ENOTEMPTY;
+      goto out;
+    }
+    args->msg.msghdr.msg_controllen = supplied.msg_controllen;
+    args->msg.msghdr.msg_control = supplied.msg_control;
+    args->msg.msghdr.msg_name = supplied.msg_name;
+    args->msg.msghdr.msg_namelen = supplied.msg_namelen;
+    rc = ci_udp_zc_recv_from_os(ni, us, args, &cb_rc);
+    if( rc != 0 )
+      goto out;
+    ++n_delivered;
+  }
+
+  if( n_delivered == 0 && (rc = UDP_RX_ERRNO(us)) ) {
+    rc = -rc;
+    us->s.rx_errno = us->s.rx_errno & 0xf0000000;
+  }
+
+ out:
+  ci_sock_unlock(ni, &us->s.b);
+  return rc < 0 ? rc : n_delivered;
+}
+
+
 int ci_udp_recvmsg_kernel(int fd, ci_netif* ni, ci_udp_state* us,
                           struct msghdr* msg, int flags)
 {
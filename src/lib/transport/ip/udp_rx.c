@@ -168,11 +168,20 @@ int ci_udp_rx_deliver(ci_sock_cmn* s, void* opaque_arg)
        * indirect packet needs to have some fields initialised that are
        * looked at on the receive path.  The indirect packet looks like an
        * empty "fragment" at the head of the real packet.
+       *
+       * Failing to get one is not memory pressure on this socket, which may
+       * be keeping up fine: count it separately so that a slow subscriber
+       * pinning the shared buffers can be told from a slow socket.
        */
       if( ni->state->n_rx_pkts > NI_OPTS(ni).max_rx_packets ||
-          (q_pkt = ci_netif_pkt_alloc(ni, 0)) == NULL )
-        goto drop;
+          (q_pkt = ci_netif_pkt_alloc(ni, 0)) == NULL ) {
+        LOG_UR(log(FNS_FMT "DROP (no buffer to share) pay_len=%d",
+                   FNS_PRI_ARGS(ni, s), pkt->pf.udp.pay_len));
+        ++us->stats.n_rx_fanout_drop;
+        return 0;  /* continue delivering to other sockets */
+      }
       ++ni->state->n_rx_pkts;
+      ++us->stats.n_rx_fanout;
       q_pkt->pf.udp.pay_len = pkt->pf.udp.pay_len;
       q_pkt->tstamp_frc = pkt->tstamp_frc;
 #if CI_CFG_TIMESTAMPING
@@ -187,6 +196,8 @@ int ci_udp_rx_deliver(ci_sock_cmn* s, void* opaque_arg)
       pkt = q_pkt;
     }
     ci_assert_nflags(pkt->rx_flags, CI_PKT_RX_FLAG_KEEP);
+    ci_udp_rx_latency_enqueue(ni, pkt);
+    OO_PROBE3(udp_enqueue, NI_ID(ni), S_ID(us), pkt->pf.udp.pay_len);
     ci_udp_recv_q_put(ni, &us->recv_q, pkt);
     us->s.b.sb_flags |= CI_SB_FLAG_RX_DELIVERED;
     ci_netif_put_on_post_poll(ni, &us->s.b);
@@ -213,7 +224,6 @@ int ci_udp_rx_deliver(ci_sock_cmn* s, void* opaque_arg)
   }
 
   /* Receive queue overflow or memory pressure. */
- drop:
   if( recvq_depth > ci_udp_recv_q_bytes2packets(us->s.so.rcvbuf) ) {
     LOG_UR(log(FNS_FMT "OVERFLOW pay_len=%d",
                FNS_PRI_ARGS(ni, s), pkt->pf.udp.pay_len));
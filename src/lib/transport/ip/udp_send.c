@@ -13,6 +13,7 @@
   
 /*! \cidoxg_lib_transport_ip */
   
+#define _GNU_SOURCE  /* for sendmmsg */
 #include "ip_internal.h"
 #include "udp_internal.h"
 #include "ip_tx.h"
@@ -24,6 +25,7 @@
 
 #ifndef __KERNEL__
 #include <ci/internal/efabcfg.h>
+#include <sys/socket.h>
 #endif
 
 
@@ -77,6 +79,12 @@ struct udp_send_info {
   int                   stack_locked;
   ci_uint32             timeout;
   int                   old_ipcache_updated;
+  ci_uint16             gso_size;
+  /* Set while sending the segments of a UDP_SEGMENT send or the messages
+   * of a sendmmsg(), which are queued to the dmaq and pushed together;
+   * [batch_queued] notes whether the last one was queued. */
+  int                   batch;
+  int                   batch_queued;
 };
 
 static bool ci_ipx_is_first_frag(int af, ci_ipx_hdr_t* ipx)
@@ -777,7 +785,17 @@ static void ci_udp_sendmsg_send(ci_netif* ni, ci_udp_state* us,
         oo_pkt_p next = pkt->next;
         prep_send_pkt(ni, us, pkt, ipcache);
         /* We've called ci_netif_pkt_hold() in ci_udp_sendmsg_fill(). */
-        ci_netif_send(ni, pkt);
+        if( sinf != NULL && sinf->batch ) {
+          oo_pktq* dmaq;
+          ef_vi* vi;
+          __ci_netif_dmaq_insert_prep_pkt(ni, pkt);
+          ci_netif_dmaq_and_vi_for_pkt(ni, pkt, &dmaq, &vi);
+          __ci_netif_dmaq_put(ni, dmaq, pkt);
+          sinf->batch_queued = 1;
+        }
+        else {
+          ci_netif_send(ni, pkt);
+        }
         if( OO_PP_IS_NULL(next) )
           break;
         pkt = PKT_CHK(ni, next);
@@ -1136,6 +1154,55 @@ static int ci_udp_sendmsg_wait(ci_netif* ni, ci_udp_state* us,
 }
   
 
+/* SO_MAX_PACING_RATE.  There is no transmit scheduler to hand datagrams
+ * to, so instead sendmsg() waits (or fails with EAGAIN if non-blocking)
+ * until the socket's token bucket has refilled.  The wait is a spin, with
+ * the stack unlocked, so pacing is intended for rates at which the gap
+ * between datagrams is short.  Other threads may be sending on the socket
+ * at the same time, so the bucket is only updated by
+ * ci_pacing_bucket_take().
+ *
+ * Returns 0 on success, -errno on failure.
+ */
+static int ci_udp_sendmsg_pace(ci_netif* ni, ci_udp_state* us,
+                               unsigned bytes_to_send, int flags,
+                               struct udp_send_info* sinf)
+{
+  ci_pacing_bucket* b = &us->pace;
+  ci_int32 depth = ci_pacing_bucket_depth(b, 2 * sinf->ipcache.mtu);
+  ci_int32 bytes = bytes_to_send + sizeof(ci_udp_hdr) +
+                   CI_IPX_HDR_SIZE(ipcache_af(&us->s.pkt));
+  ci_uint64 now_frc, schedule_frc;
+#ifndef __KERNEL__
+  citp_signal_info* si = citp_signal_get_specific_inited();
+#endif
+  int rc;
+
+  if( ! ci_pacing_bucket_take(ni, b, depth, bytes) ) {
+    ++ni->state->stats.udp_tx_paced;
+    if( (flags & MSG_DONTWAIT) ||
+        (us->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK|CI_SB_AFLAG_O_NDELAY)) ) {
+      ++us->stats.n_tx_eagain;
+      return -EAGAIN;
+    }
+    if( sinf->stack_locked ) {
+      ci_netif_unlock(ni);
+      sinf->stack_locked = 0;
+    }
+    ci_frc64(&schedule_frc);
+    do {
+      ci_frc64(&now_frc);
+      rc = OO_SPINLOOP_PAUSE_CHECK_SIGNALS(ni, now_frc, &schedule_frc,
+                                           us->s.so.sndtimeo_msec, NULL, si);
+      if( rc != 0 )
+        return rc;
+    } while( ! ci_pacing_bucket_take(ni, b, depth, bytes) );
+  }
+
+  return 0;
+}
+
+
 ci_inline ci_udp_hdr* udp_init(ci_udp_state* us, ci_ip_pkt_fmt* pkt,
                                unsigned payload_bytes, bool is_frag)
 {
@@ -1230,7 +1297,7 @@ int ci_udp_sendmsg_fill(ci_netif* ni, ci_udp_state* us,
   /* ID for IPv6 case should only be generated when fragmentation is really
    * required. */
   if( !IS_AF_INET6(af) || need_frag )
-    ipx_id = ci_next_ipx_id_be(af, ni);
+    ipx_id = ci_udp_next_ipx_id_be(af, ni, us);
 
   udp = udp_init(us, first_pkt, bytes_to_send, need_frag);
 
@@ -1372,6 +1439,117 @@ int ci_udp_sendmsg_fill(ci_netif* ni, ci_udp_state* us,
 }
 
 
+/* Send [pkt] as part of a batch, leaving it queued on the dmaq.  A
+ * reference to the last packet queued is kept in [last_queued] so we know
+ * which dmaq to push once the batch is complete.
+ */
+static void ci_udp_sendmsg_batch_send(ci_netif* ni, ci_udp_state* us,
+                                      ci_ip_pkt_fmt* pkt, int flags,
+                                      bool may_poll,
+                                      struct udp_send_info* sinf,
+                                      ci_ip_pkt_fmt** last_queued)
+{
+  ci_assert(sinf->batch);
+
+  sinf->rc = 0;
+  sinf->batch_queued = 0;
+  ci_udp_sendmsg_send(ni, us, pkt, flags, may_poll, sinf);
+  if( sinf->batch_queued ) {
+    if( *last_queued != NULL )
+      ci_netif_pkt_release(ni, *last_queued);
+    *last_queued = pkt;
+  }
+  else {
+    ci_netif_pkt_release(ni, pkt);
+  }
+}
+
+
+static void ci_udp_sendmsg_batch_push(ci_netif* ni,
+                                      ci_ip_pkt_fmt** last_queued)
+{
+  if( *last_queued != NULL ) {
+    ci_netif_dmaq_shove_for_pkt(ni, *last_queued, 0 /*is_fresh*/);
+    ci_netif_pkt_release(ni, *last_queued);
+    *last_queued = NULL;
+  }
+}
+
+
+/* UDP_SEGMENT: send [bytes_to_send] as a train of datagrams carrying
+ * [sinf->gso_size] bytes of payload each, the last possibly shorter.  The
+ * stack lock is taken once for the whole train, the route found by the
+ * caller is used for every segment, and the segments are posted to the
+ * NIC together.
+ */
+static
+void ci_udp_sendmsg_gso(ci_netif* ni, ci_udp_state* us, ci_iovec_ptr* piov,
+                        int bytes_to_send, int flags,
+                        struct udp_send_info* sinf)
+{
+  struct oo_pkt_filler pf;
+  ci_ip_pkt_fmt* last_queued = NULL;
+  int af = ipcache_af(&us->s.pkt);
+  int bytes_left = bytes_to_send;
+  int seg_bytes, rc = 0;
+#if CI_CFG_TIMESTAMPING
+  ci_uint32 ts_key = us->s.ts_key;
+#endif
+
+  if( ! sinf->stack_locked ) {
+#ifndef __KERNEL__
+    ci_netif_lock(ni);
+#else
+    if( ci_netif_lock(ni) < 0 ) {
+      sinf->rc = -ERESTARTSYS;
+      return;
+    }
+#endif
+    sinf->stack_locked = 1;
+    ++us->stats.n_tx_lock_snd;
+  }
+  ++us->stats.n_tx_gso;
+
+  pf.alloc_pkt = NULL;
+  sinf->batch = 1;
+  do {
+    seg_bytes = CI_MIN(bytes_left, sinf->gso_size);
+    rc = ci_udp_sendmsg_fill(ni, us, piov, seg_bytes, flags, &pf, sinf,
+                             false);
+    if( rc < 0 )
+      break;
+    bytes_left -= seg_bytes;
+#if CI_CFG_TIMESTAMPING
+    if( us->s.timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID )
+      pf.pkt->ts_key = ts_key;
+#endif
+    TX_PKT_SET_DADDR(af, pf.pkt, ipcache_raddr(&sinf->ipcache));
+    TX_PKT_IPX_UDP(af, pf.pkt, false)->udp_dest_be16 =
+        sinf->ipcache.dport_be16;
+
+    ci_udp_sendmsg_batch_send(ni, us, pf.pkt, flags,
+                              bytes_left == 0 && ci_netif_may_poll(ni),
+                              sinf, &last_queued);
+    rc = sinf->rc;
+  } while( rc >= 0 && bytes_left > 0 );
+  sinf->batch = 0;
+
+  ci_udp_sendmsg_batch_push(ni, &last_queued);
+
+#if CI_CFG_TIMESTAMPING
+  if( us->s.timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID )
+    ci_atomic32_inc(&us->s.ts_key);
+#endif
+
+  /* Segments already sent can't be recalled, so report them rather than a
+   * failure part way through the train. */
+  if( bytes_left < bytes_to_send )
+    sinf->rc = bytes_to_send - bytes_left;
+  else
+    sinf->rc = rc;
+}
+
+
 static
 void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
                            const ci_msghdr* msg, int flags,
@@ -1384,6 +1562,7 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
   int was_locked;
   int af = ipcache_af(&us->s.pkt);
   bool need_frag = false;
+  bool gso = false;
 
   /* Caller should guarantee the following: */
   ci_assert(ni);
@@ -1406,9 +1585,21 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     ci_iovec_ptr_init(&piov, NULL, 0);
   }
 
-  if( bytes_to_send > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
-      sizeof(ci_udp_hdr) )
+  if( sinf->gso_size != 0 && bytes_to_send > sinf->gso_size ) {
+    /* As Linux, each segment must fit the path MTU. */
+    if( sinf->gso_size > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
+                         sizeof(ci_udp_hdr) ||
+        bytes_to_send > (unsigned long) sinf->gso_size *
+                        CI_UDP_GSO_MAX_SEGS ) {
+      sinf->rc = -EINVAL;
+      return;
+    }
+    gso = true;
+  }
+  else if( bytes_to_send > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
+           sizeof(ci_udp_hdr) ) {
     need_frag = true;
+  }
 
   /* For now we don't allocate packets in advance, so init to NULL */
   pf.alloc_pkt = NULL;
@@ -1418,6 +1609,17 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     goto no_space_or_too_big;
 
  back_to_fast_path:
+  if( CI_UNLIKELY( us->pace.rate != 0 ) ) {
+    rc = ci_udp_sendmsg_pace(ni, us, bytes_to_send, flags, sinf);
+    if( rc != 0 ) {
+      sinf->rc = rc;
+      return;
+    }
+  }
+  if( gso ) {
+    ci_udp_sendmsg_gso(ni, us, &piov, bytes_to_send, flags, sinf);
+    return;
+  }
   was_locked = sinf->stack_locked;
   if( need_frag && is_sock_flag_always_df_set(&us->s, af) ) {
     /* We are trying to send too large a datagram with DontFragment bit */
@@ -1553,6 +1755,8 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
   sinf.used_ipcache = 0;
   sinf.old_ipcache_updated = 0;
   sinf.timeout = us->s.so.sndtimeo_msec;
+  sinf.gso_size = us->gso_size;
+  sinf.batch = 0;
 
 #ifndef __KERNEL__
 #ifdef __i386__
@@ -1564,7 +1768,7 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
 #else
   if(CI_UNLIKELY( CMSG_FIRSTHDR(msg) != NULL )) {
     void* info = NULL;
-    if( ci_ip_cmsg_send(msg, &info) != 0 || info != NULL )
+    if( ci_ip_cmsg_send(msg, &info, &sinf.gso_size) != 0 || info != NULL )
       goto send_via_os;
   }
 #endif
@@ -1780,5 +1984,173 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
     RET_WITH_ERRNO(-rc);
 }
 
+
+#ifndef __KERNEL__
+/* Whether ci_udp_sendmmsg() can send [msg] under the stack lock with the
+ * route already cached on the socket, without fragmenting or waiting for
+ * space.  If so, set the destination and MTU in [sinf] and return the
+ * payload length; otherwise return -1 and leave [msg] to ci_udp_sendmsg().
+ */
+static int ci_udp_sendmmsg_prep(ci_netif* ni, ci_udp_state* us,
+                                const ci_msghdr* msg,
+                                struct udp_send_info* sinf)
+{
+  ci_ip_cached_hdrs* ipcache;
+  unsigned long bytes = 0;
+  int i;
+
+  ci_assert(sinf->stack_locked);
+
+  if( (msg->msg_iov == NULL && msg->msg_iovlen != 0) ||
+      CMSG_FIRSTHDR(msg) != NULL ||
+      us->s.so_error | us->s.tx_errno | us->pace.rate | sinf->gso_size )
+    return -1;
+
+  for( i = 0; i < msg->msg_iovlen; ++i ) {
+    if( CI_IOVEC_BASE(&msg->msg_iov[i]) != NULL )
+      bytes += CI_IOVEC_LEN(&msg->msg_iov[i]);
+    else if( CI_IOVEC_LEN(&msg->msg_iov[i]) > 0 )
+      return -1;
+  }
+
+  if( msg->msg_namelen == 0 ) {
+    if( ! (us->s.s_flags & CI_SOCK_FLAG_CONNECTED) )
+      return -1;
+    ipcache = &us->s.pkt;
+    ci_ipcache_set_daddr(&sinf->ipcache, addr_any);
+  }
+  else {
+    /* Only a destination that matches the last one sent to, as then the
+     * route looked up for that is reused. */
+    ci_addr_t pkt_daddr;
+
+    if( msg->msg_name == NULL || ! msg_namelen_ok(AF_INET, msg->msg_namelen) ||
+        CI_SIN(msg->msg_name)->sin_family != AF_INET ||
+        ipcache_is_ipv6(&us->s.pkt) || udp_lport_be16(us) == 0 )
+      return -1;
+    ipcache = &us->ephemeral_pkt;
+    pkt_daddr = ci_get_addr(CI_SA(msg->msg_name));
+    if( CI_IPX_ADDR_IS_ANY(pkt_daddr) ||
+        ! CI_IPX_ADDR_EQ(pkt_daddr, ipcache_raddr(ipcache)) ||
+        ci_get_port(CI_SA(msg->msg_name)) != ipcache->dport_be16 )
+      return -1;
+    ci_ipcache_set_daddr(&sinf->ipcache, pkt_daddr);
+    sinf->ipcache.dport_be16 = ipcache->dport_be16;
+    ++us->stats.n_tx_cp_match;
+  }
+
+  if( ! oo_cp_ipcache_is_valid(ni, ipcache) ||
+      ipcache->status != retrrc_success ||
+      bytes > ipcache->mtu - CI_IPX_HDR_SIZE(ipcache_af(ipcache)) -
+              sizeof(ci_udp_hdr) ||
+      ! UDP_HAS_SENDQ_SPACE(us, bytes) ||
+      ! ci_netif_pkt_tx_can_alloc_now(ni) )
+    return -1;
+
+#if CI_CFG_IPV6
+  sinf->ipcache.ether_type = us->s.pkt.ether_type;
+#endif
+  sinf->ipcache.mtu = ipcache->mtu;
+  return bytes;
+}
+
+
+/* sendmmsg(): the stack lock is taken once for the whole vector, and
+ * datagrams that can reuse the socket's cached route are queued to the
+ * dmaq and posted to the NIC together.  Anything else is pushed out and
+ * sent by ci_udp_sendmsg() as usual.
+ */
+int ci_udp_sendmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
+                    unsigned int vlen, int flags)
+{
+  ci_netif* ni = a->ni;
+  ci_udp_state* us = a->us;
+  struct udp_send_info sinf;
+  struct oo_pkt_filler pf;
+  ci_ip_pkt_fmt* last_queued = NULL;
+  ci_iovec_ptr piov;
+  int af = ipcache_af(&us->s.pkt);
+  int rc = 0, bytes;
+  unsigned i = 0;
+
+  sinf.rc = 0;
+  sinf.stack_locked = 0;
+  sinf.used_ipcache = 0;
+  sinf.old_ipcache_updated = 0;
+  sinf.timeout = us->s.so.sndtimeo_msec;
+  sinf.gso_size = us->gso_size;
+  sinf.batch = 0;
+
+  while( i < vlen ) {
+    ci_msghdr* msg = &mmsg[i].msg_hdr;
+
+    bytes = -1;
+    if( ! (flags & (MSG_MORE | MSG_OOB)) ) {
+      if( ! sinf.stack_locked ) {
+        ci_netif_lock(ni);
+        sinf.stack_locked = 1;
+        ++us->stats.n_tx_lock_snd;
+      }
+      bytes = ci_udp_sendmmsg_prep(ni, us, msg, &sinf);
+    }
+
+    if( bytes < 0 ) {
+      ci_udp_sendmsg_batch_push(ni, &last_queued);
+      if( sinf.stack_locked ) {
+        ci_netif_unlock(ni);
+        sinf.stack_locked = 0;
+      }
+      if(CI_LIKELY( msg->msg_iov != NULL || msg->msg_iovlen == 0 )) {
+        rc = ci_udp_sendmsg(a, msg, flags);
+      }
+      else {
+        rc = -1;
+        errno = EFAULT;
+      }
+      if( rc < 0 )
+        return rc;
+      mmsg[i++].msg_len = rc;
+      continue;
+    }
+
+    if( msg->msg_iovlen > 0 )
+      ci_iovec_ptr_init_nz(&piov, msg->msg_iov, msg->msg_iovlen);
+    else
+      ci_iovec_ptr_init(&piov, NULL, 0);
+    pf.alloc_pkt = NULL;
+    rc = ci_udp_sendmsg_fill(ni, us, &piov, bytes, flags, &pf, &sinf, false);
+    if( rc < 0 )
+      break;
+#if CI_CFG_TIMESTAMPING
+    if( us->s.timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID ) {
+      pf.pkt->ts_key = us->s.ts_key;
+      ci_atomic32_inc(&us->s.ts_key);
+    }
+#endif
+    TX_PKT_SET_DADDR(af, pf.pkt, ipcache_raddr(&sinf.ipcache));
+    TX_PKT_IPX_UDP(af, pf.pkt, false)->udp_dest_be16 =
+        sinf.ipcache.dport_be16;
+
+    sinf.batch = 1;
+    ci_udp_sendmsg_batch_send(ni, us, pf.pkt, flags,
+                              i + 1 == vlen && ci_netif_may_poll(ni),
+                              &sinf, &last_queued);
+    sinf.batch = 0;
+    if( (rc = sinf.rc) < 0 )
+      break;
+    mmsg[i++].msg_len = bytes;
+  }
+
+  ci_udp_sendmsg_batch_push(ni, &last_queued);
+  if( sinf.stack_locked )
+    ci_netif_unlock(ni);
+  if( rc < 0 ) {
+    CI_SET_ERROR(rc, -rc);
+    return rc;
+  }
+  return i;
+}
+#endif
+
 #endif
 /*! \cidoxg_end */
@@ -270,16 +270,255 @@ static void citp_epoll_sb_state_set(struct citp_epoll_member* eitem,
 }
 
 
+/* Satellite stacks (EF_EPOLL_MULTI_STACK): see struct citp_epoll_satellite.
+ * The functions below require the epoll lock.
+ */
+
+static void citp_epoll_satellite_release(struct citp_epoll_fd* ep, int i,
+                                         int fdt_locked)
+{
+  struct citp_epoll_satellite* sat = &ep->satellites[i];
+  ci_int32 slot = i;
+
+  ci_assert(sat->ni);
+  ci_assert_equal(sat->n_members, 0);
+
+  Log_POLL(ci_log("%s: release ready list %d stack %s", __FUNCTION__,
+                  sat->ready_list, sat->ni->state->pretty_name));
+  ci_sys_ioctl(ep->epfd_os, OO_EPOLL1_IOC_REMOVE_SATELLITE, &slot);
+  ci_netif_put_ready_list(sat->ni, sat->ready_list);
+  citp_netif_release_ref(sat->ni, fdt_locked);
+  sat->ni = NULL;
+}
+
+static void citp_epoll_satellites_release_all(struct citp_epoll_fd* ep,
+                                              int fdt_locked)
+{
+  int i;
+
+  for( i = 0; i < CITP_EPOLL_SATELLITES_MAX; ++i )
+    if( ep->satellites[i].ni != NULL ) {
+      ep->satellites[i].n_members = 0;
+      citp_epoll_satellite_release(ep, i, fdt_locked);
+    }
+  ep->satellite_members_n = 0;
+}
+
+/* Returns the index of the satellite for [ni], claiming a ready list in
+ * [ni] if needed, or -1 if we can't. */
+static int citp_epoll_satellite_get(struct citp_epoll_fd* ep, ci_netif* ni)
+{
+  struct oo_epoll1_satellite_arg op;
+  struct citp_epoll_satellite* sat;
+  int i, free_i = -1, n = 0;
+
+  for( i = 0; i < CITP_EPOLL_SATELLITES_MAX; ++i ) {
+    if( ep->satellites[i].ni == ni )
+      return i;
+    if( ep->satellites[i].ni != NULL )
+      ++n;
+    else if( free_i < 0 )
+      free_i = i;
+  }
+  if( free_i < 0 || n >= CITP_OPTS.ul_epoll_multi_stack )
+    return -1;
+
+  sat = &ep->satellites[free_i];
+  sat->ready_list = ci_netif_get_ready_list(ni);
+  if( sat->ready_list < 0 )
+    return -1;
+
+  /* Tell the driver, so that it gives the ready list back if we exit
+   * without doing so. */
+  op.sockfd = ci_netif_get_driver_handle(ni);
+  op.ready_list = sat->ready_list;
+  op.slot = free_i;
+  if( ci_sys_ioctl(ep->epfd_os, OO_EPOLL1_IOC_ADD_SATELLITE, &op) != 0 ) {
+    ci_netif_put_ready_list(ni, sat->ready_list);
+    return -1;
+  }
+
+  Log_POLL(ci_log("%s: satellite %d using ready list %d stack %s",
+                  __FUNCTION__, free_i, sat->ready_list,
+                  ni->state->pretty_name));
+  citp_netif_add_ref(ni);
+  sat->ni = ni;
+  sat->n_members = 0;
+  sat->quiet = 0;
+  sat->n_events = 0;
+  return free_i;
+}
+
+static void citp_epoll_satellite_attach(struct citp_epoll_fd* ep,
+                                        struct citp_epoll_member* eitem,
+                                        citp_socket* sock)
+{
+  ci_netif* ni = sock->netif;
+  struct citp_epoll_satellite* sat;
+  ci_sb_epoll_state* epoll;
+  struct oo_p_dllink_state link, unready_list;
+  int i;
+
+  ci_assert_equal(eitem->satellite, -1);
+  ci_assert_equal(eitem->ready_list_id, -1);
+
+  if( CITP_OPTS.ul_epoll_multi_stack == 0 || CITP_OPTS.ul_epoll != 3 ||
+      ep->home_stack == NULL || ni == ep->home_stack )
+    return;
+  if( citp_epoll_sb_state_alloc(sock) != 0 )
+    return;
+  if( (i = citp_epoll_satellite_get(ep, ni)) < 0 )
+    return;
+
+  sat = &ep->satellites[i];
+  epoll = ci_ni_aux_p2epoll(ni, sock->s->b.epoll);
+  link = ci_sb_epoll_ready_link(ni, epoll, sat->ready_list);
+
+  ci_netif_lock(ni);
+  /* The socket may still be on our list if it was a member before and we
+   * lost track of it, see citp_epoll_satellite_detach(). */
+  if( sock->s->b.ready_lists_in_use & (1 << sat->ready_list) )
+    oo_p_dllink_del(ni, link);
+  else
+    sock->s->b.ready_lists_in_use |= 1 << sat->ready_list;
+  CI_USER_PTR_SET(epoll->e[sat->ready_list].eitem, eitem);
+  unready_list = oo_p_dllink_ptr(ni,
+                                 &ni->state->unready_lists[sat->ready_list]);
+  oo_p_dllink_add_tail(ni, unready_list, link);
+  ci_netif_unlock(ni);
+
+  eitem->satellite = i;
+  ++sat->n_members;
+  ++ep->satellite_members_n;
+  /* It may be ready already. */
+  sat->quiet = 0;
+}
+
+/* [fd_fdi] is the member's fdinfo, or NULL if we no longer have it.  In
+ * that case the socket is left on our ready list until it is freed or we
+ * give the list back.  That is harmless: it can only make us look at the
+ * satellite's members when we need not.
+ *
+ * The ready list is not given back here, but by citp_epoll_satellites_poll()
+ * when it finds no members, because we may have the fdtable lock here.
+ */
+static void citp_epoll_satellite_detach(struct citp_epoll_fd* ep,
+                                        struct citp_epoll_member* eitem,
+                                        citp_fdinfo* fd_fdi)
+{
+  struct citp_epoll_satellite* sat;
+  citp_socket* sock;
+
+  if( eitem->satellite < 0 )
+    return;
+  sat = &ep->satellites[eitem->satellite];
+  ci_assert(sat->ni);
+  ci_assert_gt(sat->n_members, 0);
+
+  if( fd_fdi != NULL && citp_fdinfo_is_socket(fd_fdi) &&
+      (sock = fdi_to_socket(fd_fdi))->netif == sat->ni &&
+      OO_PP_NOT_NULL(sock->s->b.epoll) ) {
+    ci_netif_lock(sat->ni);
+    if( sock->s->b.ready_lists_in_use & (1 << sat->ready_list) ) {
+      ci_sb_epoll_state* epoll = ci_ni_aux_p2epoll(sat->ni, sock->s->b.epoll);
+      struct oo_p_dllink_state link =
+              ci_sb_epoll_ready_link(sat->ni, epoll, sat->ready_list);
+
+      sock->s->b.ready_lists_in_use &=~ (1 << sat->ready_list);
+      oo_p_dllink_del(sat->ni, link);
+      oo_p_dllink_init(sat->ni, link);
+    }
+    ci_netif_unlock(sat->ni);
+  }
+
+  eitem->satellite = -1;
+  --sat->n_members;
+  --ep->satellite_members_n;
+}
+
+/* Poll each satellite stack once, and see whether any of its members has
+ * been woken since we last looked.  Nothing but the emptiness of the ready
+ * list matters, so we just move everything back to the unready list.
+ */
+static void citp_epoll_satellites_poll(struct oo_ul_epoll_state*
+                                       __restrict__ eps)
+{
+  struct citp_epoll_fd* ep = eps->ep;
+  struct citp_epoll_satellite* sat;
+  struct oo_p_dllink_state ready_list, unready_list, lnk, tmp;
+  ci_netif* ni;
+  int i, locked;
+
+  for( i = 0; i < CITP_EPOLL_SATELLITES_MAX; ++i ) {
+    sat = &ep->satellites[i];
+    if( (ni = sat->ni) == NULL )
+      continue;
+    if( sat->n_members == 0 ) {
+      citp_epoll_satellite_release(ep, i, 0);
+      continue;
+    }
+
+    sat->n_events = 0;
+    locked = 0;
+    if( ! eps->ordering_info )
+      locked = __citp_poll_if_needed(ni, eps->this_poll_frc,
+                                     eps->ul_epoll_spin);
+    ready_list = oo_p_dllink_ptr(ni, &ni->state->ready_lists[sat->ready_list]);
+    if( ! oo_p_dllink_is_empty(ni, ready_list) ) {
+      if( ! locked ) {
+        ci_netif_lock(ni);
+        locked = 1;
+      }
+      unready_list =
+        oo_p_dllink_ptr(ni, &ni->state->unready_lists[sat->ready_list]);
+      oo_p_dllink_for_each_safe(ni, lnk, tmp, ready_list) {
+        oo_p_dllink_del(ni, lnk);
+        oo_p_dllink_add_tail(ni, unready_list, lnk);
+      }
+      sat->quiet = 0;
+    }
+    if( locked )
+      ci_netif_unlock(ni);
+  }
+}
+
+/* True if every member of [oo_sockets] is in a quiet satellite. */
+static int citp_epoll_satellites_all_quiet(struct citp_epoll_fd* ep)
+{
+  int i;
+
+  if( ep->satellite_members_n == 0 ||
+      ep->satellite_members_n != ep->oo_sockets_n )
+    return 0;
+  for( i = 0; i < CITP_EPOLL_SATELLITES_MAX; ++i )
+    if( ep->satellites[i].n_members != 0 && ! ep->satellites[i].quiet )
+      return 0;
+  return 1;
+}
+
+/* Called when a pass over [oo_sockets] has looked at every member. */
+static void citp_epoll_satellites_pass_done(struct citp_epoll_fd* ep)
+{
+  int i;
+
+  for( i = 0; i < CITP_EPOLL_SATELLITES_MAX; ++i )
+    if( ep->satellites[i].ni != NULL )
+      ep->satellites[i].quiet = ep->satellites[i].n_events == 0;
+}
+
+
 static void
 citp_epoll_promote_to_home(struct citp_epoll_member* eitem, citp_fdinfo* fd_fdi,
                            citp_socket* sock, struct citp_epoll_fd* ep)
 {
   Log_POLL(ci_log("%s:  fd %d", __FUNCTION__, eitem->fd));
+  citp_epoll_satellite_detach(ep, eitem, fd_fdi);
   /* Sockets from the oo_sockets list are added to the OS epoll set.
    * We'll handle it when deleting them, see citp_epoll_ctl_onload_del().
    */
   ci_dllist_remove_safe(&eitem->dllink);
   ep->oo_sockets_n--;
+  ep->oo_sockets_gen++;
   eitem->item_list = &ep->oo_stack_sockets;
   eitem->ready_list_id = ep->ready_list;
   eitem->flags &=~ CITP_EITEM_FLAG_POLL_END;
@@ -489,6 +728,9 @@ static void citp_epoll_dtor(citp_fdinfo* fdi, int fdt_locked)
 #endif
 
   citp_epoll_purge_other_socks(ep);
+#if CI_CFG_EPOLL3
+  citp_epoll_satellites_release_all(ep, fdt_locked);
+#endif
 
   if( ! fdt_locked )  CITP_FDTABLE_LOCK();
   ci_tcp_helper_close_no_trampoline(ep->shared->epfd);
@@ -502,6 +744,9 @@ static void citp_epoll_dtor(citp_fdinfo* fdi, int fdt_locked)
 #if CI_CFG_TIMESTAMPING
   ci_free(ep->ordering_info);
   ci_free(ep->wait_events);
+  while( ep->n_ordering_stacks > 0 )
+    citp_netif_release_ref(ep->ordering_stacks[--ep->n_ordering_stacks],
+                           fdt_locked);
 #endif
 
   CI_FREE_OBJ(ep);
@@ -636,9 +881,12 @@ int citp_epoll_create(int size, int flags)
   ci_dllist_init(&ep->dead_stack_sockets);
   ep->home_stack = NULL;
   ep->ready_list = -1;
+  memset(ep->satellites, 0, sizeof(ep->satellites));
+  ep->satellite_members_n = 0;
 #endif
   ci_dllist_init(&ep->oo_sockets);
   ep->oo_sockets_n = 0;
+  ep->oo_sockets_gen = 0;
   ci_dllist_init(&ep->dead_sockets);
   oo_atomic_set(&ep->refcount, 1);
   ep->epfd_syncs_needed = 0;
@@ -647,6 +895,8 @@ int citp_epoll_create(int size, int flags)
   ep->ordering_info = NULL;
   ep->wait_events = NULL;
   ep->n_woda_events = 0;
+  ep->n_ordering_stacks = 0;
+  ep->ordering_stacks_gen = 0;
 #endif
   ep->avoid_spin_once = 0;
   ep->closing = 0;
@@ -787,6 +1037,7 @@ static void citp_eitem_init(struct citp_epoll_member* eitem,
   eitem->fdi_seq = fd_fdi->seq;
 #if CI_CFG_EPOLL3
   eitem->ready_list_id = -1;
+  eitem->satellite = -1;
   ci_dllink_self_link(&eitem->dead_stack_link);
 #endif
   eitem->flags = 0;
@@ -827,6 +1078,7 @@ static void citp_epoll_ctl_onload_add_other(struct citp_epoll_member* eitem,
   eitem->flags &=~ CITP_EITEM_FLAG_POLL_END;
   ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
   ep->oo_sockets_n++;
+  ep->oo_sockets_gen++;
 
 #if CI_CFG_FD_CACHING
   /* We need to be able to autopop at user level if we want to cache, and that
@@ -949,6 +1201,9 @@ static int citp_epoll_ctl_onload_add_new(struct citp_epoll_member** eitem_out,
   {
     citp_epoll_ctl_onload_add_other(*eitem_out, ep, sync_kernel, fd_fdi,
                                     epoll_fd, epoll_fd_seq);
+#if CI_CFG_EPOLL3
+    citp_epoll_satellite_attach(ep, *eitem_out, sock);
+#endif
     CITP_STATS_NETIF_INC(ni, epoll_add_non_home);
   }
 
@@ -982,6 +1237,11 @@ static void citp_epoll_ctl_onload_readd(struct citp_epoll_member* eitem,
 
   ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
   ep->oo_sockets_n++;
+  ep->oo_sockets_gen++;
+#if CI_CFG_EPOLL3
+  if( citp_fdinfo_is_socket(fd_fdi) )
+    citp_epoll_satellite_attach(ep, eitem, fdi_to_socket(fd_fdi));
+#endif
 
   if( ci_cas32_succeed(&fd_fdi->epoll_fd, -1, epoll_fd) )
     fd_fdi->epoll_fd_seq = epoll_fd_seq;
@@ -1045,6 +1305,11 @@ static int citp_epoll_ctl_onload_mod(struct citp_epoll_member* eitem,
 #endif
             !citp_eitem_is_synced(eitem) )
       ++ep->epfd_syncs_needed;
+#if CI_CFG_EPOLL3
+    /* The new events may be ready without a wakeup. */
+    if( eitem->satellite >= 0 )
+      ep->satellites[eitem->satellite].quiet = 0;
+#endif
 
     /* Reinsert at front to exploit locality of reference if there
      * are many sockets and EPOLL_CTL_MOD is frequent.
@@ -1090,8 +1355,12 @@ static int citp_epoll_ctl_onload_del(struct citp_epoll_member* eitem,
     else
 #endif
     {
+#if CI_CFG_EPOLL3
+      citp_epoll_satellite_detach(ep, eitem, fd_fdi);
+#endif
       ci_dllist_remove(&eitem->dllink);
       ep->oo_sockets_n--;
+      ep->oo_sockets_gen++;
       if( eitem->epfd_event.events == EP_NOT_REGISTERED ) {
         *sync_kernel = 0;
         CI_FREE_OBJ(eitem);
@@ -1449,8 +1718,12 @@ static void citp_ul_epoll_ctl_sync(struct citp_epoll_fd* ep, int epfd)
         eitem->flags |= CITP_EITEM_FLAG_OS_SYNC;
       }
       else {
+#if CI_CFG_EPOLL3
+        citp_epoll_satellite_detach(ep, eitem, NULL);
+#endif
         ci_dllist_remove(&eitem->dllink);
         ep->oo_sockets_n--;
+        ep->oo_sockets_gen++;
         CI_FREE_OBJ(eitem);
       }
       if( --ep->epfd_syncs_needed == 0 )
@@ -1522,8 +1795,12 @@ static int citp_ul_epoll_one(struct oo_ul_epoll_state*__restrict__ eps,
     Log_POLL(ci_log("%s: auto remove fd %d from epoll set",
                     __FUNCTION__, eitem->fd));
 
+#if CI_CFG_EPOLL3
+    citp_epoll_satellite_detach(eps->ep, eitem, NULL);
+#endif
     ci_dllist_remove(&eitem->dllink);
     eps->ep->oo_sockets_n--;
+    eps->ep->oo_sockets_gen++;
     CI_FREE_OBJ(eitem);
   }
 
@@ -1643,9 +1920,25 @@ static void citp_epoll_poll_ul_other(struct oo_ul_epoll_state* __restrict__ eps)
 {
   struct citp_epoll_member* eitem;
   ci_dllink *next, *last;
+#if CI_CFG_EPOLL3
+  struct citp_epoll_satellite* sat;
+  int skip_quiet;
+#endif
 
   ci_assert( eps->events < eps->events_top );
 
+#if CI_CFG_EPOLL3
+  if( CITP_OPTS.ul_epoll_multi_stack ) {
+    citp_epoll_satellites_poll(eps);
+    if( citp_epoll_satellites_all_quiet(eps->ep) ) {
+      eps->phase = EPOLL_PHASE_DONE_OTHER;
+      return;
+    }
+  }
+  /* We must look at every member if we are looking for a spinning one. */
+  skip_quiet = ! (eps->ul_epoll_spin & (1 << ONLOAD_SPIN_SO_BUSY_POLL));
+#endif
+
   if( ci_dllist_not_empty(&eps->ep->oo_sockets) ) {
     if( citp_fdtable_not_mt_safe() )
       CITP_FDTABLE_LOCK_RD();
@@ -1659,11 +1952,26 @@ static void citp_epoll_poll_ul_other(struct oo_ul_epoll_state* __restrict__ eps)
       if( eitem->flags & CITP_EITEM_FLAG_POLL_END )
         eps->phase |= EPOLL_PHASE_DONE_OTHER;
       next = next->next;
+#if CI_CFG_EPOLL3
+      if( eitem->satellite >= 0 ) {
+        /* NB. The eitem may be freed by citp_ul_epoll_one(). */
+        sat = &eps->ep->satellites[eitem->satellite];
+        if( skip_quiet && sat->quiet )
+          continue;
+        if( citp_ul_epoll_one(eps, eitem) )
+          ++sat->n_events;
+        continue;
+      }
+#endif
       citp_ul_epoll_one(eps, eitem);
     } while( eps->events < eps->events_top && &eitem->dllink != last );
 
-    if( &eitem->dllink == last )
+    if( &eitem->dllink == last ) {
       eps->phase = EPOLL_PHASE_DONE_OTHER;
+#if CI_CFG_EPOLL3
+      citp_epoll_satellites_pass_done(eps->ep);
+#endif
+    }
 
     if( citp_fdtable_not_mt_safe() )
       CITP_FDTABLE_UNLOCK_RD();
@@ -1698,6 +2006,11 @@ static void citp_epoll_poll_ul(struct oo_ul_epoll_state*__restrict__ eps)
 }
 
 
+/* Collect events from the fds that Onload does not accelerate, such as
+ * eventfd and timerfd, which live in the kernel epoll set.  The driver
+ * sets OO_EPOLL1_FLAG_EVENT when that set becomes ready, so the common
+ * case of none of them being ready costs no system call.
+ */
 ci_inline int citp_epoll_os_fds(citp_epoll_fdi *efdi,
                                 struct epoll_event* events,
                                 struct citp_ordering_info* ordering_info,
@@ -1777,6 +2090,20 @@ citp_epoll_ctl_try_sync(struct citp_epoll_fd* ep, citp_fdinfo* fdi,
 }
 
 
+/* Record the end of a wait for EF_SPIN_ADAPT.  Statistics go to the home
+ * stack, if there is one. */
+static void citp_epoll_spin_adapt_done(struct citp_epoll_fd* ep,
+                                       ci_uint64 start_frc, int spinning)
+{
+  oo_spin_adapt_record(ep, ci_frc64_get() - start_frc, citp.cpu_khz);
+#if CI_CFG_EPOLL3
+  if( spinning && ep->home_stack != NULL ) {
+    CITP_STATS_NETIF_INC(ep->home_stack, spin_adapt_hit);
+  }
+#endif
+}
+
+
 int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
                     struct citp_ordered_wait* ordering, int maxevents,
                     ci_int64 timeout_hr, const sigset_t *sigmask,
@@ -1789,6 +2116,8 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
   sigset_t sigsaved;
   int pwait_was_spinning = 0;
   int have_spin = 0;
+  ci_uint64 spin_cycles = citp.spin_cycles;
+  int spin_adapt = 0;
 
   ci_assert_ge(timeout_hr, 0);
   ci_assert_le(timeout_hr, OO_EPOLL_MAX_TIMEOUT_HR);
@@ -1867,6 +2196,15 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
   if( eps.ul_epoll_spin ) {
     eps.ul_epoll_spin |=
       oo_per_thread_get()->spinstate & (1 << ONLOAD_SPIN_SO_BUSY_POLL);
+    if( CITP_OPTS.ul_spin_adapt ) {
+      spin_adapt = 1;
+      spin_cycles = oo_spin_adapt_limit(ep, spin_cycles, citp.cpu_khz);
+#if CI_CFG_EPOLL3
+      if( spin_cycles == 0 && ep->home_stack != NULL ) {
+        CITP_STATS_NETIF_INC(ep->home_stack, spin_adapt_skip);
+      }
+#endif
+    }
   }
 
   if(CI_UNLIKELY( eps.phase )) {
@@ -1988,6 +2326,8 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
      * events are probably past the limit being used for ordering.  Tell caller
      * that it would be worth polling again.
      */
+    if( have_spin && spin_adapt )
+      citp_epoll_spin_adapt_done(ep, base_poll_start_frc, 1);
     if( have_spin && ordering ) {
       ordering->poll_again = 1;
       citp_epoll_find_timeout(&timeout_hr, &poll_start_frc);
@@ -2009,7 +2349,8 @@ no_events:
   }
 
   /* Blocking.  Shall we spin? */
-  if( KEEP_POLLING(eps.ul_epoll_spin, eps.this_poll_frc, base_poll_start_frc) ) {
+  if( KEEP_POLLING_FOR(eps.ul_epoll_spin, eps.this_poll_frc,
+                       base_poll_start_frc, spin_cycles) ) {
     if( !pwait_was_spinning && sigmask != NULL) {
       if( ep->avoid_spin_once ) {
         eps.ul_epoll_spin = 0;
@@ -2060,9 +2401,12 @@ no_events:
      * that the stack continues to be polled, so if we've looked at everything
      * and nothing's ready yet then poll now.
      */
-    if( ordering && ordering->ordering_stack)
-      citp_poll_if_needed(ordering->ordering_stack, eps.this_poll_frc,
-                          eps.ul_epoll_spin);
+    if( ordering ) {
+      int i;
+      for( i = 0; i < ordering->n_ordering_stacks; ++i )
+        citp_poll_if_needed(ordering->ordering_stacks[i], eps.this_poll_frc,
+                            eps.ul_epoll_spin);
+    }
     if( CITP_OPTS.sleep_spin_usec ) {
       struct oo_epoll1_spin_on_arg op = {};
       op.epoll_fd = fdi->fd;
@@ -2078,6 +2422,12 @@ no_events:
     goto poll_again;
   } /* endif ul_epoll_spin spinning*/
 
+#if CI_CFG_EPOLL3
+  if( spin_adapt && spin_cycles != 0 && ep->home_stack != NULL ) {
+    CITP_STATS_NETIF_INC(ep->home_stack, spin_adapt_miss);
+  }
+#endif
+
   /* Re-calculate timeout.  We should do it if we were spinning a lot. */
   if( eps.ul_epoll_spin && timeout_hr > 0 ) {
     timeout_hr -= eps.this_poll_frc - poll_start_frc;
@@ -2192,6 +2542,9 @@ no_events:
     }
   }
 
+  if( rc > 0 && spin_adapt )
+    citp_epoll_spin_adapt_done(ep, base_poll_start_frc, 0);
+
   if( rc && ordering ) {
     ordering->poll_again = 1;
     citp_epoll_find_timeout(&timeout_hr, &poll_start_frc);
@@ -2268,6 +2621,9 @@ void citp_epoll_on_move_do(citp_fdinfo* epoll_fdi, citp_fdinfo* fd_fdi,
     /* Would be nice to move into the home stack if that's where we're moved
      * to, but not bothering for now.
      */
+#if CI_CFG_EPOLL3
+    citp_epoll_satellite_detach(ep, eitem, fd_fdi);
+#endif
     eitem->fdi_seq = new_fdi->seq;
   }
 #if CI_CFG_EPOLL3
@@ -2284,6 +2640,7 @@ void citp_epoll_on_move_do(citp_fdinfo* epoll_fdi, citp_fdinfo* fd_fdi,
     eitem->item_list = &ep->oo_sockets;
     ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
     ep->oo_sockets_n++;
+    ep->oo_sockets_gen++;
 
     eitem->fdi_seq = new_fdi->seq;
     eitem->epfd_event.events = EP_NOT_REGISTERED;
@@ -2320,7 +2677,11 @@ static void citp_epoll_on_handover_do(citp_fdinfo* epoll_fdi,
   else
 #endif
   {
+#if CI_CFG_EPOLL3
+    citp_epoll_satellite_detach(ep, eitem, fd_fdi);
+#endif
     ep->oo_sockets_n--;
+    ep->oo_sockets_gen++;
     ci_dllist_remove(&eitem->dllink);
   }
 
@@ -2415,6 +2776,39 @@ void citp_epoll_on_handover(citp_fdinfo* epoll_fdi, citp_fdinfo* fd_fdi,
 }
 
 #if CI_CFG_EPOLL3
+/* A member in a satellite stack is being closed.  We can't tidy up here,
+ * as we may not have the epoll lock, but we must make sure that the next
+ * epoll_wait() looks at the member so that it drops it from the set.
+ */
+static void citp_epoll_satellite_on_close(struct citp_epoll_fd* ep,
+                                          citp_socket* sock)
+{
+  ci_netif* ni = sock->netif;
+  ci_sb_epoll_state* epoll;
+  struct oo_p_dllink_state link;
+  int i, ready_list;
+
+  for( i = 0; i < CITP_EPOLL_SATELLITES_MAX; ++i )
+    if( ep->satellites[i].ni == ni )
+      break;
+  if( i == CITP_EPOLL_SATELLITES_MAX )
+    return;
+  ready_list = ep->satellites[i].ready_list;
+  epoll = ci_ni_aux_p2epoll(ni, sock->s->b.epoll);
+  link = ci_sb_epoll_ready_link(ni, epoll, ready_list);
+
+  ci_netif_lock(ni);
+  if( sock->s->b.ready_lists_in_use & (1 << ready_list) ) {
+    oo_p_dllink_del(ni, link);
+    oo_p_dllink_add_tail(ni,
+                         oo_p_dllink_ptr(ni,
+                                         &ni->state->ready_lists[ready_list]),
+                         link);
+  }
+  ci_netif_unlock(ni);
+}
+
+
 void citp_epoll_on_close(citp_fdinfo* epoll_fdi, citp_fdinfo* fd_fdi,
                          int fdt_locked)
 {
@@ -2434,8 +2828,10 @@ void citp_epoll_on_close(citp_fdinfo* epoll_fdi, citp_fdinfo* fd_fdi,
     return;
 
   oo_wqlock_lock(&ep->dead_stack_lock);
-  if( ni != ep->home_stack )
+  if( ni != ep->home_stack ) {
+    citp_epoll_satellite_on_close(ep, sock);
     goto unlock;
+  }
   if( (sock->s->b.ready_lists_in_use & (1 << ep->ready_list)) == 0 )
     goto unlock;
 
@@ -2653,6 +3049,27 @@ static int citp_epoll_ordering_compare(const void* a, const void* b)
 }
 
 
+/* Restore the min-heap property of [h] below [i]. */
+static void citp_epoll_ordering_sift_down(struct citp_ordering_info* h,
+                                          int n, int i)
+{
+  struct citp_ordering_info tmp;
+  int child;
+
+  while( (child = 2 * i + 1) < n ) {
+    if( child + 1 < n &&
+        citp_epoll_ordering_compare(&h[child + 1], &h[child]) < 0 )
+      ++child;
+    if( citp_epoll_ordering_compare(&h[child], &h[i]) >= 0 )
+      break;
+    tmp = h[i];
+    h[i] = h[child];
+    h[child] = tmp;
+    i = child;
+  }
+}
+
+
 static int
 citp_epoll_sort_results(struct epoll_event*__restrict__ events,
                         struct epoll_event*__restrict__ wait_events,
@@ -2663,8 +3080,10 @@ citp_epoll_sort_results(struct epoll_event*__restrict__ events,
 {
   int i;
   int ordered_events = 0;
+  int n = ready_socks;
   struct timespec next;
   struct timespec* next_data_limit;
+  struct citp_ordering_info* succ;
   if( ready_socks < maxevents )
     maxevents = ready_socks;
 
@@ -2674,12 +3093,16 @@ citp_epoll_sort_results(struct epoll_event*__restrict__ events,
   for( i = 0; i < ready_socks; i++ )
     ordering_info[i].event = &wait_events[i];
 
-  /* Sort list of ready sockets based on timestamp of next available data. */
-  qsort(ordering_info, ready_socks, sizeof(*ordering_info),
-        citp_epoll_ordering_compare);
+  /* Arrange the ready sockets as a min-heap on the timestamp of their next
+   * available data.  We usually return far fewer events than there are
+   * ready sockets (we stop at the limit), so this is cheaper than sorting
+   * the lot: O(n) to build, then O(log n) for each event returned.
+   */
+  for( i = n / 2 - 1; i >= 0; --i )
+    citp_epoll_ordering_sift_down(ordering_info, n, i);
 
-  /* Working from head of list, copy ordered data into output array, stopping
-   * when any of the following conditions are true:
+  /* Working from the top of the heap, copy ordered data into output array,
+   * stopping when any of the following conditions are true:
    * - we have filled the output event array (i == maxevents)
    * - the timestamp for the current event is after the limit
    * - a ready socket has additional data that is earlier than the next socket's
@@ -2691,59 +3114,205 @@ citp_epoll_sort_results(struct epoll_event*__restrict__ events,
                    (unsigned long)limit->tv_sec, (int)limit->tv_nsec));
   for( i = 0; i < maxevents; i++ ) {
     /* If this event has a valid timestamp, then get ordering data for it. */
-    if( ordering_info[i].oo_event.ts.tv_sec != 0 ) {
+    if( ordering_info[0].oo_event.ts.tv_sec != 0 ) {
       Log_VPOLL(ci_log("%s: ev=%d ts %lus %dns", __func__, i,
-                       (unsigned long)ordering_info[i].oo_event.ts.tv_sec,
-                       (int)ordering_info[i].oo_event.ts.tv_nsec));
+                       (unsigned long)ordering_info[0].oo_event.ts.tv_sec,
+                       (int)ordering_info[0].oo_event.ts.tv_nsec));
       /* If this event is after the limit, stop here. */
-      if( citp_timespec_compare(limit, &ordering_info[i].oo_event.ts) < 0 )
+      if( citp_timespec_compare(limit, &ordering_info[0].oo_event.ts) < 0 )
         break;
 
       /* If there is another ready socket then use the start of their data
-       * to bound the amount we claim as available from this socket.
+       * to bound the amount we claim as available from this socket.  The
+       * next one in order is the smaller child of the top.
        */
-      if( (i + 1) < ready_socks && ordering_info[i + 1].oo_event.ts.tv_sec &&
-          citp_timespec_compare(&ordering_info[i + 1].oo_event.ts, limit) < 0 )
-        next_data_limit = &ordering_info[i + 1].oo_event.ts;
+      succ = NULL;
+      if( n > 1 ) {
+        succ = &ordering_info[1];
+        if( n > 2 && citp_epoll_ordering_compare(&ordering_info[2], succ) < 0 )
+          succ = &ordering_info[2];
+      }
+      if( succ && succ->oo_event.ts.tv_sec &&
+          citp_timespec_compare(&succ->oo_event.ts, limit) < 0 )
+        next_data_limit = &succ->oo_event.ts;
       else
         next_data_limit = limit;
 
       /* Get the number of bytes available in order, and the timestamp of the
        * first data that is after that.
        */
-      if( ordering_info[i].fdi )
-        citp_fdinfo_get_ops(ordering_info[i].fdi)->ordered_data(
-                                       ordering_info[i].fdi, next_data_limit,
-                                       &next, &ordering_info[i].oo_event.bytes);
+      if( ordering_info[0].fdi )
+        citp_fdinfo_get_ops(ordering_info[0].fdi)->ordered_data(
+                                       ordering_info[0].fdi, next_data_limit,
+                                       &next, &ordering_info[0].oo_event.bytes);
 
       /* If we have more data then don't let us return anything beyond that. */
       if( next.tv_sec && citp_timespec_compare(&next, limit) < 0 )
         *limit = next;
     }
 
-    memcpy(&events[i], ordering_info[i].event, sizeof(struct epoll_event));
-    memcpy(&oo_events[i], &ordering_info[i].oo_event,
+    memcpy(&events[i], ordering_info[0].event, sizeof(struct epoll_event));
+    memcpy(&oo_events[i], &ordering_info[0].oo_event,
            sizeof(struct onload_ordered_epoll_event));
     ordered_events++;
+
+    /* Pop the top of the heap. */
+    ordering_info[0] = ordering_info[--n];
+    citp_epoll_ordering_sift_down(ordering_info, n, 0);
   }
   Log_VPOLL(ci_log("%s: got %d ordered events", __FUNCTION__, ordered_events));
 
   return ordered_events;
 }
 
+
+static void citp_epoll_ordering_add_stack(struct citp_ordered_wait* wait,
+                                          ci_netif* ni)
+{
+  int i;
+
+  for( i = 0; i < wait->n_ordering_stacks; ++i )
+    if( wait->ordering_stacks[i] == ni )
+      return;
+  /* Sockets in any further stacks are ordered only relative to those we do
+   * track, as they were when only one stack was tracked. */
+  if( wait->n_ordering_stacks == CITP_EPOLL_ORDERING_STACKS_MAX )
+    return;
+  citp_netif_add_ref(ni);
+  wait->ordering_stacks[wait->n_ordering_stacks++] = ni;
+}
+
+
+static void citp_epoll_ordering_release_stacks(struct citp_ordered_wait* wait)
+{
+  int i;
+
+  for( i = 0; i < wait->n_ordering_stacks; ++i )
+    citp_netif_release_ref(wait->ordering_stacks[i], 0);
+  wait->n_ordering_stacks = 0;
+}
+
+
+static void citp_epoll_get_ordering_limits(struct citp_ordered_wait* wait,
+                                           struct timespec* limits)
+{
+  int i;
+
+  for( i = 0; i < wait->n_ordering_stacks; ++i )
+    citp_epoll_get_ordering_limit(wait->ordering_stacks[i], &limits[i]);
+}
+
+
+/* Combine the per-stack limits into one that is safe for all of the ready
+ * events: the earliest limit of any stack that has timestamped data ready.
+ * Stacks with nothing ready don't hold back the others; if they are idle
+ * their limit can be arbitrarily old, which is the same problem the base_ts
+ * fallback in citp_epoll_get_ordering_limit() deals with for interfaces.
+ */
+static void
+citp_epoll_merge_ordering_limits(const struct citp_ordered_wait* wait,
+                                 const struct timespec* limits,
+                                 const struct citp_ordering_info* ordering_info,
+                                 int ready_socks, struct timespec* limit_out)
+{
+  unsigned used = 0;
+  int i, j;
+
+  limit_out->tv_sec = 0;
+  limit_out->tv_nsec = 0;
+  if( wait->n_ordering_stacks == 0 )
+    return;
+
+  for( i = 0; i < ready_socks; ++i ) {
+    citp_fdinfo* fdi = ordering_info[i].fdi;
+    ci_netif* ni;
+    if( ordering_info[i].oo_event.ts.tv_sec == 0 || fdi == NULL ||
+        ! citp_fdinfo_is_socket(fdi) )
+      continue;
+    ni = fdi_to_socket(fdi)->netif;
+    for( j = 0; j < wait->n_ordering_stacks; ++j )
+      if( wait->ordering_stacks[j] == ni ) {
+        used |= 1u << j;
+        break;
+      }
+  }
+
+  if( used == 0 ) {
+    *limit_out = limits[0];
+    return;
+  }
+  for( j = 0; j < wait->n_ordering_stacks; ++j )
+    if( (used & (1u << j)) &&
+        (limit_out->tv_sec == 0 ||
+         citp_timespec_compare(&limits[j], limit_out) < 0) )
+      *limit_out = limits[j];
+}
+
+
+/* Find the stacks of the orderable sockets in the set, and cache them in
+ * [ep] until the membership of [oo_sockets] next changes.  This walks every
+ * member, so doing it on each onload_ordered_epoll_wait() call would make
+ * the cost of a call grow with the size of the set rather than with the
+ * number of events returned.
+ *
+ * Called with the ep lock held.
+ */
+static void citp_epoll_ordering_find_stacks(struct citp_epoll_fd* ep)
+{
+  struct citp_ordered_wait found;
+  struct citp_epoll_member* eitem;
+  citp_fdinfo* sock_fdi;
+  ci_dllink *link;
+
+  found.n_ordering_stacks = 0;
+  if( ci_dllist_not_empty(&ep->oo_sockets) ) {
+    ci_assert(ep->oo_sockets_n);
+
+    if( citp_fdtable_not_mt_safe() )
+      CITP_FDTABLE_LOCK_RD();
+
+    /* Order across the stacks of all of the orderable sockets in the set,
+     * so that data arriving on any of them is merged into one sequence.
+     */
+    CI_DLLIST_FOR_EACH(link, &ep->oo_sockets) {
+      if( found.n_ordering_stacks == CITP_EPOLL_ORDERING_STACKS_MAX )
+        break;
+      eitem = CI_CONTAINER(struct citp_epoll_member, dllink, link);
+
+      ci_assert_lt(eitem->fd, citp_fdtable.inited_count);
+
+      if(CI_LIKELY( (sock_fdi = citp_ul_epoll_member_to_fdi(eitem)) != NULL )) {
+        if( citp_fdinfo_is_socket(sock_fdi) )
+          citp_epoll_ordering_add_stack(&found,
+                                        fdi_to_sock_fdi(sock_fdi)->sock.netif);
+      }
+    }
+
+    if( citp_fdtable_not_mt_safe() )
+      CITP_FDTABLE_UNLOCK_RD();
+  }
+
+  /* Take the new references before dropping the old ones, so that a stack
+   * in both sets is never left without one. */
+  while( ep->n_ordering_stacks > 0 )
+    citp_netif_release_ref(ep->ordering_stacks[--ep->n_ordering_stacks], 0);
+  memcpy(ep->ordering_stacks, found.ordering_stacks,
+         found.n_ordering_stacks * sizeof(found.ordering_stacks[0]));
+  ep->n_ordering_stacks = found.n_ordering_stacks;
+  ep->ordering_stacks_gen = ep->oo_sockets_gen;
+}
+
+
 int citp_epoll_ordered_wait(citp_fdinfo* fdi,
                             struct epoll_event*__restrict__ events,
                             struct onload_ordered_epoll_event* oo_events,
                             int maxevents, int timeout, const sigset_t *sigmask,
                             citp_lib_context_t *lib_context)
 {
-  int rc;
+  int rc, i;
   struct citp_epoll_fd* ep = fdi_to_epoll(fdi);
-  struct citp_epoll_member* eitem;
-  citp_fdinfo* sock_fdi = NULL;
-  citp_sock_fdi* sock_epi;
-  ci_netif* ni;
   struct timespec limit_ts = {0, 0};
+  struct timespec limits[CITP_EPOLL_ORDERING_STACKS_MAX];
   struct citp_ordered_wait wait;
   int n_socks;
   ci_int64 timeout_hr = oo_epoll_ms_to_frc(timeout);
@@ -2754,9 +3323,9 @@ int citp_epoll_ordered_wait(citp_fdinfo* fdi,
                    ! ci_dllist_is_empty(&ep->dead_sockets),
                    ep->epfd_syncs_needed));
 
- new_stack:
-  ni = NULL;
+  wait.n_ordering_stacks = 0;
 
+ new_stack:
   CITP_EPOLL_EP_LOCK(ep);
 
   /* We need to consider all accelerated sockets in the set.  We drop the lock
@@ -2805,50 +3374,23 @@ int citp_epoll_ordered_wait(citp_fdinfo* fdi,
   }
 
 #if CI_CFG_EPOLL3
-  if( ep->home_stack ) {
-    ni = ep->home_stack;
-    citp_netif_add_ref(ni);
-  }
-  else
+  if( ep->home_stack )
+    citp_epoll_ordering_add_stack(&wait, ep->home_stack);
 #endif
-  if( ci_dllist_not_empty(&ep->oo_sockets) ) {
-    ci_dllink *link;
-    ci_assert(ep->oo_sockets_n);
-
-    if( citp_fdtable_not_mt_safe() )
-      CITP_FDTABLE_LOCK_RD();
-
-    CI_DLLIST_FOR_EACH(link, &ep->oo_sockets) {
-      eitem = CI_CONTAINER(struct citp_epoll_member, dllink, link);
-
-      ci_assert_lt(eitem->fd, citp_fdtable.inited_count);
-
-      /* Use the first orderable socket we find to select the netif to use
-       * for ordering.
-       */
-      if(CI_LIKELY( (sock_fdi = citp_ul_epoll_member_to_fdi(eitem)) != NULL )) {
-        if( citp_fdinfo_is_socket(sock_fdi) ) {
-          sock_epi = fdi_to_sock_fdi(sock_fdi);
-          ni = sock_epi->sock.netif;
-          citp_netif_add_ref(ni);
-          break;
-        }
-      }
-    }
-
-    if( citp_fdtable_not_mt_safe() )
-      CITP_FDTABLE_UNLOCK_RD();
-  }
+  if( ep->ordering_stacks_gen != ep->oo_sockets_gen ||
+      (ep->n_ordering_stacks == 0 && ci_dllist_not_empty(&ep->oo_sockets)) )
+    citp_epoll_ordering_find_stacks(ep);
+  for( i = 0; i < ep->n_ordering_stacks; ++i )
+    citp_epoll_ordering_add_stack(&wait, ep->ordering_stacks[i]);
   FDTABLE_ASSERT_VALID();
 
   CITP_EPOLL_EP_UNLOCK(ep, 0);
 
  again:
-  citp_epoll_get_ordering_limit(ni, &limit_ts);
+  citp_epoll_get_ordering_limits(&wait, limits);
 
   wait.ordering_info = ep->ordering_info;
   wait.poll_again = 0;
-  wait.ordering_stack = ni;
   /* citp_epoll_wait will do citp_exit_lib */
   rc = citp_epoll_wait(fdi, ep->wait_events, &wait,
                        n_socks, timeout_hr, sigmask, lib_context);
@@ -2863,9 +3405,9 @@ int citp_epoll_ordered_wait(citp_fdinfo* fdi,
     ci_assert_gt(rc, 0);
     Log_VPOLL(ci_log("%s: need repoll at user level", __FUNCTION__));
     citp_reenter_lib(lib_context);
-    if( ni == NULL )
+    if( wait.n_ordering_stacks == 0 )
       goto new_stack;
-    citp_epoll_get_ordering_limit(ni, &limit_ts);
+    citp_epoll_get_ordering_limits(&wait, limits);
 
     rc = citp_epoll_wait(fdi, ep->wait_events, &wait, n_socks,
                          0, sigmask, lib_context);
@@ -2883,22 +3425,26 @@ int citp_epoll_ordered_wait(citp_fdinfo* fdi,
   if( rc > 0 ) {
     /* ordering_info should be protected by the ep lock */
     CITP_EPOLL_EP_LOCK(ep);
+    citp_epoll_merge_ordering_limits(&wait, limits, ep->ordering_info, rc,
+                                     &limit_ts);
     rc = citp_epoll_sort_results(events, ep->wait_events, oo_events,
                                  ep->ordering_info, rc, maxevents, &limit_ts);
+    /* If the events vanished a socket may have moved stack, so find the
+     * stacks afresh rather than trusting the cached set. */
+    if( rc == 0 )
+      ep->ordering_stacks_gen = ep->oo_sockets_gen - 1;
     CITP_EPOLL_EP_UNLOCK(ep, 0);
     if( rc == 0 && wait.next_timeout_hr != 0 ) {
       citp_reenter_lib(lib_context);
       timeout_hr = wait.next_timeout_hr;
       Log_VPOLL(ci_log("%s: all events vanished.  Stack change?", __FUNCTION__));
-      if( ni )
-        citp_netif_release_ref(ni, 0);
+      citp_epoll_ordering_release_stacks(&wait);
       goto new_stack;
     }
   }
 
 out:
-  if( ni )
-    citp_netif_release_ref(ni, 0);
+  citp_epoll_ordering_release_stacks(&wait);
   return rc;
 }
 #endif /* CI_CFG_TIMESTAMPING */
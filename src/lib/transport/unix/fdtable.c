@@ -86,10 +86,10 @@ static void sighandler_sigonload(int sig, siginfo_t* info, void* context)
   ci_assert_equal(info->si_code, SI_TKILL);
 
   /* Ensure that blocking operations are not restarted */
-  ci_atomic32_or(&citp_signal_get_specific_inited()->c.aflags,
-                 OO_SIGNAL_FLAG_HAVE_PENDING);
-  ci_atomic32_and(&citp_signal_get_specific_inited()->c.aflags,
-                  ~OO_SIGNAL_FLAG_NEED_RESTART);
+  oo_signal_flags_or(&citp_signal_get_specific_inited()->c.aflags,
+                     OO_SIGNAL_FLAG_HAVE_PENDING);
+  oo_signal_flags_and(&citp_signal_get_specific_inited()->c.aflags,
+                      ~OO_SIGNAL_FLAG_NEED_RESTART);
 }
 
 /* Hook to be called at gracious exit */
@@ -138,6 +138,7 @@ void oo_exit_hook(int status)
   uncache_active_netifs();
 #endif
 
+  drain_active_netifs_pkt_mags();
   exit_lock_all_stacks();
 
   CITP_FDTABLE_UNLOCK_RD();
@@ -521,11 +522,19 @@ int citp_fdtable_ctor()
 
   citp_fdtable.inited_count = 0;
 
-  citp_fdtable.table = malloc(sizeof (citp_fdtable_entry) *
-                              citp_fdtable.size);
-  if( ! citp_fdtable.table ) {
-    Log_U(log("%s: failed to allocate fdtable (0x%x)", __FUNCTION__,
-              citp_fdtable.size));
+  /* The table is sized by the hard limit on open files, which can be very
+  ** large, while most processes use only a few fds.  Reserve address space
+  ** for it without committing memory, so that pages are only populated as
+  ** the entries in them are first touched.
+  */
+  citp_fdtable.table = mmap(NULL, sizeof (citp_fdtable_entry) *
+                            citp_fdtable.size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                            -1, 0);
+  if( citp_fdtable.table == MAP_FAILED ) {
+    Log_U(log("%s: failed to allocate fdtable (0x%x): %d", __FUNCTION__,
+              citp_fdtable.size, errno));
+    citp_fdtable.table = NULL;
     return -1;
   }
 
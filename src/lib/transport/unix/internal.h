@@ -518,6 +518,8 @@ extern void citp_uncache_fds_ul(ci_netif* netif);
 extern void uncache_active_netifs(void);
 #endif
 
+extern void drain_active_netifs_pkt_mags(void);
+extern void reset_active_netifs_pkt_mags(void);
 extern void exit_lock_all_stacks(void);
 extern bool have_active_netifs(void);
 
@@ -543,6 +545,15 @@ extern int citp_syscall_init(void) CI_HF;
 
 extern citp_fdinfo* citp_tcp_dup(citp_fdinfo* orig_fdi);
 
+/* Largest run of sockets citp_tcp_ds_prepare_batch() takes at once. */
+#define CITP_DS_BATCH_MAX  64
+struct onload_delegated_send_batch;
+/* Delegated-send prepare for [n] TCP sockets in stack [ni], all under one
+ * hold of the stack lock.  Returns the number that succeeded. */
+extern int citp_tcp_ds_prepare_batch(ci_netif* ni, citp_fdinfo** fdis,
+                                     struct onload_delegated_send_batch* batch,
+                                     int n, unsigned flags) CI_HF;
+
 /* Locking order:
  * - citp_pkt_map_lock is the innermost lock;
  * - citp_dup_lock should be taken before citp_ul_lock.
@@ -1089,12 +1100,17 @@ static inline int __citp_poll_if_needed(ci_netif* ni, ci_uint64 recent_frc,
                                         int is_spinning)
 {
   if( ci_netif_may_poll(ni) &&
-      ci_netif_need_poll_maybe_spinning(ni, recent_frc, is_spinning) &&
-      ci_netif_trylock(ni) ) {
-    ci_netif_poll(ni);
+      ci_netif_need_poll_maybe_spinning(ni, recent_frc, is_spinning) ) {
+    if( ci_netif_trylock(ni) ) {
+      ci_netif_poll(ni);
+      if( is_spinning ) {
+        ni->state->last_spin_poll_frc = IPTIMER_STATE(ni)->frc;
+        ni->state->poll_handoffs = 0;
+      }
+      return 1;
+    }
     if( is_spinning )
-      ni->state->last_spin_poll_frc = IPTIMER_STATE(ni)->frc;
-    return 1;
+      ci_netif_poll_handoff(ni);
   }
   return 0;
 }
@@ -192,6 +192,7 @@ static void citp_netif_child_fork_hook(void)
   Log_CALL(ci_log("%s()", __FUNCTION__));
 
   oo_stackname_update(&stackname_config_across_fork);
+  reset_active_netifs_pkt_mags();
 
   if( CITP_OPTS.fork_netif == CI_UNIX_FORK_NETIF_CHILD ) 
     __citp_netif_mark_all_dont_use();
@@ -23,6 +23,7 @@
 #include <onload/extensions.h>
 #include <onload/ul/stackname.h>
 #include <ci/internal/ip_timestamp.h>
+#include <onload/cplane_ops.h>
 
 #include "ul_pipe.h"
 #include "ul_epoll.h"
@@ -200,6 +201,153 @@ out:
 }
 
 
+int onload_move_fds(const int* fds, int n_fds)
+{
+#if CI_CFG_ENDPOINT_MOVE
+  ef_driver_handle fd_ni;
+  oo_move_fds_t op;
+  ci_netif* ni;
+  citp_lib_context_t lib_context;
+  citp_fdinfo *fdi;
+  int i, rc;
+
+  Log_CALL(ci_log("%s(%p, %d)", __func__, fds, n_fds));
+  if( n_fds <= 0 )
+    return 0;
+  citp_enter_lib(&lib_context);
+
+  op.moved_n = 0;
+  rc = citp_netif_alloc_and_init(&fd_ni, &ni);
+  if( rc != 0 )
+    goto out;
+
+  CI_USER_PTR_SET(op.fds, fds);
+  op.fds_n = n_fds;
+  rc = oo_resource_op(ci_netif_get_driver_handle(ni),
+                      OO_IOC_MOVE_FDS, &op);
+  if( rc != 0 ) {
+    op.moved_n = 0;
+    goto out;
+  }
+  if( op.moved_n < n_fds )
+    Log_V(ci_log("%s: fds[%d]=%d not moved (%d)", __func__, op.moved_n,
+                 fds[op.moved_n], op.rc));
+
+  for( i = 0; i < op.moved_n; ++i ) {
+    fdi = citp_fdtable_lookup(fds[i]);
+    fdi = citp_reprobe_moved(fdi, CI_FALSE, CI_FALSE);
+    citp_fdinfo_release_ref(fdi, CI_FALSE);
+  }
+
+out:
+  citp_exit_lib(&lib_context, CI_TRUE);
+  Log_CALL_RESULT(op.moved_n);
+  return op.moved_n;
+#else
+  return 0;
+#endif
+}
+
+
+/* Can [fdi] be connected by ci_tcp_connect_batch()?  Sockets that
+ * citp_tcp_connect() treats specially are left to connect(). */
+static int connect_batch_fdi_ok(citp_fdinfo* fdi)
+{
+  ci_sock_cmn* s;
+
+  if( citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET )
+    return 0;
+  s = fdi_to_socket(fdi)->s;
+  return ! ((s->s_flags & CI_SOCK_FLAG_TPROXY) &&
+            (s->s_flags & CI_SOCK_FLAG_CONNECT_MUST_BIND));
+}
+
+
+/* Connect the accelerated sockets of each stack in one batch, in the order
+ * given.  Requests which aren't done are left with [rc] of
+ * CI_SOCKET_HANDOVER. */
+static void connect_batch_accelerated(struct onload_connect_req* reqs,
+                                      int n_reqs,
+                                      struct ci_tcp_connect_batch_req* breqs,
+                                      citp_fdinfo** fdis)
+{
+  ci_netif* ni;
+  int i, j, n;
+
+  for( i = 0; i < n_reqs; ++i ) {
+    fdis[i] = citp_fdtable_lookup(reqs[i].fd);
+    if( fdis[i] != NULL && ! connect_batch_fdi_ok(fdis[i]) ) {
+      citp_fdinfo_release_ref(fdis[i], CI_FALSE);
+      fdis[i] = NULL;
+    }
+  }
+
+  for( i = 0; i < n_reqs; ++i ) {
+    if( fdis[i] == NULL )
+      continue;
+    ni = fdi_to_socket(fdis[i])->netif;
+    for( j = i, n = 0; j < n_reqs; ++j )
+      if( fdis[j] != NULL && fdi_to_socket(fdis[j])->netif == ni ) {
+        breqs[n].ep = *fdi_to_socket(fdis[j]);
+        breqs[n].fd = fdis[j]->fd;
+        breqs[n].addr = reqs[j].addr;
+        breqs[n].addrlen = reqs[j].addrlen;
+        ++n;
+      }
+
+    ci_tcp_connect_batch(ni, breqs, n);
+
+    for( j = i, n = 0; j < n_reqs; ++j )
+      if( fdis[j] != NULL && fdi_to_socket(fdis[j])->netif == ni ) {
+        reqs[j].rc = breqs[n++].rc;
+        citp_fdinfo_release_ref(fdis[j], CI_FALSE);
+        fdis[j] = NULL;
+      }
+  }
+}
+
+
+int onload_connect_batch(struct onload_connect_req* reqs, int n_reqs)
+{
+  struct ci_tcp_connect_batch_req* breqs;
+  citp_fdinfo** fdis;
+  citp_lib_context_t lib_context;
+  int i, n_ok = 0;
+
+  Log_CALL(ci_log("%s(%p, %d)", __func__, reqs, n_reqs));
+  if( n_reqs <= 0 )
+    return 0;
+
+  for( i = 0; i < n_reqs; ++i )
+    reqs[i].rc = CI_SOCKET_HANDOVER;
+
+  breqs = malloc(n_reqs * sizeof(*breqs));
+  fdis = malloc(n_reqs * sizeof(*fdis));
+  if( breqs != NULL && fdis != NULL ) {
+    citp_enter_lib(&lib_context);
+    connect_batch_accelerated(reqs, n_reqs, breqs, fdis);
+    citp_exit_lib(&lib_context, CI_TRUE);
+  }
+  free(breqs);
+  free(fdis);
+
+  /* Everything else goes through the ordinary connect() path. */
+  for( i = 0; i < n_reqs; ++i ) {
+    if( reqs[i].rc == CI_SOCKET_HANDOVER ) {
+      if( connect(reqs[i].fd, reqs[i].addr, reqs[i].addrlen) == 0 )
+        reqs[i].rc = 0;
+      else
+        reqs[i].rc = -errno;
+    }
+    if( reqs[i].rc == 0 || reqs[i].rc == -EINPROGRESS )
+      ++n_ok;
+  }
+
+  Log_CALL_RESULT(n_ok);
+  return n_ok;
+}
+
+
 static int onload_fd_check_msg_warm(int fd)
 {
   struct onload_stat stat = { .stack_name = NULL };
@@ -281,13 +429,22 @@ int onload_timestamping_request(int fd, unsigned flags)
 
   if( (fdi = citp_fdtable_lookup(fd)) != NULL && citp_fdinfo_is_socket(fdi) ) {
     ci_sock_cmn* sock = fdi_to_socket(fdi)->s;
-    if( flags & ONLOAD_TIMESTAMPING_FLAG_RX_MASK )
-      sock->cmsg_flags |= CI_IP_CMSG_TIMESTAMPING;
-    else
-      sock->cmsg_flags &= ~CI_IP_CMSG_TIMESTAMPING;
-
-    sock->timestamping_flags = ONLOAD_SOF_TIMESTAMPING_ONLOAD | flags;
-    rc = 0;
+    if( (flags & ONLOAD_TIMESTAMPING_FLAG_TX_RING) &&
+        fdi_to_socket(fdi)->netif->tx_ts_ring == NULL ) {
+      rc = -ENOSPC;
+    }
+    else {
+      if( flags & ONLOAD_TIMESTAMPING_FLAG_TX_RING )
+        flags |= ONLOAD_TIMESTAMPING_FLAG_TX_NIC;
+      if( flags & ONLOAD_TIMESTAMPING_FLAG_RX_MASK )
+        sock->cmsg_flags |= CI_IP_CMSG_TIMESTAMPING;
+      else
+        sock->cmsg_flags &= ~CI_IP_CMSG_TIMESTAMPING;
+
+      sock->timestamping_flags = ONLOAD_SOF_TIMESTAMPING_ONLOAD | flags;
+      rc = 0;
+    }
+    citp_fdinfo_release_ref(fdi, 0);
   }
   else {
     rc = -ENOTTY;
@@ -301,6 +458,84 @@ int onload_timestamping_request(int fd, unsigned flags)
 }
 
 
+#if CI_CFG_TIMESTAMPING
+static int tx_ts_ring_read(ci_netif* ni, struct onload_tx_timestamp* out,
+                           int max, unsigned* dropped)
+{
+  ci_netif_state* ns = ni->state;
+  const ci_tx_ts_rec* rec;
+  ci_uint32 read, n, i, seen, d;
+
+  /* Copy out what is there and then claim it.  The stack never overwrites
+   * records that have not been claimed, so if another reader claims some
+   * of them first we just try again. */
+  do {
+    read = OO_ACCESS_ONCE(ns->tx_ts_ring_read);
+    n = OO_ACCESS_ONCE(ns->tx_ts_ring_write) - read;
+    ci_rmb();
+    n = CI_MIN(n, ni->tx_ts_ring_mask + 1);
+    n = CI_MIN(n, (ci_uint32) max);
+    for( i = 0; i < n; ++i ) {
+      rec = &ni->tx_ts_ring[(read + i) & ni->tx_ts_ring_mask];
+      out[i].endpoint_id = rec->sock_id;
+      out[i].id = rec->id;
+      out[i].ts.sec = rec->stamp.tv_sec;
+      out[i].ts.nsec = rec->stamp.tv_nsec;
+      out[i].ts.nsec_frac = 0;
+      out[i].ts.reserved = 0;
+    }
+  } while( n != 0 &&
+           ! ci_cas32u_succeed(&ns->tx_ts_ring_read, read, read + n) );
+
+  if( dropped != NULL ) {
+    do {
+      seen = OO_ACCESS_ONCE(ns->tx_ts_ring_dropped_seen);
+      d = OO_ACCESS_ONCE(ns->tx_ts_ring_dropped);
+    } while( ! ci_cas32u_succeed(&ns->tx_ts_ring_dropped_seen, seen, d) );
+    *dropped = d - seen;
+  }
+  return n;
+}
+#endif
+
+
+int onload_tx_timestamp_ring_read(int fd, struct onload_tx_timestamp* out,
+                                  int max, unsigned* dropped)
+{
+#if CI_CFG_TIMESTAMPING
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+  int rc;
+
+  if( max < 0 )
+    return -EINVAL;
+
+  citp_enter_lib(&lib_context);
+  if( (fdi = citp_fdtable_lookup(fd)) != NULL ) {
+    if( citp_fdinfo_is_socket(fdi) ) {
+      ni = fdi_to_socket(fdi)->netif;
+      if( ni->tx_ts_ring != NULL )
+        rc = tx_ts_ring_read(ni, out, max, dropped);
+      else
+        rc = -ENOSPC;
+    }
+    else {
+      rc = -ENOTTY;
+    }
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+  else {
+    rc = -ENOTTY;
+  }
+  citp_exit_lib(&lib_context, 0);
+  return rc;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+
 static int oo_extensions_version_check(void)
 {
   static unsigned int* oev;
@@ -408,6 +643,86 @@ onload_delegated_send_complete(int fd, const struct iovec* iov, int iovlen,
   return rc;
 }
 
+int
+onload_delegated_send_prepare_batch(struct onload_delegated_send_batch* batch,
+                                    int n, unsigned flags, void* headers,
+                                    int headers_stride)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* run_fdi[CITP_DS_BATCH_MAX];
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+  int i, j, n_run, rc = 0;
+
+  Log_CALL(ci_log("%s(%p, %d, 0x%x, %p, %d)", __FUNCTION__,
+                  batch, n, flags, headers, headers_stride));
+
+  if( n < 0 || (headers != NULL && headers_stride <= 0) ) {
+    errno = EINVAL;
+    Log_CALL_RESULT(-1);
+    return -1;
+  }
+
+  if( headers != NULL )
+    for( i = 0; i < n; ++i ) {
+      batch[i].ds.headers = (char*) headers + i * headers_stride;
+      batch[i].ds.headers_len = headers_stride;
+    }
+
+  citp_enter_lib(&lib_context);
+  for( i = 0; i < n; i += n_run ) {
+    /* Gather a run of TCP sockets in one stack. */
+    ni = NULL;
+    n_run = 0;
+    while( i + n_run < n && n_run < CITP_DS_BATCH_MAX ) {
+      fdi = citp_fdtable_lookup(batch[i + n_run].fd);
+      if( fdi == NULL )
+        break;
+      if( citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET ||
+          (ni != NULL && fdi_to_sock_fdi(fdi)->sock.netif != ni) ) {
+        citp_fdinfo_release_ref(fdi, 0);
+        break;
+      }
+      ni = fdi_to_sock_fdi(fdi)->sock.netif;
+      run_fdi[n_run++] = fdi;
+    }
+
+    if( n_run == 0 ) {
+      /* Not an accelerated TCP socket. */
+      batch[i].rc = ONLOAD_DELEGATED_SEND_RC_BAD_SOCKET;
+      n_run = 1;
+      continue;
+    }
+    rc += citp_tcp_ds_prepare_batch(ni, run_fdi, &batch[i], n_run, flags);
+    for( j = 0; j < n_run; ++j )
+      citp_fdinfo_release_ref(run_fdi[j], 0);
+  }
+  citp_exit_lib(&lib_context, TRUE);
+
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+int
+onload_delegated_send_complete_batch(struct onload_delegated_send_batch* batch,
+                                     int n, int flags)
+{
+  int i, n_ok = 0;
+
+  /* Completion copies the data to the retransmit queue and can block, and
+   * is off the latency-critical path, so the sockets are done one at a
+   * time. */
+  for( i = 0; i < n; ++i ) {
+    batch[i].rc = onload_delegated_send_complete(batch[i].fd, batch[i].iov,
+                                                 batch[i].iovlen, flags);
+    if( batch[i].rc < 0 )
+      batch[i].rc = -errno;
+    else
+      ++n_ok;
+  }
+  return n_ok;
+}
+
 int
 onload_delegated_send_cancel(int fd)
 {
@@ -533,6 +848,248 @@ fail:
 
 
 
+/* Resolves routes to the destinations in [dsts] or, if it is not NULL, in
+ * [pins], in chunks, so that the requests in each chunk are outstanding
+ * together.  Returns the number of destinations with a route. */
+static int
+route_prewarm(citp_sock_fdi* sock_epi, const struct sockaddr_storage* dsts,
+              struct onload_route_pin* pins, int n_dsts)
+{
+  ci_netif* ni = sock_epi->sock.netif;
+  ci_sock_cmn* s = sock_epi->sock.s;
+  struct cp_fwd_table* fwd_table =
+    oo_cp_get_fwd_table(ni->cplane, ci_ni_fwd_table_id(ni));
+  ci_addr_t daddrs[64];
+  cicp_verinfo_t verinfos[64];
+  int flags[64];
+  int idx[64];
+  int i, j, n, rc = 0;
+
+  for( i = 0; i < n_dsts; ) {
+    for( n = 0; i < n_dsts && n < CI_ARRAY_SIZE(daddrs); ++i ) {
+      const struct sockaddr* sa = pins != NULL ?
+        (const struct sockaddr*) &pins[i].dst :
+        (const struct sockaddr*) &dsts[i];
+      if( (sa->sa_family != AF_INET && sa->sa_family != AF_INET6)
+#if ! CI_CFG_IPV6
+          || (sa->sa_family == AF_INET6 && ! ci_tcp_ipv6_is_ipv4(sa))
+#endif
+          ) {
+        if( pins != NULL )
+          pins[i].flags = ONLOAD_ROUTE_PIN_NO_ROUTE;
+        continue;
+      }
+      daddrs[n] = ci_get_addr(sa);
+      oo_cp_verinfo_init(&verinfos[n]);
+      /* [priv] is caller memory: it may be uninitialised, or may come
+       * from a stack in another namespace, so trust no row outside the
+       * table. */
+      if( pins != NULL && pins[i].priv[0] != 0 ) {
+        cicp_mac_rowid_t id = pins[i].priv[0] - 1;
+        if( CICP_MAC_ROWID_IS_VALID(id) && id <= fwd_table->mask ) {
+          verinfos[n].id = id;
+          verinfos[n].version = pins[i].priv[1];
+        }
+      }
+      idx[n++] = i;
+    }
+
+    rc += cicp_user_prewarm(ni, &s->pkt, &s->cp, daddrs, verinfos, flags, n);
+
+    for( j = 0; pins != NULL && j < n; ++j ) {
+      struct onload_route_pin* pin = &pins[idx[j]];
+      pin->priv[0] = verinfos[j].id + 1;
+      pin->priv[1] = verinfos[j].version;
+      pin->flags = 0;
+      if( flags[j] & CICP_PREWARM_CHANGED )
+        pin->flags |= ONLOAD_ROUTE_PIN_CHANGED;
+      if( flags[j] & CICP_PREWARM_NO_ROUTE )
+        pin->flags |= ONLOAD_ROUTE_PIN_NO_ROUTE;
+      if( flags[j] & CICP_PREWARM_NO_MAC )
+        pin->flags |= ONLOAD_ROUTE_PIN_NO_MAC;
+    }
+  }
+
+  return rc;
+}
+
+
+static int
+onload_route_prewarm_fd(int fd, const struct sockaddr_storage* dsts,
+                        struct onload_route_pin* pins, int n_dsts)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  int rc;
+
+  citp_enter_lib(&lib_context);
+  fdi = citp_fdtable_lookup(fd);
+  if( fdi == NULL || n_dsts < 0 ||
+      (citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET &&
+       citp_fdinfo_get_type(fdi) != CITP_UDP_SOCKET) ) {
+    errno = EINVAL;
+    rc = -1;
+  }
+  else {
+    rc = route_prewarm(fdi_to_sock_fdi(fdi), dsts, pins, n_dsts);
+  }
+
+  if( fdi != NULL )
+    citp_fdinfo_release_ref(fdi, 0);
+  citp_exit_lib(&lib_context, rc >= 0);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_route_prewarm(int fd, const struct sockaddr_storage* dsts,
+                         int n_dsts)
+{
+  Log_CALL(ci_log("%s(%d, %p, %d)", __FUNCTION__, fd, dsts, n_dsts));
+  return onload_route_prewarm_fd(fd, dsts, NULL, n_dsts);
+}
+
+
+int onload_route_pin(int fd, struct onload_route_pin* pins, int n_pins)
+{
+  Log_CALL(ci_log("%s(%d, %p, %d)", __FUNCTION__, fd, pins, n_pins));
+  return onload_route_prewarm_fd(fd, NULL, pins, n_pins);
+}
+
+
+/* Finds the stack of [fd] for the RX drop rule calls, taking a reference
+ * to [*fdi_out].  Returns NULL with errno set on failure. */
+static ci_netif* rx_drop_rule_netif(int fd, int rule_id,
+                                    citp_fdinfo** fdi_out)
+{
+  citp_fdinfo* fdi = citp_fdtable_lookup(fd);
+
+  CI_BUILD_ASSERT(ONLOAD_RX_DROP_RULES_MAX == CI_RX_DROP_RULES_MAX);
+  *fdi_out = fdi;
+  if( fdi == NULL || rule_id < 0 || rule_id >= CI_RX_DROP_RULES_MAX ||
+      (citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET &&
+       citp_fdinfo_get_type(fdi) != CITP_UDP_SOCKET) ) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return fdi_to_sock_fdi(fdi)->sock.netif;
+}
+
+
+int onload_rx_drop_rule_set(int fd, int rule_id,
+                            const struct onload_rx_drop_rule* rule)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+  ci_rx_drop_rule* r;
+  int rc = -1;
+
+  Log_CALL(ci_log("%s(%d, %d, %p)", __FUNCTION__, fd, rule_id, rule));
+  citp_enter_lib(&lib_context);
+
+  ni = rx_drop_rule_netif(fd, rule_id, &fdi);
+  if( ni == NULL )
+    goto out;
+  if( rule != NULL &&
+      (rule->src_prefix_len < 0 || rule->src_prefix_len > 32) ) {
+    errno = EINVAL;
+    goto out;
+  }
+
+  ci_netif_lock(ni);
+  r = &ni->state->rx_drop_rules[rule_id];
+  memset(r, 0, sizeof(*r));
+  if( rule != NULL ) {
+    r->smask_be32 = CI_BSWAP_BE32(ci_ip_prefix2mask(rule->src_prefix_len));
+    r->saddr_be32 = rule->src.s_addr & r->smask_be32;
+    r->dport_be16 = CI_BSWAP_BE16(rule->dst_port);
+    r->protocol = rule->protocol;
+    r->rate_pps = rule->rate_pps;
+    r->tokens = rule->rate_pps;
+    r->refill_frc = IPTIMER_STATE(ni)->frc;
+    r->in_use = 1;
+  }
+  while( ni->state->rx_drop_rules_n > 0 &&
+         ! ni->state->rx_drop_rules[ni->state->rx_drop_rules_n - 1].in_use )
+    --ni->state->rx_drop_rules_n;
+  if( rule != NULL && rule_id >= ni->state->rx_drop_rules_n )
+    ni->state->rx_drop_rules_n = rule_id + 1;
+  ci_netif_unlock(ni);
+  rc = 0;
+
+ out:
+  if( fdi != NULL )
+    citp_fdinfo_release_ref(fdi, 0);
+  citp_exit_lib(&lib_context, rc == 0);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_rx_drop_rule_stats(int fd, int rule_id, uint64_t* n_matched,
+                              uint64_t* n_dropped)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+  int rc = -1;
+
+  Log_CALL(ci_log("%s(%d, %d, %p, %p)", __FUNCTION__, fd, rule_id,
+                  n_matched, n_dropped));
+  citp_enter_lib(&lib_context);
+
+  ni = rx_drop_rule_netif(fd, rule_id, &fdi);
+  if( ni != NULL ) {
+    ci_netif_lock(ni);
+    *n_matched = ni->state->rx_drop_rules[rule_id].n_matched;
+    *n_dropped = ni->state->rx_drop_rules[rule_id].n_dropped;
+    ci_netif_unlock(ni);
+    rc = 0;
+  }
+
+  if( fdi != NULL )
+    citp_fdinfo_release_ref(fdi, 0);
+  citp_exit_lib(&lib_context, rc == 0);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+int onload_stack_irq_set_core(int fd, int core)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_int32 op_arg = core;
+  int rc = -1;
+
+  Log_CALL(ci_log("%s(%d, %d)", __FUNCTION__, fd, core));
+  citp_enter_lib(&lib_context);
+
+  fdi = citp_fdtable_lookup(fd);
+  if( fdi == NULL ||
+      (citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET &&
+       citp_fdinfo_get_type(fdi) != CITP_UDP_SOCKET) ) {
+    errno = EINVAL;
+    goto out;
+  }
+
+  rc = oo_resource_op(ci_netif_get_driver_handle(fdi_to_sock_fdi(fdi)->
+                                                 sock.netif),
+                      OO_IOC_IRQ_SET_CORE, &op_arg);
+  if( rc < 0 ) {
+    errno = -rc;
+    rc = -1;
+  }
+
+ out:
+  if( fdi != NULL )
+    citp_fdinfo_release_ref(fdi, 0);
+  citp_exit_lib(&lib_context, rc == 0);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 int onload_socket_nonaccel(int domain, int type, int protocol)
 {
   return ci_sys_socket(domain, type, protocol);
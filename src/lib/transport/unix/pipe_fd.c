@@ -876,6 +876,8 @@ static int oo_pipe_ctor(ci_netif* netif, struct oo_pipe** out_pipe,
     p->aflags = (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_READER_SHIFT) |
         (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT);
   }
+  if( CITP_OPTS.pipe_wake_batch )
+    p->aflags |= CI_PFD_AFLAG_WAKE_BATCH;
 
   /* attach */
   rc = ci_tcp_helper_pipe_attach(ci_netif_get_driver_handle(netif),
@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Implementation of the onload_ring_* submission/completion extension API */
+
+#include "internal.h"
+#include <ci/internal/ip.h>
+#include <sys/socket.h>
+#include <onload/extensions.h>
+#include <onload/extensions_ring.h>
+
+
+#define RING_ENTRIES_MAX  (1u << 16)
+
+
+/* Identifies an (fd, op) pair which has an operation outstanding, so that
+ * later operations on the same pair are not attempted ahead of it.  The set
+ * is rebuilt on every pass over the pending list; bumping 'gen' empties it
+ * without touching the table. */
+struct ring_block {
+  int fd;
+  uint8_t op;
+  unsigned gen;
+};
+
+struct onload_ring {
+  /* Number of entries minus one */
+  unsigned mask;
+
+  /* Entries handed out by onload_ring_get_sqe() but not yet submitted are
+   * those from sq_head up to sq_tail. */
+  struct onload_ring_sqe* sq;
+  unsigned sq_head, sq_tail;
+
+  /* Submitted operations which have not yet completed, in submission
+   * order. */
+  struct onload_ring_sqe* pending;
+  unsigned n_pending;
+
+  /* Completions not yet reaped are those from cq_head up to cq_tail. */
+  struct onload_ring_cqe* cq;
+  unsigned cq_head, cq_tail;
+
+  /* Open-addressed set of twice the ring size */
+  struct ring_block* blocks;
+  unsigned blocks_mask;
+  unsigned gen;
+};
+
+
+static unsigned ring_outstanding(const struct onload_ring* ring)
+{
+  return (ring->sq_tail - ring->sq_head) + ring->n_pending +
+         (ring->cq_tail - ring->cq_head);
+}
+
+
+static struct ring_block* ring_block_find(struct onload_ring* ring,
+                                          const struct onload_ring_sqe* sqe)
+{
+  unsigned i = ((unsigned) sqe->fd * 2654435761u + sqe->op) &
+               ring->blocks_mask;
+  struct ring_block* b;
+
+  /* The set never holds more than half the table, so this terminates. */
+  for( ; ; i = (i + 1) & ring->blocks_mask ) {
+    b = &ring->blocks[i];
+    if( b->gen != ring->gen || (b->fd == sqe->fd && b->op == sqe->op) )
+      return b;
+  }
+}
+
+
+static void ring_complete(struct onload_ring* ring,
+                          const struct onload_ring_sqe* sqe, int64_t res)
+{
+  struct onload_ring_cqe* cqe = &ring->cq[ring->cq_tail++ & ring->mask];
+  cqe->user_data = sqe->user_data;
+  cqe->res = res;
+  cqe->flags = 0;
+}
+
+
+/* Returns true if accept() on this socket will not block: either there is
+ * a connection to take, or there is an error for accept() to report. */
+static int ring_accept_ready(citp_fdinfo* fdi)
+{
+  ci_sock_cmn* s = fdi_to_sock_fdi(fdi)->sock.s;
+  ci_tcp_socket_listen* tls;
+
+  if( s->b.state != CI_TCP_LISTEN || s->so_error )
+    return 1;
+  tls = SOCK_TO_TCP_LISTEN(s);
+  return ci_tcp_acceptq_n(tls) || (s->os_sock_status & OO_OS_STATUS_RX);
+}
+
+
+static int64_t ring_do_op(citp_fdinfo* fdi, const struct onload_ring_sqe* sqe,
+                          citp_lib_context_t* lib_context)
+{
+  struct iovec iov;
+  struct msghdr msg;
+  int rc;
+
+  switch( sqe->op ) {
+  case ONLOAD_RING_OP_SEND:
+  case ONLOAD_RING_OP_RECV:
+    iov.iov_base = sqe->buf;
+    iov.iov_len = sqe->len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if( sqe->op == ONLOAD_RING_OP_SEND )
+      rc = citp_fdinfo_get_ops(fdi)->send(fdi, &msg,
+                                          sqe->flags | MSG_DONTWAIT);
+    else
+      rc = citp_fdinfo_get_ops(fdi)->recv(fdi, &msg,
+                                          sqe->flags | MSG_DONTWAIT);
+    break;
+  case ONLOAD_RING_OP_ACCEPT:
+    if( citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET )
+      return -EOPNOTSUPP;
+    if( ! ring_accept_ready(fdi) )
+      return -EAGAIN;
+    rc = citp_fdinfo_get_ops(fdi)->accept(fdi, NULL, NULL, sqe->flags,
+                                          lib_context);
+    break;
+  default:
+    return -EINVAL;
+  }
+
+  return rc < 0 ? -errno : rc;
+}
+
+
+/* Attempt every pending operation once, in order, completing those that
+ * do not return EAGAIN.  If [poll] the stack of each socket is polled
+ * (when it needs it and the lock is free) before its operations are
+ * retried. */
+static void ring_process(struct onload_ring* ring, int poll)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi = NULL;
+  ci_netif* last_ni = NULL;
+  ci_netif* ni;
+  struct onload_ring_sqe* sqe;
+  struct ring_block* b;
+  int last_fd = -1;
+  unsigned i, kept = 0;
+  int64_t res;
+
+  if( ++ring->gen == 0 )
+    ++ring->gen;
+
+  citp_enter_lib(&lib_context);
+
+  for( i = 0; i < ring->n_pending; ++i ) {
+    sqe = &ring->pending[i];
+    b = ring_block_find(ring, sqe);
+    if( b->gen == ring->gen )
+      goto keep;
+
+    if( sqe->fd != last_fd ) {
+      if( fdi != NULL )
+        citp_fdinfo_release_ref(fdi, 0);
+      fdi = citp_fdtable_lookup(sqe->fd);
+      if( fdi != NULL && ! citp_fdinfo_is_socket(fdi) ) {
+        citp_fdinfo_release_ref(fdi, 0);
+        fdi = NULL;
+      }
+      last_fd = sqe->fd;
+      if( fdi != NULL && poll &&
+          (ni = fdi_to_sock_fdi(fdi)->sock.netif) != last_ni ) {
+        if( ci_netif_may_poll(ni) && ci_netif_need_poll(ni) &&
+            ci_netif_trylock(ni) ) {
+          ci_netif_poll(ni);
+          ci_netif_unlock(ni);
+        }
+        last_ni = ni;
+      }
+    }
+
+    if( fdi == NULL )
+      res = -ESOCKTNOSUPPORT;
+    else
+      res = ring_do_op(fdi, sqe, &lib_context);
+    if( res == -EAGAIN ) {
+      b->fd = sqe->fd;
+      b->op = sqe->op;
+      b->gen = ring->gen;
+      goto keep;
+    }
+    ring_complete(ring, sqe, res);
+    continue;
+
+  keep:
+    if( kept != i )
+      ring->pending[kept] = *sqe;
+    ++kept;
+  }
+  ring->n_pending = kept;
+
+  if( fdi != NULL )
+    citp_fdinfo_release_ref(fdi, 0);
+
+  citp_exit_lib(&lib_context, TRUE);
+}
+
+
+int onload_ring_alloc(unsigned entries, int flags,
+                      struct onload_ring** ring_out)
+{
+  struct onload_ring* ring;
+  unsigned n;
+  int rc = 0;
+
+  Log_CALL(ci_log("%s(%u, %x, %p)", __FUNCTION__, entries, flags, ring_out));
+
+  if( flags != 0 || entries == 0 || entries > RING_ENTRIES_MAX ) {
+    rc = -EINVAL;
+    goto out;
+  }
+  for( n = 1; n < entries; n <<= 1 )
+    ;
+
+  ring = calloc(1, sizeof(*ring));
+  if( ring == NULL ) {
+    rc = -ENOMEM;
+    goto out;
+  }
+  ring->mask = n - 1;
+  ring->blocks_mask = 2 * n - 1;
+  ring->sq = calloc(n, sizeof(*ring->sq));
+  ring->pending = calloc(n, sizeof(*ring->pending));
+  ring->cq = calloc(n, sizeof(*ring->cq));
+  ring->blocks = calloc(2 * n, sizeof(*ring->blocks));
+  if( ring->sq == NULL || ring->pending == NULL || ring->cq == NULL ||
+      ring->blocks == NULL ) {
+    onload_ring_free(ring);
+    rc = -ENOMEM;
+    goto out;
+  }
+  *ring_out = ring;
+
+ out:
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_ring_free(struct onload_ring* ring)
+{
+  Log_CALL(ci_log("%s(%p)", __FUNCTION__, ring));
+
+  free(ring->sq);
+  free(ring->pending);
+  free(ring->cq);
+  free(ring->blocks);
+  free(ring);
+
+  Log_CALL_RESULT(0);
+  return 0;
+}
+
+
+struct onload_ring_sqe* onload_ring_get_sqe(struct onload_ring* ring)
+{
+  struct onload_ring_sqe* sqe;
+
+  if( ring_outstanding(ring) > ring->mask )
+    return NULL;
+  sqe = &ring->sq[ring->sq_tail++ & ring->mask];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+
+int onload_ring_submit(struct onload_ring* ring)
+{
+  int n = ring->sq_tail - ring->sq_head;
+
+  Log_CALL(ci_log("%s(%p)", __FUNCTION__, ring));
+
+  /* Newly-submitted entries go to the back of the pending list, so that
+   * anything already outstanding on the same fd keeps its place. */
+  for( ; ring->sq_head != ring->sq_tail; ++ring->sq_head )
+    ring->pending[ring->n_pending++] =
+      ring->sq[ring->sq_head & ring->mask];
+  ring_process(ring, 0);
+
+  Log_CALL_RESULT(n);
+  return n;
+}
+
+
+int onload_ring_reap(struct onload_ring* ring,
+                     struct onload_ring_cqe* cqes, int max)
+{
+  int n = 0;
+
+  Log_CALL(ci_log("%s(%p, %p, %d)", __FUNCTION__, ring, cqes, max));
+
+  if( ring->n_pending )
+    ring_process(ring, 1);
+  for( ; n < max && ring->cq_head != ring->cq_tail; ++n )
+    cqes[n] = ring->cq[ring->cq_head++ & ring->mask];
+
+  Log_CALL_RESULT(n);
+  return n;
+}
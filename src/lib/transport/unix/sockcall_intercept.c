@@ -2572,7 +2572,17 @@ static int onload_exec(const char *path, char *const argv[],
     citp_environ_make_preload(envp, e, env_bytes);
   }
 
-  /* No citp_enter_lib() / citp_exit_lib() needed here */
+  /* Packets cached by this process's threads would not survive exec(). */
+  if( citp.init_level >= CITP_INIT_NETIF ) {
+    citp_lib_context_t lib_context;
+    citp_enter_lib(&lib_context);
+    CITP_FDTABLE_LOCK();
+    drain_active_netifs_pkt_mags();
+    CITP_FDTABLE_UNLOCK();
+    citp_exit_lib(&lib_context, 1);
+  }
+
+  /* No other citp_enter_lib() / citp_exit_lib() needed here */
   Log_CALL(ci_log("%s(\"%s\", %p, %p)", fname, path,argv,envp));
   if (!resolve_path) {
     Log_V(log("execve: %s", path));
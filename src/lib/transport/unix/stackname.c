@@ -282,6 +282,14 @@ void oo_stackname_get(char **stackname)
 }
 
 
+int oo_stackname_is_thread_local(void)
+{
+  struct oo_stackname_state *state = oo_stackname_thread_get();
+
+  return state->who == ONLOAD_THIS_THREAD && state->scoped_stackname[0] != 1;
+}
+
+
 static void
 oo_stackname_update_local_suffix(struct oo_stackname_state *state,
                                      enum onload_stackname_scope context)
@@ -163,6 +163,7 @@ static void citp_dump_opts(citp_opts_t *o)
   DUMP_OPT_INT("EF_PIPE_RECV_SPIN",     pipe_recv_spin);
   DUMP_OPT_INT("EF_PIPE_SEND_SPIN",     pipe_send_spin);
   DUMP_OPT_INT("EF_PIPE_SIZE",          pipe_size);
+  DUMP_OPT_INT("EF_PIPE_WAKE_BATCH",    pipe_wake_batch);
   DUMP_OPT_INT("EF_SOCK_LOCK_BUZZ",     sock_lock_buzz);
   DUMP_OPT_INT("EF_STACK_LOCK_BUZZ",    stack_lock_buzz);
   DUMP_OPT_INT("EF_SO_BUSY_POLL_SPIN",  so_busy_poll_spin);
@@ -171,8 +172,10 @@ static void citp_dump_opts(citp_opts_t *o)
   DUMP_OPT_INT("EF_EPOLL_CTL_FAST",     ul_epoll_ctl_fast);
   DUMP_OPT_INT("EF_EPOLL_CTL_HANDOFF",  ul_epoll_ctl_handoff);
   DUMP_OPT_INT("EF_EPOLL_MT_SAFE",      ul_epoll_mt_safe);
+  DUMP_OPT_INT("EF_EPOLL_MULTI_STACK",  ul_epoll_multi_stack);
   DUMP_OPT_INT("EF_FDTABLE_SIZE",	fdtable_size);
   DUMP_OPT_INT("EF_SPIN_USEC",		ul_spin_usec);
+  DUMP_OPT_INT("EF_SPIN_ADAPT",		ul_spin_adapt);
   DUMP_OPT_INT("EF_SLEEP_SPIN_USEC",	sleep_spin_usec);
   DUMP_OPT_INT("EF_STACK_PER_THREAD",	stack_per_thread);
   DUMP_OPT_INT("EF_DONT_ACCELERATE",	dont_accelerate);
@@ -189,6 +192,7 @@ static void citp_dump_opts(citp_opts_t *o)
   DUMP_OPT_INT("EF_CLUSTER_SIZE",  cluster_size);
   DUMP_OPT_INT("EF_CLUSTER_RESTART",  cluster_restart_opt);
   DUMP_OPT_INT("EF_CLUSTER_HOT_RESTART", cluster_hot_restart_opt);
+  DUMP_OPT_INT("EF_CLUSTER_PER_THREAD", cluster_per_thread);
   ci_log("EF_CLUSTER_NAME=%s", o->cluster_name);
   if( o->tcp_reuseports == 0 ) {
     DUMP_OPT_INT("EF_TCP_FORCE_REUSEPORT", tcp_reuseports);
@@ -366,6 +370,9 @@ static void citp_opts_getenv(citp_opts_t* opts)
   }
   if( getenv("EF_LOG_THREAD") )
     ci_log_options |= CI_LOG_TID;
+  GET_ENV_OPT_INT("EF_LOG_BINARY", log_binary);
+  if( opts->log_binary )
+    ci_blog_till_exit();
 
 
   if( getenv("EF_POLL_NONBLOCK_FAST_LOOPS") &&
@@ -425,6 +432,7 @@ static void citp_opts_getenv(citp_opts_t* opts)
   GET_ENV_OPT_INT("EF_PIPE_RECV_SPIN",  pipe_recv_spin);
   GET_ENV_OPT_INT("EF_PIPE_SEND_SPIN",  pipe_send_spin);
   GET_ENV_OPT_INT("EF_PIPE_SIZE",       pipe_size);
+  GET_ENV_OPT_INT("EF_PIPE_WAKE_BATCH", pipe_wake_batch);
   GET_ENV_OPT_INT("EF_SOCK_LOCK_BUZZ",  sock_lock_buzz);
   GET_ENV_OPT_INT("EF_STACK_LOCK_BUZZ", stack_lock_buzz);
   GET_ENV_OPT_INT("EF_SO_BUSY_POLL_SPIN", so_busy_poll_spin);
@@ -433,9 +441,11 @@ static void citp_opts_getenv(citp_opts_t* opts)
   GET_ENV_OPT_INT("EF_EPOLL_CTL_FAST",  ul_epoll_ctl_fast);
   GET_ENV_OPT_INT("EF_EPOLL_CTL_HANDOFF",ul_epoll_ctl_handoff);
   GET_ENV_OPT_INT("EF_EPOLL_MT_SAFE",   ul_epoll_mt_safe);
+  GET_ENV_OPT_INT("EF_EPOLL_MULTI_STACK", ul_epoll_multi_stack);
   GET_ENV_OPT_INT("EF_WODA_SINGLE_INTERFACE", woda_single_if);
   GET_ENV_OPT_INT("EF_FDTABLE_SIZE",	fdtable_size);
   GET_ENV_OPT_INT("EF_SPIN_USEC",	ul_spin_usec);
+  GET_ENV_OPT_INT("EF_SPIN_ADAPT",	ul_spin_adapt);
   GET_ENV_OPT_INT("EF_SLEEP_SPIN_USEC",	sleep_spin_usec);
   GET_ENV_OPT_INT("EF_STACK_PER_THREAD",stack_per_thread);
   GET_ENV_OPT_INT("EF_DONT_ACCELERATE",	dont_accelerate);
@@ -480,6 +490,7 @@ static void citp_opts_getenv(citp_opts_t* opts)
     log("ERROR: invalid cluster_size. cluster_size needs to be 0 or a positive number");
   GET_ENV_OPT_INT("EF_CLUSTER_RESTART",	cluster_restart_opt);
   GET_ENV_OPT_INT("EF_CLUSTER_HOT_RESTART", cluster_hot_restart_opt);
+  GET_ENV_OPT_INT("EF_CLUSTER_PER_THREAD", cluster_per_thread);
   get_env_opt_port_list(&opts->tcp_reuseports, "EF_TCP_FORCE_REUSEPORT");
   get_env_opt_port_list(&opts->udp_reuseports, "EF_UDP_FORCE_REUSEPORT");
 
@@ -520,6 +531,7 @@ static void citp_opts_validate_env(void)
     "EF_VI_PD_FLAGS",
     "EF_VI_LOG_LEVEL",
     "EF_VI_EVQ_CLEAR_STRIDE",
+    "EF_VI_EFCT_RX_PREFETCH",
     "EF_BUILDTREE_UL",
     NULL
   };
@@ -877,6 +877,40 @@ redo:
 }
 
 
+/* Take the listener's socket lock to pop the accept queue.
+ *
+ * The lock is only held across the pop itself, so when many threads accept
+ * on one listener it is better to buzz on it than to sleep in the kernel.
+ * Spinners give up as soon as the queue is seen to be empty, so threads
+ * that lose the race go back to waiting without ever touching the lock.
+ * Returns false (without the lock) if the queue drained while waiting.
+ */
+static int citp_tcp_accept_lock(ci_netif* ni, ci_tcp_socket_listen* listener)
+{
+  ci_uint64 start_frc, now_frc;
+
+  if( ci_sock_trylock(ni, &listener->s.b) )
+    return 1;
+
+  CITP_STATS_NETIF(++ni->state->stats.accept_lock_contended);
+  ci_frc64(&start_frc);
+  now_frc = start_frc;
+  while( now_frc - start_frc < ni->state->buzz_cycles ) {
+    ci_spinloop_pause();
+    if( ci_tcp_acceptq_n(listener) == 0 )
+      return 0;
+    if( ci_sock_trylock(ni, &listener->s.b) )
+      return 1;
+    ci_frc64(&now_frc);
+  }
+
+  /* The holder is taking its time (descheduled, or putting a socket back
+   * after failing to get an fd), so block as before. */
+  ci_sock_lock(ni, &listener->s.b);
+  return 1;
+}
+
+
 static int citp_tcp_accept(citp_fdinfo* fdinfo,
                            struct sockaddr* sa, socklen_t* p_sa_len,
                            int flags,
@@ -921,8 +955,7 @@ check_ul_accept_q:
     return -1;
   }
 
-  if( ci_tcp_acceptq_n(listener) ) {
-      ci_sock_lock(ni, &listener->s.b);
+  if( ci_tcp_acceptq_n(listener) && citp_tcp_accept_lock(ni, listener) ) {
       if( ci_tcp_acceptq_not_empty(listener) ) {
           /* delayed error report (after a connect came) */
           if( CI_UNLIKELY(p_sa_len == NULL && sa != NULL) ) {
@@ -1327,17 +1360,21 @@ static void citp_tcp_close_active_cached(ci_netif* netif, citp_fdinfo* fdinfo)
 
 #if CI_CFG_FD_CACHING
 /* Check whether a socket's local port is in the list of permitted ports for
- * caching.
+ * caching.  The local port of an active-open socket is usually ephemeral, so
+ * for those the remote port is checked too.
  */
 static int citp_tcp_cache_port_eligible(ci_sock_cmn* s) {
   struct ci_port_list *sock_cache_port;
+  int active = (s->b.state & CI_TCP_STATE_TCP_CONN) &&
+               ~SOCK_TO_TCP(s)->tcpflags & CI_TCPT_FLAG_PASSIVE_OPENED;
 
   if( CITP_OPTS.sock_cache_ports == 0 )
     return 1;
 
   CI_DLLIST_FOR_EACH2(struct ci_port_list, sock_cache_port, link,
                       (ci_dllist*)(ci_uintptr_t)CITP_OPTS.sock_cache_ports)
-    if( sock_cache_port->port == sock_lport_be16(s) )
+    if( sock_cache_port->port == sock_lport_be16(s) ||
+        (active && sock_cache_port->port == sock_rport_be16(s)) )
       return 1;
 
   return 0;
@@ -1367,6 +1404,11 @@ static int citp_tcp_cache(citp_fdinfo* fdinfo)
    */
   if( s->b.sb_aflags & CI_SB_AFLAG_OS_BACKED ) {
     Log_EP(ci_log("FD %d not cached - has backing socket", fdinfo->fd));
+    /* Active-opens get a backing socket when they bind a local port of
+     * their own, i.e. unless they use EF_TCP_SHARED_LOCAL_PORTS. */
+    if( (s->b.state & CI_TCP_STATE_TCP_CONN) &&
+        ~SOCK_TO_TCP(s)->tcpflags & CI_TCPT_FLAG_PASSIVE_OPENED )
+      CITP_STATS_NETIF(++netif->state->stats.active_sockcache_os_backed);
     return 0;
   }
 
@@ -1754,10 +1796,58 @@ static int citp_tcp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg,
   return -1;
 }
 
+/* sendmsg(MSG_FASTOPEN) on an unconnected socket: connect, with as much of
+ * the data as we can in the SYN.  A blocking socket then sends the rest.
+ */
+static int citp_tcp_send_fastopen(citp_fdinfo* fdinfo,
+                                  const struct msghdr* msg, int flags)
+{
+  citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
+  const struct iovec* iov = msg->msg_iov;
+  int iovlen = msg->msg_iovlen;
+  int sent, n, rc;
+
+  if( ~NI_OPTS(epi->sock.netif).tcp_fastopen & EF_TCP_FASTOPEN_CLIENT )
+    RET_WITH_ERRNO(EOPNOTSUPP);
+
+  sent = ci_tcp_connect_fastopen(&epi->sock, msg->msg_name,
+                                 msg->msg_namelen, fdinfo->fd, iov, iovlen);
+  if( sent < 0 || (epi->sock.s->b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK |
+                                               CI_SB_AFLAG_O_NDELAY)) )
+    return sent;
+
+  /* Skip what went in the SYN. */
+  for( n = sent; iovlen > 0 && n >= (int) iov->iov_len; ++iov, --iovlen )
+    n -= iov->iov_len;
+  if( iovlen == 0 )
+    return sent;
+  flags &= ~MSG_FASTOPEN;
+  if( n != 0 ) {
+    struct iovec io = { (char*) iov->iov_base + n, iov->iov_len - n };
+    rc = ci_tcp_sendmsg(epi->sock.netif, SOCK_TO_TCP(epi->sock.s),
+                        &io, 1, flags);
+    if( rc < (int) io.iov_len )
+      return rc < 0 && sent == 0 ? rc : sent + CI_MAX(rc, 0);
+    sent += rc;
+    ++iov;
+    --iovlen;
+  }
+  if( iovlen > 0 ) {
+    rc = ci_tcp_sendmsg(epi->sock.netif, SOCK_TO_TCP(epi->sock.s),
+                        iov, iovlen, flags);
+    if( rc < 0 )
+      return sent == 0 ? rc : sent;
+    sent += rc;
+  }
+  return sent;
+}
+
+
 static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
                          int flags)
 {
   citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
+  int zerocopy = 0;
   int rc;
 
   ci_assert(msg != NULL);
@@ -1766,6 +1856,11 @@ static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
                                   CI_SB_AFLAG_O_NDELAY) ) {
     flags |= MSG_DONTWAIT;
   }
+  /* As Linux, MSG_ZEROCOPY is ignored unless SO_ZEROCOPY is set. */
+  if( CI_UNLIKELY(flags & MSG_ZEROCOPY) ) {
+    zerocopy = epi->sock.s->s_aflags & CI_SOCK_AFLAG_ZEROCOPY;
+    flags &= ~MSG_ZEROCOPY;
+  }
 
   if(CI_LIKELY( msg->msg_iov != NULL && msg->msg_iovlen > 0 )) {
     ci_uint32 state;
@@ -1781,12 +1876,18 @@ static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
      * state inside ci_tcp_sendmsg(). */
     if( CI_UNLIKELY(state == CI_TCP_CLOSED || state == CI_TCP_LISTEN ||
                     state == CI_TCP_INVALID) ) {
-      if( CI_UNLIKELY(flags & ONLOAD_MSG_WARM) )
-        ++SOCK_TO_TCP(epi->sock.s)->stats.tx_msg_warm_abort;
-      if( (rc = ci_get_so_error(epi->sock.s)) != 0 )
-        CI_SET_ERROR(rc, rc);
-      else
-        CI_SET_ERROR(rc, EPIPE);
+      if( state == CI_TCP_CLOSED && (flags & MSG_FASTOPEN) &&
+          msg->msg_name != NULL ) {
+        rc = citp_tcp_send_fastopen(fdinfo, msg, flags);
+      }
+      else {
+        if( CI_UNLIKELY(flags & ONLOAD_MSG_WARM) )
+          ++SOCK_TO_TCP(epi->sock.s)->stats.tx_msg_warm_abort;
+        if( (rc = ci_get_so_error(epi->sock.s)) != 0 )
+          CI_SET_ERROR(rc, rc);
+        else
+          CI_SET_ERROR(rc, EPIPE);
+      }
     }
     else {
       rc = ci_tcp_sendmsg(epi->sock.netif, SOCK_TO_TCP(epi->sock.s),
@@ -1811,6 +1912,8 @@ static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
     oo_resource_op(ci_netif_get_driver_handle(epi->sock.netif), 
                    OO_IOC_KILL_SELF_SIGPIPE, NULL);
   }
+  if( zerocopy && rc > 0 )
+    ci_sock_zc_copied(epi->sock.netif, epi->sock.s, 1);
   Log_V(log(LPF "send("EF_FMT") = %d", EF_PRI_ARGS(epi,fdinfo->fd),rc));
   return rc;
 }
@@ -2200,17 +2303,9 @@ int citp_sock_is_spinning(citp_fdinfo* fdi)
 
 
 
-enum onload_delegated_send_rc
-citp_tcp_ds_prepare(citp_fdinfo* fdi, int size, unsigned flags,
-                    struct onload_delegated_send* out)
+static enum onload_delegated_send_rc
+citp_tcp_ds_check(ci_sock_cmn* s)
 {
-  citp_sock_fdi* epi = fdi_to_sock_fdi(fdi);
-  ci_netif* ni = epi->sock.netif;
-  ci_sock_cmn* s = epi->sock.s;
-  ci_tcp_state* ts;
-  enum onload_delegated_send_rc rc = ONLOAD_DELEGATED_SEND_RC_OK;
-  enum onload_delegated_send_rc rc1;
-
   /* Basic checks */
   if( s->tx_errno != 0
 #if CI_CFG_TIMESTAMPING
@@ -2218,18 +2313,23 @@ citp_tcp_ds_prepare(citp_fdinfo* fdi, int size, unsigned flags,
 #endif
       )
     return ONLOAD_DELEGATED_SEND_RC_BAD_SOCKET;
-  ts = SOCK_TO_TCP(epi->sock.s);
-  if( ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE )
+  if( SOCK_TO_TCP(s)->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE )
     return ONLOAD_DELEGATED_SEND_RC_BAD_SOCKET;
+  return ONLOAD_DELEGATED_SEND_RC_OK;
+}
 
-  /* We lock the stack at this point to ensure that the prequeue has been
-   * flushed, and also to prevent various sequence numbers changing under our
-   * feet. */
-  ci_netif_lock(ni);
-  if( ci_tcp_sendq_not_empty(ts) ) {
-    rc = ONLOAD_DELEGATED_SEND_RC_SENDQ_BUSY;
-    goto unlock_out;
-  }
+
+static enum onload_delegated_send_rc
+__citp_tcp_ds_prepare(ci_netif* ni, ci_tcp_state* ts, int size, unsigned flags,
+                      struct onload_delegated_send* out)
+{
+  enum onload_delegated_send_rc rc = ONLOAD_DELEGATED_SEND_RC_OK;
+  enum onload_delegated_send_rc rc1;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( ci_tcp_sendq_not_empty(ts) )
+    return ONLOAD_DELEGATED_SEND_RC_SENDQ_BUSY;
 
   /* Calculate the windows */
   out->mss = tcp_eff_mss(ts);
@@ -2245,27 +2345,72 @@ citp_tcp_ds_prepare(citp_fdinfo* fdi, int size, unsigned flags,
   }
   if( out->send_wnd <= 0 ) {
     out->send_wnd = 0;
-    rc = ONLOAD_DELEGATED_SEND_RC_NOWIN;
-    goto unlock_out;
+    return ONLOAD_DELEGATED_SEND_RC_NOWIN;
   }
 
 
   rc1 = ci_tcp_ds_fill_headers(ni, ts, flags, out->headers, &out->headers_len,
                               &out->ip_tcp_hdr_len,
                               &out->tcp_seq_offset, &out->ip_len_offset);
-  if( rc1 != ONLOAD_DELEGATED_SEND_RC_OK ) {
-    rc = rc1;
-    goto unlock_out;
-  }
+  if( rc1 != ONLOAD_DELEGATED_SEND_RC_OK )
+    return rc1;
 
   /* Tell TCP state to be ready for ACKs from future */
   ts->snd_delegated = CI_MIN(size, out->send_wnd);
+  return rc;
+}
 
- unlock_out:
+
+enum onload_delegated_send_rc
+citp_tcp_ds_prepare(citp_fdinfo* fdi, int size, unsigned flags,
+                    struct onload_delegated_send* out)
+{
+  citp_sock_fdi* epi = fdi_to_sock_fdi(fdi);
+  ci_netif* ni = epi->sock.netif;
+  enum onload_delegated_send_rc rc;
+
+  rc = citp_tcp_ds_check(epi->sock.s);
+  if( rc != ONLOAD_DELEGATED_SEND_RC_OK )
+    return rc;
+
+  /* We lock the stack at this point to ensure that the prequeue has been
+   * flushed, and also to prevent various sequence numbers changing under our
+   * feet. */
+  ci_netif_lock(ni);
+  rc = __citp_tcp_ds_prepare(ni, SOCK_TO_TCP(epi->sock.s), size, flags, out);
   ci_netif_unlock(ni);
   return rc;
 }
 
+
+int
+citp_tcp_ds_prepare_batch(ci_netif* ni, citp_fdinfo** fdis,
+                          struct onload_delegated_send_batch* batch, int n,
+                          unsigned flags)
+{
+  citp_sock_fdi* epi;
+  int i, n_ok = 0;
+
+  for( i = 0; i < n; ++i ) {
+    ci_assert(fdi_to_sock_fdi(fdis[i])->sock.netif == ni);
+    batch[i].rc = citp_tcp_ds_check(fdi_to_sock_fdi(fdis[i])->sock.s);
+  }
+
+  /* All of the sockets are in one stack, so one lock hold covers them. */
+  ci_netif_lock(ni);
+  for( i = 0; i < n; ++i ) {
+    if( batch[i].rc != ONLOAD_DELEGATED_SEND_RC_OK )
+      continue;
+    epi = fdi_to_sock_fdi(fdis[i]);
+    batch[i].rc = __citp_tcp_ds_prepare(ni, SOCK_TO_TCP(epi->sock.s),
+                                        batch[i].size, flags, &batch[i].ds);
+    if( batch[i].rc == ONLOAD_DELEGATED_SEND_RC_OK )
+      ++n_ok;
+  }
+  ci_netif_unlock(ni);
+  return n_ok;
+}
+
 int citp_tcp_ds_complete(citp_fdinfo* fdi, const ci_iovec *iov, int iovlen,
                          int flags)
 {
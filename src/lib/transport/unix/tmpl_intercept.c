@@ -75,6 +75,83 @@ onload_msg_template_update(int fd, onload_template_handle handle,
 }
 
 
+int
+onload_msg_template_update_batch(struct onload_template_msg_update_batch* batch,
+                                 int n, unsigned flags)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  int i, n_run, rc = 0;
+#if CI_CFG_PIO
+  citp_fdinfo* run_fdi[CI_TCP_TMPL_BATCH_MAX];
+  ci_tcp_state* run_ts[CI_TCP_TMPL_BATCH_MAX];
+  ci_netif* ni;
+  int j;
+#endif
+
+  Log_CALL(ci_log("%s(%p, %d, %d)", __FUNCTION__, batch, n, flags));
+
+  if( n < 0 ) {
+    Log_CALL_RESULT(-EINVAL);
+    return -EINVAL;
+  }
+
+  citp_enter_lib(&lib_context);
+  for( i = 0; i < n; i += n_run ) {
+    n_run = 0;
+#if CI_CFG_PIO
+    /* Gather a run of TCP sockets in one stack so that they can be done
+     * under a single lock. */
+    ni = NULL;
+    while( i + n_run < n && n_run < CI_TCP_TMPL_BATCH_MAX ) {
+      fdi = citp_fdtable_lookup(batch[i + n_run].otmb_fd);
+      if( fdi == NULL )
+        break;
+      if( citp_fdinfo_get_type(fdi) != CITP_TCP_SOCKET ||
+          (ni != NULL && fdi_to_sock_fdi(fdi)->sock.netif != ni) ||
+          SOCK_TO_TCP(fdi_to_sock_fdi(fdi)->sock.s)->s.b.state ==
+            CI_TCP_LISTEN ) {
+        citp_fdinfo_release_ref(fdi, 0);
+        break;
+      }
+      ni = fdi_to_sock_fdi(fdi)->sock.netif;
+      run_fdi[n_run] = fdi;
+      run_ts[n_run] = SOCK_TO_TCP(fdi_to_sock_fdi(fdi)->sock.s);
+      ++n_run;
+    }
+    if( n_run > 0 ) {
+      ci_tcp_tmpl_update_batch(ni, run_ts, &batch[i], n_run, flags);
+      for( j = 0; j < n_run; ++j )
+        citp_fdinfo_release_ref(run_fdi[j], 0);
+    }
+    else
+#endif
+    {
+      /* Not something we can batch, so hand it to the fd on its own. */
+      n_run = 1;
+      if( (fdi = citp_fdtable_lookup(batch[i].otmb_fd)) != NULL ) {
+        batch[i].otmb_rc = citp_fdinfo_get_ops(fdi)->
+          tmpl_update(fdi, batch[i].otmb_handle, batch[i].otmb_updates,
+                      batch[i].otmb_ulen, flags);
+        citp_fdinfo_release_ref(fdi, 0);
+      }
+      else {
+        batch[i].otmb_rc = -ESOCKTNOSUPPORT;
+      }
+    }
+  }
+  citp_exit_lib(&lib_context, TRUE);
+
+  for( i = 0; i < n; ++i )
+    if( batch[i].otmb_rc < 0 ) {
+      rc = batch[i].otmb_rc;
+      break;
+    }
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 int onload_msg_template_abort(int fd, onload_template_handle handle)
 {
   struct oo_msg_template* omt = handle;
@@ -415,6 +415,7 @@ static int citp_udp_send(citp_fdinfo* fdinfo, const struct msghdr * msg,
 {
   citp_sock_fdi *epi = fdi_to_sock_fdi(fdinfo);
   ci_udp_iomsg_args a;
+  int zerocopy = 0;
   int rc;
 
   ci_assert(msg != NULL);
@@ -424,6 +425,14 @@ static int citp_udp_send(citp_fdinfo* fdinfo, const struct msghdr * msg,
   a.ni = epi->sock.netif;
   a.us = SOCK_TO_UDP(epi->sock.s);
 
+  /* As Linux, MSG_ZEROCOPY is ignored unless SO_ZEROCOPY is set.  It is
+   * never passed on, so that datagrams sent via the OS socket are
+   * notified by us too, and the ids stay in sequence. */
+  if( CI_UNLIKELY(flags & MSG_ZEROCOPY) ) {
+    zerocopy = epi->sock.s->s_aflags & CI_SOCK_AFLAG_ZEROCOPY;
+    flags &= ~MSG_ZEROCOPY;
+  }
+
   /* NB. msg_name[len] validated in ci_udp_sendmsg(). */
   if(CI_LIKELY( msg->msg_iov != NULL || msg->msg_iovlen == 0 )) {
     rc = ci_udp_sendmsg( &a, msg, flags);
@@ -432,6 +441,8 @@ static int citp_udp_send(citp_fdinfo* fdinfo, const struct msghdr * msg,
     rc = -1;
     errno = EFAULT;
   }
+  if( zerocopy && rc >= 0 )
+    ci_sock_zc_copied(a.ni, epi->sock.s, 1);
   return rc;
 }
 
@@ -441,7 +452,8 @@ static int citp_udp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* mmsg,
 {
   citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
   ci_udp_iomsg_args a;
-  int i, rc;
+  int zerocopy = 0;
+  int rc;
 
   Log_V(log(LPF "sendmmsg(%d, msg, %u, %#x)", fdinfo->fd, vlen, 
             (unsigned) flags));
@@ -454,15 +466,16 @@ static int citp_udp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* mmsg,
   a.ni = epi->sock.netif;
   a.us = SOCK_TO_UDP(epi->sock.s);
 
-  i = 0;
+  /* See citp_udp_send(). */
+  if( CI_UNLIKELY(flags & MSG_ZEROCOPY) ) {
+    zerocopy = epi->sock.s->s_aflags & CI_SOCK_AFLAG_ZEROCOPY;
+    flags &= ~MSG_ZEROCOPY;
+  }
 
-  do {
-    rc = ci_udp_sendmsg(&a, &mmsg[i].msg_hdr, flags);
-    if(CI_LIKELY( rc >= 0 ) )
-      mmsg[i].msg_len = rc;
-    ++i;
-  } while( rc >= 0 && i < vlen );
-  return (rc>=0) ? i : rc;
+  rc = ci_udp_sendmmsg(&a, mmsg, vlen, flags);
+  if( zerocopy && rc > 0 )
+    ci_sock_zc_copied(a.ni, epi->sock.s, rc);
+  return rc;
 }
 
 
@@ -108,6 +108,7 @@ struct citp_epoll_member {
 #if CI_CFG_EPOLL3
   ci_dllink             dead_stack_link; /*!< Link for dead stack list */
   int                   ready_list_id;
+  int                   satellite;  /*!< index in satellites[] or -1 */
 #endif
   struct epoll_event    epoll_data;
   struct epoll_event    epfd_event; /*!< event synchronised to kernel */
@@ -132,6 +133,31 @@ enum {
 
 #define EPOLL_STACK_EITEM 1
 #define EPOLL_NON_STACK_EITEM 2
+
+#if CI_CFG_EPOLL3
+#define CITP_EPOLL_SATELLITES_MAX  OO_EPOLL1_SATELLITES_MAX
+
+/*! A stack other than the home stack in which the epoll set holds a ready
+ * list (EF_EPOLL_MULTI_STACK).  Members in such a stack are still non-home
+ * members, on [oo_sockets] and in the kernel set; the ready list only tells
+ * us when none of them can have become ready, so that we can skip them.
+ */
+struct citp_epoll_satellite {
+  ci_netif*  ni;          /*!< NULL if the slot is free */
+  int        ready_list;
+  int        n_members;
+  /* No member has been woken since a full pass over [oo_sockets] found no
+   * event on any of them. */
+  int        quiet;
+  /* Events found on members during the current pass. */
+  int        n_events;
+};
+#endif
+
+/* Maximum number of stacks across which onload_ordered_epoll_wait() orders
+ * events.  Sockets in further stacks are ordered only relative to these. */
+#define CITP_EPOLL_ORDERING_STACKS_MAX  8
+
 /*! Data associated with each epoll epfd.  */
 struct citp_epoll_fd {
   /* epoll_create() parameter */
@@ -162,6 +188,8 @@ struct citp_epoll_fd {
   /* List of onload sockets in non-home stack (struct citp_epoll_member) */
   ci_dllist             oo_sockets;
   int                   oo_sockets_n;
+  /* Bumped whenever membership of [oo_sockets] changes */
+  unsigned              oo_sockets_gen;
 
   /* List of deleted sockets (struct citp_epoll_member) */
   ci_dllist             dead_sockets;
@@ -188,6 +216,10 @@ struct citp_epoll_fd {
 #if CI_CFG_EPOLL3
   ci_netif* home_stack;
   int ready_list;
+
+  struct citp_epoll_satellite satellites[CITP_EPOLL_SATELLITES_MAX];
+  /* Number of members of [oo_sockets] in a satellite stack */
+  int                   satellite_members_n;
 #endif
 
   /*!< phase of the poll to ensure fairness between groups of sockets
@@ -202,6 +234,14 @@ struct citp_epoll_fd {
   struct citp_ordering_info* ordering_info;
   struct epoll_event* wait_events;
   int n_woda_events;
+
+  /* Stacks of the orderable sockets in [oo_sockets], each holding a
+   * reference.  Finding them means walking the whole set, so it is only
+   * redone when [oo_sockets_gen] moves on from [ordering_stacks_gen].
+   */
+  ci_netif* ordering_stacks[CITP_EPOLL_ORDERING_STACKS_MAX];
+  int n_ordering_stacks;
+  unsigned ordering_stacks_gen;
 #endif
 };
 
@@ -225,7 +265,9 @@ struct citp_ordered_wait {
   struct citp_ordering_info* ordering_info;
   int poll_again;
   ci_int64 next_timeout_hr;
-  ci_netif* ordering_stack;
+  /* Stacks of the sockets being ordered, each holding a reference */
+  ci_netif* ordering_stacks[CITP_EPOLL_ORDERING_STACKS_MAX];
+  int n_ordering_stacks;
 };
 
 /* Epoll state in user-land poll.  Copied from oo_ul_poll_state */
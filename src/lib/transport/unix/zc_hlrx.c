@@ -210,6 +210,65 @@ int onload_zc_hlrx_buffer_release(int fd, onload_zc_handle buf)
 }
 
 
+/* Number of last references onload_zc_hlrx_buffer_release_batch() collects
+ * before handing them to onload_zc_release_buffers() */
+#define HLRX_RELEASE_BATCH  64
+
+static int release_last_refs(int fd, onload_zc_handle* bufs, int n)
+{
+  int rc = onload_zc_release_buffers(fd, bufs, n);
+  if( rc < 0 ) {
+    int i;
+    /* As in onload_zc_buffer_decref(), the caller keeps its ref. */
+    for( i = 0; i < n; ++i )
+      zc_handle_to_pktbuf(bufs[i])->user_refcount = CI_ZC_USER_REFCOUNT_ONE;
+  }
+  return rc;
+}
+
+
+int onload_zc_hlrx_buffer_release_batch(int fd, const onload_zc_handle* bufs,
+                                        int n_bufs)
+{
+  onload_zc_handle last_refs[HLRX_RELEASE_BATCH];
+  int i, n = 0, rc = 0;
+
+  Log_CALL(ci_log("%s(%d, %p, %d)", __FUNCTION__, fd, bufs, n_bufs));
+
+  for( i = 0; i < n_bufs; ++i ) {
+    onload_zc_handle buf = bufs[i];
+    ci_ip_pkt_fmt* pkt;
+
+    if(CI_UNLIKELY( zc_is_remote(buf) )) {
+      uint64_t* rd = zc_handle_to_remote(buf);
+      OO_ACCESS_ONCE(*rd) |= HLRX_REMOTE_PTR_DONE_FLAG;
+      continue;
+    }
+
+    /* Drop the refs without the stack lock, exactly as
+     * onload_zc_buffer_decref() does, and only collect the packets for
+     * which this was the last one. */
+    pkt = zc_handle_to_pktbuf(buf);
+    if( pkt->user_refcount == CI_ZC_USER_REFCOUNT_ONE ||
+        __sync_sub_and_fetch(&pkt->user_refcount, 1) <
+            CI_ZC_USER_REFCOUNT_ONE ) {
+      last_refs[n++] = buf;
+      if( n == HLRX_RELEASE_BATCH ) {
+        if( (rc = release_last_refs(fd, last_refs, n)) < 0 )
+          goto out;
+        n = 0;
+      }
+    }
+  }
+  if( n != 0 )
+    rc = release_last_refs(fd, last_refs, n);
+
+ out:
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 /* *********************************************************************** */
 
 /* Temporary structure we need to pass as the cookie to the callback of
@@ -380,16 +439,15 @@ struct zc_cb_zc_state {
 
 static void zc_buffer_addref(int fd, onload_zc_handle buf, int delta)
 {
-  /* In due course (and if benchmarks show it's needed) a built-in
-   * implementation of this function is a good idea */
+  /* A message spread over many iovs gives out one ref per iov, so take
+   * them all with a single atomic rather than one onload_zc_buffer_incref()
+   * each.  Only the ref hlrx itself owns is ever dropped here. */
   while( delta < 0 ) {
     onload_zc_buffer_decref(fd, buf);
     ++delta;
   }
-  while( delta > 0 ) {
-    onload_zc_buffer_incref(fd, buf);
-    --delta;
-  }
+  if( delta > 0 )
+    __sync_add_and_fetch(&zc_handle_to_pktbuf(buf)->user_refcount, delta);
 }
 
 
@@ -278,7 +278,7 @@ int onload_zc_query_rx_memregs(int fd, struct onload_zc_iovec* iov,
        * is a future possibility to add a flag which causes this part not to
        * happen, if such a thing is found to be useful. */
       while( ni->packets->sets_n < ni->packets->sets_max ) {
-        rc = ci_tcp_helper_more_bufs(ni);
+        rc = ci_tcp_helper_more_bufs(ni, -1);
         if( rc != 0 )
           break;
       }
@@ -338,6 +338,71 @@ int onload_zc_recv(int fd, struct onload_zc_recv_args* args)
 }
 
 
+int onload_zc_recv_mmsg(struct onload_zc_recv_mmsg* msgs, int mlen)
+{
+  int total = 0, i;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  citp_sock_fdi* epi;
+  ci_netif* polled_ni = NULL;
+  ci_udp_iomsg_args a;
+
+  Log_CALL(ci_log("%s(%p, %d)", __FUNCTION__, msgs, mlen));
+
+  if( mlen < 1 )
+    return -EINVAL;
+
+  citp_enter_lib(&lib_context);
+
+  for( i = 0; i < mlen; ++i ) {
+    fdi = citp_fdtable_lookup(msgs[i].fd);
+    if( fdi == NULL ) {
+      msgs[i].rc = -ESOCKTNOSUPPORT;
+      continue;
+    }
+    if( citp_fdinfo_get_type(fdi) != CITP_UDP_SOCKET ) {
+      msgs[i].rc = -ESOCKTNOSUPPORT;
+      citp_fdinfo_release_ref(fdi, 0);
+      continue;
+    }
+    if( msgs[i].args.flags & ~ONLOAD_ZC_RECV_FLAGS_MASK ) {
+      msgs[i].rc = -EINVAL;
+      citp_fdinfo_release_ref(fdi, 0);
+      continue;
+    }
+
+    epi = fdi_to_sock_fdi(fdi);
+    a.fd = fdi->fd;
+    a.ep = &epi->sock;
+    a.ni = epi->sock.netif;
+    a.us = SOCK_TO_UDP(epi->sock.s);
+
+    /* Poll each stack once, on reaching its first socket, so that all of
+     * its sockets' receive queues are filled with a single lock
+     * acquisition.  If the lock is busy then whoever holds it is polling.
+     */
+    if( a.ni != polled_ni ) {
+      polled_ni = a.ni;
+      if( ci_netif_may_poll(a.ni) && ci_netif_need_poll(a.ni) &&
+          ci_netif_trylock(a.ni) ) {
+        ci_netif_poll(a.ni);
+        ci_netif_unlock(a.ni);
+      }
+    }
+
+    msgs[i].rc = ci_udp_zc_recv_ready(&a, &msgs[i].args);
+    if( msgs[i].rc > 0 )
+      total += msgs[i].rc;
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+
+  citp_exit_lib(&lib_context, TRUE);
+
+  Log_CALL_RESULT(total);
+  return total;
+}
+
+
 
 int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 {
@@ -386,6 +451,218 @@ int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 }
 
 
+/* Most segments moved by one call to onload_zc_forward() */
+#define ZC_FORWARD_MAX  64
+
+struct zc_forward {
+  struct onload_zc_recv_args args;
+  struct onload_zc_iovec iov[ZC_FORWARD_MAX];
+  int n, max;
+};
+
+
+static enum onload_zc_callback_rc
+zc_forward_cb(struct onload_zc_recv_args* args, int flags)
+{
+  struct zc_forward* f = CI_CONTAINER(struct zc_forward, args, args);
+
+  f->iov[f->n++] = args->msg.iov[0];
+  return ONLOAD_ZC_KEEP |
+         (f->n < f->max ? ONLOAD_ZC_CONTINUE : ONLOAD_ZC_TERMINATE);
+}
+
+
+static void zc_forward_release(ci_netif* ni, struct onload_zc_iovec* iov,
+                               int n)
+{
+  ci_ip_pkt_fmt* pkt;
+  int i;
+
+  ci_netif_lock(ni);
+  for( i = 0; i < n; ++i ) {
+    pkt = zc_handle_to_pktbuf(iov[i].buf);
+    pkt->pio_addr = -1;  /* Got reused by user_refcount */
+    ci_netif_pkt_release_check_keep(ni, pkt);
+  }
+  ci_netif_unlock(ni);
+}
+
+
+/* Queue buffers adopted by ci_tcp_zc_adopt_rx_pkt().  Returns the number
+ * of bytes sent or -errno, and releases any buffers not consumed. */
+static int zc_forward_send_zc(ci_netif* ni, ci_tcp_state* ts,
+                              struct onload_zc_iovec* iov, int n)
+{
+  struct onload_zc_mmsg msg;
+  int i, sent;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg.iov = iov;
+  msg.msg.msghdr.msg_iovlen = n;
+  ci_tcp_zc_send(ni, ts, &msg, MSG_NOSIGNAL);
+
+  for( i = 0, sent = 0; i < n && sent < msg.rc; ++i )
+    sent += iov[i].iov_len;
+  if( i < n )
+    zc_forward_release(ni, iov + i, n - i);
+  return msg.rc;
+}
+
+
+/* Copy the payload of received buffers straight into the send queue, and
+ * release them. */
+static int zc_forward_send_copy(ci_netif* out_ni, ci_tcp_state* out_ts,
+                                ci_netif* in_ni, struct onload_zc_iovec* iov,
+                                int n)
+{
+  ci_iovec ciov[ZC_FORWARD_MAX];
+  int i, rc;
+
+  for( i = 0; i < n; ++i ) {
+    CI_IOVEC_BASE(&ciov[i]) = iov[i].iov_base;
+    CI_IOVEC_LEN(&ciov[i]) = iov[i].iov_len;
+  }
+  rc = ci_tcp_sendmsg(out_ni, out_ts, ciov, n, MSG_NOSIGNAL);
+  if( rc < 0 )
+    rc = -errno;
+  zc_forward_release(in_ni, iov, n);
+  return rc;
+}
+
+
+int onload_zc_forward(int in_fd, int out_fd, int flags)
+{
+  int rc, i, j, space, sock_locked, total = 0;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* in_fdi;
+  citp_fdinfo* out_fdi = NULL;
+  citp_sock_fdi* in_epi;
+  citp_sock_fdi* out_epi;
+  ci_netif* in_ni;
+  ci_netif* out_ni;
+  ci_tcp_state* in_ts;
+  ci_tcp_state* out_ts;
+  ci_uint32 state;
+  struct zc_forward f;
+  int is_zc[ZC_FORWARD_MAX];
+
+  Log_CALL(ci_log("%s(%d, %d, %x)", __FUNCTION__, in_fd, out_fd, flags));
+
+  if( flags & ~ONLOAD_MSG_DONTWAIT )
+    return -EINVAL;
+
+  citp_enter_lib(&lib_context);
+
+  in_fdi = citp_fdtable_lookup(in_fd);
+  if( in_fdi != NULL )
+    out_fdi = citp_fdtable_lookup(out_fd);
+  if( out_fdi == NULL ||
+      citp_fdinfo_get_type(in_fdi) != CITP_TCP_SOCKET ||
+      citp_fdinfo_get_type(out_fdi) != CITP_TCP_SOCKET ) {
+    rc = -ESOCKTNOSUPPORT;
+    goto out;
+  }
+  in_epi = fdi_to_sock_fdi(in_fdi);
+  out_epi = fdi_to_sock_fdi(out_fdi);
+  in_ni = in_epi->sock.netif;
+  out_ni = out_epi->sock.netif;
+
+  if( in_epi->sock.s->b.state == CI_TCP_LISTEN ) {
+    rc = -ENOTCONN;
+    goto out;
+  }
+  /* Check [out_fd] can take data before taking any from [in_fd]. */
+  state = OO_ACCESS_ONCE(out_epi->sock.s->b.state);
+  if( state == CI_TCP_CLOSED || state == CI_TCP_LISTEN ||
+      state == CI_TCP_INVALID ) {
+    rc = ci_get_so_error(out_epi->sock.s);
+    rc = rc ? -rc : -EPIPE;
+    goto out;
+  }
+  in_ts = SOCK_TO_TCP(in_epi->sock.s);
+  out_ts = SOCK_TO_TCP(out_epi->sock.s);
+  if( ci_tcp_is_pluginized(in_ts) ) {
+    rc = -EOPNOTSUPP;
+    goto out;
+  }
+
+  /* Take no more segments than [out_fd] has room for, so that everything
+   * we take can be queued without waiting. */
+  ci_netif_lock(out_ni);
+  space = ci_tcp_tx_send_space(out_ni, out_ts);
+  ci_netif_unlock(out_ni);
+  if( space <= 0 ) {
+    if( flags & ONLOAD_MSG_DONTWAIT ) {
+      rc = -EAGAIN;
+      goto out;
+    }
+    space = 1;
+  }
+
+  memset(&f.args, 0, sizeof(f.args));
+  f.args.cb = zc_forward_cb;
+  f.args.flags = flags;
+  f.n = 0;
+  f.max = CI_MIN(space, ZC_FORWARD_MAX);
+  rc = citp_fdinfo_get_ops(in_fdi)->zc_recv(in_fdi, &f.args);
+  if( f.n == 0 )
+    goto out;
+
+  /* Within a stack, buffers whose payload will fit in a segment of
+   * [out_fd] are moved across as they are.  The receive queue still holds
+   * a reference to the buffers until it is reaped, which we do here rather
+   * than waiting for the next receive. */
+  memset(is_zc, 0, sizeof(is_zc));
+  if( in_ni == out_ni ) {
+    sock_locked = ci_sock_trylock(in_ni, &in_ts->s.b);
+    ci_netif_lock(in_ni);
+    if( sock_locked )
+      ci_tcp_rx_reap_rxq_bufs_socklocked(in_ni, in_ts);
+    else
+      ci_tcp_rx_reap_rxq_bufs(in_ni, in_ts);
+    for( i = 0; i < f.n; ++i ) {
+      is_zc[i] = ci_tcp_zc_adopt_rx_pkt(in_ni, out_ts,
+                                        zc_handle_to_pktbuf(f.iov[i].buf),
+                                        &f.iov[i]);
+      if( is_zc[i] )
+        CITP_STATS_NETIF_INC(in_ni, tcp_zc_forward_pkts);
+    }
+    ci_netif_unlock(in_ni);
+    if( sock_locked )
+      ci_sock_unlock(in_ni, &in_ts->s.b);
+  }
+
+  /* Send runs of adopted and copied buffers in order.  Once [out_fd] has
+   * failed what is left can only be dropped. */
+  rc = 0;
+  for( i = 0; i < f.n; i = j ) {
+    for( j = i + 1; j < f.n && is_zc[j] == is_zc[i]; ++j )
+      ;
+    if( rc < 0 ) {
+      zc_forward_release(in_ni, f.iov + i, j - i);
+      continue;
+    }
+    if( is_zc[i] )
+      rc = zc_forward_send_zc(out_ni, out_ts, f.iov + i, j - i);
+    else
+      rc = zc_forward_send_copy(out_ni, out_ts, in_ni, f.iov + i, j - i);
+    if( rc > 0 )
+      total += rc;
+  }
+  if( total > 0 )
+    rc = total;
+
+ out:
+  if( out_fdi != NULL )
+    citp_fdinfo_release_ref(out_fdi, 0);
+  if( in_fdi != NULL )
+    citp_fdinfo_release_ref(in_fdi, 0);
+  citp_exit_lib(&lib_context, rc >= 0);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 int onload_set_recv_filter(int fd, onload_zc_recv_filter_callback filter,
                            void* cb_arg, int flags)
 {
@@ -552,6 +829,126 @@ int onload_zc_unregister_buffers(int fd, onload_zc_handle handle, int flags)
 }
 
 
+#ifdef OO_MMAP_TYPE_DSHM
+static int zc_shm_map(ci_netif* ni, int id, uint64_t len, void** addr_out)
+{
+  return oo_resource_mmap(ci_netif_get_driver_handle(ni), OO_MMAP_TYPE_DSHM,
+                          OO_MMAP_DSHM_MAKE_ID(OO_DSHM_CLASS_ZC_SHM, id),
+                          len, OO_MMAP_FLAG_DEFAULT, addr_out);
+}
+#endif
+
+
+int onload_zc_shm_create(int fd, uint64_t len, int* id_out, void** addr_out)
+{
+  int rc;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+
+  Log_CALL(ci_log("%s(%d, %" PRIu64 ", %p, %p)",
+                  __FUNCTION__, fd, len, id_out, addr_out));
+
+  citp_enter_lib(&lib_context);
+
+#ifdef OO_MMAP_TYPE_DSHM
+  if( len == 0 || ! is_page_aligned(len) )
+    rc = -EINVAL;
+  else if( len > UINT_MAX )
+    rc = -E2BIG;
+  else if( (rc = fd_to_stack(fd, &ni, &fdi)) == 0 ) {
+    /* A NULL buffer asks the driver to allocate the pages, which can then
+     * be registered for DMA by whoever maps them. */
+    oo_dshm_register_t op = {
+      .shm_class = OO_DSHM_CLASS_ZC_SHM,
+      .length = len,
+    };
+    CI_USER_PTR_SET(op.buffer, NULL);
+    rc = oo_resource_op(ci_netif_get_driver_handle(ni),
+                        OO_IOC_DSHM_REGISTER, &op);
+    if( rc == 0 )
+      rc = zc_shm_map(ni, op.buffer_id, len, addr_out);
+    if( rc == 0 )
+      *id_out = op.buffer_id;
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+#else
+  rc = -ENOTSUP;
+#endif
+
+  citp_exit_lib(&lib_context, TRUE);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_zc_shm_list(int fd, int* ids, int* n_in_out)
+{
+  int rc;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+
+  Log_CALL(ci_log("%s(%d, %p, %p)", __FUNCTION__, fd, ids, n_in_out));
+
+  citp_enter_lib(&lib_context);
+
+#ifdef OO_MMAP_TYPE_DSHM
+  if( *n_in_out < 0 )
+    rc = -EINVAL;
+  else if( (rc = fd_to_stack(fd, &ni, &fdi)) == 0 ) {
+    oo_dshm_list_t op = {
+      .shm_class = OO_DSHM_CLASS_ZC_SHM,
+      .count = *n_in_out,
+    };
+    CI_USER_PTR_SET(op.buffer_ids, ids);
+    rc = oo_resource_op(ci_netif_get_driver_handle(ni),
+                        OO_IOC_DSHM_LIST, &op);
+    if( rc == 0 )
+      *n_in_out = op.count;
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+#else
+  rc = -ENOTSUP;
+#endif
+
+  citp_exit_lib(&lib_context, TRUE);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_zc_shm_map(int fd, int id, uint64_t len, void** addr_out)
+{
+  int rc;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+
+  Log_CALL(ci_log("%s(%d, %d, %" PRIu64 ", %p)",
+                  __FUNCTION__, fd, id, len, addr_out));
+
+  citp_enter_lib(&lib_context);
+
+#ifdef OO_MMAP_TYPE_DSHM
+  if( id < 0 || len == 0 || ! is_page_aligned(len) )
+    rc = -EINVAL;
+  else if( len > UINT_MAX )
+    rc = -E2BIG;
+  else if( (rc = fd_to_stack(fd, &ni, &fdi)) == 0 ) {
+    rc = zc_shm_map(ni, id, len, addr_out);
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+#else
+  rc = -ENOTSUP;
+#endif
+
+  citp_exit_lib(&lib_context, TRUE);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 int onload_recvmsg_kernel(int fd, struct msghdr *msg, int flags)
 {
   int rc;
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+# X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc.
+######################################################################
+# Compare two sets of onload_bench results.
+#
+# Each input holds one JSON object per line, as written by onload_bench.
+# Runs are matched on benchmark name and parameters, and a metric counts
+# as a regression if it moves in the wrong direction by more than the
+# threshold.  Exits with status 1 if any regression is found.
+######################################################################
+
+from __future__ import print_function
+import json
+import sys
+
+
+# Metric name suffixes, and whether larger values are better.
+directions = [
+    ('_ns', False),
+    ('_bytes', False),
+    ('_mbps', True),
+    ('_per_sec', True),
+]
+
+
+def higher_is_better(metric):
+    for suffix, higher in directions:
+        if metric.endswith(suffix):
+            return higher
+    return None
+
+
+def load(path):
+    runs = {}
+    with open(path) as f:
+        for l in f:
+            l = l.strip()
+            if not l or l[0] == '#':
+                continue
+            r = json.loads(l)
+            key = (r['benchmark'], json.dumps(r['params'], sort_keys=True))
+            # Later runs of the same benchmark replace earlier ones.
+            runs[key] = r
+    return runs
+
+
+def main():
+    import optparse
+    op = optparse.OptionParser()
+    op.set_usage('%prog [options] BASELINE RESULTS')
+    op.add_option("-t", "--threshold", action="store", type='float',
+                  default=5.0, help="Regression threshold (percent)")
+    op.add_option("-a", "--all", action="store_true", default=False,
+                  help="Show all metrics, not only regressions")
+    opts, args = op.parse_args()
+    if len(args) != 2:
+        op.print_usage(sys.stderr)
+        sys.exit(2)
+
+    base = load(args[0])
+    new = load(args[1])
+    n_regressions = 0
+    for key in sorted(new):
+        if key not in base:
+            print("%-24s (no baseline)" % key[0])
+            continue
+        b_res = base[key]['results']
+        n_res = new[key]['results']
+        for metric in sorted(n_res):
+            higher = higher_is_better(metric)
+            if metric not in b_res or higher is None:
+                continue
+            b, n = b_res[metric], n_res[metric]
+            change = (n - b) * 100.0 / b if b else 0.0
+            worse = -change if higher else change
+            regressed = worse > opts.threshold
+            n_regressions += regressed
+            if regressed or opts.all:
+                print("%-24s %-28s %14.1f %14.1f %+8.1f%%%s" %
+                      (key[0], metric, b, n, change,
+                       "  REGRESSION" if regressed else ""))
+    if n_regressions:
+        print("%d regression(s) beyond %.1f%%" %
+              (n_regressions, opts.threshold))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
+    sys.exit(0)
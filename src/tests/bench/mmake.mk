@@ -0,0 +1,19 @@
+# SPDX-License-Identifier: GPL-2.0
+# X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc.
+
+TEST_APPS	:= onload_bench
+TARGETS		:= $(TEST_APPS:%=$(AppPattern)) bench_compare
+
+
+all: $(TARGETS)
+
+clean:
+	@$(MakeClean)
+
+
+MMAKE_LIBS	:= $(LINK_ONLOAD_EXT_LIB)
+MMAKE_LIB_DEPS	:= $(ONLOAD_EXT_LIB_DEPEND)
+
+
+bench_compare: bench_compare.py
+	cp $< $@
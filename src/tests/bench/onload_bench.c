@@ -0,0 +1,765 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* onload_bench: fast-path benchmarks for Onload sockets.
+ *
+ * Each client run emits one JSON object on a single line, so that the
+ * results of a suite can be appended to one file and compared between
+ * releases with bench_compare.py.  Network benchmarks talk to an
+ * "onload_bench server" on the peer host; epoll_wakeup and sock_footprint
+ * run on the local host only.
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <onload/extensions.h>
+
+
+#define TEST(x)                                                         \
+  do {                                                                  \
+    if( ! (x) ) {                                                       \
+      fprintf(stderr, "ERROR: %s: TEST(%s) failed\n", __func__, #x);    \
+      fprintf(stderr, "ERROR: at %s:%d\n", __FILE__, __LINE__);         \
+      fprintf(stderr, "ERROR: errno=%d (%s)\n", errno, strerror(errno)); \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+#define TRY(x)                                                          \
+  ({                                                                    \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s: TRY(%s) failed\n", __func__, #x);     \
+      fprintf(stderr, "ERROR: at %s:%d\n", __FILE__, __LINE__);         \
+      fprintf(stderr, "ERROR: rc=%d errno=%d (%s)\n",                   \
+              __rc, errno, strerror(errno));                            \
+      exit(1);                                                          \
+    }                                                                   \
+    __rc;                                                               \
+  })
+
+
+/* Sessions on the server's TCP port begin with this header. */
+enum bench_session {
+  SESSION_PINGPONG = 1,
+  SESSION_STREAM   = 2,
+  SESSION_STREAM_RX = 3,
+};
+
+struct bench_hdr {
+  uint32_t session;
+  uint32_t msg_size;
+};
+
+
+struct bench_opts {
+  const char* tag;
+  const char* host;
+  int         port;
+  int         msg_size;
+  int         n_iters;
+  int         n_warm_ups;
+  int         duration_s;
+  int         n_fds;
+  int         gap_us;
+  int         udp;
+};
+static struct bench_opts opts = {
+  .tag        = "",
+  .port       = 8765,
+  .msg_size   = 32,
+  .n_iters    = 100000,
+  .n_warm_ups = 10000,
+  .duration_s = 5,
+  .n_fds      = 1000,
+  .gap_us     = 100,
+};
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+
+static void get_addr(struct sockaddr_storage* ss, socklen_t* ss_len,
+                     const char* host, int port_num, int socktype)
+{
+  struct addrinfo hints, *ai;
+  char port[16];
+  int rc;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_flags = AI_PASSIVE;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = socktype;
+  snprintf(port, sizeof(port), "%d", port_num);
+  rc = getaddrinfo(host, port, &hints, &ai);
+  if( rc != 0 ) {
+    fprintf(stderr, "ERROR: getaddrinfo(%s, %s) failed: %s\n",
+            host ? host : "", port, gai_strerror(rc));
+    exit(1);
+  }
+  memcpy(ss, ai->ai_addr, ai->ai_addrlen);
+  *ss_len = ai->ai_addrlen;
+  freeaddrinfo(ai);
+}
+
+
+static int sock_connect(int socktype, int port)
+{
+  struct sockaddr_storage ss;
+  socklen_t ss_len;
+  int sock, one = 1;
+
+  get_addr(&ss, &ss_len, opts.host, port, socktype);
+  TRY( sock = socket(AF_INET, socktype, 0) );
+  if( socktype == SOCK_STREAM )
+    TRY( setsockopt(sock, SOL_TCP, TCP_NODELAY, &one, sizeof(one)) );
+  TRY( connect(sock, (struct sockaddr*) &ss, ss_len) );
+  return sock;
+}
+
+
+/* Port 0 binds to an ephemeral port. */
+static int sock_bind(int socktype, const char* host, int port)
+{
+  struct sockaddr_storage ss;
+  socklen_t ss_len;
+  int sock, one = 1;
+
+  get_addr(&ss, &ss_len, host, port, socktype);
+  TRY( sock = socket(AF_INET, socktype, 0) );
+  TRY( setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) );
+  TRY( bind(sock, (struct sockaddr*) &ss, ss_len) );
+  if( socktype == SOCK_STREAM )
+    TRY( listen(sock, 1024) );
+  return sock;
+}
+
+
+/**********************************************************************
+ * Output.
+ */
+
+static int json_n;
+
+static void json_begin(const char* bench)
+{
+  printf("{\"benchmark\": \"%s\", \"tag\": \"%s\", \"onload\": %s, "
+         "\"params\": {\"msg_size\": %d, \"iters\": %d, \"duration_s\": %d, "
+         "\"n_fds\": %d}, \"results\": {",
+         bench, opts.tag, onload_is_present() ? "true" : "false",
+         opts.msg_size, opts.n_iters, opts.duration_s, opts.n_fds);
+  json_n = 0;
+}
+
+
+static void json_result(const char* name, double val)
+{
+  printf("%s\"%s\": %.1f", json_n++ ? ", " : "", name, val);
+}
+
+
+static void json_end(void)
+{
+  printf("}}\n");
+  fflush(stdout);
+}
+
+
+static int compare_u64(const void* pa, const void* pb)
+{
+  uint64_t a = *(const uint64_t*) pa, b = *(const uint64_t*) pb;
+  return (a > b) - (a < b);
+}
+
+
+/* Sorts [samples] and emits their min, mean, percentiles and max. */
+static void json_percentiles(const char* prefix, uint64_t* samples, int n)
+{
+  static const struct { const char* name; int per_mille; } pc[] = {
+    { "median", 500 }, { "p90", 900 }, { "p99", 990 }, { "p99.9", 999 },
+  };
+  char name[64];
+  double sum = 0;
+  int i;
+
+  TEST( n > 0 );
+  qsort(samples, n, sizeof(samples[0]), compare_u64);
+  for( i = 0; i < n; ++i )
+    sum += samples[i];
+
+  snprintf(name, sizeof(name), "%s_min_ns", prefix);
+  json_result(name, samples[0]);
+  snprintf(name, sizeof(name), "%s_mean_ns", prefix);
+  json_result(name, sum / n);
+  for( i = 0; i < sizeof(pc) / sizeof(pc[0]); ++i ) {
+    snprintf(name, sizeof(name), "%s_%s_ns", prefix, pc[i].name);
+    json_result(name, samples[(uint64_t) n * pc[i].per_mille / 1000]);
+  }
+  snprintf(name, sizeof(name), "%s_max_ns", prefix);
+  json_result(name, samples[n - 1]);
+}
+
+
+/**********************************************************************
+ * Server.
+ */
+
+static void serve_pingpong(int sock, int msg_size)
+{
+  char* buf;
+  ssize_t rc;
+
+  TEST( (buf = malloc(msg_size)) != NULL );
+  while( (rc = recv(sock, buf, msg_size, MSG_WAITALL)) == msg_size )
+    if( send(sock, buf, msg_size, 0) != msg_size )
+      break;
+  free(buf);
+}
+
+
+static void serve_stream(int sock)
+{
+  static char buf[65536];
+  uint64_t bytes = 0;
+  ssize_t rc;
+
+  while( (rc = recv(sock, buf, sizeof(buf), 0)) > 0 )
+    bytes += rc;
+  send(sock, &bytes, sizeof(bytes), 0);
+}
+
+
+/* Send as fast as possible until the client goes away. */
+static void serve_stream_rx(int sock)
+{
+  static char buf[65536];
+
+  while( send(sock, buf, sizeof(buf), MSG_NOSIGNAL) > 0 )
+    ;
+}
+
+
+static void serve_session(int lsock)
+{
+  struct bench_hdr hdr;
+  int sock, one = 1;
+
+  if( (sock = accept(lsock, NULL, NULL)) < 0 )
+    return;
+  TRY( setsockopt(sock, SOL_TCP, TCP_NODELAY, &one, sizeof(one)) );
+  if( recv(sock, &hdr, sizeof(hdr), MSG_WAITALL) == sizeof(hdr) ) {
+    switch( ntohl(hdr.session) ) {
+    case SESSION_PINGPONG:
+      serve_pingpong(sock, ntohl(hdr.msg_size));
+      break;
+    case SESSION_STREAM:
+      serve_stream(sock);
+      break;
+    case SESSION_STREAM_RX:
+      serve_stream_rx(sock);
+      break;
+    default:
+      fprintf(stderr, "WARNING: unknown session %u\n", ntohl(hdr.session));
+      break;
+    }
+  }
+  close(sock);
+}
+
+
+/* Serves one client at a time.  The TCP port carries ping-pong and
+ * streaming sessions, the UDP port of the same number echoes datagrams,
+ * and connections to the next port up are accepted and closed
+ * immediately for tcp_connrate. */
+static int do_server(void)
+{
+  static char buf[65536];
+  struct pollfd pfd[3];
+  struct sockaddr_storage from;
+  socklen_t from_len;
+  ssize_t rc;
+  int sock;
+
+  pfd[0].fd = sock_bind(SOCK_STREAM, opts.host, opts.port);
+  pfd[1].fd = sock_bind(SOCK_DGRAM, opts.host, opts.port);
+  pfd[2].fd = sock_bind(SOCK_STREAM, opts.host, opts.port + 1);
+  pfd[0].events = pfd[1].events = pfd[2].events = POLLIN;
+
+  while( 1 ) {
+    TRY( poll(pfd, 3, -1) );
+    if( pfd[0].revents & POLLIN )
+      serve_session(pfd[0].fd);
+    if( pfd[1].revents & POLLIN ) {
+      from_len = sizeof(from);
+      rc = recvfrom(pfd[1].fd, buf, sizeof(buf), MSG_DONTWAIT,
+                    (struct sockaddr*) &from, &from_len);
+      if( rc >= 0 )
+        sendto(pfd[1].fd, buf, rc, 0, (struct sockaddr*) &from, from_len);
+    }
+    if( pfd[2].revents & POLLIN ) {
+      sock = accept(pfd[2].fd, NULL, NULL);
+      if( sock >= 0 )
+        close(sock);
+    }
+  }
+  return 0;
+}
+
+
+/**********************************************************************
+ * Client benchmarks.
+ */
+
+static int session_open(enum bench_session session)
+{
+  int sock = sock_connect(SOCK_STREAM, opts.port);
+  struct bench_hdr hdr = {
+    .session  = htonl(session),
+    .msg_size = htonl(opts.msg_size),
+  };
+  TEST( send(sock, &hdr, sizeof(hdr), 0) == sizeof(hdr) );
+  return sock;
+}
+
+
+static void bench_pingpong(int udp)
+{
+  struct timeval tv = { .tv_sec = 1 };
+  uint64_t* samples;
+  uint64_t t;
+  char* buf;
+  int sock, i;
+  int flags = udp ? 0 : MSG_WAITALL;
+
+  TEST( (buf = calloc(1, opts.msg_size)) != NULL );
+  TEST( (samples = calloc(opts.n_iters, sizeof(samples[0]))) != NULL );
+  if( udp ) {
+    /* A lost datagram fails the run rather than hanging it. */
+    sock = sock_connect(SOCK_DGRAM, opts.port);
+    TRY( setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) );
+  }
+  else {
+    sock = session_open(SESSION_PINGPONG);
+  }
+
+  for( i = -opts.n_warm_ups; i < opts.n_iters; ++i ) {
+    t = now_ns();
+    TEST( send(sock, buf, opts.msg_size, 0) == opts.msg_size );
+    TEST( recv(sock, buf, opts.msg_size, flags) == opts.msg_size );
+    if( i >= 0 )
+      samples[i] = now_ns() - t;
+  }
+  close(sock);
+
+  json_begin(udp ? "udp_pingpong" : "tcp_pingpong");
+  json_percentiles("rtt", samples, opts.n_iters);
+  json_end();
+  free(samples);
+  free(buf);
+}
+
+
+static void bench_tcp_stream(void)
+{
+  uint64_t t_start, t_end, sent = 0, received;
+  char* buf;
+  ssize_t rc;
+  int sock;
+
+  TEST( (buf = calloc(1, opts.msg_size)) != NULL );
+  sock = session_open(SESSION_STREAM);
+
+  t_start = now_ns();
+  t_end = t_start + opts.duration_s * (uint64_t) 1000000000;
+  do {
+    TRY( rc = send(sock, buf, opts.msg_size, 0) );
+    sent += rc;
+  } while( now_ns() < t_end );
+  TRY( shutdown(sock, SHUT_WR) );
+  /* The server replies with its byte count once it has seen everything,
+   * so the elapsed time covers delivery rather than just buffering. */
+  TEST( recv(sock, &received, sizeof(received), MSG_WAITALL) ==
+        sizeof(received) );
+  t_end = now_ns();
+  close(sock);
+  TEST( received == sent );
+
+  json_begin("tcp_stream");
+  json_result("throughput_mbps",
+              received * 8 * 1000.0 / (double) (t_end - t_start));
+  json_end();
+  free(buf);
+}
+
+
+/* Receive-side streaming.  Reports CPU time as well as elapsed, as with
+ * large reads the cost per byte of copying to the app is the point. */
+static void bench_tcp_stream_rx(void)
+{
+  uint64_t t_start, t_end, cpu_start, cpu_end, received = 0;
+  struct timespec ts;
+  char* buf;
+  ssize_t rc;
+  int sock;
+
+  TEST( (buf = malloc(opts.msg_size)) != NULL );
+  /* Fault the buffer in before we start timing. */
+  memset(buf, 0, opts.msg_size);
+  sock = session_open(SESSION_STREAM_RX);
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  cpu_start = ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+  t_start = now_ns();
+  t_end = t_start + opts.duration_s * (uint64_t) 1000000000;
+  do {
+    TRY( rc = recv(sock, buf, opts.msg_size, 0) );
+    TEST( rc > 0 );
+    received += rc;
+  } while( now_ns() < t_end );
+  t_end = now_ns();
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  cpu_end = ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+  close(sock);
+
+  json_begin("tcp_stream_rx");
+  json_result("throughput_mbps",
+              received * 8 * 1000.0 / (double) (t_end - t_start));
+  json_result("per_core_mbps",
+              received * 8 * 1000.0 / (double) (cpu_end - cpu_start));
+  json_end();
+  free(buf);
+}
+
+
+static void bench_tcp_connrate(void)
+{
+  uint64_t* samples;
+  uint64_t t_start, t_end, t;
+  int sock, n, max_n = opts.n_iters;
+
+  TEST( (samples = calloc(max_n, sizeof(samples[0]))) != NULL );
+  t_start = now_ns();
+  t_end = t_start + opts.duration_s * (uint64_t) 1000000000;
+  for( n = 0; n < max_n && (t = now_ns()) < t_end; ++n ) {
+    sock = sock_connect(SOCK_STREAM, opts.port + 1);
+    samples[n] = now_ns() - t;
+    close(sock);
+  }
+  t_end = now_ns();
+
+  json_begin("tcp_connrate");
+  json_result("connections_per_sec", n * 1e9 / (double) (t_end - t_start));
+  json_percentiles("connect", samples, n);
+  json_end();
+  free(samples);
+}
+
+
+struct wakeup_state {
+  int               tx_sock;
+  volatile int      rx_seq;
+};
+
+
+static void* wakeup_sender(void* arg)
+{
+  struct wakeup_state* ws = arg;
+  uint64_t stamp;
+  int i;
+
+  for( i = 0; i < opts.n_warm_ups + opts.n_iters; ++i ) {
+    while( ws->rx_seq != i )
+      ;
+    /* Give the receiver time to go to sleep in epoll_wait(). */
+    if( opts.gap_us )
+      usleep(opts.gap_us);
+    stamp = now_ns();
+    TEST( send(ws->tx_sock, &stamp, sizeof(stamp), 0) == sizeof(stamp) );
+  }
+  return NULL;
+}
+
+
+/* Measures the time from send() to the return of epoll_wait() on a set
+ * holding one active and n_fds idle UDP sockets. */
+static void bench_epoll_wakeup(void)
+{
+  struct wakeup_state ws = { 0 };
+  struct sockaddr_storage ss;
+  socklen_t ss_len = sizeof(ss);
+  struct epoll_event ev = { .events = EPOLLIN };
+  uint64_t* samples;
+  uint64_t stamp;
+  pthread_t tid;
+  int* idle;
+  int epfd, rx_sock, i;
+
+  TEST( (samples = calloc(opts.n_iters, sizeof(samples[0]))) != NULL );
+  TEST( (idle = calloc(opts.n_fds, sizeof(idle[0]))) != NULL );
+  TRY( epfd = epoll_create(1) );
+  for( i = 0; i < opts.n_fds; ++i ) {
+    idle[i] = sock_bind(SOCK_DGRAM, "127.0.0.1", 0);
+    ev.data.fd = idle[i];
+    TRY( epoll_ctl(epfd, EPOLL_CTL_ADD, idle[i], &ev) );
+  }
+  rx_sock = sock_bind(SOCK_DGRAM, "127.0.0.1", 0);
+  ev.data.fd = rx_sock;
+  TRY( epoll_ctl(epfd, EPOLL_CTL_ADD, rx_sock, &ev) );
+  TRY( getsockname(rx_sock, (struct sockaddr*) &ss, &ss_len) );
+  TRY( ws.tx_sock = socket(AF_INET, SOCK_DGRAM, 0) );
+  TRY( connect(ws.tx_sock, (struct sockaddr*) &ss, ss_len) );
+
+  TEST( pthread_create(&tid, NULL, wakeup_sender, &ws) == 0 );
+  for( i = -opts.n_warm_ups; i < opts.n_iters; ++i ) {
+    TEST( epoll_wait(epfd, &ev, 1, -1) == 1 );
+    if( i >= 0 )
+      samples[i] = now_ns();
+    TEST( ev.data.fd == rx_sock );
+    TEST( recv(rx_sock, &stamp, sizeof(stamp), 0) == sizeof(stamp) );
+    if( i >= 0 )
+      samples[i] -= stamp;
+    ++ws.rx_seq;
+  }
+  pthread_join(tid, NULL);
+
+  json_begin("epoll_wakeup");
+  json_percentiles("wakeup", samples, opts.n_iters);
+  json_end();
+
+  close(ws.tx_sock);
+  close(rx_sock);
+  for( i = 0; i < opts.n_fds; ++i )
+    close(idle[i]);
+  close(epfd);
+  free(idle);
+  free(samples);
+}
+
+
+static long resident_bytes(void)
+{
+  long size, resident;
+  FILE* f;
+
+  TEST( (f = fopen("/proc/self/statm", "r")) != NULL );
+  TEST( fscanf(f, "%ld %ld", &size, &resident) == 2 );
+  fclose(f);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+
+/* Resident memory added by creating n_fds sockets.  TCP sockets are made
+ * listening and UDP sockets bound so that Onload accelerates them. */
+static void bench_sock_footprint(void)
+{
+  int socktype = opts.udp ? SOCK_DGRAM : SOCK_STREAM;
+  long before, after;
+  int* socks;
+  int i;
+
+  TEST( (socks = calloc(opts.n_fds, sizeof(socks[0]))) != NULL );
+  /* Create and close one socket first so that the cost of creating the
+   * stack is not charged to the sockets. */
+  close(sock_bind(socktype, "127.0.0.1", 0));
+  before = resident_bytes();
+  for( i = 0; i < opts.n_fds; ++i )
+    socks[i] = sock_bind(socktype, "127.0.0.1", 0);
+  after = resident_bytes();
+  for( i = 0; i < opts.n_fds; ++i )
+    close(socks[i]);
+
+  json_begin(opts.udp ? "udp_sock_footprint" : "tcp_sock_footprint");
+  json_result("rss_per_socket_bytes",
+              (double) (after - before) / opts.n_fds);
+  json_end();
+  free(socks);
+}
+
+
+/* Mean cost of [n] send()+recv() pairs from [tx] to [rx]; [raw] bypasses
+ * the libc entry points, and so Onload's interception of them. */
+static double intercept_pair_ns(int tx, int rx, int n, int raw)
+{
+  char buf[64];
+  uint64_t start;
+  int i;
+
+  memset(buf, 0, sizeof(buf));
+  start = now_ns();
+  for( i = 0; i < n; ++i ) {
+    if( raw ) {
+      TEST( syscall(SYS_sendto, tx, buf, opts.msg_size, 0, NULL, 0) ==
+            opts.msg_size );
+      TEST( syscall(SYS_recvfrom, rx, buf, sizeof(buf), 0, NULL, NULL) ==
+            opts.msg_size );
+    }
+    else {
+      TEST( send(tx, buf, opts.msg_size, 0) == opts.msg_size );
+      TEST( recv(rx, buf, sizeof(buf), 0) == opts.msg_size );
+    }
+  }
+  return n ? (double) (now_ns() - start) / n : 0;
+}
+
+
+/* Overhead that interception adds to send() and recv() on sockets which
+ * Onload does not accelerate, so that both variants make the same system
+ * calls.  The sockets are moved to fds n_fds and n_fds+1 so that lookups
+ * are made far along the fd table. */
+static void bench_intercept(void)
+{
+  int sv[2], tx, rx;
+  double libc_ns, raw_ns;
+
+  TEST( opts.msg_size <= 64 );
+  TRY( socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) );
+  TRY( tx = dup2(sv[0], opts.n_fds) );
+  TRY( rx = dup2(sv[1], opts.n_fds + 1) );
+  close(sv[0]);
+  close(sv[1]);
+
+  intercept_pair_ns(tx, rx, opts.n_warm_ups, 0);
+  intercept_pair_ns(tx, rx, opts.n_warm_ups, 1);
+  libc_ns = intercept_pair_ns(tx, rx, opts.n_iters, 0);
+  raw_ns = intercept_pair_ns(tx, rx, opts.n_iters, 1);
+
+  json_begin("intercept");
+  json_result("libc_pair_ns", libc_ns);
+  json_result("syscall_pair_ns", raw_ns);
+  json_result("overhead_pair_ns", libc_ns - raw_ns);
+  json_end();
+
+  close(tx);
+  close(rx);
+}
+
+
+/**********************************************************************
+ * main()
+ */
+
+static void usage_msg(FILE* f)
+{
+  fprintf(f, "usage:\n");
+  fprintf(f, "  onload_bench [OPTIONS] server [BIND_HOST]\n");
+  fprintf(f, "  onload_bench [OPTIONS] tcp_pingpong|udp_pingpong|"
+          "tcp_stream|tcp_stream_rx|tcp_connrate HOST\n");
+  fprintf(f, "  onload_bench [OPTIONS] epoll_wakeup|sock_footprint|"
+          "intercept\n");
+  fprintf(f, "\n");
+  fprintf(f, "options:\n");
+  fprintf(f, "  -p PORT        - server port; tcp_connrate uses PORT+1\n");
+  fprintf(f, "  -s MSG_SIZE    - message size (bytes)\n");
+  fprintf(f, "  -i ITERATIONS  - num iterations\n");
+  fprintf(f, "  -w WARMUPS     - num warm-up iterations\n");
+  fprintf(f, "  -d SECONDS     - duration of stream and connrate tests\n");
+  fprintf(f, "  -n FDS         - idle fds for epoll_wakeup, sockets for "
+          "sock_footprint,\n");
+  fprintf(f, "                   first fd used by intercept\n");
+  fprintf(f, "  -g GAP_US      - pause before each epoll_wakeup send\n");
+  fprintf(f, "  -u             - sock_footprint: use UDP sockets\n");
+  fprintf(f, "  -t TAG         - label recorded in the results\n");
+}
+
+
+static __attribute__ ((__noreturn__)) void usage_err(void)
+{
+  usage_msg(stderr);
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  const char* bench;
+  int c;
+
+  while( (c = getopt(argc, argv, "p:s:i:w:d:n:g:ut:h")) != -1 )
+    switch( c ) {
+    case 'p':
+      opts.port = atoi(optarg);
+      break;
+    case 's':
+      opts.msg_size = atoi(optarg);
+      break;
+    case 'i':
+      opts.n_iters = atoi(optarg);
+      break;
+    case 'w':
+      opts.n_warm_ups = atoi(optarg);
+      break;
+    case 'd':
+      opts.duration_s = atoi(optarg);
+      break;
+    case 'n':
+      opts.n_fds = atoi(optarg);
+      break;
+    case 'g':
+      opts.gap_us = atoi(optarg);
+      break;
+    case 'u':
+      opts.udp = 1;
+      break;
+    case 't':
+      opts.tag = optarg;
+      break;
+    case 'h':
+      usage_msg(stdout);
+      exit(0);
+    default:
+      usage_err();
+    }
+
+  argc -= optind;
+  argv += optind;
+  if( argc < 1 || argc > 2 )
+    usage_err();
+  bench = argv[0];
+  opts.host = argc > 1 ? argv[1] : NULL;
+  if( opts.msg_size < 1 || opts.n_iters < 1 || opts.n_warm_ups < 0 ||
+      opts.n_fds < 1 )
+    usage_err();
+
+  if( ! strcmp(bench, "server") )
+    return do_server();
+  if( ! strcmp(bench, "epoll_wakeup") )
+    bench_epoll_wakeup();
+  else if( ! strcmp(bench, "sock_footprint") )
+    bench_sock_footprint();
+  else if( ! strcmp(bench, "intercept") )
+    bench_intercept();
+  else if( opts.host == NULL )
+    usage_err();
+  else if( ! strcmp(bench, "tcp_pingpong") )
+    bench_pingpong(0);
+  else if( ! strcmp(bench, "udp_pingpong") )
+    bench_pingpong(1);
+  else if( ! strcmp(bench, "tcp_stream") )
+    bench_tcp_stream();
+  else if( ! strcmp(bench, "tcp_stream_rx") )
+    bench_tcp_stream_rx();
+  else if( ! strcmp(bench, "tcp_connrate") )
+    bench_tcp_connrate();
+  else
+    usage_err();
+  return 0;
+}
@@ -82,7 +82,10 @@ struct vi {
   /* registered memory for DMA */
   ef_memreg          memreg;
 
-  /* number of TX waiting to be pushed (in '-x' mode) */
+  /* packets waiting to be sent as one burst */
+#define TX_BATCH_SIZE      64
+  ef_iovec           tx_iov[TX_BATCH_SIZE];
+  ef_request_id      tx_ids[TX_BATCH_SIZE];
   unsigned int       tx_outstanding;
 
   /* statistics */
@@ -114,6 +117,15 @@ static inline int addr_offset_from_id(int pkt_buf_i)
 }
 
 
+/* Free buffer into free pool in LIFO order to minimize cache footprint. */
+static inline void pkt_buf_free(struct pkt_buf* pkt_buf)
+{
+  pkt_buf->next = pbs.free_pool;
+  pbs.free_pool = pkt_buf;
+  ++pbs.free_pool_n;
+}
+
+
 /* Try to refill the RXQ on the given VI with at most
  * REFILL_BATCH_SIZE packets if it has enough space and we have
  * enough free buffers. */
@@ -121,54 +133,64 @@ static void vi_refill_rx_ring(int vi_i)
 {
   ef_vi* vi = &vis[vi_i].vi;
 #define REFILL_BATCH_SIZE  64
-  struct pkt_buf* pkt_buf;
-  int i;
+  struct pkt_buf* pkt_bufs[REFILL_BATCH_SIZE];
+  ef_addr addrs[REFILL_BATCH_SIZE];
+  ef_request_id ids[REFILL_BATCH_SIZE];
+  int i, n;
 
   if( ef_vi_receive_space(vi) < REFILL_BATCH_SIZE ||
       pbs.free_pool_n < REFILL_BATCH_SIZE )
     return;
 
   for( i = 0; i < REFILL_BATCH_SIZE; ++i ) {
-    pkt_buf = pbs.free_pool;
+    pkt_bufs[i] = pbs.free_pool;
     pbs.free_pool = pbs.free_pool->next;
     --pbs.free_pool_n;
-    ef_vi_receive_init(vi, pkt_buf->rx_ef_addr[vi_i], pkt_buf->id);
+    addrs[i] = pkt_bufs[i]->rx_ef_addr[vi_i];
+    ids[i] = pkt_bufs[i]->id;
   }
-  ef_vi_receive_push(vi);
+
+  /* Posts and pushes the whole batch in one go. */
+  n = ef_vi_receive_post_burst(vi, addrs, ids, REFILL_BATCH_SIZE);
+  TEST(n >= 0);
+  for( i = REFILL_BATCH_SIZE; i-- > n; )
+    pkt_buf_free(pkt_bufs[i]);
 }
 
 
-/* Free buffer into free pool in LIFO order to minimize cache footprint. */
-static inline void pkt_buf_free(struct pkt_buf* pkt_buf)
+/* Send the packets queued on a VI as a single burst. */
+static void vi_flush_tx(struct vi* vi)
 {
-  pkt_buf->next = pbs.free_pool;
-  pbs.free_pool = pkt_buf;
-  ++pbs.free_pool_n;
+  unsigned i;
+  int n;
+
+  n = ef_vi_transmitv_burst(&vi->vi, vi->tx_iov, vi->tx_ids,
+                            vi->tx_outstanding);
+  TEST(n >= 0);
+  /* TXQ is full.  A real app might consider implementing an overflow
+   * queue in software.  We simply choose not to send.
+   */
+  for( i = n; i < vi->tx_outstanding; ++i )
+    pkt_buf_free(pkt_buf_from_id(vi->tx_ids[i]));
+  vi->tx_outstanding = 0;
 }
 
 
 /* Handle an RX event on a VI.  We forward the packet on the other VI. */
 static void handle_rx(int rx_vi_i, int pkt_buf_i, int len)
 {
-  int rc;
   int tx_vi_i = 2 - 1 - rx_vi_i;
   struct vi* rx_vi = &vis[rx_vi_i];
   struct vi* tx_vi = &vis[tx_vi_i];
   struct pkt_buf* pkt_buf = pkt_buf_from_id(pkt_buf_i);
+  unsigned i = tx_vi->tx_outstanding;
 
   ++rx_vi->n_pkts;
-  rc = ef_vi_transmit_init(&tx_vi->vi, pkt_buf->tx_ef_addr[tx_vi_i], len,
-                           pkt_buf->id);
-  if( rc == 0 ) {
-    ++tx_vi->tx_outstanding;
-  }
-  else {
-    assert(rc == -EAGAIN);
-    /* TXQ is full.  A real app might consider implementing an overflow
-     * queue in software.  We simply choose not to send.
-     */
-    pkt_buf_free(pkt_buf);
-  }
+  tx_vi->tx_iov[i].iov_base = pkt_buf->tx_ef_addr[tx_vi_i];
+  tx_vi->tx_iov[i].iov_len = len;
+  tx_vi->tx_ids[i] = pkt_buf->id;
+  if( ++tx_vi->tx_outstanding == TX_BATCH_SIZE )
+    vi_flush_tx(tx_vi);
 }
 
 
@@ -207,10 +229,8 @@ static void main_loop(void)
     for( i = 0; i < 2; ++i ) {
       ef_vi* vi = &vis[i].vi;
 
-      if( vis[i].tx_outstanding ) {
-        ef_vi_transmit_push(vi);
-        vis[i].tx_outstanding = 0;
-      }
+      if( vis[i].tx_outstanding )
+        vi_flush_tx(&vis[i]);
 
       ef_event evs[EF_VI_EVENT_POLL_MIN_EVS];
       int n_ev = ef_eventq_poll(vi, evs, sizeof(evs) / sizeof(evs[0]));
@@ -283,7 +303,9 @@ static void* monitor_fn(void* dummy)
     prev_pkts[i] = vis[i].n_pkts;
   gettimeofday(&start, NULL);
 
-  printf("  vi0-rx\t  vi1-rx\n");
+  /* Everything runs on the one thread, so the total is also the
+   * forwarding rate per core. */
+  printf("  vi0-rx\t  vi1-rx\t  Mpps/core\n");
   while( 1 ) {
     sleep(1);
     for( i = 0; i < 2; ++i )
@@ -294,7 +316,8 @@ static void* monitor_fn(void* dummy)
 
     for( i = 0; i < 2; ++i )
       pkt_rates[i] = (int64_t)(now_pkts[i] - prev_pkts[i]) * 1000 / ms;
-    printf("%8d\t%8d\n", pkt_rates[0], pkt_rates[1]);
+    printf("%8d\t%8d\t%8.3f\n", pkt_rates[0], pkt_rates[1],
+           (pkt_rates[0] + pkt_rates[1]) / 1e6);
     fflush(stdout);
     for( i = 0; i < 2; ++i )
       prev_pkts[i] = now_pkts[i];
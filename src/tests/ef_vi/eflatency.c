@@ -45,6 +45,7 @@ static int              cfg_payload_step = 1;
 static int              cfg_ctpio_no_poison;
 static unsigned         cfg_ctpio_thresh = 64;
 static const char*      cfg_save_file = NULL;
+static unsigned         cfg_rate = 0;
 enum mode {
   MODE_DMA = 1,
   MODE_PIO = 2,
@@ -77,6 +78,7 @@ struct eflatency_vi {
   ef_vi     vi;
   int       n_ev;
   int       i;
+  unsigned  n_rx;
   ef_event  evs[EF_VI_EVENT_POLL_MIN_EVS];
   ef_pd     pd;
   ef_memreg memreg;
@@ -150,12 +152,21 @@ static int cmp_u64(const void* ap, const void* bp)
 static void output_results(struct timeval start, struct timeval end)
 {
   unsigned freq = 0;
-  double div;
+  double div, mean_usec;
   int usec = (end.tv_sec - start.tv_sec) * 1000000;
   usec += end.tv_usec - start.tv_usec;
 
   ci_get_cpu_khz(&freq);
   div = freq / 1e3;
+  mean_usec = (double) usec / cfg_iter;
+  if( cfg_rate ) {
+    /* Requests overlap, so elapsed time says nothing about latency. */
+    double sum = 0;
+    int i;
+    for( i = 0 ; i < cfg_iter; ++i )
+      sum += timings[i];
+    mean_usec = sum / cfg_iter / div;
+  }
   if( cfg_save_file ) {
     int i;
     char* subst = strstr(cfg_save_file, "$s");
@@ -183,13 +194,13 @@ static void output_results(struct timeval start, struct timeval end)
   qsort(timings, cfg_iter, sizeof(timings[0]), cmp_u64);
   printf("%d\t%0.3lf\t%0.3lf\t%0.3lf\t%0.3lf\t%0.3lf\t%0.3lf\n",
          cfg_payload_len,
-         (double) usec / cfg_iter,
+         mean_usec,
          timings[0] / div,
          timings[cfg_iter / 2] / div,
          timings[cfg_iter - cfg_iter / 20] / div,
          timings[cfg_iter - cfg_iter / 100] / div,
          timings[cfg_iter - 1] / div);
-  last_mean_latency_usec = (double) usec / cfg_iter;
+  last_mean_latency_usec = mean_usec;
 }
 
 /**********************************************************************/
@@ -206,6 +217,62 @@ typedef struct {
 static void
 generic_desc_check(struct eflatency_vi* vi, int wait);
 
+/* Open loop: send at cfg_rate regardless of whether replies have arrived,
+ * and measure each reply from the time its request was due to be sent
+ * rather than when it actually was.  Otherwise a stall delays the sends
+ * behind it, and the time they spend queued is never counted.
+ */
+static void
+open_loop_ping(struct eflatency_vi* rx_vi, struct eflatency_vi* tx_vi,
+               void (*tx_send)(struct eflatency_vi*))
+{
+  struct timeval start, end;
+  unsigned freq = 0;
+  uint64_t t0, interval;
+  int i, n_tx = 0, n_rx = 0;
+  unsigned rx_base;
+  int do_rx_post = ( rx_vi->vi.nic_type.arch != EF_VI_ARCH_EFCT );
+
+  for( i = 0; i < cfg_warmups; ++i ) {
+    tx_send(tx_vi);
+    if( do_rx_post )
+      rx_post(&rx_vi->vi);
+    generic_desc_check(rx_vi, 1);
+    generic_desc_check(tx_vi, 0);
+  }
+
+  ci_get_cpu_khz(&freq);
+  interval = (uint64_t) freq * 1000 / cfg_rate;
+  gettimeofday(&start, NULL);
+  rx_base = rx_vi->n_rx;
+  t0 = ci_frc64_get();
+
+  while( n_rx < cfg_iter ) {
+    uint64_t now = ci_frc64_get();
+    if( n_tx < cfg_iter && now - t0 >= n_tx * interval ) {
+      tx_send(tx_vi);
+      ++n_tx;
+    }
+    /* Replies come back in order, so the next one answers request n_rx.
+     * Count them with rx_vi->n_rx as the CTPIO send path can consume them
+     * too while waiting for TX space.
+     */
+    generic_desc_check(rx_vi, 0);
+    while( n_rx < rx_vi->n_rx - rx_base ) {
+      timings[n_rx] = ci_frc64_get() - (t0 + n_rx * interval);
+      ++n_rx;
+      if( do_rx_post )
+        rx_post(&rx_vi->vi);
+    }
+    if( tx_vi != rx_vi )
+      generic_desc_check(tx_vi, 0);
+  }
+
+  gettimeofday(&end, NULL);
+  output_results(start, end);
+}
+
+
 static void
 generic_ping(struct eflatency_vi* rx_vi, struct eflatency_vi* tx_vi,
              void (*rx_wait)(struct eflatency_vi*),
@@ -215,6 +282,11 @@ generic_ping(struct eflatency_vi* rx_vi, struct eflatency_vi* tx_vi,
   int i;
   int do_rx_post = ( rx_vi->vi.nic_type.arch != EF_VI_ARCH_EFCT );
 
+  if( cfg_rate ) {
+    open_loop_ping(rx_vi, tx_vi, tx_send);
+    return;
+  }
+
   for( i = 0; i < cfg_warmups; ++i ) {
     tx_send(tx_vi);
     if( do_rx_post )
@@ -473,10 +545,12 @@ generic_desc_check(struct eflatency_vi* vi, int wait)
       switch( EF_EVENT_TYPE(evs[i]) ) {
       case EF_EVENT_TYPE_RX:
         vi->i = ++i;
+        ++vi->n_rx;
         return;
       case EF_EVENT_TYPE_RX_REF:
         handle_rx_ref(&vi->vi, evs[i].rx_ref.pkt_id, evs[i].rx_ref.len);
         vi->i = ++i;
+        ++vi->n_rx;
         return;
       case EF_EVENT_TYPE_TX:
         ef_vi_transmit_unbundle(&vi->vi, &(evs[i]), tx_ids);
@@ -489,12 +563,14 @@ generic_desc_check(struct eflatency_vi* vi, int wait)
         n_rx = ef_vi_receive_unbundle(&vi->vi, &(evs[i]), rx_ids);
         TEST(n_rx == 1);
         vi->i = ++i;
+        ++vi->n_rx;
         return;
       case EF_EVENT_TYPE_RX_MULTI_PKTS:
         n_rx = evs[i].rx_multi_pkts.n_pkts;
         TEST(n_rx == 1);
         ef_vi_rxq_next_desc_id(&vi->vi);
         vi->i = ++i;
+        ++vi->n_rx;
         return;
       case EF_EVENT_TYPE_RX_REF_DISCARD:
         handle_rx_ref(&vi->vi, evs[i].rx_ref_discard.pkt_id,
@@ -699,6 +775,7 @@ static CI_NORETURN usage(const char* fmt, ...)
   fprintf(stderr, "                        [pio], [a]lternatives, [d]ma\n");
   fprintf(stderr, "  -t <modes>          - set TX_PUSH: [a]lways, [d]isable\n");
   fprintf(stderr, "  -o <filename>       - save raw timings to file\n");
+  fprintf(stderr, "  -r <rate>           - ping: send <rate> msgs/sec open loop\n");
   fprintf(stderr, "\n");
   exit(1);
 }
@@ -736,7 +813,7 @@ int main(int argc, char* argv[])
     p = (unsigned int)__v;                                   \
   } while( 0 );
 
-  while( (c = getopt (argc, argv, "n:s:w:c:pm:t:o:")) != -1 )
+  while( (c = getopt (argc, argv, "n:s:w:c:pm:t:o:r:")) != -1 )
     switch( c ) {
     case 'n':
       OPT_INT(optarg, cfg_iter);
@@ -767,6 +844,9 @@ int main(int argc, char* argv[])
     case 'o':
       cfg_save_file = optarg;
       break;
+    case 'r':
+      OPT_UINT(optarg, cfg_rate);
+      break;
     case 'm':
       cfg_mode = 0;
       for( i = 0; i < strlen(optarg); ++i ) {
@@ -821,6 +901,10 @@ int main(int argc, char* argv[])
     usage("Max payload size not reachable from min");
   }
 
+  /* Alternatives can't be refilled while the previous send is in flight. */
+  if( cfg_rate )
+    cfg_mode &= ~MODE_ALT;
+
   if( strcmp(argv[0], "ping") == 0 )
     ping = true;
   else if( strcmp(argv[0], "pong") != 0 )
@@ -887,6 +971,8 @@ int main(int argc, char* argv[])
          cfg_payload_step);
   printf("# iterations: %d\n", cfg_iter);
   printf("# warmups: %d\n", cfg_warmups);
+  if( cfg_rate )
+    printf("# open loop rate: %u msgs/sec\n", cfg_rate);
   printf("# frame len: %d\n", tx_frame_len);
   printf("# mode: %s\n", t->name);
   if( ping )
@@ -910,7 +996,8 @@ int main(int argc, char* argv[])
     tx_frame_len = cfg_payload_len + HEADER_SIZE;
   }
   if( ping && iters_run == 1 )
-    printf("mean round-trip time: %.3lf usec\n", last_mean_latency_usec);
+    printf("mean %s time: %.3lf usec\n",
+           cfg_rate ? "response" : "round-trip", last_mean_latency_usec);
 
   return 0;
 }
@@ -0,0 +1,359 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* efreplay
+ *
+ * Sample app that replays a pcap file on an interface, keeping the gaps
+ * between packets that were recorded in the capture.
+ *
+ * The file is mapped and registered with the NIC as a whole, so packets
+ * are sent straight from the capture without copying.  Each packet is
+ * sent with CTPIO where the NIC supports it, falling back to DMA.
+ *
+ * With -t, the NIC timestamps each transmit and the achieved gaps are
+ * compared with those in the capture.
+ */
+
+#include "utils.h"
+
+#include <etherfabric/vi.h>
+#include <etherfabric/pd.h>
+#include <etherfabric/memreg.h>
+#include <etherfabric/capabilities.h>
+#include <ci/tools.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <time.h>
+
+
+#define PCAP_MAGIC_USEC      0xa1b2c3d4
+#define PCAP_MAGIC_NSEC      0xa1b23c4d
+#define PCAP_LINKTYPE_ETHER  1
+
+struct pcap_file_hdr {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+struct pcap_rec_hdr {
+  uint32_t ts_sec;
+  uint32_t ts_frac;
+  uint32_t incl_len;
+  uint32_t orig_len;
+};
+
+/* Enough for a 64KiB frame split at every NIC page boundary. */
+#define MAX_DMA_IOV          17
+/* Transmits in flight are tracked by DMA id modulo this. */
+#define MAX_INFLIGHT         4096
+
+
+static int cfg_ctpio = 1;
+static int cfg_timestamps;
+static int cfg_verbose;
+static unsigned cfg_ctpio_thresh = 64;
+
+static ef_vi vi;
+static ef_driver_handle dh;
+static ef_memreg mr;
+static char* file_base;
+static int ns_per_frac;
+
+static int n_sent;
+static int n_completed;
+static uint64_t due_ns[MAX_INFLIGHT];
+
+/* Gaps achieved on the wire, as measured by TX timestamps. */
+static struct {
+  uint64_t prev_due;
+  uint64_t prev_wire;
+  uint64_t n;
+  double   sum_abs_err;
+  int64_t  max_abs_err;
+} gap;
+
+/* Time by which sends missed their due time, as seen by software. */
+static int64_t max_late_ns;
+static double sum_late_ns;
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static void record_wire_time(ef_request_id id, const ef_event* ev)
+{
+  uint64_t wire = EF_EVENT_TX_WITH_TIMESTAMP_SEC(*ev) * 1000000000ull +
+                  EF_EVENT_TX_WITH_TIMESTAMP_NSEC(*ev);
+  uint64_t due = due_ns[id % MAX_INFLIGHT];
+
+  if( n_completed != 0 ) {
+    int64_t err = (int64_t) ((wire - gap.prev_wire) -
+                             (due - gap.prev_due));
+    if( err < 0 )
+      err = -err;
+    gap.sum_abs_err += err;
+    if( err > gap.max_abs_err )
+      gap.max_abs_err = err;
+    ++gap.n;
+    LOGV("%d: gap error %"PRId64" ns\n", (int) id, err);
+  }
+  gap.prev_due = due;
+  gap.prev_wire = wire;
+}
+
+
+static void poll_evq(void)
+{
+  ef_event evs[EF_VI_EVENT_POLL_MIN_EVS];
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  int i, n_ev;
+
+  n_ev = ef_eventq_poll(&vi, evs, sizeof(evs) / sizeof(evs[0]));
+  for( i = 0; i < n_ev; ++i )
+    switch( EF_EVENT_TYPE(evs[i]) ) {
+    case EF_EVENT_TYPE_TX:
+      n_completed += ef_vi_transmit_unbundle(&vi, &evs[i], ids);
+      break;
+    case EF_EVENT_TYPE_TX_WITH_TIMESTAMP:
+      /* One of these completes exactly one transmit. */
+      record_wire_time(EF_EVENT_TX_WITH_TIMESTAMP_RQ_ID(evs[i]), &evs[i]);
+      ++n_completed;
+      break;
+    default:
+      fprintf(stderr, "ERROR: unexpected event "EF_EVENT_FMT"\n",
+              EF_EVENT_PRI_ARG(evs[i]));
+      TEST(0);
+      break;
+    }
+}
+
+
+/* Describe a packet in the mapped file to the NIC.  A registered region is
+ * only contiguous within each NIC page, so split at page boundaries.
+ */
+static int pkt_dma_iov(size_t off, int len, ef_iovec* iov)
+{
+  int n = 0;
+
+  while( len > 0 ) {
+    int seg = EF_VI_NIC_PAGE_SIZE - (off & (EF_VI_NIC_PAGE_SIZE - 1));
+    if( seg > len )
+      seg = len;
+    TEST(n < MAX_DMA_IOV);
+    iov[n].iov_base = ef_memreg_dma_addr(&mr, off);
+    iov[n].iov_len = seg;
+    ++n;
+    off += seg;
+    len -= seg;
+  }
+  return n;
+}
+
+
+static void send_pkt(size_t off, int len, uint64_t due)
+{
+  ef_iovec dma_iov[MAX_DMA_IOV];
+  int n_iov = pkt_dma_iov(off, len, dma_iov);
+  uint64_t now;
+  int64_t late;
+  int rc;
+
+  /* Don't let a full TXQ hold up a send at its due time. */
+  while( n_sent - n_completed >= ef_vi_transmit_capacity(&vi) )
+    poll_evq();
+
+  due_ns[n_sent % MAX_INFLIGHT] = due;
+  while( (now = now_ns()) < due )
+    ;
+
+  if( cfg_ctpio ) {
+    struct iovec iov = { file_base + off, len };
+    ef_vi_transmitv_ctpio(&vi, len, &iov, 1, cfg_ctpio_thresh);
+    while( (rc = ef_vi_transmitv_ctpio_fallback(&vi, dma_iov, n_iov,
+                                                n_sent)) == -EAGAIN )
+      poll_evq();
+    TRY(rc);
+  }
+  else {
+    while( (rc = ef_vi_transmitv(&vi, dma_iov, n_iov, n_sent)) == -EAGAIN )
+      poll_evq();
+    TRY(rc);
+  }
+  ++n_sent;
+
+  late = now - due;
+  sum_late_ns += late;
+  if( late > max_late_ns )
+    max_late_ns = late;
+}
+
+
+static CI_NORETURN usage(void)
+{
+  fprintf(stderr, "\nusage:\n");
+  fprintf(stderr, "  efreplay [options] <interface> <pcap-file>\n");
+  fprintf(stderr, "\noptions:\n");
+  fprintf(stderr, "  -d                  - use DMA rather than CTPIO\n");
+  fprintf(stderr, "  -c <cut-through>    - CTPIO cut-through threshold\n");
+  fprintf(stderr, "  -t                  - check gaps with TX timestamps\n");
+  fprintf(stderr, "  -v                  - verbose\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "pcapng files must first be converted, for example with\n"
+          "'editcap -F pcap in.pcapng out.pcap'.\n");
+  exit(1);
+}
+
+
+static void map_file(const char* path, size_t* len_out)
+{
+  struct stat st;
+  size_t map_len;
+  int fd;
+
+  TRY(fd = open(path, O_RDONLY));
+  TRY(fstat(fd, &st));
+  TEST(st.st_size >= (off_t) sizeof(struct pcap_file_hdr));
+  /* Registration is in whole pages, so map past the end of the file. */
+  map_len = CI_ROUND_UP((size_t) st.st_size, CI_PAGE_SIZE);
+  file_base = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  TEST(file_base != MAP_FAILED);
+  close(fd);
+  *len_out = st.st_size;
+}
+
+
+static void check_file_hdr(const struct pcap_file_hdr* fh)
+{
+  if( fh->magic == PCAP_MAGIC_USEC ) {
+    ns_per_frac = 1000;
+  }
+  else if( fh->magic == PCAP_MAGIC_NSEC ) {
+    ns_per_frac = 1;
+  }
+  else {
+    fprintf(stderr, "ERROR: not a pcap file in host byte order\n");
+    usage();
+  }
+  if( fh->linktype != PCAP_LINKTYPE_ETHER ) {
+    fprintf(stderr, "ERROR: link type %u is not Ethernet\n", fh->linktype);
+    exit(1);
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  ef_pd pd;
+  enum ef_vi_flags vi_flags = EF_VI_FLAGS_DEFAULT;
+  size_t file_len, off;
+  uint64_t start_ns = 0, first_pkt_ns = 0;
+  int ifindex, c, n_skipped = 0;
+
+  while( (c = getopt(argc, argv, "dc:tv")) != -1 )
+    switch( c ) {
+    case 'd':
+      cfg_ctpio = 0;
+      break;
+    case 'c':
+      cfg_ctpio_thresh = atoi(optarg);
+      break;
+    case 't':
+      cfg_timestamps = 1;
+      break;
+    case 'v':
+      cfg_verbose = 1;
+      break;
+    case '?':
+      usage();
+    default:
+      TEST(0);
+    }
+
+  argc -= optind;
+  argv += optind;
+  if( argc != 2 )
+    usage();
+  if( ! parse_interface(argv[0], &ifindex) ) {
+    fprintf(stderr, "ERROR: unable to parse interface '%s'\n", argv[0]);
+    usage();
+  }
+
+  map_file(argv[1], &file_len);
+  check_file_hdr((const struct pcap_file_hdr*) file_base);
+
+  TRY(ef_driver_open(&dh));
+  TRY(ef_pd_alloc(&pd, dh, ifindex, EF_PD_DEFAULT));
+  if( cfg_timestamps )
+    vi_flags |= EF_VI_TX_TIMESTAMPS;
+  if( cfg_ctpio ) {
+    enum ef_vi_flags tx_flags = 0;
+    TRY(ef_vi_capabilities_tx_flags(dh, ifindex, &tx_flags));
+    if( ! (tx_flags & EF_VI_TX_CTPIO) ||
+        ef_vi_alloc_from_pd(&vi, dh, &pd, dh, -1, 0, -1, NULL, -1,
+                            vi_flags | tx_flags) != 0 ) {
+      fprintf(stderr, "CTPIO not available, using DMA\n");
+      cfg_ctpio = 0;
+    }
+  }
+  if( ! cfg_ctpio )
+    TRY(ef_vi_alloc_from_pd(&vi, dh, &pd, dh, -1, 0, -1, NULL, -1,
+                            vi_flags));
+  TEST(ef_vi_transmit_capacity(&vi) <= MAX_INFLIGHT);
+  TRY(ef_memreg_alloc(&mr, dh, &pd, dh, file_base,
+                      CI_ROUND_UP(file_len, CI_PAGE_SIZE)));
+
+  printf("# mode: %s\n", cfg_ctpio ? "CTPIO" : "DMA");
+  printf("# tx timestamps: %s\n", cfg_timestamps ? "yes" : "no");
+
+  for( off = sizeof(struct pcap_file_hdr);
+       off + sizeof(struct pcap_rec_hdr) <= file_len; ) {
+    const struct pcap_rec_hdr* rh = (void*) (file_base + off);
+    uint64_t pkt_ns = rh->ts_sec * 1000000000ull +
+                      (uint64_t) rh->ts_frac * ns_per_frac;
+    size_t pkt_off = off + sizeof(*rh);
+
+    if( pkt_off + rh->incl_len > file_len ) {
+      fprintf(stderr, "WARNING: capture ends with a partial record\n");
+      break;
+    }
+    off = pkt_off + rh->incl_len;
+    /* Frames cut short by the capture's snaplen can't be replayed. */
+    if( rh->incl_len < rh->orig_len || rh->incl_len == 0 ) {
+      ++n_skipped;
+      continue;
+    }
+
+    if( start_ns == 0 ) {
+      first_pkt_ns = pkt_ns;
+      start_ns = now_ns();
+    }
+    send_pkt(pkt_off, rh->incl_len, start_ns + (pkt_ns - first_pkt_ns));
+  }
+
+  while( n_completed < n_sent )
+    poll_evq();
+
+  printf("sent: %d\n", n_sent);
+  printf("skipped: %d\n", n_skipped);
+  if( n_sent ) {
+    printf("send late mean: %.0lf ns\n", sum_late_ns / n_sent);
+    printf("send late max: %"PRId64" ns\n", max_late_ns);
+  }
+  if( gap.n ) {
+    printf("wire gap error mean: %.0lf ns\n", gap.sum_abs_err / gap.n);
+    printf("wire gap error max: %"PRId64" ns\n", gap.max_abs_err);
+  }
+  return 0;
+}
@@ -24,6 +24,9 @@
  *    this returns true the read was valid and the action can be finalised
  *    (e.g. by sending a response). If this returns false, the consumer can
  *    retry the read to get new data.
+ *
+ * etherfabric/shm_ring.h provides a supported version of this ring with
+ * configurable depth, several rings per region and tracking of reader lag.
  */
 #include <etherfabric/ef_vi.h>
 #include <ci/tools.h>
@@ -52,10 +52,34 @@ static int                cfg_disable_tx_push;
 static int                cfg_use_vf;
 static int                cfg_max_batch = 8192;
 static int                cfg_vlan = -1;
+static int                cfg_batch_completions;
+static int                cfg_burst;
 static int                n_sent;
 static int                n_pushed;
 static int                ifindex;
 
+/* Completes only the last TX event in each poll, which covers all the
+ * transmits reported by those before it. */
+static void handle_completions_batched(void)
+{
+  ef_event      evs[EVENT_BATCH_SIZE];
+  const ef_event* last_tx = NULL;
+  int           n_ev, i;
+
+  n_ev = ef_eventq_poll(&vi, evs, sizeof(evs) / sizeof(evs[0]));
+  for( i = 0; i < n_ev; ++i ) {
+    switch( EF_EVENT_TYPE(evs[i]) ) {
+    case EF_EVENT_TYPE_TX:
+      last_tx = &evs[i];
+      break;
+    default:
+      TEST(!"Unexpected event received");
+    }
+  }
+  if( last_tx != NULL )
+    n_sent += ef_vi_transmit_complete(&vi, last_tx);
+}
+
 static void handle_completions(void)
 {
   ef_request_id ids[EF_VI_TRANSMIT_BATCH];
@@ -86,6 +110,19 @@ int send_more_packets(int desired, ef_vi* vi, ef_addr dma_buf_addr) {
   int i;
   int to_send = cfg_max_batch < desired ? cfg_max_batch : desired;
 
+  if( cfg_burst ) {
+    ef_iovec iov[EF_VI_TRANSMIT_BATCH];
+    ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+    int n = to_send < EF_VI_TRANSMIT_BATCH ? to_send : EF_VI_TRANSMIT_BATCH;
+    for( i = 0; i < n; ++i ) {
+      iov[i].iov_base = dma_buf_addr;
+      iov[i].iov_len = tx_frame_len;
+      ids[i] = n_pushed + i;
+    }
+    TRY(i = ef_vi_transmitv_burst(vi, iov, ids, n));
+    return i;
+  }
+
   /* This is sending the same packet buffer over and over again.
    * a real application would usually send new data. */
   for( i = 0; i < to_send; ++i ) {
@@ -169,7 +206,10 @@ int main(int argc, char* argv[])
     /* Try to push up to the requested iterations, likely fewer get sent */
     n_pushed += send_more_packets(cfg_iter - n_pushed, &vi, dma_buf_addr);
     /* Check for transmit complete */
-    handle_completions();
+    if( cfg_batch_completions )
+      handle_completions_batched();
+    else
+      handle_completions();
     if( cfg_usleep )
       usleep(cfg_usleep);
   }
@@ -189,7 +229,11 @@ void usage(void)
   fprintf(stderr, "  -p                  - enable physical address mode\n");
   fprintf(stderr, "  -t                  - disable tx push (on by default)\n");
   fprintf(stderr, "  -B                  - maximum send batch size\n");
+  fprintf(stderr, "  -c                  - complete only the last TX event "
+          "per poll\n");
   fprintf(stderr, "  -s                  - microseconds to sleep between batches\n");
+  fprintf(stderr, "  -u                  - send each batch with "
+          "ef_vi_transmitv_burst()\n");
   fprintf(stderr, "  -v                  - use a VF\n");
   fprintf(stderr, "  -V <vlan>           - vlan to send to (interface must have an IP)\n");
   fprintf(stderr, "\n");
@@ -204,7 +248,7 @@ static int parse_opts(int argc, char *argv[])
 {
   int c;
 
-  while((c = getopt(argc, argv, "n:m:s:B:l:V:bptvx")) != -1)
+  while((c = getopt(argc, argv, "n:m:s:B:l:V:bcptuvx")) != -1)
     switch( c ) {
     case 'n':
       cfg_iter = atoi(optarg);
@@ -227,12 +271,18 @@ static int parse_opts(int argc, char *argv[])
     case 'b':
       cfg_loopback = 1;
       break;
+    case 'c':
+      cfg_batch_completions = 1;
+      break;
     case 'p':
       cfg_phys_mode = 1;
       break;
     case 't':
       cfg_disable_tx_push = 1;
       break;
+    case 'u':
+      cfg_burst = 1;
+      break;
     case 'v':
       cfg_use_vf = 1;
       break;
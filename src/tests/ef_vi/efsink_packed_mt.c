@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* efsink_packed_mt
+ *
+ * Receive packets using "packed stream" mode, and process them on several
+ * worker threads.
+ *
+ * The main thread polls the VI and hands batches of packets out to the
+ * workers without copying them, using the ps_fanout library.  Each worker
+ * here just counts what it is given; a real application would filter the
+ * packets or write them to disk.
+ */
+
+#include <etherfabric/vi.h>
+#include <etherfabric/pd.h>
+#include <etherfabric/memreg.h>
+#include <etherfabric/packedstream.h>
+
+#include "utils.h"
+#include "ps_fanout.h"
+
+
+#define MAX_WORKERS  64
+
+
+struct worker {
+  struct ps_fanout*        fo;
+  int                      id;
+  pthread_t                thread_id;
+  volatile uint64_t        n_pkts CI_ALIGN(CI_CACHE_LINE_SIZE);
+  volatile uint64_t        n_bytes;
+};
+
+
+static struct ps_fanout  fo;
+static struct worker     workers[MAX_WORKERS];
+static int cfg_timestamping;
+static int cfg_max_fill;
+static int cfg_workers = 2;
+
+
+static void* worker_fn(void* arg)
+{
+  struct worker* w = arg;
+  struct ps_fanout_batch batch;
+  ef_packed_stream_packet* ps_pkt;
+  uint64_t n_bytes;
+  int i;
+
+  while( 1 ) {
+    if( ! ps_fanout_worker_next(w->fo, w->id, &batch) )
+      continue;
+
+    /* Do something useful with the received packets! */
+    n_bytes = 0;
+    ps_pkt = batch.first;
+    for( i = 0; i < batch.n_pkts; ++i ) {
+      n_bytes += ps_pkt->ps_cap_len;
+      ps_pkt = ef_packed_stream_packet_next(ps_pkt);
+    }
+    w->n_pkts += batch.n_pkts;
+    w->n_bytes += n_bytes;
+
+    ps_fanout_batch_done(w->fo, &batch);
+  }
+  return NULL;
+}
+
+/**********************************************************************/
+
+static void* monitor_fn(void* arg)
+{
+  /* Print approx packet rate and bandwidth every second, in total and
+   * for each worker. */
+
+  uint64_t prev_pkts[MAX_WORKERS], prev_bytes, now_bytes, prev_drops;
+  struct timeval start, end;
+  uint64_t prev_total, now_total, pkts;
+  int ms, i;
+
+  printf("# pkt-rate  bandwidth(Mbps)  drop-batches  per-worker-pkt-rate\n");
+
+  prev_total = prev_bytes = 0;
+  for( i = 0; i < cfg_workers; ++i ) {
+    prev_pkts[i] = workers[i].n_pkts;
+    prev_total += prev_pkts[i];
+    prev_bytes += workers[i].n_bytes;
+  }
+  prev_drops = fo.n_drop_batches;
+  gettimeofday(&start, NULL);
+
+  while( 1 ) {
+    sleep(1);
+    gettimeofday(&end, NULL);
+    ms = (end.tv_sec - start.tv_sec) * 1000;
+    ms += (end.tv_usec - start.tv_usec) / 1000;
+
+    now_total = now_bytes = 0;
+    for( i = 0; i < cfg_workers; ++i ) {
+      now_total += workers[i].n_pkts;
+      now_bytes += workers[i].n_bytes;
+    }
+    printf("%10d %16d %13"PRIu64" ",
+           (int) ((now_total - prev_total) * 1000 / ms),
+           (int) ((now_bytes - prev_bytes) * 8 / 1000 / ms),
+           fo.n_drop_batches - prev_drops);
+    for( i = 0; i < cfg_workers; ++i ) {
+      pkts = workers[i].n_pkts;
+      printf(" %d", (int) ((pkts - prev_pkts[i]) * 1000 / ms));
+      prev_pkts[i] = pkts;
+    }
+    printf("\n");
+    fflush(stdout);
+    prev_total = now_total;
+    prev_bytes = now_bytes;
+    prev_drops = fo.n_drop_batches;
+    start = end;
+  }
+  return NULL;
+}
+
+
+static __attribute__ ((__noreturn__)) void usage(void)
+{
+  fprintf(stderr, "usage:\n");
+  fprintf(stderr, "  efsink_packed_mt [options] <interface> "
+          "<filter-spec>...\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "filter-spec:\n");
+  fprintf(stderr, "  {udp|tcp}:[mcastloop-rx,][vid=<vlan>,]<local-host>:"
+          "<local-port>[,<remote-host>:<remote-port>]\n");
+  fprintf(stderr, "  eth:[vid=<vlan>,]<local-mac>\n");
+  fprintf(stderr, "  {unicast-all,multicast-all}\n");
+  fprintf(stderr, "  {unicast-mis,multicast-mis}:[vid=<vlan>]\n");
+  fprintf(stderr, "  {sniff}:[promisc|no-promisc]\n");
+  fprintf(stderr, "  {tx-sniff}\n");
+  fprintf(stderr, "  {block-kernel|block-kernel-unicast|"
+          "block-kernel-multicast}\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -w N   number of worker threads (default 2)\n");
+  fprintf(stderr, "  -t     Request hardware timestamping of packets\n");
+  fprintf(stderr, "  -F FL  set max fill level for RX ring\n");
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  const char* interface;
+  pthread_t thread_id;
+  ef_driver_handle dh;
+  struct ef_pd pd;
+  struct ef_vi vi;
+  struct ef_memreg memreg;
+  unsigned vi_flags;
+  int c, i;
+
+  while( (c = getopt (argc, argv, "tw:F:")) != -1 )
+    switch( c ) {
+    case 't':
+      cfg_timestamping = 1;
+      break;
+    case 'w':
+      cfg_workers = atoi(optarg);
+      break;
+    case 'F':
+      cfg_max_fill = atoi(optarg);
+      break;
+    case '?':
+      usage();
+    default:
+      TEST(0);
+    }
+
+  argc -= optind;
+  argv += optind;
+  if( argc < 2 || cfg_workers < 1 || cfg_workers > MAX_WORKERS )
+    usage();
+  interface = argv[0];
+  ++argv; --argc;
+
+  TRY(ef_driver_open(&dh));
+  TRY(ef_pd_alloc_by_name(&pd, dh, interface, EF_PD_RX_PACKED_STREAM));
+  vi_flags = EF_VI_RX_PACKED_STREAM | EF_VI_RX_PS_BUF_SIZE_64K;
+  if( cfg_timestamping )
+    vi_flags |= EF_VI_RX_TIMESTAMPS;
+  TRY(ef_vi_alloc_from_pd(&vi, dh, &pd, dh, -1, -1, -1, NULL, -1, vi_flags));
+  TRY(ps_fanout_init(&fo, &vi, cfg_workers));
+
+  ef_packed_stream_params psp;
+  TRY(ef_vi_packed_stream_get_params(&vi, &psp));
+  if( cfg_max_fill == 0 )
+    cfg_max_fill = psp.psp_max_usable_buffers;
+  TEST( cfg_max_fill <= ef_vi_receive_capacity(&vi) );
+
+  /* Packed stream mode requires large contiguous buffers, so allocate huge
+   * pages.  (Also makes consuming packets more efficient of course).
+   */
+  int n_bufs = cfg_max_fill;
+  size_t buf_size = psp.psp_buffer_size;
+  size_t alloc_size = n_bufs * buf_size;
+  alloc_size = ROUND_UP(alloc_size, huge_page_size);
+  void* p;
+  p = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE,
+           MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+  if( p == MAP_FAILED ) {
+    fprintf(stderr, "ERROR: mmap failed.  You probably need to allocate some "
+            "huge pages.\n");
+    exit(2);
+  }
+  TEST(((uintptr_t) p & (psp.psp_buffer_align - 1)) == 0);
+  TRY(ef_memreg_alloc(&memreg, dh, &pd, dh, p, alloc_size));
+  for( i = 0; i < n_bufs; ++i ) {
+    struct ps_fanout_buf* buf = (void*) ((char*) p + i * buf_size);
+    TRY(ps_fanout_buf_post(&fo, buf, ef_memreg_dma_addr(&memreg,
+                                                        i * buf_size)));
+  }
+
+  while( argc > 0 ) {
+    ef_filter_spec filter_spec;
+    if( filter_parse(&filter_spec, argv[0], NULL, EF_FILTER_FLAG_NONE) != 0 ) {
+      LOGE("ERROR: Bad filter spec '%s'\n", argv[0]);
+      exit(1);
+    }
+    TRY(ef_vi_filter_add(&vi, dh, &filter_spec, NULL));
+    ++argv; --argc;
+  }
+
+  for( i = 0; i < cfg_workers; ++i ) {
+    workers[i].fo = &fo;
+    workers[i].id = i;
+    TEST(pthread_create(&workers[i].thread_id, NULL,
+                        worker_fn, &workers[i]) == 0);
+  }
+  TEST(pthread_create(&thread_id, NULL, monitor_fn, NULL) == 0);
+  while( 1 )
+    ps_fanout_poll(&fo);
+  return 0;
+}
@@ -3,8 +3,8 @@
 
 EFSEND_APPS := efsend efsend_pio efsend_timestamping efsend_pio_warm
 TEST_APPS	:= efforward efrss efsink \
-		   efsink_packed efforward_packed eflatency efexclusivity stats \
-		   efjumborx $(EFSEND_APPS)
+		   efsink_packed efsink_packed_mt efforward_packed eflatency \
+		   efexclusivity stats efjumborx efreplay $(EFSEND_APPS)
 
 ifeq (${PLATFORM},gnu_x86_64)
 	TEST_APPS += efrink_controller efrink_consumer
@@ -33,8 +33,12 @@ efsink: efsink.o utils.o
 
 efjumborx: efjumborx.o utils.o
 
+efreplay: efreplay.o utils.o
+
 efsink_packed: efsink_packed.o utils.o
 
+efsink_packed_mt: efsink_packed_mt.o ps_fanout.o utils.o
+
 efforward_packed: efforward_packed.o utils.o
 
 efpingpong: MMAKE_LIBS     := $(LINK_CITOOLS_LIB) $(MMAKE_LIBS)
@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* ps_fanout.c
+ *
+ * Spread packed-stream receive over several cores.  See ps_fanout.h.
+ */
+
+#include <etherfabric/vi.h>
+
+#include "utils.h"
+#include "ps_fanout.h"
+
+
+int ps_fanout_init(struct ps_fanout* fo, ef_vi* vi, int n_workers)
+{
+  ef_packed_stream_params psp;
+  void* p;
+  int rc;
+
+  if( n_workers <= 0 )
+    return -EINVAL;
+  rc = ef_vi_packed_stream_get_params(vi, &psp);
+  if( rc < 0 )
+    return rc;
+  if( (size_t) psp.psp_start_offset <
+      sizeof(struct ps_fanout_buf) + sizeof(ef_packed_stream_packet) )
+    return -ENOSPC;
+  if( posix_memalign(&p, CI_CACHE_LINE_SIZE,
+                     n_workers * sizeof(struct ps_fanout_queue)) != 0 )
+    return -ENOMEM;
+
+  memset(fo, 0, sizeof(*fo));
+  memset(p, 0, n_workers * sizeof(struct ps_fanout_queue));
+  fo->vi = vi;
+  fo->psp_start_offset = psp.psp_start_offset;
+  fo->posted_bufs_tail = &fo->posted_bufs;
+  fo->n_workers = n_workers;
+  fo->queues = p;
+  return 0;
+}
+
+
+int ps_fanout_buf_post(struct ps_fanout* fo, struct ps_fanout_buf* buf,
+                       ef_addr ef_addr)
+{
+  buf->ef_addr = ef_addr;
+  buf->next = NULL;
+  ci_atomic_set(&buf->refs, 0);
+  *(fo->posted_bufs_tail) = buf;
+  fo->posted_bufs_tail = &buf->next;
+  return ef_vi_receive_post(fo->vi, ef_addr, 0);
+}
+
+
+static inline struct ps_fanout_buf* posted_buf_get(struct ps_fanout* fo)
+{
+  struct ps_fanout_buf* buf = fo->posted_bufs;
+  if( buf != NULL ) {
+    fo->posted_bufs = buf->next;
+    if( fo->posted_bufs == NULL )
+      fo->posted_bufs_tail = &(fo->posted_bufs);
+  }
+  return buf;
+}
+
+
+static inline void buf_release(struct ps_fanout* fo, struct ps_fanout_buf* buf)
+{
+  struct ps_fanout_buf* head;
+
+  if( ! ci_atomic_dec_and_test(&buf->refs) )
+    return;
+  /* Last reference gone.  Only the collector may touch the VI, so leave
+   * the buffer for it to post. */
+  do {
+    head = fo->released;
+    buf->released_next = head;
+  } while( ! ci_cas_uintptr_succeed(&fo->released, (ci_uintptr_t) head,
+                                   (ci_uintptr_t) buf) );
+}
+
+
+static void post_released(struct ps_fanout* fo)
+{
+  struct ps_fanout_buf* buf;
+  struct ps_fanout_buf* next;
+
+  if( fo->released == NULL )
+    return;
+  /* Take the whole stack at once, so there is no ABA problem. */
+  buf = (void*) (ci_uintptr_t) ci_xchg_uintptr(&fo->released, 0);
+  for( ; buf != NULL; buf = next ) {
+    next = buf->released_next;
+    TRY(ps_fanout_buf_post(fo, buf, buf->ef_addr));
+  }
+}
+
+
+static int queue_put(struct ps_fanout_queue* q,
+                     const struct ps_fanout_batch* batch)
+{
+  unsigned added = q->added;
+
+  if( added - q->removed >= PS_FANOUT_QUEUE_SIZE )
+    return 0;
+  q->batches[added & (PS_FANOUT_QUEUE_SIZE - 1)] = *batch;
+  ci_wmb();
+  q->added = added + 1;
+  return 1;
+}
+
+
+static void dispatch(struct ps_fanout* fo, struct ps_fanout_batch* batch)
+{
+  int i, w;
+
+  /* Take the reference before the batch becomes visible to a worker. */
+  ci_atomic_inc(&batch->buf->refs);
+  for( i = 0; i < fo->n_workers; ++i ) {
+    w = fo->next_worker;
+    if( ++fo->next_worker == fo->n_workers )
+      fo->next_worker = 0;
+    if( queue_put(&fo->queues[w], batch) )
+      return;
+  }
+  ++fo->n_drop_batches;
+  buf_release(fo, batch->buf);
+}
+
+
+static void handle_rx_ps(struct ps_fanout* fo, const ef_event* pev)
+{
+  struct ps_fanout_batch batch;
+  int n_pkts, n_bytes;
+
+  if( EF_EVENT_RX_PS_NEXT_BUFFER(*pev) ) {
+    if( fo->current_buf != NULL )
+      buf_release(fo, fo->current_buf);
+    fo->current_buf = posted_buf_get(fo);
+    TEST(fo->current_buf != NULL);
+    ci_atomic_set(&fo->current_buf->refs, 1);
+    fo->ps_pkt_iter = ef_packed_stream_packet_first(fo->current_buf,
+                                                    fo->psp_start_offset);
+  }
+
+  batch.buf = fo->current_buf;
+  batch.first = fo->ps_pkt_iter;
+  TRY(ef_vi_packed_stream_unbundle(fo->vi, pev, &fo->ps_pkt_iter,
+                                   &n_pkts, &n_bytes));
+  fo->n_rx_pkts += n_pkts;
+  fo->n_rx_bytes += n_bytes;
+  if( n_pkts == 0 )
+    return;
+  batch.n_pkts = n_pkts;
+  dispatch(fo, &batch);
+}
+
+
+int ps_fanout_poll(struct ps_fanout* fo)
+{
+  ef_event evs[16];
+  const int max_evs = sizeof(evs) / sizeof(evs[0]);
+  int i, n_ev;
+
+  post_released(fo);
+
+  n_ev = ef_eventq_poll(fo->vi, evs, max_evs);
+  for( i = 0; i < n_ev; ++i ) {
+    switch( EF_EVENT_TYPE(evs[i]) ) {
+    case EF_EVENT_TYPE_RX_PACKED_STREAM:
+      handle_rx_ps(fo, &(evs[i]));
+      break;
+    default:
+      LOGE("ERROR: unexpected event type=%d\n", (int) EF_EVENT_TYPE(evs[i]));
+      break;
+    }
+  }
+  return n_ev;
+}
+
+
+int ps_fanout_worker_next(struct ps_fanout* fo, int worker,
+                          struct ps_fanout_batch* batch_out)
+{
+  struct ps_fanout_queue* q = &fo->queues[worker];
+  unsigned removed = q->removed;
+
+  if( q->added == removed )
+    return 0;
+  ci_rmb();
+  *batch_out = q->batches[removed & (PS_FANOUT_QUEUE_SIZE - 1)];
+  /* Finish reading the slot before handing it back. */
+  ci_mb();
+  q->removed = removed + 1;
+  return 1;
+}
+
+
+void ps_fanout_batch_done(struct ps_fanout* fo,
+                          const struct ps_fanout_batch* batch)
+{
+  buf_release(fo, batch->buf);
+}
@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+/* ps_fanout.h
+ *
+ * Library to spread packed-stream receive over several cores.
+ *
+ * A single collector thread owns the VI.  It polls the event queue and
+ * hands each batch of packets reported by an RX_PACKED_STREAM event to
+ * one of a number of workers, round robin, through a lock-free
+ * single-producer single-consumer queue per worker.  Packets are not
+ * copied: a batch names a run of packets in a packed-stream buffer, and
+ * the buffer is reference counted so that it is only given back to the
+ * NIC once the collector has moved on from it and every worker has
+ * finished with the batches it was given from it.
+ *
+ * The collector must:
+ * 1. call ps_fanout_init() once the VI has been allocated
+ * 2. call ps_fanout_buf_post() for each buffer to fill the RX ring
+ * 3. call ps_fanout_poll() in a loop
+ *
+ * Each worker must:
+ * 1. call ps_fanout_worker_next() to get a batch
+ * 2. walk the batch with ef_packed_stream_packet_next().  The batch may
+ *    be held for as long as needed, e.g. while it is being written to disk
+ * 3. call ps_fanout_batch_done() when it is finished with the batch
+ *
+ * If every worker's queue is full the collector drops the batch, and
+ * counts it in n_drop_batches.
+ */
+#ifndef __PS_FANOUT_H__
+#define __PS_FANOUT_H__
+
+#include <etherfabric/ef_vi.h>
+#include <etherfabric/packedstream.h>
+#include <ci/tools.h>
+
+
+/* Must be a power of 2. */
+#define PS_FANOUT_QUEUE_SIZE  1024
+
+
+/* Lives at the start of each packed-stream buffer, in the space the
+ * adapter leaves in front of the first packet. */
+struct ps_fanout_buf {
+  ef_addr                  ef_addr;
+  /* One reference is held by the collector while the NIC is filling the
+   * buffer, and one for each batch handed to a worker. */
+  ci_atomic_t              refs;
+  /* Collector's list of buffers posted to the NIC, in order. */
+  struct ps_fanout_buf*    next;
+  /* Stack of buffers released by workers, waiting to be posted again. */
+  struct ps_fanout_buf*    released_next;
+};
+
+
+struct ps_fanout_batch {
+  struct ps_fanout_buf*    buf;
+  ef_packed_stream_packet* first;
+  int                      n_pkts;
+};
+
+
+struct ps_fanout_queue {
+  volatile unsigned        added CI_ALIGN(CI_CACHE_LINE_SIZE);
+  volatile unsigned        removed CI_ALIGN(CI_CACHE_LINE_SIZE);
+  struct ps_fanout_batch   batches[PS_FANOUT_QUEUE_SIZE]
+                             CI_ALIGN(CI_CACHE_LINE_SIZE);
+};
+
+
+struct ps_fanout {
+  /* Touched only by the collector */
+  ef_vi*                   vi;
+  int                      psp_start_offset;
+  struct ps_fanout_buf*    current_buf;
+  ef_packed_stream_packet* ps_pkt_iter;
+  struct ps_fanout_buf*    posted_bufs;
+  struct ps_fanout_buf**   posted_bufs_tail;
+  int                      n_workers;
+  int                      next_worker;
+  uint64_t                 n_rx_pkts;
+  uint64_t                 n_rx_bytes;
+  uint64_t                 n_drop_batches;
+
+  /* Shared with the workers */
+  struct ps_fanout_buf* volatile released CI_ALIGN(CI_CACHE_LINE_SIZE);
+  struct ps_fanout_queue*  queues;
+};
+
+
+/* Set up for [n_workers] workers to receive from [vi], which must be in
+ * packed-stream mode.  Returns 0 on success or a negative error code. */
+extern int ps_fanout_init(struct ps_fanout* fo, ef_vi* vi, int n_workers);
+
+/* Give a buffer to the NIC.  [buf] is the start of a packed-stream
+ * buffer and [ef_addr] its DMA address.  Collector only. */
+extern int ps_fanout_buf_post(struct ps_fanout* fo, struct ps_fanout_buf* buf,
+                              ef_addr ef_addr);
+
+/* Post released buffers back to the NIC, then poll the event queue and
+ * hand out what has arrived.  Returns the number of events handled.
+ * Collector only. */
+extern int ps_fanout_poll(struct ps_fanout* fo);
+
+/* Take the next batch queued for [worker].  Returns 1 if [batch_out] was
+ * filled in, or 0 if there is no batch waiting. */
+extern int ps_fanout_worker_next(struct ps_fanout* fo, int worker,
+                                 struct ps_fanout_batch* batch_out);
+
+/* Finish with a batch taken by ps_fanout_worker_next().  May be called
+ * from any thread. */
+extern void ps_fanout_batch_done(struct ps_fanout* fo,
+                                 const struct ps_fanout_batch* batch);
+
+#endif  /* __PS_FANOUT_H__ */
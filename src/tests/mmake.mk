@@ -1,7 +1,8 @@
 # SPDX-License-Identifier: BSD-2-Clause
 # X-SPDX-Copyright-Text: (c) Copyright 2002-2020 Xilinx, Inc.
 ifeq ($(GNU),1)
-SUBDIRS		:=     driver \
+SUBDIRS		:=     bench \
+                   driver \
                    ef_vi \
                    onload \
                    orm_test_client \
@@ -13,7 +14,8 @@ SUBDIRS		:=     driver \
 OTHER_SUBDIRS	:=
 
 ifeq ($(ONLOAD_ONLY),1)
-SUBDIRS		:= ef_vi \
+SUBDIRS		:= bench \
+                   ef_vi \
                    onload \
                    rtt \
                    trade_sim \
@@ -369,6 +369,52 @@ void test_buddy_5(ci_netif* ni)
 }
 
 
+void test_buddy_6(ci_netif* ni)
+{
+  ci_pio_buddy_allocator* b = &ni->state->nic[0].pio_buddy;
+  const ci_uint8 o = CI_CFG_MIN_PIO_BLOCK_ORDER;
+  oo_sp s1 = OO_SP_FROM_INT(ni, 1);
+  ci_uint8 ro;
+  int i, a[4], r1;
+
+  CHK_PT();
+
+  /* Relocation lets a stranded block's buddy merge. */
+  ci_pio_buddy_ctor(ni, b, CI_PIO_BUDDY_TEST_LEN);
+  for( i = 0; i < 4; ++i ) {
+    CI_TRY(a[i] = ci_pio_buddy_alloc(ni, b, o));
+    CI_TEST(a[i] == ADDR_TO_OFFSET(i));
+  }
+  ci_pio_buddy_free(ni, b, a[0], o);
+  ci_pio_buddy_free(ni, b, a[2], o);
+  CI_TEST(ci_pio_buddy_can_compact(ni, b));
+  a[1] = ci_pio_buddy_relocate(ni, b, a[1], o);
+  CI_TEST(a[1] == ADDR_TO_OFFSET(2));
+  CI_TEST(! ci_pio_buddy_can_compact(ni, b));
+  ci_pio_buddy_free(ni, b, a[1], o);
+  ci_pio_buddy_free(ni, b, a[3], o);
+  CI_TEST(ci_pio_buddy_alloc(ni, b, CI_PIO_BUDDY_TEST_MAX_ORDER) == 0);
+  ci_pio_buddy_dtor(ni, b);
+
+  CHK_PT();
+
+  /* A reserved block survives being freed, and is handed back. */
+  ci_pio_buddy_ctor(ni, b, CI_PIO_BUDDY_TEST_LEN);
+  ro = o;
+  CI_TRY(r1 = ci_pio_buddy_alloc_reserved(ni, b, s1, &ro));
+  CI_TEST(ro == o);
+  ci_pio_buddy_free(ni, b, r1, o);
+  CI_TEST(ci_pio_buddy_alloc(ni, b, CI_PIO_BUDDY_TEST_MAX_ORDER) < 0);
+  ro = o;
+  CI_TEST(ci_pio_buddy_alloc_reserved(ni, b, s1, &ro) == r1);
+  ci_pio_buddy_free(ni, b, r1, o);
+  CI_TEST(ci_pio_buddy_unreserve(ni, b, s1));
+  CI_TEST(! ci_pio_buddy_unreserve(ni, b, s1));
+  CI_TEST(ci_pio_buddy_alloc(ni, b, CI_PIO_BUDDY_TEST_MAX_ORDER) == 0);
+  ci_pio_buddy_dtor(ni, b);
+}
+
+
 int main(int argc, char* argv[])
 {
   netif_t* netif;
@@ -399,6 +445,7 @@ int main(int argc, char* argv[])
   test_buddy_3(&netif->ni);
   test_buddy_4(&netif->ni);
   test_buddy_5(&netif->ni);
+  test_buddy_6(&netif->ni);
 
   return 0;
 }
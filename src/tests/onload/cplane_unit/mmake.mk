@@ -41,7 +41,7 @@ SRCS := ../../tap/tap.c ../../../tools/onload_mibdump/dump_tables.c \
 # Main source file for each unit test binary.
 TEST_SRCS := test_route.c test_route_expire.c test_arp_expire.c \
 	     test_route_stress.c test_teambond.c test_namespace.c \
-	     test_service_dnat.c
+	     test_service_dnat.c test_ip_prefix_list.c
 
 OBJS := $(patsubst %.c,%.o,$(SRCS))
 OBJS += $(patsubst %,$(CPLANE_OBJ_DIR)/%,$(SERVER_OBJS))
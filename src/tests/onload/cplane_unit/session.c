@@ -48,6 +48,8 @@ void cp_unit_init_session(struct cp_session* s)
   /* Initial sizes for route_dst and rule_src are enlarged at need. */
   cp_ippl_init(&s->route_dst, sizeof(struct cp_ip_with_prefix), NULL, 4);
   cp_ippl_init(&s->rule_src, sizeof(struct cp_ip_with_prefix), NULL, 1);
+  cp_ippl_enable_trie(&s->route_dst, AF_INET);
+  cp_ippl_enable_trie(&s->rule_src, AF_INET);
 
   /* Rather than go to the effort of finding the CPU's frequency, use a value
    * of 1 KHz.  Times will therefore not be reported in milliseconds as
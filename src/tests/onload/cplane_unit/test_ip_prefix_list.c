@@ -0,0 +1,247 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* This test checks, for IPv4 and IPv6, both after single additions and
+ * removals and after a dump, that
+ * - cp_ippl_search() finds exactly the entries in the list;
+ * - cp_ippl_get_prefix() gives the same answers with the address trie as
+ *   with the scan of the whole list;
+ * - cp_ippl_lpm() gives the same answers as the scan of the whole list. */
+
+#include "cplane_unit.h"
+
+#include "../../tap/tap.h"
+
+
+#define N_ENTRIES 500
+#define N_QUERIES 5000
+
+/* Addresses are picked near a few bases, so that they share long prefixes
+ * with each other. */
+static ci_addr_sh_t bases[8];
+
+
+static ci_addr_sh_t random_addr(int af)
+{
+  ci_addr_sh_t addr = bases[rand32() % 8];
+  int bits = rand32() % (CI_IPX_MAX_PREFIX_LEN(af) + 1);
+
+  if( af == AF_INET ) {
+    uint32_t noise = bits == 32 ? rand32() : rand32() & ((1u << bits) - 1);
+    addr.ip4 ^= htonl(noise);
+  }
+  else {
+    int i;
+    for( i = 3; i >= 0 && bits > 0; i--, bits -= 32 ) {
+      uint32_t noise = bits >= 32 ? rand32() : rand32() & ((1u << bits) - 1);
+      addr.u32[i] ^= htonl(noise);
+    }
+  }
+  return addr;
+}
+
+
+static void random_entry(int af, struct cp_ip_with_prefix* ipp)
+{
+  ipp->addr = random_addr(af);
+  ipp->prefix = rand32() % (CI_IPX_MAX_PREFIX_LEN(af) + 1);
+}
+
+
+static void add_all(struct cp_ip_prefix_list* lists, int n,
+                    struct cp_ip_with_prefix* ipp)
+{
+  int i;
+
+  for( i = 0; i < n; i++ )
+    cp_ippl_add(&lists[i], ipp, NULL);
+}
+
+
+static void del_all(struct cp_ip_prefix_list* lists, int n,
+                    struct cp_ip_with_prefix* ipp)
+{
+  struct cp_ip_with_prefix* entry;
+  int i;
+
+  for( i = 0; i < n; i++ )
+    if( (entry = cp_ippl_search(&lists[i], ipp)) != NULL )
+      cp_ippl_del(&lists[i], entry);
+}
+
+
+static struct cp_ip_with_prefix*
+linear_search(struct cp_ip_prefix_list* list, struct cp_ip_with_prefix* ipp)
+{
+  int i;
+
+  for( i = 0; i < list->used; i++ )
+    if( list->compare(cp_ippl_entry(list, i), ipp) == 0 )
+      return cp_ippl_entry(list, i);
+  return NULL;
+}
+
+
+static void check_search(int af, struct cp_ip_prefix_list* list,
+                         const char* what)
+{
+  int i, mismatches = 0;
+
+  /* Every entry is found where it is... */
+  for( i = 0; i < list->used; i++ )
+    if( cp_ippl_search(list, cp_ippl_entry(list, i)) !=
+        cp_ippl_entry(list, i) )
+      mismatches++;
+
+  /* ...and nothing else is found. */
+  for( i = 0; i < N_QUERIES; i++ ) {
+    struct cp_ip_with_prefix ipp;
+    random_entry(af, &ipp);
+    if( cp_ippl_search(list, &ipp) != linear_search(list, &ipp) )
+      mismatches++;
+  }
+  cmp_ok(mismatches, "==", 0, "%s: hash agrees with the list scan", what);
+}
+
+
+static bool match_odd(struct cp_ip_with_prefix* ipp, void* arg)
+{
+  return arg == NULL || (ipp->addr.u32[3] & htonl(1));
+}
+
+
+static struct cp_ip_with_prefix*
+linear_lpm(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr,
+           void* arg)
+{
+  struct cp_ip_with_prefix* best = NULL;
+  int i;
+
+  for( i = 0; i < list->used; i++ ) {
+    struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, i);
+    if( ! cp_ipx_ippl_pfx_match(af, addr, ipp->addr, ipp->prefix) ||
+        ! match_odd(ipp, arg) )
+      continue;
+    if( best == NULL || list->compare(ipp, best) < 0 )
+      best = ipp;
+  }
+  return best;
+}
+
+
+static void check_lpm(int af, struct cp_ip_prefix_list* list,
+                      const char* what)
+{
+  int i, mismatches = 0;
+
+  for( i = 0; i < N_QUERIES; i++ ) {
+    ci_addr_sh_t addr = random_addr(af);
+    void* arg = (i & 1) ? list : NULL;
+    if( cp_ippl_lpm(list, af, addr, match_odd, arg) !=
+        linear_lpm(list, af, addr, arg) )
+      mismatches++;
+  }
+  cmp_ok(mismatches, "==", 0, "%s: lpm agrees with the list scan", what);
+}
+
+
+static void compare_lists(int af, struct cp_ip_prefix_list* plain,
+                          struct cp_ip_prefix_list* trie,
+                          struct cp_ip_prefix_list* lpm, const char* what)
+{
+  int i, mismatches = 0;
+
+  cmp_ok(plain->used, "==", trie->used, "%s: same number of entries", what);
+  cmp_ok(plain->used, "==", lpm->used, "%s: same number of entries", what);
+  for( i = 0; i < N_QUERIES; i++ ) {
+    ci_addr_sh_t addr = random_addr(af);
+    if( cp_ippl_get_prefix(plain, af, addr) !=
+        cp_ippl_get_prefix(trie, af, addr) )
+      mismatches++;
+  }
+  cmp_ok(mismatches, "==", 0, "%s: trie agrees with the list scan", what);
+
+  check_search(af, trie, what);
+  check_search(af, lpm, what);
+  check_lpm(af, lpm, what);
+}
+
+
+static void test_af(int af)
+{
+  /* The same entries in a plain list, a list with the trie, and a list
+   * hashed by prefix. */
+  struct cp_ip_prefix_list lists[3];
+  struct cp_ip_prefix_list* plain = &lists[0];
+  struct cp_ip_prefix_list* trie = &lists[1];
+  struct cp_ip_prefix_list* lpm = &lists[2];
+  struct cp_ip_with_prefix entries[N_ENTRIES];
+  const char* name = af == AF_INET ? "IPv4" : "IPv6";
+  char what[64];
+  int i;
+
+  for( i = 0; i < 8; i++ ) {
+    memset(&bases[i], 0, sizeof(bases[i]));
+    if( af == AF_INET ) {
+      bases[i] = CI_ADDR_SH_FROM_IP4(rand32());
+    }
+    else {
+      int j;
+      for( j = 0; j < 4; j++ )
+        bases[i].u32[j] = rand32();
+    }
+  }
+
+  for( i = 0; i < 3; i++ )
+    cp_ippl_init(&lists[i], sizeof(struct cp_ip_with_prefix), NULL, 4);
+  cp_ippl_enable_trie(trie, af);
+  lpm->hash_by_prefix = true;
+
+  snprintf(what, sizeof(what), "%s empty", name);
+  compare_lists(af, plain, trie, lpm, what);
+
+  for( i = 0; i < N_ENTRIES; i++ ) {
+    random_entry(af, &entries[i]);
+    add_all(lists, 3, &entries[i]);
+  }
+  snprintf(what, sizeof(what), "%s after additions", name);
+  compare_lists(af, plain, trie, lpm, what);
+
+  for( i = 0; i < N_ENTRIES; i += 3 )
+    del_all(lists, 3, &entries[i]);
+  snprintf(what, sizeof(what), "%s after removals", name);
+  compare_lists(af, plain, trie, lpm, what);
+  for( i = 0; i < N_ENTRIES; i += 3 )
+    if( cp_ippl_search(trie, &entries[i]) != NULL ||
+        cp_ippl_search(lpm, &entries[i]) != NULL )
+      break;
+  cmp_ok(i, ">=", N_ENTRIES, "%s: removed entries are not found", what);
+
+  /* A dump keeps every other entry, removes some of them in the middle
+   * and brings in new ones. */
+  for( i = 0; i < 3; i++ )
+    cp_ippl_start_dump(&lists[i]);
+  for( i = 0; i < N_ENTRIES; i++ ) {
+    if( i % 2 == 0 )
+      random_entry(af, &entries[i]);
+    add_all(lists, 3, &entries[i]);
+    if( i % 5 == 0 )
+      del_all(lists, 3, &entries[i / 2]);
+  }
+  for( i = 0; i < 3; i++ )
+    cp_ippl_finalize(NULL, &lists[i], NULL);
+  snprintf(what, sizeof(what), "%s after a dump", name);
+  compare_lists(af, plain, trie, lpm, what);
+}
+
+
+int main(void)
+{
+  cp_unit_init();
+  srand(0);
+
+  test_af(AF_INET);
+  test_af(AF_INET6);
+
+  done_testing();
+}
@@ -272,15 +272,19 @@ void test_inserts(void)
   cmp_ok(s.route_dst.used, "==", 4,
 	 "saw all rules other than the default gateway");
 
-  /* Control plane sorts routes by prefix: /32 first, /0 last. */
-  cmp_ok(cp_ippl_entry(&s.route_dst, 0)->addr.ip4, "==", A("9.9.9.0"),
-	 "route destination - longest prefix");
-  cmp_ok(cp_ippl_entry(&s.route_dst, 0)->prefix, "==", 24,
-	 "longest route prefix");
-  cmp_ok(cp_ippl_entry(&s.route_dst, 1)->addr.ip4, "==", A("1.2.0.0"),
-	 "route destination");
-  cmp_ok(cp_ippl_entry(&s.route_dst, 1)->prefix, "==", 16,
-	 "route prefix");
+  /* Control plane finds routes by destination and prefix. */
+  struct cp_ip_with_prefix dst;
+  dst.addr = ASH("9.9.9.0");
+  dst.prefix = 24;
+  ok(cp_ippl_search(&s.route_dst, &dst) != NULL,
+     "route destination - longest prefix");
+  dst.addr = ASH("1.2.0.0");
+  dst.prefix = 16;
+  ok(cp_ippl_search(&s.route_dst, &dst) != NULL,
+     "route destination");
+  dst.prefix = 24;
+  ok(cp_ippl_search(&s.route_dst, &dst) == NULL,
+     "no route with a different prefix");
 }
 
 
@@ -781,6 +781,67 @@ void test_svc_load_balancing(void)
 
 
 
+/* Removing one backend should only move the Maglev slots that it held */
+void test_svc_maglev_disruption(void)
+{
+  const unsigned n_backends = 20;
+  ci_addr_sh_t addr = CI_ADDR_SH_FROM_IP4(0x01010101);
+  ci_addr_sh_t addr_b = CI_ADDR_SH_FROM_IP4(0x12121212);
+  ci_uint16 port = 80;
+  const ci_uint16 removed_port = port + 7;
+  struct cp_session s;
+  struct cp_mibs *mib;
+  struct cp_svc_ep_dllist* svc;
+  cicp_mac_rowid_t id, id_b;
+  ci_uint16 before[CP_SVC_MAGLEV_SIZE];
+  unsigned i, n_moved = 0, n_removed = 0, n_still_removed = 0;
+
+  cp_unit_init_session(&s);
+
+  id = cp_svc_add(&s, addr, port);
+  ok(CICP_MAC_ROWID_IS_VALID(id), "Added service");
+  for( i = 0; i < n_backends; ++i ) {
+    id_b = cp_svc_backend_add(&s, id, addr_b, port + i);
+    ci_assert( CICP_MAC_ROWID_IS_VALID(id_b) );
+  }
+
+  /* Record the backend port in each slot, as element ids move on removal */
+  mib = cp_get_active_mib(&s);
+  svc = &mib->svc_ep_table[id];
+  for( i = 0; i < CP_SVC_MAGLEV_SIZE; ++i ) {
+    ci_uint32 slot =
+      mib->svc_maglev[svc->u.service.head_array_id].slots[i];
+    before[i] = mib->svc_arrays[CP_SVC_MAGLEV_SLOT_ARRAY(slot)]
+                  .eps[CP_SVC_MAGLEV_SLOT_INDEX(slot)].port;
+  }
+
+  cp_svc_backend_del(&s, id, addr_b, removed_port);
+
+  mib = cp_get_active_mib(&s);
+  svc = &mib->svc_ep_table[id];
+  for( i = 0; i < CP_SVC_MAGLEV_SIZE; ++i ) {
+    ci_uint32 slot =
+      mib->svc_maglev[svc->u.service.head_array_id].slots[i];
+    ci_uint16 after = mib->svc_arrays[CP_SVC_MAGLEV_SLOT_ARRAY(slot)]
+                        .eps[CP_SVC_MAGLEV_SLOT_INDEX(slot)].port;
+    if( after == removed_port )
+      ++n_still_removed;
+    if( before[i] == removed_port )
+      ++n_removed;
+    else if( after != before[i] )
+      ++n_moved;
+  }
+
+  ok(n_removed > 0, "Removed backend held some slots");
+  cmp_ok(n_still_removed, "==", 0, "Removed backend has no slots");
+  cmp_ok(n_moved, "<", CP_SVC_MAGLEV_SIZE / 10,
+         "Few slots of remaining backends moved");
+
+  cp_unit_destroy_session(&s);
+}
+
+
+
 int main(void)
 {
   cp_unit_init();
@@ -802,6 +863,7 @@ int main(void)
   test_svc_hash_table_full();
   test_svc_erase();
   test_svc_load_balancing();
+  test_svc_maglev_disruption();
 
   done_testing();
 }
@@ -3,7 +3,7 @@
 # Only build if USEONLOADEXT is defined
 ifneq ($(strip $(USEONLOADEXT)),)
 
-TARGETS := wire_order_client wire_order_server
+TARGETS := wire_order_client wire_order_server wire_order_bench
 
 MMAKE_LIBS += $(LINK_ONLOAD_EXT_LIB)
 MMAKE_LIB_DEPS += $(ONLOAD_EXT_LIB_DEPEND)
@@ -0,0 +1,265 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2026 Advanced Micro Devices, Inc. */
+/* Scaling benchmark for the wire order delivery API.
+ *
+ * The receiver binds many UDP sockets, spread across several stacks, and
+ * drains them with onload_ordered_epoll_wait().  It reports the cost of
+ * each call and the number of events returned, and counts any event whose
+ * timestamp is earlier than one already returned.
+ *
+ * The sender blasts datagrams round-robin across the receiver's ports,
+ * optionally at a fixed rate.  Run it on another host, so that the traffic
+ * arrives on the wire and is hardware timestamped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <netdb.h>
+
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/net_tstamp.h>
+
+#include <onload/extensions.h>
+
+#include "wire_order.h"
+
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+      if( __rc < 0 ) {                                                  \
+        fprintf(stderr, "ERROR: TRY(%s) failed\n", #x);                 \
+        fprintf(stderr, "ERROR: at %s:%d\n", __FILE__, __LINE__);       \
+        fprintf(stderr, "ERROR: rc=%d errno=%d (%s)\n",                 \
+                __rc, errno, strerror(errno));                          \
+        exit(1);                                                        \
+      }                                                                 \
+  } while( 0 )
+
+
+#define MAX_EPOLL_EVENTS  1024
+
+static int cfg_n_socks = 256;
+static int cfg_n_stacks = 4;
+static int cfg_max_events = DEFAULT_MAX_EPOLL_EVENTS;
+static int cfg_port = DEFAULT_PORT;
+static int cfg_seconds = 10;
+static int cfg_msg_size = 64;
+static long cfg_rate;
+
+
+static void usage(void)
+{
+  fprintf(stderr, "\nusage:\n");
+  fprintf(stderr, "  wire_order_bench [options] rx\n");
+  fprintf(stderr, "  wire_order_bench [options] tx <host>\n");
+  fprintf(stderr, "\noptions:\n");
+  fprintf(stderr, "  -n <sockets>          - Number of sockets [%d]\n",
+          cfg_n_socks);
+  fprintf(stderr, "  -s <stacks>           - Number of stacks (rx) [%d]\n",
+          cfg_n_stacks);
+  fprintf(stderr, "  -m <max epoll events> - Maximum number of epoll events "
+          "[%d]\n", cfg_max_events);
+  fprintf(stderr, "  -p <port>             - First port number [%d]\n",
+          cfg_port);
+  fprintf(stderr, "  -t <seconds>          - Duration [%d]\n", cfg_seconds);
+  fprintf(stderr, "  -l <bytes>            - Message size (tx) [%d]\n",
+          cfg_msg_size);
+  fprintf(stderr, "  -r <msgs per sec>     - Message rate, 0 for as fast as "
+          "possible (tx) [%ld]\n", cfg_rate);
+  exit(1);
+}
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static int ts_before(const struct timespec* a, const struct timespec* b)
+{
+  return a->tv_sec < b->tv_sec ||
+         (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+
+static void do_rx(void)
+{
+  struct epoll_event evs[MAX_EPOLL_EVENTS];
+  struct onload_ordered_epoll_event oo_evs[MAX_EPOLL_EVENTS];
+  struct timespec last_ts = {0, 0};
+  uint64_t n_calls = 0, n_empty = 0, n_events = 0, n_bytes = 0;
+  uint64_t n_out_of_order = 0, call_ns = 0, start, end, t;
+  char buf[65536];
+  char stackname[16];
+  int epoll_fd, i, n_evs, rc, sock;
+  int ts_flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+  struct sockaddr_in sa;
+
+  TRY(epoll_fd = epoll_create(1));
+
+  for( i = 0; i < cfg_n_socks; ++i ) {
+    snprintf(stackname, sizeof(stackname), "woda%d", i % cfg_n_stacks);
+    TRY(onload_set_stackname(ONLOAD_THIS_THREAD, ONLOAD_SCOPE_GLOBAL,
+                             stackname));
+    TRY(sock = socket(AF_INET, SOCK_DGRAM, 0));
+    TRY(setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags,
+                   sizeof(ts_flags)));
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    sa.sin_port = htons(cfg_port + i);
+    TRY(bind(sock, (struct sockaddr*) &sa, sizeof(sa)));
+
+    evs[0].events = EPOLLIN;
+    evs[0].data.fd = sock;
+    TRY(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &evs[0]));
+  }
+  TRY(onload_stackname_restore());
+
+  printf("rx: %d sockets across %d stacks, max_events=%d\n",
+         cfg_n_socks, cfg_n_stacks, cfg_max_events);
+
+  start = now_ns();
+  end = start + (uint64_t) cfg_seconds * 1000000000;
+  while( (t = now_ns()) < end ) {
+    n_evs = onload_ordered_epoll_wait(epoll_fd, evs, oo_evs,
+                                      cfg_max_events, 0);
+    call_ns += now_ns() - t;
+    TRY(n_evs);
+    ++n_calls;
+    if( n_evs == 0 ) {
+      ++n_empty;
+      continue;
+    }
+    for( i = 0; i < n_evs; ++i ) {
+      if( oo_evs[i].ts.tv_sec != 0 ) {
+        if( ts_before(&oo_evs[i].ts, &last_ts) )
+          ++n_out_of_order;
+        last_ts = oo_evs[i].ts;
+      }
+      /* Only consume what we were told is in order, so that the rest is
+       * ordered against the other sockets on the next call.  Without a
+       * timestamp there is no count, so just take one message. */
+      do {
+        TRY(rc = recv(evs[i].data.fd, buf, sizeof(buf), MSG_DONTWAIT));
+        n_bytes += rc;
+        oo_evs[i].bytes -= rc < oo_evs[i].bytes ? rc : oo_evs[i].bytes;
+        ++n_events;
+      } while( oo_evs[i].bytes > 0 );
+    }
+  }
+  t = now_ns() - start;
+
+  printf("calls:          %llu (%llu empty)\n",
+         (unsigned long long) n_calls, (unsigned long long) n_empty);
+  printf("messages:       %llu (%.0f per sec)\n",
+         (unsigned long long) n_events, n_events * 1e9 / t);
+  printf("bytes:          %llu\n", (unsigned long long) n_bytes);
+  printf("ns per call:    %.1f\n", n_calls ? (double) call_ns / n_calls : 0);
+  printf("msgs per call:  %.2f\n",
+         n_calls > n_empty ? (double) n_events / (n_calls - n_empty) : 0);
+  printf("out of order:   %llu\n", (unsigned long long) n_out_of_order);
+}
+
+
+static void do_tx(const char* host)
+{
+  struct sockaddr_in sa;
+  struct hostent* he;
+  uint64_t start, end, t, n_sent = 0, interval_ns = 0, next;
+  char* buf;
+  int sock, port_i = 0;
+
+  if( (he = gethostbyname(host)) == NULL ) {
+    fprintf(stderr, "ERROR: unknown host '%s'\n", host);
+    exit(1);
+  }
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  memcpy(&sa.sin_addr, he->h_addr_list[0], sizeof(sa.sin_addr));
+
+  TRY(sock = socket(AF_INET, SOCK_DGRAM, 0));
+  buf = calloc(1, cfg_msg_size);
+  if( cfg_rate > 0 )
+    interval_ns = 1000000000 / cfg_rate;
+
+  start = next = now_ns();
+  end = start + (uint64_t) cfg_seconds * 1000000000;
+  while( (t = now_ns()) < end ) {
+    if( interval_ns ) {
+      if( t < next )
+        continue;
+      next += interval_ns;
+    }
+    memcpy(buf, &n_sent, cfg_msg_size < 8 ? cfg_msg_size : 8);
+    sa.sin_port = htons(cfg_port + port_i);
+    TRY(sendto(sock, buf, cfg_msg_size, 0, (struct sockaddr*) &sa,
+               sizeof(sa)));
+    ++n_sent;
+    if( ++port_i == cfg_n_socks )
+      port_i = 0;
+  }
+
+  printf("sent %llu messages (%.0f per sec)\n", (unsigned long long) n_sent,
+         n_sent * 1e9 / (now_ns() - start));
+  free(buf);
+}
+
+
+int main(int argc, char* argv[])
+{
+  int c;
+
+  while( (c = getopt(argc, argv, "n:s:m:p:t:l:r:")) != -1 )
+    switch( c ) {
+    case 'n':
+      cfg_n_socks = atoi(optarg);
+      break;
+    case 's':
+      cfg_n_stacks = atoi(optarg);
+      break;
+    case 'm':
+      cfg_max_events = atoi(optarg);
+      break;
+    case 'p':
+      cfg_port = atoi(optarg);
+      break;
+    case 't':
+      cfg_seconds = atoi(optarg);
+      break;
+    case 'l':
+      cfg_msg_size = atoi(optarg);
+      break;
+    case 'r':
+      cfg_rate = atol(optarg);
+      break;
+    default:
+      usage();
+    }
+  argc -= optind;
+  argv += optind;
+
+  if( cfg_n_socks < 1 || cfg_n_stacks < 1 || cfg_msg_size < 1 ||
+      cfg_max_events < 1 || cfg_max_events > MAX_EPOLL_EVENTS )
+    usage();
+
+  if( argc == 1 && ! strcmp(argv[0], "rx") )
+    do_rx();
+  else if( argc == 2 && ! strcmp(argv[0], "tx") )
+    do_tx(argv[1]);
+  else
+    usage();
+  return 0;
+}
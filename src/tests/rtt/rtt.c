@@ -49,6 +49,8 @@ struct endpoint_type {
 static const struct endpoint_type ep_types[] = {
   { "tcp", rtt_tcp_build_endpoint },
   { "udp", rtt_udp_build_endpoint },
+  { "tcp6", rtt_tcp6_build_endpoint },
+  { "udp6", rtt_udp6_build_endpoint },
   { "efvi", rtt_efvi_build_endpoint },
 };
 
@@ -56,13 +56,13 @@ static int keyprefixcmp(const char* cmp, const char* key, int key_len)
 
 
 static int lookup_and(int (*op)(int, const struct sockaddr*, socklen_t),
-                      const char* op_s,  int sock, int socktype,
+                      const char* op_s,  int sock, int af, int socktype,
                       const char* node, const char* service)
 {
   struct addrinfo hints, *ai;
   memset(&hints, 0, sizeof(hints));
   hints.ai_flags = AI_PASSIVE;
-  hints.ai_family = AF_INET;
+  hints.ai_family = af;
   hints.ai_socktype = socktype;
   int rc = getaddrinfo(node, service, &hints, &ai);
   if( rc != 0 )
@@ -81,7 +81,7 @@ static int lookup_and(int (*op)(int, const struct sockaddr*, socklen_t),
 static int socket_build_endpoint(struct rtt_endpoint** ep_out,
                                  const struct rtt_options* opts,
                                  const char** args, int n_args,
-                                 int socktype)
+                                 int af, int socktype)
 {
   const char* bind_port = NULL;
   const char* bind_host = NULL;
@@ -106,7 +106,7 @@ static int socket_build_endpoint(struct rtt_endpoint** ep_out,
       return rtt_err("ERROR: unknown arg: %s\n", args[arg_i]);
   }
 
-  int sock = socket(AF_INET, socktype, 0);
+  int sock = socket(af, socktype, 0);
   if( sock < 0 )
     return rtt_err("ERROR: socket() failed: %s\n", strerror(errno));
 
@@ -116,11 +116,12 @@ static int socket_build_endpoint(struct rtt_endpoint** ep_out,
   }
 
   if( bind_port || bind_host )
-    if( lookup_and(bind, "bind", sock, socktype, bind_host, bind_port) < 0 )
+    if( lookup_and(bind, "bind", sock, af, socktype,
+                   bind_host, bind_port) < 0 )
       return -1;
 
   if( connect_port ) {
-    if( lookup_and(connect, "connect", sock, socktype,
+    if( lookup_and(connect, "connect", sock, af, socktype,
                    connect_host, connect_port) < 0 )
       return -1;
   }
@@ -139,7 +140,7 @@ static int socket_build_endpoint(struct rtt_endpoint** ep_out,
   sep->ep.reset_stats = NULL;
   sep->ep.dump_info = NULL;
   sep->sock = sock;
-  const ssize_t headers = 14 + 20 + 8;
+  const ssize_t headers = 14 + (af == AF_INET6 ? 40 : 20) + 8;
   RTT_TEST( opts->ping_frame_len >= headers );
   RTT_TEST( opts->pong_frame_len >= headers );
   sep->ping_len = opts->ping_frame_len - headers;
@@ -156,7 +157,8 @@ int rtt_tcp_build_endpoint(struct rtt_endpoint** ep_out,
                            const struct rtt_options* opts, unsigned dirs,
                            const char** args, int n_args)
 {
-  return socket_build_endpoint(ep_out, opts, args, n_args, SOCK_STREAM);
+  return socket_build_endpoint(ep_out, opts, args, n_args,
+                               AF_INET, SOCK_STREAM);
 }
 
 
@@ -164,5 +166,24 @@ int rtt_udp_build_endpoint(struct rtt_endpoint** ep_out,
                            const struct rtt_options* opts, unsigned dirs,
                            const char** args, int n_args)
 {
-  return socket_build_endpoint(ep_out, opts, args, n_args, SOCK_DGRAM);
+  return socket_build_endpoint(ep_out, opts, args, n_args,
+                               AF_INET, SOCK_DGRAM);
+}
+
+
+int rtt_tcp6_build_endpoint(struct rtt_endpoint** ep_out,
+                            const struct rtt_options* opts, unsigned dirs,
+                            const char** args, int n_args)
+{
+  return socket_build_endpoint(ep_out, opts, args, n_args,
+                               AF_INET6, SOCK_STREAM);
+}
+
+
+int rtt_udp6_build_endpoint(struct rtt_endpoint** ep_out,
+                            const struct rtt_options* opts, unsigned dirs,
+                            const char** args, int n_args)
+{
+  return socket_build_endpoint(ep_out, opts, args, n_args,
+                               AF_INET6, SOCK_DGRAM);
 }
@@ -38,6 +38,7 @@ static bool        cfg_hw_ts = true;
 static int         cfg_send_rate = 100000;
 static int         cfg_iter;
 static int         cfg_warm_n;
+static const char* cfg_json;
 
 
 struct server_state {
@@ -58,6 +59,7 @@ struct server_state {
   uint64_t rtt_sum;
   unsigned rtt_min, rtt_max;
   int      rtt_n;
+  unsigned* rtt_samples;
   unsigned n_lost_msgs;
 };
 
@@ -192,6 +194,89 @@ static void wait_for_client(struct server_state* ss)
   ss->rtt_min = -1;
   ss->rtt_max = 0;
   ss->rtt_n = -cfg_warm_n;
+  TEST( ss->rtt_samples = malloc(cfg_iter * sizeof(ss->rtt_samples[0])) );
+}
+
+
+static int cmp_unsigned(const void* pa, const void* pb)
+{
+  unsigned a = *(const unsigned*) pa, b = *(const unsigned*) pb;
+  return (a > b) - (a < b);
+}
+
+
+/* Percentile [pct] of the sorted samples, by the nearest-rank method. */
+static unsigned rtt_percentile(const struct server_state* ss, double pct)
+{
+  double r = pct / 100.0 * ss->rtt_n;
+  int rank = (int) r;
+  if( rank < r )
+    ++rank;
+  if( rank < 1 )
+    rank = 1;
+  return ss->rtt_samples[rank - 1];
+}
+
+
+static const struct {
+  const char* name;
+  double      pct;
+} percentiles[] = {
+  { "p50", 50.0 }, { "p90", 90.0 }, { "p99", 99.0 },
+  { "p99_9", 99.9 }, { "p99_99", 99.99 },
+};
+#define N_PERCENTILES  (sizeof(percentiles) / sizeof(percentiles[0]))
+
+
+static void write_json(const struct server_state* ss)
+{
+  FILE* f;
+  int i;
+
+  if( (f = fopen(cfg_json, "w")) == NULL ) {
+    fprintf(stderr, "ERROR: could not open %s: %s\n", cfg_json,
+            strerror(errno));
+    exit(7);
+  }
+  fprintf(f, "{\n  \"config\": {\n");
+  fprintf(f, "    \"send_rate\": %d,\n", cfg_send_rate);
+  fprintf(f, "    \"measure_nth\": %d,\n", cfg_measure_nth);
+  fprintf(f, "    \"md_msg_size\": %d,\n", ss->tx_msg_size);
+  fprintf(f, "    \"order_msg_size\": %d,\n", ss->rx_msg_size);
+  fprintf(f, "    \"hw_timestamps\": %s\n", cfg_hw_ts ? "true" : "false");
+  fprintf(f, "  },\n  \"results\": {\n");
+  fprintf(f, "    \"n_lost_msgs\": %u,\n", ss->n_lost_msgs);
+  fprintf(f, "    \"n_samples\": %d,\n", ss->rtt_n);
+  fprintf(f, "    \"latency_mean\": %u,\n",
+          (unsigned) (ss->rtt_sum / ss->rtt_n));
+  fprintf(f, "    \"latency_min\": %u,\n", ss->rtt_min);
+  for( i = 0; i < N_PERCENTILES; ++i )
+    fprintf(f, "    \"latency_%s\": %u,\n", percentiles[i].name,
+            rtt_percentile(ss, percentiles[i].pct));
+  fprintf(f, "    \"latency_max\": %u\n", ss->rtt_max);
+  fprintf(f, "  }\n}\n");
+  TRY( fclose(f) );
+}
+
+
+static void report(struct server_state* ss)
+{
+  int i;
+
+  qsort(ss->rtt_samples, ss->rtt_n, sizeof(ss->rtt_samples[0]), cmp_unsigned);
+  ss->rtt_min = ss->rtt_samples[0];
+  ss->rtt_max = ss->rtt_samples[ss->rtt_n - 1];
+  printf("n_lost_msgs:  %u\n", ss->n_lost_msgs);
+  printf("n_samples:    %d\n", ss->rtt_n);
+  printf("latency_mean: %u\n", (unsigned) (ss->rtt_sum / ss->rtt_n));
+  printf("latency_min:  %u\n", ss->rtt_min);
+  for( i = 0; i < N_PERCENTILES; ++i )
+    printf("latency_%s:%*s%u\n", percentiles[i].name,
+           (int) (6 - strlen(percentiles[i].name)), "",
+           rtt_percentile(ss, percentiles[i].pct));
+  printf("latency_max:  %u\n", ss->rtt_max);
+  if( cfg_json != NULL )
+    write_json(ss);
 }
 
 
@@ -203,17 +288,14 @@ static void measured_rtt(struct server_state* ss, struct timespec tx_ts,
   ns += rx_ts.tv_nsec - tx_ts.tv_nsec;
   msg(2, "rtt: %d\n", (int) ns);
   if( ++(ss->rtt_n) > 0 ) {
+    ss->rtt_samples[ss->rtt_n - 1] = ns;
     ss->rtt_sum += ns;
     if( ns <= ss->rtt_min )
       ss->rtt_min = ns;
     else if( ns >= ss->rtt_max )
       ss->rtt_max = ns;
     if( ss->rtt_n == cfg_iter ) {
-      printf("n_lost_msgs:  %u\n", ss->n_lost_msgs);
-      printf("n_samples:    %d\n", ss->rtt_n);
-      printf("latency_mean: %u\n", (unsigned) (ss->rtt_sum / ss->rtt_n));
-      printf("latency_min:  %u\n", ss->rtt_min);
-      printf("latency_max:  %u\n", ss->rtt_max);
+      report(ss);
       exit(0);
     }
   }
@@ -376,10 +458,11 @@ static void usage_msg(FILE* f)
   fprintf(f, "  -r <send-rate>    - set UDP message send rate\n");
   fprintf(f, "  -n <n>            - measure latency for 1-in-n sends\n");
   fprintf(f, "  -i <num-iter>     - number of samples to measure\n");
-  fprintf(f, "  -n <num-warmups>  - number of warmup samples\n");
+  fprintf(f, "  -w <num-warmups>  - number of warmup samples\n");
   fprintf(f, "  -s                - use software timestamps\n");
   fprintf(f, "  -l <log-level>    - set log level\n");
   fprintf(f, "  -p <port>         - set TCP/UDP port number\n");
+  fprintf(f, "  -j <file>         - also write results to <file> as JSON\n");
   fprintf(f, "\n");
 }
 
@@ -395,7 +478,7 @@ int main(int argc, char* argv[])
 {
   int c;
 
-  while( (c = getopt(argc, argv, "hr:n:i:w:sl:p:")) != -1 )
+  while( (c = getopt(argc, argv, "hr:n:i:w:sl:p:j:")) != -1 )
     switch( c ) {
     case 'h':
       usage_msg(stdout);
@@ -422,6 +505,9 @@ int main(int argc, char* argv[])
     case 'p':
       cfg_port = optarg;
       break;
+    case 'j':
+      cfg_json = optarg;
+      break;
     case '?':
       usage_err();
       break;
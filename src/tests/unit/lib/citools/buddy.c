@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Functions under test */
+#include <ci/tools.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_perf.h"
+
+#define ORDER       16
+#define SIZE        (1u << ORDER)
+#define MAX_ALLOCS  4096
+#define N_OPS       (1 << 20)
+
+struct alloc {
+  int addr;
+  unsigned order;
+};
+
+static ci_uint8 owner[SIZE];
+
+
+/* Allocate and free blocks of random sizes, checking that no two live
+ * blocks overlap and that everything merges back into one block. */
+static void test_buddy_random(void)
+{
+  ci_buddy_allocator b;
+  struct alloc* allocs = calloc(MAX_ALLOCS, sizeof(*allocs));
+  int n = 0, i, j, overlaps = 0;
+
+  CHECK(ci_buddy_ctor2(&b, ORDER, malloc, free), ==, 0);
+  memset(owner, 0, sizeof(owner));
+  srand(1);
+
+  for( i = 0; i < 100000; ++i ) {
+    if( n < MAX_ALLOCS && (n == 0 || rand() % 3 != 0) ) {
+      unsigned order = rand() % 6;
+      int addr = ci_buddy_alloc(&b, order);
+      if( addr < 0 )
+        continue;
+      CHECK(addr & ((1 << order) - 1), ==, 0);
+      for( j = 0; j < (1 << order); ++j )
+        overlaps += owner[addr + j]++ != 0;
+      allocs[n].addr = addr;
+      allocs[n++].order = order;
+    }
+    else {
+      struct alloc* a = &allocs[rand() % n];
+      for( j = 0; j < (1 << a->order); ++j )
+        --owner[a->addr + j];
+      ci_buddy_free(&b, a->addr, a->order);
+      *a = allocs[--n];
+    }
+  }
+  CHECK(overlaps, ==, 0);
+
+  while( n > 0 ) {
+    --n;
+    ci_buddy_free(&b, allocs[n].addr, allocs[n].order);
+  }
+  CHECK(ci_buddy_alloc(&b, ORDER), ==, 0);
+  ci_buddy_free(&b, 0, ORDER);
+
+  ci_buddy_dtor2(&b, free);
+  free(allocs);
+}
+
+
+/* Time alloc/free pairs: with a single block to split and merge each time,
+ * and with a fragmented allocator where most requests are satisfied from a
+ * free list directly. */
+static void test_buddy_perf(void)
+{
+  ci_buddy_allocator b;
+  struct ut_perf perf;
+  int addrs[MAX_ALLOCS];
+  int i;
+
+  CHECK(ci_buddy_ctor2(&b, ORDER, malloc, free), ==, 0);
+
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_OPS; ++i )
+    ci_buddy_free(&b, ci_buddy_alloc(&b, 0), 0);
+  UT_PERF_END(&perf, "buddy alloc+free (split/merge)", N_OPS);
+
+  for( i = 0; i < MAX_ALLOCS; ++i )
+    addrs[i] = ci_buddy_alloc(&b, 0);
+  for( i = 0; i < MAX_ALLOCS; i += 2 )
+    ci_buddy_free(&b, addrs[i], 0);
+
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_OPS; ++i )
+    ci_buddy_free(&b, ci_buddy_alloc(&b, 0), 0);
+  UT_PERF_END(&perf, "buddy alloc+free (fragmented)", N_OPS);
+
+  for( i = 1; i < MAX_ALLOCS; i += 2 )
+    ci_buddy_free(&b, addrs[i], 0);
+  CHECK(ci_buddy_alloc(&b, ORDER), ==, 0);
+  ci_buddy_free(&b, 0, ORDER);
+
+  ci_buddy_dtor2(&b, free);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_buddy_random);
+  TEST_RUN(test_buddy_perf);
+  TEST_END();
+}
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Functions under test */
+#include <ci/tools.h>
+#include <ci/tools/crc32c.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define MAX_LEN  5000
+#define MAX_ALIGN  16
+
+static ci_uint8 src_buf[MAX_LEN + MAX_ALIGN];
+static ci_uint8 dst_buf[MAX_LEN + MAX_ALIGN];
+static ci_uint8 ref_buf[MAX_LEN + MAX_ALIGN];
+
+static void fill_random(void)
+{
+  int i;
+  srand(1);
+  for( i = 0; i < sizeof(src_buf); ++i )
+    src_buf[i] = rand();
+}
+
+static int next_len(int len)
+{
+  return len < 64 ? len + 1 : len + 61;
+}
+
+/* Check values from RFC 3720 B.4 and the usual "123456789". */
+static void test_known_values(void)
+{
+  ci_uint8 buf[32];
+  int i;
+
+  CHECK(ci_crc32c((const ci_uint8*) "123456789", 9), ==, 0xe3069283);
+
+  memset(buf, 0, sizeof(buf));
+  CHECK(ci_crc32c(buf, sizeof(buf)), ==, 0x8a9136aa);
+  memset(buf, 0xff, sizeof(buf));
+  CHECK(ci_crc32c(buf, sizeof(buf)), ==, 0x62a8ab43);
+  for( i = 0; i < sizeof(buf); ++i )
+    buf[i] = i;
+  CHECK(ci_crc32c(buf, sizeof(buf)), ==, 0x46dd794e);
+}
+
+static void test_partial(void)
+{
+  int align, len;
+
+  for( align = 0; align < MAX_ALIGN; ++align )
+    for( len = 0; len <= MAX_LEN; len = next_len(len) )
+      CHECK(ci_crc32c_partial(src_buf + align, len, 0x12345678), ==,
+            ci_crc32c_partial_c(src_buf + align, len, 0x12345678));
+}
+
+static void test_partial_copy(void)
+{
+  int src_align, dst_align, len;
+  ci_uint32 crc, ref_crc;
+
+  for( src_align = 0; src_align < MAX_ALIGN; src_align += 3 )
+    for( dst_align = 0; dst_align < MAX_ALIGN; dst_align += 5 )
+      for( len = 0; len <= MAX_LEN; len = next_len(len) ) {
+        memset(dst_buf, 0xaa, sizeof(dst_buf));
+        memset(ref_buf, 0xaa, sizeof(ref_buf));
+        crc = ci_crc32c_partial_copy(dst_buf + dst_align,
+                                     src_buf + src_align, len, 0xffffffff);
+        ref_crc = ci_crc32c_partial_copy_c(ref_buf + dst_align,
+                                           src_buf + src_align, len,
+                                           0xffffffff);
+        CHECK(crc, ==, ref_crc);
+        CHECK_MEM(dst_buf, ref_buf, sizeof(dst_buf));
+      }
+}
+
+/* A CRC accumulated over several calls must match one over the whole. */
+static void test_split(void)
+{
+  ci_uint32 crc;
+  int split;
+
+  for( split = 0; split <= MAX_LEN; split = next_len(split) ) {
+    crc = ci_crc32c_partial(src_buf, split, 0xffffffff);
+    crc = ci_crc32c_partial(src_buf + split, MAX_LEN - split, crc);
+    CHECK(crc, ==, ci_crc32c_partial_c(src_buf, MAX_LEN, 0xffffffff));
+  }
+}
+
+int main(void)
+{
+  fill_random();
+  printf("SSE4.2 CRC32C %s\n", ci_crc32c_sse42_ok() ? "enabled" : "disabled");
+  TEST_RUN(test_known_values);
+  TEST_RUN(test_partial);
+  TEST_RUN(test_partial_copy);
+  TEST_RUN(test_split);
+  TEST_END();
+}
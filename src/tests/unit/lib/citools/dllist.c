@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Functions under test */
+#include <ci/tools.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_perf.h"
+
+#define N_LINKS  (1 << 16)
+#define N_OPS    (1 << 22)
+
+struct item {
+  ci_dllink link;
+  int id;
+  char pad[64 - sizeof(ci_dllink) - sizeof(int)];
+};
+
+
+static void test_dllist_ops(void)
+{
+  struct item items[8];
+  ci_dllist list, other;
+  ci_dllink* l;
+  int i;
+
+  ci_dllist_init(&list);
+  ci_dllist_init(&other);
+  CHECK_TRUE(ci_dllist_is_empty(&list));
+  for( i = 0; i < 8; ++i ) {
+    items[i].id = i;
+    if( i & 1 )
+      ci_dllist_push_tail(&list, &items[i].link);
+    else
+      ci_dllist_push(&list, &items[i].link);
+  }
+  CHECK(ci_dllist_count(&list), ==, 8);
+
+  /* Pushed at the head: 6 4 2 0, then at the tail: 1 3 5 7 */
+  i = 0;
+  CI_DLLIST_FOR_EACH(l, &list) {
+    static const int order[] = { 6, 4, 2, 0, 1, 3, 5, 7 };
+    CHECK(CI_CONTAINER(struct item, link, l)->id, ==, order[i++]);
+  }
+
+  ci_dllist_remove(&items[0].link);
+  CHECK_FALSE(ci_dllist_is_member(&list, &items[0].link));
+  CHECK(CI_CONTAINER(struct item, link, ci_dllist_pop(&list))->id, ==, 6);
+  CHECK(CI_CONTAINER(struct item, link, ci_dllist_pop_tail(&list))->id, ==, 7);
+
+  ci_dllist_rehome(&other, &list);
+  CHECK_TRUE(ci_dllist_is_empty(&list));
+  CHECK(ci_dllist_count(&other), ==, 5);
+  ci_dllist_join(&list, &other);
+  CHECK(ci_dllist_count(&list), ==, 5);
+  while( ci_dllist_try_pop(&list) != NULL )
+    ;
+  CHECK_TRUE(ci_dllist_is_empty(&list));
+}
+
+
+/* A FIFO cycling through links in array order, and in a random order as
+ * the free lists of a long-running allocator end up. */
+static void test_dllist_perf(void)
+{
+  struct item* items = calloc(N_LINKS, sizeof(*items));
+  int* perm = calloc(N_LINKS, sizeof(*perm));
+  struct ut_perf perf;
+  ci_dllist list;
+  int i;
+
+  for( i = 0; i < N_LINKS; ++i )
+    perm[i] = i;
+  srand(1);
+  for( i = N_LINKS - 1; i > 0; --i ) {
+    int j = rand() % (i + 1), t = perm[i];
+    perm[i] = perm[j];
+    perm[j] = t;
+  }
+
+  ci_dllist_init(&list);
+  for( i = 0; i < N_LINKS; ++i )
+    ci_dllist_push_tail(&list, &items[i].link);
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_OPS; ++i )
+    ci_dllist_push_tail(&list, ci_dllist_pop(&list));
+  UT_PERF_END(&perf, "dllist pop+push_tail (sequential)", N_OPS);
+  CHECK(ci_dllist_count(&list), ==, N_LINKS);
+
+  ci_dllist_init(&list);
+  for( i = 0; i < N_LINKS; ++i )
+    ci_dllist_push_tail(&list, &items[perm[i]].link);
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_OPS; ++i )
+    ci_dllist_push_tail(&list, ci_dllist_pop(&list));
+  UT_PERF_END(&perf, "dllist pop+push_tail (random)", N_OPS);
+  CHECK(ci_dllist_count(&list), ==, N_LINKS);
+
+  free(perm);
+  free(items);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_dllist_ops);
+  TEST_RUN(test_dllist_perf);
+  TEST_END();
+}
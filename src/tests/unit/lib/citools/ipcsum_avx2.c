@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Functions under test */
+#include <ci/tools.h>
+#include <ci/tools/ipcsum_base.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define MAX_LEN  1600
+#define MAX_ALIGN  64
+
+static char src_buf[MAX_LEN + MAX_ALIGN];
+static char dst_buf[MAX_LEN + MAX_ALIGN];
+static char ref_buf[MAX_LEN + MAX_ALIGN];
+
+static void fill_random(void)
+{
+  int i;
+  srand(1);
+  for( i = 0; i < sizeof(src_buf); ++i )
+    src_buf[i] = rand();
+}
+
+/* Lengths around the vector width, the dispatch threshold and packet
+ * sizes. */
+static int next_len(int len)
+{
+  return len < 256 ? len + 1 : len + 37;
+}
+
+static void test_csum_partial(void)
+{
+  int align, len;
+
+  for( align = 0; align < MAX_ALIGN; ++align )
+    for( len = 0; len <= MAX_LEN; len = next_len(len) )
+      CHECK(ci_ip_hdr_csum_finish(
+                ci_ip_csum_partial(0x1234, src_buf + align, len)), ==,
+            ci_ip_hdr_csum_finish(
+                ci_ip_csum_partial_c(0x1234, src_buf + align, len)));
+}
+
+static void test_csum_copy2(void)
+{
+  int src_align, dst_align, len;
+  unsigned sum, ref_sum;
+
+  for( src_align = 0; src_align < MAX_ALIGN; src_align += 3 )
+    for( dst_align = 0; dst_align < MAX_ALIGN; dst_align += 5 )
+      for( len = 0; len <= MAX_LEN; len = next_len(len) + 1 ) {
+        len &= ~1;
+        memset(dst_buf, 0xaa, sizeof(dst_buf));
+        memset(ref_buf, 0xaa, sizeof(ref_buf));
+        sum = ci_ip_csum_copy2(dst_buf + dst_align, src_buf + src_align,
+                               len, 0x1234);
+        ref_sum = ci_ip_csum_copy2_c(ref_buf + dst_align,
+                                     src_buf + src_align, len, 0x1234);
+        CHECK(ci_ip_hdr_csum_finish(sum), ==,
+              ci_ip_hdr_csum_finish(ref_sum));
+        CHECK_MEM(dst_buf, ref_buf, sizeof(dst_buf));
+      }
+}
+
+/* A block of 0xff words is the worst case for the vector accumulators. */
+static void test_csum_partial_large(void)
+{
+  static char big[4 << 20];
+  int len;
+
+  memset(big, 0xff, sizeof(big));
+  for( len = 1 << 16; len <= sizeof(big); len <<= 1 )
+    CHECK(ci_ip_hdr_csum_finish(ci_ip_csum_partial(0, big, len)), ==, 0);
+}
+
+int main(void)
+{
+  fill_random();
+  printf("AVX2 checksums %s\n", ci_ip_csum_avx2_ok() ? "enabled" : "disabled");
+  TEST_RUN(test_csum_partial);
+  TEST_RUN(test_csum_copy2);
+  TEST_RUN(test_csum_partial_large);
+  TEST_END();
+}
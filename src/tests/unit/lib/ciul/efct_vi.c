@@ -774,6 +774,110 @@ static void test_efct_forced_rollover_all(void)
 }
 
 
+static void test_efct_rx_match(void)
+{
+  static const uint8_t mask_bytes[8] = { 0xff, 0xff };
+  static const uint8_t value_bytes[8] = { 0x88, 0xb5 };
+  struct efct_vi_rx_match match = { .offset = 12 };
+  struct efct_vi_rxq_stats stats;
+  ef_event evs[16];
+  char* pkt;
+  int i;
+  struct efct_test* t = efct_test_init_rx(1);
+
+  efct_test_attach(t, 0);
+
+  memcpy(&match.mask, mask_bytes, sizeof(match.mask));
+  memcpy(&match.value, value_bytes, sizeof(match.value));
+  CHECK(efct_vi_rx_set_match(t->vi, &match, EFCT_VI_RX_MATCH_MAX_TERMS + 1),
+        ==, -EINVAL);
+  CHECK(efct_vi_rx_set_match(t->vi, &match, 1), ==, 0);
+
+  /* Only the odd packets pass the match */
+  for( i = 0; i < 4; ++i ) {
+    pkt = t->mock_rxqs.q[0].next_pkt + i * EFCT_PKT_STRIDE;
+    if( i & 1 )
+      memcpy(pkt + 12, value_bytes, 2);
+    efct_test_rx_meta(t, 0);
+  }
+  CHECK(efct_ef_eventq_check_event(t->vi), ==, 1);
+  CHECK(ef_eventq_poll(t->vi, evs, 16), ==, 2);
+  for( i = 0; i < 2; ++i ) {
+    CHECK((int)evs[i].rx_ref.type, ==, EF_EVENT_TYPE_RX_REF);
+    CHECK(efct_vi_rxpkt_get(t->vi, evs[i].rx_ref.pkt_id), ==,
+          t->mock_rxqs.q[0].next_pkt + (2 * i + 1) * EFCT_PKT_STRIDE);
+    efct_vi_rxpkt_release(t->vi, evs[i].rx_ref.pkt_id);
+  }
+  t->mock_rxqs.q[0].next_pkt += 4 * EFCT_PKT_STRIDE;
+
+  CHECK(efct_vi_rxq_get_stats(t->vi, EF_VI_MAX_EFCT_RXQS, &stats), ==, -EINVAL);
+  CHECK(efct_vi_rxq_get_stats(t->vi, 0, &stats), ==, 0);
+  CHECK(stats.sw_filtered, ==, 2);
+  CHECK(stats.sbseq_gaps, ==, 0);
+
+  /* Without the match, everything is delivered */
+  CHECK(efct_vi_rx_set_match(t->vi, NULL, 0), ==, 0);
+  for( i = 0; i < 2; ++i )
+    efct_test_rx_meta(t, 0);
+  efct_test_rx_poll(t, 0, 2, 16);
+
+  efct_test_cleanup(t);
+}
+
+static void test_efct_rx_peek(void)
+{
+  struct efct_vi_rx_peek_pkt pkts[16];
+  int i;
+  struct efct_test* t = efct_test_init_rx(1);
+
+  efct_test_attach(t, 0);
+  CHECK(efct_vi_rx_peek(t->vi, pkts, 16), ==, 0);
+
+  for( i = 0; i < 3; ++i )
+    efct_test_rx_meta(t, 0);
+
+  /* Peeking doesn't consume anything, however many times it's done */
+  CHECK(efct_vi_rx_peek(t->vi, pkts, 2), ==, 2);
+  CHECK(efct_vi_rx_peek(t->vi, pkts, 16), ==, 3);
+  for( i = 0; i < 3; ++i ) {
+    CHECK(pkts[i].data, ==, t->mock_rxqs.q[0].next_pkt + i * EFCT_PKT_STRIDE);
+    CHECK((int)pkts[i].len, ==, rx_len);
+    CHECK((int)pkts[i].discard_flags, ==, 0);
+  }
+  STATE_CHECK(t->mock_ops, anything_called, 0);
+
+  efct_test_rx_poll(t, 0, 3, 16);
+  CHECK(efct_vi_rx_peek(t->vi, pkts, 16), ==, 0);
+
+  efct_test_cleanup(t);
+}
+
+static void test_efct_rx_round_robin(void)
+{
+  ef_event evs[16];
+  int i;
+  struct efct_test* t = efct_test_init_rx(2);
+
+  efct_test_attach(t, 0);
+  efct_test_attach(t, 1);
+
+  /* Queue 0 fills the first poll, so the next one starts at queue 1 */
+  for( i = 0; i < 4; ++i )
+    efct_test_rx_meta(t, 0);
+  efct_test_rx_meta(t, 1);
+  efct_test_rx_poll(t, 0, 4, 4);
+
+  efct_test_rx_meta(t, 0);
+  CHECK(ef_eventq_poll(t->vi, evs, 16), ==, 2);
+  efct_test_check_rx_event(t, 1, &evs[0]);
+  efct_test_check_rx_event(t, 0, &evs[1]);
+  t->mock_rxqs.q[1].next_pkt += EFCT_PKT_STRIDE;
+  t->mock_rxqs.q[0].next_pkt += EFCT_PKT_STRIDE;
+  for( i = 0; i < 2; ++i )
+    efct_vi_rxpkt_release(t->vi, evs[i].rx_ref.pkt_id);
+
+  efct_test_cleanup(t);
+}
 
 int main(void)
 {
@@ -786,5 +890,8 @@ int main(void)
   TEST_RUN(test_efct_forced_rollover_none);
   TEST_RUN(test_efct_forced_rollover_some);
   TEST_RUN(test_efct_forced_rollover_all);
+  TEST_RUN(test_efct_rx_match);
+  TEST_RUN(test_efct_rx_peek);
+  TEST_RUN(test_efct_rx_round_robin);
   TEST_END();
 }
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <string.h>
+
+/* Functions under test */
+#include <etherfabric/pkt_pool.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define N_BUFS    64
+#define BUF_SIZE  2048
+
+/* An RXQ with room for rxq_space descriptors, recording what it is given */
+static ef_vi_state state;
+static int rxq_space;
+static int n_bursts;
+static ef_addr last_addr;
+
+static int fake_receive_post_burst(ef_vi* vi, const ef_addr* addrs,
+                                   const ef_request_id* dma_ids, int n)
+{
+  if( n > rxq_space )
+    n = rxq_space;
+  rxq_space -= n;
+  vi->ep_state->rxq.added += n;
+  ++n_bursts;
+  if( n )
+    last_addr = addrs[n - 1];
+  return n;
+}
+
+static void init_fake_vi(ef_vi* vi)
+{
+  memset(vi, 0, sizeof(*vi));
+  memset(&state, 0, sizeof(state));
+  vi->ep_state = &state;
+  vi->ops.receive_post_burst = fake_receive_post_burst;
+  rxq_space = 1000;
+  n_bursts = 0;
+}
+
+/* One NIC page per entry, with DMA addresses that are easy to check */
+static ef_addr dma_addrs[N_BUFS * BUF_SIZE / EF_VI_NIC_PAGE_SIZE];
+static ef_memreg mr = { dma_addrs, dma_addrs };
+static char mem[N_BUFS * BUF_SIZE];
+static uint32_t free_ids[N_BUFS];
+
+static void init_mr(void)
+{
+  unsigned i;
+  for( i = 0; i < sizeof(dma_addrs) / sizeof(dma_addrs[0]); ++i )
+    dma_addrs[i] = 0x100000 * (i + 1);
+}
+
+static void test_init_get_put(void)
+{
+  ef_pkt_pool pool;
+  int id, i;
+
+  init_mr();
+  CHECK(ef_pkt_pool_init(&pool, &mr, mem, 0, 3000, N_BUFS, free_ids),
+        ==, -EINVAL);
+  CHECK(ef_pkt_pool_init(&pool, &mr, mem, 100, BUF_SIZE, N_BUFS, free_ids),
+        ==, -EINVAL);
+  CHECK(ef_pkt_pool_init(&pool, &mr, mem, 0, BUF_SIZE, N_BUFS, free_ids),
+        ==, 0);
+  CHECK(ef_pkt_pool_n_free(&pool), ==, N_BUFS);
+
+  /* Buffers are first handed out in address order */
+  CHECK(ef_pkt_pool_get(&pool), ==, 0);
+  CHECK(ef_pkt_pool_get(&pool), ==, 1);
+  id = ef_pkt_pool_get(&pool);
+  CHECK(id, ==, 2);
+  CHECK(ef_pkt_pool_ptr(&pool, id), ==, mem + 2 * BUF_SIZE);
+  CHECK(ef_pkt_pool_dma_addr(&pool, id), ==, 0x200000);
+  CHECK(ef_pkt_pool_dma_addr(&pool, 3), ==, 0x200000 + BUF_SIZE);
+
+  /* The most recently freed buffer is reused first */
+  ef_pkt_pool_put(&pool, 1);
+  CHECK(ef_pkt_pool_get(&pool), ==, 1);
+
+  for( i = 3; i < N_BUFS; ++i )
+    ef_pkt_pool_get(&pool);
+  CHECK(ef_pkt_pool_n_free(&pool), ==, 0);
+  CHECK(ef_pkt_pool_get(&pool), ==, -ENOBUFS);
+}
+
+static void test_refill_rx(void)
+{
+  ef_pkt_pool pool;
+  ef_vi vi;
+
+  init_mr();
+  init_fake_vi(&vi);
+  ef_pkt_pool_init(&pool, &mr, mem, 0, BUF_SIZE, N_BUFS, free_ids);
+
+  /* Not enough room for a batch */
+  CHECK(ef_pkt_pool_refill_rx(&pool, &vi, 64, EF_PKT_POOL_REFILL_BATCH - 1),
+        ==, 0);
+  CHECK(n_bursts, ==, 0);
+
+  /* Fills in whole batches up to the target */
+  CHECK(ef_pkt_pool_refill_rx(&pool, &vi, 64, 40), ==, 32);
+  CHECK(n_bursts, ==, 2);
+  CHECK(last_addr, ==, ef_pkt_pool_dma_addr(&pool, 31) + 64);
+  CHECK(ef_pkt_pool_n_free(&pool), ==, N_BUFS - 32);
+
+  /* Buffers that do not fit in the ring go back to the pool */
+  rxq_space = 4;
+  CHECK(ef_pkt_pool_refill_rx(&pool, &vi, 64, 100), ==, 4);
+  CHECK(ef_pkt_pool_n_free(&pool), ==, N_BUFS - 36);
+  CHECK(ef_pkt_pool_get(&pool), ==, 36);
+}
+
+int main(void)
+{
+  TEST_RUN(test_init_get_put);
+  TEST_RUN(test_refill_rx);
+  TEST_END();
+}
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Functions under test */
+#include <etherfabric/shm_ring.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define N_BUFS    8
+#define BUF_SIZE  256
+
+static void* alloc_ring(size_t* bytes)
+{
+  void* mem = NULL;
+  *bytes = ef_shm_ring_bytes(N_BUFS, BUF_SIZE);
+  if( posix_memalign(&mem, EF_SHM_RING_ALIGN, *bytes) != 0 )
+    abort();
+  memset(mem, 0xff, *bytes);
+  return mem;
+}
+
+static void write_pkt(ef_shm_ring* ring, uint64_t seq)
+{
+  ef_shm_ring_buf* buf = ef_shm_ring_write_begin(ring, seq);
+  buf->len = (int32_t) seq;
+  buf->flags = EF_SHM_RING_BUF_GOOD;
+  ef_shm_ring_write_end(ring, buf);
+}
+
+static void test_init_attach(void)
+{
+  size_t bytes;
+  void* mem = alloc_ring(&bytes);
+  ef_shm_ring* ring;
+
+  CHECK(bytes % EF_SHM_RING_ALIGN, ==, 0);
+  CHECK(ef_shm_ring_attach(&ring, mem, bytes), ==, -EINVAL);
+  CHECK(ef_shm_ring_init(mem, bytes, N_BUFS + 1, BUF_SIZE), ==, -EINVAL);
+  CHECK(ef_shm_ring_init(mem, bytes, N_BUFS, 8), ==, -EINVAL);
+  CHECK(ef_shm_ring_init(mem, bytes - 1, N_BUFS, BUF_SIZE), ==, -EINVAL);
+  CHECK(ef_shm_ring_init((char*) mem + 8, bytes, N_BUFS, BUF_SIZE),
+        ==, -EINVAL);
+
+  CHECK(ef_shm_ring_init(mem, bytes, N_BUFS, BUF_SIZE), ==, 0);
+  CHECK(ef_shm_ring_attach(&ring, mem, bytes - 1), ==, -EINVAL);
+  CHECK(ef_shm_ring_attach(&ring, mem, bytes), ==, 0);
+  CHECK(ring, ==, (ef_shm_ring*) mem);
+  CHECK(ef_shm_ring_head(ring), ==, 0);
+  CHECK(ef_shm_ring_buf_offset(ring, 0) % EF_SHM_RING_ALIGN, ==, 0);
+  CHECK(ef_shm_ring_buf_offset(ring, N_BUFS), ==,
+        ef_shm_ring_buf_offset(ring, 0));
+  free(mem);
+}
+
+static void test_read_write(void)
+{
+  size_t bytes;
+  void* mem = alloc_ring(&bytes);
+  ef_shm_ring* ring = mem;
+  ef_shm_ring_buf* buf;
+  uint64_t gen, seq;
+
+  CHECK(ef_shm_ring_init(mem, bytes, N_BUFS, BUF_SIZE), ==, 0);
+  CHECK(ef_shm_ring_read_begin(ring, 0, &buf, &gen), ==, -EAGAIN);
+
+  /* A buffer being written is not yet visible */
+  buf = ef_shm_ring_write_begin(ring, 0);
+  CHECK(ef_shm_ring_read_begin(ring, 0, &buf, &gen), ==, -EAGAIN);
+  ef_shm_ring_write_end(ring, buf);
+
+  for( seq = 1; seq < N_BUFS + 2; ++seq )
+    write_pkt(ring, seq);
+  CHECK(ef_shm_ring_lag(ring, 0), ==, N_BUFS + 2);
+
+  /* The first two buffers have been overwritten */
+  CHECK(ef_shm_ring_read_begin(ring, 0, &buf, &gen), ==, -ENOBUFS);
+  CHECK(ef_shm_ring_read_begin(ring, 1, &buf, &gen), ==, -ENOBUFS);
+
+  for( seq = 2; seq < N_BUFS + 2; ++seq ) {
+    CHECK(ef_shm_ring_read_begin(ring, seq, &buf, &gen), ==, 0);
+    CHECK(buf->len, ==, (int32_t) seq);
+    CHECK_TRUE(ef_shm_ring_read_valid(buf, gen));
+  }
+  CHECK(ef_shm_ring_read_begin(ring, seq, &buf, &gen), ==, -EAGAIN);
+
+  /* A read overlapping a rewrite of its buffer is rejected */
+  CHECK(ef_shm_ring_read_begin(ring, N_BUFS + 1, &buf, &gen), ==, 0);
+  write_pkt(ring, N_BUFS + 2);
+  CHECK_TRUE(ef_shm_ring_read_valid(buf, gen));
+  for( seq = N_BUFS + 3; seq <= 2 * N_BUFS + 1; ++seq )
+    write_pkt(ring, seq);
+  CHECK_FALSE(ef_shm_ring_read_valid(buf, gen));
+  free(mem);
+}
+
+int main(void)
+{
+  TEST_RUN(test_init_attach);
+  TEST_RUN(test_read_write);
+  TEST_END();
+}
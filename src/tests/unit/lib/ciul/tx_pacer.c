@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <string.h>
+
+/* Functions under test */
+#include <etherfabric/tx_pacer.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define N_DESCS  4
+
+/* A TXQ with room for txq_space descriptors, recording what it is given */
+static int txq_space;
+static int n_init, n_push;
+static ef_request_id last_id;
+
+static int fake_transmitv_init(ef_vi* vi, const ef_iovec* iov, int iov_len,
+                               ef_request_id dma_id)
+{
+  if( txq_space == 0 )
+    return -EAGAIN;
+  --txq_space;
+  ++n_init;
+  last_id = dma_id;
+  return 0;
+}
+
+static void fake_transmit_push(ef_vi* vi)
+{
+  ++n_push;
+}
+
+static void init_fake_vi(ef_vi* vi)
+{
+  memset(vi, 0, sizeof(*vi));
+  vi->ops.transmitv_init = fake_transmitv_init;
+  vi->ops.transmit_push = fake_transmit_push;
+  txq_space = 100;
+  n_init = n_push = 0;
+}
+
+static void test_init_queue(void)
+{
+  ef_vi vi;
+  ef_tx_pacer pacer;
+  ef_tx_pacer_desc descs[N_DESCS];
+  int i;
+
+  init_fake_vi(&vi);
+  CHECK(ef_tx_pacer_init(&pacer, &vi, descs, 0), ==, -EINVAL);
+  CHECK(ef_tx_pacer_init(&pacer, &vi, descs, 3), ==, -EINVAL);
+  CHECK(ef_tx_pacer_init(&pacer, &vi, descs, N_DESCS), ==, 0);
+  CHECK(ef_tx_pacer_fill_level(&pacer), ==, 0);
+
+  for( i = 0; i < N_DESCS; ++i )
+    CHECK(ef_tx_pacer_queue(&pacer, 0, 60, i, 100), ==, 0);
+  CHECK(ef_tx_pacer_queue(&pacer, 0, 60, i, 100), ==, -EAGAIN);
+  CHECK(ef_tx_pacer_fill_level(&pacer), ==, N_DESCS);
+}
+
+static void test_release(void)
+{
+  ef_vi vi;
+  ef_tx_pacer pacer;
+  ef_tx_pacer_desc descs[N_DESCS];
+
+  init_fake_vi(&vi);
+  ef_tx_pacer_init(&pacer, &vi, descs, N_DESCS);
+  ef_tx_pacer_queue(&pacer, 0, 60, 1, 100);
+  ef_tx_pacer_queue(&pacer, 0, 60, 2, 200);
+  ef_tx_pacer_queue(&pacer, 0, 60, 3, 150);
+
+  /* Nothing is due yet, so nothing is pushed */
+  CHECK(ef_tx_pacer_release(&pacer, 99), ==, 0);
+  CHECK(n_push, ==, 0);
+
+  CHECK(ef_tx_pacer_release(&pacer, 100), ==, 1);
+  CHECK(last_id, ==, 1);
+  CHECK(n_push, ==, 1);
+
+  /* The third is due but waits for the second, which is queued ahead */
+  CHECK(ef_tx_pacer_release(&pacer, 199), ==, 0);
+  CHECK(ef_tx_pacer_release(&pacer, 200), ==, 2);
+  CHECK(last_id, ==, 3);
+  CHECK(n_push, ==, 2);
+  CHECK(ef_tx_pacer_fill_level(&pacer), ==, 0);
+}
+
+static void test_txq_full(void)
+{
+  ef_vi vi;
+  ef_tx_pacer pacer;
+  ef_tx_pacer_desc descs[N_DESCS];
+
+  init_fake_vi(&vi);
+  ef_tx_pacer_init(&pacer, &vi, descs, N_DESCS);
+  ef_tx_pacer_queue(&pacer, 0, 60, 1, 0);
+  ef_tx_pacer_queue(&pacer, 0, 60, 2, 0);
+
+  /* A transmit that does not fit stays queued for the next release */
+  txq_space = 1;
+  CHECK(ef_tx_pacer_release(&pacer, 0), ==, 1);
+  CHECK(ef_tx_pacer_fill_level(&pacer), ==, 1);
+  CHECK(ef_tx_pacer_release(&pacer, 0), ==, 0);
+  txq_space = 1;
+  CHECK(ef_tx_pacer_release(&pacer, 0), ==, 1);
+  CHECK(last_id, ==, 2);
+  CHECK(n_init, ==, 2);
+}
+
+int main(void)
+{
+  TEST_RUN(test_init_queue);
+  TEST_RUN(test_release);
+  TEST_RUN(test_txq_full);
+  TEST_END();
+}
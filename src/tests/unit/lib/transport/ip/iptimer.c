@@ -0,0 +1,210 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_perf.h"
+
+#define N_TIMERS  3000
+#define N_OPS     (1 << 20)
+
+/* The timers live in aux buffers, after the shared state, as pmtu timers
+ * do in a real stack. */
+struct test_state {
+  ci_netif_state ns;
+  ci_ni_aux_mem aux[N_TIMERS];
+};
+
+static ci_iptime_t expect_time[N_TIMERS];
+static int fired[N_TIMERS];
+static ci_iptime_t last_closest;
+static struct test_state* state;
+
+/* Dependencies */
+void ci_pmtu_timeout_pmtu(ci_netif* ni, ci_pmtu_state_t* pmtu)
+{
+  int i = CI_CONTAINER(ci_ni_aux_mem, u.pmtus, pmtu) - state->aux;
+
+  CHECK(i, >=, 0);
+  CHECK(i, <, N_TIMERS);
+  CHECK(pmtu->tid.time, ==, expect_time[i]);
+  CHECK(pmtu->tid.time, ==, IPTIMER_STATE(ni)->sched_ticks);
+  /* The stack must not have slept past this timer. */
+  CHECK_TRUE(TIME_LE(last_closest, pmtu->tid.time));
+  ++fired[i];
+}
+
+
+static void timer_state_init(ci_netif* ni, ci_iptime_t now)
+{
+  ci_ip_timer_state* ipts = IPTIMER_STATE(ni);
+  int i;
+
+  ipts->sched_ticks = now;
+  ipts->ci_ip_time_real_ticks = now;
+  ipts->closest_timer = now + 2 * CI_IPTIME_BUCKETS;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->fire_list));
+  for( i = 0; i < CI_IPTIME_WHEELSIZE; i++ )
+    oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->warray[i]));
+}
+
+
+static ci_ip_timer* test_timer(ci_netif* ni, int i)
+{
+  return &state->aux[i].u.pmtus.tid;
+}
+
+
+/* Run the wheel a tick at a time with a mixture of sparse timers and a
+ * dense group that all expire together, checking that every timer fires
+ * exactly once, on time.  Returns the largest cascade seen. */
+static ci_uint32 run_wheel(unsigned budget, ci_iptime_t start)
+{
+  STATE_ALLOC(ci_netif, ni);
+  ci_iptime_t now = start, end = start;
+  ci_iptime_t dense = start + 0x30000 - IPTIMER_BUCKETNO(0, start) + 0x10;
+  ci_uint32 cascade_max;
+  int i;
+
+  state = calloc(1, sizeof(*state));
+  ni->state = &state->ns;
+  NI_OPTS(ni).timer_cascade_budget = budget;
+  timer_state_init(ni, start);
+  srandom(1);
+
+  for( i = 0; i < N_TIMERS; ++i ) {
+    oo_p p = oo_state_ptr_to_statep(ni, test_timer(ni, i));
+    ci_ip_timer* t = test_timer(ni, i);
+    ci_iptime_t when;
+
+    t->fn = CI_IP_TIMER_PMTU_DISCOVER;
+    ci_ip_timer_init(ni, t, p, "test");
+    if( i < N_TIMERS / 2 )
+      when = start + 1 + random() % 0x50000;
+    else
+      when = dense;
+    expect_time[i] = when;
+    fired[i] = 0;
+    ci_ip_timer_set(ni, t, when);
+    if( TIME_GT(when, end) )
+      end = when;
+  }
+
+  while( TIME_LE(now, end) ) {
+    ++now;
+    IPTIMER_STATE(ni)->ci_ip_time_real_ticks = now;
+    last_closest = IPTIMER_STATE(ni)->closest_timer;
+    ci_ip_timer_poll(ni);
+
+    /* Shuffle some sparse timers around, including ones that may have
+     * been moved down the wheel ahead of time. */
+    if( (now & 0x3f) == 0 ) {
+      i = random() % (N_TIMERS / 2);
+      if( ci_ip_timer_pending(ni, test_timer(ni, i)) &&
+          TIME_LT(now + 1, end) ) {
+        expect_time[i] = now + 1 + random() % (end - now - 1);
+        ci_ip_timer_modify(ni, test_timer(ni, i), expect_time[i]);
+        last_closest = IPTIMER_STATE(ni)->closest_timer;
+      }
+    }
+#ifndef NDEBUG
+    if( (now & 0xfff) == 0 )
+      ci_ip_timer_state_assert_valid(ni, __FILE__, __LINE__);
+#endif
+  }
+
+  for( i = 0; i < N_TIMERS; ++i ) {
+    CHECK(fired[i], ==, 1);
+    CHECK_FALSE(ci_ip_timer_pending(ni, test_timer(ni, i)));
+  }
+  if( budget == 0 )
+    CHECK(state->ns.stats.timer_cascade_early, ==, 0);
+  else
+    CHECK(state->ns.stats.timer_cascade_early, >, 0);
+
+  cascade_max = state->ns.stats.timer_cascade_max;
+  free(state);
+  free(ni);
+  return cascade_max;
+}
+
+
+static void test_ci_ip_timer_poll(void)
+{
+  ci_uint32 classic, budgeted;
+
+  classic = run_wheel(0, 0x12345);
+  budgeted = run_wheel(64, 0x12345);
+
+  /* The dense group is moved all at once by the classic wheel... */
+  CHECK(classic, >=, N_TIMERS / 2);
+  /* ...but ahead of time, a bit at a time, with a cascade budget. */
+  CHECK(budgeted, <, N_TIMERS / 8);
+
+  /* Wrapping of the 32-bit clock. */
+  run_wheel(0, 0xfffe0000);
+  run_wheel(64, 0xfffe0000);
+}
+
+
+/* Time rescheduling of pending timers, as TCP does on most ACKs, and then
+ * running the wheel until they have all fired. */
+static void test_ci_ip_timer_perf(void)
+{
+  STATE_ALLOC(ci_netif, ni);
+  struct ut_perf perf;
+  ci_iptime_t start = 0x12345, now = start, end = start;
+  int i;
+
+  state = calloc(1, sizeof(*state));
+  ni->state = &state->ns;
+  timer_state_init(ni, start);
+  srandom(2);
+
+  for( i = 0; i < N_TIMERS; ++i ) {
+    ci_ip_timer* t = test_timer(ni, i);
+    t->fn = CI_IP_TIMER_PMTU_DISCOVER;
+    ci_ip_timer_init(ni, t, oo_state_ptr_to_statep(ni, t), "test");
+    expect_time[i] = start + 1 + random() % 0x50000;
+    fired[i] = 0;
+    ci_ip_timer_set(ni, t, expect_time[i]);
+  }
+
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_OPS; ++i ) {
+    int j = i % N_TIMERS;
+    expect_time[j] = start + 1 + (i * 7919u) % 0x50000;
+    ci_ip_timer_modify(ni, test_timer(ni, j), expect_time[j]);
+  }
+  UT_PERF_END(&perf, "ci_ip_timer_modify", N_OPS);
+
+  for( i = 0; i < N_TIMERS; ++i )
+    if( TIME_GT(expect_time[i], end) )
+      end = expect_time[i];
+
+  UT_PERF_BEGIN(&perf);
+  while( TIME_LE(now, end) ) {
+    ++now;
+    IPTIMER_STATE(ni)->ci_ip_time_real_ticks = now;
+    last_closest = IPTIMER_STATE(ni)->closest_timer;
+    ci_ip_timer_poll(ni);
+  }
+  UT_PERF_END(&perf, "ci_ip_timer_poll per tick", end - start);
+
+  for( i = 0; i < N_TIMERS; ++i )
+    CHECK(fired[i], ==, 1);
+
+  free(state);
+  free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_ci_ip_timer_poll);
+  TEST_RUN(test_ci_ip_timer_perf);
+  TEST_END();
+}
@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_perf.h"
+
+#define TABLE_LG2       16
+#define TABLE_SIZE      (1u << TABLE_LG2)
+/* Each socket owns one entry per local address, as a socket bound to
+ * several addresses does, so we don't need an endpoint buffer per entry. */
+#define N_LADDRS        4
+#define N_SOCKS         (TABLE_SIZE * 9 / 10 / N_LADDRS + 1)
+#define N_LOOKUPS       (1 << 20)
+
+/* The sockets are in endpoint buffers after the shared state, as in a real
+ * stack.  Only the parts of the state used by the filter table are set. */
+struct test_state {
+  ci_netif_state ns;
+  char eps[N_SOCKS][EP_BUF_SIZE] CI_ALIGN(EP_BUF_SIZE);
+};
+
+static struct test_state* state;
+
+
+static unsigned test_laddr(int i)
+{
+  return CI_BSWAP_BE32(0xc0a80001 + i);
+}
+
+
+static ci_sock_cmn* test_sock(ci_netif* ni, int id)
+{
+  return ID_TO_SOCK(ni, id);
+}
+
+
+static void table_init(ci_netif* ni, int n_socks)
+{
+  ci_netif_filter_table* tbl = ni->filter_table;
+  unsigned i;
+
+  *(unsigned*) &tbl->table_size_mask = TABLE_SIZE - 1;
+  /* The EMPTY encoding, as ci_netif_filter_init() would set in the kernel */
+  for( i = 0; i < TABLE_SIZE; ++i ) {
+    tbl->table[i].__id_and_state = 2u << 30;
+    tbl->table[i].laddr = 0;
+    ni->filter_table_ext[i].route_count = 0;
+    ni->filter_table_ext[i].lport = 0;
+  }
+  memset(&state->ns.stats, 0, sizeof(state->ns.stats));
+
+  for( i = 0; i < n_socks; ++i ) {
+    ci_sock_cmn* s = test_sock(ni, i);
+    memset(s, 0, sizeof(*s));
+    s->pkt.ether_type = CI_ETHERTYPE_IP;
+    s->pkt.ipx.ip4.ip_daddr_be32 = CI_BSWAP_BE32(0x0a000000 + random());
+    sock_rport_be16(s) = random();
+    sock_lport_be16(s) = CI_BSWAP_BE16(80 + (i & 7));
+    sock_protocol(s) = (i & 1) ? IPPROTO_UDP : IPPROTO_TCP;
+    s->rx_bind2dev_ifindex = CI_IFID_BAD;
+  }
+}
+
+
+static int filter_insert(ci_netif* ni, int id, int laddr_i)
+{
+  ci_sock_cmn* s = test_sock(ni, id);
+  return ci_netif_filter_insert(ni, OO_SP_FROM_INT(ni, id), AF_SPACE_FLAG_IP4,
+                                CI_ADDR_FROM_IP4(test_laddr(laddr_i)),
+                                sock_lport_be16(s),
+                                CI_ADDR_FROM_IP4(sock_raddr_be32(s)),
+                                sock_rport_be16(s), sock_protocol(s));
+}
+
+
+static void filter_remove(ci_netif* ni, int id, int laddr_i)
+{
+  ci_sock_cmn* s = test_sock(ni, id);
+  ci_netif_filter_remove(ni, OO_SP_FROM_INT(ni, id), AF_SPACE_FLAG_IP4,
+                         CI_ADDR_FROM_IP4(test_laddr(laddr_i)),
+                         sock_lport_be16(s),
+                         CI_ADDR_FROM_IP4(sock_raddr_be32(s)),
+                         sock_rport_be16(s), sock_protocol(s));
+}
+
+
+static int found_cb(ci_sock_cmn* s, void* arg)
+{
+  *(ci_sock_cmn**) arg = s;
+  return 1;
+}
+
+
+/* The receive path's lookup.  Returns the matching socket or NULL. */
+static ci_sock_cmn* filter_match(ci_netif* ni, int id, int laddr_i,
+                                 unsigned rport_xor)
+{
+  ci_sock_cmn* s = test_sock(ni, id);
+  ci_sock_cmn* found = NULL;
+  ci_netif_filter_for_each_match(ni, test_laddr(laddr_i), sock_lport_be16(s),
+                                 sock_raddr_be32(s),
+                                 sock_rport_be16(s) ^ rport_xor,
+                                 sock_protocol(s), 0, 0, found_cb, &found,
+                                 NULL);
+  return found;
+}
+
+
+/* Fill the table to [fill_pct] percent, checking that every filter can be
+ * found both by the receive path and by ci_netif_filter_lookup(), and that
+ * removed ones can't.  With UNIT_PERF set, reports the lookup rate for
+ * hits and misses. */
+static void run_fill(ci_netif* ni, int fill_pct)
+{
+  int n_entries = TABLE_SIZE * fill_pct / 100;
+  int n_socks = (n_entries + N_LADDRS - 1) / N_LADDRS;
+  int i, id, laddr_i, hits = 0;
+  struct ut_perf perf;
+  char name[64];
+
+  ci_assert_le(n_socks, N_SOCKS);
+  table_init(ni, n_socks);
+
+  for( i = 0; i < n_entries; ++i )
+    CHECK(filter_insert(ni, i / N_LADDRS, i % N_LADDRS), ==, 0);
+  CHECK(state->ns.stats.table_n_entries, ==, n_entries);
+
+  for( i = 0; i < n_entries; ++i ) {
+    id = i / N_LADDRS;
+    laddr_i = i % N_LADDRS;
+    CHECK(filter_match(ni, id, laddr_i, 0), ==, test_sock(ni, id));
+    CHECK(OO_SP_TO_INT(ci_netif_filter_lookup(ni, AF_SPACE_FLAG_IP4,
+                         CI_ADDR_FROM_IP4(test_laddr(laddr_i)),
+                         sock_lport_be16(test_sock(ni, id)),
+                         CI_ADDR_FROM_IP4(sock_raddr_be32(test_sock(ni, id))),
+                         sock_rport_be16(test_sock(ni, id)),
+                         sock_protocol(test_sock(ni, id)))), ==, id);
+  }
+
+  if( ut_perf_enabled() )
+    printf("fill=%d%% entries=%d max_hops=%u\n",
+           fill_pct, n_entries, state->ns.stats.table_max_hops);
+
+  snprintf(name, sizeof(name), "  fill=%d%% lookup hit", fill_pct);
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_LOOKUPS; ++i ) {
+    int e = (i * 7919u) % n_entries;
+    hits += filter_match(ni, e / N_LADDRS, e % N_LADDRS, 0) != NULL;
+  }
+  UT_PERF_END(&perf, name, N_LOOKUPS);
+  CHECK(hits, ==, N_LOOKUPS);
+
+  hits = 0;
+  snprintf(name, sizeof(name), "  fill=%d%% lookup miss", fill_pct);
+  UT_PERF_BEGIN(&perf);
+  for( i = 0; i < N_LOOKUPS; ++i ) {
+    int e = (i * 7919u) % n_entries;
+    hits += filter_match(ni, e / N_LADDRS, e % N_LADDRS, 0x1234) != NULL;
+  }
+  UT_PERF_END(&perf, name, N_LOOKUPS);
+  CHECK(hits, ==, 0);
+
+  /* Remove every other filter, leaving tombstones on the chains of the
+   * rest, then everything. */
+  for( i = 0; i < n_entries; i += 2 )
+    filter_remove(ni, i / N_LADDRS, i % N_LADDRS);
+  for( i = 0; i < n_entries; ++i ) {
+    ci_sock_cmn* s = filter_match(ni, i / N_LADDRS, i % N_LADDRS, 0);
+    CHECK(s, ==, (i & 1) ? test_sock(ni, i / N_LADDRS) : NULL);
+  }
+  for( i = 1; i < n_entries; i += 2 )
+    filter_remove(ni, i / N_LADDRS, i % N_LADDRS);
+
+  CHECK(state->ns.stats.table_n_entries, ==, 0);
+  CHECK(state->ns.stats.table_n_slots, ==, 0);
+  for( i = 0; i < TABLE_SIZE; ++i )
+    CHECK(ni->filter_table_ext[i].route_count, ==, 0);
+}
+
+
+static void test_ci_netif_filter_table(void)
+{
+  STATE_ALLOC(ci_netif, ni);
+  int fills[] = { 10, 25, 50, 75, 90 };
+  int i;
+
+  state = aligned_alloc(CI_PAGE_SIZE, sizeof(*state));
+  memset(&state->ns, 0, sizeof(state->ns));
+  ni->state = &state->ns;
+  state->ns.lock.lock = CI_EPLOCK_LOCKED;
+  *(ci_uint32*) &state->ns.ep_ofs = CI_MEMBER_OFFSET(struct test_state, eps);
+  *(ci_uint32*) &state->ns.n_ep_bufs = N_SOCKS;
+  ni->filter_table = aligned_alloc(CI_CACHE_LINE_SIZE,
+                                   CI_ROUND_UP(sizeof(ci_netif_filter_table) +
+                                     sizeof(ci_netif_filter_table_entry_fast) *
+                                     TABLE_SIZE, CI_CACHE_LINE_SIZE));
+  ni->filter_table_ext = calloc(TABLE_SIZE,
+                                sizeof(ci_netif_filter_table_entry_ext));
+  srandom(1);
+
+  for( i = 0; i < sizeof(fills) / sizeof(fills[0]); ++i )
+    run_fill(ni, fills[i]);
+
+  free(ni->filter_table_ext);
+  free(ni->filter_table);
+  free(state);
+  free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_ci_netif_filter_table);
+  TEST_END();
+}
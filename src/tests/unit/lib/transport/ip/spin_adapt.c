@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <onload/ul/per_thread.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+/* Dependencies */
+__thread struct oo_per_thread oo_per_thread;
+
+/* 1GHz clock */
+#define KHZ     1000000u
+#define USEC(n) ((ci_uint64) (n) * 1000)
+
+static const int key_a, key_b;
+
+
+static void record_n(const void* key, int n, ci_uint64 usec)
+{
+  int i;
+  for( i = 0; i < n; ++i )
+    oo_spin_adapt_record(key, USEC(usec), KHZ);
+}
+
+
+static void reset(void)
+{
+  memset(&oo_per_thread, 0, sizeof(oo_per_thread));
+}
+
+
+/* With no history we spin for the full time. */
+static void test_cold(void)
+{
+  reset();
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(50));
+  record_n(&key_a, 7, 1000);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(50));
+}
+
+
+/* Short waits shorten the spin to just cover them. */
+static void test_short(void)
+{
+  reset();
+  record_n(&key_a, 20, 3);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(4));
+  /* Never more than the configured limit */
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(2), KHZ), <=, USEC(2));
+}
+
+
+/* Waits much longer than the spin time turn spinning off, apart from an
+ * occasional probe. */
+static void test_long(void)
+{
+  int i;
+
+  reset();
+  record_n(&key_a, 20, 1000);
+  for( i = 0; i < 15; ++i )
+    CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, 0);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(50));
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, 0);
+}
+
+
+/* A mostly-short mix still spins, for long enough to catch the bulk of the
+ * short waits but not the stragglers. */
+static void test_mixed(void)
+{
+  reset();
+  record_n(&key_a, 70, 1);
+  record_n(&key_a, 10, 20);
+  record_n(&key_a, 20, 1000);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(2));
+}
+
+
+/* Old history fades, so a change in behaviour is followed. */
+static void test_decay(void)
+{
+  reset();
+  record_n(&key_a, 200, 1000);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, 0);
+  record_n(&key_a, 400, 3);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(4));
+}
+
+
+/* Keys are tracked separately. */
+static void test_keys(void)
+{
+  reset();
+  record_n(&key_a, 20, 3);
+  record_n(&key_b, 20, 1000);
+  CHECK(oo_spin_adapt_limit(&key_a, USEC(50), KHZ), ==, USEC(4));
+  CHECK(oo_spin_adapt_limit(&key_b, USEC(50), KHZ), ==, 0);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_cold);
+  TEST_RUN(test_short);
+  TEST_RUN(test_long);
+  TEST_RUN(test_mixed);
+  TEST_RUN(test_decay);
+  TEST_RUN(test_keys);
+  TEST_END();
+}
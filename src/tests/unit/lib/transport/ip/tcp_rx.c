@@ -97,6 +97,10 @@ static void test_ci_tcp_handle_rx(void)
   netif->state = ns;
   STATE_STASH(netif);
 
+  /* pre: poll state is as at the start of a poll */
+  ci_netif_poll_state_init(ps);
+  STATE_STASH(ps);
+
   /* pre: pkt identifies as TCP, and passes basic sanity tests */
   pkt->frag_next = OO_PP_ID_NULL;
   pkt->pkt_eth_payload_off = 14;
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2026 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include "tcp_tx.h"
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+
+/* Fixture: a stack with one valid route, and a socket that uses it */
+static struct cp_fwd_row fwd_row;
+static struct oo_cplane_handle cplane;
+
+static void route_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  fwd_row.version = 2;
+  cplane.mib[0].fwd_table.rows = &fwd_row;
+  cplane.mib[0].fwd_table.mask = 0;
+  ni->cplane = &cplane;
+
+  ts->s.pkt.status = retrrc_success;
+  ts->s.pkt.fwd_ver.id = 0;
+  ts->s.pkt.fwd_ver.version = fwd_row.version;
+  ts->s.pkt.fwd_ver_init_net.id = CICP_MAC_ROWID_UNUSED;
+}
+
+
+/* ci_netif_poll_n() queues ACKs to the end of the poll, as it pushes every
+ * dmaq when it finishes. */
+static void test_ack_batch_poll(void)
+{
+  STATE_ALLOC(ci_netif, ni);
+  STATE_ALLOC(ci_netif_state, ns);
+  STATE_ALLOC(ci_tcp_state, ts);
+
+  ni->state = ns;
+  route_init(ni, ts);
+  ns->in_poll = 1;
+  ns->ack_batch_active = 1;
+  STATE_STASH(ni);
+  STATE_STASH(ns);
+  STATE_STASH(ts);
+
+  CHECK_TRUE(ci_tcp_ack_may_batch(ni, ts));
+
+  /* ...but not on a stale route, which must go through the slow path */
+  ++fwd_row.version;
+  CHECK_FALSE(ci_tcp_ack_may_batch(ni, ts));
+
+  STATE_FREE(ni);
+  STATE_FREE(ns);
+  STATE_FREE(ts);
+}
+
+
+/* ci_netif_poll_intf_future() raises in_poll, but nothing pushes the dmaq
+ * after it, so a queued ACK could wait indefinitely.  Its ACKs go at once. */
+static void test_ack_batch_poll_future(void)
+{
+  STATE_ALLOC(ci_netif, ni);
+  STATE_ALLOC(ci_netif_state, ns);
+  STATE_ALLOC(ci_tcp_state, ts);
+
+  ni->state = ns;
+  route_init(ni, ts);
+  ns->in_poll = 1;
+  ns->ack_batch_active = 0;
+  STATE_STASH(ni);
+  STATE_STASH(ns);
+  STATE_STASH(ts);
+
+  CHECK_FALSE(ci_tcp_ack_may_batch(ni, ts));
+
+  STATE_FREE(ni);
+  STATE_FREE(ns);
+  STATE_FREE(ts);
+}
+
+
+/* Loopback ACKs are never queued on a dmaq. */
+static void test_ack_batch_loopback(void)
+{
+  STATE_ALLOC(ci_netif, ni);
+  STATE_ALLOC(ci_netif_state, ns);
+  STATE_ALLOC(ci_tcp_state, ts);
+
+  ni->state = ns;
+  route_init(ni, ts);
+  ns->in_poll = 1;
+  ns->ack_batch_active = 1;
+  ts->s.pkt.flags |= CI_IP_CACHE_IS_LOCALROUTE;
+  STATE_STASH(ni);
+  STATE_STASH(ns);
+  STATE_STASH(ts);
+
+  CHECK_FALSE(ci_tcp_ack_may_batch(ni, ts));
+
+  STATE_FREE(ni);
+  STATE_FREE(ns);
+  STATE_FREE(ts);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_ack_batch_poll);
+  TEST_RUN(test_ack_batch_poll_future);
+  TEST_RUN(test_ack_batch_loopback);
+  TEST_END();
+}
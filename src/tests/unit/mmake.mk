@@ -14,9 +14,20 @@ UNIT_TEST_WRAPPER ?=
 ALL_UNIT_TESTS := \
   header/ci/internal/ip_timestamp \
   lib/transport/ip/netif_init \
+  lib/transport/ip/iptimer \
+  lib/transport/ip/netif_table \
   lib/transport/ip/tcp_rx \
+  lib/transport/ip/tcp_tx \
+  lib/transport/ip/spin_adapt \
   lib/ciul/checksum \
   lib/ciul/efct_vi \
+  lib/ciul/shm_ring \
+  lib/ciul/tx_pacer \
+  lib/ciul/pkt_pool \
+  lib/citools/ipcsum_avx2 \
+  lib/citools/crc32c \
+  lib/citools/buddy \
+  lib/citools/dllist \
 
 # The tests to be run, and their corresponding files
 TESTS := $(filter $(UNIT_TEST_FILTER)%, $(ALL_UNIT_TESTS))
@@ -25,7 +36,8 @@ OBJECTS := $(TESTS:%=%.o)
 PASSED := $(TESTS:%=%.passed)
 
 # Library objects names are mangled with a prefix. Deal with that madness here.
-LIB_PREFIXES := lib/transport/common/ci_tp_common_ lib/transport/ip/ci_ip_
+LIB_PREFIXES := lib/transport/common/ci_tp_common_ lib/transport/ip/ci_ip_ \
+                lib/citools/ci_tools_
 
 lib_prefix = $(notdir $(filter $(dir $(1))%,$(LIB_PREFIXES)))
 lib_object = ../../$(dir $(1))$(call lib_prefix,$(1))$(notdir $(1)).o
@@ -70,6 +82,12 @@ $(filter lib/%, $(TARGETS)): $$(call lib_object,$$@)
 $(TARGETS): %: %.o stubs.o
 	$(MMakeLinkCApp)
 
+# The SIMD checksums are tested against the scalar ones, so need those too.
+lib/citools/ipcsum_avx2: ../../lib/citools/ci_tools_ip_csum_partial.o \
+                         ../../lib/citools/ci_tools_csum_copy2.o \
+                         ../../lib/citools/ci_tools_cpu_features.o
+lib/citools/crc32c: ../../lib/citools/ci_tools_cpu_features.o
+
 # The build system relies on a convoluted web of makefiles in subdirectories
 # of both source and build trees to generate the dependencies. Lets do it the
 # easy way instead. TODO remove this once the build system is more sensible.
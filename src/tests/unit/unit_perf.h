@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Microbenchmark support for unit tests
+ *
+ * Wrap a loop of [n_ops] operations in UT_PERF_BEGIN/UT_PERF_END to report
+ * the mean time per operation and, where the kernel lets us count them, the
+ * hardware cache misses per operation:
+ *
+ *   struct ut_perf perf;
+ *   UT_PERF_BEGIN(&perf);
+ *   for( i = 0; i < N; ++i )
+ *     do_something();
+ *   UT_PERF_END(&perf, "do_something", N);
+ *
+ * The results are informational only; they do not affect the test result,
+ * and are printed only if UNIT_PERF is set to a non-zero value in the
+ * environment, so that an ordinary test run stays quiet.
+ */
+#ifndef ONLOAD_UNIT_PERF_H
+#define ONLOAD_UNIT_PERF_H
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct ut_perf {
+  struct timespec start;
+  int misses_fd;
+};
+
+#define UT_PERF_BEGIN(PERF) ut_perf_begin(PERF)
+#define UT_PERF_END(PERF, NAME, N_OPS) ut_perf_end(PERF, NAME, N_OPS)
+
+
+/* Whether to report results: true if UNIT_PERF is set and non-zero */
+static inline int ut_perf_enabled(void)
+{
+  const char* s = getenv("UNIT_PERF");
+  return s != NULL && atoi(s) != 0;
+}
+
+
+/* Implementation details */
+static inline void ut_perf_begin(struct ut_perf* perf)
+{
+  struct perf_event_attr attr;
+
+  perf->misses_fd = -1;
+  if( ! ut_perf_enabled() )
+    return;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  /* Fails without a PMU or when perf_event_paranoid forbids it. */
+  perf->misses_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if( perf->misses_fd >= 0 ) {
+    ioctl(perf->misses_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(perf->misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &perf->start);
+}
+
+static inline void
+ut_perf_end(struct ut_perf* perf, const char* name, long n_ops)
+{
+  struct timespec end;
+  uint64_t misses;
+  double ns;
+
+  if( ! ut_perf_enabled() )
+    return;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns = (end.tv_sec - perf->start.tv_sec) * 1e9 +
+       (end.tv_nsec - perf->start.tv_nsec);
+
+  if( perf->misses_fd >= 0 ) {
+    ioctl(perf->misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+    if( read(perf->misses_fd, &misses, sizeof(misses)) == sizeof(misses) )
+      printf("%s: %.1f ns/op, %.3f cache-misses/op\n", name, ns / n_ops,
+             (double) misses / n_ops);
+    else
+      printf("%s: %.1f ns/op\n", name, ns / n_ops);
+    close(perf->misses_fd);
+  }
+  else {
+    printf("%s: %.1f ns/op\n", name, ns / n_ops);
+  }
+}
+
+#endif
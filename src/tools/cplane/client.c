@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/socket.h> /* RHEL6 needs this before linux/rtnetlink.h */
 #include <linux/rtnetlink.h>
 #include <sys/user.h>
@@ -172,6 +173,129 @@ static int arp_confirm(struct oo_cplane_handle* cp, int argc, char** argv)
   return 0;
 }
 
+
+/* A destination held by the "pin" command.  key[0] has the source address
+ * that was asked for (usually any), key[1] the one chosen by the route
+ * lookup, as sockets use both. */
+struct cp_pin {
+  const char* name;
+  struct cp_fwd_key key[2];
+  cicp_verinfo_t verinfo[2];
+  int ok;
+};
+
+/* Returns true if the route for pin->key[i] is resolved, with a MAC
+ * address, and logs any change since the last call. */
+static int pin_refresh_one(struct oo_cplane_handle* cp, struct cp_pin* pin,
+                           int i)
+{
+  struct cp_fwd_data data;
+  int rc;
+
+  rc = oo_cp_route_resolve(cp, &pin->verinfo[i], &pin->key[i], &data);
+  if( rc < 0 ) {
+    if( pin->ok )
+      ci_log("%s: failed to resolve the route: %s", pin->name, strerror(-rc));
+    oo_cp_verinfo_init(&pin->verinfo[i]);
+    return 0;
+  }
+  if( rc == 0 ) {
+    ci_log("%s: route %s (verinfo %x-%x)", pin->name,
+           pin->ok ? "changed" : "resolved",
+           pin->verinfo[i].id, pin->verinfo[i].version);
+    print_fwd_data(&cp->mib[0], &data);
+    if( i == 0 && CI_IPX_ADDR_IS_ANY(pin->key[0].src) &&
+        ! CI_IPX_ADDR_IS_ANY(data.base.src) ) {
+      pin->key[1] = pin->key[0];
+      pin->key[1].src = data.base.src;
+      oo_cp_verinfo_init(&pin->verinfo[1]);
+    }
+  }
+  if( ! (data.flags & CICP_FWD_DATA_FLAG_ARP_VALID) ) {
+    if( pin->ok )
+      ci_log("%s: stale: ARP "CICP_FWD_DATA_FLAG_FMT, pin->name,
+             CICP_FWD_DATA_FLAG_ARG(data.flags));
+    oo_cp_arp_resolve(cp, &pin->verinfo[i], 0 /* unused at UL */);
+    return 0;
+  }
+  return 1;
+}
+
+static int fwd_pin(struct oo_cplane_handle* cp, int argc, char** argv)
+{
+  struct cp_pin* pins;
+  int n_pins, interval_ms = 1000, count = 0, i, j, iter, ok;
+
+  for( n_pins = 0; n_pins < argc; ++n_pins )
+    if( strcmp(argv[n_pins], "interval") == 0 ||
+        strcmp(argv[n_pins], "count") == 0 )
+      break;
+  if( n_pins == 0 ) {
+    usage();
+    return 1;
+  }
+  for( i = n_pins; i < argc; i += 2 ) {
+    if( i + 1 == argc ) {
+      ci_log("No value for parameter %s", argv[i]);
+      usage();
+      return 1;
+    }
+    if( strcmp(argv[i], "interval") == 0 )
+      interval_ms = atoi(argv[i + 1]);
+    else if( strcmp(argv[i], "count") == 0 )
+      count = atoi(argv[i + 1]);
+    else {
+      ci_log("Unknown parameter %s", argv[i]);
+      usage();
+      return 1;
+    }
+  }
+
+  pins = calloc(n_pins, sizeof(*pins));
+  if( pins == NULL )
+    return 1;
+  for( i = 0; i < n_pins; ++i ) {
+    struct cp_fwd_key* key = &pins[i].key[0];
+    int af = ci_addr_sh_from_str(argv[i], &key->dst);
+    if( af == AF_UNSPEC ) {
+      ci_log("Failed to parse destination address %s", argv[i]);
+      free(pins);
+      usage();
+      return 1;
+    }
+    pins[i].name = argv[i];
+    key->src = af == AF_INET ? ip4_addr_sh_any : addr_sh_any;
+    key->flag = CP_FWD_KEY_REQ_WAIT;
+    oo_cp_verinfo_init(&pins[i].verinfo[0]);
+    oo_cp_verinfo_init(&pins[i].verinfo[1]);
+  }
+
+  /* Re-resolve each route in turn, which also stops it from expiring, and
+   * report when one changes or loses its ARP entry. */
+  for( iter = 0; count == 0 || iter < count; ++iter ) {
+    for( i = 0; i < n_pins; ++i )
+      if( ! oo_cp_verinfo_is_valid(cp, &pins[i].verinfo[0], 0) )
+        oo_cp_route_prefetch(cp, &pins[i].key[0], 0);
+    for( i = 0; i < n_pins; ++i ) {
+      ok = 1;
+      for( j = 0; j < 2; ++j )
+        if( j == 0 || ! CI_IPX_ADDR_IS_ANY(pins[i].key[1].src) )
+          ok &= pin_refresh_one(cp, &pins[i], j);
+      if( ok && ! pins[i].ok )
+        ci_log("%s: ready", pins[i].name);
+      pins[i].ok = ok;
+    }
+    if( count == 0 || iter + 1 < count )
+      usleep(interval_ms * 1000);
+  }
+
+  for( i = 0; i < n_pins; ++i )
+    if( ! pins[i].ok )
+      break;
+  free(pins);
+  return i == n_pins ? 0 : 1;
+}
+
 struct cp_func {
   const char* name;
   int (*fn)(struct oo_cplane_handle* cp, int argc, char** argv);
@@ -183,6 +307,9 @@ struct cp_func func[] =
       "<destination> [from <source>] [via <interface>] [tos <tos>] "
       "[verinfo <id>-<ver>] [nowait] [transparent] - resolve a route" },
   { "confirm", arp_confirm, "<id>-<ver> - confirm ARP entry" },
+  { "pin", fwd_pin,
+      "<destination>... [interval <ms>] [count <n>] - resolve routes and ARP, "
+      "keep them fresh and report changes" },
 };
 #define FUNC_NR (sizeof(func)/sizeof(func[0]))
 
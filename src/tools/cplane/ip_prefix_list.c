@@ -16,38 +16,449 @@ int cp_ippl_compare(const void *void_a, const void *void_b)
   return memcmp(b->addr.ip6, a->addr.ip6, sizeof(a->addr.ip6));
 }
 
+/* The address an entry is hashed by */
+static inline ci_addr_sh_t
+cp_ippl_hash_addr(struct cp_ip_prefix_list* list, ci_addr_sh_t addr, int pfx)
+{
+  if( list->hash_by_prefix && pfx >= 0 ) {
+    if( CI_ADDR_AF(addr) == AF_INET6 )
+      cp_addr_apply_pfx(&addr, pfx);
+    else
+      addr.ip4 &= cp_prefixlen2bitmask(pfx);
+  }
+  return addr;
+}
+
+static inline cicp_mac_rowid_t
+cp_ippl_hash_slot(struct cp_ip_prefix_list* list, ci_addr_sh_t addr)
+{
+  const uint32_t* w = (const uint32_t*) addr.ip6;
+  uint32_t h = w[0];
+
+  h = (h * 0x9e3779b1u) ^ w[1];
+  h = (h * 0x9e3779b1u) ^ w[2];
+  h = (h * 0x9e3779b1u) ^ w[3];
+  h *= 0x9e3779b1u;
+  return (h ^ (h >> 16)) & list->hash_mask;
+}
+
+/* Bit [i] of an address of the trie's family, counting from the most
+ * significant bit.  IPv4 addresses live in the last 4 bytes. */
+static inline int
+cp_ippl_trie_bit(int af, const ci_addr_sh_t* addr, int i)
+{
+  const uint8_t* b = (const uint8_t*) addr->ip6;
+
+  if( af != AF_INET6 )
+    i += 96;
+  return (b[i / 8] >> (7 - i % 8)) & 1;
+}
+
+/* Number of leading bits two addresses have in common */
+static inline int
+cp_ippl_trie_cpl(int af, const ci_addr_sh_t* a, const ci_addr_sh_t* b)
+{
+  int i = (af == AF_INET6) ? 0 : 3;
+
+  for( ; i < 4; i++ ) {
+    uint32_t x = a->u32[i] ^ b->u32[i];
+    if( x != 0 )
+      return (i - (af == AF_INET6 ? 0 : 3)) * 32 +
+             __builtin_clz(CI_BSWAP_BE32(x));
+  }
+  return CI_IPX_MAX_PREFIX_LEN(af);
+}
+
+static cicp_mac_rowid_t
+cp_ippl_trie_node_alloc(struct cp_ip_prefix_list* list,
+                        const ci_addr_sh_t* addr, int prefix)
+{
+  struct cp_ippl_trie_node* node;
+  cicp_mac_rowid_t id;
+
+  if( list->trie_free >= 0 ) {
+    id = list->trie_free;
+    list->trie_free = list->trie[id].child[0];
+  }
+  else {
+    if( list->trie_used == list->trie_max ) {
+      cicp_mac_rowid_t max = list->trie_max == 0 ? 16 : list->trie_max * 2;
+      struct cp_ippl_trie_node* trie = realloc(list->trie,
+                                               max * sizeof(*trie));
+      ci_assert(trie);
+      list->trie = trie;
+      list->trie_max = max;
+    }
+    id = list->trie_used++;
+  }
+  node = &list->trie[id];
+  node->addr = *addr;
+  node->bit = -1;
+  node->max_prefix = prefix;
+  node->child[0] = node->child[1] = -1;
+  return id;
+}
+
+static void
+cp_ippl_trie_node_free(struct cp_ip_prefix_list* list, cicp_mac_rowid_t id)
+{
+  list->trie[id].child[0] = list->trie_free;
+  list->trie_free = id;
+}
+
+static void
+cp_ippl_trie_insert(struct cp_ip_prefix_list* list,
+                    const ci_addr_sh_t* addr, int prefix)
+{
+  int af = list->trie_af;
+  struct cp_ippl_trie_node* node;
+  cicp_mac_rowid_t id, leaf = -1, inner = -1;
+  cicp_mac_rowid_t* link;
+  int crit;
+
+  if( list->trie_root < 0 ) {
+    list->trie_root = cp_ippl_trie_node_alloc(list, addr, prefix);
+    return;
+  }
+
+  /* Find the leaf which shares the most bits with the new address. */
+  for( id = list->trie_root; list->trie[id].bit >= 0; ) {
+    node = &list->trie[id];
+    id = node->child[cp_ippl_trie_bit(af, addr, node->bit)];
+  }
+  crit = cp_ippl_trie_cpl(af, addr, &list->trie[id].addr);
+
+  /* Allocate the new nodes before taking pointers into the trie. */
+  if( crit < CI_IPX_MAX_PREFIX_LEN(af) ) {
+    leaf = cp_ippl_trie_node_alloc(list, addr, prefix);
+    inner = cp_ippl_trie_node_alloc(list, addr, prefix);
+  }
+
+  /* Walk down to the place of the new node, or to the leaf with the same
+   * address, accounting the new prefix on the way. */
+  for( link = &list->trie_root; ; ) {
+    node = &list->trie[*link];
+    if( node->bit < 0 || node->bit > crit )
+      break;
+    node->max_prefix = CI_MAX(node->max_prefix, prefix);
+    link = &node->child[cp_ippl_trie_bit(af, addr, node->bit)];
+  }
+
+  if( crit == CI_IPX_MAX_PREFIX_LEN(af) ) {
+    ci_assert_lt(node->bit, 0);
+    node->max_prefix = CI_MAX(node->max_prefix, prefix);
+    return;
+  }
+
+  node = &list->trie[inner];
+  node->bit = crit;
+  node->max_prefix = CI_MAX(prefix, list->trie[*link].max_prefix);
+  node->child[cp_ippl_trie_bit(af, addr, crit)] = leaf;
+  node->child[!cp_ippl_trie_bit(af, addr, crit)] = *link;
+  *link = inner;
+}
+
+/* Longest prefix of the entries in the list with address [addr], or -1 if
+ * there are none.  The trie is never combined with hash_by_prefix, so all
+ * of them are on the hash chain of [addr]. */
+static int
+cp_ippl_addr_max_prefix(struct cp_ip_prefix_list* list,
+                        const ci_addr_sh_t* addr)
+{
+  cicp_mac_rowid_t i;
+  int prefix = -1;
+
+  for( i = cp_ippl_hash_slot(list, *addr);
+       list->hash[i] >= 0;
+       i = (i + 1) & list->hash_mask ) {
+    struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, list->hash[i]);
+    if( memcmp(ipp->addr.ip6, addr->ip6, sizeof(addr->ip6)) == 0 )
+      prefix = CI_MAX(prefix, ipp->prefix);
+  }
+  return prefix;
+}
+
+/* Account for the removal of an entry with [addr], which must already be
+ * out of the hash.  The leaf for [addr] goes away with the last such entry,
+ * and takes its parent with it: the parent is left with one child, which
+ * takes its place. */
+static void
+cp_ippl_trie_remove(struct cp_ip_prefix_list* list, const ci_addr_sh_t* addr)
+{
+  int af = list->trie_af;
+  /* links[i] points to the i-th node on the path of [addr] */
+  cicp_mac_rowid_t* links[CI_IPX_MAX_PREFIX_LEN(AF_INET6) + 2];
+  struct cp_ippl_trie_node* node;
+  int depth = 0, prefix, i;
+
+  links[0] = &list->trie_root;
+  ci_assert_ge(*links[0], 0);
+  while( (node = &list->trie[*links[depth]])->bit >= 0 ) {
+    links[depth + 1] = &node->child[cp_ippl_trie_bit(af, addr, node->bit)];
+    depth++;
+  }
+  ci_assert_equal(cp_ippl_trie_cpl(af, addr, &node->addr),
+                  CI_IPX_MAX_PREFIX_LEN(af));
+
+  prefix = cp_ippl_addr_max_prefix(list, addr);
+  if( prefix >= 0 ) {
+    node->max_prefix = prefix;
+    depth--;
+  }
+  else if( depth == 0 ) {
+    cp_ippl_trie_node_free(list, list->trie_root);
+    list->trie_root = -1;
+    return;
+  }
+  else {
+    cicp_mac_rowid_t leaf = *links[depth];
+    cicp_mac_rowid_t parent = *links[depth - 1];
+    node = &list->trie[parent];
+    *links[depth - 1] = node->child[node->child[0] == leaf];
+    cp_ippl_trie_node_free(list, leaf);
+    cp_ippl_trie_node_free(list, parent);
+    depth -= 2;
+  }
+
+  /* Fix up the nodes above; their address might have been the one which
+   * has gone. */
+  for( i = depth; i >= 0; i-- ) {
+    struct cp_ippl_trie_node* c0;
+    struct cp_ippl_trie_node* c1;
+    node = &list->trie[*links[i]];
+    c0 = &list->trie[node->child[0]];
+    c1 = &list->trie[node->child[1]];
+    node->max_prefix = CI_MAX(c0->max_prefix, c1->max_prefix);
+    node->addr = c0->addr;
+  }
+}
+
+/* Longest prefix cp_ippl_get_prefix() needs because of the entries in the
+ * list.  For each entry, this is its prefix if it covers [addr], and one
+ * bit more than it has in common with [addr] otherwise; i.e. the smaller
+ * of the two in both cases.  Everything on the other side of an inner node
+ * shares exactly node->bit bits with [addr], so only the nodes on the path
+ * of [addr] need to be visited. */
+cicp_prefixlen_t
+cp_ippl_trie_get_prefix(struct cp_ip_prefix_list* list, ci_addr_sh_t addr)
+{
+  int af = list->trie_af;
+  cicp_mac_rowid_t id = list->trie_root;
+  int len = 0;
+
+  while( id >= 0 ) {
+    struct cp_ippl_trie_node* node = &list->trie[id];
+    int cpl = cp_ippl_trie_cpl(af, &addr, &node->addr);
+    int b;
+
+    if( node->bit < 0 || cpl < node->bit ) {
+      /* All the entries below share cpl bits with [addr]. */
+      len = CI_MAX(len, CI_MIN(cpl + 1, node->max_prefix));
+      break;
+    }
+    b = cp_ippl_trie_bit(af, &addr, node->bit);
+    len = CI_MAX(len, CI_MIN(node->bit + 1,
+                             list->trie[node->child[!b]].max_prefix));
+    id = node->child[b];
+  }
+
+  return len;
+}
+
+/* The first slot of the hash chain of an entry */
+static inline cicp_mac_rowid_t
+cp_ippl_hash_home(struct cp_ip_prefix_list* list, cicp_mac_rowid_t idx)
+{
+  struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, idx);
+  return cp_ippl_hash_slot(list,
+                           cp_ippl_hash_addr(list, ipp->addr, ipp->prefix));
+}
+
+/* The hash slot which holds an entry */
+static cicp_mac_rowid_t
+cp_ippl_hash_find(struct cp_ip_prefix_list* list, cicp_mac_rowid_t idx)
+{
+  cicp_mac_rowid_t i;
+
+  for( i = cp_ippl_hash_home(list, idx);
+       list->hash[i] != idx;
+       i = (i + 1) & list->hash_mask )
+    ci_assert_ge(list->hash[i], 0);
+  return i;
+}
+
+static void
+cp_ippl_hash_insert(struct cp_ip_prefix_list* list, cicp_mac_rowid_t idx)
+{
+  struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, idx);
+  cicp_mac_rowid_t i;
+
+  for( i = cp_ippl_hash_home(list, idx);
+       list->hash[i] >= 0;
+       i = (i + 1) & list->hash_mask )
+    ;
+  list->hash[i] = idx;
+  if( list->hash_by_prefix )
+    list->prefixes[ipp->prefix / 64] |= 1ull << (ipp->prefix % 64);
+}
+
+/* Remove an entry from the hash.  The entries after it on the probe
+ * sequence are shifted back into the hole, so that the hash never needs
+ * tombstones. */
+static void
+cp_ippl_hash_remove(struct cp_ip_prefix_list* list, cicp_mac_rowid_t idx)
+{
+  cicp_mac_rowid_t i = cp_ippl_hash_find(list, idx);
+  cicp_mac_rowid_t j = i;
+
+  list->hash[i] = -1;
+  for( ; ; ) {
+    cicp_mac_rowid_t home;
+
+    j = (j + 1) & list->hash_mask;
+    if( list->hash[j] < 0 )
+      return;
+    home = cp_ippl_hash_home(list, list->hash[j]);
+    /* The entry at [j] stays where it is if its chain starts after the
+     * hole, cyclically. */
+    if( i <= j ? (i < home && home <= j) : (i < home || home <= j) )
+      continue;
+    list->hash[i] = list->hash[j];
+    list->hash[j] = -1;
+    i = j;
+  }
+}
+
+/* Rebuild the hash for the current contents of the list, when the list
+ * grows.  The hash has at least twice as many slots as the list has
+ * entries.  The bits in prefixes[] are only cleared here: a prefix length
+ * which is no longer in use costs cp_ippl_lpm() one extra probe. */
+void cp_ippl_hash_rebuild(struct cp_ip_prefix_list* list)
+{
+  cicp_mac_rowid_t i, size = 1;
+
+  while( size < list->max * 2 )
+    size *= 2;
+  if( size != list->hash_mask + 1 || list->hash == NULL ) {
+    cicp_mac_rowid_t* hash = realloc(list->hash, size * sizeof(*hash));
+    ci_assert(hash);
+    list->hash = hash;
+    list->hash_mask = size - 1;
+  }
+  for( i = 0; i <= list->hash_mask; i++ )
+    list->hash[i] = -1;
+  memset(list->prefixes, 0, sizeof(list->prefixes));
+
+  for( i = 0; i < list->used; i++ )
+    cp_ippl_hash_insert(list, i);
+}
+
+struct cp_ip_with_prefix*
+cp_ippl_search_next(struct cp_ip_prefix_list* list,
+                    struct cp_ip_with_prefix* ipp,
+                    cp_ipp_compare_fn_t compare, cicp_mac_rowid_t* iter)
+{
+  cicp_mac_rowid_t i;
+
+  CP_IPPL_ASSERT_VALID(list);
+  if( *iter < 0 )
+    i = cp_ippl_hash_slot(list,
+                          cp_ippl_hash_addr(list, ipp->addr, ipp->prefix));
+  else
+    i = (*iter + 1) & list->hash_mask;
+
+  for( ; list->hash[i] >= 0; i = (i + 1) & list->hash_mask ) {
+    struct cp_ip_with_prefix* ipp1 = cp_ippl_entry(list, list->hash[i]);
+    if( compare(ipp1, ipp) == 0 ) {
+      *iter = i;
+      return ipp1;
+    }
+  }
+
+  return NULL;
+}
+
 struct cp_ip_with_prefix*
 __cp_ippl_search(struct cp_ip_prefix_list* list,
                  struct cp_ip_with_prefix* ipp,
                  cp_ipp_compare_fn_t compare)
 {
-  CP_IPPL_ASSERT_VALID(list);
-  struct cp_ip_with_prefix* entry = bsearch(ipp, list->list, list->sorted,
-                                            list->stride, compare);
+  cicp_mac_rowid_t iter = -1;
+  return cp_ippl_search_next(list, ipp, compare, &iter);
+}
 
-  if( entry != NULL )
-    return entry;
+struct cp_ip_with_prefix*
+cp_ippl_lpm(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr,
+            cp_ippl_match_fn_t match, void* arg)
+{
+  int pfx;
 
-  /* Look up in the unsorted part of the list */
-  int i;
-  for( i = list->sorted; i < list->used; i++ ) {
-    struct cp_ip_with_prefix* ipp1 = cp_ippl_entry(list, i);
-    if( compare(ipp1, ipp) == 0 )
-      return ipp1;
+  ci_assert(list->hash_by_prefix);
+
+  for( pfx = CI_IPX_MAX_PREFIX_LEN(af); pfx >= 0; pfx-- ) {
+    struct cp_ip_with_prefix* best = NULL;
+    ci_addr_sh_t masked;
+    cicp_mac_rowid_t i;
+
+    if( ! (list->prefixes[pfx / 64] & (1ull << (pfx % 64))) )
+      continue;
+
+    masked = cp_ippl_hash_addr(list, addr, pfx);
+    for( i = cp_ippl_hash_slot(list, masked);
+         list->hash[i] >= 0;
+         i = (i + 1) & list->hash_mask ) {
+      struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, list->hash[i]);
+      if( ipp->prefix == pfx &&
+          cp_ipx_ippl_pfx_match(af, addr, ipp->addr, pfx) &&
+          (best == NULL || list->compare(ipp, best) < 0) &&
+          match(ipp, arg) )
+        best = ipp;
+    }
+    if( best != NULL )
+      return best;
   }
 
   return NULL;
 }
 
+/* Remove an entry.  The last entry of the list is moved into its place,
+ * so only that entry's hash slot and "seen" bit change. */
+void cp_ippl_remove(struct cp_ip_prefix_list* list, int idx)
+{
+  cicp_mac_rowid_t last = list->used - 1;
+  struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, idx);
+
+  ci_assert_ge(idx, 0);
+  ci_assert_lt(idx, list->used);
+
+  cp_ippl_hash_remove(list, idx);
+  if( list->trie_af != 0 )
+    cp_ippl_trie_remove(list, &ipp->addr);
+
+  if( idx != last ) {
+    list->hash[cp_ippl_hash_find(list, last)] = idx;
+    memcpy(ipp, cp_ippl_entry(list, last), list->stride);
+    if( cp_row_mask_get(list->seen, last) )
+      cp_row_mask_set(list->seen, idx);
+    else
+      cp_row_mask_unset(list->seen, idx);
+  }
+  cp_row_mask_unset(list->seen, last);
+  cp_ippl_entry(list, last)->addr = addr_sh_any;
+  cp_ippl_entry(list, last)->sort_by = -1;
+  list->used--;
+}
+
 /* Returns true if the list was modified */
 bool cp_ippl_add(struct cp_ip_prefix_list* list,
                  struct cp_ip_with_prefix* ipp, int* idx_p)
 {
   CP_IPPL_ASSERT_VALID(list);
   struct cp_ip_with_prefix* entry = cp_ippl_search(list, ipp);
+  int idx;
 
   if( entry ) {
-    int idx = cp_ippl_idx(list, entry);
+    idx = cp_ippl_idx(list, entry);
     cp_row_mask_set(list->seen, idx);
     if( idx_p )
       *idx_p = idx;
@@ -58,7 +469,8 @@ bool cp_ippl_add(struct cp_ip_prefix_list* list,
     struct cp_ip_with_prefix* new_list =
       realloc(list->list, list->stride * list->max * 2);
     if( new_list == NULL ) {
-      *idx_p = -1;
+      if( idx_p )
+        *idx_p = -1;
       return false;
     }
     list->list = new_list;
@@ -69,21 +481,24 @@ bool cp_ippl_add(struct cp_ip_prefix_list* list,
     cp_row_mask_t new_seen = cp_row_mask_realloc(list->seen,
                                                  list->max, list->max * 2);
     if( new_seen == NULL ) {
-      *idx_p = -1;
+      if( idx_p )
+        *idx_p = -1;
       return false;
     }
     list->seen = new_seen;
 
     list->max *= 2;
+    cp_ippl_hash_rebuild(list);
   }
 
+  idx = list->used++;
+  memcpy(cp_ippl_entry(list, idx), ipp, list->stride);
+  cp_row_mask_set(list->seen, idx);
+  cp_ippl_hash_insert(list, idx);
+  if( list->trie_af != 0 )
+    cp_ippl_trie_insert(list, &ipp->addr, ipp->prefix);
   if( idx_p )
-    *idx_p = list->used;
-  cp_row_mask_set(list->seen, list->used);
-  memcpy(cp_ippl_entry(list, list->used++), ipp, list->stride);
-
-  if( ! list->in_dump )
-    cp_ippl_sort(list);
+    *idx_p = idx;
 
   CP_IPPL_ASSERT_VALID(list);
   return true;
@@ -102,8 +517,7 @@ void cp_ippl_print(struct cp_session* s,
 {
   int i;
 
-  cp_print(s, "  allocated/used/sorted: %d / %d / %d",
-           list->max, list->used, list->sorted);
+  cp_print(s, "  allocated/used: %d / %d", list->max, list->used);
   for( i = 0; i < list->used; i++ )
     cb(s, i, cp_ippl_entry(list, i));
 }
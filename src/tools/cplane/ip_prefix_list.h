@@ -23,14 +23,34 @@ struct cp_ip_with_prefix {
   };
 };
 
-/* compare function suitable to passing to bsearch & qsort.
+/* compare function in the style of qsort.  Entries which compare equal
+ * are the same entry of the list; cp_ippl_lpm() prefers the entry which
+ * comes first in this order.
  * Must return b->prefix - a->prefix if it is non-zero (i.e. longer
- * prefixes should be sorted first).
+ * prefixes come first).
  * See also cp_ippl_compare(), which fits for the most ip-prefix lists.
  */
 typedef int (*cp_ipp_compare_fn_t)(const void *void_a, const void *void_b);
 
-/* List of ip/prefix entries; can be updated and sorted if needed. */
+/* Node of the binary trie which cp_ippl_get_prefix() walks.  The trie is
+ * path-compressed: an inner node is only kept where the addresses below it
+ * start to differ, so there are fewer than two nodes per address.  A leaf
+ * stands for all the entries with its address. */
+struct cp_ippl_trie_node {
+  /* For a leaf, its address; for an inner node, the address of any leaf
+   * below it, which gives the bits all the leaves below it share. */
+  ci_addr_sh_t addr;
+  /* For an inner node, the first bit where its children differ; -1 for a
+   * leaf. */
+  int16_t bit;
+  /* Longest prefix of all the entries below this node */
+  int16_t max_prefix;
+  cicp_mac_rowid_t child[2];
+};
+
+/* List of ip/prefix entries.  The entries are not kept in any order: new
+ * entries are appended, and the last entry is moved into the place of a
+ * removed one.  Entries are found through the hash. */
 struct cp_ip_prefix_list {
   /* an array of structures starting with cp_ip_with_prefix  */
   void* list;
@@ -39,14 +59,33 @@ struct cp_ip_prefix_list {
 
   cp_ipp_compare_fn_t compare;
   cp_row_mask_t seen;  /* which entries we've seen during this dump? */
-  cicp_rowid_t max;    /* allocated array size */
-  cicp_rowid_t used;   /* number of entries in use */
-  cicp_rowid_t sorted; /* number of sorted entries */
+  cicp_mac_rowid_t max;    /* allocated array size */
+  cicp_mac_rowid_t used;   /* number of entries in use */
+
+  /* Open-addressing hash of entry indices by address, so that entries are
+   * found without scanning the list.  It is updated in place when entries
+   * are added or removed, and rebuilt only when the list grows.
+   *
+   * If hash_by_prefix is set, addresses are hashed after masking with the
+   * entry's prefix length, and prefixes[] has a bit for each prefix length
+   * in use, which makes cp_ippl_lpm() possible. */
+  cicp_mac_rowid_t* hash;
+  cicp_mac_rowid_t hash_mask;
+  bool hash_by_prefix;
+  uint64_t prefixes[3];
+
+  /* Binary trie of the addresses in the list, if trie_af is non-zero.  It
+   * is updated together with the hash.  Freed nodes are chained through
+   * child[0] from trie_free. */
+  int trie_af;
+  struct cp_ippl_trie_node* trie;
+  cicp_mac_rowid_t trie_root;
+  cicp_mac_rowid_t trie_used;
+  cicp_mac_rowid_t trie_max;
+  cicp_mac_rowid_t trie_free;
 };
 #define CP_IPPL_ASSERT_VALID(list) \
-  ci_assert_le((list)->sorted, (list)->used);   \
-  ci_assert_le((list)->used, (list)->max);      \
-  ci_assert_impl(!(list)->in_dump, (list)->used == (list)->sorted);
+  ci_assert_le((list)->used, (list)->max);
 
 static inline struct cp_ip_with_prefix*
 cp_ippl_entry(struct cp_ip_prefix_list* list, int idx)
@@ -61,6 +100,8 @@ cp_ippl_idx(struct cp_ip_prefix_list* list, struct cp_ip_with_prefix* entry)
 }
 
 int cp_ippl_compare(const void *void_a, const void *void_b);
+void cp_ippl_hash_rebuild(struct cp_ip_prefix_list* list);
+void cp_ippl_remove(struct cp_ip_prefix_list* list, int idx);
 static inline void
 cp_ippl_init(struct cp_ip_prefix_list* list, size_t stride,
              cp_ipp_compare_fn_t compare, cicp_rowid_t size)
@@ -71,15 +112,34 @@ cp_ippl_init(struct cp_ip_prefix_list* list, size_t stride,
   ci_assert(list->list);
   list->seen = cp_row_mask_alloc(size);
   list->max = size;
-  list->used = list->sorted = 0;
+  list->used = 0;
   list->in_dump = false;
+  list->hash = NULL;
+  list->hash_mask = 0;
+  list->hash_by_prefix = false;
+  list->trie_af = 0;
+  list->trie = NULL;
+  list->trie_root = -1;
+  list->trie_used = list->trie_max = 0;
+  list->trie_free = -1;
 
   int i;
   for( i = 0; i < size; i++ )
     cp_ippl_entry(list, i)->sort_by = -1;
+  cp_ippl_hash_rebuild(list);
   CP_IPPL_ASSERT_VALID(list);
 }
 
+/* Keep a trie of the addresses in the list, to make cp_ippl_get_prefix()
+ * independent of the list size.  All the addresses must be of family af. */
+static inline void
+cp_ippl_enable_trie(struct cp_ip_prefix_list* list, int af)
+{
+  ci_assert(!list->hash_by_prefix);
+  ci_assert_equal(list->used, 0);
+  list->trie_af = af;
+}
+
 typedef void (*cp_ippl_print_callback)(struct cp_session* s, int i,
                                        struct cp_ip_with_prefix*);
 void cp_ippl_print_cb_ip_prefix(struct cp_session* s, int i,
@@ -89,20 +149,15 @@ void cp_ippl_print(struct cp_session* s,
                    cp_ippl_print_callback cb);
 bool cp_ippl_add(struct cp_ip_prefix_list* list,
                  struct cp_ip_with_prefix* ipp, int* idx_p);
-static inline void
-cp_ippl_sort(struct cp_ip_prefix_list* list)
-{
-  qsort(list->list, list->used, list->stride, list->compare);
-
-  /* Check that the last entries are really used */
-  while( list->used > 0 &&
-         cp_ippl_entry(list, list->used - 1)->sort_by == -1 )
-    list->used--;
-
-  list->sorted = list->used;
-  CP_IPPL_ASSERT_VALID(list);
-}
-
+/* Iterate over the entries for which [compare] returns 0 against [ipp].
+ * [compare] must only match entries with the same hash key as [ipp],
+ * i.e. with the same address, or the same masked address and prefix if
+ * hash_by_prefix is set.  *iter must be -1 for the first call.  The list
+ * must not change between the calls. */
+struct cp_ip_with_prefix*
+cp_ippl_search_next(struct cp_ip_prefix_list* list,
+                    struct cp_ip_with_prefix* ipp,
+                    cp_ipp_compare_fn_t compare, cicp_mac_rowid_t* iter);
 struct cp_ip_with_prefix*
 __cp_ippl_search(struct cp_ip_prefix_list* list,
                  struct cp_ip_with_prefix* ipp,
@@ -114,6 +169,16 @@ cp_ippl_search(struct cp_ip_prefix_list* list,
   return __cp_ippl_search(list, ipp, list->compare);
 }
 
+/* Longest-prefix match.  Returns the entry with the longest prefix which
+ * covers [addr] and for which [match] returns true; among several such
+ * entries with the same prefix, the one which comes first in the order of
+ * list->compare.
+ * The list must have hash_by_prefix set. */
+typedef bool (*cp_ippl_match_fn_t)(struct cp_ip_with_prefix* ipp, void* arg);
+struct cp_ip_with_prefix*
+cp_ippl_lpm(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr,
+            cp_ippl_match_fn_t match, void* arg);
+
 /* The "entry" parameter should be the pointer to the member list.  I.e.
  * it is something returned by cp_ippl_search(). */
 static inline void
@@ -121,23 +186,7 @@ cp_ippl_del(struct cp_ip_prefix_list* list,
             struct cp_ip_with_prefix* entry)
 {
   CP_IPPL_ASSERT_VALID(list);
-  int idx = cp_ippl_idx(list, entry);
-  ci_assert_ge(idx, 0);
-  ci_assert_lt(idx, list->max);
-
-  entry->addr = addr_sh_any;
-  entry->sort_by = -1;
-
-  if( ! list->in_dump ) {
-    cp_ippl_sort(list);
-  }
-  else {
-    /* mark it as "not seen" */
-    if( list->sorted > idx )
-      list->sorted = idx;
-    cp_row_mask_unset(list->seen, idx);
-  }
-
+  cp_ippl_remove(list, cp_ippl_idx(list, entry));
   CP_IPPL_ASSERT_VALID(list);
 }
 
@@ -149,31 +198,24 @@ static inline bool cp_ippl_finalize(struct cp_session* s,
                                     struct cp_ip_prefix_list* list,
                                     cp_ippl_finalize_callback cb)
 {
-  cicp_rowid_t id = -1;
-  cicp_rowid_t removed = 0;
+  cicp_mac_rowid_t id;
+  cicp_mac_rowid_t removed = 0;
 
   ci_assert(list->in_dump);
 
   CP_IPPL_ASSERT_VALID(list);
-  while( (id =
-         cp_row_mask_iter_set(list->seen, ++id, list->used, false) ) !=
-         CICP_MAC_ROWID_BAD ) {
-    struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, id);
-    if( ipp->sort_by < 0 )
-      break;
+  /* Go backwards, so that the entry which cp_ippl_remove() moves into the
+   * freed place has already been seen. */
+  for( id = list->used - 1; id >= 0; id-- ) {
+    if( cp_row_mask_get(list->seen, id) )
+      continue;
 
     if( cb != NULL )
-      cb(s, ipp);
-
-    /* We'll push this entry to the end with qsort(). */
-    ipp->addr = addr_sh_any;
-    ipp->sort_by = -1;
+      cb(s, cp_ippl_entry(list, id));
+    cp_ippl_remove(list, id);
     removed++;
   }
 
-  if( removed != 0 || list->used != list->sorted )
-    cp_ippl_sort(list);
-
   list->in_dump = false;
   CP_IPPL_ASSERT_VALID(list);
   return removed != 0;
@@ -185,7 +227,7 @@ cp_ippl_start_dump(struct cp_ip_prefix_list* list)
 {
   ci_assert(!list->in_dump);
   CP_IPPL_ASSERT_VALID(list);
-  cp_row_mask_init(list->seen, list->sorted);
+  cp_row_mask_init(list->seen, list->used);
   list->in_dump = true;
 }
 
@@ -233,6 +275,9 @@ cp_ipx_ippl_pfx_get(int af, ci_addr_sh_t addr1, ci_addr_sh_t addr2)
   return cp_ipx_clz(af, ci_ipx_addr_xor(af, &addr1, &addr2));
 }
 
+cicp_prefixlen_t
+cp_ippl_trie_get_prefix(struct cp_ip_prefix_list* list, ci_addr_sh_t addr);
+
 /*
  * Calculate the prefix-length at which an entry should be added to the
  * route table.  This is equal to the maximum of
@@ -244,7 +289,7 @@ static inline cicp_prefixlen_t
 cp_ippl_get_prefix(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr)
 {
   cicp_prefixlen_t len;
-  cicp_rowid_t id;
+  cicp_mac_rowid_t id;
 
   /* INADDR_ANY has special meaning in many contexts.  Assume that
    * 0.0.0.0/32 is the first entry in any list.
@@ -257,6 +302,11 @@ cp_ippl_get_prefix(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr)
     return CI_IPX_MAX_PREFIX_LEN(af);
   len = cp_ipx_clz(af, addr) + 1;
 
+  if( list->trie_af != 0 ) {
+    ci_assert_equal(list->trie_af, af);
+    return CI_MAX(len, cp_ippl_trie_get_prefix(list, addr));
+  }
+
   for( id = 0; id < list->used; id++ ) {
     struct cp_ip_with_prefix* ipp = cp_ippl_entry(list, id);
     cicp_prefixlen_t l;
@@ -266,10 +316,6 @@ cp_ippl_get_prefix(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr)
       l = cp_ipx_ippl_pfx_get(af, addr, ipp->addr) + 1;
     if( l > len )
       len = l;
-    if( len >= ipp->prefix && id < list->sorted )
-      /* We can skip sorted part of the table as no further entry will have
-       * longer prefix, however we still need to go through unsorted bit */
-      id = list->sorted - 1; /* - 1 is due to following id++ */
   }
 
   return len;
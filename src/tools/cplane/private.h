@@ -731,14 +731,26 @@ static inline int cp_fwd_change_done(struct cp_fwd_row* s)
   return 1;
 }
 
+/* Finish the second pass of an update.  The data it has rewritten is not
+ * the one readers use, so there is no need to move the version again: a
+ * reader retries at most once per update. */
+static inline void cp_fwd_change_synced(struct cp_fwd_row* s)
+{
+  s->flags &= ~CICP_FWD_FLAG_CHANGES_STARTED;
+}
+
 static inline struct cp_fwd_data*
 cp_get_fwd_data_scratch(struct cp_fwd_row* r)
 {
   return &r->data[(*cp_fwd_version(r) & 1) ^ 1];
 }
 
+/* The data is updated in two passes: the first one fills the copy readers
+ * do not use and publishes it with a version bump, the second one brings
+ * the other copy in sync. */
 #define FWD_UPDATE_LOOP(fwd_data_, fwd_, ver_i_) \
   { \
+    int fwd_update_published_ = 0; \
     cp_fwd_verify_identical((fwd_)); \
     ci_assert_nflags((fwd_)->flags, CICP_FWD_FLAG_CHANGES_STARTED); \
     for( (ver_i_) = 0; (ver_i_) < 2; ++(ver_i_) ) { \
@@ -747,8 +759,13 @@ cp_get_fwd_data_scratch(struct cp_fwd_row* r)
 
 #define FWD_UPDATE_LOOP_END(fwd_) \
       } while(0); \
+      if( fwd_update_published_ ) { \
+        cp_fwd_change_synced((fwd_)); \
+        break; \
+      } \
       if( ! cp_fwd_change_done((fwd_)) ) \
         break; /* no work has been done */ \
+      fwd_update_published_ = 1; \
     } \
     cp_fwd_verify_identical((fwd_)); \
   }
@@ -111,11 +111,14 @@
  * When cplane updates a fwd entry, it performs it in following sequence:
  * - update non-active data structure;
  * - move verlock;
- * - update another data structure;
- * - move verlock again.
- * The last step does not look necessary, but it is easier to code this
- * all.  For example in some cases cplane updates verlock without any
- * update to the data itself (see sections 1 and 7).
+ * - update another data structure.
+ * The second copy is not in use by the time it is updated, so the verlock
+ * is not moved again: a user who catches an update under their feet
+ * retries once, and the retry reads data which stays stable until the
+ * next update.  All changes made to an entry in one FWD_UPDATE_LOOP are
+ * published by the same verlock move.  In some cases cplane moves verlock
+ * without any update to the data itself (see sections 1 and 7); this is
+ * fine because both copies are identical outside of an update.
  *
  *
  * 4. Hash table
@@ -301,10 +304,6 @@ cp_route_del(struct cp_session* s, uint32_t table_id,
   bool changed = false;
   bool multipath = false;
   do {
-    /* In theory, we can so something similar to cp_route_add() and
-     * leverage ordering of the route list.  But for del() it is trickier
-     * than for add(), because we really have to handle non-ordered case
-     * when the route table is in_dump. */
     struct cp_ip_with_prefix* dst = __cp_ippl_search(&table->routes,
                                                      &route->dst,
                                                      cp_route_cmp_multipath);
@@ -329,6 +328,25 @@ cp_route_entry_by_idx(struct cp_route_table* table, int idx)
   return cp_route_entry_from_dst(cp_ippl_entry(&table->routes, idx));
 }
 
+/* The path of a multipath route which comes after [route] in the order of
+ * weight.end, or NULL if there is none. */
+static struct cp_route*
+cp_route_next_path(struct cp_route_table* table, struct cp_route* route)
+{
+  struct cp_route* next = NULL;
+  struct cp_ip_with_prefix* dst;
+  cicp_mac_rowid_t iter = -1;
+
+  while( (dst = cp_ippl_search_next(&table->routes, &route->dst,
+                                    cp_route_cmp_multipath, &iter)) ) {
+    struct cp_route* t = cp_route_entry_from_dst(dst);
+    if( t->weight.end > route->weight.end &&
+        (next == NULL || t->weight.end < next->weight.end) )
+      next = t;
+  }
+  return next;
+}
+
 static void
 cp_route2laddr(struct cp_session* s, struct cp_route* route, int af)
 {
@@ -349,6 +367,7 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
     table->id = table_id;
     cp_ippl_init(&table->routes, sizeof(struct cp_route),
                  cp_route_compare, 4);
+    table->routes.hash_by_prefix = true;
     if( cp_routes_under_dump(s,af) )
       cp_ippl_start_dump(&table->routes);
     table->next =
@@ -393,73 +412,50 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
   /* else cp_ippl_add() have already added a new entry with the correct
    * route data */
 
-  /* When we are under dump, the route table may be unsorted, and we
-   * must not sort it.  On the flip side, dumping takes care on removing
-   * all the obsolete routes. */
+  /* When we are under dump, dumping takes care on removing all the
+   * obsolete routes. */
   if( table->routes.in_dump )
     return changed;
 
-  if( key_changed ) {
-    cp_ippl_sort(&table->routes);
-
-    /* Find the just-added route entry again, after sort. */
-    idx = cp_ippl_idx(&table->routes,
-                      cp_ippl_search(&table->routes, &route->dst));
-    entry = cp_route_entry_by_idx(table, idx);
-  }
-  /* else the table is already sorted */
-
   /* We changed the route list.  It may happen that it was a multipath route
    * change, and we have to remove all old-weighted paths from the table.
-   * The next 2 loops heavily use that
-   * - The route list is sorted.
-   * - We always add the full spectrum of the paths, see the code under
-   *   RTA_MULTIPATH below.
-   */
-  key_changed = false;
-  int id;
-  int in_dump = table->routes.in_dump;
-
-  /* Prevent any re-order of the routes now */
-  table->routes.in_dump = true;
+   * This relies on that we always add the full spectrum of the paths, see
+   * the code under RTA_MULTIPATH below.
+   *
+   * Removing a route may move [entry], so work with a copy. */
+  struct cp_route e = *entry;
+  bool last = e.weight.end == 0 ||
+              (e.weight.flag & CP_FWD_MULTIPATH_FLAG_LAST);
+  struct cp_ip_with_prefix* dst;
+  cicp_mac_rowid_t iter = -1;
 
-  /* Remove all entries with smaller "end" and overlapping this entry. */
-  for( id = idx - 1; id >= 0; id--) {
-    struct cp_route* t = cp_route_entry_by_idx(table, id);
-    if( cp_route_cmp_multipath(entry, t) != 0 )
-      break;
-    if( t->weight.end == 0 ) {
-      /* Non-multipath entry is definitely wrong, and definitely the
-       * only one. */
-      cp_ippl_del(&table->routes, &t->dst);
-      key_changed = true;
-      break;
+  key_changed = false;
+  while( (dst = cp_ippl_search_next(&table->routes, &e.dst,
+                                    cp_route_cmp_multipath, &iter)) ) {
+    struct cp_route* t = cp_route_entry_from_dst(dst);
+    bool del;
+
+    if( t->weight.end < e.weight.end ) {
+      /* Remove all entries with smaller "end" and overlapping this entry.
+       * Non-multipath entry is definitely wrong. */
+      del = t->weight.end == 0 ||
+            t->weight.end > e.weight.end - e.weight.val;
     }
-    if( t->weight.end <= entry->weight.end - entry->weight.val )
-      break;
-    cp_ippl_del(&table->routes, &t->dst);
-    key_changed = true;
-  }
-
-  /* In case of the last path, all the other paths for the same route
-   * are old ones.  Remove them! */
-  if( route->weight.end == 0 ||
-      route->weight.flag & CP_FWD_MULTIPATH_FLAG_LAST ) {
-    for( id = idx + 1; id < table->routes.sorted; id++) {
-      struct cp_route* t = cp_route_entry_by_idx(table, id);
-      if( cp_route_cmp_multipath(entry, t) != 0 )
-        break;
-      cp_ippl_del(&table->routes, &t->dst);
+    else {
+      /* In case of the last path, all the other paths for the same route
+       * are old ones.  Remove them! */
+      del = t->weight.end > e.weight.end && last;
+    }
+    if( del ) {
+      cp_ippl_del(&table->routes, dst);
       key_changed = true;
+      /* The list has changed under the iterator */
+      iter = -1;
     }
   }
 
-  table->routes.in_dump = in_dump;
-  if( key_changed ) {
-    if( ! in_dump )
-      cp_ippl_sort(&table->routes);
+  if( key_changed )
     changed = true;
-  }
 
   return changed;
 }
@@ -610,28 +606,28 @@ cp_nl_route_table_update(struct cp_session* s, struct nlmsghdr* nlhdr,
                 CP_SESSION_FLAG_FWD_PREFIX_CHECK_NEEDED;
 }
 
+static bool
+cp_route_tos_match(struct cp_ip_with_prefix* ipp, void* arg)
+{
+  const struct cp_fwd_key* key = arg;
+  struct cp_route* route = CI_CONTAINER(struct cp_route, dst, ipp);
+  return route->tos == 0 || route->tos == key->tos;
+}
+
 static struct cp_route *
 cp_route_find(struct cp_session* s, struct cp_fwd_key* key,
               struct cp_route_table* table, int af)
 {
-  struct cp_ip_with_prefix* ipp = NULL;
-  struct cp_route *route = NULL;
-  int i;
+  struct cp_ip_with_prefix* ipp;
 
-  /* Find the best prefix and metric.
-   * The list is ordered by prefix length, then by metric,
-   * so the first match is the best prefix & metric. */
-  for( i = 0; i < table->routes.used; i++ ) {
-    ipp = cp_ippl_entry(&table->routes, i);
-    route = CI_CONTAINER(struct cp_route, dst, ipp);
-    if( cp_ipx_ippl_pfx_match(af, key->dst, ipp->addr, ipp->prefix) &&
-        (route->tos == 0 || route->tos == key->tos) )
-      break;
-  }
-  if( i == table->routes.used )
+  /* Find the best prefix and metric.  cp_route_compare() orders the
+   * routes of each prefix length by metric, so the first match is the best
+   * metric. */
+  ipp = cp_ippl_lpm(&table->routes, af, key->dst, cp_route_tos_match, key);
+  if( ipp == NULL )
     return NULL;
 
-  return route;
+  return CI_CONTAINER(struct cp_route, dst, ipp);
 }
 
 /* This function finds the preferred source address for a given route.
@@ -935,16 +931,11 @@ cp_route_check_multipath(struct cp_session* s, struct cp_fwd_state* fwd_state,
     nlmsg_seq |= CP_FWD_FLAG_REQ;
     nlmsg_seq &=~ CP_FWD_FLAG_REQ_WAIT;
   }
-  int idx;
+  struct cp_route *t;
   struct cp_fwd_table* fwd_table = &fwd_state->fwd_table;
   struct fwd_iterate_weight_arg w_arg = { .s = s, .w = NULL };
-  for( idx = cp_ippl_idx(&table->routes, &route->dst);
-       idx < table->routes.used;
-       idx++ ) {
-    struct cp_route *t = cp_route_entry_by_idx(table, idx);
-    if( cp_route_cmp_multipath(route, t) != 0 )
-      break;
-
+  /* cp_route_find() returns the first path */
+  for( t = route; t != NULL; t = cp_route_next_path(table, t) ) {
     struct cp_fwd_data_base data;
     cp_route_to_data(s, key, table, t, &data, af);
 
@@ -310,6 +310,10 @@ static void init_files(struct cp_session* s)
   cp_ippl_init(&s->ip6_route_dst, sizeof(struct cp_ip_with_prefix), NULL, 4);
   cp_ippl_init(&s->ip6_rule_src, sizeof(struct cp_ip_with_prefix), NULL, 4);
   cp_ippl_init(&s->laddr, sizeof(struct cp_ip_with_prefix), NULL, 4);
+  cp_ippl_enable_trie(&s->route_dst, AF_INET);
+  cp_ippl_enable_trie(&s->rule_src, AF_INET);
+  cp_ippl_enable_trie(&s->ip6_route_dst, AF_INET6);
+  cp_ippl_enable_trie(&s->ip6_rule_src, AF_INET6);
 }
 
 
@@ -13,6 +13,8 @@
  * There are two tables in the onload implementation:
  *  - An endpoint hash table with a double linked list overlay
  *  - A set of backend endpoint arrays for quick selection
+ *  - A Maglev lookup table per service, sharing the index of the service's
+ *    head backend array, that maps a hash onto a backend in constant time
  *
  * The hash table contains both frontend and backend endpoints.  The backends
  * contain an ci_mib_dllist_link that links them together into a double link
@@ -223,6 +225,68 @@ svc_array_remove(struct cp_session* s, struct cp_mibs* mib,
 }
 
 
+/* Per-backend state while filling a Maglev table */
+struct svc_maglev_perm {
+  ci_uint32 offset;
+  ci_uint32 skip;
+  ci_uint32 next;
+  ci_uint32 slot;
+};
+
+
+/* Rebuild a service's Maglev lookup table from its backend arrays.
+ *
+ * Each backend has its own permutation of the table's slots, derived from a
+ * hash of its address and port.  Backends take turns to claim the next free
+ * slot in their permutation until every slot is taken.  Because the
+ * permutations depend only on the backends themselves, a change to the set of
+ * backends moves few of the slots held by the others. */
+static void
+svc_maglev_build(struct cp_mibs* mib, struct cp_svc_ep_dllist* svc)
+{
+  struct svc_maglev_perm perm[CP_SVC_MAGLEV_SIZE];
+  size_t n_backends = svc->u.service.n_backends;
+  struct cp_svc_maglev* maglev;
+  cicp_rowid_t array_id;
+  unsigned i, n_filled;
+
+  if( n_backends == 0 || n_backends > CP_SVC_MAGLEV_SIZE )
+    return;
+  maglev = &mib->svc_maglev[svc->u.service.head_array_id];
+
+  array_id = svc->u.service.head_array_id;
+  for( i = 0; i < n_backends; ++i ) {
+    unsigned index = i % CP_SVC_BACKENDS_PER_ARRAY;
+    struct cp_svc_endpoint* ep;
+    cicp_mac_rowid_t hash1, hash2;
+
+    if( i != 0 && index == 0 )
+      array_id = mib->svc_arrays[array_id].next;
+    ep = &mib->svc_arrays[array_id].eps[index];
+    cp_calc_svc_hash(0xffff, &ep->addr, ep->port, &hash1, &hash2);
+    perm[i].offset = (ci_uint32) hash1 % CP_SVC_MAGLEV_SIZE;
+    perm[i].skip = (ci_uint32) hash2 % (CP_SVC_MAGLEV_SIZE - 1) + 1;
+    perm[i].next = 0;
+    perm[i].slot = CP_SVC_MAGLEV_SLOT(array_id, index);
+  }
+
+  /* All-ones marks a slot not yet claimed; no backend can have that value */
+  memset(maglev->slots, 0xff, sizeof(maglev->slots));
+  for( n_filled = 0; ; ) {
+    for( i = 0; i < n_backends; ++i ) {
+      unsigned c;
+      do
+        c = (perm[i].offset + perm[i].next++ * perm[i].skip) %
+            CP_SVC_MAGLEV_SIZE;
+      while( maglev->slots[c] != (ci_uint32) -1 );
+      maglev->slots[c] = perm[i].slot;
+      if( ++n_filled == CP_SVC_MAGLEV_SIZE )
+        return;
+    }
+  }
+}
+
+
 static void svc_oof_add(struct cp_session* s, struct cp_svc_ep_dllist* svc)
 {
   int rc;
@@ -397,6 +461,7 @@ cp_svc_backend_add(struct cp_session* s, const cicp_mac_rowid_t svc_id,
         svc_array_append(s, mib, svc, &ep->ep, free_array_id);
 
       svc->u.service.n_backends++;
+      svc_maglev_build(mib, svc);
     }
 
   MIB_UPDATE_LOOP_END(mib, s);
@@ -521,6 +586,7 @@ cp_svc_backend_del(struct cp_session* s, cicp_mac_rowid_t svc_id,
     }
     ci_mib_dllist_remove(mib->dim, &ep->u.backend.link);
     svc->u.service.n_backends--;
+    svc_maglev_build(mib, svc);
 
     svc_hash_ep_del(mib, rowid);
 
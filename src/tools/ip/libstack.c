@@ -1319,6 +1319,22 @@ static void stack_stats_describe(ci_netif* ni)
 static void stack_clear_stats(ci_netif* ni)
 {
   clear_stats(netif_stats_fields, N_NETIF_STATS_FIELDS, &ni->state->stats);
+#if CI_CFG_RX_LATENCY_HIST
+  memset(&ni->state->rx_latency, 0, sizeof(ni->state->rx_latency));
+#endif
+#if CI_CFG_LOCK_PROFILE
+  memset(&ni->state->lock_profile, 0, sizeof(ni->state->lock_profile));
+#endif
+#if CI_CFG_POLL_PROFILE
+  {
+    /* Keep the sampling state of a poll that may be in progress. */
+    ci_netif_poll_profile* pp = &ni->state->poll_profile;
+    pp->n_polls = pp->total_cycles = 0;
+    memset(pp->phase_cycles, 0, sizeof(pp->phase_cycles));
+    memset(pp->ev_cycles, 0, sizeof(pp->ev_cycles));
+    memset(pp->ev_count, 0, sizeof(pp->ev_count));
+  }
+#endif
 }
 
 static void stack_dstats(ci_netif* ni)
@@ -1340,6 +1356,159 @@ static void stack_more_stats(ci_netif* ni)
   ci_dump_stats(more_stats_fields, N_MORE_STATS_FIELDS, &stats, 0, NULL, NULL);
 }
 
+static void stack_rx_latency(ci_netif* ni)
+{
+#if CI_CFG_RX_LATENCY_HIST
+  const ci_netif_rx_latency* lat = &ni->state->rx_latency;
+  const struct {
+    const char* name;
+    const ci_uint64* hist;
+  } hists[] = {
+    { "hw_to_poll", lat->hw_to_poll },
+    { "poll_to_enqueue", lat->poll_to_enqueue },
+    { "enqueue_to_recv", lat->enqueue_to_recv },
+  };
+  unsigned khz = IPTIMER_STATE(ni)->khz;
+  int h, i;
+
+  ci_log("-------------------- rx_latency: %d -------------------------",
+         NI_ID(ni));
+  if( ! NI_OPTS(ni).rx_latency_hist )
+    ci_log("not enabled: set EF_RX_LATENCY_HIST, or set_opt "
+           "rx_latency_hist 1");
+  for( h = 0; h < sizeof(hists) / sizeof(hists[0]); ++h ) {
+    ci_log("%s:", hists[h].name);
+    /* Bucket i holds samples of less than 2^i cycles, except the last. */
+    for( i = 0; i < CI_RX_LATENCY_BUCKETS; ++i ) {
+      if( hists[h].hist[i] == 0 )
+        continue;
+      if( i == CI_RX_LATENCY_BUCKETS - 1 )
+        ci_log("  >= %10lluns: %llu", (1ull << (i - 1)) * 1000000 / khz,
+               (unsigned long long) hists[h].hist[i]);
+      else
+        ci_log("  <  %10lluns: %llu", (1ull << i) * 1000000 / khz,
+               (unsigned long long) hists[h].hist[i]);
+    }
+  }
+#else
+  ci_log("rx_latency: not supported in this build");
+#endif
+}
+
+#if CI_CFG_LOCK_PROFILE
+static int lock_profile_site_cmp(const void* pa, const void* pb)
+{
+  const ci_netif_lock_profile_site* a = *(ci_netif_lock_profile_site**) pa;
+  const ci_netif_lock_profile_site* b = *(ci_netif_lock_profile_site**) pb;
+  return a->hold_cycles < b->hold_cycles ? 1 :
+         a->hold_cycles > b->hold_cycles ? -1 : 0;
+}
+
+/* Upper bound of the hold-time bucket holding the [pct]th percentile. */
+static ci_uint64 lock_profile_pct(const ci_netif_lock_profile_site* site,
+                                  int pct)
+{
+  ci_uint64 total = 0, sum = 0;
+  int i;
+
+  for( i = 0; i < CI_LOCK_PROFILE_BUCKETS; ++i )
+    total += site->hold_hist[i];
+  for( i = 0; i < CI_LOCK_PROFILE_BUCKETS; ++i ) {
+    sum += site->hold_hist[i];
+    if( sum * 100 >= total * pct && sum != 0 )
+      break;
+  }
+  return i >= CI_LOCK_PROFILE_BUCKETS - 1 ? site->hold_max : 1ull << i;
+}
+#endif
+
+static void stack_lock_profile(ci_netif* ni)
+{
+#if CI_CFG_LOCK_PROFILE
+  const ci_netif_lock_profile* lp = &ni->state->lock_profile;
+  const ci_netif_lock_profile_site* sites[CI_LOCK_PROFILE_SITES];
+  ci_uint64 khz = IPTIMER_STATE(ni)->khz;
+  char name[CI_LOCK_PROFILE_FILE_LEN + 8];
+  int i, n = 0;
+
+#define CYC_TO_NS(c)  ((unsigned long long) (c) * 1000000 / khz)
+  for( i = 0; i < CI_LOCK_PROFILE_SITES; ++i )
+    if( lp->sites[i].file[0] != '\0' )
+      sites[n++] = &lp->sites[i];
+  qsort(sites, n, sizeof(sites[0]), lock_profile_site_cmp);
+
+  ci_log("-------------------- lock_profile: %d -----------------------",
+         NI_ID(ni));
+  if( ! NI_OPTS(ni).lock_profile )
+    ci_log("not enabled: set EF_LOCK_PROFILE, or set_opt lock_profile 1");
+  ci_log("%-30s %10s %12s %9s %9s %9s %9s %9s %9s", "site", "locks",
+         "hold_tot_us", "hold_mean", "hold_p50", "hold_p99", "hold_max",
+         "waits", "wait_mean");
+  for( i = 0; i < n; ++i ) {
+    const ci_netif_lock_profile_site* s = sites[i];
+    snprintf(name, sizeof(name), "%.*s:%u", CI_LOCK_PROFILE_FILE_LEN,
+             s->file, s->line);
+    ci_log("%-30s %10llu %12llu %9llu %9llu %9llu %9llu %9u %9llu", name,
+           (unsigned long long) s->n_locks, CYC_TO_NS(s->hold_cycles) / 1000,
+           s->n_locks ? CYC_TO_NS(s->hold_cycles / s->n_locks) : 0,
+           CYC_TO_NS(lock_profile_pct(s, 50)),
+           CYC_TO_NS(lock_profile_pct(s, 99)), CYC_TO_NS(s->hold_max),
+           s->n_waits,
+           s->n_waits ? CYC_TO_NS(s->wait_cycles / s->n_waits) : 0);
+  }
+  if( lp->n_unrecorded )
+    ci_log("%u locks not recorded: table full", lp->n_unrecorded);
+  ci_log("Times are in ns unless stated; percentiles are bucket upper bounds.");
+#undef CYC_TO_NS
+#else
+  ci_log("lock_profile: not supported in this build");
+#endif
+}
+
+static void stack_poll_profile(ci_netif* ni)
+{
+#if CI_CFG_POLL_PROFILE
+  static const char* const phases[CI_POLL_PHASE_N] = {
+    "evq", "post_poll", "rx_refill", "tx_push", "loopback", "timers", "other"
+  };
+  static const char* const evs[CI_POLL_EV_N] = {
+    "rx", "tx", "rx_discard", "other"
+  };
+  ci_netif_poll_profile pp;
+  ci_uint64 khz = IPTIMER_STATE(ni)->khz;
+  ci_uint64 total;
+  int i;
+
+#define CYC_TO_NS(c)  ((unsigned long long) (c) * 1000000 / khz)
+  memcpy(&pp, &ni->state->poll_profile, sizeof(pp));
+  total = pp.total_cycles ? pp.total_cycles : 1;
+
+  ci_log("-------------------- poll_profile: %d -----------------------",
+         NI_ID(ni));
+  if( ! NI_OPTS(ni).poll_profile )
+    ci_log("not enabled: set EF_POLL_PROFILE, or set_opt poll_profile N");
+  ci_log("sampled polls: %llu  mean: %lluns", (unsigned long long) pp.n_polls,
+         pp.n_polls ? CYC_TO_NS(pp.total_cycles / pp.n_polls) : 0);
+  ci_log("%-12s %14s %6s %12s", "phase", "total_us", "pct", "per_poll_ns");
+  for( i = 0; i < CI_POLL_PHASE_N; ++i )
+    ci_log("%-12s %14llu %5llu%% %12llu", phases[i],
+           CYC_TO_NS(pp.phase_cycles[i]) / 1000,
+           (unsigned long long) (pp.phase_cycles[i] * 100 / total),
+           pp.n_polls ? CYC_TO_NS(pp.phase_cycles[i] / pp.n_polls) : 0);
+  ci_log("%-12s %14s %12s %12s", "event", "count", "total_us", "per_ev_ns");
+  for( i = 0; i < CI_POLL_EV_N; ++i )
+    ci_log("%-12s %14llu %12llu %12llu", evs[i],
+           (unsigned long long) pp.ev_count[i],
+           CYC_TO_NS(pp.ev_cycles[i]) / 1000,
+           pp.ev_count[i] ? CYC_TO_NS(pp.ev_cycles[i] / pp.ev_count[i]) : 0);
+  ci_log("RX protocol processing lags by one packet, so is charged to the "
+         "next event.");
+#undef CYC_TO_NS
+#else
+  ci_log("poll_profile: not supported in this build");
+#endif
+}
+
 static void stack_more_stats_describe(ci_netif* ni)
 {
   more_stats_t stats;
@@ -2209,6 +2378,11 @@ static void stack_universe(ci_netif* ni)
   ci_netif_dump_sockets(ni);
   stack_stats(ni);
   stack_more_stats(ni);
+  stack_rx_latency(ni);
+  if( NI_OPTS(ni).lock_profile )
+    stack_lock_profile(ni);
+  if( NI_OPTS(ni).poll_profile )
+    stack_poll_profile(ni);
 
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   stack_ip_stats(ni);
@@ -2237,6 +2411,11 @@ static void stack_lots(ci_netif* ni)
   ci_netif_dump_sockets(ni);
   stack_stats(ni);
   stack_more_stats(ni);
+  stack_rx_latency(ni);
+  if( NI_OPTS(ni).lock_profile )
+    stack_lock_profile(ni);
+  if( NI_OPTS(ni).poll_profile )
+    stack_poll_profile(ni);
 
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   stack_ip_stats(ni);
@@ -2303,6 +2482,229 @@ static void stack_vi_stats(ci_netif* ni)
   ci_netif_dump_vi_stats(ni);
 }
 
+/* Return true if arg is a TCP connection in a state that can pass data. */
+ci_inline int is_tcp_stream(citp_waitable_obj* wo)
+{
+  return ( (wo->waitable.state
+            & (CI_TCP_STATE_TCP_CONN | CI_TCP_STATE_NOT_CONNECTED
+               | CI_TCP_STATE_SYNCHRONISED))
+           == (CI_TCP_STATE_TCP_CONN | CI_TCP_STATE_SYNCHRONISED) );
+}
+
+/* State kept between samples by "top", per stack. */
+typedef struct {
+  ci_uint32  key;     /* identifies the connection, 0 if not a TCP stream */
+  ci_uint32  rx, tx;  /* rcv_nxt and snd_nxt at the last sample */
+} top_sock_state_t;
+
+typedef struct {
+  ci_uint32  rx_evs;
+  ci_uint32  tx_pkts;
+  ci_uint32  tx_bytes;
+  ci_uint32  retransmits;
+  ci_uint32  lock_waits;
+  ci_uint64  lock_wait_cycles;
+  ci_uint64  poll_cycles;
+  ci_uint64  n_polls;
+  unsigned   n_eps;
+  top_sock_state_t* socks;
+} top_stack_state_t;
+
+/* One line of output for a stack, with the counts for the interval. */
+typedef struct {
+  ci_netif*  ni;
+  ci_uint32  rx_evs, tx_pkts, tx_bytes, retransmits, lock_waits;
+  ci_uint64  lock_wait_cycles, poll_cycles, n_polls, tcp_rx_bytes;
+} top_stack_row_t;
+
+#define TOP_SOCKETS  10
+
+typedef struct {
+  ci_netif*  ni;
+  int        id;
+  ci_uint32  rx, tx;
+} top_sock_row_t;
+
+
+static void top_sock_insert(top_sock_row_t* top, int* n_top,
+                            const top_sock_row_t* row)
+{
+  int i;
+  ci_uint64 load = (ci_uint64) row->rx + row->tx;
+
+  if( load == 0 )
+    return;
+  for( i = *n_top; i > 0; --i ) {
+    if( (ci_uint64) top[i - 1].rx + top[i - 1].tx >= load )
+      break;
+    if( i < TOP_SOCKETS )
+      top[i] = top[i - 1];
+  }
+  if( i < TOP_SOCKETS ) {
+    top[i] = *row;
+    if( *n_top < TOP_SOCKETS )
+      ++*n_top;
+  }
+}
+
+
+/* Take a sample of [ni], filling in [row] with the change since the
+ * previous one, and offer its busiest sockets to [top]. */
+static void top_sample(ci_netif* ni, top_stack_state_t* st,
+                       top_stack_row_t* row, top_sock_row_t* top, int* n_top)
+{
+  const ci_netif_stats* stats = &ni->state->stats;
+  ci_uint32 tx_pkts = 0, tx_bytes = 0;
+  top_sock_row_t sock_row;
+  unsigned id, n_eps;
+  int intf_i;
+
+  for( intf_i = 0; intf_i < oo_stack_intf_max(ni); ++intf_i ) {
+    tx_pkts += ni->state->nic[intf_i].tx_dmaq_done_seq;
+    tx_bytes += ni->state->nic[intf_i].tx_bytes_removed;
+  }
+
+  memset(row, 0, sizeof(*row));
+  row->ni = ni;
+  row->rx_evs = stats->rx_evs - st->rx_evs;
+  row->tx_pkts = tx_pkts - st->tx_pkts;
+  row->tx_bytes = tx_bytes - st->tx_bytes;
+  row->retransmits = stats->retransmits - st->retransmits;
+  row->lock_waits = stats->stack_lock_waits - st->lock_waits;
+  row->lock_wait_cycles = stats->stack_lock_wait_cycles -
+                          st->lock_wait_cycles;
+  st->rx_evs = stats->rx_evs;
+  st->tx_pkts = tx_pkts;
+  st->tx_bytes = tx_bytes;
+  st->retransmits = stats->retransmits;
+  st->lock_waits = stats->stack_lock_waits;
+  st->lock_wait_cycles = stats->stack_lock_wait_cycles;
+#if CI_CFG_POLL_PROFILE
+  row->poll_cycles = ni->state->poll_profile.total_cycles - st->poll_cycles;
+  row->n_polls = ni->state->poll_profile.n_polls - st->n_polls;
+  st->poll_cycles = ni->state->poll_profile.total_cycles;
+  st->n_polls = ni->state->poll_profile.n_polls;
+#endif
+
+  n_eps = ni->state->n_ep_bufs;
+  if( n_eps > st->n_eps ) {
+    CI_TEST(st->socks = realloc(st->socks, n_eps * sizeof(st->socks[0])));
+    memset(st->socks + st->n_eps, 0,
+           (n_eps - st->n_eps) * sizeof(st->socks[0]));
+    st->n_eps = n_eps;
+  }
+
+  for( id = 0; id < n_eps; ++id ) {
+    citp_waitable_obj* wo = ID_TO_WAITABLE_OBJ(ni, id);
+    top_sock_state_t* ss = &st->socks[id];
+    ci_uint32 key, rx, tx;
+
+    if( ! is_tcp_stream(wo) ) {
+      ss->key = 0;
+      continue;
+    }
+    key = tcp_raddr_be32(&wo->tcp) ^
+          ((ci_uint32) tcp_rport_be16(&wo->tcp) << 16 |
+           tcp_lport_be16(&wo->tcp));
+    key |= 1;
+    rx = tcp_rcv_nxt(&wo->tcp);
+    tx = tcp_snd_nxt(&wo->tcp);
+    if( ss->key == key ) {
+      sock_row.ni = ni;
+      sock_row.id = id;
+      sock_row.rx = SEQ_SUB(rx, ss->rx);
+      sock_row.tx = SEQ_SUB(tx, ss->tx);
+      row->tcp_rx_bytes += sock_row.rx;
+      top_sock_insert(top, n_top, &sock_row);
+    }
+    ss->key = key;
+    ss->rx = rx;
+    ss->tx = tx;
+  }
+}
+
+
+static int top_stack_row_cmp(const void* pa, const void* pb)
+{
+  const top_stack_row_t* a = pa;
+  const top_stack_row_t* b = pb;
+  ci_uint64 la = (ci_uint64) a->rx_evs + a->tx_pkts;
+  ci_uint64 lb = (ci_uint64) b->rx_evs + b->tx_pkts;
+  return la < lb ? 1 : la > lb ? -1 : 0;
+}
+
+
+static void stack_top(ci_netif* ni_unused)
+{
+  top_stack_state_t* state;
+  top_stack_row_t* rows;
+  top_sock_row_t top[TOP_SOCKETS];
+  struct timeval prev, now;
+  int n_top, n_rows, i, first = 1;
+  double sec;
+  netif_t* n;
+
+  CI_TEST(state = calloc(stacks_size, sizeof(state[0])));
+  CI_TEST(rows = calloc(stacks_size, sizeof(rows[0])));
+  gettimeofday(&prev, NULL);
+
+  while( 1 ) {
+    n_top = n_rows = 0;
+    CI_DLLIST_FOR_EACH2(netif_t, n, link, &stacks_list)
+      top_sample(&n->ni, &state[NI_ID(&n->ni)], &rows[n_rows++], top, &n_top);
+    gettimeofday(&now, NULL);
+    sec = (now.tv_sec - prev.tv_sec) + (now.tv_usec - prev.tv_usec) / 1e6;
+    prev = now;
+
+    if( ! first ) {
+      qsort(rows, n_rows, sizeof(rows[0]), top_stack_row_cmp);
+      if( isatty(STDOUT_FILENO) )
+        ci_log_nonl("\033[H\033[J");
+      ci_log("onload top: %d stacks, %.2fs interval", n_rows, sec);
+      ci_log(" ");
+      ci_log("%-5s %-16s %10s %10s %9s %9s %8s %8s %8s %8s %9s", "stack",
+             "name", "rx_evs/s", "tx_pkts/s", "tx_MB/s", "rx_MB/s", "retx/s",
+             "lkwait/s", "wait_us", "poll_ns", "free_pkts");
+      for( i = 0; i < n_rows; ++i ) {
+        const top_stack_row_t* r = &rows[i];
+        unsigned khz = IPTIMER_STATE(r->ni)->khz;
+        char poll_ns[16];
+        if( r->n_polls )
+          snprintf(poll_ns, sizeof(poll_ns), "%llu", (unsigned long long)
+                   (r->poll_cycles / r->n_polls * 1000000 / khz));
+        else
+          strcpy(poll_ns, "-");
+        ci_log("%-5d %-16.16s %10.0f %10.0f %9.2f %9.2f %8.0f %8.0f %8.1f "
+               "%8s %9d", NI_ID(r->ni), r->ni->state->name,
+               r->rx_evs / sec, r->tx_pkts / sec, r->tx_bytes / sec / 1e6,
+               r->tcp_rx_bytes / sec / 1e6, r->retransmits / sec,
+               r->lock_waits / sec,
+               r->lock_waits ?
+                 (double) r->lock_wait_cycles / r->lock_waits * 1000 / khz : 0,
+               poll_ns, r->ni->packets->n_free);
+      }
+      ci_log(" ");
+      ci_log("%-12s %-21s %10s %10s %9s %9s", "socket", "remote", "rx_KB/s",
+             "tx_KB/s", "sendq", "recvq");
+      for( i = 0; i < n_top; ++i ) {
+        ci_tcp_state* ts = ID_TO_TCP(top[i].ni, top[i].id);
+        ci_uint32 raddr = tcp_raddr_be32(ts);
+        char sock[16], remote[32];
+        snprintf(sock, sizeof(sock), "%d:%d", NI_ID(top[i].ni), top[i].id);
+        snprintf(remote, sizeof(remote), CI_IP_PRINTF_FORMAT ":%u",
+                 CI_IP_PRINTF_ARGS(&raddr),
+                 (unsigned) CI_BSWAP_BE16(tcp_rport_be16(ts)));
+        ci_log("%-12s %-21s %10.1f %10.1f %9u %9u", sock, remote,
+               top[i].rx / sec / 1e3, top[i].tx / sec / 1e3,
+               SEQ_SUB(tcp_enq_nxt(ts), tcp_snd_una(ts)), tcp_rcv_usr(ts));
+      }
+      fflush(stdout);
+    }
+    first = 0;
+    ci_sleep(cfg_watch_msec);
+  }
+}
+
 /**********************************************************************
 ***********************************************************************
 **********************************************************************/
@@ -2346,6 +2748,9 @@ static const stack_op_t stack_ops[] = {
   STACK_OP(clear_stats,        "reset stack statistics"),
   STACK_OP(dstats,             "show derived statistics"),
   STACK_OP(more_stats,         "show more stack statistics"),
+  STACK_OP(rx_latency,         "show receive latency histograms"),
+  STACK_OP(lock_profile,       "show stack lock hold times by call site"),
+  STACK_OP(poll_profile,       "show where stack poll time is spent"),
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   STACK_OP(ip_stats,           "show IP statistics"),
   STACK_OP(tcp_stats,          "show TCP statistics"),
@@ -2362,6 +2767,8 @@ static const stack_op_t stack_ops[] = {
   STACK_OP(timers,             "dump state of stack timers"),
   STACK_OP(filter_table,       "show stack software filter table"),
   STACK_OP_F(filters,          "show stack hardware filters", FL_ONCE),
+  STACK_OP_F(top,              "show the busiest stacks and sockets, "
+                               "refreshing every --msec", FL_ONCE),
 #if CI_CFG_ENDPOINT_MOVE
   STACK_OP_F(clusters,         "show clusters", FL_ONCE),
 #endif
@@ -2598,16 +3005,6 @@ ci_inline unsigned t_usec(void)
 }
 
 
-/* Return true if arg is a TCP connection in a state that can pass data. */
-ci_inline int is_tcp_stream(citp_waitable_obj* wo)
-{
-  return ( (wo->waitable.state
-            & (CI_TCP_STATE_TCP_CONN | CI_TCP_STATE_NOT_CONNECTED
-               | CI_TCP_STATE_SYNCHRONISED))
-           == (CI_TCP_STATE_TCP_CONN | CI_TCP_STATE_SYNCHRONISED) );
-}
-
-
 typedef struct {
   unsigned	rx, tx;
 } sockets_bw_sample_t;
@@ -28,6 +28,7 @@
 #include <pcap.h>
 #include <net/if.h>
 #include <fnmatch.h>
+#include <fcntl.h>
 
 #if 0
 #define LOG_DUMP(x) x
@@ -54,6 +55,13 @@ static int cfg_dump_no_match_only = 0;
 static const char *cfg_precision = "micro";
 static int do_nano = 0;
 
+/* Output format and destination */
+static int cfg_pcapng = 0;
+static const char *cfg_write_file = NULL;
+
+/* Packet sampling: 1 in cfg_sample_every packets, 0 to dump them all */
+static int cfg_sample_every = 0;
+
 /* Interface to dump */
 static const char *cfg_interface = "any";
 static int cfg_ifindex = -1;
@@ -87,6 +95,16 @@ static ci_cfg_desc cfg_opts[] = {
                            "dump only packets not matching onload sockets"},
   {  2, "time-stamp-precision", CI_CFG_STR, &cfg_precision,
                  "set the timestamp precision, default to \"micro\", man tcpdump"},
+  {  3, "pcapng",    CI_CFG_FLAG, &cfg_pcapng,
+                 "write pcapng, with nanosecond timestamps"},
+  {  4, "write-file", CI_CFG_STR, &cfg_write_file,
+                 "write to this file from a writer thread, using large "
+                 "O_DIRECT writes, rather than to stdout"},
+#if CI_CFG_PKT_SAMPLE
+  {  5, "sample",    CI_CFG_UINT, &cfg_sample_every,
+                 "dump the headers of only 1 in N packets, copied by the "
+                 "stack, so that capture can be left running"},
+#endif
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
@@ -150,15 +168,15 @@ static void frc_resync(struct frc_sync* fs)
 }
 
 
-static void pkt_tstamp(const ci_ip_pkt_fmt* pkt, struct timespec* ts_out)
+static void frc_tstamp(ci_uint64 frc, struct timespec* ts_out)
 {
   static struct frc_sync fs;
-  int64_t ns, frc_diff = pkt->tstamp_frc - fs.sync_frc;
+  int64_t ns, frc_diff = frc - fs.sync_frc;
 
   /* This if() triggers on the first call. */
   if( frc_diff > fs.max_frc_diff ) {
     frc_resync(&fs);
-    frc_diff = pkt->tstamp_frc - fs.sync_frc;
+    frc_diff = frc - fs.sync_frc;
   }
 
   *ts_out = fs.sync_ts;
@@ -190,6 +208,21 @@ static void pkt_tstamp(const ci_ip_pkt_fmt* pkt, struct timespec* ts_out)
 }
 
 
+static void pkt_tstamp(const ci_ip_pkt_fmt* pkt, struct timespec* ts_out)
+{
+#if CI_CFG_TIMESTAMPING
+  /* Use the adapter's timestamp when the packet was received with one. */
+  if( (pkt->flags & CI_PKT_FLAG_RX) && pkt->hw_stamp.tv_sec != 0 ) {
+    ts_out->tv_sec = pkt->hw_stamp.tv_sec;
+    ts_out->tv_nsec = pkt->hw_stamp.tv_nsec &
+                      ~CI_IP_PKT_HW_STAMP_FLAG_IN_SYNC;
+    return;
+  }
+#endif
+  frc_tstamp(pkt->tstamp_frc, ts_out);
+}
+
+
 static inline ci_uint8 dump_hwport_val_get(void) {
   return cfg_dump_no_match_only ? OO_INTF_I_DUMP_NO_MATCH :
                                   OO_INTF_I_DUMP_ALL;
@@ -268,8 +301,32 @@ static void stack_dump_on(ci_netif *ni)
         return;
       }
     }
+#if CI_CFG_PKT_SAMPLE
+    if( ni->state->pkt_sample_every != 0 ) {
+      ci_log("ERROR: Onload stack [%d,%s] is already being sampled.",
+             ni->state->stack_id, ni->state->name);
+      stack_detach(stack_attached(ni->state->stack_id), 1);
+      return;
+    }
+#endif
   }
 
+#if CI_CFG_PKT_SAMPLE
+  if( cfg_sample_every ) {
+    /* The stack copies into its ring whatever we do, so start from
+     * whatever it writes next. */
+    ni->state->pkt_sample_snaplen = cfg_snaplen;
+    ni->state->pkt_sample_read_i = ni->state->pkt_sample_write_i;
+    ni->state->pkt_sample_countdown = cfg_sample_every;
+    ci_wmb();
+    ni->state->pkt_sample_every = cfg_sample_every;
+    ci_log("Onload stack [%d,%s]: start sampling 1 in %d packets",
+           ni->state->stack_id, ni->state->name, cfg_sample_every);
+    libstack_netif_unlock(ni);
+    return;
+  }
+#endif
+
   /* No data from other tcpdump processes should be available. */
   ci_assert_equal(ni->state->dump_read_i, ni->state->dump_write_i);
 
@@ -304,30 +361,326 @@ static void stack_dump_on(ci_netif *ni)
 /* Turn dumping off */
 static void stack_dump_off(ci_netif *ni)
 {
+#if CI_CFG_PKT_SAMPLE
+  if( cfg_sample_every ) {
+    ni->state->pkt_sample_every = 0;
+    libstack_netif_lock(ni);
+    ci_log("Onload stack [%d,%s]: stop sampling",
+           ni->state->stack_id, ni->state->name);
+    return;
+  }
+#endif
   memset(ni->state->dump_intf, 0, sizeof(ni->state->dump_intf));
   libstack_netif_lock(ni);
   oo_tcpdump_free_pkts(ni, ni->state->dump_read_i);
   ni->state->dump_read_i = ni->state->dump_write_i;
   ci_log("Onload stack [%d,%s]: stop packet dump",
          ni->state->stack_id, ni->state->name);
+#if CI_CFG_STATS_NETIF
+  /* Packets the stack could not queue for us because we fell behind. */
+  ci_log("Onload stack [%d,%s]: %u packets missed since the stack was "
+         "created", ni->state->stack_id, ni->state->name,
+         ni->state->stats.tcpdump_missed);
+#endif
+}
+
+/* With --write-file, dumped data is gathered into large aligned blocks
+ * which a writer thread writes out, so that the dump loop never waits for
+ * the disk unless the writer falls a whole ring of blocks behind.  Full
+ * blocks, at block-aligned offsets, are what O_DIRECT needs. */
+#define WRITER_BLOCK_SIZE  (1u << 20)
+#define WRITER_N_BLOCKS    16
+#define WRITER_ALIGN       4096
+
+static struct {
+  int              fd;
+  char*            mem;
+  unsigned         fill;         /* bytes in the block being filled */
+  unsigned         filled;       /* blocks handed to the writer thread */
+  unsigned         written;      /* blocks written out */
+  unsigned         stalls;       /* times we had to wait for the writer */
+  pthread_t        thread;
+  pthread_mutex_t  lock;
+  pthread_cond_t   cond;
+} writer = {
+  .fd = -1,
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static ci_uint64 n_dumped;
+
+
+static char* writer_block(unsigned i)
+{
+  return writer.mem + (size_t) (i % WRITER_N_BLOCKS) * WRITER_BLOCK_SIZE;
+}
+
+static void writer_write(const char* buf, size_t len)
+{
+  ssize_t rc;
+
+  while( len > 0 ) {
+    rc = write(writer.fd, buf, len);
+    if( rc < 0 && errno == EINTR )
+      continue;
+    if( rc <= 0 ) {
+      ci_log("Failed to write to %s: %s", cfg_write_file, strerror(errno));
+      _exit(1);
+    }
+    buf += rc;
+    len -= rc;
+  }
+}
+
+static void *writer_thread(void *arg)
+{
+  unsigned i;
+
+  while( 1 ) {
+    pthread_mutex_lock(&writer.lock);
+    while( writer.written == writer.filled )
+      pthread_cond_wait(&writer.cond, &writer.lock);
+    i = writer.written;
+    pthread_mutex_unlock(&writer.lock);
+
+    writer_write(writer_block(i), WRITER_BLOCK_SIZE);
+
+    pthread_mutex_lock(&writer.lock);
+    ++writer.written;
+    pthread_cond_broadcast(&writer.cond);
+    pthread_mutex_unlock(&writer.lock);
+  }
+
+  /* Unreachable */
+  return NULL;
+}
+
+static void writer_open(void)
+{
+  sigset_t sigset, old_sigset;
+
+  writer.fd = open(cfg_write_file, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT,
+                   0644);
+  if( writer.fd < 0 && errno == EINVAL ) {
+    /* Some filesystems (tmpfs, for one) don't do O_DIRECT. */
+    ci_log("%s does not support O_DIRECT, using buffered writes",
+           cfg_write_file);
+    writer.fd = open(cfg_write_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if( writer.fd < 0 ) {
+    ci_log("Failed to open %s: %s", cfg_write_file, strerror(errno));
+    exit(1);
+  }
+  CI_TEST(posix_memalign((void**) &writer.mem, WRITER_ALIGN,
+                         (size_t) WRITER_N_BLOCKS * WRITER_BLOCK_SIZE) == 0);
+
+  /* Signals are handled by the other threads, which finish the file off
+   * with the writer's help. */
+  sigfillset(&sigset);
+  CI_TEST(pthread_sigmask(SIG_BLOCK, &sigset, &old_sigset) == 0);
+  CI_TEST(pthread_create(&writer.thread, NULL, writer_thread, NULL) == 0);
+  CI_TEST(pthread_sigmask(SIG_SETMASK, &old_sigset, NULL) == 0);
+}
+
+/* Hand the current block to the writer thread. */
+static void writer_block_done(void)
+{
+  pthread_mutex_lock(&writer.lock);
+  ++writer.filled;
+  pthread_cond_broadcast(&writer.cond);
+  if( writer.filled - writer.written == WRITER_N_BLOCKS ) {
+    ++writer.stalls;
+    while( writer.filled - writer.written == WRITER_N_BLOCKS )
+      pthread_cond_wait(&writer.cond, &writer.lock);
+  }
+  pthread_mutex_unlock(&writer.lock);
+  writer.fill = 0;
+}
+
+/* Wait for the writer thread, then write the partial last block and trim
+ * the file back to the data. */
+static void writer_close(void)
+{
+  off_t len;
+  unsigned fill;
+
+  if( writer.fd < 0 )
+    return;
+
+  pthread_mutex_lock(&writer.lock);
+  while( writer.written != writer.filled )
+    pthread_cond_wait(&writer.cond, &writer.lock);
+  pthread_mutex_unlock(&writer.lock);
+
+  len = (off_t) writer.written * WRITER_BLOCK_SIZE + writer.fill;
+  fill = CI_ROUND_UP(writer.fill, WRITER_ALIGN);
+  memset(writer_block(writer.written) + writer.fill, 0, fill - writer.fill);
+  writer_write(writer_block(writer.written), fill);
+  if( ftruncate(writer.fd, len) < 0 )
+    ci_log("Failed to truncate %s: %s", cfg_write_file, strerror(errno));
+  close(writer.fd);
+  writer.fd = -1;
+
+  ci_log("Onload tcpdump: %"CI_PRIu64" packets written to %s, %u writer "
+         "stalls", n_dumped, cfg_write_file, writer.stalls);
 }
 
 /* Dump and flush dumped data */
 static void dump_data(const void *data, size_t size)
 {
-  if( fwrite(data, size, 1, stdout) != 1 ) {
-    ci_log("Failed to dump packet data to stdout");
-    exit(1);
+  unsigned n;
+
+  if( writer.fd < 0 ) {
+    if( fwrite(data, size, 1, stdout) != 1 ) {
+      ci_log("Failed to dump packet data to stdout");
+      exit(1);
+    }
+    return;
+  }
+
+  while( size > 0 ) {
+    n = CI_MIN(size, WRITER_BLOCK_SIZE - writer.fill);
+    memcpy(writer_block(writer.filled) + writer.fill, data, n);
+    writer.fill += n;
+    data = (const char*) data + n;
+    size -= n;
+    if( writer.fill == WRITER_BLOCK_SIZE )
+      writer_block_done();
   }
 }
 static void dump_flush(void)
 {
+  if( writer.fd >= 0 )
+    return;
   if( fflush(stdout) == EOF ) {
     ci_log("Failed to flush stdout");
     exit(1);
   }
 }
 
+
+/* pcapng block types and options, from draft-ietf-opsawg-pcapng */
+#define PCAPNG_SHB_TYPE          0x0A0D0D0A
+#define PCAPNG_IDB_TYPE          0x00000001
+#define PCAPNG_EPB_TYPE          0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC  0x1A2B3C4D
+#define PCAPNG_OPT_IF_TSRESOL    9
+
+struct pcapng_epb_hdr {
+  ci_uint32 type;
+  ci_uint32 total_len;
+  ci_uint32 if_id;
+  ci_uint32 ts_high;
+  ci_uint32 ts_low;
+  ci_uint32 caplen;
+  ci_uint32 len;
+};
+
+/* Write the record header for a packet with [caplen] bytes to follow. */
+static void dump_pkt_hdr(const struct timespec* ts, ci_uint32 caplen,
+                         ci_uint32 len)
+{
+  if( cfg_pcapng ) {
+    struct pcapng_epb_hdr epb;
+    ci_uint64 ns = (ci_uint64) ts->tv_sec * 1000000000 + ts->tv_nsec;
+
+    epb.type = PCAPNG_EPB_TYPE;
+    epb.total_len = sizeof(epb) + CI_ROUND_UP(caplen, 4) + 4;
+    epb.if_id = 0;
+    epb.ts_high = ns >> 32;
+    epb.ts_low = ns;
+    epb.caplen = caplen;
+    epb.len = len;
+    dump_data(&epb, sizeof(epb));
+  }
+  else {
+    struct oo_pcap_pkthdr hdr;
+
+    hdr.t.ts.tv_sec = ts->tv_sec;
+    if( do_nano )
+      hdr.t.ts.tv_nsec = ts->tv_nsec;
+    else
+      hdr.t.tv.tv_usec = ts->tv_nsec / 1000;
+    hdr.caplen = caplen;
+    hdr.len = len;
+    dump_data(&hdr, sizeof(hdr));
+  }
+  ++n_dumped;
+}
+
+/* Finish the record for a packet of [caplen] bytes. */
+static void dump_pkt_end(ci_uint32 caplen)
+{
+  if( cfg_pcapng ) {
+    static const ci_uint8 pad[4];
+    ci_uint32 total_len = sizeof(struct pcapng_epb_hdr) +
+                          CI_ROUND_UP(caplen, 4) + 4;
+
+    dump_data(pad, CI_ROUND_UP(caplen, 4) - caplen);
+    dump_data(&total_len, sizeof(total_len));
+  }
+}
+
+#if CI_CFG_PKT_SAMPLE
+static ci_uint64 n_sample_missed;
+
+/* Dump the copies in the sample ring.  The stack never waits for us, so a
+ * slot may be overwritten while we copy it: [seq] tells us when. */
+static void stack_dump_samples(ci_netif *ni)
+{
+  ci_netif_state* ns = ni->state;
+  ci_uint32 read_i = ns->pkt_sample_read_i;
+  ci_uint32 write_i = ns->pkt_sample_write_i;
+  sigset_t sigset;
+
+  if( read_i == write_i )
+    return;
+
+  if( write_i - read_i > CI_CFG_PKT_SAMPLE_RING_LEN ) {
+    n_sample_missed += write_i - read_i - CI_CFG_PKT_SAMPLE_RING_LEN;
+    read_i = write_i - CI_CFG_PKT_SAMPLE_RING_LEN;
+  }
+
+  sigemptyset(&sigset);
+  sigaddset(&sigset, SIGINT);
+  CI_TEST( pthread_sigmask(SIG_BLOCK, &sigset, NULL) == 0 );
+
+  for( ; read_i != write_i; ++read_i ) {
+    const ci_pkt_sample* s;
+    ci_pkt_sample copy;
+    struct timespec ts;
+
+    s = &ns->pkt_sample_ring[read_i % CI_CFG_PKT_SAMPLE_RING_LEN];
+    if( s->seq != read_i ) {
+      ++n_sample_missed;
+      continue;
+    }
+    ci_rmb();
+    memcpy(&copy, (const void*) s, sizeof(copy));
+    ci_rmb();
+    if( s->seq != read_i ) {
+      ++n_sample_missed;
+      continue;
+    }
+
+    if( copy.intf_i == OO_INTF_I_LOOPBACK )
+      memset(copy.data, 0, 2 * ETH_ALEN);
+    frc_tstamp(copy.frc, &ts);
+    LOG_DUMP(ci_log("%u: got ni %d sample len %d caplen %d %s",
+                    read_i, ns->stack_id, copy.len, copy.caplen,
+                    copy.is_tx ? "tx" : "rx"));
+    dump_pkt_hdr(&ts, copy.caplen, copy.len);
+    dump_data(copy.data, copy.caplen);
+    dump_pkt_end(copy.caplen);
+  }
+  ns->pkt_sample_read_i = read_i;
+
+  dump_flush();
+  CI_TEST( pthread_sigmask(SIG_UNBLOCK, &sigset, NULL) == 0 );
+}
+#endif
+
 /* Do dump */
 static void stack_dump(ci_netif *ni)
 {
@@ -337,6 +690,13 @@ static void stack_dump(ci_netif *ni)
   ci_uint16 i, fill_level = ni->state->dump_write_i - read_i;
   sigset_t sigset;
 
+#if CI_CFG_PKT_SAMPLE
+  if( cfg_sample_every ) {
+    stack_dump_samples(ni);
+    return;
+  }
+#endif
+
   if( fill_level == 0 )
     return;
 
@@ -357,9 +717,9 @@ static void stack_dump(ci_netif *ni)
   CI_TEST( pthread_sigmask(SIG_BLOCK, &sigset, NULL) == 0 );
 
   for( i = 0; i < fill_level; ++i, ++read_i ) {
-    struct oo_pcap_pkthdr hdr;
     struct timespec ts;
     int paylen;
+    int caplen;
     int fraglen;
     oo_pkt_p id;
     ci_ip_pkt_fmt *pkt;
@@ -403,20 +763,14 @@ static void stack_dump(ci_netif *ni)
 
     if( do_strip_vlan )
       paylen -= ETH_VLAN_HLEN;
-    hdr.caplen = CI_MIN(cfg_snaplen, paylen);
-    hdr.len = paylen;
+    caplen = CI_MIN(cfg_snaplen, paylen);
     pkt_tstamp(pkt, &ts);
-    hdr.t.ts.tv_sec = ts.tv_sec;
-    if( do_nano )
-      hdr.t.ts.tv_nsec = ts.tv_nsec;
-    else
-      hdr.t.tv.tv_usec = ts.tv_nsec / 1000;
     LOG_DUMP(ci_log("%u: got ni %d pkt %d len %d ref %d",
                     read_i, ni->state->stack_id,
                     OO_PKT_FMT(pkt), paylen, pkt->refcount));
 
-    dump_data(&hdr, sizeof(hdr));
-    fraglen = hdr.caplen;
+    dump_pkt_hdr(&ts, caplen, paylen);
+    fraglen = caplen;
     if( do_strip_vlan ) {
       if( pkt->n_buffers > 1 )
         fraglen = CI_MIN(fraglen, pkt->buf_len - ETH_VLAN_HLEN);
@@ -433,9 +787,10 @@ static void stack_dump(ci_netif *ni)
     /* Dump all scatter-gather chain */
     if( pkt->n_buffers  > 1 ) {
       ci_ip_pkt_fmt *frag = PKT_CHK_NNL(ni, pkt->frag_next);
+      int left = caplen;
       do {
-        hdr.caplen -= fraglen;
-        fraglen = CI_MIN(hdr.caplen, frag->buf_len);
+        left -= fraglen;
+        fraglen = CI_MIN(left, frag->buf_len);
         if( fraglen > 0 )
           dump_data(frag->dma_start, fraglen);
         if( OO_PP_IS_NULL(frag->frag_next) )
@@ -443,6 +798,7 @@ static void stack_dump(ci_netif *ni)
         frag = PKT_CHK_NNL(ni, frag->frag_next);
       } while( frag != NULL );
     }
+    dump_pkt_end(caplen);
   }
 
   /* Ensure we've finished reading before we release. */
@@ -458,6 +814,9 @@ static void stack_dump(ci_netif *ni)
 static void stack_pre_detach(ci_netif *ni)
 {
   memset(ni->state->dump_intf, 0, sizeof(ni->state->dump_intf));
+#if CI_CFG_PKT_SAMPLE
+  ni->state->pkt_sample_every = 0;
+#endif
   ci_wmb();
   stack_dump(ni);
 
@@ -531,9 +890,16 @@ static void atexit_fn(void)
 
   for_each_stack(stack_dump_off, 0);
   libstack_end();
+#if CI_CFG_PKT_SAMPLE
+  if( cfg_sample_every )
+    ci_log("%"CI_PRIu64" samples were overwritten before they were read",
+           n_sample_missed);
+#endif
 
   CI_TRY(oo_fd_close(onload_fd));
 
+  writer_close();
+
   /* Do not use fflush, sice we exit via signal.  All our threads are
    * cancelled, so we are safe here. */
   fflush_unlocked(stdout);
@@ -547,10 +913,63 @@ static void signal_terminate(int sig)
   atexit_fn();
 }
 
+static void write_pcapng_header(void)
+{
+  struct {
+    ci_uint32 type;
+    ci_uint32 total_len;
+    ci_uint32 byte_order_magic;
+    ci_uint16 version_major;
+    ci_uint16 version_minor;
+    ci_int64  section_len;
+    ci_uint32 total_len2;
+  } __attribute__((packed)) shb = {
+    .type = PCAPNG_SHB_TYPE,
+    .total_len = sizeof(shb),
+    .byte_order_magic = PCAPNG_BYTE_ORDER_MAGIC,
+    .version_major = 1,
+    .version_minor = 0,
+    .section_len = -1,
+    .total_len2 = sizeof(shb),
+  };
+  /* One interface for everything, with nanosecond timestamps. */
+  struct {
+    ci_uint32 type;
+    ci_uint32 total_len;
+    ci_uint16 linktype;
+    ci_uint16 reserved;
+    ci_uint32 snaplen;
+    ci_uint16 tsresol_code;
+    ci_uint16 tsresol_len;
+    ci_uint8  tsresol;
+    ci_uint8  tsresol_pad[3];
+    ci_uint32 end_of_opts;
+    ci_uint32 total_len2;
+  } __attribute__((packed)) idb = {
+    .type = PCAPNG_IDB_TYPE,
+    .total_len = sizeof(idb),
+    .linktype = DLT_EN10MB,
+    .snaplen = cfg_snaplen,
+    .tsresol_code = PCAPNG_OPT_IF_TSRESOL,
+    .tsresol_len = 1,
+    .tsresol = 9,
+    .total_len2 = sizeof(idb),
+  };
+
+  dump_data(&shb, sizeof(shb));
+  dump_data(&idb, sizeof(idb));
+  dump_flush();
+}
+
 static void write_pcap_header(void)
 {
   struct pcap_file_header hdr;
 
+  if( cfg_pcapng ) {
+    write_pcapng_header();
+    return;
+  }
+
   if( do_nano )
     hdr.magic = 0xa1b23c4d; //pcap-ns
   else
@@ -690,11 +1109,22 @@ int main(int argc, char* argv[])
     cfg_snaplen = MAXIMUM_SNAPLEN; /* tcpdump compatibility */
   cfg_snaplen = CI_MAX(cfg_snaplen, 80);
   cfg_snaplen = CI_MIN(cfg_snaplen, MAXIMUM_SNAPLEN);
+#if CI_CFG_PKT_SAMPLE
+  if( cfg_sample_every ) {
+    /* The stack copies only the start of each sampled frame, from every
+     * interface. */
+    if( strcmp(cfg_interface, "any") != 0 || cfg_dump_no_match_only )
+      usage("--sample can not be combined with -i or --no-match");
+    cfg_snaplen = CI_MIN(cfg_snaplen, CI_CFG_PKT_SAMPLE_SNAPLEN);
+  }
+#endif
 
   /* Parse interfaces */
   parse_interface();
 
   /* Pcap file header */
+  if( cfg_write_file != NULL )
+    writer_open();
   write_pcap_header();
 
   /* Get the initial seq no of stack list */
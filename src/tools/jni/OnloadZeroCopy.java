@@ -321,7 +321,57 @@ public class OnloadZeroCopy {
    */
   public native static int Send( OnloadZeroCopy[] msgs, int flags,
                                  java.net.Socket socket );
-  
+
+
+  /* Batched methods.
+   * These take parallel arrays of DirectByteBuffers over the packet buffers
+   * and their native handles, rather than OnloadZeroCopy objects, so that a
+   * whole batch costs one JNI crossing and no per-packet Java objects beyond
+   * the ByteBuffers themselves.  Only the fd versions are provided.
+   */
+
+  /** Receive a batch of datagrams without copying.
+   * Fills bufs[] with buffers over the received data, and handles[] with
+   * the handle to release each with.  A datagram larger than one packet
+   * buffer takes one entry per fragment; only the first has a non-zero
+   * handle.  Fragments beyond the end of the arrays are not returned.
+   * The buffers are yours until passed to ReleaseBatch().
+   * NOTE: ZeroCopy receive is only supported for UDP
+   * @param fd      the socket to receive on.
+   * @param flags   ONLOAD_MSG_DONTWAIT and/or ONLOAD_MSG_RECV_OS_INLINE.
+   * @param bufs    filled with the received buffers.
+   * @param handles filled with the handles, at least as long as bufs.
+   * @return the number of entries filled, or a negative error code.
+   */
+  public native static int RecvBatch( int fd, int flags,
+                                      java.nio.ByteBuffer[] bufs,
+                                      long[] handles );
+
+  /** Allocate a batch of buffers for sending - you now own them.
+   * @param fd      the socket that will own these buffers.
+   * @param flags   expects one of ONLOAD_ZC_BUFFER_HDR_*
+   * @param bufs    filled with the new buffers.
+   * @param handles filled with their handles, at least as long as bufs.
+   * @return 0 on success, or a negative error code.
+   */
+  public native static int AllocBatch( int fd, int flags,
+                                       java.nio.ByteBuffer[] bufs,
+                                       long[] handles );
+
+  /** Release the first n handles from RecvBatch() or AllocBatch().
+   * Zero handles are skipped.
+   * @return 0 on success, or a negative error code.
+   */
+  public native static int ReleaseBatch( int fd, long[] handles, int n );
+
+  /** Send the first n buffers from AllocBatch() as one message.
+   * Takes ownership of the buffers, as Send() does.
+   * @param lengths number of bytes to send from the start of each buffer.
+   * @return the number of bytes sent, or a negative error code.
+   */
+  public native static int SendBatch( int fd, java.nio.ByteBuffer[] bufs,
+                                      long[] handles, int[] lengths, int n,
+                                      int flags );  
   /** Simple unit test and example */
   public static void main(String[] args) throws java.net.SocketException,
                                                 java.io.IOException
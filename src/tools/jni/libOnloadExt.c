@@ -928,6 +928,200 @@ Java_OnloadZeroCopy_Send ( JNIEnv* env, jclass cls,
 }
 
 
+/* ********************************************************* */
+/* Batched zerocopy: one JNI crossing per batch of buffers.   */
+/* Buffers are passed as parallel arrays of DirectByteBuffers */
+/* and native handles, with no OnloadZeroCopy object or Java  */
+/* callback per packet.                                       */
+/* ********************************************************* */
+
+struct native_zc_batch {
+	JNIEnv*	env;
+	jobjectArray bufs;
+	jlong* handles;
+	int n;
+	int max;
+};
+
+static enum onload_zc_callback_rc
+native_zerocopy_recv_batch_callback(struct onload_zc_recv_args *args,
+							int flags)
+{
+	struct native_zc_batch* batch;
+	JNIEnv* env;
+	int i;
+
+	batch = (struct native_zc_batch*) args->user_ptr;
+	env = batch->env;
+
+	/* Fragments that don't fit are dropped from the view, but the
+	   datagram is still kept and released through its first handle. */
+	for ( i=0; i<args->msg.msghdr.msg_iovlen && batch->n < batch->max; ++i )
+	{
+		struct onload_zc_iovec* iov = args->msg.iov + i;
+		jobject bb = (*env)->NewDirectByteBuffer(env, iov->iov_base,
+							iov->iov_len);
+		if ( !bb || (*env)->ExceptionOccurred(env) )
+			return i ? ONLOAD_ZC_KEEP | ONLOAD_ZC_TERMINATE :
+				   ONLOAD_ZC_TERMINATE;
+		(*env)->SetObjectArrayElement( env, batch->bufs, batch->n, bb );
+		(*env)->DeleteLocalRef( env, bb );
+		/* Only the first fragment owns the chain. */
+		batch->handles[batch->n++] = i ? 0 : (jlong) iov->buf;
+	}
+	if ( batch->n == batch->max )
+		return ONLOAD_ZC_KEEP | ONLOAD_ZC_TERMINATE;
+	return ONLOAD_ZC_KEEP;
+}
+
+JNIEXPORT jint JNICALL
+Java_OnloadZeroCopy_RecvBatch(JNIEnv* env, jclass cls, jint fd, jint flags,
+				jobjectArray bufs, jlongArray handles)
+{
+	struct onload_zc_recv_args args;
+	struct native_zc_batch batch;
+	jsize max = (*env)->GetArrayLength(env, bufs);
+	int rc;
+
+	if ( max < 1 || (*env)->GetArrayLength(env, handles) < max )
+		return -EINVAL;
+
+	batch.env = env;
+	batch.bufs = bufs;
+	batch.handles = alloca( max * sizeof(jlong) );
+	batch.n = 0;
+	batch.max = max;
+
+	memset( &args, 0, sizeof(args) );
+	args.cb = native_zerocopy_recv_batch_callback;
+	args.user_ptr = &batch;
+	args.flags = flags & ONLOAD_ZC_RECV_FLAGS_MASK;
+
+	rc = onload_zc_recv(fd, &args);
+	/* Whatever we kept is the caller's now, even if the call then failed. */
+	if ( batch.n > 0 ) {
+		(*env)->SetLongArrayRegion( env, handles, 0, batch.n,
+						batch.handles );
+		return batch.n;
+	}
+	return rc;
+}
+
+JNIEXPORT jint JNICALL
+Java_OnloadZeroCopy_AllocBatch(JNIEnv* env, jclass cls, jint fd, jint flags,
+				jobjectArray bufs, jlongArray handles)
+{
+	struct onload_zc_iovec* iovecs;
+	jlong* native_handles;
+	jsize num = (*env)->GetArrayLength(env, bufs);
+	jsize i;
+	int got;
+
+	if ( num < 1 || (*env)->GetArrayLength(env, handles) < num )
+		return -EINVAL;
+
+	iovecs = alloca( num * sizeof(struct onload_zc_iovec) );
+	native_handles = alloca( num * sizeof(jlong) );
+
+	got = onload_zc_alloc_buffers( fd, iovecs, num, flags );
+	if ( got < 0 )
+		return got;
+
+	for ( i=0; i<num; ++i ) {
+		jobject bb = (*env)->NewDirectByteBuffer(env, iovecs[i].iov_base,
+							iovecs[i].iov_len);
+		if ( !bb || (*env)->ExceptionOccurred(env) ) {
+			for ( i=0; i<num; ++i )
+				onload_zc_release_buffers( fd, &iovecs[i].buf, 1 );
+			return -ENOMEM;
+		}
+		(*env)->SetObjectArrayElement( env, bufs, i, bb );
+		(*env)->DeleteLocalRef( env, bb );
+		native_handles[i] = (jlong) iovecs[i].buf;
+	}
+	(*env)->SetLongArrayRegion( env, handles, 0, num, native_handles );
+	return got;
+}
+
+JNIEXPORT jint JNICALL
+Java_OnloadZeroCopy_ReleaseBatch(JNIEnv* env, jclass cls, jint fd,
+				jlongArray handles, jint n)
+{
+	jlong* all;
+	onload_zc_handle* bufs;
+	jsize i;
+	int num = 0;
+
+	if ( n < 0 || (*env)->GetArrayLength(env, handles) < n )
+		return -EINVAL;
+	if ( n == 0 )
+		return 0;
+
+	all = alloca( n * sizeof(jlong) );
+	bufs = alloca( n * sizeof(onload_zc_handle) );
+	(*env)->GetLongArrayRegion( env, handles, 0, n, all );
+	/* Skip the zero handles of trailing fragments from RecvBatch(). */
+	for ( i=0; i<n; ++i )
+		if ( all[i] )
+			bufs[num++] = (onload_zc_handle) all[i];
+
+	return num ? onload_zc_release_buffers( fd, bufs, num ) : 0;
+}
+
+JNIEXPORT jint JNICALL
+Java_OnloadZeroCopy_SendBatch(JNIEnv* env, jclass cls, jint fd,
+				jobjectArray bufs, jlongArray handles,
+				jintArray lengths, jint n, jint flags)
+{
+	struct onload_zc_mmsg instruction;
+	struct onload_zc_iovec* sendBuffer;
+	jlong* native_handles;
+	jint* native_lengths;
+	jsize i;
+	int rval;
+
+	if ( n < 1 || (*env)->GetArrayLength(env, bufs) < n ||
+	     (*env)->GetArrayLength(env, handles) < n ||
+	     (*env)->GetArrayLength(env, lengths) < n )
+		return -EINVAL;
+
+	sendBuffer = alloca( n * sizeof(struct onload_zc_iovec) );
+	native_handles = alloca( n * sizeof(jlong) );
+	native_lengths = alloca( n * sizeof(jint) );
+	(*env)->GetLongArrayRegion( env, handles, 0, n, native_handles );
+	(*env)->GetIntArrayRegion( env, lengths, 0, n, native_lengths );
+
+	for ( i=0; i<n; ++i ) {
+		jobject entry = (*env)->GetObjectArrayElement( env, bufs, i );
+		void* data;
+		if ( !entry )
+			return -EINVAL;
+		data = (*env)->GetDirectBufferAddress( env, entry );
+		if ( !data || native_lengths[i] < 1 ||
+		     native_lengths[i] > (*env)->GetDirectBufferCapacity( env,
+									entry ) )
+			return -EINVAL;
+		(*env)->DeleteLocalRef( env, entry );
+
+		sendBuffer[i].iov_base = data;
+		sendBuffer[i].iov_len = native_lengths[i];
+		sendBuffer[i].buf = (onload_zc_handle) native_handles[i];
+		sendBuffer[i].iov_flags = 0;
+	}
+	/* IMPORTANT - MUST ZERO OUT UNUSED MEMBERS */
+	memset( &instruction, 0, sizeof( struct onload_zc_mmsg ) );
+	instruction.msg.iov = sendBuffer;
+	instruction.msg.msghdr.msg_iovlen = n;
+	instruction.fd = fd;
+
+	rval = onload_zc_send( &instruction, 1, flags );
+	if ( rval >= 0 )
+		rval = instruction.rc;
+
+	return rval;
+}
+
+
 /* ************** */
 /* Templated Send */
 /* ************** */
@@ -6,8 +6,13 @@ FTL_DECLARE(STRUCT_OO_PKTQ)
 FTL_DECLARE(UNION_EFAB_EVENT)
 FTL_DECLARE(STRUCT_EF_EVENTQ_STATE)
 FTL_DECLARE(STRUCT_OO_P_DLLIST)
+FTL_DECLARE(STRUCT_PIO_BUDDY_RESV)
 FTL_DECLARE(STRUCT_PIO_BUDDY_ALLOCATOR)
 FTL_DECLARE(STRUCT_OO_TIMESPEC)
+#if CI_CFG_TX_ADAPTIVE
+FTL_DECLARE(STRUCT_TX_ADAPT_ENTRY)
+FTL_DECLARE(STRUCT_TX_ADAPT)
+#endif
 FTL_DECLARE(STRUCT_NETIF_STATE_NIC)
 FTL_DECLARE(STRUCT_CI_EPLOCK)
 FTL_DECLARE(STRUCT_NETIF_CONFIG)
@@ -77,6 +77,12 @@
 #define ON_CI_HAVE_CTPIO IGNORE
 #endif
 
+#if CI_CFG_TX_ADAPTIVE
+#define ON_CI_CFG_TX_ADAPTIVE DO
+#else
+#define ON_CI_CFG_TX_ADAPTIVE IGNORE
+#endif
+
 #ifndef NDEBUG
 #if CI_CFG_PIO
 #define ON_CI_HAVE_PIO_DEBUG DO
@@ -216,6 +222,14 @@ typedef struct oo_p_dllink oo_p_dllink_t;
     FTL_TFIELD_INT(ctx, oo_p, prev, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))\
     FTL_TSTRUCT_END(ctx)
 
+#define STRUCT_PIO_BUDDY_RESV(ctx)              \
+  FTL_TSTRUCT_BEGIN(ctx, ci_pio_buddy_resv, )                             \
+  FTL_TFIELD_INT(ctx, ci_int32, sock_id, ORM_OUTPUT_STACK)                \
+  FTL_TFIELD_INT(ctx, ci_int16, offset, ORM_OUTPUT_STACK)                 \
+  FTL_TFIELD_INT(ctx, ci_uint8, order, ORM_OUTPUT_STACK)                  \
+  FTL_TFIELD_INT(ctx, ci_uint8, in_use, ORM_OUTPUT_STACK)                 \
+  FTL_TSTRUCT_END(ctx)
+
 #define STRUCT_PIO_BUDDY_ALLOCATOR(ctx)         \
   FTL_TSTRUCT_BEGIN(ctx, ci_pio_buddy_allocator, )                        \
   FTL_TFIELD_ARRAYOFSTRUCT(ctx, oo_p_dllink_t, \
@@ -224,6 +238,9 @@ typedef struct oo_p_dllink oo_p_dllink_t;
                            links, 1ul << CI_PIO_BUDDY_MAX_ORDER, ORM_OUTPUT_EXTRA, 1)     \
   FTL_TFIELD_ARRAYOFINT(ctx, ci_uint8, orders,  \
                         1ul << CI_PIO_BUDDY_MAX_ORDER, ORM_OUTPUT_STACK)                  \
+  FTL_TFIELD_ARRAYOFSTRUCT(ctx, ci_pio_buddy_resv, resv,   \
+                           CI_PIO_BUDDY_MAX_RESV, ORM_OUTPUT_STACK, 1)    \
+  FTL_TFIELD_INT(ctx, ci_int32, n_resv, ORM_OUTPUT_STACK) \
   FTL_TFIELD_INT(ctx, ci_int32, initialised, ORM_OUTPUT_STACK) \
   FTL_TSTRUCT_END(ctx)
 
@@ -234,6 +251,22 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   FTL_TSTRUCT_END(ctx)
 
 
+#define STRUCT_TX_ADAPT_ENTRY(ctx)                                      \
+  FTL_TSTRUCT_BEGIN(ctx, ci_tx_adapt_entry_t, )                         \
+  FTL_TFIELD_INT(ctx, ci_uint32, attempts, ORM_OUTPUT_STACK)            \
+  FTL_TFIELD_INT(ctx, ci_uint32, fallbacks, ORM_OUTPUT_STACK)           \
+  FTL_TFIELD_INT(ctx, ci_uint32, lat_ewma, ORM_OUTPUT_STACK)            \
+  FTL_TFIELD_INT(ctx, ci_uint32, fallback_ewma, ORM_OUTPUT_STACK)       \
+  FTL_TSTRUCT_END(ctx)
+
+#define STRUCT_TX_ADAPT(ctx)                                            \
+  FTL_TSTRUCT_BEGIN(ctx, ci_tx_adapt_t, )                               \
+  FTL_TFIELD_ARRAYOFSTRUCT(ctx, ci_tx_adapt_entry_t, entry,             \
+                           CI_TX_ADAPT_N_BUCKETS * CI_TX_MECH_N,        \
+                           ORM_OUTPUT_STACK, 1)                         \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_decisions, ORM_OUTPUT_STACK)         \
+  FTL_TSTRUCT_END(ctx)
+
 #define STRUCT_NETIF_STATE_NIC(ctx)                                     \
   FTL_TSTRUCT_BEGIN(ctx, ci_netif_state_nic_t, )                        \
   FTL_TFIELD_INT(ctx, ci_uint32, timer_quantum_ns, ORM_OUTPUT_STACK) \
@@ -284,6 +317,9 @@ typedef struct oo_p_dllink oo_p_dllink_t;
     FTL_TFIELD_INT(ctx, ci_uint32, ctpio_frame_len_check, ORM_OUTPUT_STACK) \
     FTL_TFIELD_INT(ctx, ci_uint32, ctpio_max_frame_len, ORM_OUTPUT_STACK) \
   ) \
+  ON_CI_CFG_TX_ADAPTIVE(                                            \
+    FTL_TFIELD_STRUCT(ctx, ci_tx_adapt_t, tx_adapt, ORM_OUTPUT_STACK) \
+  ) \
   FTL_TSTRUCT_END(ctx)
 
 #define STRUCT_CI_EPLOCK(ctx) \
@@ -485,6 +521,7 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_spinners, ORM_OUTPUT_STACK)            \
   FTL_TFIELD_INT(ctx, ci_int8, is_spinner, ORM_OUTPUT_STACK)              \
   FTL_TFIELD_INT(ctx, ci_int8, poll_work_outstanding, ORM_OUTPUT_STACK)   \
+  FTL_TFIELD_INT(ctx, ci_uint32, poll_handoffs, ORM_OUTPUT_STACK)         \
   FTL_TFIELD_INT(ctx, ci_uint64, last_spin_poll_frc, ORM_OUTPUT_STACK)    \
   FTL_TFIELD_INT(ctx, ci_uint64, last_sleep_frc, ORM_OUTPUT_STACK)        \
   FTL_TFIELD_STRUCT(ctx, ci_eplock_t, lock, ORM_OUTPUT_STACK)             \
@@ -512,6 +549,15 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   FTL_TFIELD_INT(ctx, ci_uint32, table_ofs, ORM_OUTPUT_STACK)             \
   FTL_TFIELD_INT(ctx, ci_uint32, table_ext_ofs, ORM_OUTPUT_STACK)             \
   FTL_TFIELD_INT(ctx, ci_uint32, buf_ofs, ORM_OUTPUT_STACK)               \
+  ON_CI_CFG_TIMESTAMPING(                                                 \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ts_ring_ofs, ORM_OUTPUT_STACK)      \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ts_ring_size, ORM_OUTPUT_STACK)     \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ts_ring_write, ORM_OUTPUT_STACK)    \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ts_ring_dropped, ORM_OUTPUT_STACK)  \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ts_ring_read, ORM_OUTPUT_STACK)     \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ts_ring_dropped_seen,               \
+                   ORM_OUTPUT_STACK)                                      \
+  )                                                                       \
   FTL_TFIELD_STRUCT(ctx, ci_ip_timer_state, iptimer_state, ORM_OUTPUT_STACK) \
   FTL_TFIELD_STRUCT(ctx, ci_ip_timer, timeout_tid, ORM_OUTPUT_STACK)      \
   FTL_TFIELD_ARRAYOFSTRUCT(ctx, oo_p_dllink_t, timeout_q, \
@@ -565,6 +611,8 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   )                                                                       \
   FTL_TFIELD_INT(ctx, ci_int32, poll_did_wake, ORM_OUTPUT_STACK)          \
   FTL_TFIELD_INT(ctx, ci_int32, in_poll, ORM_OUTPUT_STACK)               \
+  FTL_TFIELD_INT(ctx, ci_int32, tx_coalesce_active, ORM_OUTPUT_STACK)    \
+  FTL_TFIELD_INT(ctx, ci_int32, ack_batch_active, ORM_OUTPUT_STACK)      \
   FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, post_poll_list, ORM_OUTPUT_EXTRA) \
   FTL_TFIELD_INT(ctx, ci_int32, rx_defrag_head, ORM_OUTPUT_STACK)         \
   FTL_TFIELD_INT(ctx, ci_int32, rx_defrag_tail, ORM_OUTPUT_STACK)         \
@@ -589,6 +637,8 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   FTL_TFIELD_INT(ctx, ci_int32, load_numa_node, ORM_OUTPUT_STACK)         \
   FTL_TFIELD_INT(ctx, ci_uint32, packet_alloc_numa_nodes, ORM_OUTPUT_STACK)\
   FTL_TFIELD_INT(ctx, ci_uint32, sock_alloc_numa_nodes, ORM_OUTPUT_STACK) \
+  FTL_TFIELD_INT(ctx, ci_uint32, sock_buf_chunks, ORM_OUTPUT_STACK)       \
+  FTL_TFIELD_INT(ctx, ci_uint32, sock_buf_huge_chunks, ORM_OUTPUT_STACK)  \
   FTL_TFIELD_INT(ctx, ci_uint32, interrupt_numa_nodes, ORM_OUTPUT_STACK)  \
   ON_CI_CFG_FD_CACHING(                                                 \
     FTL_TFIELD_STRUCT(ctx, ci_socket_cache_t, active_cache, ORM_OUTPUT_EXTRA)   \
@@ -816,6 +866,9 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, uuid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                      \
   FTL_TFIELD_INT(ctx, ci_int32, pid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                       \
   FTL_TFIELD_INT(ctx, ci_uint8, domain, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
+  FTL_TFIELD_INT(ctx, ci_uint64, so_max_pacing_rate, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
+  FTL_TFIELD_INT(ctx, ci_uint32, zc_id_next, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
+  FTL_TFIELD_INT(ctx, ci_uint32, zc_id_unreported, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
   FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, reap_link, ORM_OUTPUT_EXTRA)     \
   FTL_TSTRUCT_END(ctx)
     
@@ -842,6 +895,9 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_overflow, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_mem_drop, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_pktinfo, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_gro, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_fanout, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_fanout_drop, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, max_recvq_pkts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os_slow, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -865,6 +921,7 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_msg_confirm, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os_late, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_unconnect_late, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_gso, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
   FTL_TSTRUCT_END(ctx)
 
 typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
@@ -876,6 +933,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_cwnd, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_more, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_nagle, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
+  FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_autocork, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_app, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
   ON_CI_CFG_BURST_CONTROL(                                              \
      FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_burst, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
@@ -886,6 +944,8 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_INT(ctx, ci_uint32, tx_msg_warm, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_tmpl_send_fast, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_tmpl_send_slow, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, rx_ooo_tail, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
+  FTL_TFIELD_INT(ctx, ci_uint32, rx_ooo_walk, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
   FTL_TFIELD_INT(ctx, ci_uint32, rx_isn, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))           \
   FTL_TFIELD_INT(ctx, ci_uint16, tx_tmpl_active, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))   \
   FTL_TFIELD_INT(ctx, ci_uint16, rtos, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
@@ -894,6 +954,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_INT(ctx, ci_uint16, rx_ack_seq_errs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
   FTL_TFIELD_INT(ctx, ci_uint16, rx_ooo_pkts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
   FTL_TFIELD_INT(ctx, ci_uint16, rx_ooo_fill, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
+  FTL_TFIELD_INT(ctx, ci_uint16, rx_ooo_max_walk, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
   FTL_TFIELD_INT(ctx, ci_uint16, total_retrans, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TSTRUCT_END(ctx)
 
@@ -912,6 +973,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_STRUCT(ctx, ci_sock_cmn, s, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
   FTL_TFIELD_STRUCT(ctx, ci_ip_cached_hdrs, ephemeral_pkt, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, udpflags, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
+  FTL_TFIELD_INT(ctx, ci_uint16, gso_size, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
   ON_CI_CFG_ZC_RECV_FILTER( \
     FTL_TFIELD_INT(ctx, ci_uint64, recv_q_filter, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TFIELD_INT(ctx, ci_uint64, recv_q_filter_arg, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -1001,6 +1063,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_ka_intvl_in_secs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_uint16, user_mss, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     FTL_TFIELD_INT(ctx, ci_uint8, tcp_defer_accept, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))	      \
+    FTL_TFIELD_INT(ctx, ci_uint8, cong_alg, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))	      \
     FTL_TSTRUCT_END(ctx)
 
 #define STRUCT_TCP(ctx) \
@@ -1011,6 +1074,8 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_int32, tmpl_head, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, ci_uint32, tcpflags, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, oo_p, pmtus, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+    FTL_TFIELD_INT(ctx, oo_p, cong, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+    FTL_TFIELD_INT(ctx, oo_p, flight, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))           \
     FTL_TFIELD_INT(ctx, ci_int32, so_sndbuf_pkts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TFIELD_INT(ctx, ci_uint32, rcv_window_max, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
     FTL_TFIELD_INT(ctx, ci_uint32, send_in, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
@@ -1025,6 +1090,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_STRUCT(ctx, ci_ip_pkt_queue, rob, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
     FTL_TFIELD_ARRAYOFINT(ctx, ci_int32, last_sack,             \
                           CI_TCP_SACK_MAX_BLOCKS + 1, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                         \
+    FTL_TFIELD_INT(ctx, ci_int32, rob_tail_block, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     FTL_TFIELD_INT(ctx, ci_uint32, dsack_start, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                 \
     FTL_TFIELD_INT(ctx, ci_uint32, dsack_end, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                   \
     FTL_TFIELD_INT(ctx, ci_int32, dsack_block, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
@@ -1072,6 +1138,16 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     ON_CI_CFG_TAIL_DROP_PROBE(                                                \
       FTL_TFIELD_INT(ctx, ci_uint32, taildrop_mark, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
     )                                                                         \
+    FTL_TFIELD_ANON_STRUCT_BEGIN(ctx, rack, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                   \
+    FTL_TFIELD_ANON_STRUCT(ctx, ci_uint32, rack, xmit_us)                     \
+    FTL_TFIELD_ANON_STRUCT(ctx, ci_uint32, rack, end_seq)                     \
+    FTL_TFIELD_ANON_STRUCT(ctx, ci_uint32, rack, rtt_us)                      \
+    FTL_TFIELD_ANON_STRUCT(ctx, ci_uint32, rack, min_rtt_us)                  \
+    FTL_TFIELD_ANON_STRUCT(ctx, ci_uint8, rack, reo_wnd_mult)                 \
+    FTL_TFIELD_ANON_STRUCT(ctx, ci_uint8, rack, valid)                        \
+    FTL_TFIELD_ANON_STRUCT_END(ctx, rack)                                     \
+    FTL_TFIELD_INT(ctx, ci_uint32, autocork_seq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+    FTL_TFIELD_INT(ctx, ci_uint32, autocork_us, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_prev_recv_payload, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_last_recv_payload, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_last_recv_ack, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -1105,6 +1181,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
       FTL_TFIELD_STRUCT(ctx, ci_ip_timer, stats_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     )                                                                         \
     FTL_TFIELD_STRUCT(ctx, ci_ip_timer, cork_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
+    FTL_TFIELD_STRUCT(ctx, ci_ip_timer, rack_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     ON_CI_CFG_TCP_SOCK_STATS(                                                 \
       FTL_TFIELD_STRUCT(ctx, ci_ip_sock_stats, stats_snapshot, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
       FTL_TFIELD_STRUCT(ctx, ci_ip_sock_stats, stats_cumulative, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))\
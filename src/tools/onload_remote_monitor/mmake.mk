@@ -41,10 +41,10 @@ all: $(APPS)
 orm_json: $(DEPS)
 	(libs="$(LIBS)"; $(MMakeLinkCApp))
 
-orm_zmq_publisher: orm_zmq_publisher.o orm_json_lib.o
+orm_zmq_publisher: orm_zmq_publisher.o orm_json_lib.o orm_bin.o
 	(libs="$(LIBS)"; $(MMakeLinkCApp))
 
-zmq_subscriber: zmq_subscriber.o
+zmq_subscriber: zmq_subscriber.o orm_bin.o
 	(libs="$(LIBS)"; $(MMakeLinkCApp))
 
 clean:
@@ -0,0 +1,328 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+#include <ci/internal/ip.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "orm_bin.h"
+
+
+const char* const orm_bin_counter_names[] = {
+#define OO_STAT(desc, type, name, kind)  "stats." #name,
+#include <ci/internal/stats_def.h>
+#undef OO_STAT
+#define OO_STAT(desc, type, name, kind)  "more_stats." #name,
+#include <ci/internal/more_stats_def.h>
+#undef OO_STAT
+#define OO_STAT(desc, type, name, kind)  "tcp_stats." #name,
+#include <ci/internal/tcp_stats_count_def.h>
+#undef OO_STAT
+#define OO_STAT(desc, type, name, kind)  "tcp_ext_stats." #name,
+#include <ci/internal/tcp_ext_stats_count_def.h>
+#undef OO_STAT
+};
+
+const int orm_bin_n_counters =
+  sizeof(orm_bin_counter_names) / sizeof(orm_bin_counter_names[0]);
+
+
+void orm_bin_counters_get(const ci_netif_stats_pub* stats, uint64_t* c)
+{
+#define OO_STAT(desc, type, name, kind)  *c++ = stats->stats.name;
+#include <ci/internal/stats_def.h>
+#undef OO_STAT
+#define OO_STAT(desc, type, name, kind)  *c++ = stats->more_stats.name;
+#include <ci/internal/more_stats_def.h>
+#undef OO_STAT
+#define OO_STAT(desc, type, name, kind)  *c++ = stats->ip_stats.tcp.name;
+#include <ci/internal/tcp_stats_count_def.h>
+#undef OO_STAT
+#define OO_STAT(desc, type, name, kind)  *c++ = stats->ip_stats.tcp_ext.name;
+#include <ci/internal/tcp_ext_stats_count_def.h>
+#undef OO_STAT
+}
+
+
+/**********************************************************/
+/* Stack tables */
+/**********************************************************/
+
+static struct orm_bin_stack*
+stack_find(struct orm_bin_stacks* s, int id, bool create)
+{
+  struct orm_bin_stack* st;
+  uint64_t* counters;
+  int i;
+
+  for( i = 0; i < s->n_stacks; ++i )
+    if( s->stacks[i].id == id )
+      return &s->stacks[i];
+  if( ! create )
+    return NULL;
+
+  if( (counters = calloc(orm_bin_n_counters, sizeof(*counters))) == NULL )
+    return NULL;
+  st = realloc(s->stacks, (s->n_stacks + 1) * sizeof(*st));
+  if( st == NULL ) {
+    free(counters);
+    return NULL;
+  }
+  s->stacks = st;
+  st = &s->stacks[s->n_stacks++];
+  st->id = id;
+  st->seen = false;
+  st->counters = counters;
+  return st;
+}
+
+
+static void stack_remove(struct orm_bin_stacks* s, struct orm_bin_stack* st)
+{
+  free(st->counters);
+  *st = s->stacks[--s->n_stacks];
+}
+
+
+static void stacks_free(struct orm_bin_stacks* s)
+{
+  while( s->n_stacks )
+    stack_remove(s, &s->stacks[0]);
+  free(s->stacks);
+  s->stacks = NULL;
+}
+
+
+static void stacks_unsee(struct orm_bin_stacks* s)
+{
+  int i;
+  for( i = 0; i < s->n_stacks; ++i )
+    s->stacks[i].seen = false;
+}
+
+
+/**********************************************************/
+/* Encoder */
+/**********************************************************/
+
+static void enc_put(struct orm_bin_enc* enc, uint8_t b)
+{
+  uint8_t* buf;
+  size_t cap;
+
+  if( enc->len == enc->cap ) {
+    cap = enc->cap ? enc->cap * 2 : 4096;
+    if( (buf = realloc(enc->buf, cap)) == NULL ) {
+      enc->rc = -ENOMEM;
+      return;
+    }
+    enc->buf = buf;
+    enc->cap = cap;
+  }
+  enc->buf[enc->len++] = b;
+}
+
+
+static void enc_varint(struct orm_bin_enc* enc, uint64_t v)
+{
+  for( ; v >= 0x80; v >>= 7 )
+    enc_put(enc, (v & 0x7f) | 0x80);
+  enc_put(enc, v);
+}
+
+
+void orm_bin_enc_begin(struct orm_bin_enc* enc, bool keyframe)
+{
+  enc->keyframe = keyframe;
+  enc->len = 0;
+  enc->rc = 0;
+  stacks_unsee(&enc->s);
+  enc_put(enc, ORM_BIN_VERSION);
+  enc_put(enc, keyframe ? ORM_BIN_MSG_KEYFRAME : ORM_BIN_MSG_DELTA);
+  enc_varint(enc, enc->seq);
+  enc_varint(enc, orm_bin_n_counters);
+}
+
+
+void orm_bin_enc_stack(struct orm_bin_enc* enc, int stack_id,
+                       const uint64_t* counters)
+{
+  struct orm_bin_stack* st = stack_find(&enc->s, stack_id, true);
+  int64_t delta;
+  int i, last = -1;
+
+  if( st == NULL ) {
+    enc->rc = -ENOMEM;
+    return;
+  }
+  st->seen = true;
+
+  enc_varint(enc, (uint64_t) stack_id << 1);
+  for( i = 0; i < orm_bin_n_counters; ++i ) {
+    delta = counters[i] - (enc->keyframe ? 0 : st->counters[i]);
+    if( delta == 0 )
+      continue;
+    enc_varint(enc, i - last);
+    enc_varint(enc, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+    last = i;
+  }
+  enc_varint(enc, 0);
+  memcpy(st->counters, counters, orm_bin_n_counters * sizeof(*counters));
+}
+
+
+int orm_bin_enc_end(struct orm_bin_enc* enc, const uint8_t** msg,
+                    size_t* len)
+{
+  int i;
+
+  for( i = enc->s.n_stacks - 1; i >= 0; --i ) {
+    struct orm_bin_stack* st = &enc->s.stacks[i];
+    if( st->seen )
+      continue;
+    /* A keyframe implies the loss of every stack it doesn't mention. */
+    if( ! enc->keyframe )
+      enc_varint(enc, ((uint64_t) st->id << 1) | 1);
+    stack_remove(&enc->s, st);
+  }
+
+  ++enc->seq;
+  *msg = enc->buf;
+  *len = enc->len;
+  return enc->rc;
+}
+
+
+void orm_bin_enc_free(struct orm_bin_enc* enc)
+{
+  stacks_free(&enc->s);
+  free(enc->buf);
+  enc->buf = NULL;
+  enc->len = enc->cap = 0;
+}
+
+
+/**********************************************************/
+/* Decoder */
+/**********************************************************/
+
+static int dec_varint(const uint8_t** p, const uint8_t* end, uint64_t* v)
+{
+  int shift;
+  uint8_t b;
+
+  *v = 0;
+  for( shift = 0; *p < end && shift < 64; shift += 7 ) {
+    b = *(*p)++;
+    *v |= (uint64_t) (b & 0x7f) << shift;
+    if( ! (b & 0x80) )
+      return 0;
+  }
+  return -EPROTO;
+}
+
+
+static int dec_stack(struct orm_bin_dec* dec, struct orm_bin_stack* st,
+                     bool keyframe, const uint8_t** p, const uint8_t* end,
+                     orm_bin_counter_fn_t* fn, void* arg)
+{
+  uint64_t v, zz;
+  int i, counter = -1;
+
+  memcpy(dec->prev, st->counters, orm_bin_n_counters * sizeof(uint64_t));
+  if( keyframe )
+    memset(st->counters, 0, orm_bin_n_counters * sizeof(uint64_t));
+
+  while( 1 ) {
+    if( dec_varint(p, end, &v) < 0 )
+      return -EPROTO;
+    if( v == 0 )
+      break;
+    if( v >= orm_bin_n_counters - counter )
+      return -EPROTO;
+    counter += v;
+    if( dec_varint(p, end, &zz) < 0 )
+      return -EPROTO;
+    st->counters[counter] += (zz >> 1) ^ -(zz & 1);
+  }
+
+  for( i = 0; i < orm_bin_n_counters; ++i )
+    if( st->counters[i] != dec->prev[i] )
+      fn(arg, st->id, i, st->counters[i]);
+  return 0;
+}
+
+
+int orm_bin_dec_apply(struct orm_bin_dec* dec, const uint8_t* msg,
+                      size_t len, orm_bin_counter_fn_t* fn, void* arg)
+{
+  const uint8_t* p = msg + 2;
+  const uint8_t* end = msg + len;
+  struct orm_bin_stack* st;
+  uint64_t seq, n_counters, v;
+  bool keyframe;
+  int i, stack_id;
+
+  if( len < 2 || msg[0] != ORM_BIN_VERSION ||
+      (msg[1] != ORM_BIN_MSG_KEYFRAME && msg[1] != ORM_BIN_MSG_DELTA) ||
+      dec_varint(&p, end, &seq) < 0 || dec_varint(&p, end, &n_counters) < 0 ||
+      n_counters != orm_bin_n_counters )
+    return -EPROTO;
+
+  keyframe = msg[1] == ORM_BIN_MSG_KEYFRAME;
+  if( ! keyframe && (! dec->synced || seq != dec->seq + 1) ) {
+    dec->synced = false;
+    return -EAGAIN;
+  }
+  if( dec->prev == NULL &&
+      (dec->prev = malloc(orm_bin_n_counters * sizeof(uint64_t))) == NULL )
+    return -ENOMEM;
+
+  /* A failure part way through leaves us out of step with the publisher
+   * until the next keyframe. */
+  dec->synced = false;
+  stacks_unsee(&dec->s);
+
+  while( p < end ) {
+    if( dec_varint(&p, end, &v) < 0 || (v >> 1) > INT_MAX )
+      return -EPROTO;
+    stack_id = v >> 1;
+    if( v & 1 ) {
+      if( (st = stack_find(&dec->s, stack_id, false)) != NULL ) {
+        stack_remove(&dec->s, st);
+        fn(arg, stack_id, -1, 0);
+      }
+      continue;
+    }
+    if( (st = stack_find(&dec->s, stack_id, true)) == NULL )
+      return -ENOMEM;
+    st->seen = true;
+    if( dec_stack(dec, st, keyframe, &p, end, fn, arg) < 0 )
+      return -EPROTO;
+  }
+
+  if( keyframe )
+    for( i = dec->s.n_stacks - 1; i >= 0; --i ) {
+      st = &dec->s.stacks[i];
+      if( ! st->seen ) {
+        stack_id = st->id;
+        stack_remove(&dec->s, st);
+        fn(arg, stack_id, -1, 0);
+      }
+    }
+
+  dec->seq = seq;
+  dec->synced = true;
+  return 0;
+}
+
+
+void orm_bin_dec_free(struct orm_bin_dec* dec)
+{
+  stacks_free(&dec->s);
+  free(dec->prev);
+  dec->prev = NULL;
+}
@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2023 Advanced Micro Devices, Inc. */
+
+/* Compact binary encoding of stack counters for orm_zmq_publisher --binary.
+ *
+ * The counters of a stack are those of the stats, more_stats, tcp_stats and
+ * tcp_ext_stats groups, in the order of orm_bin_counter_names[].  Each
+ * message is:
+ *
+ *   u8      ORM_BIN_VERSION
+ *   u8      ORM_BIN_MSG_KEYFRAME or ORM_BIN_MSG_DELTA
+ *   varint  sequence number, one more than the previous message's
+ *   varint  number of counters per stack
+ *   then for each stack:
+ *     varint  stack_id << 1, with bit 0 set if the stack has gone away
+ *     then, unless it has gone away, for each counter that changed:
+ *       varint  1 + number of counters skipped since the previous one
+ *       varint  change in value, zigzag encoded
+ *     varint  0
+ *
+ * Varints are little-endian base 128.  A keyframe lists every stack and
+ * every counter relative to zero, so that a subscriber can start or
+ * resynchronise from one.  A delta lists only what changed since the
+ * previous message.
+ */
+#ifndef __ORM_BIN_H__
+#define __ORM_BIN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define ORM_BIN_VERSION       1
+
+#define ORM_BIN_MSG_KEYFRAME  1
+#define ORM_BIN_MSG_DELTA     2
+
+extern const char* const orm_bin_counter_names[];
+extern const int orm_bin_n_counters;
+
+struct orm_bin_stack {
+  int       id;
+  bool      seen;
+  uint64_t* counters;
+};
+
+struct orm_bin_stacks {
+  struct orm_bin_stack* stacks;
+  int                   n_stacks;
+};
+
+struct orm_bin_enc {
+  struct orm_bin_stacks s;
+  uint64_t              seq;
+  bool                  keyframe;
+  uint8_t*              buf;
+  size_t                len;
+  size_t                cap;
+  int                   rc;
+};
+
+struct orm_bin_dec {
+  struct orm_bin_stacks s;
+  uint64_t              seq;
+  bool                  synced;
+  uint64_t*             prev;
+};
+
+/* Flatten [stats] into [counters], which has orm_bin_n_counters entries */
+extern void orm_bin_counters_get(const ci_netif_stats_pub* stats,
+                                 uint64_t* counters);
+
+/* Start a new message */
+extern void orm_bin_enc_begin(struct orm_bin_enc* enc, bool keyframe);
+
+/* Add one stack's counters to the message */
+extern void orm_bin_enc_stack(struct orm_bin_enc* enc, int stack_id,
+                              const uint64_t* counters);
+
+/* Finish the message, noting stacks not seen since orm_bin_enc_begin() as
+ * gone.  Returns 0 and sets [msg] and [len] on success, or -ENOMEM. */
+extern int orm_bin_enc_end(struct orm_bin_enc* enc, const uint8_t** msg,
+                           size_t* len);
+
+extern void orm_bin_enc_free(struct orm_bin_enc* enc);
+
+/* Called by orm_bin_dec_apply() for each counter whose value changed, or
+ * with [counter] of -1 when a stack has gone away. */
+typedef void orm_bin_counter_fn_t(void* arg, int stack_id, int counter,
+                                  uint64_t value);
+
+/* Decode one message, calling [fn] for each change.  Returns 0 on success,
+ * -EAGAIN if the message was skipped while waiting for a keyframe, or
+ * -EPROTO if it is malformed.  Deltas are ignored after a lost message
+ * until the next keyframe. */
+extern int orm_bin_dec_apply(struct orm_bin_dec* dec, const uint8_t* msg,
+                             size_t len, orm_bin_counter_fn_t* fn, void* arg);
+
+extern void orm_bin_dec_free(struct orm_bin_dec* dec);
+
+#endif  /* __ORM_BIN_H__ */
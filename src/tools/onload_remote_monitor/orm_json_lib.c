@@ -404,6 +404,91 @@ static int orm_oo_more_stats_dump(const char* label, const more_stats_t* stats)
 }
 
 
+/**********************************************************/
+/* Dump ci_netif_rx_latency */
+/**********************************************************/
+
+#if CI_CFG_RX_LATENCY_HIST
+static void orm_oo_rx_latency_hist_dump(const char* label,
+                                        const ci_uint64* hist)
+{
+  int i;
+  dump_buf_label("\"", label, "\":[");
+  for( i = 0; i < CI_RX_LATENCY_BUCKETS; ++i )
+    dump_buf_cat_comma(ci_uint64_fmt, (unsigned long long) hist[i]);
+  dump_buf_cleanup();
+  dump_buf_literal_comma("]");
+}
+#endif
+
+
+/* Bucket i of each histogram counts samples of less than 2^i cycles, and
+ * [khz] gives the cycle rate. */
+static int orm_oo_rx_latency_dump(const char* label, ci_netif* ni)
+{
+#if CI_CFG_RX_LATENCY_HIST
+  const ci_netif_rx_latency* lat = &ni->state->rx_latency;
+  dump_buf_label("\"", label, "\":{");
+  dump_buf_cat_comma("\"khz\":%u", IPTIMER_STATE(ni)->khz);
+  orm_oo_rx_latency_hist_dump("hw_to_poll", lat->hw_to_poll);
+  orm_oo_rx_latency_hist_dump("poll_to_enqueue", lat->poll_to_enqueue);
+  orm_oo_rx_latency_hist_dump("enqueue_to_recv", lat->enqueue_to_recv);
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+#endif
+  return 0;
+}
+
+
+/**********************************************************/
+/* Dump ci_netif_poll_profile */
+/**********************************************************/
+
+#if CI_CFG_POLL_PROFILE
+static void orm_oo_poll_profile_array_dump(const char* label,
+                                           const char* const* names,
+                                           const ci_uint64* vals, int n)
+{
+  int i;
+  dump_buf_label("\"", label, "\":{");
+  for( i = 0; i < n; ++i )
+    dump_buf_cat_comma("\"%s\":" ci_uint64_fmt, names[i],
+                       (unsigned long long) vals[i]);
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+}
+#endif
+
+
+/* All times are in cycles, and [khz] gives the cycle rate. */
+static int orm_oo_poll_profile_dump(const char* label, ci_netif* ni)
+{
+#if CI_CFG_POLL_PROFILE
+  static const char* const phases[CI_POLL_PHASE_N] = {
+    "evq", "post_poll", "rx_refill", "tx_push", "loopback", "timers", "other"
+  };
+  static const char* const evs[CI_POLL_EV_N] = {
+    "rx", "tx", "rx_discard", "other"
+  };
+  const ci_netif_poll_profile* pp = &ni->state->poll_profile;
+  dump_buf_label("\"", label, "\":{");
+  dump_buf_cat_comma("\"khz\":%u", IPTIMER_STATE(ni)->khz);
+  dump_buf_cat_comma("\"n_polls\":" ci_uint64_fmt,
+                     (unsigned long long) pp->n_polls);
+  dump_buf_cat_comma("\"total_cycles\":" ci_uint64_fmt,
+                     (unsigned long long) pp->total_cycles);
+  orm_oo_poll_profile_array_dump("phase_cycles", phases, pp->phase_cycles,
+                                 CI_POLL_PHASE_N);
+  orm_oo_poll_profile_array_dump("ev_cycles", evs, pp->ev_cycles,
+                                 CI_POLL_EV_N);
+  orm_oo_poll_profile_array_dump("ev_count", evs, pp->ev_count, CI_POLL_EV_N);
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+#endif
+  return 0;
+}
+
+
 static int orm_oo_tcp_stats_count_dump(const char* label, const ci_tcp_stats_count* stats)
 {
   dump_buf_label("\"", label, "\":{");
@@ -901,9 +986,48 @@ static int orm_vis_dump(ci_netif* ni, int output_flags)
 /* Main */
 /**********************************************************/
 
+#define ORM_OUTPUT_ANY_STATS  (ORM_OUTPUT_STATS | ORM_OUTPUT_MORE_STATS | \
+                               ORM_OUTPUT_TCP_STATS_COUNT |              \
+                               ORM_OUTPUT_TCP_EXT_STATS_COUNT)
+
+/* How many times to try for a consistent copy of the published stats
+ * before giving up and reading the live counters. */
+#define ORM_STATS_PUB_TRIES  10000
+
+/* Fill in [out] with the stack's statistics.  When the stack publishes them
+ * (EF_STATS_PUBLISH_MS) we take a consistent copy of that, and so needn't
+ * walk the sockets.  Otherwise we read the live counters, and walk the
+ * sockets only if more_stats are wanted. */
+static void orm_stats_get(ci_netif* ni, int output_flags,
+                          ci_netif_stats_pub* out)
+{
+  const ci_netif_stats_pub* pub = &ni->state->stats_pub;
+  ci_uint32 seq;
+  int i;
+
+  for( i = 0; i < ORM_STATS_PUB_TRIES; ++i ) {
+    seq = pub->seq;
+    ci_rmb();
+    if( pub->version != CI_NETIF_STATS_PUB_VERSION )
+      break;
+    if( seq & 1 )
+      continue;
+    memcpy(out, (const void*) pub, sizeof(*out));
+    ci_rmb();
+    if( pub->seq == seq )
+      return;
+  }
+
+  memcpy(&out->stats, &ni->state->stats, sizeof(out->stats));
+  if( output_flags & ORM_OUTPUT_MORE_STATS )
+    get_more_stats(ni, &out->more_stats);
+  memcpy(&out->ip_stats, &ni->state->stats_snapshot, sizeof(out->ip_stats));
+}
+
 static int orm_netif_dump(ci_netif* ni, int id, int output_flags, bool cfg_flat,
                           const char* stackname, const sockbuf_filter_t* sft)
 {
+  ci_netif_stats_pub stats;
   int rc;
 
   if (stackname != NULL)
@@ -949,29 +1073,41 @@ static int orm_netif_dump(ci_netif* ni, int id, int output_flags, bool cfg_flat,
       return rc;
     }
   }
+  if (output_flags & ORM_OUTPUT_ANY_STATS)
+    orm_stats_get(ni, output_flags, &stats);
   if (output_flags & ORM_OUTPUT_STATS) {
-    if( (rc = orm_oo_stats_dump("stats", &ni->state->stats)) != 0 ) {
+    if( (rc = orm_oo_stats_dump("stats", &stats.stats)) != 0 ) {
       LOG("stats error code %d\n",rc);
       return rc;
     }
   }
   if (output_flags & ORM_OUTPUT_MORE_STATS) {
-    more_stats_t more_stats;
-    get_more_stats(ni, &more_stats);
-    if( (rc = orm_oo_more_stats_dump("more_stats", &more_stats)) != 0 ) {
+    if( (rc = orm_oo_more_stats_dump("more_stats", &stats.more_stats)) != 0 ) {
       LOG("more stats error code %d\n",rc);
       return rc;
     }
   }
+  if (output_flags & ORM_OUTPUT_RX_LATENCY) {
+    if( (rc = orm_oo_rx_latency_dump("rx_latency", ni)) != 0 ) {
+      LOG("rx latency error code %d\n",rc);
+      return rc;
+    }
+  }
+  if (output_flags & ORM_OUTPUT_POLL_PROFILE) {
+    if( (rc = orm_oo_poll_profile_dump("poll_profile", ni)) != 0 ) {
+      LOG("poll profile error code %d\n",rc);
+      return rc;
+    }
+  }
   if (output_flags & ORM_OUTPUT_TCP_STATS_COUNT) {
-    ci_tcp_stats_count* tcp = &ni->state->stats_snapshot.tcp;
+    ci_tcp_stats_count* tcp = &stats.ip_stats.tcp;
     if( (rc = orm_oo_tcp_stats_count_dump("tcp_stats", tcp)) != 0 ) {
       LOG("tcp stats error code %d\n",rc);
       return rc;
     }
   }
   if (output_flags & ORM_OUTPUT_TCP_EXT_STATS_COUNT) {
-    ci_tcp_ext_stats_count* tcp_ext = &ni->state->stats_snapshot.tcp_ext;
+    ci_tcp_ext_stats_count* tcp_ext = &stats.ip_stats.tcp_ext;
     if( (rc = orm_oo_tcp_ext_stats_count_dump("tcp_ext_stats", tcp_ext)) != 0 ) {
       LOG("tcp ext stats error code %d\n",rc);
       return rc;
@@ -1019,6 +1155,10 @@ int orm_parse_output_flags(int argc, const char* const* argv)
       output_flags |= ORM_OUTPUT_STATS;
     else if ( !strcmp(argv[i], "more_stats") )
       output_flags |= ORM_OUTPUT_MORE_STATS;
+    else if ( !strcmp(argv[i], "rx_latency") )
+      output_flags |= ORM_OUTPUT_RX_LATENCY;
+    else if ( !strcmp(argv[i], "poll_profile") )
+      output_flags |= ORM_OUTPUT_POLL_PROFILE;
     else if ( !strcmp(argv[i], "tcp_stats") )
       output_flags |= ORM_OUTPUT_TCP_STATS_COUNT;
     else if ( !strcmp(argv[i], "tcp_ext_stats") )
@@ -1113,19 +1253,18 @@ int orm_do_dump(const struct orm_cfg* cfg, int output_flags,
      * in the json array to match *_meta_dump() functions above. */
     for( i = 0; i < state.n_stacks; ++i ) {
       ci_netif* ni = &state.stacks[i]->os_ni;
+      ci_netif_stats_pub stats;
+      orm_stats_get(ni, output_flags, &stats);
       if( output_flags & ORM_OUTPUT_STATS )
-        orm_oo_stats_sum(&stats_sum, &ni->state->stats);
-      if( output_flags & ORM_OUTPUT_MORE_STATS ) {
-        more_stats_t more_stats;
-        get_more_stats(ni, &more_stats);
-        orm_oo_more_stats_sum(&more_stats_sum, &more_stats);
-      }
+        orm_oo_stats_sum(&stats_sum, &stats.stats);
+      if( output_flags & ORM_OUTPUT_MORE_STATS )
+        orm_oo_more_stats_sum(&more_stats_sum, &stats.more_stats);
       if( output_flags & ORM_OUTPUT_TCP_STATS_COUNT ) {
-        ci_tcp_stats_count_update(&tcp_stats_sum, &ni->state->stats_snapshot.tcp);
+        ci_tcp_stats_count_update(&tcp_stats_sum, &stats.ip_stats.tcp);
       }
       if( output_flags & ORM_OUTPUT_TCP_EXT_STATS_COUNT ) {
         ci_tcp_ext_stats_count_update(&tcp_ext_stats_sum,
-                                      &ni->state->stats_snapshot.tcp_ext);
+                                      &stats.ip_stats.tcp_ext);
       }
     }
     if( ! cfg->flat )
@@ -1187,3 +1326,23 @@ done:
 
   return rc;
 }
+
+
+int orm_do_stats(const struct orm_cfg* cfg, orm_stats_fn_t* fn, void* arg)
+{
+  orm_state_t state = { };
+  ci_netif_stats_pub stats;
+  int i, rc;
+
+  if( (rc = orm_map_stacks(&state)) == 0 )
+    for( i = 0; i < state.n_stacks; ++i ) {
+      ci_netif* ni = &state.stacks[i]->os_ni;
+      if( cfg->stackname != NULL && strcmp(cfg->stackname, ni->state->name) )
+        continue;
+      orm_stats_get(ni, ORM_OUTPUT_SUM, &stats);
+      fn(arg, state.stacks[i]->os_id, &stats);
+    }
+
+  orm_unmap_stacks(&state);
+  return rc;
+}
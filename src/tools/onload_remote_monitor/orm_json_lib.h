@@ -11,6 +11,8 @@
 #define ORM_OUTPUT_SOCKETS 0x20
 #define ORM_OUTPUT_VIS 0x40
 #define ORM_OUTPUT_OPTS 0x100
+#define ORM_OUTPUT_RX_LATENCY 0x200
+#define ORM_OUTPUT_POLL_PROFILE 0x400
 #define ORM_OUTPUT_EXTRA 0x100000
 #define ORM_OUTPUT_LOTS 0xFFFFF
 #define ORM_OUTPUT_SUM (ORM_OUTPUT_STATS | ORM_OUTPUT_MORE_STATS | \
@@ -36,3 +38,12 @@ extern int orm_parse_output_flags(int argc, const char* const* argv);
 extern int orm_do_dump(const struct orm_cfg* cfg, int output_flags,
                        FILE* output_stream);
 
+/* Called by orm_do_stats() with the statistics of one stack */
+typedef void orm_stats_fn_t(void* arg, int stack_id,
+                            const ci_netif_stats_pub* stats);
+
+/* Call [fn] for each stack selected by cfg->stackname
+ * Return 0 on success, or negative error code
+ */
+extern int orm_do_stats(const struct orm_cfg* cfg, orm_stats_fn_t* fn,
+                        void* arg);
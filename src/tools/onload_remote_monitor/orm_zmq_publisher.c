@@ -11,11 +11,15 @@
 #include <czmq.h>
 
 #include "orm_json_lib.h"
+#include "orm_bin.h"
 
 
 static struct orm_cfg cfg;
 static int cfg_interval = 10;
+static int cfg_interval_ms;
 static char* cfg_endpoint = "tcp://*:5556";
+static int cfg_binary;
+static int cfg_keyframe = 10;
 
 static ci_cfg_desc cfg_opts[] = {
   { 'h', "help", CI_CFG_USAGE, 0, "this message" },
@@ -32,16 +36,70 @@ static ci_cfg_desc cfg_opts[] = {
     "ZMQ endpoint to publish stats (default tcp://*:5556)" },
   { 0, "interval",  CI_CFG_INT,  &cfg_interval,
     "Interval between stats in seconds (default 10s)" },
+  { 0, "interval-ms",  CI_CFG_INT,  &cfg_interval_ms,
+    "Interval between stats in milliseconds (overrides --interval)" },
+  { 0, "binary", CI_CFG_FLAG,   &cfg_binary,
+    "publish counter deltas in the compact orm_bin.h format" },
+  { 0, "keyframe",  CI_CFG_INT,  &cfg_keyframe,
+    "with --binary, send every counter once per N updates (default 10)" },
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
 
+static struct orm_bin_enc bin_enc;
+static uint64_t* bin_counters;
+
+
+static void bin_add_stack(void* arg, int stack_id,
+                          const ci_netif_stats_pub* stats)
+{
+  orm_bin_counters_get(stats, bin_counters);
+  orm_bin_enc_stack(&bin_enc, stack_id, bin_counters);
+}
+
+
+static int json_publish(zsock_t* publisher, int output_flags)
+{
+  char* data = NULL;
+  size_t datalen = 0;
+  FILE* output_stream = open_memstream(&data, &datalen);
+
+  int rc = orm_do_dump(&cfg, output_flags, output_stream);
+  fclose(output_stream);
+
+  if( rc == 0 )
+    // data generated OK
+    zstr_send(publisher, data);
+  free(data);
+  return rc;
+}
+
+
+static int bin_publish(zsock_t* publisher, unsigned int n)
+{
+  const uint8_t* msg;
+  size_t len;
+  zframe_t* frame;
+  int rc;
+
+  orm_bin_enc_begin(&bin_enc, cfg_keyframe <= 1 || n % cfg_keyframe == 0);
+  rc = orm_do_stats(&cfg, bin_add_stack, NULL);
+  if( orm_bin_enc_end(&bin_enc, &msg, &len) < 0 )
+    rc = -ENOMEM;
+  if( rc < 0 )
+    return rc;
+  /* Copies the message, so the encoder may reuse its buffer */
+  frame = zframe_new(msg, len);
+  return zframe_send(&frame, publisher, 0) == 0 ? 0 : -EIO;
+}
+
+
 int main(int argc, char** argv)
 {
   ci_app_standard_opts = 0;
   ci_app_getopt(
-    "[stats] [more_stats] [tcp_stats] [stack] [stack_state] [vis] [opts] "
-    "[lots] [extra] [all]",
+    "[stats] [more_stats] [tcp_stats] [rx_latency] [poll_profile] [stack] "
+    "[stack_state] [vis] [opts] [lots] [extra] [all]",
     &argc, argv, cfg_opts, N_CFG_OPTS);
   ++argv;  --argc;
 
@@ -52,6 +110,14 @@ int main(int argc, char** argv)
   }
   unsigned int n = 0;
 
+  if( cfg_binary ) {
+    bin_counters = calloc(orm_bin_n_counters, sizeof(*bin_counters));
+    if( bin_counters == NULL ) {
+      printf("Out of memory\n");
+      return EXIT_FAILURE;
+    }
+  }
+
   printf("Publishing stats to ZMQ endpoint: %s\n", cfg_endpoint);
   zsock_t* publisher = zsock_new_pub(cfg_endpoint);
   // allow ^C etc to stop the app
@@ -61,29 +127,24 @@ int main(int argc, char** argv)
     if( zsys_interrupted )
       break;
 
-    char* data = NULL;
-    size_t datalen = 0;
-    FILE* output_stream = open_memstream(&data, &datalen);
-
-    int rc = orm_do_dump(&cfg, output_flags, output_stream);
-    fclose(output_stream);
-
-    if( rc == 0 ) {
-      // data generated OK
-      zstr_send(publisher, data);
+    int rc = cfg_binary ? bin_publish(publisher, n) :
+                          json_publish(publisher, output_flags);
+    if( rc == 0 )
       printf("Stats published #%u\n", ++n);
-    }
-    else {
-      printf("Not able to generate JSON rc=%d\n", rc);
-    }
-
+    else
+      printf("Not able to generate %s rc=%d\n",
+             cfg_binary ? "binary stats" : "JSON", rc);
     fflush(stdout);
-    free(data);
 
-    sleep(cfg_interval);
+    if( cfg_interval_ms > 0 )
+      usleep(cfg_interval_ms * 1000);
+    else
+      sleep(cfg_interval);
   }
 
   // clean up
+  orm_bin_enc_free(&bin_enc);
+  free(bin_counters);
   zsock_destroy(&publisher);
   return 0;
 }
@@ -11,16 +11,42 @@
 
 #include <czmq.h>
 
+#include "orm_bin.h"
+
 static char* cfg_endpoint = "tcp://localhost:5556";
+static int cfg_binary;
 
 static ci_cfg_desc cfg_opts[] = {
   { 'h', "help", CI_CFG_USAGE, 0, "this message" },
   { 0, "endpoint",  CI_CFG_STR,  &cfg_endpoint,
     "ZMQ endpoint to subscribe to stats (default tcp://localhost:5556)" },
+  { 0, "binary", CI_CFG_FLAG,   &cfg_binary,
+    "expect updates from orm_zmq_publisher --binary" },
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
 
+static void bin_print(void* arg, int stack_id, int counter, uint64_t value)
+{
+  if( counter < 0 )
+    printf("%d gone\n", stack_id);
+  else
+    printf("%d %s %"PRIu64"\n", stack_id, orm_bin_counter_names[counter],
+           value);
+}
+
+
+static void bin_apply(struct orm_bin_dec* dec, zframe_t* frame)
+{
+  int rc = orm_bin_dec_apply(dec, zframe_data(frame), zframe_size(frame),
+                         bin_print, NULL);
+  if( rc == -EAGAIN )
+    fprintf(stderr, "Waiting for keyframe...\n");
+  else if( rc < 0 )
+    fprintf(stderr, "Bad update rc=%d\n", rc);
+}
+
+
 int main (int argc, char *argv [])
 {
   ci_app_standard_opts = 0;
@@ -29,6 +55,7 @@ int main (int argc, char *argv [])
 
   unsigned int update_n = 0;
   char* buffer = NULL;
+  struct orm_bin_dec dec = { };
 
   // allow ^C etc to stop the app
   zsys_catch_interrupts();
@@ -38,7 +65,19 @@ int main (int argc, char *argv [])
 
   fprintf(stderr, "Waiting for update from publisher...\n");
 
-  while( 1 ) {
+  while( cfg_binary ) {
+    zframe_t* frame = zframe_recv(subscriber);
+    if( zsys_interrupted )
+      break;
+    ++update_n;
+    fprintf(stderr, "Received update #%u :\n", update_n);
+    if( frame != NULL )
+      bin_apply(&dec, frame);
+    zframe_destroy(&frame);
+    fflush(stdout);
+  }
+
+  while( ! cfg_binary ) {
     buffer = zstr_recv(subscriber);
     if( zsys_interrupted )
       break;
@@ -48,6 +87,7 @@ int main (int argc, char *argv [])
     zstr_free(&buffer);
   }
 
+  orm_bin_dec_free(&dec);
   zsock_destroy(&subscriber);
   return 0;
 }
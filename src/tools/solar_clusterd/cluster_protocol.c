@@ -172,11 +172,31 @@ static PyObject* vi_set_add_stream(PyObject* self, PyObject* args)
 }
 
 
+static PyObject* vi_set_rss_spread(PyObject* self, PyObject* args)
+{
+  struct cp_vi* cp_vi;
+  int rc, cp_vi_index, n_active;
+
+  if( ! PyArg_ParseTuple(args, "ii", &cp_vi_index, &n_active) )
+    return NULL;
+
+  cp_vi = cp_vis[cp_vi_index];
+  rc = ef_vi_set_rss_spread(&cp_vi->viset, cp_vi->dh, n_active);
+  if( rc < 0 ) {
+    errno = -rc;
+    return PyErr_SetFromErrno(PyExc_OSError);
+  }
+
+  Py_RETURN_NONE;
+}
+
+
 static PyMethodDef cluster_protocol_methods[] = {
   {"sendfd",       sendfd,       METH_VARARGS, "sendfd(sock, fd, msg)"},
   {"open_driver",  open_driver,  METH_VARARGS, "open_driver() -> handle"},
   {"vi_set_alloc", vi_set_alloc, METH_VARARGS, "vi_set_alloc()"},
   {"vi_set_add_stream", vi_set_add_stream, METH_VARARGS, "vi_set_add_stream()"},
+  {"vi_set_rss_spread", vi_set_rss_spread, METH_VARARGS, "vi_set_rss_spread()"},
   {NULL,           NULL,         0,             NULL}
 };
 
@@ -205,6 +225,9 @@ PyMODINIT_FUNC PyInit_cluster_protocol(void)
   MODULE_INT_CONST(module, CLUSTERD_VERSION_RESP);
   MODULE_INT_CONST(module, CLUSTERD_ALLOC_CLUSTER_REQ);
   MODULE_INT_CONST(module, CLUSTERD_ALLOC_CLUSTER_RESP);
+  MODULE_INT_CONST(module, CLUSTERD_RESIZE_CLUSTER_REQ);
+  MODULE_INT_CONST(module, CLUSTERD_RESIZE_CLUSTER_RESP);
+  MODULE_INT_CONST(module, CLUSTERD_CLUSTER_RESIZED);
 
   MODULE_INT_CONST(module, CLUSTERD_ERR_SUCCESS);
   MODULE_INT_CONST(module, CLUSTERD_ERR_FAIL);
@@ -114,6 +114,7 @@ class Config(object):
         # defaults
         optional_props = {
             'numchannels'    : (int, 1),
+            'maxchannels'    : (int, 0),
             'protectionmode' : (str, 'EF_PD_DEFAULT'),
             }
 
@@ -157,6 +158,12 @@ class Config(object):
             cluster['streams'] = streams
 
         for (name, props) in self.clusters.items():
+            if props['maxchannels'] == 0:
+                props['maxchannels'] = props['numchannels']
+            if props['numchannels'] < 1 or \
+                    props['numchannels'] > props['maxchannels']:
+                raise SyntaxError("Cluster '%s': NumChannels must be between "
+                                  "1 and MaxChannels" % name)
             for prop in singleval_props.keys():
                 if prop not in props:
                     raise SyntaxError("Cluster '%s' is missing property '%s'" %